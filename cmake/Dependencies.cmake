@@ -1,6 +1,9 @@
 # This list is required for static linking and exported to CaffeConfig.cmake
 set(Caffe_LINKER_LIBS "")
 
+# ---[ dl (runtime BLAS backend loading)
+list(APPEND Caffe_LINKER_LIBS ${CMAKE_DL_LIBS})
+
 # ---[ Boost
 find_package(Boost 1.46 REQUIRED COMPONENTS system thread filesystem)
 include_directories(SYSTEM ${Boost_INCLUDE_DIR})
@@ -39,6 +42,23 @@ if(USE_LMDB)
   endif()
 endif()
 
+# ---[ Release serving
+if(CAFFE_RELEASE_CHECKS)
+  add_definitions(-DCAFFE_RELEASE_CHECKS)
+endif()
+
+# ---[ NUMA
+if(USE_NUMA)
+  find_library(NUMA_LIBRARY numa)
+  find_path(NUMA_INCLUDE_DIR numa.h)
+  if(NOT NUMA_LIBRARY OR NOT NUMA_INCLUDE_DIR)
+    message(FATAL_ERROR "Could not find libnuma (required by USE_NUMA)")
+  endif()
+  include_directories(SYSTEM ${NUMA_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${NUMA_LIBRARY})
+  add_definitions(-DUSE_NUMA)
+endif()
+
 # ---[ LevelDB
 if(USE_LEVELDB)
   find_package(LevelDB REQUIRED)
@@ -56,6 +76,10 @@ endif()
 
 # ---[ CUDA
 include(cmake/Cuda.cmake)
+if(USE_PER_THREAD_STREAMS AND NOT CPU_ONLY)
+  add_definitions(-DUSE_PER_THREAD_STREAMS -DCUDA_API_PER_THREAD_DEFAULT_STREAM)
+  list(APPEND CUDA_NVCC_FLAGS --default-stream=per-thread)
+endif()
 if(NOT HAVE_CUDA)
   if(CPU_ONLY)
     message(STATUS "-- CUDA is disabled. Building without it...")
@@ -67,6 +91,33 @@ if(NOT HAVE_CUDA)
   add_definitions(-DCPU_ONLY)
 endif()
 
+# ---[ NCCL
+if(USE_NCCL)
+  find_package(NCCL REQUIRED)
+  include_directories(SYSTEM ${NCCL_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${NCCL_LIBRARIES})
+  add_definitions(-DUSE_NCCL)
+endif()
+
+# ---[ NVTX
+if(USE_NVTX)
+  list(APPEND Caffe_LINKER_LIBS nvToolsExt)
+  add_definitions(-DUSE_NVTX)
+endif()
+
+# ---[ librt (shm_open for the shared weight segments)
+if(UNIX AND NOT APPLE)
+  list(APPEND Caffe_LINKER_LIBS rt)
+endif()
+
+# ---[ MPI
+if(USE_MPI)
+  find_package(MPI REQUIRED)
+  include_directories(SYSTEM ${MPI_CXX_INCLUDE_PATH})
+  list(APPEND Caffe_LINKER_LIBS ${MPI_CXX_LIBRARIES})
+  add_definitions(-DUSE_MPI)
+endif()
+
 # ---[ OpenCV
 if(USE_OPENCV)
   find_package(OpenCV QUIET COMPONENTS core highgui imgproc imgcodecs)
@@ -79,6 +130,14 @@ if(USE_OPENCV)
   add_definitions(-DUSE_OPENCV)
 endif()
 
+# ---[ TurboJPEG
+if(USE_TURBOJPEG)
+  find_package(TurboJPEG REQUIRED)
+  include_directories(SYSTEM ${TurboJPEG_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${TurboJPEG_LIBRARIES})
+  add_definitions(-DUSE_TURBOJPEG)
+endif()
+
 # ---[ BLAS
 if(NOT APPLE)
   set(BLAS "Atlas" CACHE STRING "Selected BLAS library")
@@ -0,0 +1,17 @@
+# Try to find the libjpeg-turbo TurboJPEG API
+#  TurboJPEG_FOUND - system has the turbojpeg library
+#  TurboJPEG_INCLUDE_DIR - the turbojpeg include directory
+#  TurboJPEG_LIBRARIES - libraries needed to use turbojpeg
+
+find_path(TurboJPEG_INCLUDE_DIR NAMES turbojpeg.h
+          PATHS "$ENV{TURBOJPEG_DIR}/include")
+find_library(TurboJPEG_LIBRARIES NAMES turbojpeg
+             PATHS "$ENV{TURBOJPEG_DIR}/lib")
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(TurboJPEG DEFAULT_MSG
+                                  TurboJPEG_INCLUDE_DIR TurboJPEG_LIBRARIES)
+
+if(TurboJPEG_FOUND)
+  mark_as_advanced(TurboJPEG_INCLUDE_DIR TurboJPEG_LIBRARIES)
+endif()
@@ -24,7 +24,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0),
+         sparse_diff_rows_valid_(false), forward_only_(false) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -51,6 +52,21 @@ class Blob {
   void Reshape(const vector<int>& shape);
   void Reshape(const BlobShape& shape);
   void ReshapeLike(const Blob& other);
+  /**
+   * @brief Ensure capacity for at least @p count elements without changing
+   *        the shape, so no Reshape up to that size ever reallocates --
+   *        call once with the largest input a deploy net will see.
+   *
+   * Reallocation discards any existing data and diff contents, as with
+   * growth inside Reshape.
+   */
+  void Reserve(const int count);
+  /**
+   * @brief Release the excess capacity that geometric growth in Reshape
+   *        leaves behind, reallocating to exactly count() elements.
+   *        Contents are discarded.
+   */
+  void ShrinkToFit();
   inline string shape_string() const {
     ostringstream stream;
     for (int i = 0; i < shape_.size(); ++i) {
@@ -226,7 +242,50 @@ class Blob {
   Dtype* mutable_gpu_data();
   Dtype* mutable_cpu_diff();
   Dtype* mutable_gpu_diff();
+
+#ifndef CPU_ONLY
+  /**
+   * @brief Enqueues the device-to-host copy of the data on the given
+   *        stream and records @p event (if non-NULL) after it, instead
+   *        of blocking inside cpu_data().
+   *
+   * Lets callers overlap reading back one batch's outputs with the next
+   * batch's compute. cpu_data() returns the fetched values without a
+   * further copy once the caller has synchronized on the event or the
+   * stream; reading before that sees stale data. The caller is also
+   * responsible for ordering the stream after the compute that produces
+   * the blob (e.g. with cudaStreamWaitEvent).
+   */
+  void async_cpu_fetch(const cudaStream_t& stream, cudaEvent_t event);
+#endif
+
   void Update();
+
+  /**
+   * @brief Record that only the given rows (slices along axis 0) of the
+   *        diff are non-zero, merging with any rows already recorded.
+   *
+   * Layers with sparse gradients (e.g. Embed) annotate their parameter
+   * blob after accumulating; Update, Net::ClearParamDiffs and SGDSolver
+   * then touch only those rows instead of sweeping the whole blob. The
+   * annotation is dropped whenever the diff may be dense again.
+   */
+  void accumulate_sparse_diff_rows(const vector<int>& rows);
+  bool has_sparse_diff_rows() const { return sparse_diff_rows_valid_; }
+  const vector<int>& sparse_diff_rows() const { return sparse_diff_rows_; }
+  void clear_sparse_diff_rows() {
+    sparse_diff_rows_valid_ = false;
+    sparse_diff_rows_.clear();
+  }
+
+  /**
+   * @brief Forbid all diff access so the lazy SyncedMemory behind it can
+   *        never be faulted in -- set by Net on inference-only nets,
+   *        where diffs would silently double the memory footprint.
+   */
+  void set_forward_only(bool forward_only) { forward_only_ = forward_only; }
+  bool forward_only() const { return forward_only_; }
+
   void FromProto(const BlobProto& proto, bool reshape = true);
   void ToProto(BlobProto* proto, bool write_diff = false) const;
 
@@ -238,6 +297,9 @@ class Blob {
   Dtype sumsq_data() const;
   /// @brief Compute the sum of squares (L2 norm squared) of the diff.
   Dtype sumsq_diff() const;
+  /// @brief Fraction of data entries that are exactly zero, in [0, 1];
+  ///        0 for an empty blob. Used to pick pruning-aware kernels.
+  float sparsity() const;
 
   /// @brief Scale the blob data by a constant factor.
   void scale_data(Dtype scale_factor);
@@ -263,6 +325,50 @@ class Blob {
    */
   void ShareDiff(const Blob& other);
 
+  /**
+   * @brief Back this blob's data by an offset view into other's data:
+   *        accesses read and write other's storage starting at element
+   *        offset. Used by Net::WireZeroCopyViews to alias concat
+   *        bottoms (and slice tops) into their shared storage so the
+   *        layer's copies become pointer-equal no-ops.
+   *
+   * The view is pinned to the current shape: a Reshape to any other
+   * count falls back to private storage.
+   */
+  void ShareDataRange(const Blob& other, int offset);
+  /// @brief Like ShareDataRange, for the diff.
+  void ShareDiffRange(const Blob& other, int offset);
+  /// @brief Replace any data/diff views with private storage.
+  void UnshareViews();
+
+  /**
+   * @brief Release the data allocation, keeping shape and diff; the
+   *        next data access allocates fresh storage. Used by activation
+   *        checkpointing to free non-checkpoint activations that will
+   *        be regenerated by recompute.
+   */
+  void ReleaseData();
+
+  /**
+   * @brief Set the data_ shared_ptr to point to an externally managed
+   *        SyncedMemory at least count() elements large -- used by
+   *        Net::ShareActivations to back several blobs with disjoint
+   *        forward lifetimes by one buffer.
+   *
+   * Unlike ShareData the sizes need not match exactly. If the blob is
+   * later Reshape%d beyond its current capacity it falls back to private
+   * storage, so sharing is a best-effort space optimization.
+   */
+  void ShareDataBuffer(const shared_ptr<SyncedMemory>& data);
+
+  /**
+   * @brief Exchange all contents (shape, data and diff storage) with
+   *        another Blob in constant time -- the copy-free way to move a
+   *        blob between holders, e.g. when rotating the timestep blobs
+   *        of an unrolled recurrent net.
+   */
+  void Swap(Blob* other);
+
   bool ShapeEquals(const BlobProto& other);
 
  protected:
@@ -272,6 +378,9 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  bool sparse_diff_rows_valid_;
+  vector<int> sparse_diff_rows_;
+  bool forward_only_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
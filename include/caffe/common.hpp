@@ -131,11 +131,42 @@ class Caffe {
     }
     return *(Get().random_generator_);
   }
+  // Serialized state of this thread's host RNG, and its restoration:
+  // the replay capture mechanism ('caffe train --capture_replay')
+  // records it each iteration so an iteration window can be rerun with
+  // the exact random sequence. Device-side curand state is separate
+  // and not covered.
+  static string rng_state();
+  static void set_rng_state(const string& state);
 #ifndef CPU_ONLY
-  inline static cublasHandle_t cublas_handle() { return Get().cublas_handle_; }
-  inline static curandGenerator_t curand_generator() {
-    return Get().curand_generator_;
+  // The calling thread's cuBLAS handle / curand generator, leased
+  // lazily from a per-device cache on first use and returned when the
+  // thread's instance is destroyed. Threads that only read mode() or
+  // run CPU work never touch the GPU, and a thread pool recycles the
+  // handles instead of paying handle creation (with its context
+  // initialization) on every pool growth. Each live thread still holds
+  // its handles exclusively: callers transiently rebind streams and
+  // the cuBLAS pointer mode, which would race on a handle shared
+  // between running threads.
+  static cublasHandle_t cublas_handle();
+  static curandGenerator_t curand_generator();
+  // Bumped by set_random_seed; lets consumers of pre-drawn device
+  // randomness (the dropout mask pool) notice a reseed and regenerate
+  // what they pipelined ahead.
+  inline static int random_seed_generation() {
+    return Get().random_seed_generation_;
   }
+  /**
+   * @brief Returns the index-th stream of this thread's pooled CUDA
+   *        streams, created lazily and non-blocking w.r.t. the default
+   *        stream. The pool is what lets independent layers and data
+   *        layer H2D copies overlap; it belongs to the thread-local
+   *        singleton, so every worker thread and device gets its own.
+   */
+  static cudaStream_t stream(int index);
+  /// @brief Returns a cuBLAS handle bound to stream(index), for GPU
+  ///        layers that issue their BLAS calls on a pooled stream.
+  static cublasHandle_t cublas_handle(int index);
 #endif
 
   // Returns the mode: running on CPU or GPU.
@@ -158,26 +189,117 @@ class Caffe {
   // Search from start_id to the highest possible device ordinal,
   // return the ordinal of the first available device.
   static int FindDevice(const int start_id = 0);
+  // cuDNN backward convolution algorithm policy. Mirrors
+  // SolverParameter.CuDNNBackwardPolicy; the solver sets it here so the
+  // convolution layers need not know about SolverParameter.
+  enum CuDNNBackward {
+    CUDNN_BACKWARD_FASTEST,
+    CUDNN_BACKWARD_DETERMINISTIC,
+    CUDNN_BACKWARD_MEMORY_LEAN
+  };
+  inline static CuDNNBackward cudnn_backward_policy() {
+    return Get().cudnn_backward_policy_;
+  }
+  inline static void set_cudnn_backward_policy(CuDNNBackward val) {
+    Get().cudnn_backward_policy_ = val;
+  }
+  // Host memory placement policy on NUMA machines (requires USE_NUMA).
+  // Mirrors NetParameter.NumaPolicy: NUMA_INTERLEAVE spreads pages across
+  // nodes so no socket pays full cross-socket bandwidth, NUMA_LOCAL binds
+  // them to the allocating thread's node (bind-to-consumer when the
+  // consumer faults its own buffers in, as prefetch threads do). The
+  // policy is thread-local like mode(), and tags each allocation, so it
+  // may change while older buffers are still live.
+  enum NumaPolicy {
+    NUMA_NONE,
+    NUMA_INTERLEAVE,
+    NUMA_LOCAL
+  };
+  inline static NumaPolicy numa_policy() { return Get().numa_policy_; }
+  static void set_numa_policy(NumaPolicy val);
+  // Load an alternate CBLAS shared object (OpenBLAS, MKL or BLIS built
+  // for the host); each GEMM shape is then timed against the built-in
+  // BLAS on first use and the faster backend wins. An empty path reverts
+  // to the built-in BLAS. Call before spawning worker threads.
+  static void set_blas_backend(const string& path);
+  // Process-wide cap on the cores Caffe-managed CPU parallelism may use:
+  // the conv batch workers, the dataflow forward pool and per-layer BLAS
+  // thread hints (LayerParameter.blas_threads) all clamp to it, so the
+  // subsystems stay within one budget instead of oversubscribing each
+  // other and the prefetch threads. 0 (the default) means no cap.
+  // Unlike mode(), the budget is shared across threads.
+  static int cpu_core_budget();
+  static void set_cpu_core_budget(const int budget);
+  // Stats of the caching device allocator behind SyncedMemory and the
+  // cuDNN workspace pool: bytes currently idle in its free lists, and the
+  // fraction of device allocations served from them. Both are zero in
+  // CPU-only builds.
+  static size_t gpu_allocator_bytes_cached();
+  static double gpu_allocator_hit_rate();
+  // Frees every idle cached device block, e.g. to give headroom back to
+  // an external library sharing the GPU.
+  static void ReleaseCachedGPUMemory();
+  // Multi-line device memory telemetry: the allocator's live/peak bytes,
+  // cache contents, per-bin allocation histogram and fragmentation
+  // estimate, plus how much of the live footprint SyncedMemory (blob
+  // storage) holds -- the remainder is layer scratch. CUDA_CHECK logs
+  // it before aborting on an allocation failure; see Net::memory_report
+  // for the per-layer breakdown of one net.
+  static string memory_telemetry();
   // Parallel training info
   inline static int solver_count() { return Get().solver_count_; }
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // Whether this process is one rank of a multi-process (multi-node)
+  // training job; see DistributedSync in parallel.hpp. solver_rank is
+  // this process's rank and process_count the total number of ranks;
+  // the data readers use them to give each rank a disjoint interleave
+  // of the database key range.
+  inline static bool multiprocess() { return Get().multiprocess_; }
+  inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
+  inline static int solver_rank() { return Get().solver_rank_; }
+  inline static void set_solver_rank(int val) { Get().solver_rank_ = val; }
+  inline static int process_count() { return Get().process_count_; }
+  inline static void set_process_count(int val) {
+    Get().process_count_ = val;
+  }
 
  protected:
 #ifndef CPU_ONLY
   cublasHandle_t cublas_handle_;
   curandGenerator_t curand_generator_;
+  int random_seed_generation_;
+  // Seed recorded by set_random_seed before the generator exists,
+  // applied when it is first leased.
+  unsigned int curand_seed_;
+  bool curand_seed_pending_;
+  // Device the leased handles belong to; -1 before the first lease.
+  int handle_device_;
+  // Pooled streams and matching stream-bound cuBLAS handles; see
+  // stream(index). Released by the destructor and on SetDevice.
+  vector<cudaStream_t> stream_pool_;
+  vector<cublasHandle_t> cublas_pool_;
 #endif
   shared_ptr<RNG> random_generator_;
 
   Brew mode_;
+  CuDNNBackward cudnn_backward_policy_;
+  NumaPolicy numa_policy_;
   int solver_count_;
   bool root_solver_;
+  bool multiprocess_;
+  int solver_rank_;
+  int process_count_;
 
  private:
   // The private constructor to avoid duplicate instantiation.
   Caffe();
+#ifndef CPU_ONLY
+  // Returns this thread's leased handles to the per-device cache; used
+  // by the destructor and SetDevice.
+  void ReleaseGpuHandles();
+#endif
 
   DISABLE_COPY_AND_ASSIGN(Caffe);
 };
@@ -7,9 +7,14 @@
 
 #include "caffe/common.hpp"
 #include "caffe/internal_thread.hpp"
+#include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
 
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+#include <google/protobuf/arena.h>  // NOLINT(build/include_order)
+#endif
+
 namespace caffe {
 
 /**
@@ -41,6 +46,11 @@ class DataReader {
 
     BlockingQueue<Datum*> free_;
     BlockingQueue<Datum*> full_;
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+    // The pooled datums live in this arena, so parse allocations are
+    // bump-pointer and all of them are freed wholesale with the pair.
+    google::protobuf::Arena arena_;
+#endif
 
   DISABLE_COPY_AND_ASSIGN(QueuePair);
   };
@@ -53,7 +63,18 @@ class DataReader {
 
    protected:
     void InternalThreadEntry();
-    void read_one(db::Cursor* cursor, QueuePair* qp);
+    void read_one(db::Cursor* cursor, QueuePair* qp, int stride = 1);
+    // Walks one stride class of the key range. Shard 0 passes the
+    // already-advanced initialization cursor so its records are not
+    // delivered twice; workers pass an empty cursor and open their own.
+    void shard_loop(db::DB* db, shared_ptr<db::Cursor> cursor, int shard,
+        int num_shards, const vector<shared_ptr<QueuePair> >& qps);
+    void multi_shard_loop(const vector<shared_ptr<db::Cursor> >& cursors,
+        int worker, int num_workers, int stride,
+        const vector<shared_ptr<QueuePair> >& qps);
+    static int reader_threads(const LayerParameter& param);
+    // The shard_source list, or the single source when no shards are set.
+    static vector<string> shard_sources(const LayerParameter& param);
 
     const LayerParameter param_;
     BlockingQueue<shared_ptr<QueuePair> > new_queue_pairs_;
@@ -63,10 +84,14 @@ class DataReader {
   DISABLE_COPY_AND_ASSIGN(Body);
   };
 
-  // A source is uniquely identified by its layer name + path, in case
+  // A source is uniquely identified by its layer name + path(s), in case
   // the same database is read from two different locations in the net.
   static inline string source_key(const LayerParameter& param) {
-    return param.name() + ":" + param.data_param().source();
+    string key = param.name() + ":" + param.data_param().source();
+    for (int i = 0; i < param.data_param().shard_source_size(); ++i) {
+      key += "|" + param.data_param().shard_source(i);
+    }
+    return key;
   }
 
   const shared_ptr<QueuePair> queue_pair_;
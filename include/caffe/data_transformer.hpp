@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
 
 namespace caffe {
 
@@ -37,10 +38,29 @@ class DataTransformer {
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the transformation to a DatumView, reading pixel data
+   * directly from the view's backing buffer (e.g. an LMDB page) without
+   * any intermediate copy. Encoded datums are not supported here since
+   * they must be decoded first.
+   *
+   * @param view
+   *    DatumView over a serialized Datum with uint8 data.
+   * @param transformed_blob
+   *    This is destination blob. It can be part of top blob's data if
+   *    set_cpu_data() is used. See data_layer.cpp for an example.
+   */
+  void Transform(const DatumView& view, Blob<Dtype>* transformed_blob);
+
   /**
    * @brief Applies the transformation defined in the data layer's
    * transform_param block to a vector of Datum.
    *
+   * When transform_param.threads is greater than one, the items are
+   * divided across an internal pool of worker threads; each worker draws
+   * its crop/mirror decisions from its own RNG stream so results stay
+   * reproducible for a fixed seed and thread count.
+   *
    * @param datum_vector
    *    A vector of Datum containing the data to be transformed.
    * @param transformed_blob
@@ -50,6 +70,30 @@ class DataTransformer {
   void Transform(const vector<Datum> & datum_vector,
                 Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Batch-granular transform: validates shapes against the first
+   * datum once, precomputes every random decision up front, then applies
+   * the pixel work in a tight loop (parallelized across
+   * transform_param.threads since the workers no longer draw randoms).
+   * Bit-identical to per-item Transform() calls in the same order.
+   *
+   * @param datum_vector
+   *    Pointers to the Datums to transform, all of identical dimensions.
+   * @param transformed_blob
+   *    This is destination blob; its num must cover the vector.
+   */
+  void TransformBatch(const vector<Datum*>& datum_vector,
+      Blob<Dtype>* transformed_blob);
+
+  /**
+   * @brief Whether transforming this datum is a pure uint8-to-Dtype
+   * widening copy: unencoded uint8 data, no mirror/scale/mean or
+   * augmentation, and any crop_size already equal to the datum's
+   * dimensions. TransformBatch takes a straight-copy path when so,
+   * which pre-resized eval datasets hit on every item.
+   */
+  bool IsIdentity(const Datum& datum) const;
+
 #ifdef USE_OPENCV
   /**
    * @brief Applies the transformation defined in the data layer's
@@ -90,6 +134,29 @@ class DataTransformer {
    */
   void Transform(Blob<Dtype>* input_blob, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Draws the crop offsets and mirror decision for one item from
+   * the usual RNG stream, in the same order as the CPU transform. Used by
+   * callers that apply the pixel work elsewhere, e.g. the GPU engine.
+   */
+  void SampleTransformParams(int datum_height, int datum_width,
+      int* h_off, int* w_off, bool* do_mirror);
+
+#ifndef CPU_ONLY
+  /**
+   * @brief Applies mean/scale/crop/mirror to a batch of packed uint8
+   * images already resident on the device, writing planar Dtype output.
+   *
+   * @param data
+   *    num contiguous uint8 images of datum_height x datum_width.
+   * @param params
+   *    One (h_off, w_off, mirror) int triple per image, as produced by
+   *    SampleTransformParams().
+   */
+  void TransformGPU(int num, int channels, int datum_height, int datum_width,
+      const unsigned char* data, const int* params, Dtype* transformed_data);
+#endif
+
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -137,16 +204,66 @@ class DataTransformer {
    *    A uniformly random integer value from ({0, 1, ..., n-1}).
    */
   virtual int Rand(int n);
+  /// As Rand(n), but drawing from the given stream instead of rng_.
+  int Rand(int n, Caffe::RNG* rng);
 
-  void Transform(const Datum& datum, Dtype* transformed_data);
+  void Transform(const Datum& datum, Dtype* transformed_data,
+      Caffe::RNG* rng);
+  /// As the public SampleTransformParams, drawing from the given stream.
+  void SampleTransformParams(int datum_height, int datum_width,
+      int* h_off, int* w_off, bool* do_mirror, Caffe::RNG* rng);
+  /// The pixel work of Transform(Datum), with the random decisions given.
+  void ApplyTransform(const Datum& datum, Dtype* transformed_data,
+      int h_off, int w_off, bool do_mirror);
+  /**
+   * @brief Parses mean_file into data_mean_ on first use, so nets that
+   * never transform data (e.g. caffe time) skip the cost entirely. A
+   * spatially constant mean collapses to per-channel mean_values_ at
+   * load, taking the cheap broadcast path and freeing the full blob;
+   * after this call, data_mean_.count() > 0 says whether a pixel-wise
+   * mean is in effect.
+   */
+  void LoadMeanFile();
+  /// Applies items worker, worker + num_workers, ... of a batch whose
+  /// decisions were precomputed into params (3 ints per item).
+  void ApplyBatchWorker(const vector<Datum*>* datum_vector,
+      Blob<Dtype>* transformed_blob, const vector<int>* params,
+      int worker, int num_workers);
+  void Transform(const DatumView& view, Dtype* transformed_data,
+      Caffe::RNG* rng);
+  void Transform(const Datum& datum, Blob<Dtype>* transformed_blob,
+      Caffe::RNG* rng);
+#ifdef USE_OPENCV
+  void Transform(const cv::Mat& cv_img, Blob<Dtype>* transformed_blob,
+      Caffe::RNG* rng);
+  /**
+   * @brief Fused random-resized-crop, rotation and brightness/contrast
+   * jitter for decoded images: samples the patch and jitter once, then
+   * fills the output in a single bilinear pass, so cost stays
+   * proportional to the crop. Used by Transform(cv::Mat) in TRAIN phase
+   * when any of the augmentation fields are set.
+   */
+  void TransformAugmented(const cv::Mat& cv_img,
+      Blob<Dtype>* transformed_blob, Caffe::RNG* rng);
+#endif  // USE_OPENCV
+  /// Transforms items worker, worker + num_workers, ... of the vector,
+  /// drawing random decisions from the worker's own RNG stream.
+  void TransformWorker(const vector<Datum>* datum_vector,
+      Blob<Dtype>* transformed_blob, int worker, int num_workers);
   // Tranformation parameters
   TransformationParameter param_;
 
 
   shared_ptr<Caffe::RNG> rng_;
+  // Per-worker streams for threaded batch transforms; entry 0 is rng_.
+  vector<shared_ptr<Caffe::RNG> > worker_rngs_;
   Phase phase_;
   Blob<Dtype> data_mean_;
+  bool mean_loaded_;
   vector<Dtype> mean_values_;
+  // Device copy of mean_values_, replicated to one entry per channel.
+  // Filled lazily by TransformGPU.
+  Blob<Dtype> mean_values_blob_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,74 @@
+#ifndef CAFFE_INFERENCE_SESSION_HPP_
+#define CAFFE_INFERENCE_SESSION_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Thread-safe single-image inference on one Net with dynamic
+ *        batching.
+ *
+ * Net itself has no notion of concurrent callers, so serving code ends
+ * up serializing whole Forward calls behind a mutex and running every
+ * request at batch size one. InferenceSession layers the standard
+ * dynamic batching pattern on top of one net: concurrent callers each
+ * submit a single input, arrivals are coalesced into the net's batch
+ * dimension -- up to max_batch images, waiting at most max_delay_us for
+ * an incomplete batch to fill -- one Forward runs for the whole batch,
+ * and each caller gets its slice of the outputs back.
+ *
+ * Coalescing uses the first caller of a batch as the leader: it
+ * collects followers, runs the forward pass, and hands the results out,
+ * so no extra dispatch thread is needed. While one batch runs forward
+ * the next one collects, keeping the net busy under load. The net's
+ * input blob is reshaped to each batch's size, which recurring batch
+ * sizes make cheap (see ConvolutionParameter::cudnn_shape_buckets).
+ *
+ * The session requires a net with exactly one input blob and does not
+ * take ownership of it; the net must not be used by other code while
+ * the session is live.
+ */
+template <typename Dtype>
+class InferenceSession {
+ public:
+  // max_batch bounds how many requests one forward packs together;
+  // max_delay_us is how long an incomplete batch waits for more
+  // arrivals before running anyway (0 runs whatever has queued at the
+  // time the leader gets to go, adding no latency).
+  InferenceSession(Net<Dtype>* net, int max_batch, int max_delay_us);
+  ~InferenceSession();
+
+  // Runs one image through the net and blocks until its results are
+  // ready. input must hold input_size() values; outputs must hold one
+  // pointer per net output, the i-th with room for output_size(i)
+  // values. Safe to call from any number of threads.
+  void Infer(const Dtype* input, const vector<Dtype*>& outputs);
+
+  // Per-image value counts, i.e. blob counts without the batch axis.
+  int input_size() const { return input_size_; }
+  int num_outputs() const { return output_sizes_.size(); }
+  int output_size(int i) const { return output_sizes_[i]; }
+
+ private:
+  void ForwardBatch(const vector<const Dtype*>& inputs,
+      const vector<const vector<Dtype*>*>& outputs);
+
+  Net<Dtype>* net_;
+  const int max_batch_;
+  const int max_delay_us_;
+  int input_size_;
+  vector<int> output_sizes_;
+
+  class Coalescer;  // hides the boost synchronization state
+  shared_ptr<Coalescer> coalescer_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceSession);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_SESSION_HPP_
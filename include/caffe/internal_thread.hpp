@@ -3,22 +3,23 @@
 
 #include "caffe/common.hpp"
 
+namespace caffe {
+
 /**
- Forward declare boost::thread instead of including boost/thread.hpp
- to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ Forward declare WorkerHandle instead of including worker_pool.hpp so
+ headers reachable from .cu files stay clear of boost (NVCC issues
+ #1009, #1010 on OSX).
  */
-namespace boost { class thread; }
-
-namespace caffe {
+class WorkerHandle;
 
 /**
- * Virtual class encapsulate boost::thread for use in base class
+ * Virtual class encapsulating a task on the shared WorkerPool.
  * The child class will acquire the ability to run a single thread,
  * by reimplementing the virtual function InternalThreadEntry.
  */
 class InternalThread {
  public:
-  InternalThread() : thread_() {}
+  InternalThread() : handle_() {}
   virtual ~InternalThread();
 
   /**
@@ -42,10 +43,10 @@ class InternalThread {
   bool must_stop();
 
  private:
-  void entry(int device, Caffe::Brew mode, int rand_seed, int solver_count,
-      bool root_solver);
+  void entry(int device, Caffe::Brew mode, Caffe::NumaPolicy numa_policy,
+      int rand_seed, int solver_count, bool root_solver);
 
-  shared_ptr<boost::thread> thread_;
+  shared_ptr<WorkerHandle> handle_;
 };
 
 }  // namespace caffe
@@ -38,7 +38,8 @@ class Layer {
    * layer.
    */
   explicit Layer(const LayerParameter& param)
-    : layer_param_(param), is_shared_(false) {
+    : layer_param_(param), is_shared_(false), stream_id_(-1),
+      async_loss_slots_(NULL) {
       // Set phase and copy blobs (if there are any).
       phase_ = param.phase();
       if (layer_param_.blobs_size() > 0) {
@@ -146,6 +147,11 @@ class Layer {
    * bottom blobs.  If the layer has any non-zero loss_weights, the wrapper
    * then computes and returns the loss.
    *
+   * Reshape only runs when a bottom shape differs from the previous
+   * call: Reshape is a pure function of the bottom shapes, so for
+   * static-shape nets the wrapper skips the whole per-layer reshape
+   * chain and its rederived geometry after the first iteration.
+   *
    * Your layer should implement Forward_cpu and (optionally) Forward_gpu.
    */
   inline Dtype Forward(const vector<Blob<Dtype>*>& bottom,
@@ -210,6 +216,33 @@ class Layer {
     loss_[top_index] = value;
   }
 
+  /**
+   * @brief Returns the bytes of private scratch memory the layer holds
+   *        beyond its parameter and top blobs -- e.g. im2col column
+   *        buffers or cuDNN workspaces. Used by Net::memory_report; the
+   *        default of 0 is right for layers with no such buffers.
+   */
+  virtual size_t scratch_memory() const { return 0; }
+
+  /**
+   * @brief Binds this layer's GPU work to one of the pooled streams
+   *        from Caffe::stream; -1 (the default) keeps the default
+   *        stream. Only layers whose GPU code consults the binding
+   *        honor it -- see BasePrefetchingDataLayer::Forward_gpu.
+   */
+  inline void set_stream_id(int stream_id) { stream_id_ = stream_id; }
+  inline int stream_id() const { return stream_id_; }
+
+  /**
+   * @brief Points this layer at device-memory loss slots, one per top
+   *        blob. When set, the GPU Forward wrapper writes each top's
+   *        weighted loss there (cuBLAS device pointer mode) instead of
+   *        reading it back synchronously; Net drains the slots with an
+   *        asynchronous copy. NULL (the default) keeps the synchronous
+   *        readback.
+   */
+  inline void set_async_loss_slots(Dtype* slots) { async_loss_slots_ = slots; }
+
   /**
    * @brief Returns the layer type.
    */
@@ -331,6 +364,14 @@ class Layer {
    *  the objective function. */
   vector<Dtype> loss_;
 
+  /** Pooled stream index this layer's GPU work is bound to; -1 = default. */
+  int stream_id_;
+  /** Bottom shapes at the last Forward; while they hold, Reshape is
+   *  skipped (SetUp already ran it once for the initial shapes). */
+  vector<vector<int> > prev_bottom_shapes_;
+  /** Device slots for asynchronous loss readback; NULL = synchronous. */
+  Dtype* async_loss_slots_;
+
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
@@ -453,7 +494,17 @@ inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
   // Lock during forward to ensure sequential forward
   Lock();
   Dtype loss = 0;
-  Reshape(bottom, top);
+  bool shapes_changed = prev_bottom_shapes_.size() != bottom.size();
+  for (int i = 0; !shapes_changed && i < bottom.size(); ++i) {
+    shapes_changed = bottom[i]->shape() != prev_bottom_shapes_[i];
+  }
+  if (shapes_changed) {
+    Reshape(bottom, top);
+    prev_bottom_shapes_.resize(bottom.size());
+    for (int i = 0; i < bottom.size(); ++i) {
+      prev_bottom_shapes_[i] = bottom[i]->shape();
+    }
+  }
   switch (Caffe::mode()) {
   case Caffe::CPU:
     Forward_cpu(bottom, top);
@@ -462,7 +513,11 @@ inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
       const int count = top[top_id]->count();
       const Dtype* data = top[top_id]->cpu_data();
       const Dtype* loss_weights = top[top_id]->cpu_diff();
-      loss += caffe_cpu_dot(count, data, loss_weights);
+      if (count == 1) {
+        loss += data[0] * loss_weights[0];
+      } else {
+        loss += caffe_cpu_dot(count, data, loss_weights);
+      }
     }
     break;
   case Caffe::GPU:
@@ -473,9 +528,21 @@ inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
       const int count = top[top_id]->count();
       const Dtype* data = top[top_id]->gpu_data();
       const Dtype* loss_weights = top[top_id]->gpu_diff();
-      Dtype blob_loss = 0;
-      caffe_gpu_dot(count, data, loss_weights, &blob_loss);
-      loss += blob_loss;
+      if (async_loss_slots_) {
+        if (count == 1) {
+          // Loss tops are scalars; skip the cuBLAS pointer-mode round
+          // trip and write the weighted value straight into the slot.
+          caffe_gpu_scalar_mul_device(data, loss_weights,
+              async_loss_slots_ + top_id);
+        } else {
+          caffe_gpu_dot_device(count, data, loss_weights,
+              async_loss_slots_ + top_id);
+        }
+      } else {
+        Dtype blob_loss = 0;
+        caffe_gpu_dot(count, data, loss_weights, &blob_loss);
+        loss += blob_loss;
+      }
     }
 #endif
     break;
@@ -39,6 +39,7 @@
 #ifndef CAFFE_LAYER_FACTORY_H_
 #define CAFFE_LAYER_FACTORY_H_
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -52,6 +53,13 @@ namespace caffe {
 template <typename Dtype>
 class Layer;
 
+// The registry has two phases. During static initialization the
+// REGISTER_LAYER_* macros fill a map; no layers are created then. The
+// first CreateLayer or TypeId call freezes the map into a sorted
+// creator table, after which every lookup reads immutable data and is
+// safe from any number of threads without locking, so nets may be
+// constructed concurrently. Registering a type after the freeze is a
+// fatal error.
 template <typename Dtype>
 class LayerRegistry {
  public:
@@ -66,21 +74,42 @@ class LayerRegistry {
   // Adds a creator.
   static void AddCreator(const string& type, Creator creator) {
     CreatorRegistry& registry = Registry();
+    CHECK(!frozen()) << "Layer type " << type
+        << " registered after the registry was frozen.";
     CHECK_EQ(registry.count(type), 0)
         << "Layer type " << type << " already registered.";
     registry[type] = creator;
   }
 
+  // Integer id of a layer type in the frozen table, or -1 if the type
+  // is unknown. Resolve once and create via the id overload when the
+  // same type string would otherwise be looked up repeatedly.
+  static int TypeId(const string& type) {
+    const FrozenTable& table = Frozen();
+    vector<string>::const_iterator iter = std::lower_bound(
+        table.types.begin(), table.types.end(), type);
+    if (iter == table.types.end() || *iter != type) { return -1; }
+    return iter - table.types.begin();
+  }
+
   // Get a layer using a LayerParameter.
   static shared_ptr<Layer<Dtype> > CreateLayer(const LayerParameter& param) {
     if (Caffe::root_solver()) {
       LOG(INFO) << "Creating layer " << param.name();
     }
-    const string& type = param.type();
-    CreatorRegistry& registry = Registry();
-    CHECK_EQ(registry.count(type), 1) << "Unknown layer type: " << type
+    const int type_id = TypeId(param.type());
+    CHECK_GE(type_id, 0) << "Unknown layer type: " << param.type()
         << " (known types: " << LayerTypeListString() << ")";
-    return registry[type](param);
+    return CreateLayer(param, type_id);
+  }
+
+  // Get a layer from a type id previously resolved with TypeId.
+  static shared_ptr<Layer<Dtype> > CreateLayer(const LayerParameter& param,
+      const int type_id) {
+    const FrozenTable& table = Frozen();
+    CHECK_GE(type_id, 0);
+    CHECK_LT(type_id, table.creators.size());
+    return table.creators[type_id](param);
   }
 
   static vector<string> LayerTypeList() {
@@ -98,6 +127,37 @@ class LayerRegistry {
   // static variables.
   LayerRegistry() {}
 
+  // Snapshot of the registration map; types is sorted (map order), so
+  // a type's index in it is its id and lookups are binary searches.
+  struct FrozenTable {
+    vector<string> types;
+    vector<Creator> creators;
+  };
+
+  static bool& frozen() {
+    static bool frozen_instance = false;
+    return frozen_instance;
+  }
+
+  // Built exactly once, on the first lookup; the local static makes
+  // concurrent first calls safe.
+  static const FrozenTable& Frozen() {
+    static FrozenTable* table = BuildFrozenTable();
+    return *table;
+  }
+
+  static FrozenTable* BuildFrozenTable() {
+    FrozenTable* table = new FrozenTable();
+    CreatorRegistry& registry = Registry();
+    for (typename CreatorRegistry::const_iterator iter = registry.begin();
+         iter != registry.end(); ++iter) {
+      table->types.push_back(iter->first);
+      table->creators.push_back(iter->second);
+    }
+    frozen() = true;
+    return table;
+  }
+
   static string LayerTypeListString() {
     vector<string> layer_types = LayerTypeList();
     string layer_types_str;
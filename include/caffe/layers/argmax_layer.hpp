@@ -1,6 +1,7 @@
 #ifndef CAFFE_ARGMAX_LAYER_HPP_
 #define CAFFE_ARGMAX_LAYER_HPP_
 
+#include <utility>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -61,15 +62,24 @@ class ArgMaxLayer : public Layer<Dtype> {
    */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
   /// @brief Not implemented (non-differentiable function)
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
     NOT_IMPLEMENTED;
   }
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    NOT_IMPLEMENTED;
+  }
   bool out_max_val_;
   size_t top_k_;
   bool has_axis_;
   int axis_;
+  // Reusable top-k min-heap for Forward_cpu, so steady-state forwards
+  // do not allocate.
+  std::vector<std::pair<Dtype, int> > top_k_heap_;
 };
 
 }  // namespace caffe
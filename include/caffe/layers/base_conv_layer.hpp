@@ -7,6 +7,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/quant.hpp"
 
 namespace caffe {
 
@@ -18,7 +19,7 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), fused_relu_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -28,17 +29,85 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
 
+  // Makes this layer borrow the given blob for its column buffer instead
+  // of owning one. Layers that run sequentially (Net executes them so)
+  // can all borrow the same blob; Blob::Reshape never shrinks, so the
+  // shared buffer ends up sized by the high-water mark. See Net::Init.
+  void set_shared_col_buffer(const shared_ptr<Blob<Dtype> >& buffer) {
+    shared_col_buffer_ = buffer;
+  }
+
+  // Sums the column, staging and bias-multiplier buffers this layer
+  // owns; a net-injected shared column buffer is the net's to report.
+  virtual size_t scratch_memory() const {
+    size_t bytes = bias_multiplier_.count() * sizeof(Dtype);
+    if (!shared_col_buffer_) {
+      bytes += col_buffer_.count() * sizeof(Dtype);
+    }
+    for (int i = 0; i < col_buffers_.size(); ++i) {
+      bytes += col_buffers_[i]->count() * sizeof(Dtype);
+    }
+    for (int i = 0; i < weight_diff_buffers_.size(); ++i) {
+      bytes += weight_diff_buffers_[i]->count() * sizeof(Dtype);
+    }
+    bytes += batch_out_buffer_.count() * sizeof(Dtype);
+    bytes += tile_col_buffer_.count() * sizeof(Dtype);
+    bytes += tile_out_buffer_.count() * sizeof(Dtype);
+    return bytes;
+  }
+
+  // Folds an in-place ReLU that immediately follows this layer into its
+  // output epilogue: bias-add and max(0, x) then run in the same pass
+  // over the output instead of two more full passes. Set by Net::Init,
+  // which drops the fused ReLU layer from its forward schedule.
+  void set_fused_relu(bool fuse) { fused_relu_ = fuse; }
+
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
   // we just called weight_cpu_gemm with the same input.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
+  // Variant taking an explicit column buffer, so batch items can run on
+  // concurrent threads; see forward_cpu_batch.
+  void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
+      Dtype* output, Blob<Dtype>* col_buffer, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // Applies the output epilogue to one image: bias-add (when bias is
+  // non-NULL) and, if a following ReLU was fused, max(0, x), in a single
+  // pass over the output.
+  void forward_cpu_epilogue(Dtype* output, const Dtype* bias);
+  // Runs forward_cpu_gemm, plus forward_cpu_bias when bias is non-NULL,
+  // over a whole batch, split across ConvolutionParameter.forward_threads
+  // threads with a column buffer per thread.
+  void forward_cpu_batch(const Dtype* bottom_data, const Dtype* weights,
+      const Dtype* bias, Dtype* top_data);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
+  // Strip-mined variant of backward_cpu_gemm used when the full column
+  // buffer would exceed ConvolutionParameter.col_buffer_max_size: runs
+  // GEMM + col2im over strips of whole column-grid rows with a bounded
+  // workspace. 2D only; see backward_cpu_gemm for the dispatch.
+  void backward_cpu_gemm_tiled(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  // Variant taking an explicit column buffer; see backward_cpu_batch.
+  // Unlike the two-argument form it never strip-mines.
+  void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
+      Dtype* output, Blob<Dtype>* col_buffer);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
+  // Variant taking an explicit column buffer; see backward_cpu_batch.
+  void weight_cpu_gemm(const Dtype* input, const Dtype* output,
+      Dtype* weights, Blob<Dtype>* col_buffer);
+  // Runs weight_cpu_gemm (when weight_diff is non-NULL) and
+  // backward_cpu_gemm (when bottom_diff is non-NULL) over a whole batch,
+  // split across the same forward_threads worker pool as
+  // forward_cpu_batch. Per-image bottom diffs are disjoint, but every
+  // image accumulates into the one weight gradient, so each worker gets
+  // a private zeroed partial and a tree reduction folds the partials
+  // into weight_diff at the end.
+  void backward_cpu_batch(const Dtype* top_diff, const Dtype* bottom_data,
+      const Dtype* weights, Dtype* weight_diff, Dtype* bottom_diff);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
 
 #ifndef CPU_ONLY
@@ -74,6 +143,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   Blob<int> conv_input_shape_;
   /// @brief The spatial dimensions of the col_buffer.
   vector<int> col_buffer_shape_;
+  /// int8 forward state (quant_param); calibrated in forward_cpu_batch,
+  /// consumed per image in forward_cpu_gemm.
+  QuantState<Dtype> quant_;
   /// @brief The spatial dimensions of the output.
   vector<int> output_shape_;
   const vector<int>* bottom_shape_;
@@ -84,8 +156,14 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   int channel_axis_;
   int num_;
+  int forward_threads_;
+  // Whether a following in-place ReLU was folded into the output
+  // epilogue; see set_fused_relu.
+  bool fused_relu_;
   int channels_;
   int group_;
+  // Byte bound on the CPU col2im column buffer; 0 means unbounded.
+  size_t col_buffer_max_size_;
   int out_spatial_dim_;
   int weight_offset_;
   int num_output_;
@@ -134,7 +212,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           dilation_.cpu_data()[0], dilation_.cpu_data()[1], col_buff);
     } else {
       im2col_nd_gpu(data, num_spatial_axes_, num_kernels_im2col_,
-          conv_input_shape_.gpu_data(), col_buffer_.gpu_shape(),
+          conv_input_shape_.gpu_data(), col_buffer()->gpu_shape(),
           kernel_shape_.gpu_data(), pad_.gpu_data(),
           stride_.gpu_data(), dilation_.gpu_data(), col_buff);
     }
@@ -149,7 +227,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           dilation_.cpu_data()[0], dilation_.cpu_data()[1], data);
     } else {
       col2im_nd_gpu(col_buff, num_spatial_axes_, num_kernels_col2im_,
-          conv_input_shape_.gpu_data(), col_buffer_.gpu_shape(),
+          conv_input_shape_.gpu_data(), col_buffer()->gpu_shape(),
           kernel_shape_.gpu_data(), pad_.gpu_data(), stride_.gpu_data(),
           dilation_.gpu_data(), data);
     }
@@ -165,7 +243,58 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int col_offset_;
   int output_offset_;
 
+  // Batch slice handled by one forward_cpu_batch thread; worker 0 runs on
+  // the calling thread and reuses col_buffer_.
+  void ForwardWorker(const Dtype* bottom_data, const Dtype* weights,
+      const Dtype* bias, Dtype* top_data, int worker, int num_workers);
+
+  // Batch slice handled by one backward_cpu_batch thread; worker 0 runs
+  // on the calling thread and accumulates straight into the real weight
+  // diff, which already carries contributions from earlier passes.
+  void BackwardWorker(const Dtype* top_diff, const Dtype* bottom_data,
+      const Dtype* weights, Dtype* weight_diff, Dtype* bottom_diff,
+      int worker, int num_workers);
+
+  // True when the CPU backward-to-bottom pass must strip-mine its column
+  // buffer to respect col_buffer_max_size; see backward_cpu_gemm_tiled.
+  inline bool tiled_backward() const {
+    return !is_1x1_ && col_buffer_max_size_ > 0 &&
+        !force_nd_im2col_ && num_spatial_axes_ == 2 &&
+        static_cast<size_t>(kernel_dim_) * group_ * conv_out_spatial_dim_
+            * sizeof(Dtype) > col_buffer_max_size_;
+  }
+
+  // Whole-batch fast path for 1x1 convolutions: packs the input into one
+  // (channels, num * spatial) matrix and runs a single GEMM instead of
+  // num small ones; see forward_cpu_batch.
+  void forward_cpu_1x1_batch(const Dtype* bottom_data, const Dtype* weights,
+      const Dtype* bias, Dtype* top_data);
+
+  // The column buffer of the calling thread: the shared one, reshaped to
+  // this layer's needs, when a net injected it, otherwise col_buffer_.
+  inline Blob<Dtype>* col_buffer() {
+    if (shared_col_buffer_) {
+      shared_col_buffer_->Reshape(col_buffer_shape_);
+      return shared_col_buffer_.get();
+    }
+    return &col_buffer_;
+  }
+
   Blob<Dtype> col_buffer_;
+  shared_ptr<Blob<Dtype> > shared_col_buffer_;
+  // Strip-sized column buffer and packed right-hand side for
+  // backward_cpu_gemm_tiled, created lazily on the first tiled call.
+  Blob<Dtype> tile_col_buffer_;
+  Blob<Dtype> tile_out_buffer_;
+  // Output staging for the whole-batch 1x1 GEMM, scattered back to the
+  // top blob together with the bias/ReLU epilogue.
+  Blob<Dtype> batch_out_buffer_;
+  // Extra column buffers for forward_cpu_batch workers 1..N-1, created
+  // lazily on the first threaded forward (backward workers reuse them).
+  vector<shared_ptr<Blob<Dtype> > > col_buffers_;
+  // Weight-gradient partials for backward_cpu_batch workers 1..N-1,
+  // created lazily on the first threaded backward.
+  vector<shared_ptr<Blob<Dtype> > > weight_diff_buffers_;
   Blob<Dtype> bias_multiplier_;
 };
 
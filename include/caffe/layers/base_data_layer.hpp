@@ -1,6 +1,7 @@
 #ifndef CAFFE_DATA_LAYERS_HPP_
 #define CAFFE_DATA_LAYERS_HPP_
 
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -45,10 +46,64 @@ class BaseDataLayer : public Layer<Dtype> {
   bool output_labels_;
 };
 
+/**
+ * @brief Snapshot of one data layer's prefetch pipeline activity, exported
+ *        through Net::prefetch_stats().
+ *
+ * Counters are cumulative since layer setup; queue depths are sampled when
+ * the snapshot is taken. The counters are written by the prefetch and
+ * forward threads without synchronization, so treat the values as
+ * monitoring-grade rather than exact.
+ */
+struct PrefetchStats {
+  PrefetchStats()
+      : batches_loaded(0), batches_consumed(0), producer_wait_us(0),
+        consumer_wait_us(0), read_us(0), transform_us(0),
+        free_queue_size(0), full_queue_size(0),
+        reader_free_size(-1), reader_full_size(-1) {}
+  /// The layer these numbers belong to.
+  string layer_name;
+  /// Batches finished by the prefetch thread(s) / consumed by Forward.
+  size_t batches_loaded, batches_consumed;
+  /// Microseconds the producer spent waiting for a free batch (prefetch
+  /// running ahead of the net) and the consumer waiting for a full one
+  /// (the net stalling on data).
+  double producer_wait_us, consumer_wait_us;
+  /// Microseconds the prefetch thread(s) spent reading/decoding source
+  /// data and transforming it, summed across threads. Zero for layers
+  /// that do not report the split.
+  double read_us, transform_us;
+  /// Prefetch queue depths at snapshot time.
+  size_t free_queue_size, full_queue_size;
+  /// DataReader queue depths at snapshot time, or -1 for layers that do
+  /// not read through a DataReader.
+  int reader_free_size, reader_full_size;
+};
+
 template <typename Dtype>
 class Batch {
  public:
   Blob<Dtype> data_, label_;
+  // Staging for the GPU transform engine: uint8 pixels, shaped num x
+  // channels x datum_height x datum_width (before cropping), and one
+  // (h_off, w_off, mirror) int triple per item, sampled on the prefetch
+  // thread. Left empty when transforms run on the CPU; then data_ alone
+  // travels. See TransformationParameter.engine.
+  Blob<unsigned char> raw_data_;
+  Blob<int> raw_params_;
+#ifndef CPU_ONLY
+  Batch() : copy_done_(NULL) {}
+  ~Batch() {
+    if (copy_done_ != NULL) {
+      cudaEventDestroy(copy_done_);
+    }
+  }
+  // Recorded on the prefetch copy stream after the async H2D push of data_.
+  // Consumers make their stream wait on it rather than having the producer
+  // block until the transfer finishes, so the copy of batch N+1 overlaps
+  // compute on batch N. Created lazily by the prefetch thread.
+  cudaEvent_t copy_done_;
+#endif
 };
 
 template <typename Dtype>
@@ -67,16 +122,57 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
-  // Prefetches batches (asynchronously if to GPU memory)
-  static const int PREFETCH_COUNT = 3;
+  // Fills a snapshot of the prefetch counters; subclasses add the depths
+  // of any queues they own (e.g. the DataReader's).
+  virtual void prefetch_stats(PrefetchStats* stats) const;
 
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Whether load_batch() may run on several prefetch threads at once.
+  // Layers whose load_batch touches shared state (single-consumer queue
+  // peeks, member staging blobs, unsynchronized RNGs or cursors) must
+  // leave this false; LayerSetUp then clamps prefetch_threads to 1 with
+  // a warning instead of silently corrupting batches.
+  virtual bool reentrant_load_batch() const { return false; }
+  // Body of each prefetch thread; pops free batches, loads them and
+  // releases them to prefetch_full_, in load order if requested.
+  void PrefetchLoop();
+  void PrefetchWorker(int device, Caffe::Brew mode, int rand_seed,
+      int solver_count, bool root_solver);
+  // Number of batches circulating through the free/full queues, which also
+  // bounds their lock-free rings.
+  static size_t prefetch_queue_capacity(const LayerParameter& param);
+
+  /**
+   Tracks load tickets so batches can be released in a deterministic order.
+   Defined in the .cpp to keep boost/thread.hpp out of headers, same as
+   BlockingQueue::sync.
+   */
+  class Order;
+  /**
+   Holds one transform staging blob per prefetch thread, so load_batch
+   implementations that stage through a scratch blob stay reentrant with
+   prefetch_threads > 1. Defined in the .cpp for the same reason as Order.
+   */
+  class TransformScratch;
+  // The calling thread's staging blob; the caller shapes it.
+  Blob<Dtype>* transform_scratch();
 
-  Batch<Dtype> prefetch_[PREFETCH_COUNT];
+  // Prefetched batches (pushed to GPU memory asynchronously if applicable).
+  // The queue depth and thread count come from DataParameter.
+  vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  int prefetch_threads_;
+  shared_ptr<Order> order_;
+  shared_ptr<TransformScratch> scratch_;
+
+  // Cumulative prefetch counters, see PrefetchStats. Updated without
+  // synchronization by the producer and consumer threads.
+  size_t batches_loaded_, batches_consumed_;
+  double producer_wait_us_, consumer_wait_us_;
+  double read_us_, transform_us_;
 
   Blob<Dtype> transformed_data_;
 };
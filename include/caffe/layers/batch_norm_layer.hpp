@@ -63,17 +63,19 @@ class BatchNormLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  Blob<Dtype> mean_, variance_, temp_, x_norm_;
+  Blob<Dtype> mean_, variance_, inv_std_;
+  // Normalized output, cached only when the layer runs in place during
+  // training: there the backward cannot recompute it because the forward
+  // overwrote bottom. In every other configuration the backward rebuilds
+  // it on the fly from the intact bottom and the channel statistics.
+  Blob<Dtype> x_norm_;
+  // 2 x channels scratch holding the per-channel top-diff reductions
+  // sum(dE/dY) and sum(dE/dY . Y) computed in Backward.
+  Blob<Dtype> channel_sums_;
   bool use_global_stats_;
   Dtype moving_average_fraction_;
   int channels_;
   Dtype eps_;
-
-  // extra temporarary variables is used to carry out sums/broadcasting
-  // using BLAS
-  Blob<Dtype> batch_sum_multiplier_;
-  Blob<Dtype> num_by_chans_;
-  Blob<Dtype> spatial_sum_multiplier_;
 };
 
 }  // namespace caffe
@@ -92,8 +92,6 @@ class ContrastiveLossLayer : public LossLayer<Dtype> {
 
   Blob<Dtype> diff_;  // cached for backward pass
   Blob<Dtype> dist_sq_;  // cached for backward pass
-  Blob<Dtype> diff_sq_;  // tmp storage for gpu forward pass
-  Blob<Dtype> summer_vec_;  // tmp storage for gpu forward pass
 };
 
 }  // namespace caffe
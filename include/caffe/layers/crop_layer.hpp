@@ -31,6 +31,15 @@ class CropLayer : public Layer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 2; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
+  /**
+   * @brief True when the cropped region is one contiguous range of the
+   *        bottom -- the crop only trims axes outside the innermost
+   *        uncropped ones -- and sets *offset to the element offset of
+   *        the region start. Lets Net::WireZeroCopyViews alias the top
+   *        into the bottom so the copy is elided entirely.
+   */
+  bool contiguous_region(int* offset) const;
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -42,13 +51,21 @@ class CropLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
   vector<int> offsets;
+  // First axis, counting from the outside, whose trailing axes are all
+  // uncropped; set by Reshape. Axes from run_axis_ inward form one
+  // contiguous run per outer index.
+  int run_axis_;
+  // True when the whole cropped region is a single contiguous range of
+  // the bottom, starting at element region_offset_.
+  bool contiguous_;
+  int region_offset_;
 
  private:
+  // Copies the cropped region as whole contiguous runs: the axes inside
+  // run_axis_ are uncropped, so each run spans them all in one
+  // caffe_copy instead of a caffe_copy per innermost line.
   void crop_copy(const vector<Blob<Dtype>*>& bottom,
                const vector<Blob<Dtype>*>& top,
-               const vector<int>& offsets,
-               vector<int> indices,
-               int cur_dim,
                const Dtype* src_data,
                Dtype* dest_data,
                bool is_forward);
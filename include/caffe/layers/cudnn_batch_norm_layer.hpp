@@ -0,0 +1,65 @@
+#ifndef CAFFE_CUDNN_BATCH_NORM_LAYER_HPP_
+#define CAFFE_CUDNN_BATCH_NORM_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/batch_norm_layer.hpp"
+
+namespace caffe {
+
+#ifdef USE_CUDNN
+/**
+ * @brief cuDNN implementation of BatchNormLayer.
+ *
+ * Besides the three statistics blobs of BatchNormLayer, this layer owns a
+ * learned per-channel scale (blob 3, initialized to 1) and bias (blob 4,
+ * initialized to 0) which cuDNN fuses into the normalization, replacing
+ * the ScaleLayer usually stacked on top of BatchNorm.
+ *
+ * cuDNN maintains true running averages, so blob 2 (the renormalization
+ * counter of the CAFFE engine) is pinned to 1; snapshots written by either
+ * engine load into the other.
+ */
+template <typename Dtype>
+class CuDNNBatchNormLayer : public BatchNormLayer<Dtype> {
+ public:
+  explicit CuDNNBatchNormLayer(const LayerParameter& param)
+      : BatchNormLayer<Dtype>(param), handles_setup_(false) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual ~CuDNNBatchNormLayer();
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Scales the stored statistics by 1 / blob 2 and pins the counter to 1,
+  // converting snapshots written by the CAFFE engine into the running-
+  // average form cuDNN updates in place.
+  void ConvertLegacyStats();
+
+  bool handles_setup_;
+  cudnnHandle_t handle_;
+  cudnnTensorDescriptor_t bottom_desc_, top_desc_;
+  cudnnTensorDescriptor_t scale_bias_desc_;
+  // Original input (data) and staged top diff (diff) for the in-place
+  // case: the cuDNN backward needs X, which an in-place forward overwrote.
+  Blob<Dtype> save_bottom_;
+};
+#endif
+
+}  // namespace caffe
+
+#endif  // CAFFE_CUDNN_BATCH_NORM_LAYER_HPP_
@@ -1,6 +1,8 @@
 #ifndef CAFFE_CUDNN_CONV_LAYER_HPP_
 #define CAFFE_CUDNN_CONV_LAYER_HPP_
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -37,12 +39,43 @@ class CuDNNConvolutionLayer : public ConvolutionLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual ~CuDNNConvolutionLayer();
 
+  // Adds the cuDNN workspace bytes this layer has reserved from the
+  // shared per-device pool on top of the base-class buffers.
+  virtual size_t scratch_memory() const {
+    return ConvolutionLayer<Dtype>::scratch_memory() + workspaceSizeInBytes;
+  }
+
  protected:
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // One fully configured set of per-shape cuDNN state. Buckets are kept
+  // per input shape so nets with dynamic inputs switch between shapes
+  // they have already seen in O(1) instead of redoing descriptor setup,
+  // algorithm selection and workspace sizing on every reshape (see
+  // ConvolutionParameter::cudnn_shape_buckets).
+  struct ShapeBucket {
+    ShapeBucket() : max_workspace(0) {}
+    vector<cudnnTensorDescriptor_t> bottom_descs, top_descs;
+    vector<cudnnConvolutionDescriptor_t> conv_descs;
+    vector<cudnnConvolutionFwdAlgo_t> fwd_algo;
+    vector<cudnnConvolutionBwdFilterAlgo_t> bwd_filter_algo;
+    vector<cudnnConvolutionBwdDataAlgo_t> bwd_data_algo;
+    vector<size_t> fwd_ws, bwd_filter_ws, bwd_data_ws;
+    size_t max_workspace;  // largest per-stream workspace request
+  };
+
+  // Configures a fresh bucket for the current input shape: descriptors,
+  // benchmarked algorithms and workspace requests.
+  void BuildBucket(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, ShapeBucket* bucket);
+  // Points the active descriptor/algorithm arrays at a bucket and
+  // re-reserves the shared workspace for its size.
+  void InstallBucket(const ShapeBucket& bucket);
+  static void DestroyBucket(ShapeBucket* bucket);
+
   bool handles_setup_;
   cudnnHandle_t* handle_;
   cudaStream_t*  stream_;
@@ -61,9 +94,17 @@ class CuDNNConvolutionLayer : public ConvolutionLayer<Dtype> {
   size_t *workspace_fwd_sizes_;
   size_t *workspace_bwd_data_sizes_;
   size_t *workspace_bwd_filter_sizes_;
-  size_t workspaceSizeInBytes;  // size of underlying storage
-  void *workspaceData;  // underlying storage
+  size_t workspaceSizeInBytes;  // bytes reserved from the device pool
+  void *workspaceData;  // borrowed from the shared per-device workspace
   void **workspace;  // aliases into workspaceData
+  int workspace_device_;  // device whose shared workspace we hold a ref on
+  map<string, ShapeBucket> shape_buckets_;
+  string active_shape_;  // shape key of the installed bucket
+#if CUDNN_VERSION_MIN(5, 0, 0)
+  // ReLU descriptor for the fused conv+bias+activation epilogue; only
+  // created when Net::Init folded a following ReLU into this layer.
+  cudnnActivationDescriptor_t activ_desc_;
+#endif
 };
 #endif
 
@@ -27,11 +27,18 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 0; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline int MaxTopBlobs() const { return 2; }
+  // Runs the transform on the device when the GPU engine is selected,
+  // otherwise defers to the base implementation.
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // Adds the DataReader queue depths to the base snapshot.
+  virtual void prefetch_stats(PrefetchStats* stats) const;
 
  protected:
   virtual void load_batch(Batch<Dtype>* batch);
 
   DataReader reader_;
+  bool use_gpu_transform_;
 };
 
 }  // namespace caffe
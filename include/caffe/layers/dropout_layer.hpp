@@ -32,7 +32,7 @@ class DropoutLayer : public NeuronLayer<Dtype> {
    *     Sets the probability @f$ p @f$ that any given unit is dropped.
    */
   explicit DropoutLayer(const LayerParameter& param)
-      : NeuronLayer<Dtype>(param) {}
+      : NeuronLayer<Dtype>(param), gpu_mask_(NULL) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -68,6 +68,8 @@ class DropoutLayer : public NeuronLayer<Dtype> {
 
   /// when divided by UINT_MAX, the randomly generated values @f$u\sim U(0,1)@f$
   Blob<unsigned int> rand_vec_;
+  /// this iteration's mask slice from the GPU-side DropoutMaskPool
+  const unsigned int* gpu_mask_;
   /// the probability @f$ p @f$ of dropping any input
   Dtype threshold_;
   /// the scale for undropped inputs at train time @f$ 1 / (1 - p) @f$
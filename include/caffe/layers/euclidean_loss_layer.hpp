@@ -100,6 +100,8 @@ class EuclideanLossLayer : public LossLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
   Blob<Dtype> diff_;
+  /// Device-side scalar the fused GPU forward reduces into.
+  Blob<Dtype> sumsq_;
 };
 
 }  // namespace caffe
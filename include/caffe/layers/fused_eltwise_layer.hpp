@@ -0,0 +1,94 @@
+#ifndef CAFFE_FUSED_ELTWISE_LAYER_HPP_
+#define CAFFE_FUSED_ELTWISE_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Evaluates a chain of parameterless element-wise layers in a
+ *        single pass over memory.
+ *
+ * A chain like Eltwise(SUM) -> ReLU -> Power is memory bound: run as
+ * separate layers each stage is a full read-modify-write round trip
+ * through the activation blob. This layer interprets the chain per
+ * element instead -- one load of each bottom, the whole op pipeline in
+ * registers, one store -- so the chain costs a single round trip no
+ * matter its length.
+ *
+ * Instances are synthesized by Net::CompileNet at TEST time from the
+ * LayerParameters of the layers they replace (see
+ * FusedEltwiseParameter); the supported stages are an optional Eltwise
+ * head followed by any sequence of ReLU, Power, TanH, Sigmoid and
+ * AbsVal. Backward is not implemented: fusion only happens on nets
+ * that never run it.
+ */
+template <typename Dtype>
+class FusedEltwiseLayer : public Layer<Dtype> {
+ public:
+  explicit FusedEltwiseLayer(const LayerParameter& param)
+      : Layer<Dtype>(param), head_op_(-1) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "FusedEltwise"; }
+  virtual inline int MinBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+  /// Stage opcodes; head_op_ additionally uses the
+  /// EltwiseParameter_EltwiseOp values, or -1 for a unary chain.
+  enum UnaryOp {
+    RELU = 0,
+    POWER = 1,
+    TANH = 2,
+    SIGMOID = 3,
+    ABSVAL = 4
+  };
+
+  /**
+   * @brief Whether a LayerParameter describes a stage this layer can
+   *        absorb; the head flag admits the multi-bottom Eltwise type.
+   *        Used by Net::CompileNet to recognize fusable chains.
+   */
+  static bool IsFusableStage(const LayerParameter& param, bool head);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    NOT_IMPLEMENTED;
+  }
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    NOT_IMPLEMENTED;
+  }
+
+  /// Eltwise head operation, or -1 if the chain starts unary.
+  int head_op_;
+  /// Eltwise SUM coefficients, one per bottom (all 1 by default).
+  vector<Dtype> coeffs_;
+  /// Unary pipeline: opcode plus up to three scalars per stage
+  /// (negative_slope for RELU; power, scale, shift for POWER).
+  vector<int> unary_ops_;
+  vector<Dtype> unary_params_;
+  /// Device-resident copies of the pipeline and the bottom data
+  /// pointers for the GPU kernel; refreshed in Reshape/Forward_gpu.
+  shared_ptr<SyncedMemory> gpu_ops_;
+  shared_ptr<SyncedMemory> gpu_params_;
+  shared_ptr<SyncedMemory> gpu_coeffs_;
+  shared_ptr<SyncedMemory> gpu_bottoms_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FUSED_ELTWISE_LAYER_HPP_
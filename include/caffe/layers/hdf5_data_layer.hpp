@@ -47,6 +47,10 @@ class HDF5DataLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void LoadHDF5FileData(const char* filename);
+  // Advances to the next row source once the current one is exhausted:
+  // the next streamed chunk in chunked mode, otherwise the next file
+  // (reloaded synchronously, as before). Resets current_row_.
+  void Next();
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
@@ -55,6 +59,15 @@ class HDF5DataLayer : public Layer<Dtype> {
   std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
   std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
+  /**
+   Loader thread for hdf5_data_param.chunk_rows > 0: reads fixed row
+   windows through hyperslab selections ahead of consumption, bounding
+   host memory by a couple of windows and hiding file transitions.
+   Defined in the .cpp to keep boost/thread.hpp out of headers, same as
+   BlockingQueue::sync.
+   */
+  class Stream;
+  shared_ptr<Stream> stream_;
 };
 
 }  // namespace caffe
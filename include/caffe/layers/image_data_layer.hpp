@@ -1,6 +1,10 @@
 #ifndef CAFFE_IMAGE_DATA_LAYER_HPP_
 #define CAFFE_IMAGE_DATA_LAYER_HPP_
 
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -11,6 +15,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/image_index.hpp"
 
 namespace caffe {
 
@@ -36,8 +41,40 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  // load_batch stages through per-thread scratch blobs (transform and
+  // decode), so it may run on several prefetch threads.
+  virtual bool reentrant_load_batch() const { return true; }
+#ifdef USE_OPENCV
+  // Reads one image through the configured decode engine, resized to
+  // new_height x new_width when set.
+  cv::Mat ReadImage(const std::string& filename);
+  /**
+   Holds one set of decode scratch buffers (file bytes, decoded image,
+   resized image) per prefetch thread, so the OpenCV read path stops
+   allocating per image. Defined in the .cpp for the same reason as
+   BasePrefetchingDataLayer::TransformScratch.
+   */
+  class DecodeScratch;
+  shared_ptr<DecodeScratch> decode_scratch_;
+#endif  // USE_OPENCV
+
+  // Entry lookup goes through order_, a permutation over the listing that
+  // is what ShuffleImages() reshuffles in place (32-bit Fisher-Yates)
+  // instead of swapping string pairs.
+  size_t num_images() const { return order_.size(); }
+  std::string image_path(size_t id) const {
+    const uint32_t entry = order_[id];
+    return use_index_ ? index_.path(entry) : lines_[entry].first;
+  }
+  int image_label(size_t id) const {
+    const uint32_t entry = order_[id];
+    return use_index_ ? index_.label(entry) : lines_[entry].second;
+  }
 
   vector<std::pair<std::string, int> > lines_;
+  ImageIndex index_;
+  bool use_index_;
+  vector<uint32_t> order_;
   int lines_id_;
 };
 
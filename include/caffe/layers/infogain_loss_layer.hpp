@@ -103,6 +103,10 @@ class InfogainLossLayer : public LossLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
   Blob<Dtype> infogain_;
+  /// Clamped element-wise log of the predictions, filled by one
+  /// vectorized pass in Forward and reduced per sample against the
+  /// matching H row.
+  Blob<Dtype> log_prob_;
 };
 
 }  // namespace caffe
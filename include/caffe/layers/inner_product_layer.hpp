@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/quant.hpp"
 
 namespace caffe {
 
@@ -19,7 +20,7 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), sparse_checked_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -45,6 +46,14 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  QuantState<Dtype> quant_;  ///< int8 forward state (quant_param)
+  /// CSR form of pruned weights, built at the first CPU forward when the
+  /// weight sparsity reaches inner_product_param.sparse_weight_threshold.
+  /// Empty row pointers mean the dense path is in use.
+  bool sparse_checked_;
+  vector<Dtype> sparse_val_;
+  vector<int> sparse_col_;
+  vector<int> sparse_row_ptr_;
 };
 
 }  // namespace caffe
@@ -55,12 +55,19 @@ class LRNLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void WithinChannelBackward(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief Fused cross-channel forward over one worker's share of
+  ///        (image, spatial block) units; the channel window sum slides
+  ///        incrementally inside each block.
+  void CrossChannelRegions(const Dtype* bottom_data, Dtype* scale_data,
+      Dtype* top_data, const int num_units, const int worker,
+      const int num_workers);
 
   int size_;
   int pre_pad_;
   Dtype alpha_;
   Dtype beta_;
   Dtype k_;
+  int forward_threads_;
   int num_;
   int channels_;
   int height_;
@@ -32,6 +32,16 @@ class MemoryDataLayer : public BaseDataLayer<Dtype> {
 #ifdef USE_OPENCV
   virtual void AddMatVector(const vector<cv::Mat>& mat_vector,
       const vector<int>& labels);
+  /**
+   * Queues 1..N items and returns immediately; a worker thread owned by
+   * the layer runs the transform and Forward swaps the batch in once
+   * the current data is consumed. For serving, where the request thread
+   * should not pay the transform cost and requests should not wait for
+   * a full batch. The mats are cloned, so callers may reuse them. Do
+   * not call concurrently with the synchronous Add methods.
+   */
+  virtual void AddMatVectorAsync(const vector<cv::Mat>& mat_vector,
+      const vector<int>& labels);
 #endif  // USE_OPENCV
 
   // Reset should accept const pointers, but can't, because the memory
@@ -56,6 +66,16 @@ class MemoryDataLayer : public BaseDataLayer<Dtype> {
   Blob<Dtype> added_data_;
   Blob<Dtype> added_label_;
   bool has_new_data_;
+  /**
+   Transform worker and queues behind AddMatVectorAsync, created on
+   first use. Defined in the .cpp to keep boost/thread.hpp out of
+   headers, same as BlockingQueue::sync.
+   */
+  class Async;
+  shared_ptr<Async> async_;
+  // The async batch currently exposed through data_/labels_, kept alive
+  // until the next one is swapped in.
+  shared_ptr<Blob<Dtype> > async_data_, async_label_;
 };
 
 }  // namespace caffe
@@ -44,6 +44,12 @@ class PoolingLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // Pools the given strided subset of the (num, channel) planes; the CPU
+  // forward pass splits the planes across forward_threads workers.
+  void ForwardPlanes(const Dtype* bottom_data, Dtype* top_data, int* mask,
+      unsigned char* off_mask, Dtype* top_mask, const int num_planes,
+      const int worker, const int num_workers);
+
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
   int pad_h_, pad_w_;
@@ -51,8 +57,17 @@ class PoolingLayer : public Layer<Dtype> {
   int height_, width_;
   int pooled_height_, pooled_width_;
   bool global_pooling_;
+  int forward_threads_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  // Per-output-row/column pooling window extents, clamped once at Reshape
+  // time so the CPU loops skip the per-element min/max index math; the
+  // *span* tables keep the padded extent that AVE pooling divides by.
+  vector<int> win_hstart_, win_hend_, win_hspan_;
+  vector<int> win_wstart_, win_wend_, win_wspan_;
+  // In-window argmax for the CPU MAX backward pass: one byte per output
+  // element instead of max_idx_'s int, for kernels of up to 256 taps.
+  vector<unsigned char> max_off_;
 };
 
 }  // namespace caffe
@@ -91,8 +91,7 @@ class PReLULayer : public NeuronLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
   bool channel_shared_;
-  Blob<Dtype> multiplier_;  // dot multiplier for backward computation of params
-  Blob<Dtype> backward_buff_;  // temporary buffer for backward computation
+  Blob<Dtype> param_buff_;  // per-block partial sums for parameter backward
   Blob<Dtype> bottom_memory_;  // memory for in-place computation
 };
 
@@ -10,6 +10,22 @@ namespace bp = boost::python;
 
 namespace caffe {
 
+// Scoped GIL re-acquisition for callbacks into Python. The pycaffe
+// bindings release the GIL around whole-net calls (see _caffe.cpp), so
+// a thread about to run Python layer code must take it back first.
+class PyGILAcquire {
+ public:
+  PyGILAcquire() : state_(PyGILState_Ensure()) {}
+  ~PyGILAcquire() { PyGILState_Release(state_); }
+
+ private:
+  PyGILState_STATE state_;
+};
+
+// Note for data-producing layers: the callbacks below hold the GIL, so
+// heavy Python-side augmentation serializes with the rest of the
+// process. caffe.BatchPool (python/caffe/batch_pool.py) moves the
+// batch production into forked workers with shared-memory transport.
 template <typename Dtype>
 class PythonLayer : public Layer<Dtype> {
  public:
@@ -24,12 +40,14 @@ class PythonLayer : public Layer<Dtype> {
         && !ShareInParallel()) {
       LOG(FATAL) << "PythonLayer is not implemented in Multi-GPU training";
     }
+    PyGILAcquire gil;
     self_.attr("param_str") = bp::str(
         this->layer_param_.python_param().param_str());
     self_.attr("setup")(bottom, top);
   }
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    PyGILAcquire gil;
     self_.attr("reshape")(bottom, top);
   }
 
@@ -42,10 +60,12 @@ class PythonLayer : public Layer<Dtype> {
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    PyGILAcquire gil;
     self_.attr("forward")(bottom, top);
   }
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    PyGILAcquire gil;
     self_.attr("backward")(top, propagate_down, bottom);
   }
 
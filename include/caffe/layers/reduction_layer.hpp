@@ -50,8 +50,6 @@ class ReductionLayer : public Layer<Dtype> {
   int num_;
   /// @brief the input size of each reduction
   int dim_;
-  /// @brief a helper Blob used for summation (op_ == SUM)
-  Blob<Dtype> sum_multiplier_;
 };
 
 }  // namespace caffe
@@ -36,6 +36,11 @@ class SoftmaxLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  /// @brief Blocked CPU forward that gathers each spatial position's channel
+  ///        vector into a contiguous tile; used when inner_num_ is large.
+  void forward_cpu_blocked(const int channels, const Dtype* bottom_data,
+      Dtype* top_data);
+
   int outer_num_;
   int inner_num_;
   int softmax_axis_;
@@ -43,6 +48,8 @@ class SoftmaxLayer : public Layer<Dtype> {
   Blob<Dtype> sum_multiplier_;
   /// scale is an intermediate Blob to hold temporary results.
   Blob<Dtype> scale_;
+  /// holds one position-major tile for the blocked CPU engine.
+  Blob<Dtype> tile_buffer_;
 };
 
 }  // namespace caffe
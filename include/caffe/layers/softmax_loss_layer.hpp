@@ -106,11 +106,23 @@ class SoftmaxWithLossLayer : public LossLayer<Dtype> {
   /// all outputs are assumed to be valid.
   virtual Dtype get_normalizer(
       LossParameter_NormalizationMode normalization_mode, int valid_count);
+  /// @brief Fused log-sum-exp forward/backward used when top.size() == 1.
+  void forward_cpu_fused(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  void backward_cpu_fused(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom);
 
   /// The internal SoftmaxLayer used to map predictions to a distribution.
   shared_ptr<Layer<Dtype> > softmax_layer_;
   /// prob stores the output probability predictions from the SoftmaxLayer.
+  /// Never materialized when the fused engine is active.
   Blob<Dtype> prob_;
+  /// Caches the per-position log-sum-exp of the fused forward so the fused
+  /// backward can rebuild the softmax gradient without a prob blob.
+  Blob<Dtype> lse_;
+  /// Fused log-sum-exp engine: active when no top wants the probabilities,
+  /// so the (outer, channels, inner) prob blob is never allocated.
+  bool fused_;
   /// bottom vector holder used in call to the underlying SoftmaxLayer::Forward
   vector<Blob<Dtype>*> softmax_bottom_vec_;
   /// top vector holder used in call to the underlying SoftmaxLayer::Forward
@@ -0,0 +1,49 @@
+#ifndef CAFFE_TEMPORAL_CONV_LAYER_HPP_
+#define CAFFE_TEMPORAL_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Convolves 1-D (Kx1 or 1xK) kernels directly, without the im2col
+ *        column buffer.
+ *
+ *   The generic im2col path treats a 1-D kernel as degenerate 2-D and
+ *   rewrites the input K times with strided access before the GEMM even
+ *   starts. This engine instead accumulates each output plane with
+ *   per-tap loops that stay contiguous along the time axis, so temporal
+ *   (audio-style) models read the input once per output channel.
+ *
+ *   Supports 2D shapes where exactly one kernel axis is 1 and that axis
+ *   has stride 1 and no padding; the time axis may use any stride,
+ *   padding and dilation. Any other shape, and Backward, fall back to
+ *   the im2col path of ConvolutionLayer. Selected through
+ *   ConvolutionParameter.engine = TEMPORAL, or automatically by the
+ *   layer factory when the parameters match.
+ */
+template <typename Dtype>
+class TemporalConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit TemporalConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // Whether the configured shapes allow the 1-D path; set in Reshape.
+  bool use_temporal_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_TEMPORAL_CONV_LAYER_HPP_
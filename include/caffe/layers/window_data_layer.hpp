@@ -36,6 +36,16 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
  protected:
   virtual unsigned int PrefetchRand();
   virtual void load_batch(Batch<Dtype>* batch);
+#ifdef USE_OPENCV
+  // Crops, warps, and writes one sampled window into the batch buffer.
+  void ProcessWindow(const vector<float>& window, const cv::Mat& cv_img,
+      bool do_mirror, const Dtype* mean, int item_id, Dtype* top_data);
+  // Worker for crop_threads > 1: processes items first, first + stride,
+  // first + 2 * stride, ... so each batch slot is written exactly once.
+  void CropWorker(const vector<vector<float> >* windows,
+      const vector<cv::Mat>* images, const vector<bool>* mirrors,
+      const Dtype* mean, int first, int stride, Dtype* top_data);
+#endif  // USE_OPENCV
 
   shared_ptr<Caffe::RNG> prefetch_rng_;
   vector<std::pair<std::string, vector<int> > > image_database_;
@@ -48,6 +58,13 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
   bool has_mean_values_;
   bool cache_images_;
   vector<std::pair<std::string, Datum > > image_database_cache_;
+  /**
+   LRU cache of decoded images for decoded_cache_size_mb > 0, so hot
+   images skip the JPEG decode that otherwise dominates load_batch.
+   Defined in the .cpp to keep OpenCV types out of the header.
+   */
+  class DecodedCache;
+  shared_ptr<DecodedCache> decoded_cache_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,62 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Convolves 3x3 stride-1 inputs with the Winograd F(2x2,3x3)
+ *        minimal filtering algorithm.
+ *
+ *   Each 2x2 output tile costs 16 multiplies per input channel instead of
+ *   the 36 the im2col+GEMM path spends, a 2.25x reduction. The input is
+ *   transformed tile by tile into 16 [channels x tiles] matrices, the 16
+ *   per-frequency products run as GEMMs against the transformed weights,
+ *   and the inverse transform writes the output tiles back.
+ *
+ *   The transformed weights are cached: computed once on the first
+ *   Forward in TEST phase (after any pretrained weights have been
+ *   loaded), and refreshed every pass in TRAIN phase since the solver
+ *   updates the weights in place. Unsupported shapes (anything but 2D
+ *   3x3, stride 1, dilation 1) and Backward fall back to the im2col path;
+ *   so does Forward_gpu, where cuDNN already provides Winograd kernels.
+ *
+ *   Selected through ConvolutionParameter.engine = WINOGRAD.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), weights_transformed_(false) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // Fills weight_wino_ with G w G^T of every filter, laid out as 16
+  // [num_output x channels/group] matrices ready for the tile GEMMs.
+  void TransformWeights();
+
+  // Whether the configured shapes allow the Winograd path; set in Reshape.
+  bool use_winograd_;
+  bool weights_transformed_;
+  // Transformed weights, (16, num_output, channels / group).
+  Blob<Dtype> weight_wino_;
+  // Transformed input tiles, (16, channels / group, tiles), and the
+  // per-frequency GEMM outputs, (16, num_output / group, tiles).
+  Blob<Dtype> input_wino_;
+  Blob<Dtype> output_wino_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
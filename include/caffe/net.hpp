@@ -11,9 +11,23 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/flat_weights.hpp"
+#include "caffe/util/shared_weights.hpp"
+
+/**
+ Forward declare the boost synchronization types instead of including
+ boost/thread.hpp to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost {
+class mutex;
+class condition_variable;
+}
 
 namespace caffe {
 
+struct PrefetchStats;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -23,19 +37,51 @@ namespace caffe {
 template <typename Dtype>
 class Net {
  public:
-  explicit Net(const NetParameter& param, const Net* root_net = NULL);
+  /// With share_params_from set, every layer shares the matching (by
+  /// name) layer's param storage from the moment it is set up, instead
+  /// of allocating its own copy for ShareTrainedLayersWith to discard
+  /// later; used for the test nets that mirror a solver's train net.
+  explicit Net(const NetParameter& param, const Net* root_net = NULL,
+      const Net* share_params_from = NULL);
   explicit Net(const string& param_file, Phase phase,
       const Net* root_net = NULL);
-  virtual ~Net() {}
+  virtual ~Net();
 
   /// @brief Initialize a network with a NetParameter.
   void Init(const NetParameter& param);
 
+  /**
+   * @brief Invoked after each layer finishes during Backward, from the
+   *        top of the net down. Lets a gradient reducer start work on a
+   *        layer's params while the layers below it still compute, so
+   *        communication overlaps the rest of the backward pass.
+   */
+  class Callback {
+   public:
+    virtual void run(int layer) = 0;
+   protected:
+    virtual ~Callback() {}
+  };
+  const vector<Callback*>& after_backward() const { return after_backward_; }
+  void add_after_backward(Callback* value) {
+    after_backward_.push_back(value);
+  }
+
   /**
    * @brief Run Forward and return the result.
    *
    */
   const vector<Blob<Dtype>*>& Forward(Dtype* loss = NULL);
+  /**
+   * @brief Trimmed Forward for deploy nets that only want the output
+   *        blobs: no per-layer loss accumulation and no debug-info
+   *        bookkeeping on the hot path. Falls back to Forward() when
+   *        debugging or profiling is enabled so those still observe
+   *        every pass. Building with CAFFE_RELEASE_CHECKS defined
+   *        additionally elides the hot-path range CHECKs in
+   *        ForwardFromTo for release-serving binaries.
+   */
+  const vector<Blob<Dtype>*>& ForwardInference();
   /// @brief DEPRECATED; use Forward() instead.
   const vector<Blob<Dtype>*>& ForwardPrefilled(Dtype* loss = NULL) {
     LOG_EVERY_N(WARNING, 1000) << "DEPRECATED: ForwardPrefilled() "
@@ -54,6 +100,13 @@ class Net {
   Dtype ForwardFromTo(int start, int end);
   Dtype ForwardFrom(int start);
   Dtype ForwardTo(int end);
+  /**
+   * @brief Run only the layers the requested blobs depend on, in
+   *        topological order, skipping everything downstream -- e.g.
+   *        feature extraction can stop at an embedding blob instead of
+   *        paying for the classifier head.
+   */
+  Dtype ForwardTo(const vector<string>& blob_names);
   /// @brief DEPRECATED; set input blobs then use Forward() instead.
   const vector<Blob<Dtype>*>& Forward(const vector<Blob<Dtype>* > & bottom,
       Dtype* loss = NULL);
@@ -82,6 +135,18 @@ class Net {
    */
   void Reshape();
 
+  /**
+   * @brief Pay all first-iteration costs up front: propagates shapes,
+   *        faults in every blob allocation on the side the current mode
+   *        computes on (diffs too for TRAIN nets), then runs one dummy
+   *        forward so cuDNN algorithm selection and workspace
+   *        reservation happen now instead of on the first real request.
+   *
+   * Note that the dummy forward consumes one batch from any prefetching
+   * data layer, like any other Forward call.
+   */
+  void Warmup();
+
   Dtype ForwardBackward() {
     Dtype loss;
     Forward(&loss);
@@ -91,6 +156,16 @@ class Net {
 
   /// @brief Updates the network weights based on the diff values computed.
   void Update();
+  /**
+   * @brief Scales the gradient every backward pass seeds at the loss
+   *        layers by rewriting their stored loss multipliers.
+   *
+   * With iter_size accumulation the solver sets this to 1/iter_size, so
+   * param diffs accumulate pre-normalized and no separate rescaling
+   * sweep over the gradients is needed. The loss each Forward reports
+   * is scaled the same way. Idempotent and cheap when unchanged.
+   */
+  void set_loss_scale(Dtype scale);
   /**
    * @brief Shares weight data of owner blobs with shared blobs.
    *
@@ -111,13 +186,120 @@ class Net {
    *        another Net.
    */
   void CopyTrainedLayersFrom(const NetParameter& param);
+  /// @brief Copy one source layer's pre-trained blobs into the matching
+  ///        (or fold-target) layer of this net.
+  void CopyTrainedLayerFrom(const LayerParameter& source_layer);
   void CopyTrainedLayersFrom(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
+  /**
+   * @brief Maps a flat weight file (FlatWeights) and points the params
+   *        at the mapping instead of copying, for fast cold start of
+   *        inference processes. Read-only: not for nets that train.
+   */
+  void CopyTrainedLayersFromFlat(const string trained_filename);
+  /**
+   * @brief Loads a delta snapshot (Solver snapshot_delta): reads the
+   *        full base snapshot it names, applies the quantized per-blob
+   *        differences, and copies the reconstructed weights in.
+   */
+  void CopyTrainedLayersFromDelta(const string trained_filename);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Points the learnable params at a weight segment a training
+   *        process publishes (SolverParameter.share_weights_shm):
+   *        zero-copy continuous evaluation with no snapshot files.
+   *
+   * In GPU mode call this again before each evaluation pass so the
+   * cached device copies of the params are refreshed; use
+   * shared_weights()->generation() around a pass to confirm the
+   * publisher did not update mid-evaluation.
+   */
+  void MapSharedWeights(const string& shm_name);
+  /**
+   * @brief Loads trained weights through a file-backed shared mapping so
+   *        every worker process on the machine shares one physical copy.
+   *
+   * The first caller wins a cache file next to the model, deserializes
+   * the .caffemodel once and publishes the flattened learnable params
+   * into it; the rest skip deserialization and map the cache read-only.
+   * Intended for fleets of identical CPU inference processes, where
+   * per-process CopyTrainedLayersFrom would hold one copy each.
+   */
+  void CopyTrainedLayersFromShared(const string& trained_filename);
+  /// Points the learnable params into an already mapped segment.
+  void MapSharedWeightsSegment(
+      const shared_ptr<SharedWeights<Dtype> >& segment);
+  const shared_ptr<SharedWeights<Dtype> >& shared_weights() const {
+    return shared_weights_;
+  }
+  /// Earliest layer consuming each learnable param; pairs with the
+  /// overlapped update events below.
+  const vector<int>& learnable_param_layer_ids() const {
+    return learnable_param_layer_ids_;
+  }
+#ifndef CPU_ONLY
+  /**
+   * @brief Creates the per-layer events the solver records as it
+   *        updates each layer's params on a side stream
+   *        (SolverParameter.overlapped_update); ForwardFromTo then
+   *        orders every layer's kernels after its event, so early
+   *        layers start the next batch while late params still update.
+   */
+  void EnableUpdateEvents();
+  cudaEvent_t update_event(int layer_id) const {
+    return update_events_[layer_id];
+  }
+#endif
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
+  /**
+   * @brief Snapshots the prefetch pipeline counters of every data layer in
+   *        the net; see PrefetchStats. Empty if the net has none.
+   */
+  vector<PrefetchStats> prefetch_stats() const;
+  /// Percentile summary (milliseconds) of one layer's recent forward
+  /// and backward times; see layer_timings().
+  struct LayerTiming {
+    string name;
+    int forward_samples, backward_samples;
+    float forward_p50, forward_p90, forward_max;
+    float backward_p50, backward_p90, backward_max;
+  };
+  /**
+   * @brief Snapshots per-layer timing statistics over the recent
+   *        iteration window (NetParameter.profile_layers); empty when
+   *        profiling is off. Harvesting completed samples is the only
+   *        synchronization-free work the hot path does.
+   */
+  vector<LayerTiming> layer_timings();
+  /// Logs the timing table; the solver calls this when a signal
+  /// action arrives, so a SIGHUP dumps the profile of a live run.
+  void LogLayerTimings();
+  bool profiling() const { return profile_layers_; }
+  /// Toggles layer profiling at runtime (the solver wires this to
+  /// SIGUSR2); sizes the sample rings on first enable.
+  void set_profiling(const bool value);
+  /**
+   * @brief Returns a per-layer breakdown of the net's memory use --
+   *        activation blobs, parameters and layer scratch buffers such
+   *        as column buffers and cuDNN workspaces -- plus totals and
+   *        how many bytes are currently resident on the host and the
+   *        device. One line per layer, suitable for logging.
+   */
+  string memory_report() const;
+  /**
+   * @brief Toggles asynchronous scalar loss readback (GPU mode only).
+   *        When enabled, loss layers accumulate their weighted losses
+   *        into device slots and Forward returns the previous
+   *        iteration's total -- a one-iteration display delay -- so the
+   *        pipeline never stalls just to fetch a number for logging.
+   */
+  void set_async_loss(bool async_loss);
   /// @brief Writes the net to an HDF5 file.
-  void ToHDF5(const string& filename, bool write_diff = false) const;
+  /// @brief Writes the net's params to an HDF5 file; deflate > 0 stores
+  ///        the datasets chunked and compressed at that level (1-9).
+  void ToHDF5(const string& filename, bool write_diff = false,
+      int deflate = 0) const;
 
   /// @brief returns the network name.
   inline const string& name() const { return name_; }
@@ -179,6 +361,12 @@ class Net {
   }
   /// @brief returns the learnable parameter learning rate multipliers
   inline const vector<float>& params_lr() const { return params_lr_; }
+  /// @brief whether each learnable param ever receives a gradient; false
+  ///        for frozen (lr_mult 0) and loss-unreachable params, whose
+  ///        diff blobs are then never touched and never allocate.
+  inline const vector<bool>& learnable_param_need_backward() const {
+    return learnable_param_need_backward_;
+  }
   inline const vector<bool>& has_params_lr() const { return has_params_lr_; }
   /// @brief returns the learnable parameter decay multipliers
   inline const vector<float>& params_weight_decay() const {
@@ -214,13 +402,105 @@ class Net {
   bool has_layer(const string& layer_name) const;
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
+  /**
+   * @brief Copies new parameter values into an existing layer in place,
+   *        on the device the current mode computes on.
+   *
+   * Shapes must match the layer's current blobs. Because layer blobs
+   * share storage with params_ (and with any sharing layers), the copy
+   * is visible everywhere without rebuilding the net -- the cheap path
+   * for services that periodically swap one layer's weights.
+   */
+  void ReplaceLayerParams(const string& layer_name,
+      const vector<shared_ptr<Blob<Dtype> > >& blobs);
+  /**
+   * @brief Splices a parameter-free element-wise layer into the net
+   *        without rerunning Init.
+   *
+   * The layer must name one bottom equal to its one top (in-place, e.g.
+   * ReLU or Dropout) on an existing blob; it is inserted after the last
+   * layer writing that blob and wired straight into the existing
+   * bottom/top bookkeeping. Not available while layer profiling,
+   * dataflow-parallel forward, overlapped updates or pooled activations
+   * are active, since their per-layer state is built by Init.
+   */
+  void InsertLayer(const LayerParameter& param);
+  /**
+   * @brief Removes a layer spliced as above (parameter-free, in-place);
+   *        the inverse of InsertLayer, with the same restrictions.
+   */
+  void RemoveLayer(const string& layer_name);
+
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /**
+   * @brief Emit the full debug info only every @p every iterations,
+   *        cheaply enough to leave on in production.
+   *
+   * On sampled iterations in GPU mode the per-blob asums are queued
+   * device-side and read back in one batch instead of one synchronizing
+   * reduction per blob. In between, a non-finite check kernel runs over
+   * every top blob each iteration as a canary; detections are reported
+   * on the next sampled iteration. Pass 0 to disable.
+   */
+  void set_debug_info_sample(const int every);
+
   // Helpers for Init.
   /**
    * @brief Remove layers that the user specified should be excluded given the current
    *        phase, level, and stage.
    */
+  /// @brief Remove foldable BatchNorm/Scale chains from a TEST-phase net
+  ///        and record where their parameters fold at load time.
+  void FoldBatchNorm(const NetParameter& param, NetParameter* param_fold);
+  /// @brief Back activation blobs with disjoint forward lifetimes by a
+  ///        shared buffer pool; TEST phase only, disables Backward.
+  void ShareActivations();
+  /// @brief Alias Concat bottoms (and Slice tops) whose concatenated
+  ///        axis is outermost-contiguous into the shared blob's storage
+  ///        as offset views, so the layers' per-iteration copies become
+  ///        pointer-equal no-ops. Re-run after Reshape.
+  void WireZeroCopyViews();
+  /**
+   * @brief Build the activation-checkpointing segment bookkeeping once
+   *        any layer sets LayerParameter::checkpoint: segment bounds,
+   *        which blobs must stay resident, and which layers recompute.
+   */
+  void SetupCheckpointing();
+  /// @brief Release the droppable activations of one segment.
+  void DropCheckpointSegment(int segment);
+  /// @brief Backward with per-segment forward recompute of dropped
+  ///        activations; BackwardFromTo dispatches here when
+  ///        checkpointing is active.
+  void BackwardCheckpointed(int start, int end);
+  /// @brief One layer's backward step plus its callbacks.
+  void BackwardLayer(int layer_id);
+  /// @brief Compile step over the NetParameter before layer
+  ///        instantiation: drops layers that are identities in the
+  ///        current phase (TEST-time Dropout) and rewires their
+  ///        consumers to the surviving blob.
+  void CompileNet(const NetParameter& param, NetParameter* param_compiled);
+  /// @brief Shared state of one dataflow-parallel forward pass.
+  struct ForwardSchedule {
+    vector<int> pending;  ///< unmet dependency count per layer
+    vector<int> ready;    ///< layers whose dependencies are all met
+    int remaining;        ///< layers not yet finished
+    Dtype loss;
+    Caffe::Brew mode;
+    Caffe::NumaPolicy numa_policy;
+    boost::mutex* mutex;
+    boost::condition_variable* cond;
+  };
+  /// @brief Run the whole forward pass with layers dispatched to
+  ///        forward_parallelism worker threads as their dependencies
+  ///        complete; used by ForwardFromTo on full-range CPU passes.
+  Dtype ForwardParallel();
+  /// @brief Worker loop of ForwardParallel; also run on the caller.
+  void ForwardParallelWorker(ForwardSchedule* schedule);
+  /// @brief BLAS thread count to apply around one layer's CPU
+  ///        Forward/Backward: the layer's blas_threads hint clamped to
+  ///        Caffe::cpu_core_budget(), or 0 (leave the backend alone).
+  int BlasThreadHint(const int layer_id) const;
   static void FilterNet(const NetParameter& param,
       NetParameter* param_filtered);
   /// @brief return whether NetState state meets NetStateRule rule
@@ -238,6 +518,18 @@ class Net {
                    const int bottom_id, set<string>* available_blobs,
                    map<string, int>* blob_name_to_idx);
   /// @brief Append a new parameter blob to the net.
+  /// @brief Point one just-set-up layer's param blobs at the matching
+  ///        (by name) layer of another net, releasing its own storage.
+  void ShareLayerParamsFrom(const Net* other, const int layer_id);
+  /// @brief Fold a removed BatchNorm or Scale source layer's parameters
+  ///        into the recorded convolution's weights and bias.
+  void FoldSourceLayer(const LayerParameter& source_layer,
+      const string& conv_layer_name);
+  /// @brief Stream a current-format binary NetParameter one layer at a
+  ///        time, bounding restore memory by the largest layer instead of
+  ///        the whole model. Returns false (without finishing) for files
+  ///        in deprecated formats, which need the full upgrade parse.
+  bool StreamTrainedLayersFromBinaryProto(const string& trained_filename);
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
@@ -247,6 +539,16 @@ class Net {
   void BackwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Update.
   void UpdateDebugInfo(const int param_id);
+  /// @brief Queue one sampled-debug asum device-side; the log line is
+  ///        formatted now, the value arrives with the batched readback.
+  void QueueDebugAsum(const Blob<Dtype>& blob, const bool diff,
+      const string& prefix);
+  /// @brief Read back all queued asums in one copy, log them, and
+  ///        report (then re-arm) the non-finite canary.
+  void FlushDebugInfo();
+  /// @brief Rejects InsertLayer/RemoveLayer while Init-built per-layer
+  ///        state (profiling, DAG, events, arenas) would go stale.
+  void CheckSurgerySupported();
 
   /// @brief The network name
   string name_;
@@ -257,6 +559,117 @@ class Net {
   vector<string> layer_names_;
   map<string, int> layer_names_index_;
   vector<bool> layer_need_backward_;
+  /// Layers whose work was folded into the preceding layer (fused
+  /// conv+ReLU); skipped by ForwardFromTo.
+  vector<bool> layer_fused_;
+  /// Maps each BatchNorm/Scale layer removed by FoldBatchNorm to the name
+  /// of the convolution layer its parameters fold into.
+  map<string, string> bn_fold_targets_;
+  /// eps of each removed BatchNorm layer, keyed by layer name.
+  map<string, float> bn_fold_eps_;
+  /// Convolutions that had no bias before FoldBatchNorm synthesized one;
+  /// their source layers legitimately carry one blob fewer.
+  set<string> bn_fold_bias_convs_;
+  /// Buffers backing the activation blobs pooled by ShareActivations.
+  vector<shared_ptr<SyncedMemory> > activation_arenas_;
+  /// Whether ShareActivations pooled activation storage; forbids Backward.
+  bool activations_shared_;
+  /// Whether diffs are frozen net-wide (forward_only); forbids Backward.
+  bool forward_only_;
+  /// Whether any layer is an activation checkpoint (see
+  /// LayerParameter::checkpoint); the members below are only built then.
+  bool checkpointing_;
+  /// Checkpoint segment each layer belongs to.
+  vector<int> layer_checkpoint_segment_;
+  /// First and last layer id of each segment.
+  vector<int> checkpoint_segment_starts_, checkpoint_segment_ends_;
+  /// Segment whose last layer this is, or -1; forward drops a finished
+  /// non-final segment at this point.
+  vector<int> checkpoint_segment_after_;
+  /// Blob ids each segment may release: produced and consumed only
+  /// inside it and not otherwise pinned.
+  vector<vector<int> > checkpoint_droppable_blobs_;
+  /// Layers producing at least one droppable blob; only these re-run
+  /// during recompute (data layers never do, so cursors do not move).
+  vector<bool> checkpoint_layer_recompute_;
+  /// Whether each segment's droppable activations are currently freed.
+  vector<bool> checkpoint_segment_dropped_;
+  /// Fired after each layer during Backward; see Callback.
+  vector<Callback*> after_backward_;
+  /// Mapped weight segment when this net evaluates a live training run.
+  shared_ptr<SharedWeights<Dtype> > shared_weights_;
+  /// Flat weight mapping the params point into, if loaded from one.
+  shared_ptr<FlatWeights<Dtype> > flat_weights_;
+  /// Earliest consuming layer per learnable param; see accessor.
+  vector<int> learnable_param_layer_ids_;
+#ifndef CPU_ONLY
+  /// Per-layer overlapped-update events; empty until EnableUpdateEvents.
+  vector<cudaEvent_t> update_events_;
+  /// Runs the forward as a captured CUDA graph when possible; returns
+  /// false when the pass must run uncaptured (see cuda_graph_replay).
+  bool GraphReplayForward();
+  /// Destroys the captured forward graph; anything that changes blob
+  /// geometry or storage must call this.
+  void InvalidateForwardGraph();
+  /// Whether the NetParameter asked for cuda_graph_replay.
+  bool graph_replay_;
+  /// Set when a capture attempt failed; no further attempts are made.
+  bool graph_replay_disabled_;
+  /// Instantiated cudaGraphExec_t of the forward, or NULL. Kept as
+  /// void* so the header needs no CUDA-version guards.
+  void* forward_graph_exec_;
+  /// Input shapes and device pointers the last uncaptured pass saw;
+  /// capture starts once two consecutive passes agree on them.
+  vector<string> graph_shapes_;
+  vector<const void*> graph_inputs_;
+#endif
+  /// Records the profiling timestamp before layer_id runs (and folds
+  /// the previous iteration's completed sample into the window).
+  void ProfileLayerStart(int layer_id, bool forward);
+  /// Records the profiling timestamp after layer_id ran.
+  void ProfileLayerStop(int layer_id, bool forward);
+  void AddTimingSample(int layer_id, bool forward, float ms);
+  /// Layer profiling state (profile_layers): per-layer sample rings in
+  /// milliseconds plus, per mode, CUDA event pairs or a host stopwatch.
+  bool profile_layers_;
+  vector<vector<float> > forward_times_, backward_times_;
+  vector<size_t> forward_times_next_, backward_times_next_;
+  vector<double> profile_start_ms_;
+  /// Hardware counters wrapped around each Forward_cpu call while
+  /// profiling in CPU mode, accumulated per layer type; tells a
+  /// memory-bound layer from a compute-bound one. Created lazily; left
+  /// unset when perf_event access is denied.
+  shared_ptr<PerfCounters> perf_counters_;
+  struct LayerPerfCounts {
+    LayerPerfCounts()
+        : calls(0), cycles(0), llc_misses(0), stalled_backend(0) {}
+    uint64_t calls, cycles, llc_misses, stalled_backend;
+  };
+  map<string, LayerPerfCounts> perf_counts_by_type_;
+#ifndef CPU_ONLY
+  /// Four events per layer (fwd start/stop, bwd start/stop), created
+  /// on first profiled pass in GPU mode.
+  vector<cudaEvent_t> profile_events_;
+  vector<bool> profile_fwd_recorded_, profile_bwd_recorded_;
+#endif
+  /// Worker threads a dataflow-parallel CPU forward may use; 1 = serial.
+  int forward_parallelism_;
+  /// Forward dependency DAG: per layer, its successors and the number
+  /// of predecessors; built by Init when forward_parallelism > 1.
+  vector<vector<int> > layer_succ_;
+  vector<int> layer_pred_count_;
+  /// Asynchronous loss readback state; see set_async_loss. The device
+  /// buffer holds one slot per top blob, mirrored into pinned host
+  /// memory by an async copy fenced with an event.
+  bool async_loss_;
+  shared_ptr<SyncedMemory> async_loss_device_;
+  Dtype* async_loss_pinned_;
+  int async_loss_slot_count_;
+  bool async_loss_pending_;
+  Dtype async_loss_last_;
+#ifndef CPU_ONLY
+  cudaEvent_t async_loss_event_;
+#endif
   /// @brief the blobs storing intermediate results between the layer.
   vector<shared_ptr<Blob<Dtype> > > blobs_;
   vector<string> blob_names_;
@@ -274,6 +687,8 @@ class Net {
   /// Vector of weight in the loss (or objective) function of each net blob,
   /// indexed by blob_id.
   vector<Dtype> blob_loss_weights_;
+  /// See set_loss_scale(); 1 unless the solver is accumulating.
+  Dtype loss_scale_;
   vector<vector<int> > param_id_vecs_;
   vector<int> param_owners_;
   vector<string> param_display_names_;
@@ -295,6 +710,11 @@ class Net {
    * and learnable_params_[learnable_param_ids_[i]] gives its owner.
    */
   vector<int> learnable_param_ids_;
+  /// See learnable_param_need_backward(); cached by Init.
+  vector<bool> learnable_param_need_backward_;
+  /// First layer with any backward work; Backward() stops its walk here
+  /// instead of at layer 0, skipping a frozen prefix entirely.
+  int first_backward_layer_;
   /// the learning rate multipliers for learnable_params_
   vector<float> params_lr_;
   vector<bool> has_params_lr_;
@@ -305,8 +725,30 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Emit debug info every this many iterations (0 disables sampling).
+  int debug_info_sample_;
+  /// Iterations seen since sampling was enabled.
+  int debug_sample_iter_;
+  /// Whether the iteration in flight is a sampled one.
+  bool debug_sample_this_iter_;
+  /// One pending batched-debug reduction (see QueueDebugAsum).
+  struct DebugInfoSlot {
+    string prefix;
+    Dtype scale;
+  };
+  vector<DebugInfoSlot> debug_slots_;
+  /// Device scalars the queued asums reduce into, one per slot.
+  shared_ptr<SyncedMemory> debug_asum_buffer_;
+  /// Sticky device flag set by the non-finite canary kernel.
+  shared_ptr<SyncedMemory> nonfinite_flag_;
+  /// Column buffer shared by all convolution layers; they run
+  /// sequentially, so one high-water-mark sized scratch blob suffices.
+  shared_ptr<Blob<Dtype> > col_buffer_arena_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
+  /// The net whose param storage this net's layers share (see the
+  /// constructor); NULL for nets that own their params.
+  const Net* share_params_from_;
   DISABLE_COPY_AND_ASSIGN(Net);
 };
 
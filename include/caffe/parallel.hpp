@@ -13,6 +13,8 @@
 #include "caffe/solver.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/mpi.hpp"
+#include "caffe/util/nccl.hpp"
 
 namespace caffe {
 
@@ -108,6 +110,9 @@ class P2PSync : public GPUParams<Dtype>, public Solver<Dtype>::Callback,
   vector<P2PSync<Dtype>*> children_;
   BlockingQueue<P2PSync<Dtype>*> queue_;
   const int initial_iter_;
+  // Iterations since startup, counted locally; drives the periodic
+  // reconcile in the bounded-staleness mode (staleness_period > 0).
+  int staleness_tick_;
   Dtype* parent_grads_;
   shared_ptr<Solver<Dtype> > solver_;
 
@@ -116,6 +121,142 @@ class P2PSync : public GPUParams<Dtype>, public Solver<Dtype>::Callback,
   using Params<Dtype>::diff_;
 };
 
+#ifdef USE_NCCL
+// Synchronous data parallelism over a NCCL ring all-reduce. The P2PSync
+// tree reduces pairwise up a binary tree and broadcasts back down, so
+// its latency grows with log(GPUs) and most links sit idle at any
+// moment; a ring keeps every link busy and moves each gradient element
+// across each link exactly once, which is what saturates NVLink on a
+// full board. One instance per device, all sharing communicators
+// created by the root's Run; params are broadcast once at startup and
+// stay in sync because every rank applies identical updates to the
+// identical averaged gradients.
+template<typename Dtype>
+class NCCLSync : public GPUParams<Dtype>, public Solver<Dtype>::Callback,
+    public Net<Dtype>::Callback, public InternalThread {
+ public:
+  NCCLSync(shared_ptr<Solver<Dtype> > root_solver,
+           const SolverParameter& param);
+  virtual ~NCCLSync();
+
+  inline const shared_ptr<Solver<Dtype> >& solver() const {
+    return solver_;
+  }
+
+  void Run(const vector<int>& gpus);
+
+ protected:
+  void on_start();
+  void on_gradients_ready();
+  /// Net callback: starts the all-reduce for one layer's params on the
+  /// reduction stream while the layers below it still compute
+  /// (solver_param.layer_wise_reduce); on_gradients_ready only waits
+  /// for the stream to drain before the update.
+  void run(int layer);
+
+  void InternalThreadEntry();
+  void BroadcastInitialParams();
+
+  ncclComm_t comm_;
+  cudaStream_t stream_;
+  const int initial_iter_;
+  shared_ptr<Solver<Dtype> > solver_;
+
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+#endif  // USE_NCCL
+
+// Inter-node collective transport used by DistributedSync. Implementations
+// wrap a host-side fabric (MPI today; a TCP or RDMA ring would slot in the
+// same way) and operate on host memory so the transport needs no knowledge
+// of devices.
+template<typename Dtype>
+class DistributedTransport {
+ public:
+  virtual ~DistributedTransport() {}
+
+  virtual int rank() const = 0;
+  virtual int size() const = 0;
+  virtual void Broadcast(Dtype* data, size_t count, int root) = 0;
+  virtual void AllReduceSum(Dtype* data, size_t count) = 0;
+  // Concatenates every rank's send buffer into recv (rank order,
+  // bytes each); carries the quantized gradient exchange, which cannot
+  // be summed on the wire because each rank uses its own scale.
+  virtual void AllGather(const void* send, void* recv, size_t bytes) = 0;
+  virtual void Barrier() = 0;
+};
+
+#ifdef USE_MPI
+// DistributedTransport over MPI collectives. Initializes MPI on first
+// construction (and finalizes it on destruction if it did); with a
+// CUDA-aware MPI the host bounce buffers in DistributedSync are the only
+// extra copies.
+template<typename Dtype>
+class MPITransport : public DistributedTransport<Dtype> {
+ public:
+  MPITransport();
+  virtual ~MPITransport();
+
+  virtual int rank() const { return rank_; }
+  virtual int size() const { return size_; }
+  virtual void Broadcast(Dtype* data, size_t count, int root);
+  virtual void AllReduceSum(Dtype* data, size_t count);
+  virtual void AllGather(const void* send, void* recv, size_t bytes);
+  virtual void Barrier();
+
+ protected:
+  int rank_;
+  int size_;
+  bool owns_mpi_;  // whether this instance ran MPI_Init
+
+DISABLE_COPY_AND_ASSIGN(MPITransport);
+};
+#endif  // USE_MPI
+
+// Synchronous data parallelism across machines: one process per GPU, one
+// rank per process, gradients all-reduced after every backward pass over a
+// DistributedTransport. Params are broadcast from rank 0 once at startup
+// and stay in sync because every rank applies the same update to the same
+// averaged gradients. Gradients bounce through a pinned host buffer on the
+// way to the transport, overlapping nothing -- combine with
+// layer_wise_reduce-style schemes only once the fabric supports device
+// memory directly.
+template<typename Dtype>
+class DistributedSync : public GPUParams<Dtype>,
+    public Solver<Dtype>::Callback {
+ public:
+  DistributedSync(shared_ptr<Solver<Dtype> > root_solver,
+                  shared_ptr<DistributedTransport<Dtype> > transport);
+  virtual ~DistributedSync();
+
+  inline const shared_ptr<Solver<Dtype> >& solver() const {
+    return solver_;
+  }
+
+  // Broadcasts rank 0's params and runs the solver to completion.
+  void Run();
+
+ protected:
+  void on_start();
+  void on_gradients_ready();
+
+  shared_ptr<DistributedTransport<Dtype> > transport_;
+  shared_ptr<Solver<Dtype> > solver_;
+  Dtype* staging_;  // pinned host bounce buffer for the transport
+  // 8-bit gradient exchange (solver_param.quantize_gradients): the
+  // quantization error of each step is kept here and folded into the
+  // next step's gradients before encoding (error feedback).
+  vector<Dtype> residual_;
+  vector<char> quant_send_;
+  vector<char> quant_recv_;
+
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
 }  // namespace caffe
 
 #endif
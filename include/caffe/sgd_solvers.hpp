@@ -19,28 +19,72 @@ class SGDSolver : public Solver<Dtype> {
       : Solver<Dtype>(param) { PreSolve(); }
   explicit SGDSolver(const string& param_file)
       : Solver<Dtype>(param_file) { PreSolve(); }
+  virtual ~SGDSolver();
   virtual inline const char* type() const { return "SGD"; }
 
   const vector<shared_ptr<Blob<Dtype> > >& history() { return history_; }
+  virtual vector<Dtype> update_stats();
 
  protected:
+  // lr_policy() resolved once in PreSolve, so the per-iteration rate
+  // computation never walks the string-comparison chain (and unknown
+  // policies fail at construction instead of on the first update).
+  enum LRPolicy {
+    LR_FIXED, LR_STEP, LR_EXP, LR_INV, LR_MULTISTEP, LR_POLY, LR_SIGMOID,
+    LR_COSINE, LR_TRIANGULAR, LR_INTERP
+  };
+
   void PreSolve();
   Dtype GetLearningRate();
   virtual void ApplyUpdate();
-  virtual void Normalize(int param_id);
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  // Decay + momentum + apply in one read-modify-write sweep over the
+  // param; replaces Regularize/ComputeUpdateValue/Blob::Update for
+  // plain SGD with L2 (or zero) decay.
+  void FusedUpdate(int param_id, Dtype rate);
+  // Records ||update||^2 and ||weights||^2 for one param into the stats
+  // buffer; device-side dots on GPU, so no sync (collect_update_stats).
+  void CollectUpdateStats(int param_id);
   virtual void ClipGradients();
+  virtual void FinishUpdate();
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
   virtual void RestoreSolverStateFromHDF5(const string& state_file);
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file);
+  // State and scratch blobs, allocated on first use: only some solver
+  // types and code paths need them, and eager allocation multiplied
+  // the optimizer state for the ones that do not (e.g. Adam only keeps
+  // m/v, and momentum-0 SGD keeps nothing at all). A fresh slot reads
+  // back as zeros, the correct initial history.
+  Blob<Dtype>* history_blob(int param_id);
+  Blob<Dtype>* update_blob(int param_id);
+  Blob<Dtype>* temp_blob(int param_id);
   // history maintains the historical momentum data.
   // update maintains update related data and is not needed in snapshots.
   // temp maintains other information that might be needed in computation
   //   of gradients/updates and is not needed in snapshots
   vector<shared_ptr<Blob<Dtype> > > history_, update_, temp_;
+  // Interleaved [||update||^2, ||weights||^2] per learnable param; on
+  // CPU written directly, on GPU the device buffer is read back into
+  // the pinned copy asynchronously at the end of each ApplyUpdate.
+  vector<Dtype> update_stats_;
+  LRPolicy lr_policy_;
+#ifndef CPU_ONLY
+  Dtype* stats_gpu_;
+  Dtype* stats_pinned_;
+  // Device scalar the per-blob gradient sum-of-squares reductions
+  // accumulate into (ClipGradients); read back with one sync instead of
+  // one blocking cublas result copy per parameter blob.
+  Dtype* clip_gpu_;
+  // Side stream for the overlapped update path (overlapped_update):
+  // update kernels run here, ordered after the backward pass by
+  // grads_ready_event_, while the next forward proceeds on the default
+  // stream waiting per layer. Created lazily on first use.
+  cudaStream_t update_stream_;
+  cudaEvent_t grads_ready_event_;
+#endif
 
   DISABLE_COPY_AND_ASSIGN(SGDSolver);
 };
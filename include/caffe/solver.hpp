@@ -6,6 +6,9 @@
 
 #include "caffe/net.hpp"
 #include "caffe/solver_factory.hpp"
+#include "caffe/util/metrics_sink.hpp"
+
+namespace boost { class thread; }
 
 namespace caffe {
 
@@ -66,13 +69,26 @@ class Solver {
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
   void Snapshot();
-  virtual ~Solver() {}
+  /// Blocks until any in-flight asynchronous snapshot write has
+  /// finished (async_snapshot); a no-op otherwise.
+  void WaitForSnapshot();
+  virtual ~Solver();
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
   inline const vector<shared_ptr<Net<Dtype> > >& test_nets() {
     return test_nets_;
   }
   int iter() { return iter_; }
+  /**
+   * @brief Per-learnable-param update/weight ratio norms,
+   *        ||update|| / ||weights||, from the most recent collection
+   *        (SolverParameter.collect_update_stats).
+   *
+   * Empty unless the solver type collects them; on GPU the values lag
+   * one iteration because the readback is asynchronous. Near-zero
+   * ratios flag dead layers, outsized ones flag lr_mult too high.
+   */
+  virtual vector<Dtype> update_stats() { return vector<Dtype>(); }
 
   // Invoked at specific points during an iteration
   class Callback {
@@ -89,6 +105,18 @@ class Solver {
   }
 
   void CheckSnapshotWritePermissions();
+  /**
+   * @brief Logs the per-iteration latency histogram with stall
+   *        attribution: power-of-two buckets over the iteration wall
+   *        time, each reporting how much of its time went to waiting
+   *        on data, ApplyUpdate and snapshotting.
+   *
+   * Recorded for every Step iteration at negligible cost. Any signal
+   * action triggers a dump of a live run; Solve also logs it at exit.
+   * Tail buckets expose the iterations that stall without moving the
+   * mean.
+   */
+  void LogIterationHistogram();
   /**
    * @brief Returns the solver type.
    */
@@ -97,17 +125,68 @@ class Solver {
  protected:
   // Make and apply the update value for the current iteration.
   virtual void ApplyUpdate() = 0;
+  // Blocks until any asynchronously issued update work has finished;
+  // called before anything outside Forward reads the params (testing,
+  // snapshots, weight publishing). No-op for synchronous solvers.
+  virtual void FinishUpdate() {}
   string SnapshotFilename(const string extension);
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
+  /// Staged model handed to the async snapshot writer thread: the
+  /// structure with blobs cleared, plus deep host copies of the blobs.
+  struct SnapshotPayload {
+    shared_ptr<NetParameter> net_param;
+    vector<int> layer_blob_counts;
+    vector<shared_ptr<Blob<Dtype> > > blobs;
+    string model_filename;
+    bool write_diff;
+  };
+  /// Stages the model on the calling thread and spawns the writer.
+  void SnapshotToBinaryProtoAsync(const string& model_filename);
+  void SnapshotWriteThread(shared_ptr<SnapshotPayload> payload);
+  /// Keeps host copies of the params just snapshotted to the named
+  /// file, as the reference for delta snapshots (snapshot_delta).
+  void CaptureSnapshotBase(const string& model_filename);
+  /// Writes the params as quantized differences against the base.
+  string SnapshotToDelta();
+  /// Appends this iteration's loss and train net outputs to the
+  /// metrics sink (metrics_log), which batches them to disk off the
+  /// solver thread; replaces the per-blob LOG(INFO) formatting.
+  void RecordMetrics();
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
+  /// Runs the evaluation batches on the given net and logs the averaged
+  /// outputs tagged with `iteration`; shared by the synchronous and
+  /// asynchronous paths. Snapshot/stop requests are only honored
+  /// between batches when handle_actions is set (synchronous path).
+  void TestOnNet(Net<Dtype>* test_net, const int test_net_id,
+      const int iteration, const bool handle_actions);
+  /// Kicks off a background evaluation pass from a snapshot of the
+  /// current weights (test_async); skips the interval if the previous
+  /// pass has not finished.
+  void TestAllAsync();
+  /// Body of the background evaluation thread.
+  void AsyncTestThread(const int mode, const int device);
+  /// Blocks until any in-flight asynchronous evaluation has finished.
+  void WaitForAsyncTest();
   virtual void SnapshotSolverState(const string& model_filename) = 0;
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
   void DisplayOutputBlobs(const int net_id);
   void UpdateSmoothedLoss(Dtype loss, int start_iter, int average_loss);
+  /// One latency bucket (total iteration time in [2^i, 2^{i+1}) ms),
+  /// with the tagged stall times summed per bucket.
+  struct IterationBucket {
+    IterationBucket()
+        : count(0), total_ms(0), data_wait_ms(0), update_ms(0),
+          snapshot_ms(0) {}
+    size_t count;
+    double total_ms, data_wait_ms, update_ms, snapshot_ms;
+  };
+  /// Files one iteration into the histogram.
+  void RecordIterationTime(double total_ms, double data_wait_ms,
+      double update_ms, double snapshot_ms);
 
   SolverParameter param_;
   int iter_;
@@ -117,6 +196,29 @@ class Solver {
   vector<Callback*> callbacks_;
   vector<Dtype> losses_;
   Dtype smoothed_loss_;
+  vector<IterationBucket> iteration_hist_;
+  // Live weight segment published for evaluator processes
+  // (share_weights_shm); NULL when publishing is off.
+  shared_ptr<SharedWeights<Dtype> > shared_weights_;
+  // Writer thread of the in-flight async snapshot, if any.
+  shared_ptr<boost::thread> snapshot_thread_;
+  // Asynchronous evaluation state (test_async): the merged test-net
+  // definitions, the evaluator's own nets (built lazily on its device),
+  // the weight snapshot under evaluation, and the worker thread. The
+  // done flag is written by the worker and polled by the solver thread.
+  vector<NetParameter> async_test_net_params_;
+  vector<shared_ptr<Net<Dtype> > > async_test_nets_;
+  shared_ptr<NetParameter> async_test_weights_;
+  shared_ptr<boost::thread> async_test_thread_;
+  volatile bool async_test_done_;
+  int async_test_iter_;
+  // Structured metrics log (metrics_log); NULL when disabled.
+  shared_ptr<MetricsSink> metrics_sink_;
+  // Delta snapshot state (snapshot_delta): the base file, host copies
+  // of the params as of the base, and deltas written since.
+  string snapshot_base_filename_;
+  vector<shared_ptr<Blob<Dtype> > > snapshot_base_;
+  int snapshots_since_base_;
 
   // The root solver that holds root nets (actually containing shared layers)
   // in data parallelism
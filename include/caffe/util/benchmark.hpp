@@ -1,8 +1,11 @@
 #ifndef CAFFE_UTIL_BENCHMARK_H_
 #define CAFFE_UTIL_BENCHMARK_H_
 
+#include <stdint.h>
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include "caffe/common.hpp"
 #include "caffe/util/device_alternate.hpp"
 
 namespace caffe {
@@ -47,6 +50,41 @@ class CPUTimer : public Timer {
   virtual float MicroSeconds();
 };
 
+/**
+ * @brief Samples hardware perf_event counters around a code section,
+ *        Timer-style: cycles, last-level cache misses and
+ *        backend-stalled cycles, enough to tell a memory-bound section
+ *        from a compute-bound one.
+ *
+ * Only functional on Linux with perf_event access
+ * (kernel.perf_event_paranoid permitting); elsewhere, or when the PMU
+ * refuses the events, available() is false and Start/Stop are no-ops.
+ * Counters that the CPU does not expose (commonly stalled-backend)
+ * simply read as zero.
+ */
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+  /// Whether the counter group could be opened.
+  bool available() const { return available_; }
+  void Start();
+  void Stop();
+  /// Counts for the most recent Start/Stop section.
+  uint64_t cycles() const { return cycles_; }
+  uint64_t llc_misses() const { return llc_misses_; }
+  uint64_t stalled_backend() const { return stalled_backend_; }
+
+ private:
+  bool available_;
+  bool running_;
+  // Group leader (cycles) and siblings; -1 when an event failed to open.
+  int fds_[3];
+  uint64_t cycles_, llc_misses_, stalled_backend_;
+
+DISABLE_COPY_AND_ASSIGN(PerfCounters);
+};
+
 }  // namespace caffe
 
 #endif   // CAFFE_UTIL_BENCHMARK_H_
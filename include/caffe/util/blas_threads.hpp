@@ -0,0 +1,37 @@
+#ifndef CAFFE_UTIL_BLAS_THREADS_HPP_
+#define CAFFE_UTIL_BLAS_THREADS_HPP_
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Scoped BLAS thread-count override: caps the threads the BLAS
+ *        backend may use for the lifetime of the object and restores
+ *        the previous count on destruction.
+ *
+ * Wrapped around Forward/Backward of layers carrying a blas_threads
+ * hint (LayerParameter.blas_threads), so a large fully-connected GEMM
+ * can use several cores without the setting leaking into the rest of
+ * the net, where BLAS threading oversubscribes against the prefetch
+ * and batch-worker threads. Uses mkl_set_num_threads_local under
+ * USE_MKL; otherwise OpenBLAS's openblas_set_num_threads, resolved at
+ * runtime so builds against ATLAS or the reference BLAS (which lack
+ * it) degrade to a no-op. Note OpenBLAS's count is process-global, so
+ * hints are meant for the serial portions of a pass.
+ */
+class BlasThreadScope {
+ public:
+  explicit BlasThreadScope(const int num_threads);
+  ~BlasThreadScope();
+
+ private:
+  int previous_;
+  bool active_;
+
+  DISABLE_COPY_AND_ASSIGN(BlasThreadScope);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BLAS_THREADS_HPP_
@@ -11,6 +11,15 @@ class BlockingQueue {
  public:
   explicit BlockingQueue();
 
+  // Bounded variant backed by a lock-free ring buffer, for hot queues that
+  // see mutex contention (reader and prefetch queues). Operations are
+  // wait-free while the queue is neither empty nor full; blocking calls
+  // spin briefly, then yield and sleep instead of waiting on a condition.
+  // Capacity is rounded up to the next power of two and must cover the
+  // total number of elements in flight or push() will block. try_peek()
+  // and peek() assume a single consumer in this mode.
+  explicit BlockingQueue(size_t capacity);
+
   void push(const T& t);
 
   bool try_pop(T* t);
@@ -33,9 +42,13 @@ class BlockingQueue {
    Linux CUDA 7.0.18.
    */
   class sync;
+  class Ring;
 
   std::queue<T> queue_;
   shared_ptr<sync> sync_;
+  // Non-NULL only for the bounded lock-free variant, which then handles
+  // all operations instead of queue_/sync_.
+  shared_ptr<Ring> ring_;
 
 DISABLE_COPY_AND_ASSIGN(BlockingQueue);
 };
@@ -0,0 +1,69 @@
+#ifndef CAFFE_UTIL_CHROME_TRACE_HPP_
+#define CAFFE_UTIL_CHROME_TRACE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Collects timed spans from any thread and writes them as a
+ *        chrome://tracing JSON file, one lane per thread, so prefetch
+ *        threads, the solver loop, per-layer work and parallel-sync
+ *        callbacks line up on a common timeline.
+ *
+ * Capture is off by default and costs one branch per instrumented
+ * site. The solver toggles it with SIGUSR1 (see SignalHandler), so a
+ * window of iterations can be pulled from a live job: first signal
+ * starts collecting, second stops and writes the file. Spans recorded
+ * while capture is off are dropped.
+ */
+class ChromeTrace {
+ public:
+  /// Whether spans are currently being collected.
+  static bool enabled();
+  /// Begins collecting into memory; the file is written by Stop.
+  static void Start(const string& filename);
+  /// Stops collecting and writes the trace JSON.
+  static void Stop();
+  /// Records a completed span on the calling thread's lane. Times are
+  /// microseconds from NowUs.
+  static void AddSpan(const char* category, const string& name,
+      double start_us, double dur_us);
+  /// Names the calling thread's lane in the trace (e.g. "prefetch").
+  static void SetThreadName(const string& name);
+  static double NowUs();
+};
+
+/**
+ * @brief Scoped span: times its lifetime and records it if tracing is
+ *        enabled when it is constructed.
+ */
+class TraceSpan {
+ public:
+  TraceSpan(const char* category, const string& name)
+      : category_(category), start_us_(0) {
+    if (ChromeTrace::enabled()) {
+      name_ = name;
+      start_us_ = ChromeTrace::NowUs();
+    }
+  }
+  ~TraceSpan() {
+    if (start_us_) {
+      ChromeTrace::AddSpan(category_, name_, start_us_,
+          ChromeTrace::NowUs() - start_us_);
+    }
+  }
+
+ private:
+  const char* category_;
+  string name_;
+  double start_us_;
+
+DISABLE_COPY_AND_ASSIGN(TraceSpan);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CHROME_TRACE_HPP_
@@ -4,6 +4,8 @@
 
 #include <cudnn.h>
 
+#include <string>
+
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 
@@ -47,6 +49,16 @@ inline const char* cudnnGetErrorString(cudnnStatus_t status) {
 
 namespace caffe {
 
+// Ahead-of-time plan cache for the benchmarked convolution algorithm
+// choices (see cudnn_conv_layer.cpp). Save writes the process-wide
+// cache to a text file stamped with the cuDNN version and device name;
+// Load refuses a file stamped for anything else, since algorithm ids
+// and timings do not transfer. Geometry (including batch size) is part
+// of each entry's key, so one plan file serves any net on the device
+// and a warm plan skips the startup benchmarking entirely.
+bool CuDNNAlgoCacheLoad(const string& path);
+bool CuDNNAlgoCacheSave(const string& path);
+
 namespace cudnn {
 
 template <typename Dtype> class dataType;
@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_DATUM_VIEW_HPP_
+#define CAFFE_UTIL_DATUM_VIEW_HPP_
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace caffe {
+
+/**
+ * @brief Read-only view of a serialized Datum whose pixel data stays in the
+ *        caller's buffer, e.g. an LMDB memory-mapped page.
+ *
+ * ParseFrom() walks the protobuf wire format and records a pointer into the
+ * buffer for the uint8 data field instead of copying it into a string, so
+ * decoding a Datum from a read-only database costs no allocation. The view
+ * is only valid while the backing buffer is, i.e. while the cursor that
+ * produced it has not been advanced past the page lifetime.
+ *
+ * Datums carrying float_data are not supported; ParseFrom() returns false
+ * and callers should fall back to a full Datum::ParseFromString().
+ */
+class DatumView {
+ public:
+  DatumView()
+      : channels_(0), height_(0), width_(0), label_(0), encoded_(false),
+        data_(NULL), data_size_(0) {}
+
+  // Returns true iff the buffer held a well-formed Datum with uint8 data.
+  bool ParseFrom(const char* buffer, size_t size);
+
+  int channels() const { return channels_; }
+  int height() const { return height_; }
+  int width() const { return width_; }
+  int label() const { return label_; }
+  bool encoded() const { return encoded_; }
+  const char* data() const { return data_; }
+  size_t data_size() const { return data_size_; }
+
+ private:
+  int channels_, height_, width_, label_;
+  bool encoded_;
+  const char* data_;
+  size_t data_size_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DATUM_VIEW_HPP_
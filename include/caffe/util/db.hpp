@@ -18,7 +18,23 @@ class Cursor {
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  // Raw view of the current value, without the string copy made by value().
+  // The pointer is only valid while the cursor itself is alive.
+  virtual const char* value_data() = 0;
+  virtual size_t value_size() = 0;
   virtual bool valid() = 0;
+  // Positions the cursor at the first entry with key >= key, invalidating
+  // it when no such entry exists. Returns false on backends without
+  // random access support.
+  virtual bool SeekToKey(const string& key) { return false; }
+  // Positions the cursor at a pseudo-random entry, approximately uniform
+  // over the key space (not over entries). Returns false on backends
+  // without random access support.
+  virtual bool SeekToRandom() { return false; }
+  // Hints that roughly the next window bytes of values will be read, so
+  // backends can fault in upcoming pages ahead of the reader. No-op by
+  // default.
+  virtual void set_readahead(size_t window) {}
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
 };
@@ -28,7 +44,19 @@ class Transaction {
   Transaction() { }
   virtual ~Transaction() { }
   virtual void Put(const string& key, const string& value) = 0;
+  // Non-owning variant: the key and value buffers are borrowed only for
+  // the duration of the call, sparing producers the std::string copy.
+  // Backends that consume raw slices override this; the default copies
+  // and delegates to the owning Put.
+  virtual void Put(const char* key, size_t key_size,
+                   const char* value, size_t value_size) {
+    Put(string(key, key_size), string(value, value_size));
+  }
   virtual void Commit() = 0;
+  // Hint that Puts will arrive in strictly increasing key order, so the
+  // backend may build pages without searching or rebalancing (LMDB uses
+  // MDB_APPEND). A no-op for backends without such a fast path.
+  virtual void set_append(bool append) { }
 
   DISABLE_COPY_AND_ASSIGN(Transaction);
 };
@@ -38,6 +66,15 @@ class DB {
   DB() { }
   virtual ~DB() { }
   virtual void Open(const string& source, Mode mode) = 0;
+  // Sizes the backend's in-memory write buffer for bulk loads, so large
+  // imports flush fewer, bigger files and stall less on foreground
+  // compactions. Must be called before Open; a no-op for backends
+  // without such a buffer.
+  virtual void set_write_buffer_size(size_t size) {}
+  // Compacts the full key range after a bulk load so later readers do
+  // not pay for overlapping files; a no-op for backends that keep
+  // themselves compacted.
+  virtual void Compact() {}
   virtual void Close() = 0;
   virtual Cursor* NewCursor() = 0;
   virtual Transaction* NewTransaction() = 0;
@@ -20,6 +20,12 @@ class LevelDBCursor : public Cursor {
   virtual void Next() { iter_->Next(); }
   virtual string key() { return iter_->key().ToString(); }
   virtual string value() { return iter_->value().ToString(); }
+  virtual const char* value_data() { return iter_->value().data(); }
+  virtual size_t value_size() { return iter_->value().size(); }
+  virtual bool SeekToKey(const string& key) {
+    iter_->Seek(key);
+    return iter_->Valid();
+  }
   virtual bool valid() { return iter_->Valid(); }
 
  private:
@@ -32,6 +38,11 @@ class LevelDBTransaction : public Transaction {
   virtual void Put(const string& key, const string& value) {
     batch_.Put(key, value);
   }
+  virtual void Put(const char* key, size_t key_size,
+                   const char* value, size_t value_size) {
+    batch_.Put(leveldb::Slice(key, key_size),
+               leveldb::Slice(value, value_size));
+  }
   virtual void Commit() {
     leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch_);
     CHECK(status.ok()) << "Failed to write batch to leveldb "
@@ -47,9 +58,16 @@ class LevelDBTransaction : public Transaction {
 
 class LevelDB : public DB {
  public:
-  LevelDB() : db_(NULL) { }
+  LevelDB() : db_(NULL), write_buffer_size_(268435456) { }
   virtual ~LevelDB() { Close(); }
   virtual void Open(const string& source, Mode mode);
+  virtual void set_write_buffer_size(size_t size) {
+    CHECK(db_ == NULL) << "write buffer must be sized before Open";
+    write_buffer_size_ = size;
+  }
+  virtual void Compact() {
+    CHECK_NOTNULL(db_)->CompactRange(NULL, NULL);
+  }
   virtual void Close() {
     if (db_ != NULL) {
       delete db_;
@@ -65,6 +83,7 @@ class LevelDB : public DB {
 
  private:
   leveldb::DB* db_;
+  size_t write_buffer_size_;
 };
 
 
@@ -17,7 +17,8 @@ inline void MDB_CHECK(int mdb_status) {
 class LMDBCursor : public Cursor {
  public:
   explicit LMDBCursor(MDB_txn* mdb_txn, MDB_cursor* mdb_cursor)
-    : mdb_txn_(mdb_txn), mdb_cursor_(mdb_cursor), valid_(false) {
+    : mdb_txn_(mdb_txn), mdb_cursor_(mdb_cursor), valid_(false),
+      readahead_window_(0), readahead_watermark_(NULL) {
     SeekToFirst();
   }
   virtual ~LMDBCursor() {
@@ -33,7 +34,17 @@ class LMDBCursor : public Cursor {
     return string(static_cast<const char*>(mdb_value_.mv_data),
         mdb_value_.mv_size);
   }
+  virtual const char* value_data() {
+    return static_cast<const char*>(mdb_value_.mv_data);
+  }
+  virtual size_t value_size() { return mdb_value_.mv_size; }
   virtual bool valid() { return valid_; }
+  virtual bool SeekToKey(const string& key);
+  virtual bool SeekToRandom();
+  virtual void set_readahead(size_t window) {
+    readahead_window_ = window;
+    readahead_watermark_ = NULL;
+  }
 
  private:
   void Seek(MDB_cursor_op op) {
@@ -43,25 +54,35 @@ class LMDBCursor : public Cursor {
     } else {
       MDB_CHECK(mdb_status);
       valid_ = true;
+      MaybeReadahead();
     }
   }
+  // Issues madvise(MADV_WILLNEED) on the next readahead window of the
+  // mapping once the cursor's value pointer crosses the previous one.
+  void MaybeReadahead();
 
   MDB_txn* mdb_txn_;
   MDB_cursor* mdb_cursor_;
   MDB_val mdb_key_, mdb_value_;
   bool valid_;
+  size_t readahead_window_;
+  const char* readahead_watermark_;
 };
 
 class LMDBTransaction : public Transaction {
  public:
   explicit LMDBTransaction(MDB_dbi* mdb_dbi, MDB_txn* mdb_txn)
-    : mdb_dbi_(mdb_dbi), mdb_txn_(mdb_txn) { }
+    : mdb_dbi_(mdb_dbi), mdb_txn_(mdb_txn), append_(false) { }
   virtual void Put(const string& key, const string& value);
+  virtual void Put(const char* key, size_t key_size,
+                   const char* value, size_t value_size);
   virtual void Commit() { MDB_CHECK(mdb_txn_commit(mdb_txn_)); }
+  virtual void set_append(bool append) { append_ = append; }
 
  private:
   MDB_dbi* mdb_dbi_;
   MDB_txn* mdb_txn_;
+  bool append_;
 
   DISABLE_COPY_AND_ASSIGN(LMDBTransaction);
 };
@@ -44,11 +44,21 @@ void classname<Dtype>::funcname##_##gpu(const vector<Blob<Dtype>*>& top, \
 // CUDA macros
 //
 
+namespace caffe {
+// Logs Caffe::memory_telemetry() (defined in common.cpp); CUDA_CHECK
+// calls it before aborting on an allocation failure so OOM post-mortems
+// start with the allocator's view of the device.
+void LogMemoryTelemetry();
+}  // namespace caffe
+
 // CUDA: various checks for different function calls.
 #define CUDA_CHECK(condition) \
   /* Code block avoids redefinition of cudaError_t error */ \
   do { \
     cudaError_t error = condition; \
+    if (error == cudaErrorMemoryAllocation) { \
+      ::caffe::LogMemoryTelemetry(); \
+    } \
     CHECK_EQ(error, cudaSuccess) << " " << cudaGetErrorString(error); \
   } while (0)
 
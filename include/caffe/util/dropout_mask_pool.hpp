@@ -0,0 +1,38 @@
+#ifndef CAFFE_UTIL_DROPOUT_MASK_POOL_HPP_
+#define CAFFE_UTIL_DROPOUT_MASK_POOL_HPP_
+
+namespace caffe {
+
+/**
+ * @brief Pre-generated GPU dropout masks, one batched cuRAND call per
+ *        training iteration instead of one launch per dropout layer.
+ *
+ * Each TRAIN-phase DropoutLayer::Forward_gpu acquires its mask from a
+ * thread-local pool (one per worker net, like the Caffe singleton). The
+ * pool keeps two device buffers: while this iteration's forwards hand
+ * out slices of the front buffer, the back buffer for the next
+ * iteration is generated by a single curandGenerate on a side stream,
+ * so mask generation overlaps compute and costs one launch per
+ * iteration. The pool sizes itself: the first iterations regrow the
+ * buffers until one cycle's acquires all fit, after which the buffers
+ * are stable.
+ *
+ * A slice stays valid through the matching Backward_gpu of the same
+ * iteration; the retired buffer is only regenerated after the next
+ * forward has begun, by which time the previous backward has been
+ * issued. Layers that re-run Forward during Backward (activation
+ * checkpointing recompute) would draw a fresh mask, which is one more
+ * reason stochastic layers should be checkpoints themselves (see
+ * LayerParameter::checkpoint).
+ */
+class DropoutMaskPool {
+ public:
+  // Returns a device pointer to count uniform random uints. The slice
+  // is owned by the pool and must not be written; it remains valid
+  // until the second following call cycle rotates the buffers.
+  static const unsigned int* Acquire(int count);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DROPOUT_MASK_POOL_HPP_
@@ -0,0 +1,62 @@
+#ifndef CAFFE_UTIL_FLAT_WEIGHTS_HPP_
+#define CAFFE_UTIL_FLAT_WEIGHTS_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A memory-mappable weight file: a small header, a NetParameter
+ *        index describing the layers and blob shapes (with the data
+ *        fields empty), and the raw tensors, each aligned so a mapping
+ *        can be used in place.
+ *
+ * Loading a binary proto snapshot parses every weight through
+ * CodedInputStream and copies it again in Blob::FromProto; for a large
+ * model that dominates process startup. A flat file is opened with one
+ * mmap: only the index is parsed, and Net::CopyTrainedLayersFromFlat
+ * points each param's SyncedMemory straight at the mapping, so weights
+ * are paged in lazily and concurrent processes share the page cache.
+ *
+ * Convert existing .caffemodel files with the convert_model_to_flat
+ * tool; Net::CopyTrainedLayersFrom dispatches on the .flat suffix.
+ */
+template <typename Dtype>
+class FlatWeights {
+ public:
+  ~FlatWeights();
+
+  /// Writes a NetParameter with filled blobs as a flat file.
+  static void Write(const NetParameter& param, const string& filename);
+  /// Maps an existing flat file read-only.
+  static shared_ptr<FlatWeights> Open(const string& filename);
+
+  /// Layer structure and blob shapes, without the weight data.
+  const NetParameter& index() const { return index_; }
+  int blob_count() const { return blob_data_.size(); }
+  /// Raw data of the i-th blob in file (net) order, inside the mapping.
+  const Dtype* blob_data(int i) const { return blob_data_[i]; }
+
+ private:
+  struct Header;
+
+  FlatWeights();
+
+  string filename_;
+  void* mapped_;
+  size_t mapped_size_;
+  NetParameter index_;
+  vector<const Dtype*> blob_data_;
+
+DISABLE_COPY_AND_ASSIGN(FlatWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FLAT_WEIGHTS_HPP_
@@ -0,0 +1,46 @@
+#ifndef CAFFE_UTIL_GEMM_DISPATCH_H_
+#define CAFFE_UTIL_GEMM_DISPATCH_H_
+
+// Runtime GEMM backend selection. One binary ships to hosts with very
+// different SIMD widths, and the BLAS that wins on one GEMM shape can
+// lose on another. An alternate CBLAS implementation (OpenBLAS, MKL or
+// BLIS built for the host) can be loaded by shared-object path at
+// runtime; each distinct (trans, M, N, K) shape is then timed against
+// the built-in BLAS on its first few calls and the faster backend is
+// memoized for the rest of the process. With no backend loaded,
+// caffe_cpu_gemm calls the built-in BLAS directly with no overhead.
+//
+// Load a backend before spawning worker threads (like Caffe::set_mode);
+// the preferred entry point is Caffe::set_blas_backend.
+
+#include <string>
+
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+// Loads an alternate CBLAS shared object and resolves cblas_sgemm and
+// cblas_dgemm from it. Returns false and fills *error on failure, in
+// which case the built-in BLAS remains active.
+bool caffe_gemm_load_backend(const std::string& path, std::string* error);
+
+// Unloads the alternate backend and forgets all per-shape timings.
+void caffe_gemm_unload_backend();
+
+// Whether an alternate backend is currently loaded.
+bool caffe_gemm_backend_active();
+
+// GEMM through the per-shape autotuning dispatcher. Only called by
+// caffe_cpu_gemm once a backend is active.
+void caffe_gemm_dispatch(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc);
+void caffe_gemm_dispatch(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GEMM_DISPATCH_H_
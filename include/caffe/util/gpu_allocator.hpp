@@ -0,0 +1,52 @@
+#ifndef CAFFE_UTIL_GPU_ALLOCATOR_H_
+#define CAFFE_UTIL_GPU_ALLOCATOR_H_
+
+// Caching CUDA device allocator. cudaMalloc and cudaFree each synchronize
+// the device, and nets with dynamic shapes (or repeated Net teardown and
+// rebuild) issue thousands of them. Freed blocks are instead parked in
+// per-device, power-of-two-binned free lists and handed to later requests
+// of the same bin; an allocation failure flushes the cache and retries
+// before reporting out of memory. All of Caffe's device work runs on the
+// default stream of its device, so recycling a block to a later request
+// needs no cross-stream fencing -- except under USE_PER_THREAD_STREAMS,
+// where co-resident nets run on per-thread streams and the cache fences
+// reuse with an event recorded when the block was returned. The cache
+// itself is process-wide either way, so co-resident models share one
+// pool instead of holding fixed partitions.
+
+#include <cstddef>
+#include <string>
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+
+class GPUAllocator {
+ public:
+  // Allocates at least size bytes on the current device, reusing a cached
+  // block when one fits, and records the owning device in *device.
+  // Returns false if the device is out of memory even after flushing the
+  // cache.
+  static bool Get(void** ptr, size_t size, int* device);
+  // Returns a block obtained from Get to the cache. size and device must
+  // be the values Get was called with.
+  static void Put(void* ptr, size_t size, int device);
+  // Frees every cached (currently unused) block on every device, e.g. to
+  // give headroom back to an external library.
+  static void ReleaseCached();
+  // Stats for the Caffe::gpu_allocator_* accessors.
+  static size_t bytes_cached();
+  static size_t hits();
+  static size_t misses();
+  // Multi-line telemetry: live and peak device bytes, cache contents,
+  // a per-bin allocation histogram and a fragmentation estimate. Also
+  // logged automatically when an allocation fails, so OOM post-mortems
+  // start from the allocator's view of the device.
+  static std::string report();
+};
+
+#endif  // CPU_ONLY
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GPU_ALLOCATOR_H_
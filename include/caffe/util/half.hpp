@@ -0,0 +1,27 @@
+#ifndef CAFFE_UTIL_HALF_H_
+#define CAFFE_UTIL_HALF_H_
+
+#include <stdint.h>
+
+namespace caffe {
+
+// IEEE 754 binary16 ("half") values stored in a uint16_t, for callers
+// that keep bulk data -- embedding caches, feature dumps, at-rest
+// parameter copies -- at half the fp32 footprint and convert at the
+// boundary of the kernels that consume it. Conversion rounds to
+// nearest even and preserves Inf/NaN; values beyond +-65504 overflow
+// to Inf and values below 2^-24 flush to (signed) zero.
+uint16_t caffe_float2half(float value);
+float caffe_half2float(uint16_t value);
+
+void caffe_cpu_float2half(const int n, const float* src, uint16_t* dst);
+void caffe_cpu_half2float(const int n, const uint16_t* src, float* dst);
+
+#ifndef CPU_ONLY
+void caffe_gpu_float2half(const int n, const float* src, uint16_t* dst);
+void caffe_gpu_half2float(const int n, const uint16_t* src, float* dst);
+#endif
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_H_
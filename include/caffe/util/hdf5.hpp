@@ -20,10 +20,24 @@ void hdf5_load_nd_dataset(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob);
 
+// Returns the extent of a dataset's first axis (its row count), for
+// sizing streamed reads.
+hsize_t hdf5_get_dataset_rows(hid_t file_id, const char* dataset_name_);
+
+// Loads rows [start, start + count) of a dataset into blob, reshaped to
+// count x the trailing dimensions, using a hyperslab selection.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob, hsize_t start, hsize_t count);
+
+// Writes the blob as a dataset. With deflate > 0 the dataset is stored
+// chunked, byte-shuffled and deflate-compressed at that level (1-9);
+// reads are transparent since deflate is a built-in HDF5 filter.
 template <typename Dtype>
 void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
-    bool write_diff = false);
+    bool write_diff = false, int deflate = 0);
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name);
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i);
@@ -29,6 +29,18 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_im);
 
+// Accumulates one strip of a column matrix -- the columns for output
+// rows [output_row_start, output_row_end), stored contiguously in
+// data_col -- into data_im. Unlike col2im_cpu the image is not zeroed
+// first: the caller clears it once and then applies the strips in turn,
+// which is how a bounded workspace can stand in for the full buffer.
+template <typename Dtype>
+void col2im_strip_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_row_start, const int output_row_end, Dtype* data_im);
+
 template <typename Dtype>
 void im2col_nd_gpu(const Dtype* data_im, const int num_spatial_axes,
     const int col_size, const int* im_shape, const int* col_shape,
@@ -0,0 +1,53 @@
+#ifndef CAFFE_UTIL_IMAGE_INDEX_HPP_
+#define CAFFE_UTIL_IMAGE_INDEX_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Compact binary index of an image listing (path + label pairs).
+ *
+ * Replaces per-entry std::string parsing of huge listing files: all paths
+ * live in one contiguous arena addressed by 32-bit offsets, so loading is
+ * three bulk reads and shuffling is Fisher-Yates over 32-bit indices
+ * instead of swapping string pairs. Built once with the build_image_index
+ * tool and detected by magic, so the same source setting accepts either
+ * format.
+ *
+ * Layout (native byte order):
+ *   char     magic[8]           "CaffeIdx"
+ *   uint32   count
+ *   int32    label[count]
+ *   uint32   offset[count + 1]  byte offsets into the path arena
+ *   char     arena[offset[count]]
+ */
+class ImageIndex {
+ public:
+  // Returns false if the file is missing or does not start with the magic;
+  // dies on a corrupt index.
+  bool Load(const string& filename);
+  static void Write(const string& filename,
+      const vector<std::pair<string, int> >& lines);
+
+  size_t size() const { return labels_.size(); }
+  string path(size_t i) const {
+    return string(arena_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+  }
+  int label(size_t i) const { return labels_[i]; }
+
+ private:
+  vector<int32_t> labels_;
+  vector<uint32_t> offsets_;
+  string arena_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IMAGE_INDEX_HPP_
@@ -5,7 +5,9 @@
 #include <iomanip>
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
+#include <vector>
 
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/message.h"
 
 #include "caffe/common.hpp"
@@ -70,6 +72,11 @@ inline void WriteProtoToTextFile(const Message& proto, const string& filename) {
 
 bool ReadProtoFromBinaryFile(const char* filename, Message* proto);
 
+// Skip one field of a binary-encoded proto, given its already-read tag.
+// Used by the streamed (bounded-memory) weight and solver state readers.
+bool SkipBinaryProtoField(google::protobuf::io::CodedInputStream* input,
+    const google::protobuf::uint32 tag);
+
 inline bool ReadProtoFromBinaryFile(const string& filename, Message* proto) {
   return ReadProtoFromBinaryFile(filename.c_str(), proto);
 }
@@ -141,6 +148,18 @@ cv::Mat ReadImageToCVMat(const string& filename,
 
 cv::Mat ReadImageToCVMat(const string& filename);
 
+// Scratch-buffer variant for hot decode loops: the file bytes, the
+// decoded image and the resized output land in caller-owned buffers
+// that keep their allocations across calls, so a steady stream of
+// same-sized images decodes without touching the allocator. Going
+// through cv::imdecode also skips imread's EXIF orientation pass.
+// cv_img may alias decode_buffer's storage when no resize is needed.
+// Returns false (leaving cv_img empty) if the file cannot be read or
+// decoded.
+bool ReadImageToCVMat(const string& filename, const int height,
+    const int width, const bool is_color, std::vector<char>* file_buffer,
+    cv::Mat* decode_buffer, cv::Mat* cv_img);
+
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
 
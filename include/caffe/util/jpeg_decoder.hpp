@@ -0,0 +1,29 @@
+#ifndef CAFFE_UTIL_JPEG_DECODER_HPP_
+#define CAFFE_UTIL_JPEG_DECODER_HPP_
+#ifdef USE_OPENCV
+
+#include <opencv2/core/core.hpp>
+
+#include <cstddef>
+
+namespace caffe {
+
+/**
+ * Decodes an in-memory JPEG with libjpeg-turbo when built with
+ * USE_TURBOJPEG, picking the smallest DCT-domain scaling factor whose
+ * output still covers min_height x min_width so oversized sources are
+ * never fully decoded. Pass min dimensions of 0 for a full-size decode.
+ *
+ * color_mode > 0 forces a 3-channel decode, 0 forces grayscale, and < 0
+ * follows the file's own colorspace (like cv::imdecode with flag -1).
+ *
+ * Returns false when the buffer is not a JPEG, decoding fails, or the
+ * build lacks libjpeg-turbo; callers then fall back to cv::imdecode.
+ */
+bool DecodeJpegToCVMat(const char* data, size_t size,
+    int min_height, int min_width, int color_mode, cv::Mat* img);
+
+}  // namespace caffe
+
+#endif  // USE_OPENCV
+#endif  // CAFFE_UTIL_JPEG_DECODER_HPP_
@@ -94,6 +94,33 @@ void caffe_log(const int n, const Dtype* a, Dtype* y);
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
+// Neuron-layer activations and their input gradients. The float versions
+// are SIMD-vectorized on x86; sigmoid and tanh then use a polynomial exp
+// accurate to a few ulps rather than bit-identical to libm.
+template <typename Dtype>
+void caffe_cpu_relu(const int n, const Dtype* x, const Dtype negative_slope,
+    Dtype* y);
+
+template <typename Dtype>
+void caffe_cpu_relu_backward(const int n, const Dtype* dy, const Dtype* x,
+    const Dtype negative_slope, Dtype* dx);
+
+template <typename Dtype>
+void caffe_cpu_sigmoid(const int n, const Dtype* x, Dtype* y);
+
+// dx from dy and the forward output y.
+template <typename Dtype>
+void caffe_cpu_sigmoid_backward(const int n, const Dtype* dy, const Dtype* y,
+    Dtype* dx);
+
+template <typename Dtype>
+void caffe_cpu_tanh(const int n, const Dtype* x, Dtype* y);
+
+// dx from dy and the forward output y.
+template <typename Dtype>
+void caffe_cpu_tanh_backward(const int n, const Dtype* dy, const Dtype* y,
+    Dtype* dx);
+
 template <typename Dtype>
 Dtype caffe_cpu_dot(const int n, const Dtype* x, const Dtype* y);
 
@@ -105,6 +132,53 @@ Dtype caffe_cpu_strided_dot(const int n, const Dtype* x, const int incx,
 template <typename Dtype>
 Dtype caffe_cpu_asum(const int n, const Dtype* x);
 
+// Computes the sum and the sum of squares of x in a single pass over the
+// data (vectorized for float); used for fused mean/variance statistics.
+template <typename Dtype>
+void caffe_cpu_sum_sumsq(const int n, const Dtype* x, Dtype* sum,
+    Dtype* sumsq);
+
+// y = log(max(x, floor)) with floor > 0, one pass (vectorized for
+// float): the clamped log the multinomial-style losses apply per
+// probability, without a scalar libm call per element.
+template <typename Dtype>
+void caffe_cpu_clipped_log(const int n, const Dtype* x, const Dtype floor,
+    Dtype* y);
+
+// Fused difference and reduction: diff = a - b and the return value is
+// the sum of squares of the difference, one pass over the inputs
+// (vectorized for float). The subtract/square/reduce of the Euclidean-
+// style losses without the two extra sweeps over the diff blob.
+template <typename Dtype>
+Dtype caffe_cpu_sub_sumsq(const int n, const Dtype* a, const Dtype* b,
+    Dtype* diff);
+
+// Per-slice reductions over a row-major (num, dim) matrix: y[i] gets the
+// sum, absolute sum or sum of squares of the i-th contiguous slice of
+// dim elements. One pass per slice (vectorized for float), replacing the
+// ones-vector dot/gemv idiom and its broadcast scratch in the reduction
+// and normalization layers.
+template <typename Dtype>
+void caffe_cpu_slice_sum(const int num, const int dim, const Dtype* x,
+    Dtype* y);
+template <typename Dtype>
+void caffe_cpu_slice_asum(const int num, const int dim, const Dtype* x,
+    Dtype* y);
+template <typename Dtype>
+void caffe_cpu_slice_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* y);
+// Fused per-slice sum and sum of squares, one read of the data: the
+// mean/variance pair for normalization layers.
+template <typename Dtype>
+void caffe_cpu_slice_sum_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* sum, Dtype* sumsq);
+// Per-slice caffe_cpu_sub_sumsq: diff = a - b and sumsq[i] the squared
+// distance of the i-th pair of dim-element slices; the batched distance
+// pass of the contrastive loss.
+template <typename Dtype>
+void caffe_cpu_slice_sub_sumsq(const int num, const int dim, const Dtype* a,
+    const Dtype* b, Dtype* diff, Dtype* sumsq);
+
 // the branchless, type-safe version from
 // http://stackoverflow.com/questions/1903954/is-there-a-standard-sign-function-signum-sgn-in-c-c
 template<typename Dtype>
@@ -142,6 +216,12 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]));
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// y[i] = alpha * x[i] + beta: one fused pass (SIMD for float) where a
+// scale followed by a broadcast bias add would take two.
+template <typename Dtype>
+void caffe_cpu_axpb(const int n, const Dtype alpha, const Dtype* x,
+    const Dtype beta, Dtype* y);
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
@@ -153,6 +233,17 @@ void caffe_gpu_gemm(const CBLAS_TRANSPOSE TransA,
     const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
     Dtype* C);
 
+// Batched gemm over `batch` independent problems whose operands sit at
+// constant strides from each other, e.g. the per-group products of a
+// grouped convolution. One cublas call (strided-batched on CUDA 8+)
+// instead of `batch` launches of tiny kernels.
+template <typename Dtype>
+void caffe_gpu_gemm_batched(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const int stride_A,
+    const Dtype* B, const int stride_B, const Dtype beta,
+    Dtype* C, const int stride_C, const int batch);
+
 template <typename Dtype>
 void caffe_gpu_gemv(const CBLAS_TRANSPOSE TransA, const int M, const int N,
     const Dtype alpha, const Dtype* A, const Dtype* x, const Dtype beta,
@@ -231,9 +322,71 @@ void caffe_gpu_rng_bernoulli(const int n, const Dtype p, int* r);
 template <typename Dtype>
 void caffe_gpu_dot(const int n, const Dtype* x, const Dtype* y, Dtype* out);
 
+// Like caffe_gpu_dot, but out points to device memory and the call does
+// not synchronize the stream (cuBLAS device pointer mode); use for
+// scalar results read back asynchronously, e.g. the per-iteration loss.
+template <typename Dtype>
+void caffe_gpu_dot_device(const int n, const Dtype* x, const Dtype* y,
+    Dtype* out);
+
+// Device-side out[0] = x[0] * y[0]; the scalar special case of
+// caffe_gpu_dot_device without the cuBLAS pointer-mode round trip.
+// Loss tops are almost always single scalars, so this is their path.
+template <typename Dtype>
+void caffe_gpu_scalar_mul_device(const Dtype* x, const Dtype* y, Dtype* out);
+
 template <typename Dtype>
 void caffe_gpu_asum(const int n, const Dtype* x, Dtype* y);
 
+// Like caffe_gpu_asum, but y points to device memory and the call does
+// not synchronize the stream; use to batch many reductions into one
+// readback, e.g. sampled debug-info asums.
+template <typename Dtype>
+void caffe_gpu_asum_device(const int n, const Dtype* x, Dtype* y);
+
+// Sets out[0] nonzero if any of the n values is NaN or infinite; never
+// clears it and does not synchronize, so it is cheap enough to run
+// every iteration and read back only occasionally.
+template <typename Dtype>
+void caffe_gpu_nonfinite_check(const int n, const Dtype* x, int* out);
+
+// Adds the sum of squares of x into the device scalar acc (which the
+// caller zeroes first) with a single-pass warp-shuffle reduction and no
+// host synchronization, so norms spanning many blobs -- e.g. the
+// gradient norm in SGDSolver::ClipGradients -- batch into one readback.
+template <typename Dtype>
+void caffe_gpu_sumsq_acc(const int n, const Dtype* x, Dtype* acc);
+
+// Fused diff = a - b plus sum of squares of the difference into the
+// device scalar acc (which the caller zeroes first): the Euclidean loss
+// forward in one kernel instead of a subtract pass and a dot.
+template <typename Dtype>
+void caffe_gpu_sub_sumsq_acc(const int n, const Dtype* a, const Dtype* b,
+    Dtype* diff, Dtype* acc);
+
+// Per-slice reductions over a row-major (num, dim) matrix, one block
+// per slice with a shuffle-based tree inside the block: all slices
+// reduce in a single launch, results stay on the device and no
+// temporaries are needed. GPU counterparts of caffe_cpu_slice_*.
+template <typename Dtype>
+void caffe_gpu_slice_sum(const int num, const int dim, const Dtype* x,
+    Dtype* y);
+template <typename Dtype>
+void caffe_gpu_slice_asum(const int num, const int dim, const Dtype* x,
+    Dtype* y);
+template <typename Dtype>
+void caffe_gpu_slice_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* y);
+template <typename Dtype>
+void caffe_gpu_slice_sum_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* sum, Dtype* sumsq);
+// Per-pair diff = a - b and squared distance per dim-element slice, one
+// block per slice; the contrastive loss distance pass without the
+// squared-diff scratch and ones-vector gemv.
+template <typename Dtype>
+void caffe_gpu_slice_sub_sumsq(const int num, const int dim, const Dtype* a,
+    const Dtype* b, Dtype* diff, Dtype* sumsq);
+
 template<typename Dtype>
 void caffe_gpu_sign(const int n, const Dtype* x, Dtype* y);
 
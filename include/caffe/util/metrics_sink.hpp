@@ -0,0 +1,72 @@
+#ifndef CAFFE_UTIL_METRICS_SINK_HPP_
+#define CAFFE_UTIL_METRICS_SINK_HPP_
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A structured training-metrics log: rows are appended to an
+ *        in-memory ring buffer and a background thread batches them
+ *        out to a CSV (or, with a .json filename, JSON-lines) file.
+ *
+ * Per-iteration LOG(INFO) formatting of every output blob is
+ * measurable on the solver thread at small display intervals, and the
+ * resulting text logs have to be parsed back apart. Append only copies
+ * a few floats under a mutex; all formatting and I/O happen on the
+ * flusher thread. If the writer outruns the flusher, rows are dropped
+ * and the drop count reported, rather than ever blocking training.
+ *
+ * Columns are registered up front with AddColumn and frozen by the
+ * first Append; every row carries one value per column.
+ */
+class MetricsSink {
+ public:
+  explicit MetricsSink(const string& filename);
+  ~MetricsSink();
+
+  /// Registers a column (idempotent) and returns its index. All
+  /// columns must be registered before the first Append.
+  int AddColumn(const string& name);
+  /// Copies one row into the ring buffer; never formats or blocks on
+  /// I/O. values must hold one entry per registered column.
+  void Append(int iter, const vector<float>& values);
+
+ private:
+  struct Row {
+    int iter;
+    vector<float> values;
+  };
+  // Synchronization fields and the flusher thread live out of line, as
+  // in BlockingQueue, so this header stays clear of boost/thread.hpp.
+  class sync;
+
+  void FlushThread();
+  /// Formats and writes rows; called only from the flusher thread.
+  void WriteRows(const vector<Row>& rows);
+
+  string filename_;
+  bool json_;
+  std::ofstream file_;
+  vector<string> columns_;
+  map<string, int> column_indices_;
+  bool columns_frozen_;
+  // Ring buffer guarded by the sync mutex; the flusher drains it on a
+  // timer or when woken by a half-full Append.
+  vector<Row> ring_;
+  size_t ring_begin_, ring_size_;
+  size_t dropped_;
+  bool stop_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(MetricsSink);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_METRICS_SINK_HPP_
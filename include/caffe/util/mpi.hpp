@@ -0,0 +1,29 @@
+#ifndef CAFFE_UTIL_MPI_H_
+#define CAFFE_UTIL_MPI_H_
+#ifdef USE_MPI
+
+#include <mpi.h>
+
+#include "caffe/common.hpp"
+
+#define MPI_CHECK(condition) \
+{ \
+  int result = condition; \
+  CHECK_EQ(result, MPI_SUCCESS) << " MPI error " << result; \
+}
+
+namespace caffe {
+
+namespace mpi {
+
+template <typename Dtype> MPI_Datatype dataType();
+
+template <> inline MPI_Datatype dataType<float>() { return MPI_FLOAT; }
+template <> inline MPI_Datatype dataType<double>() { return MPI_DOUBLE; }
+
+}  // namespace mpi
+
+}  // namespace caffe
+
+#endif  // USE_MPI
+#endif  // CAFFE_UTIL_MPI_H_
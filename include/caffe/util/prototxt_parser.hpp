@@ -0,0 +1,22 @@
+#ifndef CAFFE_UTIL_PROTOTXT_PARSER_H_
+#define CAFFE_UTIL_PROTOTXT_PARSER_H_
+
+#include <google/protobuf/message.h>
+
+#include <string>
+
+namespace caffe {
+
+// Single-pass reflection-driven parser for the prototxt subset our model
+// definitions use: `field: value` and `field { ... }` entries, comments,
+// quoted strings with simple escapes, and enums by name or number. On
+// machine-generated nets with thousands of layers this is several times
+// faster than google::protobuf::TextFormat. Returns false on anything
+// outside the subset (unknown fields, list syntax, exotic escapes); the
+// caller should then Clear() the message and retry with TextFormat.
+bool ParsePrototxtFast(const std::string& text,
+    google::protobuf::Message* message);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PROTOTXT_PARSER_H_
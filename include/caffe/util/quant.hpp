@@ -0,0 +1,112 @@
+#ifndef CAFFE_UTIL_QUANT_H_
+#define CAFFE_UTIL_QUANT_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Symmetric linear int8 quantization for the CPU inference path
+// (QuantizationParameter). Values quantize as q = round(x / scale)
+// clamped to [-127, 127], so a scale of max|x| / 127 loses nothing to
+// clipping and dequantization is a single multiply.
+
+template <typename Dtype>
+Dtype caffe_cpu_max_abs(const int n, const Dtype* x);
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const Dtype scale,
+    int8_t* y);
+
+// C = A * B^T with int8 operands and int32 accumulation: A is M x K and
+// B is N x K, both row major -- the layout InnerProductLayer stores its
+// weights in. Every inner loop runs contiguously over K, so compilers
+// vectorize it; on int8 dot-product hardware the same loop compiles to
+// int8 multiply-accumulates.
+void caffe_cpu_igemm_nt(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int* C);
+
+// C = A * B with A M x K and B K x N, the weights-times-im2col shape
+// convolution uses. Accumulates rank-1 updates over K so B and C are
+// both walked contiguously.
+void caffe_cpu_igemm_nn(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int* C);
+
+/**
+ * @brief Per-layer state for the int8 forward path: lazily quantized
+ *        weights (one symmetric scale per output channel) plus an
+ *        activation scale calibrated from the inputs of the first
+ *        calibration_iters forward passes, which still run in float.
+ */
+template <typename Dtype>
+class QuantState {
+ public:
+  QuantState()
+      : enabled_(false), ready_(false), weights_ready_(false),
+        calibration_left_(0), input_max_(0), input_scale_(0) {}
+
+  void Init(const QuantizationParameter& param) {
+    enabled_ = param.enabled();
+    calibration_left_ = std::max(1u, param.calibration_iters());
+  }
+
+  bool enabled() const { return enabled_; }
+
+  // True once calibration finished and the weights are quantized, i.e.
+  // the int8 path can run without touching calibration state. Safe to
+  // poll from concurrent workers while ObserveInput/QuantizeWeights stay
+  // on the dispatching thread.
+  bool active() const { return enabled_ && ready_ && weights_ready_; }
+
+  // Folds one forward's input range into the calibration. Returns true
+  // once calibration is complete and the int8 path should be taken;
+  // the completing pass itself still computes in float, since its input
+  // was needed to fix the scale.
+  bool ObserveInput(const int n, const Dtype* x);
+
+  // Quantizes a rows x cols row-major weight matrix, one scale per row
+  // (output channel). Runs once; inference weights are static.
+  void QuantizeWeights(const int rows, const int cols, const Dtype* w);
+
+  void QuantizeInput(const int n, const Dtype* x, int8_t* y) const {
+    caffe_cpu_quantize(n, x, input_scale_, y);
+  }
+
+  const int8_t* weights() const { return &weights_q_[0]; }
+  Dtype weight_scale(const int row) const { return weight_scales_[row]; }
+  Dtype input_scale() const { return input_scale_; }
+
+  // Scratch reused across forwards so the quantized path allocates only
+  // on growth, like Caffe's other lazily sized buffers.
+  int8_t* input_buffer(const int n) {
+    if (input_q_.size() < static_cast<size_t>(n)) { input_q_.resize(n); }
+    return &input_q_[0];
+  }
+  int* acc_buffer(const int n) {
+    if (acc_.size() < static_cast<size_t>(n)) { acc_.resize(n); }
+    return &acc_[0];
+  }
+
+ private:
+  bool enabled_;
+  bool ready_;
+  bool weights_ready_;
+  unsigned int calibration_left_;
+  Dtype input_max_;
+  Dtype input_scale_;
+  std::vector<int8_t> weights_q_;
+  std::vector<Dtype> weight_scales_;
+  std::vector<int8_t> input_q_;
+  std::vector<int> acc_;
+
+  DISABLE_COPY_AND_ASSIGN(QuantState);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANT_H_
@@ -0,0 +1,87 @@
+#ifndef CAFFE_UTIL_SHARED_WEIGHTS_HPP_
+#define CAFFE_UTIL_SHARED_WEIGHTS_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Publishes a net's weights in a POSIX shared memory segment so
+ *        evaluator processes on the same machine can map them read-only
+ *        instead of round-tripping snapshot files through disk.
+ *
+ * Layout: a small header (magic, element count and size, generation
+ * counter) followed by the learnable params flattened in net order --
+ * the same order Params<Dtype> uses. Publishing is a seqlock: the
+ * generation is bumped to an odd value before the payload is rewritten
+ * and to the next even value after, so a reader that sees the same even
+ * generation before and after a forward pass knows it evaluated one
+ * consistent set of weights.
+ *
+ * A bare name ("/caffe_weights") is a POSIX shm object; a name with a
+ * directory component ("/models/net.caffemodel.cache") is backed by
+ * that file, so the payload survives the publisher and later mappers
+ * share the same page-cache pages.
+ *
+ * The evaluating side maps with Net::MapSharedWeights, which points the
+ * net's params straight into the segment (zero-copy). In GPU mode call
+ * it again before each evaluation pass: remapping invalidates the
+ * device-side copies SyncedMemory caches, which cannot see the
+ * publisher writing behind them.
+ */
+template <typename Dtype>
+class SharedWeights {
+ public:
+  ~SharedWeights();
+
+  /// Creates (or replaces) the segment; the publishing side.
+  static shared_ptr<SharedWeights> Create(const string& name, size_t count);
+  /// Creates the segment only if it does not exist yet; returns an empty
+  /// pointer when another process got there first. Lets a fleet of
+  /// identical workers elect one loader, with the rest waiting on
+  /// OpenWhenReady.
+  static shared_ptr<SharedWeights> CreateExclusive(const string& name,
+      size_t count);
+  /// Maps an existing segment read-only; the evaluating side.
+  static shared_ptr<SharedWeights> Open(const string& name);
+  /// Like Open, but blocks until the segment exists and holds a complete
+  /// payload (nonzero even generation).
+  static shared_ptr<SharedWeights> OpenWhenReady(const string& name);
+
+  /// Copies the blobs, flattened in order, into the segment under the
+  /// seqlock. Blob counts must sum to count().
+  void Publish(const vector<Blob<Dtype>*>& params);
+
+  size_t count() const { return count_; }
+  /// Seqlock generation; odd while a publish is in progress.
+  uint64_t generation() const;
+  const Dtype* data() const { return data_; }
+
+ private:
+  struct Header;
+
+  SharedWeights(const string& name, bool owner);
+  /// Sizes, maps and initializes a freshly created segment.
+  void MapCreated(size_t count);
+
+  string name_;
+  bool owner_;  // whether this side created (and unlinks) the segment
+  int fd_;
+  void* mapped_;
+  size_t mapped_size_;
+  size_t count_;
+  Dtype* data_;
+  Header* header_;
+
+DISABLE_COPY_AND_ASSIGN(SharedWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SHARED_WEIGHTS_HPP_
@@ -13,6 +13,17 @@ class SignalHandler {
                 SolverAction::Enum SIGHUP_action);
   ~SignalHandler();
   ActionCallback GetActionFunction();
+  // True once per received SIGUSR1, which toggles chrome-trace capture
+  // (see ChromeTrace); polled by the solver loop.
+  static bool GotTraceRequest();
+  // True once per received SIGUSR2, which toggles layer profiling on
+  // the training net; polled by the solver loop.
+  static bool GotProfileRequest();
+  // Whether an action signal (SIGINT/SIGHUP) has arrived and not yet
+  // been consumed: one flag load, so the solver can poll it every
+  // iteration and only go through its action callback on a hit. Always
+  // true while no handler is hooked up.
+  static bool ActionPending();
  private:
   SolverAction::Enum CheckForSignals() const;
   SolverAction::Enum SIGINT_action_;
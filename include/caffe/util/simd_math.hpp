@@ -0,0 +1,62 @@
+#ifndef CAFFE_UTIL_SIMD_MATH_H_
+#define CAFFE_UTIL_SIMD_MATH_H_
+
+// Hand-vectorized element-wise kernels for builds without MKL. OpenBLAS
+// covers the BLAS entry points but the vs* loops in mkl_alternate.hpp
+// stay scalar at -O2, and they feed LRN, BatchNorm and the loss layers.
+// The implementations carry per-function target attributes (AVX2+FMA and
+// AVX-512F) and pick a version at runtime from cpuid, so no special
+// compiler flags are needed and the binary still runs on older machines.
+// Only the float kernels are vectorized; double traffic through these
+// entry points is negligible.
+
+#if !defined(USE_MKL) && defined(__GNUC__) && defined(__x86_64__)
+#define CAFFE_SIMD_MATH
+#endif
+
+#ifdef CAFFE_SIMD_MATH
+
+namespace caffe {
+
+void caffe_simd_sqr(const int n, const float* a, float* y);
+void caffe_simd_exp(const int n, const float* a, float* y);
+// y = log(max(x, floor)) with floor > 0: the clamped log of the
+// cross-entropy style losses, fused so the clamp costs nothing and the
+// log runs 8/16-wide instead of a libm call per element.
+void caffe_simd_clipped_log(const int n, const float* x, const float floor,
+    float* y);
+// Single-pass sum and sum-of-squares reduction; one read of the data
+// where a square into scratch plus two reductions would take three.
+void caffe_simd_sum_sumsq(const int n, const float* x, float* sum,
+    float* sumsq);
+// diff = a - b and sum of squares of the difference in one pass: the
+// subtract, square and reduce of the Euclidean-style losses fused so
+// the difference is read back out of registers instead of memory.
+void caffe_simd_sub_sumsq(const int n, const float* a, const float* b,
+    float* diff, float* sumsq);
+// y = a * x + b with broadcast scalars; the fused multiply-add behind
+// ScaleLayer's combined scale+bias forward.
+void caffe_simd_axpb(const int n, const float a, const float* x,
+    const float b, float* y);
+void caffe_simd_add(const int n, const float* a, const float* b, float* y);
+void caffe_simd_sub(const int n, const float* a, const float* b, float* y);
+void caffe_simd_mul(const int n, const float* a, const float* b, float* y);
+void caffe_simd_div(const int n, const float* a, const float* b, float* y);
+
+// Neuron-layer kernels. The sigmoid and tanh forwards use the same
+// polynomial exp as caffe_simd_exp, accurate to a few ulps.
+void caffe_simd_relu(const int n, const float* x, const float negative_slope,
+    float* y);
+void caffe_simd_relu_backward(const int n, const float* dy, const float* x,
+    const float negative_slope, float* dx);
+void caffe_simd_sigmoid(const int n, const float* x, float* y);
+void caffe_simd_sigmoid_backward(const int n, const float* dy,
+    const float* y, float* dx);
+void caffe_simd_tanh(const int n, const float* x, float* y);
+void caffe_simd_tanh_backward(const int n, const float* dy, const float* y,
+    float* dx);
+
+}  // namespace caffe
+
+#endif  // CAFFE_SIMD_MATH
+#endif  // CAFFE_UTIL_SIMD_MATH_H_
@@ -7,12 +7,26 @@
 
 namespace caffe {
 
+// The current net schema: V2 LayerParameter with transform_param messages
+// and Input layers. Nets whose schema_version field carries this value
+// (stamped by UpgradeNetAsNeeded and Net::ToProto) skip the per-layer
+// deprecation scans on load.
+const int kCurrentNetSchemaVersion = 2;
+
 // Return true iff the net is not the current version.
 bool NetNeedsUpgrade(const NetParameter& net_param);
 
 // Check for deprecations and upgrade the NetParameter as needed.
 bool UpgradeNetAsNeeded(const string& param_file, NetParameter* param);
 
+// Enable or disable the binary NetParameterCache consulted by
+// ReadNetParamsFromTextFileOrDie. With the cache on, the fully-upgraded
+// NetParameter is stored beside the prototxt (<file>.netcache) keyed by
+// a hash of the text, so unchanged files skip the parse and upgrade
+// passes; edits invalidate the cache automatically. Off by default; the
+// caffe command line turns it on.
+void EnableNetParameterCache(bool enable);
+
 // Read parameters from a file into a NetParameter proto message.
 void ReadNetParamsFromTextFileOrDie(const string& param_file,
                                     NetParameter* param);
@@ -0,0 +1,73 @@
+#ifndef CAFFE_UTIL_WORKER_POOL_HPP_
+#define CAFFE_UTIL_WORKER_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+class WorkerPoolImpl;
+
+/**
+ * @brief Ticket for a task submitted to the WorkerPool.
+ *
+ * Interrupt() forwards a boost interruption request to the worker
+ * running the task (a no-op once it finished), which is how long-lived
+ * tasks like InternalThread loops are asked to wind down. Join()
+ * blocks until the task has returned.
+ */
+class WorkerHandle {
+ public:
+  ~WorkerHandle();
+  void Interrupt();
+  void Join();
+  bool done();
+
+ private:
+  friend class WorkerPoolImpl;
+  WorkerHandle();
+  class State;
+  shared_ptr<State> state_;
+
+  DISABLE_COPY_AND_ASSIGN(WorkerHandle);
+};
+
+/**
+ * @brief Process-wide cached worker pool shared by every thread source
+ *        in Caffe.
+ *
+ * InternalThread (data-layer prefetch, parallel readers) and the
+ * chunked level-1 math loops used to each spawn their own
+ * boost::threads: restarts paid thread create/teardown plus cold
+ * caches, and independent sources oversubscribed the machine. The pool
+ * keeps finished workers parked and grows only when a task is
+ * submitted and no worker is idle, so long-running tasks (a prefetch
+ * loop runs for the life of its layer) never starve short ones and the
+ * process converges on one stable set of threads.
+ *
+ * Workers re-run Caffe thread-local setup per task where needed (see
+ * InternalThread::entry); a pending interruption is consumed between
+ * tasks so it cannot leak from one task into the next.
+ */
+class WorkerPool {
+ public:
+  /// Runs task on an idle worker, spawning one if none is free.
+  static shared_ptr<WorkerHandle> Submit(
+      const boost::function<void()>& task);
+
+  /**
+   * Pins workers spawned from now on to the given CPUs, round-robin
+   * over the list (Linux only; ignored elsewhere). With the NUMA_LOCAL
+   * policy this also keeps their Batch buffers on the matching socket,
+   * since pages are bound at allocation by the pinned thread. Existing
+   * workers keep their affinity.
+   */
+  static void SetAffinity(const std::vector<int>& cpus);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WORKER_POOL_HPP_
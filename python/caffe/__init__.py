@@ -6,3 +6,4 @@ from .classifier import Classifier
 from .detector import Detector
 from . import io
 from .net_spec import layers, params, NetSpec, to_proto
+from .batch_pool import BatchPool
@@ -73,6 +73,35 @@ void CheckContiguousArray(PyArrayObject* arr, string name,
   }
 }
 
+// Releases the GIL for the duration of a long-running C++ call so that
+// other Python threads keep running, which is what makes thread-based
+// serving from Python worthwhile. PythonLayer re-acquires the GIL
+// around its callbacks (see python_layer.hpp), so nets with Python
+// layers stay safe under released-GIL calls.
+class PyGILRelease {
+ public:
+  PyGILRelease() : state_(PyEval_SaveThread()) {}
+  ~PyGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+};
+
+Dtype Net_ForwardFromTo(Net<Dtype>* net, int start, int end) {
+  PyGILRelease gil;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_BackwardFromTo(Net<Dtype>* net, int start, int end) {
+  PyGILRelease gil;
+  net->BackwardFromTo(start, end);
+}
+
+void Solver_Step(Solver<Dtype>* solver, int iters) {
+  PyGILRelease gil;
+  solver->Step(iters);
+}
+
 // Net constructor for passing phase as int
 shared_ptr<Net<Dtype> > Net_Init(
     string param_file, int phase) {
@@ -178,6 +207,39 @@ struct NdarrayCallPolicies : public bp::default_call_policies {
   }
 };
 
+// Zero-copy input binding: alias the array's memory as the blob's CPU
+// data instead of copying into blob storage. The blob takes the array's
+// shape; the binding (with_custodian_and_ward below) keeps the array
+// alive as long as the blob. The caller must not resize or reassign the
+// array's buffer while it is bound.
+void Blob_BindData(Blob<Dtype>* blob, bp::object data_obj) {
+  if (!PyArray_Check(data_obj.ptr())) {
+    throw std::runtime_error("bind_data requires a numpy array; pass "
+        "np.ascontiguousarray(arr, dtype=np.float32) for other buffers");
+  }
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(data_obj.ptr());
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)) {
+    throw std::runtime_error("bind_data array must be C contiguous");
+  }
+  if (PyArray_TYPE(arr) != NPY_FLOAT32) {
+    throw std::runtime_error("bind_data array must be float32");
+  }
+  vector<int> shape(PyArray_NDIM(arr));
+  for (int i = 0; i < PyArray_NDIM(arr); ++i) {
+    shape[i] = PyArray_DIMS(arr)[i];
+  }
+  blob->Reshape(shape);
+  blob->set_cpu_data(static_cast<Dtype*>(PyArray_DATA(arr)));
+}
+
+// Address of the blob's CPU data, exposed so Python-side caches can
+// tell cheaply whether a previously built ndarray view still aliases
+// the blob's storage (reshape may reallocate). Syncs the data to the
+// host, like Blob.data does.
+size_t Blob_DataPtr(Blob<Dtype>* blob) {
+  return reinterpret_cast<size_t>(blob->cpu_data());
+}
+
 bp::object Blob_Reshape(bp::tuple args, bp::dict kwargs) {
   if (bp::len(kwargs) > 0) {
     throw std::runtime_error("Blob.reshape takes no kwargs");
@@ -226,8 +288,9 @@ BOOST_PYTHON_MODULE(_caffe) {
     bp::no_init)
     .def("__init__", bp::make_constructor(&Net_Init))
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
+    // GIL-releasing wrappers: the whole pass runs without the GIL.
+    .def("_forward", &Net_ForwardFromTo)
+    .def("_backward", &Net_BackwardFromTo)
     .def("reshape", &Net<Dtype>::Reshape)
     // The cast is to select a particular overload.
     .def("copy_from", static_cast<void (Net<Dtype>::*)(const string)>(
@@ -271,6 +334,9 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("count",    static_cast<int (Blob<Dtype>::*)() const>(
         &Blob<Dtype>::count))
     .def("reshape",           bp::raw_function(&Blob_Reshape))
+    .def("bind_data",         &Blob_BindData,
+        bp::with_custodian_and_ward<1, 2>())
+    .add_property("data_ptr", &Blob_DataPtr)
     .add_property("data",     bp::make_function(&Blob<Dtype>::mutable_cpu_data,
           NdarrayCallPolicies()))
     .add_property("diff",     bp::make_function(&Blob<Dtype>::mutable_cpu_diff,
@@ -296,7 +362,7 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("iter", &Solver<Dtype>::iter)
     .def("solve", static_cast<void (Solver<Dtype>::*)(const char*)>(
           &Solver<Dtype>::Solve), SolveOverloads())
-    .def("step", &Solver<Dtype>::Step)
+    .def("step", &Solver_Step)
     .def("restore", &Solver<Dtype>::Restore)
     .def("snapshot", &Solver<Dtype>::Snapshot);
   bp::register_ptr_to_python<shared_ptr<Solver<Dtype> > >();
@@ -0,0 +1,90 @@
+"""
+Fork-based worker pool with shared-memory batch transport for Python
+data layers.
+
+A data-producing PythonLayer runs on the net's prefetch thread and
+holds the GIL for its whole forward, so augmentation written in Python
+serializes with the main process no matter how many threads run.
+BatchPool moves the batch-producing function into forked worker
+processes that fill a ring of shared-memory buffers; the layer's
+forward just takes the next filled slot and copies it into its tops.
+
+Example, inside a PythonLayer producing a 32-image batch with labels:
+
+    def setup(self, bottom, top):
+        shapes = [(32, 3, 224, 224), (32,)]
+        self.pool = caffe.BatchPool(fill_batch, shapes, workers=4)
+
+    def forward(self, bottom, top):
+        arrays, token = self.pool.get()
+        for i, arr in enumerate(arrays):
+            top[i].data[...] = arr
+        self.pool.put(token)
+
+fill_batch(arrays) is called in a worker process and must fill the
+given list of float32 arrays in place. Batches are delivered in
+completion order, not submission order, so workers must draw their own
+samples (e.g. seed from os.getpid()) rather than share a cursor.
+"""
+
+import multiprocessing as mp
+from multiprocessing import sharedctypes
+
+import numpy as np
+
+
+class BatchPool(object):
+    def __init__(self, fill_fn, shapes, workers=2, slots=None):
+        """
+        Start `workers` forked processes that keep a ring of `slots`
+        shared-memory batches (default 2 * workers) filled by calling
+        fill_fn(arrays), where arrays has one float32 ndarray per entry
+        of `shapes`.
+        """
+        if slots is None:
+            slots = 2 * workers
+        self._shapes = [tuple(s) for s in shapes]
+        self._slots = [[sharedctypes.RawArray('f', int(np.prod(s)))
+                        for s in self._shapes] for _ in range(slots)]
+        self._free = mp.Queue()
+        self._full = mp.Queue()
+        for i in range(slots):
+            self._free.put(i)
+        self._workers = []
+        for _ in range(workers):
+            w = mp.Process(target=self._work, args=(fill_fn,))
+            w.daemon = True
+            w.start()
+            self._workers.append(w)
+
+    def _views(self, slot):
+        return [np.frombuffer(buf, dtype=np.float32).reshape(shape)
+                for buf, shape in zip(self._slots[slot], self._shapes)]
+
+    def _work(self, fill_fn):
+        while True:
+            slot = self._free.get()
+            if slot is None:
+                break
+            fill_fn(self._views(slot))
+            self._full.put(slot)
+
+    def get(self):
+        """
+        Return (arrays, token) for the next filled batch, blocking
+        until one is ready. The arrays are shared-memory views that
+        stay valid until put(token) hands the slot back.
+        """
+        slot = self._full.get()
+        return self._views(slot), slot
+
+    def put(self, token):
+        """Return a consumed slot to the workers for refilling."""
+        self._free.put(token)
+
+    def stop(self):
+        """Shut the workers down; slots in flight are dropped."""
+        for _ in self._workers:
+            self._free.put(None)
+        for w in self._workers:
+            w.join()
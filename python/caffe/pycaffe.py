@@ -27,7 +27,9 @@ def _Net_blobs(self):
     An OrderedDict (bottom to top, i.e., input to output) of network
     blobs indexed by name
     """
-    return OrderedDict(zip(self._blob_names, self._blobs))
+    if not hasattr(self, '_blobs_dict'):
+        self._blobs_dict = OrderedDict(zip(self._blob_names, self._blobs))
+    return self._blobs_dict
 
 
 @property
@@ -36,7 +38,10 @@ def _Net_blob_loss_weights(self):
     An OrderedDict (bottom to top, i.e., input to output) of network
     blob loss weights indexed by name
     """
-    return OrderedDict(zip(self._blob_names, self._blob_loss_weights))
+    if not hasattr(self, '_blob_loss_weights_dict'):
+        self._blob_loss_weights_dict = OrderedDict(
+            zip(self._blob_names, self._blob_loss_weights))
+    return self._blob_loss_weights_dict
 
 
 @property
@@ -46,9 +51,12 @@ def _Net_params(self):
     parameters indexed by name; each is a list of multiple blobs (e.g.,
     weights and biases)
     """
-    return OrderedDict([(name, lr.blobs)
-                        for name, lr in zip(self._layer_names, self.layers)
-                        if len(lr.blobs) > 0])
+    if not hasattr(self, '_params_dict'):
+        self._params_dict = OrderedDict(
+            [(name, lr.blobs)
+             for name, lr in zip(self._layer_names, self.layers)
+             if len(lr.blobs) > 0])
+    return self._params_dict
 
 
 @property
@@ -61,6 +69,26 @@ def _Net_outputs(self):
     return [list(self.blobs.keys())[i] for i in self._outputs]
 
 
+def _Net_get_blob_data(self, names):
+    """
+    Return a list with the data ndarray of each named blob, reusing a
+    cached view as long as the blob's shape and storage are unchanged
+    (checked via Blob.data_ptr). This keeps tight monitoring loops from
+    constructing a fresh ndarray wrapper on every access.
+    """
+    views = self.__dict__.setdefault('_blob_data_views', {})
+    arrays = []
+    for name in names:
+        blob = self.blobs[name]
+        key = (blob.data_ptr, tuple(blob.shape))
+        cached = views.get(name)
+        if cached is None or cached[0] != key:
+            cached = (key, blob.data)
+            views[name] = cached
+        arrays.append(cached[1])
+    return arrays
+
+
 def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     """
     Forward pass: prepare inputs and run the net forward.
@@ -98,11 +126,16 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
         if set(kwargs.keys()) != set(self.inputs):
             raise Exception('Input blob arguments do not match net inputs.')
         # Set input according to defined shapes and make arrays single and
-        # C-contiguous as Caffe expects.
+        # C-contiguous as Caffe expects. Arrays that already are get
+        # bound zero-copy instead of copied into blob storage.
         for in_, blob in six.iteritems(kwargs):
             if blob.shape[0] != self.blobs[in_].shape[0]:
                 raise Exception('Input is not batch sized')
-            self.blobs[in_].data[...] = blob
+            if (isinstance(blob, np.ndarray) and blob.dtype == np.float32
+                    and blob.flags['C_CONTIGUOUS']):
+                self.blobs[in_].bind_data(blob)
+            else:
+                self.blobs[in_].data[...] = blob
 
     self._forward(start_ind, end_ind)
 
@@ -298,6 +331,7 @@ class _Net_IdNameWrapper:
 Net.blobs = _Net_blobs
 Net.blob_loss_weights = _Net_blob_loss_weights
 Net.params = _Net_params
+Net.get_blob_data = _Net_get_blob_data
 Net.forward = _Net_forward
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
@@ -0,0 +1,24 @@
+import unittest
+
+import numpy as np
+
+import caffe
+
+
+def fill_batch(arrays):
+    arrays[0][...] = np.arange(arrays[0].size,
+                               dtype=np.float32).reshape(arrays[0].shape)
+    arrays[1][...] = 7
+
+
+class TestBatchPool(unittest.TestCase):
+    def test_round_trip(self):
+        pool = caffe.BatchPool(fill_batch, [(2, 3), (2,)], workers=2)
+        expected = np.arange(6, dtype=np.float32).reshape(2, 3)
+        for _ in range(8):
+            arrays, token = pool.get()
+            self.assertEqual(arrays[0].shape, (2, 3))
+            self.assertTrue((arrays[0] == expected).all())
+            self.assertTrue((arrays[1] == 7).all())
+            pool.put(token)
+        pool.stop()
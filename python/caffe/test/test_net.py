@@ -63,6 +63,33 @@ class TestNet(unittest.TestCase):
         self.net.forward()
         self.net.backward()
 
+    def test_get_blob_data(self):
+        """get_blob_data reuses ndarray views until a blob changes"""
+
+        first = self.net.get_blob_data(['ip'])[0]
+        again = self.net.get_blob_data(['ip'])[0]
+        self.assertIs(first, again)
+        self.assertTrue((first == self.net.blobs['ip'].data).all())
+        self.net.blobs['ip'].reshape(2, self.num_output)
+        rebuilt = self.net.get_blob_data(['ip'])[0]
+        self.assertIsNot(first, rebuilt)
+        self.assertEqual(rebuilt.shape, (2, self.num_output))
+
+    def test_bind_data(self):
+        """Blob.bind_data aliases the array instead of copying it."""
+
+        blob = self.net.blobs['ip']
+        arr = np.arange(blob.data.size,
+                        dtype=np.float32).reshape(blob.data.shape)
+        blob.bind_data(arr)
+        self.assertTrue((blob.data == arr).all())
+        blob.data[0, 0] = -1
+        self.assertEqual(arr[0, 0], -1)
+        # only float32 C-contiguous arrays may be bound
+        self.assertRaises(RuntimeError, blob.bind_data,
+                          arr.astype(np.float64))
+        self.assertRaises(RuntimeError, blob.bind_data, arr.T)
+
     def test_inputs_outputs(self):
         self.assertEqual(self.net.inputs, [])
         self.assertEqual(self.net.outputs, ['loss'])
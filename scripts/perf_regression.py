@@ -0,0 +1,125 @@
+#!/usr/bin/env python
+"""Performance regression gate over the bundled reference nets.
+
+Runs `caffe time` on each model's deploy prototxt several times, takes
+the median per-layer forward and backward time across runs, and compares
+against a committed baseline. Layers more than --threshold slower than
+baseline fail the run; use --update after an intentional change (or on a
+new machine) to rewrite the baseline.
+
+Usage (see the `runbench` make target):
+    python scripts/perf_regression.py --caffe_bin build/tools/caffe \
+        [--update] [--gpu 0] [--baseline perf_baseline.json]
+"""
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+default_models = [
+    'models/bvlc_reference_caffenet/deploy.prototxt',
+    'models/bvlc_alexnet/deploy.prototxt',
+    'models/bvlc_googlenet/deploy.prototxt',
+]
+
+# "    conv1\tforward: 12.34 ms." lines from `caffe time`.
+layer_time_re = re.compile(
+    r'\s(\S+)\s+(forward|backward): ([0-9.]+) ms\.')
+
+
+def run_once(args, model):
+    """Runs `caffe time` once; returns {(layer, direction): ms}."""
+    cmd = [args.caffe_bin, 'time', '--model=' + model,
+           '--iterations=%d' % args.iterations]
+    if args.gpu >= 0:
+        cmd.append('--gpu=%d' % args.gpu)
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    output = proc.communicate()[0].decode('utf-8', 'replace')
+    if proc.returncode != 0:
+        sys.stderr.write(output)
+        raise RuntimeError('%s failed for %s' % (args.caffe_bin, model))
+    times = {}
+    for line in output.splitlines():
+        match = layer_time_re.search(line)
+        if match:
+            times[(match.group(1), match.group(2))] = float(match.group(3))
+    if not times:
+        sys.stderr.write(output)
+        raise RuntimeError('no per-layer timings parsed for ' + model)
+    return times
+
+
+def median(values):
+    ordered = sorted(values)
+    middle = len(ordered) // 2
+    if len(ordered) % 2:
+        return ordered[middle]
+    return (ordered[middle - 1] + ordered[middle]) / 2.0
+
+
+def measure(args, model):
+    """Median per-layer ms across --runs invocations, as a flat dict."""
+    runs = [run_once(args, model) for _ in range(args.runs)]
+    merged = {}
+    for key in runs[0]:
+        merged['%s:%s' % key] = median([r[key] for r in runs if key in r])
+    return merged
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='compare per-layer timings against a baseline')
+    parser.add_argument('--caffe_bin', default='build/tools/caffe')
+    parser.add_argument('--baseline', default='perf_baseline.json')
+    parser.add_argument('--models', nargs='*', default=default_models)
+    parser.add_argument('--iterations', type=int, default=20)
+    parser.add_argument('--runs', type=int, default=5,
+                        help='caffe time invocations to take medians over')
+    parser.add_argument('--gpu', type=int, default=-1)
+    parser.add_argument('--threshold', type=float, default=0.05,
+                        help='fractional slowdown that fails the gate')
+    parser.add_argument('--update', action='store_true',
+                        help='rewrite the baseline instead of comparing')
+    args = parser.parse_args()
+
+    results = {}
+    for model in args.models:
+        print('Timing %s (%d runs x %d iterations)...' %
+              (model, args.runs, args.iterations))
+        results[model] = measure(args, model)
+
+    if args.update or not os.path.exists(args.baseline):
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        print('Wrote baseline ' + args.baseline)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    regressions = []
+    for model, layers in results.items():
+        base_layers = baseline.get(model, {})
+        for layer, ms in sorted(layers.items()):
+            base_ms = base_layers.get(layer)
+            if base_ms is None or base_ms <= 0:
+                continue
+            slowdown = ms / base_ms - 1
+            if slowdown > args.threshold:
+                regressions.append('%s %s: %.3f ms -> %.3f ms (+%.1f%%)' %
+                                   (model, layer, base_ms, ms,
+                                    100 * slowdown))
+    if regressions:
+        print('Performance regressions against %s:' % args.baseline)
+        for line in regressions:
+            print('  ' + line)
+        return 1
+    print('No regressions > %.0f%% against %s' %
+          (100 * args.threshold, args.baseline))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
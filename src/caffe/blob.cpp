@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -22,6 +23,13 @@ void Blob<Dtype>::Reshape(const int num, const int channels, const int height,
 template <typename Dtype>
 void Blob<Dtype>::Reshape(const vector<int>& shape) {
   CHECK_LE(shape.size(), kMaxBlobAxes);
+  if (shape == shape_ && shape_data_) {
+    // Fast path for the Layer::Reshape chains that run every iteration:
+    // besides skipping the axis loop, leaving shape_data_ untouched
+    // keeps its device copy (gpu_shape) valid instead of invalidating
+    // and re-uploading it on every call.
+    return;
+  }
   count_ = 1;
   shape_.resize(shape.size());
   if (!shape_data_ || shape_data_->size() < shape.size() * sizeof(int)) {
@@ -36,9 +44,22 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     shape_data[i] = shape[i];
   }
   if (count_ > capacity_) {
-    capacity_ = count_;
+    // Grow geometrically so a stream of slightly different input sizes
+    // (e.g. variable-sized detection images) does not reallocate -- and,
+    // in GPU mode, cudaMalloc -- on every reshape.
+    if (capacity_ > INT_MAX / 2) {
+      capacity_ = count_;
+    } else {
+      capacity_ = std::max(count_, 2 * capacity_);
+    }
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  } else if (data_ && data_->is_view() &&
+             data_->size() != count_ * sizeof(Dtype)) {
+    // A zero-copy view (ShareDataRange) is only valid at the exact
+    // shape it was wired for; any other shape falls back to private
+    // storage and the layer's copies resume.
+    UnshareViews();
   }
 }
 
@@ -57,18 +78,49 @@ void Blob<Dtype>::ReshapeLike(const Blob<Dtype>& other) {
   Reshape(other.shape());
 }
 
+template <typename Dtype>
+void Blob<Dtype>::Swap(Blob<Dtype>* other) {
+  CHECK(other);
+  data_.swap(other->data_);
+  diff_.swap(other->diff_);
+  shape_data_.swap(other->shape_data_);
+  shape_.swap(other->shape_);
+  std::swap(count_, other->count_);
+  std::swap(capacity_, other->capacity_);
+  std::swap(sparse_diff_rows_valid_, other->sparse_diff_rows_valid_);
+  sparse_diff_rows_.swap(other->sparse_diff_rows_);
+  std::swap(forward_only_, other->forward_only_);
+}
+
+template <typename Dtype>
+void Blob<Dtype>::Reserve(const int count) {
+  CHECK_GE(count, 0);
+  if (count <= capacity_) { return; }
+  capacity_ = count;
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShrinkToFit() {
+  if (capacity_ == count_) { return; }
+  capacity_ = count_;
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
 template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), sparse_diff_rows_valid_(false), forward_only_(false) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), sparse_diff_rows_valid_(false), forward_only_(false) {
   Reshape(shape);
 }
 
@@ -87,6 +139,14 @@ const Dtype* Blob<Dtype>::cpu_data() const {
 template <typename Dtype>
 void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
+  // The external buffer holds exactly count_ elements, so a larger
+  // capacity allocation must not stay behind it: device syncs copy
+  // size() bytes and would read past the caller's memory.
+  const size_t size = count_ * sizeof(Dtype);
+  if (data_->size() != size || data_->is_view()) {
+    data_.reset(new SyncedMemory(size));
+    if (!forward_only_) { diff_.reset(new SyncedMemory(size)); }
+  }
   data_->set_cpu_data(data);
 }
 
@@ -99,12 +159,14 @@ const Dtype* Blob<Dtype>::gpu_data() const {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_diff() const {
   CHECK(diff_);
+  CHECK(!forward_only_) << "diff access on a forward-only blob";
   return (const Dtype*)diff_->cpu_data();
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_diff() const {
   CHECK(diff_);
+  CHECK(!forward_only_) << "diff access on a forward-only blob";
   return (const Dtype*)diff_->gpu_data();
 }
 
@@ -123,15 +185,29 @@ Dtype* Blob<Dtype>::mutable_gpu_data() {
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_diff() {
   CHECK(diff_);
+  CHECK(!forward_only_) << "diff access on a forward-only blob";
   return static_cast<Dtype*>(diff_->mutable_cpu_data());
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_diff() {
   CHECK(diff_);
+  CHECK(!forward_only_) << "diff access on a forward-only blob";
   return static_cast<Dtype*>(diff_->mutable_gpu_data());
 }
 
+#ifndef CPU_ONLY
+template <typename Dtype>
+void Blob<Dtype>::async_cpu_fetch(const cudaStream_t& stream,
+    cudaEvent_t event) {
+  CHECK(data_);
+  data_->async_cpu_pull(stream);
+  if (event != NULL) {
+    CUDA_CHECK(cudaEventRecord(event, stream));
+  }
+}
+#endif
+
 template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
@@ -144,9 +220,62 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareDataRange(const Blob& other, const int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  data_.reset(new SyncedMemory(other.data(),
+      offset * sizeof(Dtype), count_ * sizeof(Dtype)));
+  // Pin capacity to the wired shape so any growth reallocates privately.
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareDiffRange(const Blob& other, const int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  diff_.reset(new SyncedMemory(other.diff(),
+      offset * sizeof(Dtype), count_ * sizeof(Dtype)));
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::UnshareViews() {
+  if (data_ && data_->is_view()) {
+    shared_ptr<SyncedMemory> old_data = data_;
+    data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    // Keep the contents when the view still matches the shape, so
+    // unwiring (e.g. the re-wire cycle in Net::Reshape) is lossless;
+    // a view left over from a different shape holds stale data anyway.
+    if (old_data->head() != SyncedMemory::UNINITIALIZED &&
+        old_data->size() == count_ * sizeof(Dtype)) {
+      caffe_copy(count_, static_cast<const Dtype*>(old_data->cpu_data()),
+          static_cast<Dtype*>(data_->mutable_cpu_data()));
+    }
+  }
+  if (diff_ && diff_->is_view()) {
+    diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+  }
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ReleaseData() {
+  // SyncedMemory allocates lazily, so this frees the old storage (when
+  // no other blob shares it) without acquiring new storage.
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareDataBuffer(const shared_ptr<SyncedMemory>& data) {
+  CHECK(data);
+  CHECK_GE(data->size(), count_ * sizeof(Dtype));
+  data_ = data;
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
-// Blob<int> or Blob<unsigned int>.
+// Blob<int>, Blob<unsigned int> or Blob<unsigned char>.
+template <> void Blob<unsigned char>::Update() { NOT_IMPLEMENTED; }
 template <> void Blob<unsigned int>::Update() { NOT_IMPLEMENTED; }
 template <> void Blob<int>::Update() { NOT_IMPLEMENTED; }
 
@@ -156,6 +285,17 @@ void Blob<Dtype>::Update() {
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
     // perform computation on CPU
+    if (sparse_diff_rows_valid_) {
+      // Only the annotated rows carry gradient; everything else is zero.
+      const int row_dim = count_ / shape_[0];
+      const Dtype* diff = static_cast<const Dtype*>(diff_->cpu_data());
+      Dtype* data = static_cast<Dtype*>(data_->mutable_cpu_data());
+      for (int r = 0; r < sparse_diff_rows_.size(); ++r) {
+        const int offset = sparse_diff_rows_[r] * row_dim;
+        caffe_axpy<Dtype>(row_dim, Dtype(-1), diff + offset, data + offset);
+      }
+      break;
+    }
     caffe_axpy<Dtype>(count_, Dtype(-1),
         static_cast<const Dtype*>(diff_->cpu_data()),
         static_cast<Dtype*>(data_->mutable_cpu_data()));
@@ -176,6 +316,26 @@ void Blob<Dtype>::Update() {
   }
 }
 
+template <typename Dtype>
+void Blob<Dtype>::accumulate_sparse_diff_rows(const vector<int>& rows) {
+  if (!sparse_diff_rows_valid_) {
+    sparse_diff_rows_ = rows;
+    sparse_diff_rows_valid_ = true;
+  } else {
+    sparse_diff_rows_.insert(sparse_diff_rows_.end(), rows.begin(),
+        rows.end());
+  }
+  std::sort(sparse_diff_rows_.begin(), sparse_diff_rows_.end());
+  sparse_diff_rows_.erase(
+      std::unique(sparse_diff_rows_.begin(), sparse_diff_rows_.end()),
+      sparse_diff_rows_.end());
+}
+
+template <> unsigned char Blob<unsigned char>::asum_data() const {
+  NOT_IMPLEMENTED;
+  return 0;
+}
+
 template <> unsigned int Blob<unsigned int>::asum_data() const {
   NOT_IMPLEMENTED;
   return 0;
@@ -211,6 +371,22 @@ Dtype Blob<Dtype>::asum_data() const {
   return 0;
 }
 
+template <typename Dtype>
+float Blob<Dtype>::sparsity() const {
+  if (count_ == 0) { return 0; }
+  const Dtype* data = cpu_data();
+  int zeros = 0;
+  for (int i = 0; i < count_; ++i) {
+    if (data[i] == Dtype(0)) { ++zeros; }
+  }
+  return static_cast<float>(zeros) / count_;
+}
+
+template <> unsigned char Blob<unsigned char>::asum_diff() const {
+  NOT_IMPLEMENTED;
+  return 0;
+}
+
 template <> unsigned int Blob<unsigned int>::asum_diff() const {
   NOT_IMPLEMENTED;
   return 0;
@@ -246,6 +422,11 @@ Dtype Blob<Dtype>::asum_diff() const {
   return 0;
 }
 
+template <> unsigned char Blob<unsigned char>::sumsq_data() const {
+  NOT_IMPLEMENTED;
+  return 0;
+}
+
 template <> unsigned int Blob<unsigned int>::sumsq_data() const {
   NOT_IMPLEMENTED;
   return 0;
@@ -283,6 +464,11 @@ Dtype Blob<Dtype>::sumsq_data() const {
   return sumsq;
 }
 
+template <> unsigned char Blob<unsigned char>::sumsq_diff() const {
+  NOT_IMPLEMENTED;
+  return 0;
+}
+
 template <> unsigned int Blob<unsigned int>::sumsq_diff() const {
   NOT_IMPLEMENTED;
   return 0;
@@ -320,6 +506,10 @@ Dtype Blob<Dtype>::sumsq_diff() const {
   return sumsq;
 }
 
+template <> void Blob<unsigned char>::scale_data(unsigned char scale_factor) {
+  NOT_IMPLEMENTED;
+}
+
 template <> void Blob<unsigned int>::scale_data(unsigned int scale_factor) {
   NOT_IMPLEMENTED;
 }
@@ -353,6 +543,10 @@ void Blob<Dtype>::scale_data(Dtype scale_factor) {
   }
 }
 
+template <> void Blob<unsigned char>::scale_diff(unsigned char scale_factor) {
+  NOT_IMPLEMENTED;
+}
+
 template <> void Blob<unsigned int>::scale_diff(unsigned int scale_factor) {
   NOT_IMPLEMENTED;
 }
@@ -536,6 +730,8 @@ void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
 INSTANTIATE_CLASS(Blob);
 template class Blob<int>;
 template class Blob<unsigned int>;
+// Storage-only blob for uint8 image bytes in the data path; see Batch.
+template class Blob<unsigned char>;
 
 }  // namespace caffe
 
@@ -3,10 +3,18 @@
 #include <cmath>
 #include <cstdio>
 #include <ctime>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
 #include "caffe/util/rng.hpp"
 
+#include "caffe/util/gemm_dispatch.hpp"
+#include "caffe/util/gpu_allocator.hpp"
+
 namespace caffe {
 
 // Make sure each thread can have different values.
@@ -40,6 +48,97 @@ int64_t cluster_seedgen(void) {
 }
 
 
+void Caffe::set_numa_policy(NumaPolicy val) {
+#ifndef USE_NUMA
+  if (val != NUMA_NONE) {
+    LOG(WARNING) << "NUMA policy requested, but Caffe was built without "
+        << "USE_NUMA; host allocations will use plain malloc.";
+    return;
+  }
+#endif
+  Get().numa_policy_ = val;
+}
+
+// Shared across threads, unlike the thread-local singleton state.
+static int cpu_core_budget_ = 0;
+
+int Caffe::cpu_core_budget() {
+  return cpu_core_budget_;
+}
+
+void Caffe::set_cpu_core_budget(const int budget) {
+  cpu_core_budget_ = budget;
+}
+
+void Caffe::set_blas_backend(const string& path) {
+  if (path.empty()) {
+    caffe_gemm_unload_backend();
+    return;
+  }
+  string error;
+  CHECK(caffe_gemm_load_backend(path, &error))
+      << "Could not load BLAS backend " << path << ": " << error;
+  LOG(INFO) << "Loaded BLAS backend " << path
+      << "; GEMM shapes will be autotuned against the built-in BLAS.";
+}
+
+void LogMemoryTelemetry() {
+  LOG(ERROR) << Caffe::memory_telemetry();
+}
+
+string Caffe::rng_state() {
+  std::ostringstream state;
+  state << *static_cast<caffe::rng_t*>(rng_stream().generator());
+  return state.str();
+}
+
+void Caffe::set_rng_state(const string& state) {
+  std::istringstream in(state);
+  in >> *static_cast<caffe::rng_t*>(rng_stream().generator());
+  CHECK(!in.fail()) << "Malformed RNG state";
+}
+
+#ifdef CPU_ONLY
+
+size_t Caffe::gpu_allocator_bytes_cached() { return 0; }
+
+double Caffe::gpu_allocator_hit_rate() { return 0; }
+
+void Caffe::ReleaseCachedGPUMemory() {}
+
+string Caffe::memory_telemetry() {
+  return "GPU memory telemetry unavailable in CPU-only build";
+}
+
+#else
+
+size_t Caffe::gpu_allocator_bytes_cached() {
+  return GPUAllocator::bytes_cached();
+}
+
+double Caffe::gpu_allocator_hit_rate() {
+  const size_t hits = GPUAllocator::hits();
+  const size_t total = hits + GPUAllocator::misses();
+  return total == 0 ? 0 : static_cast<double>(hits) / total;
+}
+
+void Caffe::ReleaseCachedGPUMemory() {
+  GPUAllocator::ReleaseCached();
+}
+
+string Caffe::memory_telemetry() {
+  std::ostringstream report;
+  report << GPUAllocator::report();
+  const double mb = 1024 * 1024;
+  report << "\n  SyncedMemory (blob storage) holds "
+         << SyncedMemory::device_bytes() / mb << " MB of the live bytes"
+         << " (peak " << SyncedMemory::peak_device_bytes() / mb
+         << " MB); the rest is layer scratch";
+  return report.str();
+}
+
+#endif  // CPU_ONLY
+
 void GlobalInit(int* pargc, char*** pargv) {
   // Google flags.
   ::gflags::ParseCommandLineFlags(pargc, pargv, true);
@@ -53,7 +152,10 @@ void GlobalInit(int* pargc, char*** pargv) {
 
 Caffe::Caffe()
     : random_generator_(), mode_(Caffe::CPU),
-      solver_count_(1), root_solver_(true) { }
+      cudnn_backward_policy_(Caffe::CUDNN_BACKWARD_FASTEST),
+      numa_policy_(Caffe::NUMA_NONE),
+      solver_count_(1), root_solver_(true), multiprocess_(false),
+      solver_rank_(0), process_count_(1) { }
 
 Caffe::~Caffe() { }
 
@@ -104,46 +206,186 @@ void* Caffe::RNG::generator() {
 
 #else  // Normal GPU + CPU Caffe.
 
+// Idle handles keyed by device: threads lease their cuBLAS handle and
+// curand generator from here on first use and give them back on exit,
+// so a growing-and-shrinking thread pool creates each device's handles
+// once instead of paying handle creation (with its context
+// initialization) on every thread bring-up. Leaked deliberately: the
+// handles die with the CUDA context at process exit, and destroying
+// them from static teardown would race the driver shutdown.
+namespace {
+
+struct HandleCache {
+  boost::mutex mutex;
+  std::map<int, vector<cublasHandle_t> > cublas;
+  std::map<int, vector<curandGenerator_t> > curand;
+};
+
+HandleCache& handle_cache() {
+  static HandleCache* cache = new HandleCache();
+  return *cache;
+}
+
+}  // namespace
+
 Caffe::Caffe()
-    : cublas_handle_(NULL), curand_generator_(NULL), random_generator_(),
-    mode_(Caffe::CPU), solver_count_(1), root_solver_(true) {
-  // Try to create a cublas handler, and report an error if failed (but we will
-  // keep the program running as one might just want to run CPU code).
-  if (cublasCreate(&cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
-    LOG(ERROR) << "Cannot create Cublas handle. Cublas won't be available.";
+    : cublas_handle_(NULL), curand_generator_(NULL),
+    random_seed_generation_(0), curand_seed_(0), curand_seed_pending_(false),
+    handle_device_(-1), random_generator_(),
+    mode_(Caffe::CPU), cudnn_backward_policy_(Caffe::CUDNN_BACKWARD_FASTEST),
+    numa_policy_(Caffe::NUMA_NONE),
+    solver_count_(1), root_solver_(true), multiprocess_(false),
+    solver_rank_(0), process_count_(1) {
+  // No GPU work here: handles are leased on first use, so bringing up a
+  // thread that only reads mode() or runs CPU code costs microseconds.
+}
+
+Caffe::~Caffe() {
+  ReleaseGpuHandles();
+  for (int i = 0; i < cublas_pool_.size(); ++i) {
+    CUBLAS_CHECK(cublasDestroy(cublas_pool_[i]));
   }
-  // Try to create a curand handler.
-  if (curandCreateGenerator(&curand_generator_, CURAND_RNG_PSEUDO_DEFAULT)
-      != CURAND_STATUS_SUCCESS ||
-      curandSetPseudoRandomGeneratorSeed(curand_generator_, cluster_seedgen())
-      != CURAND_STATUS_SUCCESS) {
-    LOG(ERROR) << "Cannot create Curand generator. Curand won't be available.";
+  for (int i = 0; i < stream_pool_.size(); ++i) {
+    CUDA_CHECK(cudaStreamDestroy(stream_pool_[i]));
   }
 }
 
-Caffe::~Caffe() {
-  if (cublas_handle_) CUBLAS_CHECK(cublasDestroy(cublas_handle_));
+cublasHandle_t Caffe::cublas_handle() {
+  Caffe& self = Get();
+  if (self.cublas_handle_ == NULL) {
+    int device;
+    CUDA_CHECK(cudaGetDevice(&device));
+    {
+      boost::mutex::scoped_lock lock(handle_cache().mutex);
+      vector<cublasHandle_t>& idle = handle_cache().cublas[device];
+      if (!idle.empty()) {
+        self.cublas_handle_ = idle.back();
+        idle.pop_back();
+      }
+    }
+    // Report an error if creation fails (but keep the program running,
+    // as one might just want to run CPU code).
+    if (self.cublas_handle_ == NULL &&
+        cublasCreate(&self.cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
+      LOG(ERROR) << "Cannot create Cublas handle. Cublas won't be available.";
+      self.cublas_handle_ = NULL;
+      return NULL;
+    }
+    self.handle_device_ = device;
+    // Rebind the stream on every lease: a previous owner may have left
+    // the handle on a side stream.
+#ifdef USE_PER_THREAD_STREAMS
+    // Binding to the per-thread default stream -- the stream kernel
+    // launches already target under --default-stream per-thread --
+    // gives every net driven from its own thread an isolated stream,
+    // so co-resident models overlap on one device instead of
+    // serializing on the legacy default stream.
+    CUBLAS_CHECK(cublasSetStream(self.cublas_handle_, cudaStreamPerThread));
+#else
+    CUBLAS_CHECK(cublasSetStream(self.cublas_handle_, NULL));
+#endif
+  }
+  return self.cublas_handle_;
+}
+
+curandGenerator_t Caffe::curand_generator() {
+  Caffe& self = Get();
+  if (self.curand_generator_ == NULL) {
+    int device;
+    CUDA_CHECK(cudaGetDevice(&device));
+    {
+      boost::mutex::scoped_lock lock(handle_cache().mutex);
+      vector<curandGenerator_t>& idle = handle_cache().curand[device];
+      if (!idle.empty()) {
+        self.curand_generator_ = idle.back();
+        idle.pop_back();
+      }
+    }
+    if (self.curand_generator_ == NULL &&
+        curandCreateGenerator(&self.curand_generator_,
+            CURAND_RNG_PSEUDO_DEFAULT) != CURAND_STATUS_SUCCESS) {
+      LOG(ERROR) << "Cannot create Curand generator. "
+                 << "Curand won't be available.";
+      self.curand_generator_ = NULL;
+      return NULL;
+    }
+    self.handle_device_ = device;
+    // A recycled generator carries its previous owner's state; reseed
+    // so a fresh thread still draws an independent sequence, or the
+    // seed set_random_seed recorded before the generator existed.
+    const unsigned int seed = self.curand_seed_pending_ ?
+        self.curand_seed_ : static_cast<unsigned int>(cluster_seedgen());
+    self.curand_seed_pending_ = false;
+    if (curandSetPseudoRandomGeneratorSeed(self.curand_generator_, seed)
+        != CURAND_STATUS_SUCCESS ||
+        curandSetGeneratorOffset(self.curand_generator_, 0)
+        != CURAND_STATUS_SUCCESS) {
+      LOG(ERROR) << "Cannot seed Curand generator. "
+                 << "Curand won't be available.";
+    }
+#ifdef USE_PER_THREAD_STREAMS
+    CURAND_CHECK(curandSetStream(self.curand_generator_,
+        cudaStreamPerThread));
+#else
+    CURAND_CHECK(curandSetStream(self.curand_generator_, 0));
+#endif
+  }
+  return self.curand_generator_;
+}
+
+void Caffe::ReleaseGpuHandles() {
+  if (cublas_handle_ == NULL && curand_generator_ == NULL) { return; }
+  boost::mutex::scoped_lock lock(handle_cache().mutex);
+  if (cublas_handle_) {
+    handle_cache().cublas[handle_device_].push_back(cublas_handle_);
+    cublas_handle_ = NULL;
+  }
   if (curand_generator_) {
-    CURAND_CHECK(curandDestroyGenerator(curand_generator_));
+    handle_cache().curand[handle_device_].push_back(curand_generator_);
+    curand_generator_ = NULL;
+  }
+}
+
+cudaStream_t Caffe::stream(int index) {
+  CHECK_GE(index, 0);
+  vector<cudaStream_t>& pool = Get().stream_pool_;
+  while (static_cast<int>(pool.size()) <= index) {
+    cudaStream_t new_stream;
+    CUDA_CHECK(cudaStreamCreateWithFlags(&new_stream, cudaStreamNonBlocking));
+    pool.push_back(new_stream);
   }
+  return pool[index];
+}
+
+cublasHandle_t Caffe::cublas_handle(int index) {
+  CHECK_GE(index, 0);
+  vector<cublasHandle_t>& pool = Get().cublas_pool_;
+  while (static_cast<int>(pool.size()) <= index) {
+    cublasHandle_t new_handle;
+    CUBLAS_CHECK(cublasCreate(&new_handle));
+    CUBLAS_CHECK(cublasSetStream(new_handle,
+        stream(static_cast<int>(pool.size()))));
+    pool.push_back(new_handle);
+  }
+  return pool[index];
 }
 
 void Caffe::set_random_seed(const unsigned int seed) {
   // Curand seed
-  static bool g_curand_availability_logged = false;
-  if (Get().curand_generator_) {
-    CURAND_CHECK(curandSetPseudoRandomGeneratorSeed(curand_generator(),
+  Caffe& self = Get();
+  if (self.curand_generator_) {
+    CURAND_CHECK(curandSetPseudoRandomGeneratorSeed(self.curand_generator_,
         seed));
-    CURAND_CHECK(curandSetGeneratorOffset(curand_generator(), 0));
+    CURAND_CHECK(curandSetGeneratorOffset(self.curand_generator_, 0));
   } else {
-    if (!g_curand_availability_logged) {
-        LOG(ERROR) <<
-            "Curand not available. Skipping setting the curand seed.";
-        g_curand_availability_logged = true;
-    }
+    // Not leased yet; record the seed and apply it when (if) this
+    // thread first touches curand, so CPU-only threads pay nothing.
+    self.curand_seed_ = seed;
+    self.curand_seed_pending_ = true;
   }
+  ++self.random_seed_generation_;
   // RNG seed
-  Get().random_generator_.reset(new RNG(seed));
+  self.random_generator_.reset(new RNG(seed));
 }
 
 void Caffe::SetDevice(const int device_id) {
@@ -152,18 +394,19 @@ void Caffe::SetDevice(const int device_id) {
   if (current_device == device_id) {
     return;
   }
-  // The call to cudaSetDevice must come before any calls to Get, which
-  // may perform initialization using the GPU.
-  CUDA_CHECK(cudaSetDevice(device_id));
-  if (Get().cublas_handle_) CUBLAS_CHECK(cublasDestroy(Get().cublas_handle_));
-  if (Get().curand_generator_) {
-    CURAND_CHECK(curandDestroyGenerator(Get().curand_generator_));
+  // Give the old device's main handles back to the cache; they are
+  // leased again, on the new device, at first use.
+  Get().ReleaseGpuHandles();
+  // Pooled streams and handles belong to the old device as well.
+  for (int i = 0; i < Get().cublas_pool_.size(); ++i) {
+    CUBLAS_CHECK(cublasDestroy(Get().cublas_pool_[i]));
   }
-  CUBLAS_CHECK(cublasCreate(&Get().cublas_handle_));
-  CURAND_CHECK(curandCreateGenerator(&Get().curand_generator_,
-      CURAND_RNG_PSEUDO_DEFAULT));
-  CURAND_CHECK(curandSetPseudoRandomGeneratorSeed(Get().curand_generator_,
-      cluster_seedgen()));
+  Get().cublas_pool_.clear();
+  for (int i = 0; i < Get().stream_pool_.size(); ++i) {
+    CUDA_CHECK(cudaStreamDestroy(Get().stream_pool_[i]));
+  }
+  Get().stream_pool_.clear();
+  CUDA_CHECK(cudaSetDevice(device_id));
 }
 
 void Caffe::DeviceQuery() {
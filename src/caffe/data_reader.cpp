@@ -1,4 +1,6 @@
 #include <boost/thread.hpp>
+#include <algorithm>
+#include <climits>
 #include <map>
 #include <string>
 #include <vector>
@@ -7,6 +9,9 @@
 #include "caffe/data_reader.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/nvtx.hpp"
 
 namespace caffe {
 
@@ -41,14 +46,20 @@ DataReader::~DataReader() {
 
 //
 
-DataReader::QueuePair::QueuePair(int size) {
+DataReader::QueuePair::QueuePair(int size)
+    : free_(size), full_(size) {
   // Initialize the free queue with requested number of datums
   for (int i = 0; i < size; ++i) {
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+    free_.push(google::protobuf::Arena::CreateMessage<Datum>(&arena_));
+#else
     free_.push(new Datum());
+#endif
   }
 }
 
 DataReader::QueuePair::~QueuePair() {
+#if GOOGLE_PROTOBUF_VERSION < 3000000
   Datum* datum;
   while (free_.try_pop(&datum)) {
     delete datum;
@@ -56,6 +67,8 @@ DataReader::QueuePair::~QueuePair() {
   while (full_.try_pop(&datum)) {
     delete datum;
   }
+#endif
+  // With arena support the datums are owned and freed by arena_.
 }
 
 //
@@ -70,49 +83,242 @@ DataReader::Body::~Body() {
   StopInternalThread();
 }
 
+int DataReader::Body::reader_threads(const LayerParameter& param) {
+  int threads = param.data_param().reader_threads();
+  if (threads > 1 && param.data_param().backend() != DataParameter_DB_LMDB) {
+    LOG(WARNING) << "reader_threads > 1 requires the LMDB backend "
+        << "(concurrent read transactions), falling back to a single thread";
+    return 1;
+  }
+  return std::max(threads, 1);
+}
+
+// How far ahead of each cursor to fault in mapped database pages.
+static const size_t kCursorReadahead = 8 * 1024 * 1024;
+
+vector<string> DataReader::Body::shard_sources(const LayerParameter& param) {
+  vector<string> sources;
+  for (int i = 0; i < param.data_param().shard_source_size(); ++i) {
+    sources.push_back(param.data_param().shard_source(i));
+  }
+  if (sources.empty()) {
+    sources.push_back(param.data_param().source());
+  } else {
+    const int weights = param.data_param().shard_weight_size();
+    CHECK(weights == 0 || weights == sources.size())
+        << "Specify either no shard_weight or one per shard_source";
+  }
+  return sources;
+}
+
 void DataReader::Body::InternalThreadEntry() {
-  shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
-  db->Open(param_.data_param().source(), db::READ);
-  shared_ptr<db::Cursor> cursor(db->NewCursor());
+  const vector<string> sources = shard_sources(param_);
+  vector<shared_ptr<db::DB> > dbs;
+  vector<shared_ptr<db::Cursor> > cursors;
+  for (int i = 0; i < sources.size(); ++i) {
+    shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
+    db->Open(sources[i], db::READ);
+    shared_ptr<db::Cursor> cursor(db->NewCursor());
+    cursor->set_readahead(kCursorReadahead);
+    dbs.push_back(db);
+    cursors.push_back(cursor);
+  }
+  shared_ptr<db::DB> db = dbs[0];
+  shared_ptr<db::Cursor> cursor = cursors[0];
   vector<shared_ptr<QueuePair> > qps;
   try {
     int solver_count = param_.phase() == TRAIN ? Caffe::solver_count() : 1;
+    const int threads = reader_threads(param_);
+    // Multi-process training partitions the key range across ranks as
+    // well: the stride grows by the process count and every cursor is
+    // pre-advanced to this rank's offset, so records owned by other
+    // ranks are never visited, let alone parsed.
+    const int ranks = param_.phase() == TRAIN ? Caffe::process_count() : 1;
+    const int rank = param_.phase() == TRAIN ? Caffe::solver_rank() : 0;
+    // Single sources stride their key range across threads; sharded
+    // sources partition whole shards instead.
+    const int stride = (sources.size() == 1 ? threads : 1) * ranks;
+    const int offset = sources.size() == 1 ? rank * threads : rank;
+    for (int c = 0; c < cursors.size(); ++c) {
+      for (int i = 0; i < offset; ++i) {
+        cursors[c]->Next();
+        if (!cursors[c]->valid()) {
+          cursors[c]->SeekToFirst();
+        }
+      }
+    }
+
+    // Replay support (DataParameter.skip): resume the walk as if this
+    // many datums had already been consumed. With several cursors each
+    // advances its share, which matches the round-robin interleave.
+    if (param_.data_param().skip() > 0) {
+      const uint64_t per_cursor = param_.data_param().skip()
+          / cursors.size();
+      for (int c = 0; c < cursors.size(); ++c) {
+        for (uint64_t i = 0; i < per_cursor; ++i) {
+          cursors[c]->Next();
+          if (!cursors[c]->valid()) {
+            cursors[c]->SeekToFirst();
+          }
+        }
+      }
+    }
 
     // To ensure deterministic runs, only start running once all solvers
     // are ready. But solvers need to peek on one item during initialization,
-    // so read one item, then wait for the next solver.
+    // so read one item, then wait for the next solver. With sharded readers,
+    // advance by the shard stride so this thread keeps walking shard 0.
     for (int i = 0; i < solver_count; ++i) {
       shared_ptr<QueuePair> qp(new_queue_pairs_.pop());
-      read_one(cursor.get(), qp.get());
+      read_one(cursor.get(), qp.get(), stride);
       qps.push_back(qp);
     }
-    // Main loop
+    if (sources.size() > 1) {
+      // Interleave reads across the shards; worker threads each own a
+      // subset of the cursors.
+      const int workers = std::min(threads, static_cast<int>(sources.size()));
+      boost::thread_group worker_group;
+      for (int t = 1; t < workers; ++t) {
+        worker_group.add_thread(new boost::thread(
+            &DataReader::Body::multi_shard_loop, this, cursors, t, workers,
+            ranks, qps));
+      }
+      multi_shard_loop(cursors, 0, workers, ranks, qps);
+      worker_group.interrupt_all();
+      worker_group.join_all();
+    } else if (threads == 1) {
+      // Main loop
+      while (!must_stop()) {
+        for (int i = 0; i < solver_count; ++i) {
+          read_one(cursor.get(), qps[i].get(), stride);
+        }
+        // Check no additional readers have been created. This can happen if
+        // more than one net is trained at a time per process, whether single
+        // or multi solver. It might also happen if two data layers have same
+        // name and same source.
+        CHECK_EQ(new_queue_pairs_.size(), 0);
+      }
+    } else {
+      // Shard the key range across worker threads, each with its own
+      // read-only LMDB transaction. This thread walks shard 0 so that
+      // must_stop() keeps being observed; workers are interrupted on exit.
+      // Ordering across solvers is no longer globally sequential in this
+      // mode, only per shard.
+      boost::thread_group workers;
+      for (int t = 1; t < threads; ++t) {
+        workers.add_thread(new boost::thread(
+            &DataReader::Body::shard_loop, this, db.get(),
+            shared_ptr<db::Cursor>(), offset + t, stride, qps));
+      }
+      // Hand shard 0 the cursor the initialization reads advanced; a
+      // fresh cursor would start back at record `offset` and deliver
+      // those records a second time.
+      shard_loop(db.get(), cursor, offset, stride, qps);
+      workers.interrupt_all();
+      workers.join_all();
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+void DataReader::Body::multi_shard_loop(
+    const vector<shared_ptr<db::Cursor> >& cursors, int worker,
+    int num_workers, int stride, const vector<shared_ptr<QueuePair> >& qps) {
+  try {
+    // Shards owned by this worker, with cumulative weights for sampling.
+    vector<db::Cursor*> shards;
+    vector<float> cum_weights;
+    const bool weighted = param_.data_param().shard_weight_size() > 0;
+    float total = 0;
+    for (int i = worker; i < cursors.size(); i += num_workers) {
+      shards.push_back(cursors[i].get());
+      total += weighted ? param_.data_param().shard_weight(i) : 1.f;
+      cum_weights.push_back(total);
+    }
+    int next = 0;
+    while (!must_stop()) {
+      for (int i = 0; i < qps.size(); ++i) {
+        int s;
+        if (weighted) {
+          const float r = total
+              * (caffe_rng_rand() / static_cast<float>(UINT_MAX));
+          s = std::lower_bound(cum_weights.begin(), cum_weights.end(), r)
+              - cum_weights.begin();
+          s = std::min(s, static_cast<int>(shards.size()) - 1);
+        } else {
+          s = next++ % shards.size();
+        }
+        read_one(shards[s], qps[i].get(), stride);
+      }
+      if (worker == 0) {
+        // See the single-threaded loop for why this must stay empty.
+        CHECK_EQ(new_queue_pairs_.size(), 0);
+      }
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+void DataReader::Body::shard_loop(db::DB* db, shared_ptr<db::Cursor> cursor,
+    int shard, int num_shards, const vector<shared_ptr<QueuePair> >& qps) {
+  try {
+    if (!cursor) {
+      // Workers open their own read-only cursor and offset it into
+      // their stride class; shard 0 reuses the caller's cursor, which
+      // is already past both the offset and the initialization reads.
+      cursor.reset(db->NewCursor());
+      cursor->set_readahead(kCursorReadahead);
+      for (int i = 0; i < shard; ++i) {
+        cursor->Next();
+        if (!cursor->valid()) {
+          cursor->SeekToFirst();
+        }
+      }
+    }
     while (!must_stop()) {
-      for (int i = 0; i < solver_count; ++i) {
-        read_one(cursor.get(), qps[i].get());
+      for (int i = 0; i < qps.size(); ++i) {
+        read_one(cursor.get(), qps[i].get(), num_shards);
+      }
+      if (shard == 0) {
+        // See the single-threaded loop for why this must stay empty.
+        CHECK_EQ(new_queue_pairs_.size(), 0);
       }
-      // Check no additional readers have been created. This can happen if
-      // more than one net is trained at a time per process, whether single
-      // or multi solver. It might also happen if two data layers have same
-      // name and same source.
-      CHECK_EQ(new_queue_pairs_.size(), 0);
     }
   } catch (boost::thread_interrupted&) {
     // Interrupted exception is expected on shutdown
   }
 }
 
-void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
+void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp,
+    int stride) {
+  NvtxRange nvtx("data_read", param_.name());
   Datum* datum = qp->free_.pop();
-  // TODO deserialize in-place instead of copy?
-  datum->ParseFromString(cursor->value());
+  // Fast path: walk the wire format in place and copy only the pixel bytes
+  // into the recycled datum, reusing its string capacity instead of the
+  // allocations made by a full parse. Datums with float_data fall back.
+  DatumView view;
+  if (view.ParseFrom(cursor->value_data(), cursor->value_size())) {
+    datum->set_channels(view.channels());
+    datum->set_height(view.height());
+    datum->set_width(view.width());
+    datum->set_label(view.label());
+    datum->set_encoded(view.encoded());
+    datum->clear_float_data();
+    datum->mutable_data()->assign(view.data(), view.data_size());
+  } else {
+    datum->ParseFromString(cursor->value());
+  }
   qp->full_.push(datum);
 
-  // go to the next iter
-  cursor->Next();
-  if (!cursor->valid()) {
-    DLOG(INFO) << "Restarting data prefetching from start.";
-    cursor->SeekToFirst();
+  // go to the next iter, skipping entries owned by other shards
+  for (int i = 0; i < stride; ++i) {
+    cursor->Next();
+    if (!cursor->valid()) {
+      DLOG(INFO) << "Restarting data prefetching from start.";
+      cursor->SeekToFirst();
+    }
   }
 }
 
@@ -2,6 +2,11 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <boost/random.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -12,21 +17,77 @@
 
 namespace caffe {
 
+// Row kernels for the uint8 transform paths. The mean-mode dispatch is
+// hoisted out of the pixel loops so each body is a branch-free pass over
+// contiguous memory that the compiler vectorizes, including the
+// uint8->Dtype conversion. The mirrored variant writes the row reversed.
+template <typename Dtype>
+inline static void TransformRow(const uint8_t* data, const Dtype* mean,
+    const bool has_mean_value, const Dtype mean_value, const Dtype scale,
+    const int width, Dtype* out) {
+  if (mean != NULL) {
+    for (int w = 0; w < width; ++w) {
+      out[w] = (static_cast<Dtype>(data[w]) - mean[w]) * scale;
+    }
+  } else if (has_mean_value) {
+    for (int w = 0; w < width; ++w) {
+      out[w] = (static_cast<Dtype>(data[w]) - mean_value) * scale;
+    }
+  } else {
+    for (int w = 0; w < width; ++w) {
+      out[w] = static_cast<Dtype>(data[w]) * scale;
+    }
+  }
+}
+
+template <typename Dtype>
+inline static void TransformRowMirror(const uint8_t* data, const Dtype* mean,
+    const bool has_mean_value, const Dtype mean_value, const Dtype scale,
+    const int width, Dtype* out) {
+  if (mean != NULL) {
+    for (int w = 0; w < width; ++w) {
+      out[width - 1 - w] = (static_cast<Dtype>(data[w]) - mean[w]) * scale;
+    }
+  } else if (has_mean_value) {
+    for (int w = 0; w < width; ++w) {
+      out[width - 1 - w] = (static_cast<Dtype>(data[w]) - mean_value) * scale;
+    }
+  } else {
+    for (int w = 0; w < width; ++w) {
+      out[width - 1 - w] = static_cast<Dtype>(data[w]) * scale;
+    }
+  }
+}
+
+// Uniform draw in [a, b) from the given stream; returns a when the range
+// is empty.
+static float RandUniform(Caffe::RNG* rng, float a, float b) {
+  if (a >= b) {
+    return a;
+  }
+  CHECK(rng);
+  boost::uniform_real<float> random_distribution(a, b);
+  boost::variate_generator<caffe::rng_t*, boost::uniform_real<float> >
+      variate_generator(static_cast<caffe::rng_t*>(rng->generator()),
+                        random_distribution);
+  return variate_generator();
+}
+
+// Whether any of the fused TRAIN-phase image augmentations are enabled.
+static bool NeedsAugmentation(const TransformationParameter& param) {
+  return param.random_area_lower() > 0 || param.max_rotation() > 0
+      || param.brightness() > 0 || param.contrast() > 0;
+}
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
-    : param_(param), phase_(phase) {
+    : param_(param), phase_(phase), mean_loaded_(false) {
   // check if we want to use mean_file
   if (param_.has_mean_file()) {
     CHECK_EQ(param_.mean_value_size(), 0) <<
       "Cannot specify mean_file and mean_value at the same time";
-    const string& mean_file = param.mean_file();
-    if (Caffe::root_solver()) {
-      LOG(INFO) << "Loading mean file from: " << mean_file;
-    }
-    BlobProto blob_proto;
-    ReadProtoFromBinaryFileOrDie(mean_file.c_str(), &blob_proto);
-    data_mean_.FromProto(blob_proto);
+    // The blob itself is parsed on first use, see LoadMeanFile().
   }
   // check if we want to use mean_value
   if (param_.mean_value_size() > 0) {
@@ -38,9 +99,61 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
   }
 }
 
+template<typename Dtype>
+void DataTransformer<Dtype>::LoadMeanFile() {
+  if (mean_loaded_ || !param_.has_mean_file()) {
+    return;
+  }
+  mean_loaded_ = true;
+  const string& mean_file = param_.mean_file();
+  if (Caffe::root_solver()) {
+    LOG(INFO) << "Loading mean file from: " << mean_file;
+  }
+  BlobProto blob_proto;
+  ReadProtoFromBinaryFileOrDie(mean_file.c_str(), &blob_proto);
+  Blob<Dtype> mean_blob;
+  mean_blob.FromProto(blob_proto);
+  // A spatially constant mean collapses to per-channel values: the
+  // transform then takes the cheap broadcast path and the full blob is
+  // freed with this scope.
+  const Dtype* mean = mean_blob.cpu_data();
+  const int dim = mean_blob.height() * mean_blob.width();
+  bool spatially_constant = true;
+  for (int c = 0; c < mean_blob.channels() && spatially_constant; ++c) {
+    for (int i = 1; i < dim; ++i) {
+      if (mean[c * dim + i] != mean[c * dim]) {
+        spatially_constant = false;
+        break;
+      }
+    }
+  }
+  if (spatially_constant) {
+    for (int c = 0; c < mean_blob.channels(); ++c) {
+      mean_values_.push_back(mean[c * dim]);
+    }
+    if (Caffe::root_solver()) {
+      LOG(INFO) << "Mean file is spatially constant, collapsed to "
+          << mean_blob.channels() << " per-channel value(s)";
+    }
+  } else {
+    data_mean_.CopyFrom(mean_blob, false, true);
+  }
+}
+
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
-                                       Dtype* transformed_data) {
+                                       Dtype* transformed_data,
+                                       Caffe::RNG* rng) {
+  int h_off, w_off;
+  bool do_mirror;
+  SampleTransformParams(datum.height(), datum.width(), &h_off, &w_off,
+      &do_mirror, rng);
+  ApplyTransform(datum, transformed_data, h_off, w_off, do_mirror);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::ApplyTransform(const Datum& datum,
+    Dtype* transformed_data, int h_off, int w_off, bool do_mirror) {
   const string& data = datum.data();
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
@@ -48,14 +161,12 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
 
   const int crop_size = param_.crop_size();
   const Dtype scale = param_.scale();
-  const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
+  LoadMeanFile();
+  const bool has_mean_file = data_mean_.count() > 0;
   const bool has_uint8 = data.size() > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
-  CHECK_GE(datum_height, crop_size);
-  CHECK_GE(datum_width, crop_size);
 
   Dtype* mean = NULL;
   if (has_mean_file) {
@@ -77,20 +188,31 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
 
   int height = datum_height;
   int width = datum_width;
-
-  int h_off = 0;
-  int w_off = 0;
   if (crop_size) {
     height = crop_size;
     width = crop_size;
-    // We only do random crop when we do training.
-    if (phase_ == TRAIN) {
-      h_off = Rand(datum_height - crop_size + 1);
-      w_off = Rand(datum_width - crop_size + 1);
-    } else {
-      h_off = (datum_height - crop_size) / 2;
-      w_off = (datum_width - crop_size) / 2;
+  }
+
+  if (has_uint8) {
+    // Hot path: process each cropped row with the vectorized kernels.
+    const uint8_t* udata = reinterpret_cast<const uint8_t*>(data.data());
+    for (int c = 0; c < datum_channels; ++c) {
+      const Dtype mean_value = has_mean_values ? mean_values_[c] : Dtype(0);
+      for (int h = 0; h < height; ++h) {
+        const int data_index =
+            (c * datum_height + h_off + h) * datum_width + w_off;
+        const Dtype* mean_row = has_mean_file ? mean + data_index : NULL;
+        Dtype* out = transformed_data + (c * height + h) * width;
+        if (do_mirror) {
+          TransformRowMirror(udata + data_index, mean_row, has_mean_values,
+              mean_value, scale, width, out);
+        } else {
+          TransformRow(udata + data_index, mean_row, has_mean_values,
+              mean_value, scale, width, out);
+        }
+      }
     }
+    return;
   }
 
   Dtype datum_element;
@@ -104,12 +226,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
         } else {
           top_index = (c * height + h) * width + w;
         }
-        if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
+        datum_element = datum.float_data(data_index);
         if (has_mean_file) {
           transformed_data[top_index] =
             (datum_element - mean[data_index]) * scale;
@@ -130,6 +247,13 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Blob<Dtype>* transformed_blob) {
+  Transform(datum, transformed_blob, rng_.get());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum,
+                                       Blob<Dtype>* transformed_blob,
+                                       Caffe::RNG* rng) {
   // If datum is encoded, decoded and transform the cv::image.
   if (datum.encoded()) {
 #ifdef USE_OPENCV
@@ -143,7 +267,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
       cv_img = DecodeDatumToCVMatNative(datum);
     }
     // Transform the cv::image into blob.
-    return Transform(cv_img, transformed_blob);
+    return Transform(cv_img, transformed_blob, rng);
 #else
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
@@ -178,7 +302,113 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   }
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  Transform(datum, transformed_data);
+  Transform(datum, transformed_data, rng);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const DatumView& view,
+                                       Dtype* transformed_data,
+                                       Caffe::RNG* rng) {
+  const char* data = view.data();
+  const int datum_channels = view.channels();
+  const int datum_height = view.height();
+  const int datum_width = view.width();
+
+  const int crop_size = param_.crop_size();
+  const Dtype scale = param_.scale();
+  const bool do_mirror = param_.mirror() && Rand(2, rng);
+  LoadMeanFile();
+  const bool has_mean_file = data_mean_.count() > 0;
+  const bool has_mean_values = mean_values_.size() > 0;
+
+  CHECK_GT(datum_channels, 0);
+  CHECK_GE(datum_height, crop_size);
+  CHECK_GE(datum_width, crop_size);
+  CHECK_EQ(view.data_size(),
+      size_t(datum_channels) * datum_height * datum_width);
+
+  Dtype* mean = NULL;
+  if (has_mean_file) {
+    CHECK_EQ(datum_channels, data_mean_.channels());
+    CHECK_EQ(datum_height, data_mean_.height());
+    CHECK_EQ(datum_width, data_mean_.width());
+    mean = data_mean_.mutable_cpu_data();
+  }
+  if (has_mean_values) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == datum_channels) <<
+     "Specify either 1 mean_value or as many as channels: " << datum_channels;
+    if (datum_channels > 1 && mean_values_.size() == 1) {
+      // Replicate the mean_value for simplicity
+      for (int c = 1; c < datum_channels; ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+  }
+
+  int height = datum_height;
+  int width = datum_width;
+
+  int h_off = 0;
+  int w_off = 0;
+  if (crop_size) {
+    height = crop_size;
+    width = crop_size;
+    // We only do random crop when we do training.
+    if (phase_ == TRAIN) {
+      h_off = Rand(datum_height - crop_size + 1, rng);
+      w_off = Rand(datum_width - crop_size + 1, rng);
+    } else {
+      h_off = (datum_height - crop_size) / 2;
+      w_off = (datum_width - crop_size) / 2;
+    }
+  }
+
+  const uint8_t* udata = reinterpret_cast<const uint8_t*>(data);
+  for (int c = 0; c < datum_channels; ++c) {
+    const Dtype mean_value = has_mean_values ? mean_values_[c] : Dtype(0);
+    for (int h = 0; h < height; ++h) {
+      const int data_index =
+          (c * datum_height + h_off + h) * datum_width + w_off;
+      const Dtype* mean_row = has_mean_file ? mean + data_index : NULL;
+      Dtype* out = transformed_data + (c * height + h) * width;
+      if (do_mirror) {
+        TransformRowMirror(udata + data_index, mean_row, has_mean_values,
+            mean_value, scale, width, out);
+      } else {
+        TransformRow(udata + data_index, mean_row, has_mean_values,
+            mean_value, scale, width, out);
+      }
+    }
+  }
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const DatumView& view,
+                                       Blob<Dtype>* transformed_blob) {
+  CHECK(!view.encoded()) << "DatumView transform does not support encoded "
+      << "datums; decode into a Datum or cv::Mat first";
+
+  const int crop_size = param_.crop_size();
+  const int datum_height = view.height();
+  const int datum_width = view.width();
+
+  // Check dimensions.
+  const int height = transformed_blob->height();
+  const int width = transformed_blob->width();
+
+  CHECK_EQ(transformed_blob->channels(), view.channels());
+  CHECK_GE(transformed_blob->num(), 1);
+
+  if (crop_size) {
+    CHECK_EQ(crop_size, height);
+    CHECK_EQ(crop_size, width);
+  } else {
+    CHECK_EQ(datum_height, height);
+    CHECK_EQ(datum_width, width);
+  }
+
+  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+  Transform(view, transformed_data, rng_.get());
 }
 
 template<typename Dtype>
@@ -193,6 +423,30 @@ void DataTransformer<Dtype>::Transform(const vector<Datum> & datum_vector,
   CHECK_GT(datum_num, 0) << "There is no datum to add";
   CHECK_LE(datum_num, num) <<
     "The size of datum_vector must be no greater than transformed_blob->num()";
+  const int threads = std::min(
+      std::max(static_cast<int>(param_.threads()), 1), datum_num);
+  if (threads > 1) {
+    // The per-datum transform lazily replicates a single mean_value and
+    // maps the mean blob; do both up front so workers only read.
+    if (channels > 1 && mean_values_.size() == 1) {
+      for (int c = 1; c < channels; ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+    LoadMeanFile();
+    if (data_mean_.count() > 0) {
+      data_mean_.mutable_cpu_data();
+    }
+    boost::thread_group workers;
+    for (int t = 1; t < threads; ++t) {
+      workers.add_thread(new boost::thread(
+          &DataTransformer<Dtype>::TransformWorker, this, &datum_vector,
+          transformed_blob, t, threads));
+    }
+    TransformWorker(&datum_vector, transformed_blob, 0, threads);
+    workers.join_all();
+    return;
+  }
   Blob<Dtype> uni_blob(1, channels, height, width);
   for (int item_id = 0; item_id < datum_num; ++item_id) {
     int offset = transformed_blob->offset(item_id);
@@ -201,6 +455,149 @@ void DataTransformer<Dtype>::Transform(const vector<Datum> & datum_vector,
   }
 }
 
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformWorker(
+    const vector<Datum>* datum_vector, Blob<Dtype>* transformed_blob,
+    int worker, int num_workers) {
+  Caffe::RNG* rng = worker < worker_rngs_.size()
+      ? worker_rngs_[worker].get() : NULL;
+  const int datum_num = datum_vector->size();
+  Blob<Dtype> uni_blob(1, transformed_blob->channels(),
+      transformed_blob->height(), transformed_blob->width());
+  for (int item_id = worker; item_id < datum_num; item_id += num_workers) {
+    int offset = transformed_blob->offset(item_id);
+    uni_blob.set_cpu_data(transformed_blob->mutable_cpu_data() + offset);
+    Transform((*datum_vector)[item_id], &uni_blob, rng);
+  }
+}
+
+template<typename Dtype>
+bool DataTransformer<Dtype>::IsIdentity(const Datum& datum) const {
+  if (datum.encoded() || datum.data().size() == 0) { return false; }
+  if (param_.mirror() || param_.scale() != Dtype(1)) { return false; }
+  if (param_.has_mean_file() || param_.mean_value_size() > 0) {
+    return false;
+  }
+  if (NeedsAugmentation(param_)) { return false; }
+  const int crop_size = param_.crop_size();
+  if (crop_size != 0 &&
+      (crop_size != datum.height() || crop_size != datum.width())) {
+    return false;
+  }
+  return true;
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformBatch(
+    const vector<Datum*>& datum_vector, Blob<Dtype>* transformed_blob) {
+  const int num = datum_vector.size();
+  CHECK_GT(num, 0) << "There is no datum to transform";
+  CHECK_LE(num, transformed_blob->num());
+  const Datum& first = *datum_vector[0];
+  if (first.encoded()) {
+    // Encoded datums need per-item decoding; no batch fast path.
+    Blob<Dtype> uni_blob(1, transformed_blob->channels(),
+        transformed_blob->height(), transformed_blob->width());
+    for (int item_id = 0; item_id < num; ++item_id) {
+      uni_blob.set_cpu_data(transformed_blob->mutable_cpu_data()
+          + transformed_blob->offset(item_id));
+      Transform(*datum_vector[item_id], &uni_blob);
+    }
+    return;
+  }
+
+  // Validate the output shape once against the first datum.
+  const int crop_size = param_.crop_size();
+  const int height = transformed_blob->height();
+  const int width = transformed_blob->width();
+  CHECK_EQ(transformed_blob->channels(), first.channels());
+  if (crop_size) {
+    CHECK_EQ(crop_size, height);
+    CHECK_EQ(crop_size, width);
+  } else {
+    CHECK_EQ(first.height(), height);
+    CHECK_EQ(first.width(), width);
+  }
+
+  if (IsIdentity(first)) {
+    // Identity transforms collapse to one widening copy per datum;
+    // pre-resized eval datasets hit this on every item.
+    const int item_size = transformed_blob->count() / transformed_blob->num();
+    Dtype* top_data = transformed_blob->mutable_cpu_data();
+    for (int item_id = 0; item_id < num; ++item_id) {
+      const Datum& datum = *datum_vector[item_id];
+      CHECK_EQ(datum.channels(), first.channels());
+      CHECK_EQ(datum.height(), first.height());
+      CHECK_EQ(datum.width(), first.width());
+      const string& data = datum.data();
+      CHECK_EQ(data.size(), item_size);
+      Dtype* out = top_data + item_id * item_size;
+      for (int i = 0; i < item_size; ++i) {
+        out[i] = static_cast<Dtype>(static_cast<uint8_t>(data[i]));
+      }
+    }
+    return;
+  }
+
+  // Draw every random decision up front, in item order, so the result
+  // matches per-item Transform() calls and is independent of how the
+  // pixel work is threaded below.
+  vector<int> params(3 * num);
+  for (int item_id = 0; item_id < num; ++item_id) {
+    const Datum& datum = *datum_vector[item_id];
+    CHECK_EQ(datum.channels(), first.channels());
+    CHECK_EQ(datum.height(), first.height());
+    CHECK_EQ(datum.width(), first.width());
+    int h_off, w_off;
+    bool do_mirror;
+    SampleTransformParams(datum.height(), datum.width(), &h_off, &w_off,
+        &do_mirror, rng_.get());
+    params[3 * item_id] = h_off;
+    params[3 * item_id + 1] = w_off;
+    params[3 * item_id + 2] = do_mirror;
+  }
+
+  const int threads = std::min(
+      std::max(static_cast<int>(param_.threads()), 1), num);
+  if (threads > 1) {
+    // As in Transform(vector<Datum>): hoist the lazy shared-state updates
+    // out of the per-datum path so workers only read.
+    if (first.channels() > 1 && mean_values_.size() == 1) {
+      for (int c = 1; c < first.channels(); ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+    LoadMeanFile();
+    if (data_mean_.count() > 0) {
+      data_mean_.mutable_cpu_data();
+    }
+    boost::thread_group workers;
+    for (int t = 1; t < threads; ++t) {
+      workers.add_thread(new boost::thread(
+          &DataTransformer<Dtype>::ApplyBatchWorker, this, &datum_vector,
+          transformed_blob, &params, t, threads));
+    }
+    ApplyBatchWorker(&datum_vector, transformed_blob, &params, 0, threads);
+    workers.join_all();
+  } else {
+    ApplyBatchWorker(&datum_vector, transformed_blob, &params, 0, 1);
+  }
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::ApplyBatchWorker(
+    const vector<Datum*>* datum_vector, Blob<Dtype>* transformed_blob,
+    const vector<int>* params, int worker, int num_workers) {
+  const int num = datum_vector->size();
+  const int item_size = transformed_blob->count() / transformed_blob->num();
+  Dtype* top_data = transformed_blob->mutable_cpu_data();
+  for (int item_id = worker; item_id < num; item_id += num_workers) {
+    ApplyTransform(*(*datum_vector)[item_id],
+        top_data + item_id * item_size, (*params)[3 * item_id],
+        (*params)[3 * item_id + 1], (*params)[3 * item_id + 2]);
+  }
+}
+
 #ifdef USE_OPENCV
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const vector<cv::Mat> & mat_vector,
@@ -225,6 +622,17 @@ void DataTransformer<Dtype>::Transform(const vector<cv::Mat> & mat_vector,
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
                                        Blob<Dtype>* transformed_blob) {
+  Transform(cv_img, transformed_blob, rng_.get());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
+                                       Blob<Dtype>* transformed_blob,
+                                       Caffe::RNG* rng) {
+  if (phase_ == TRAIN && NeedsAugmentation(param_)) {
+    TransformAugmented(cv_img, transformed_blob, rng);
+    return;
+  }
   const int crop_size = param_.crop_size();
   const int img_channels = cv_img.channels();
   const int img_height = cv_img.rows;
@@ -244,8 +652,9 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
 
   const Dtype scale = param_.scale();
-  const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
+  const bool do_mirror = param_.mirror() && Rand(2, rng);
+  LoadMeanFile();
+  const bool has_mean_file = data_mean_.count() > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(img_channels, 0);
@@ -278,8 +687,8 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
     CHECK_EQ(crop_size, width);
     // We only do random crop when we do training.
     if (phase_ == TRAIN) {
-      h_off = Rand(img_height - crop_size + 1);
-      w_off = Rand(img_width - crop_size + 1);
+      h_off = Rand(img_height - crop_size + 1, rng);
+      w_off = Rand(img_width - crop_size + 1, rng);
     } else {
       h_off = (img_height - crop_size) / 2;
       w_off = (img_width - crop_size) / 2;
@@ -293,31 +702,146 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
 
   CHECK(cv_cropped_img.data);
 
+  // Fused crop + mirror + HWC->CHW transpose, one row at a time. Writes
+  // walk every channel plane sequentially; the mirror decision only flips
+  // the read index, so there is no per-pixel destination arithmetic. The
+  // mean-mode dispatch is hoisted out of the pixel loop as in the uint8
+  // Datum path.
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  int top_index;
+  vector<Dtype*> out_rows(img_channels);
+  vector<const Dtype*> mean_rows(img_channels);
   for (int h = 0; h < height; ++h) {
     const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
-    int img_index = 0;
+    for (int c = 0; c < img_channels; ++c) {
+      out_rows[c] = transformed_data + (c * height + h) * width;
+      if (has_mean_file) {
+        mean_rows[c] = mean + (c * img_height + h_off + h) * img_width + w_off;
+      }
+    }
+    if (has_mean_file) {
+      for (int w = 0; w < width; ++w) {
+        const int rw = do_mirror ? width - 1 - w : w;
+        const uchar* px = ptr + rw * img_channels;
+        for (int c = 0; c < img_channels; ++c) {
+          out_rows[c][w] = (static_cast<Dtype>(px[c]) - mean_rows[c][rw])
+              * scale;
+        }
+      }
+    } else if (has_mean_values) {
+      for (int w = 0; w < width; ++w) {
+        const int rw = do_mirror ? width - 1 - w : w;
+        const uchar* px = ptr + rw * img_channels;
+        for (int c = 0; c < img_channels; ++c) {
+          out_rows[c][w] = (static_cast<Dtype>(px[c]) - mean_values_[c])
+              * scale;
+        }
+      }
+    } else {
+      for (int w = 0; w < width; ++w) {
+        const int rw = do_mirror ? width - 1 - w : w;
+        const uchar* px = ptr + rw * img_channels;
+        for (int c = 0; c < img_channels; ++c) {
+          out_rows[c][w] = static_cast<Dtype>(px[c]) * scale;
+        }
+      }
+    }
+  }
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformAugmented(const cv::Mat& cv_img,
+    Blob<Dtype>* transformed_blob, Caffe::RNG* rng) {
+  const int img_channels = cv_img.channels();
+  const int img_height = cv_img.rows;
+  const int img_width = cv_img.cols;
+  const int height = transformed_blob->height();
+  const int width = transformed_blob->width();
+
+  CHECK_EQ(transformed_blob->channels(), img_channels);
+  CHECK_GE(transformed_blob->num(), 1);
+  CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
+  LoadMeanFile();
+  CHECK_EQ(data_mean_.count(), 0) << "Augmentations resample the image, so "
+      << "a pixel-wise mean_file is undefined; use mean_value or a "
+      << "spatially constant mean instead";
+
+  const Dtype scale = param_.scale();
+  const bool do_mirror = param_.mirror() && Rand(2, rng);
+  const bool has_mean_values = mean_values_.size() > 0;
+  if (has_mean_values) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == img_channels) <<
+     "Specify either 1 mean_value or as many as channels: " << img_channels;
+    if (img_channels > 1 && mean_values_.size() == 1) {
+      // Replicate the mean_value for simplicity
+      for (int c = 1; c < img_channels; ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+  }
+
+  // Sample the patch: area fraction and aspect ratio, then its position.
+  float patch_h = img_height;
+  float patch_w = img_width;
+  if (param_.random_area_lower() > 0) {
+    const float area = img_height * img_width
+        * RandUniform(rng, param_.random_area_lower(),
+                      param_.random_area_upper());
+    const float aspect = RandUniform(rng, param_.random_aspect_lower(),
+                                     param_.random_aspect_upper());
+    patch_w = std::min(std::sqrt(area * aspect),
+                       static_cast<float>(img_width));
+    patch_h = std::min(std::sqrt(area / aspect),
+                       static_cast<float>(img_height));
+  }
+  const float x0 = RandUniform(rng, 0, img_width - patch_w);
+  const float y0 = RandUniform(rng, 0, img_height - patch_h);
+  const float angle = param_.max_rotation() > 0
+      ? RandUniform(rng, -param_.max_rotation(), param_.max_rotation())
+          * 3.14159265358979323846f / 180
+      : 0;
+  const float sin_a = std::sin(angle);
+  const float cos_a = std::cos(angle);
+  // Photometric jitter, applied about mid-gray before mean subtraction.
+  const float brightness = param_.brightness() > 0
+      ? RandUniform(rng, -param_.brightness(), param_.brightness()) : 0;
+  const float contrast = param_.contrast() > 0
+      ? RandUniform(rng, 1 - param_.contrast(), 1 + param_.contrast()) : 1;
+
+  // One pass over the output: map each pixel through mirror, rotation
+  // about the patch center and the patch-to-output scaling, bilinearly
+  // sample the source, jitter, then subtract mean and scale.
+  const float cx = x0 + patch_w / 2;
+  const float cy = y0 + patch_h / 2;
+  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+  for (int h = 0; h < height; ++h) {
     for (int w = 0; w < width; ++w) {
+      const int rw = do_mirror ? width - 1 - w : w;
+      const float px = ((rw + 0.5f) / width - 0.5f) * patch_w;
+      const float py = ((h + 0.5f) / height - 0.5f) * patch_h;
+      const float sx = std::min(std::max(
+          cx + cos_a * px - sin_a * py - 0.5f, 0.f), img_width - 1.f);
+      const float sy = std::min(std::max(
+          cy + sin_a * px + cos_a * py - 0.5f, 0.f), img_height - 1.f);
+      const int x1 = static_cast<int>(sx);
+      const int y1 = static_cast<int>(sy);
+      const int x2 = std::min(x1 + 1, img_width - 1);
+      const int y2 = std::min(y1 + 1, img_height - 1);
+      const float dx = sx - x1;
+      const float dy = sy - y1;
+      const uchar* p11 = cv_img.ptr<uchar>(y1) + x1 * img_channels;
+      const uchar* p12 = cv_img.ptr<uchar>(y1) + x2 * img_channels;
+      const uchar* p21 = cv_img.ptr<uchar>(y2) + x1 * img_channels;
+      const uchar* p22 = cv_img.ptr<uchar>(y2) + x2 * img_channels;
       for (int c = 0; c < img_channels; ++c) {
-        if (do_mirror) {
-          top_index = (c * height + h) * width + (width - 1 - w);
-        } else {
-          top_index = (c * height + h) * width + w;
-        }
-        // int top_index = (c * height + h) * width + w;
-        Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
-        if (has_mean_file) {
-          int mean_index = (c * img_height + h_off + h) * img_width + w_off + w;
+        float pixel = (1 - dy) * ((1 - dx) * p11[c] + dx * p12[c])
+                    + dy * ((1 - dx) * p21[c] + dx * p22[c]);
+        pixel = (pixel - 127.5f) * contrast + 127.5f + brightness;
+        const int top_index = (c * height + h) * width + w;
+        if (has_mean_values) {
           transformed_data[top_index] =
-            (pixel - mean[mean_index]) * scale;
+              (static_cast<Dtype>(pixel) - mean_values_[c]) * scale;
         } else {
-          if (has_mean_values) {
-            transformed_data[top_index] =
-              (pixel - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = pixel * scale;
-          }
+          transformed_data[top_index] = static_cast<Dtype>(pixel) * scale;
         }
       }
     }
@@ -359,7 +883,8 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
 
   const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
+  LoadMeanFile();
+  const bool has_mean_file = data_mean_.count() > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   int h_off = 0;
@@ -519,24 +1044,72 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(
 }
 #endif  // USE_OPENCV
 
+template<typename Dtype>
+void DataTransformer<Dtype>::SampleTransformParams(int datum_height,
+    int datum_width, int* h_off, int* w_off, bool* do_mirror) {
+  SampleTransformParams(datum_height, datum_width, h_off, w_off, do_mirror,
+      rng_.get());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::SampleTransformParams(int datum_height,
+    int datum_width, int* h_off, int* w_off, bool* do_mirror,
+    Caffe::RNG* rng) {
+  const int crop_size = param_.crop_size();
+  CHECK_GE(datum_height, crop_size);
+  CHECK_GE(datum_width, crop_size);
+  // Same draw order as the per-element Transform() paths: mirror first,
+  // then the crop offsets.
+  *do_mirror = param_.mirror() && Rand(2, rng);
+  *h_off = 0;
+  *w_off = 0;
+  if (crop_size) {
+    // We only do random crop when we do training.
+    if (phase_ == TRAIN) {
+      *h_off = Rand(datum_height - crop_size + 1, rng);
+      *w_off = Rand(datum_width - crop_size + 1, rng);
+    } else {
+      *h_off = (datum_height - crop_size) / 2;
+      *w_off = (datum_width - crop_size) / 2;
+    }
+  }
+}
+
 template <typename Dtype>
 void DataTransformer<Dtype>::InitRand() {
   const bool needs_rand = param_.mirror() ||
-      (phase_ == TRAIN && param_.crop_size());
+      (phase_ == TRAIN && (param_.crop_size() || NeedsAugmentation(param_)));
   if (needs_rand) {
     const unsigned int rng_seed = caffe_rng_rand();
     rng_.reset(new Caffe::RNG(rng_seed));
   } else {
     rng_.reset();
   }
+  // One stream per batch transform worker, each seeded from the solver
+  // RNG so threaded runs are reproducible for a fixed seed and thread
+  // count. Worker 0 reuses rng_, keeping single-threaded runs unchanged.
+  worker_rngs_.clear();
+  if (needs_rand) {
+    worker_rngs_.push_back(rng_);
+    const int threads = std::max(static_cast<int>(param_.threads()), 1);
+    for (int i = 1; i < threads; ++i) {
+      worker_rngs_.push_back(
+          shared_ptr<Caffe::RNG>(new Caffe::RNG(caffe_rng_rand())));
+    }
+  }
 }
 
 template <typename Dtype>
 int DataTransformer<Dtype>::Rand(int n) {
-  CHECK(rng_);
+  return Rand(n, rng_.get());
+}
+
+template <typename Dtype>
+int DataTransformer<Dtype>::Rand(int n, Caffe::RNG* rng_stream) {
+  CHECK(rng_stream);
   CHECK_GT(n, 0);
   caffe::rng_t* rng =
-      static_cast<caffe::rng_t*>(rng_->generator());
+      static_cast<caffe::rng_t*>(rng_stream->generator());
   return ((*rng)() % n);
 }
 
@@ -0,0 +1,86 @@
+#include <vector>
+
+#include "caffe/data_transformer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+__global__ void TransformBatchKernel(const int nthreads, const int channels,
+    const int datum_height, const int datum_width, const int height,
+    const int width, const Dtype scale, const bool has_mean_file,
+    const Dtype* mean, const bool has_mean_values, const Dtype* mean_values,
+    const unsigned char* data, const int* params, Dtype* top_data) {
+  CUDA_KERNEL_LOOP(index, nthreads) {
+    const int w = index % width;
+    const int h = (index / width) % height;
+    const int c = (index / width / height) % channels;
+    const int n = index / width / height / channels;
+    const int h_off = params[n * 3];
+    const int w_off = params[n * 3 + 1];
+    const bool mirror = params[n * 3 + 2];
+    // Mirroring flips the read column, matching the CPU row kernels.
+    const int rw = mirror ? width - 1 - w : w;
+    const int data_index =
+        ((n * channels + c) * datum_height + h_off + h) * datum_width
+        + w_off + rw;
+    Dtype element = static_cast<Dtype>(data[data_index]);
+    if (has_mean_file) {
+      const int mean_index =
+          (c * datum_height + h_off + h) * datum_width + w_off + rw;
+      element -= mean[mean_index];
+    } else if (has_mean_values) {
+      element -= mean_values[c];
+    }
+    top_data[index] = element * scale;
+  }
+}
+
+template <typename Dtype>
+void DataTransformer<Dtype>::TransformGPU(int num, int channels,
+    int datum_height, int datum_width, const unsigned char* data,
+    const int* params, Dtype* transformed_data) {
+  const int crop_size = param_.crop_size();
+  const int height = crop_size ? crop_size : datum_height;
+  const int width = crop_size ? crop_size : datum_width;
+  LoadMeanFile();
+  const bool has_mean_file = data_mean_.count() > 0;
+  const bool has_mean_values = mean_values_.size() > 0;
+
+  const Dtype* mean = NULL;
+  if (has_mean_file) {
+    CHECK_EQ(channels, data_mean_.channels());
+    CHECK_EQ(datum_height, data_mean_.height());
+    CHECK_EQ(datum_width, data_mean_.width());
+    mean = data_mean_.gpu_data();
+  }
+  const Dtype* mean_values = NULL;
+  if (has_mean_values) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == channels) <<
+     "Specify either 1 mean_value or as many as channels: " << channels;
+    if (mean_values_blob_.count() != channels) {
+      mean_values_blob_.Reshape(vector<int>(1, channels));
+      Dtype* values = mean_values_blob_.mutable_cpu_data();
+      for (int c = 0; c < channels; ++c) {
+        values[c] = mean_values_[c < mean_values_.size() ? c : 0];
+      }
+    }
+    mean_values = mean_values_blob_.gpu_data();
+  }
+
+  const int count = num * channels * height * width;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  TransformBatchKernel<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(
+      count, channels, datum_height, datum_width, height, width,
+      Dtype(param_.scale()), has_mean_file, mean, has_mean_values,
+      mean_values, data, params, transformed_data);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void DataTransformer<float>::TransformGPU(int, int, int, int,
+    const unsigned char*, const int*, float*);
+template void DataTransformer<double>::TransformGPU(int, int, int, int,
+    const unsigned char*, const int*, double*);
+
+}  // namespace caffe
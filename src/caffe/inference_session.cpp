@@ -0,0 +1,143 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Leader-based request coalescing: the first caller to join an empty
+// batch becomes its leader, waits up to max_delay_us for followers,
+// then closes the batch and runs it forward while the next batch starts
+// collecting. Followers just park until the leader marks their request
+// done. At most one forward is in flight at a time, so only the leader
+// ever touches the net.
+template <typename Dtype>
+class InferenceSession<Dtype>::Coalescer {
+ public:
+  struct Request {
+    Request(const Dtype* input, const vector<Dtype*>* outputs)
+        : input(input), outputs(outputs), done(false) {}
+    const Dtype* input;
+    const vector<Dtype*>* outputs;
+    bool done;
+  };
+
+  Coalescer() : forward_in_flight_(false) {}
+
+  void Infer(InferenceSession* session, const Dtype* input,
+      const vector<Dtype*>& outputs) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (open_batch_.size() >= static_cast<size_t>(session->max_batch_)) {
+      batch_open_.wait(lock);
+    }
+    Request request(input, &outputs);
+    open_batch_.push_back(&request);
+    if (open_batch_.size() > 1) {
+      // Follower: wake the leader in case this arrival filled the
+      // batch, then wait for it to deliver the results.
+      batch_grew_.notify_one();
+      while (!request.done) {
+        request_done_.wait(lock);
+      }
+      return;
+    }
+    // Leader: give followers max_delay_us to arrive, unless the batch
+    // fills up first.
+    if (session->max_delay_us_ > 0) {
+      const boost::system_time deadline = boost::get_system_time()
+          + boost::posix_time::microseconds(session->max_delay_us_);
+      while (open_batch_.size() < static_cast<size_t>(session->max_batch_)
+          && batch_grew_.timed_wait(lock, deadline)) {}
+    }
+    vector<Request*> batch;
+    batch.swap(open_batch_);
+    batch_open_.notify_all();  // the next batch may start collecting
+    while (forward_in_flight_) {
+      forward_done_.wait(lock);
+    }
+    forward_in_flight_ = true;
+    {
+      // Run forward unlocked so the next batch keeps filling meanwhile.
+      vector<const Dtype*> inputs(batch.size());
+      vector<const vector<Dtype*>*> batch_outputs(batch.size());
+      for (size_t i = 0; i < batch.size(); ++i) {
+        inputs[i] = batch[i]->input;
+        batch_outputs[i] = batch[i]->outputs;
+      }
+      lock.unlock();
+      session->ForwardBatch(inputs, batch_outputs);
+      lock.lock();
+    }
+    forward_in_flight_ = false;
+    forward_done_.notify_one();
+    for (size_t i = 0; i < batch.size(); ++i) {
+      batch[i]->done = true;
+    }
+    request_done_.notify_all();
+  }
+
+ private:
+  boost::mutex mutex_;
+  boost::condition_variable batch_open_, batch_grew_;
+  boost::condition_variable forward_done_, request_done_;
+  vector<Request*> open_batch_;
+  bool forward_in_flight_;
+};
+
+template <typename Dtype>
+InferenceSession<Dtype>::InferenceSession(Net<Dtype>* net, int max_batch,
+    int max_delay_us)
+    : net_(net), max_batch_(max_batch), max_delay_us_(max_delay_us) {
+  CHECK_GE(max_batch_, 1);
+  CHECK_GE(max_delay_us_, 0);
+  CHECK_EQ(net_->num_inputs(), 1)
+      << "InferenceSession requires a net with a single input blob";
+  input_size_ = net_->input_blobs()[0]->count(1);
+  for (int i = 0; i < net_->num_outputs(); ++i) {
+    output_sizes_.push_back(net_->output_blobs()[i]->count(1));
+  }
+  coalescer_.reset(new Coalescer());
+}
+
+template <typename Dtype>
+InferenceSession<Dtype>::~InferenceSession() {}
+
+template <typename Dtype>
+void InferenceSession<Dtype>::Infer(const Dtype* input,
+    const vector<Dtype*>& outputs) {
+  CHECK_EQ(outputs.size(), output_sizes_.size());
+  coalescer_->Infer(this, input, outputs);
+}
+
+template <typename Dtype>
+void InferenceSession<Dtype>::ForwardBatch(
+    const vector<const Dtype*>& inputs,
+    const vector<const vector<Dtype*>*>& outputs) {
+  Blob<Dtype>* input_blob = net_->input_blobs()[0];
+  vector<int> shape = input_blob->shape();
+  shape[0] = inputs.size();
+  input_blob->Reshape(shape);
+  Dtype* input_data = input_blob->mutable_cpu_data();
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    caffe_copy(input_size_, inputs[i], input_data + i * input_size_);
+  }
+  net_->Forward();
+  // Demultiplex each output blob's batch slices back to the callers.
+  for (int j = 0; j < net_->num_outputs(); ++j) {
+    const Blob<Dtype>* output_blob = net_->output_blobs()[j];
+    CHECK_EQ(output_blob->shape(0), static_cast<int>(inputs.size()));
+    const Dtype* output_data = output_blob->cpu_data();
+    const int size = output_sizes_[j];
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      caffe_copy(size, output_data + i * size, (*outputs[i])[j]);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(InferenceSession);
+
+}  // namespace caffe
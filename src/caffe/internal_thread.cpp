@@ -1,8 +1,10 @@
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <exception>
 
 #include "caffe/internal_thread.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/worker_pool.hpp"
 
 namespace caffe {
 
@@ -11,11 +13,16 @@ InternalThread::~InternalThread() {
 }
 
 bool InternalThread::is_started() const {
-  return thread_ && thread_->joinable();
+  // Mirrors the joinable() semantics of the dedicated-thread version:
+  // true from start until StopInternalThread, even if the entry
+  // function has already returned.
+  return handle_.get() != NULL;
 }
 
 bool InternalThread::must_stop() {
-  return thread_ && thread_->interruption_requested();
+  // Only meaningful on the thread running InternalThreadEntry, which is
+  // the only caller.
+  return boost::this_thread::interruption_requested();
 }
 
 void InternalThread::StartInternalThread() {
@@ -26,24 +33,23 @@ void InternalThread::StartInternalThread() {
   CUDA_CHECK(cudaGetDevice(&device));
 #endif
   Caffe::Brew mode = Caffe::mode();
+  Caffe::NumaPolicy numa_policy = Caffe::numa_policy();
   int rand_seed = caffe_rng_rand();
   int solver_count = Caffe::solver_count();
   bool root_solver = Caffe::root_solver();
 
-  try {
-    thread_.reset(new boost::thread(&InternalThread::entry, this, device, mode,
-          rand_seed, solver_count, root_solver));
-  } catch (std::exception& e) {
-    LOG(FATAL) << "Thread exception: " << e.what();
-  }
+  handle_ = WorkerPool::Submit(boost::bind(&InternalThread::entry, this,
+      device, mode, numa_policy, rand_seed, solver_count, root_solver));
 }
 
-void InternalThread::entry(int device, Caffe::Brew mode, int rand_seed,
-    int solver_count, bool root_solver) {
+void InternalThread::entry(int device, Caffe::Brew mode,
+    Caffe::NumaPolicy numa_policy, int rand_seed, int solver_count,
+    bool root_solver) {
 #ifndef CPU_ONLY
   CUDA_CHECK(cudaSetDevice(device));
 #endif
   Caffe::set_mode(mode);
+  Caffe::set_numa_policy(numa_policy);
   Caffe::set_random_seed(rand_seed);
   Caffe::set_solver_count(solver_count);
   Caffe::set_root_solver(root_solver);
@@ -52,14 +58,10 @@ void InternalThread::entry(int device, Caffe::Brew mode, int rand_seed,
 }
 
 void InternalThread::StopInternalThread() {
-  if (is_started()) {
-    thread_->interrupt();
-    try {
-      thread_->join();
-    } catch (boost::thread_interrupted&) {
-    } catch (std::exception& e) {
-      LOG(FATAL) << "Thread exception: " << e.what();
-    }
+  if (handle_) {
+    handle_->Interrupt();
+    handle_->Join();
+    handle_.reset();
   }
 }
 
@@ -7,16 +7,21 @@
 
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
+#include "caffe/layers/batch_norm_layer.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/layers/relu_layer.hpp"
 #include "caffe/layers/sigmoid_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/layers/temporal_conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #ifdef USE_CUDNN
+#include "caffe/layers/cudnn_batch_norm_layer.hpp"
 #include "caffe/layers/cudnn_conv_layer.hpp"
 #include "caffe/layers/cudnn_lcn_layer.hpp"
 #include "caffe/layers/cudnn_lrn_layer.hpp"
@@ -33,6 +38,78 @@
 
 namespace caffe {
 
+// Get batch norm layer according to engine. CUDNN is never picked for
+// DEFAULT: it carries two extra learned parameter blobs (fused scale and
+// bias), so silently upgrading existing nets would change their parameter
+// layout.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetBatchNormLayer(const LayerParameter& param) {
+  BatchNormParameter_Engine engine = param.batch_norm_param().engine();
+  if (engine == BatchNormParameter_Engine_DEFAULT) {
+    engine = BatchNormParameter_Engine_CAFFE;
+  }
+  if (engine == BatchNormParameter_Engine_CAFFE) {
+    return shared_ptr<Layer<Dtype> >(new BatchNormLayer<Dtype>(param));
+#ifdef USE_CUDNN
+  } else if (engine == BatchNormParameter_Engine_CUDNN) {
+    return shared_ptr<Layer<Dtype> >(new CuDNNBatchNormLayer<Dtype>(param));
+#endif
+  } else {
+    LOG(FATAL) << "Layer " << param.name() << " has unknown engine.";
+  }
+}
+
+REGISTER_LAYER_CREATOR(BatchNorm, GetBatchNormLayer);
+
+// Whether the configured kernel/stride/dilation let the DIRECT engine
+// handle every image: 2D 3x3 kernels at stride 1 without dilation. Axis
+// and input-shape conditions are re-checked by the layer at Reshape time.
+bool DirectConvolutionSupported(const ConvolutionParameter& conv_param) {
+  if (conv_param.force_nd_im2col()) { return false; }
+  if (conv_param.has_kernel_h() || conv_param.has_kernel_w()) {
+    if (conv_param.kernel_h() != 3 || conv_param.kernel_w() != 3) {
+      return false;
+    }
+  } else {
+    if (conv_param.kernel_size_size() == 0) { return false; }
+    for (int i = 0; i < conv_param.kernel_size_size(); ++i) {
+      if (conv_param.kernel_size(i) != 3) { return false; }
+    }
+  }
+  if (conv_param.has_stride_h() || conv_param.has_stride_w()) {
+    if (conv_param.stride_h() != 1 || conv_param.stride_w() != 1) {
+      return false;
+    }
+  }
+  for (int i = 0; i < conv_param.stride_size(); ++i) {
+    if (conv_param.stride(i) != 1) { return false; }
+  }
+  for (int i = 0; i < conv_param.dilation_size(); ++i) {
+    if (conv_param.dilation(i) != 1) { return false; }
+  }
+  return true;
+}
+
+// Whether the configured kernel is 1-D (exactly one spatial axis of size
+// 1) so the TEMPORAL engine can skip im2col. The pass-through axis and
+// input-shape conditions are re-checked by the layer at Reshape time.
+bool TemporalConvolutionSupported(const ConvolutionParameter& conv_param) {
+  if (conv_param.force_nd_im2col()) { return false; }
+  int kernel_h = -1, kernel_w = -1;
+  if (conv_param.has_kernel_h() || conv_param.has_kernel_w()) {
+    kernel_h = conv_param.kernel_h();
+    kernel_w = conv_param.kernel_w();
+  } else if (conv_param.kernel_size_size() == 2) {
+    kernel_h = conv_param.kernel_size(0);
+    kernel_w = conv_param.kernel_size(1);
+  } else {
+    // A single repeated kernel_size is square; 1x1 is already a plain
+    // GEMM without a column buffer.
+    return false;
+  }
+  return (kernel_h == 1 && kernel_w > 1) || (kernel_w == 1 && kernel_h > 1);
+}
+
 // Get convolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetConvolutionLayer(
@@ -49,6 +126,12 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 #endif
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
     engine = ConvolutionParameter_Engine_CAFFE;
+    if (DirectConvolutionSupported(conv_param)) {
+      engine = ConvolutionParameter_Engine_DIRECT;
+    }
+    if (TemporalConvolutionSupported(conv_param)) {
+      engine = ConvolutionParameter_Engine_TEMPORAL;
+    }
 #ifdef USE_CUDNN
     if (!use_dilation) {
       engine = ConvolutionParameter_Engine_CUDNN;
@@ -57,6 +140,14 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
     return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_DIRECT) {
+    return shared_ptr<Layer<Dtype> >(new DirectConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_WINOGRAD) {
+    return shared_ptr<Layer<Dtype> >(
+        new WinogradConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_TEMPORAL) {
+    return shared_ptr<Layer<Dtype> >(
+        new TemporalConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     if (use_dilation) {
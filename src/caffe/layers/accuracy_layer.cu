@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "caffe/layers/accuracy_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// One thread per sample counts how many classes outscore the true
+// label; the prediction is top-k correct iff fewer than k do. Ties are
+// ranked toward the larger index, like the CPU path's partial_sort, so
+// both paths agree exactly. Writes a 0/1 correctness flag and a 0/1
+// counted flag (0 for ignored labels) per sample for reduction.
+template <typename Dtype>
+__global__ void AccuracyForwardGPU(const int nthreads,
+    const Dtype* bottom_data, const Dtype* label, Dtype* acc,
+    const int dim, const int inner_num, const int num_labels,
+    const int top_k, const bool has_ignore_label, const int ignore_label,
+    Dtype* counts) {
+  CUDA_KERNEL_LOOP(index, nthreads) {
+    const int i = index / inner_num;
+    const int j = index % inner_num;
+    const int label_value = static_cast<int>(label[index]);
+    if (has_ignore_label && label_value == ignore_label) {
+      acc[index] = 0;
+      counts[index] = 0;
+    } else {
+      const Dtype label_score =
+          bottom_data[i * dim + label_value * inner_num + j];
+      int num_better = 0;
+      for (int k = 0; k < num_labels; ++k) {
+        const Dtype score = bottom_data[i * dim + k * inner_num + j];
+        if (score > label_score ||
+            (score == label_score && k > label_value)) {
+          ++num_better;
+        }
+      }
+      acc[index] = num_better < top_k;
+      counts[index] = 1;
+    }
+  }
+}
+
+template <typename Dtype>
+void AccuracyLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  if (top.size() > 1) {
+    // The per-class accuracy top is a reporting feature; keep it on the
+    // host path rather than scattering per-class atomics.
+    Forward_cpu(bottom, top);
+    return;
+  }
+  const Dtype* bottom_data = bottom[0]->gpu_data();
+  const Dtype* bottom_label = bottom[1]->gpu_data();
+  const int dim = bottom[0]->count() / outer_num_;
+  const int num_labels = bottom[0]->shape(label_axis_);
+  const int nthreads = outer_num_ * inner_num_;
+  // The layer has no backward, so the bottom diffs are free scratch for
+  // the per-sample flags; only the reduced scalars come back to host.
+  Dtype* acc_data = bottom[0]->mutable_gpu_diff();
+  Dtype* counts = bottom[1]->mutable_gpu_diff();
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  AccuracyForwardGPU<Dtype><<<CAFFE_GET_BLOCKS(nthreads),
+      CAFFE_CUDA_NUM_THREADS>>>(nthreads, bottom_data, bottom_label,
+      acc_data, dim, inner_num_, num_labels, top_k_, has_ignore_label_,
+      ignore_label_, counts);
+  CUDA_POST_KERNEL_CHECK;
+  Dtype acc, valid_count;
+  caffe_gpu_asum(nthreads, acc_data, &acc);
+  caffe_gpu_asum(nthreads, counts, &valid_count);
+  top[0]->mutable_cpu_data()[0] =
+      valid_count > 0 ? acc / valid_count : Dtype(0);
+  // Clear the borrowed diffs so debug dumps don't see stale flags.
+  caffe_gpu_set(nthreads, Dtype(0), acc_data);
+  caffe_gpu_set(nthreads, Dtype(0), counts);
+}
+
+INSTANTIATE_LAYER_GPU_FORWARD(AccuracyLayer);
+
+}  // namespace caffe
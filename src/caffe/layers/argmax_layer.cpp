@@ -66,35 +66,51 @@ void ArgMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     axis_dist = 1;
   }
   int num = bottom[0]->count() / dim;
-  std::vector<std::pair<Dtype, int> > bottom_data_vector(dim);
+  // Keep a min-heap of the k best (value, index) pairs per item instead
+  // of sorting all dim classes; the heap member is reused across calls
+  // so steady-state forwards do not allocate. Ordering (including ties,
+  // broken toward the larger index) matches the old partial_sort.
+  std::vector<std::pair<Dtype, int> >& heap = top_k_heap_;
+  std::greater<std::pair<Dtype, int> > comp;
   for (int i = 0; i < num; ++i) {
+    heap.clear();
     for (int j = 0; j < dim; ++j) {
-      bottom_data_vector[j] = std::make_pair(
+      const std::pair<Dtype, int> entry(
         bottom_data[(i / axis_dist * dim + j) * axis_dist + i % axis_dist], j);
+      if (heap.size() < top_k_) {
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), comp);
+      } else if (comp(entry, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), comp);
+        heap.back() = entry;
+        std::push_heap(heap.begin(), heap.end(), comp);
+      }
     }
-    std::partial_sort(
-        bottom_data_vector.begin(), bottom_data_vector.begin() + top_k_,
-        bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
+    std::sort_heap(heap.begin(), heap.end(), comp);
     for (int j = 0; j < top_k_; ++j) {
       if (out_max_val_) {
         if (has_axis_) {
           // Produces max_val per axis
           top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-            = bottom_data_vector[j].first;
+            = heap[j].first;
         } else {
           // Produces max_ind and max_val
-          top_data[2 * i * top_k_ + j] = bottom_data_vector[j].second;
-          top_data[2 * i * top_k_ + top_k_ + j] = bottom_data_vector[j].first;
+          top_data[2 * i * top_k_ + j] = heap[j].second;
+          top_data[2 * i * top_k_ + top_k_ + j] = heap[j].first;
         }
       } else {
         // Produces max_ind per axis
         top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-          = bottom_data_vector[j].second;
+          = heap[j].second;
       }
     }
   }
 }
 
+#ifdef CPU_ONLY
+STUB_GPU_FORWARD(ArgMaxLayer, Forward);
+#endif
+
 INSTANTIATE_CLASS(ArgMaxLayer);
 REGISTER_LAYER_CLASS(ArgMax);
 
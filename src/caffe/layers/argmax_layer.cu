@@ -0,0 +1,83 @@
+#include <vector>
+
+#include "caffe/layers/argmax_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// One thread per item selects its k maxima by repeated scans, each pass
+// finding the largest (value, index) pair strictly below the previous
+// selection in the same (value, then index) ordering the CPU path uses,
+// so ties resolve identically. O(top_k * dim) per item, which is the
+// classifier regime: small k over one softmax vector. This keeps the
+// result on the device instead of pulling the full probability blob
+// back per request just to rank it.
+template <typename Dtype>
+__global__ void ArgMaxForward(const int num, const int dim,
+    const int axis_dist, const int top_k, const bool out_max_val,
+    const bool has_axis, const Dtype* bottom_data, Dtype* top_data) {
+  CUDA_KERNEL_LOOP(i, num) {
+    Dtype prev_val = 0;
+    int prev_idx = -1;
+    for (int k = 0; k < top_k; ++k) {
+      Dtype best_val = 0;
+      int best_idx = -1;
+      for (int j = 0; j < dim; ++j) {
+        const Dtype val =
+            bottom_data[(i / axis_dist * dim + j) * axis_dist + i % axis_dist];
+        if (k > 0 && !(val < prev_val ||
+                       (val == prev_val && j < prev_idx))) {
+          continue;  // already selected in an earlier pass
+        }
+        if (best_idx < 0 || val > best_val ||
+            (val == best_val && j > best_idx)) {
+          best_val = val;
+          best_idx = j;
+        }
+      }
+      if (out_max_val) {
+        if (has_axis) {
+          // Produces max_val per axis
+          top_data[(i / axis_dist * top_k + k) * axis_dist + i % axis_dist]
+            = best_val;
+        } else {
+          // Produces max_ind and max_val
+          top_data[2 * i * top_k + k] = best_idx;
+          top_data[2 * i * top_k + top_k + k] = best_val;
+        }
+      } else {
+        // Produces max_ind per axis
+        top_data[(i / axis_dist * top_k + k) * axis_dist + i % axis_dist]
+          = best_idx;
+      }
+      prev_val = best_val;
+      prev_idx = best_idx;
+    }
+  }
+}
+
+template <typename Dtype>
+void ArgMaxLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->gpu_data();
+  Dtype* top_data = top[0]->mutable_gpu_data();
+  int dim, axis_dist;
+  if (has_axis_) {
+    dim = bottom[0]->shape(axis_);
+    // Distance between values of axis in blob
+    axis_dist = bottom[0]->count(axis_) / dim;
+  } else {
+    dim = bottom[0]->count(1);
+    axis_dist = 1;
+  }
+  const int num = bottom[0]->count() / dim;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  ArgMaxForward<Dtype><<<CAFFE_GET_BLOCKS(num), CAFFE_CUDA_NUM_THREADS>>>(
+      num, dim, axis_dist, top_k_, out_max_val_, has_axis_, bottom_data,
+      top_data);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+INSTANTIATE_LAYER_GPU_FORWARD(ArgMaxLayer);
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <boost/thread.hpp>
 #include <algorithm>
 #include <vector>
 
@@ -14,6 +15,10 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
   force_nd_im2col_ = conv_param.force_nd_im2col();
+  forward_threads_ = std::max(1, static_cast<int>(
+      conv_param.forward_threads()));
+  quant_.Init(this->layer_param_.quant_param());
+  col_buffer_max_size_ = conv_param.col_buffer_max_size();
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
   const int first_spatial_axis = channel_axis_ + 1;
   const int num_axes = bottom[0]->num_axes();
@@ -256,12 +261,44 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  forward_cpu_gemm(input, weights, output, col_buffer(), skip_im2col);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
+    const Dtype* weights, Dtype* output, Blob<Dtype>* col_buffer,
+    bool skip_im2col) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      conv_im2col_cpu(input, col_buffer->mutable_cpu_data());
+    }
+    col_buff = col_buffer->cpu_data();
+  }
+  if (quant_.active()) {
+    // Quantize this image's column buffer and run the int8 GEMM. The
+    // scratch is local because batch items may run on worker threads;
+    // its cost is small next to the GEMM itself.
+    const int col_count = kernel_dim_ * group_ * conv_out_spatial_dim_;
+    const int rows = conv_out_channels_ / group_;
+    std::vector<int8_t> col_q(col_count);
+    std::vector<int> acc(output_offset_);
+    quant_.QuantizeInput(col_count, col_buff, &col_q[0]);
+    const Dtype input_scale = quant_.input_scale();
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_igemm_nn(rows, conv_out_spatial_dim_, kernel_dim_,
+          quant_.weights() + weight_offset_ * g, &col_q[col_offset_ * g],
+          &acc[0]);
+      Dtype* out_g = output + output_offset_ * g;
+      for (int r = 0; r < rows; ++r) {
+        const Dtype scale = input_scale * quant_.weight_scale(g * rows + r);
+        for (int n = 0; n < conv_out_spatial_dim_; ++n) {
+          out_g[r * conv_out_spatial_dim_ + n] =
+              acc[r * conv_out_spatial_dim_ + n] * scale;
+        }
+      }
     }
-    col_buff = col_buffer_.cpu_data();
+    return;
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -271,6 +308,107 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::ForwardWorker(const Dtype* bottom_data,
+    const Dtype* weights, const Dtype* bias, Dtype* top_data, int worker,
+    int num_workers) {
+  Blob<Dtype>* col_buffer =
+      worker == 0 ? this->col_buffer() : col_buffers_[worker - 1].get();
+  for (int n = worker; n < num_; n += num_workers) {
+    forward_cpu_gemm(bottom_data + n * bottom_dim_, weights,
+        top_data + n * top_dim_, col_buffer);
+    forward_cpu_epilogue(top_data + n * top_dim_, bias);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_batch(const Dtype* bottom_data,
+    const Dtype* weights, const Dtype* bias, Dtype* top_data) {
+  // Calibration and weight quantization run here, on the dispatching
+  // thread, so the per-image workers only ever read the quant state.
+  // Padding contributes zeros to the column buffer, so observing the
+  // bottom blob sees the same value range.
+  if (quant_.enabled() &&
+      quant_.ObserveInput(num_ * bottom_dim_, bottom_data)) {
+    quant_.QuantizeWeights(conv_out_channels_, kernel_dim_, weights);
+  }
+  if (is_1x1_ && group_ == 1 && num_ > 1 && !quant_.active()) {
+    forward_cpu_1x1_batch(bottom_data, weights, bias, top_data);
+    return;
+  }
+  int num_workers = std::min(forward_threads_, num_);
+  if (Caffe::cpu_core_budget() > 0) {
+    num_workers = std::min(num_workers, Caffe::cpu_core_budget());
+  }
+  if (num_workers <= 1) {
+    ForwardWorker(bottom_data, weights, bias, top_data, 0, 1);
+    return;
+  }
+  // The per-image GEMMs are independent; only the column buffers have to
+  // be private to each worker. Their memory is allocated on first touch,
+  // inside the worker.
+  while (col_buffers_.size() < num_workers - 1) {
+    col_buffers_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  for (int i = 0; i < num_workers - 1; ++i) {
+    col_buffers_[i]->Reshape(col_buffer_shape_);
+  }
+  boost::thread_group workers;
+  for (int t = 1; t < num_workers; ++t) {
+    workers.add_thread(new boost::thread(
+        &BaseConvolutionLayer<Dtype>::ForwardWorker, this, bottom_data,
+        weights, bias, top_data, t, num_workers));
+  }
+  ForwardWorker(bottom_data, weights, bias, top_data, 0, num_workers);
+  workers.join_all();
+}
+
+// A 1x1 convolution is a plain matrix product per image, but num_ small
+// GEMMs run BLAS far below peak. Gathering the batch into one
+// (channels, num_ * spatial) matrix makes it a single large GEMM; the
+// gather and the scatter back are each one copy pass, and the scatter
+// absorbs the bias/ReLU epilogue.
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_1x1_batch(
+    const Dtype* bottom_data, const Dtype* weights, const Dtype* bias,
+    Dtype* top_data) {
+  const int spatial = conv_out_spatial_dim_;
+  const int cols = num_ * spatial;
+  Blob<Dtype>* pack = col_buffer();
+  pack->Reshape(vector<int>(1, conv_in_channels_ * cols));
+  batch_out_buffer_.Reshape(vector<int>(1, conv_out_channels_ * cols));
+  Dtype* packed = pack->mutable_cpu_data();
+  for (int n = 0; n < num_; ++n) {
+    const Dtype* src = bottom_data + n * bottom_dim_;
+    for (int c = 0; c < conv_in_channels_; ++c) {
+      caffe_copy(spatial, src + c * spatial,
+          packed + (c * num_ + n) * spatial);
+    }
+  }
+  Dtype* staged = batch_out_buffer_.mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_,
+      cols, conv_in_channels_, (Dtype)1., weights, packed, (Dtype)0.,
+      staged);
+  for (int n = 0; n < num_; ++n) {
+    for (int oc = 0; oc < conv_out_channels_; ++oc) {
+      const Dtype* src = staged + (oc * num_ + n) * spatial;
+      Dtype* dst = top_data + n * top_dim_ + oc * spatial;
+      const Dtype b = bias != NULL ? bias[oc] : Dtype(0);
+      if (fused_relu_) {
+        for (int s = 0; s < spatial; ++s) {
+          dst[s] = std::max(Dtype(0), src[s] + b);
+        }
+      } else if (bias != NULL) {
+        for (int s = 0; s < spatial; ++s) {
+          dst[s] = src[s] + b;
+        }
+      } else {
+        caffe_copy(spatial, src, dst);
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
@@ -279,13 +417,40 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_epilogue(Dtype* output,
+    const Dtype* bias) {
+  if (!fused_relu_) {
+    if (bias != NULL) {
+      forward_cpu_bias(output, bias);
+    }
+    return;
+  }
+  // Bias-add and rectification share one pass over the output, instead
+  // of a bias GEMM pass followed by a ReLU layer pass.
+  for (int oc = 0; oc < num_output_; ++oc) {
+    const Dtype b = bias != NULL ? bias[oc] : Dtype(0);
+    Dtype* out = output + oc * out_spatial_dim_;
+    for (int s = 0; s < out_spatial_dim_; ++s) {
+      out[s] = std::max(Dtype(0), out[s] + b);
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  if (tiled_backward()) {
+    backward_cpu_gemm_tiled(output, weights, input);
+    return;
   }
+  backward_cpu_gemm(output, weights, input, col_buffer());
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
+    const Dtype* weights, Dtype* input, Blob<Dtype>* col_buffer) {
+  Dtype* col_buff = is_1x1_ ? input : col_buffer->mutable_cpu_data();
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
         conv_out_spatial_dim_, conv_out_channels_ / group_,
@@ -297,13 +462,67 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm_tiled(const Dtype* output,
+    const Dtype* weights, Dtype* input) {
+  const int grid_h = col_buffer_shape_[1];
+  const int grid_w = col_buffer_shape_[2];
+  const size_t row_bytes =
+      static_cast<size_t>(kernel_dim_) * group_ * grid_w * sizeof(Dtype);
+  int strip_rows = std::min(static_cast<size_t>(grid_h),
+      std::max(static_cast<size_t>(1), col_buffer_max_size_ / row_bytes));
+  vector<int> tile_shape(3);
+  tile_shape[0] = kernel_dim_ * group_;
+  tile_shape[1] = strip_rows;
+  tile_shape[2] = grid_w;
+  tile_col_buffer_.Reshape(tile_shape);
+  Dtype* col_buff = tile_col_buffer_.mutable_cpu_data();
+  tile_out_buffer_.Reshape(
+      vector<int>(1, conv_out_channels_ * strip_rows * grid_w));
+  Dtype* out_buff = tile_out_buffer_.mutable_cpu_data();
+  // col2im_strip accumulates, so clear the image once up front instead
+  // of per strip as col2im_cpu would.
+  caffe_set(num_kernels_col2im_, Dtype(0), input);
+  for (int row = 0; row < grid_h; row += strip_rows) {
+    const int rows = std::min(strip_rows, grid_h - row);
+    const int cols = rows * grid_w;
+    // Pack the strip's columns so the GEMM sees a contiguous right-hand
+    // side; this touches conv_out_channels rows against the kernel_dim
+    // rows the GEMM writes, so the copy is noise next to the GEMM.
+    for (int c = 0; c < conv_out_channels_; ++c) {
+      caffe_copy(cols, output + c * conv_out_spatial_dim_ + row * grid_w,
+          out_buff + c * cols);
+    }
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+          cols, conv_out_channels_ / group_,
+          (Dtype)1., weights + weight_offset_ * g,
+          out_buff + conv_out_channels_ / group_ * cols * g,
+          (Dtype)0., col_buff + kernel_dim_ * cols * g);
+    }
+    col2im_strip_cpu(col_buff, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        row, row + rows, input);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  weight_cpu_gemm(input, output, weights, col_buffer());
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
+    const Dtype* output, Dtype* weights, Blob<Dtype>* col_buffer) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+    conv_im2col_cpu(input, col_buffer->mutable_cpu_data());
+    col_buff = col_buffer->cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -313,6 +532,105 @@ void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::BackwardWorker(const Dtype* top_diff,
+    const Dtype* bottom_data, const Dtype* weights, Dtype* weight_diff,
+    Dtype* bottom_diff, int worker, int num_workers) {
+  Blob<Dtype>* col_buffer =
+      worker == 0 ? this->col_buffer() : col_buffers_[worker - 1].get();
+  for (int n = worker; n < num_; n += num_workers) {
+    if (weight_diff) {
+      weight_cpu_gemm(bottom_data + n * bottom_dim_,
+          top_diff + n * top_dim_, weight_diff, col_buffer);
+    }
+    if (bottom_diff) {
+      backward_cpu_gemm(top_diff + n * top_dim_, weights,
+          bottom_diff + n * bottom_dim_, col_buffer);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_batch(const Dtype* top_diff,
+    const Dtype* bottom_data, const Dtype* weights, Dtype* weight_diff,
+    Dtype* bottom_diff) {
+  int num_workers = std::min(forward_threads_, num_);
+  if (Caffe::cpu_core_budget() > 0) {
+    num_workers = std::min(num_workers, Caffe::cpu_core_budget());
+  }
+  // The strip-mined col2im path exists to bound scratch memory and
+  // shares one tile buffer, so it stays serial rather than multiplying
+  // its workspace by the worker count.
+  if (num_workers <= 1 || (bottom_diff && tiled_backward())) {
+    for (int n = 0; n < num_; ++n) {
+      if (weight_diff) {
+        weight_cpu_gemm(bottom_data + n * bottom_dim_,
+            top_diff + n * top_dim_, weight_diff);
+      }
+      if (bottom_diff) {
+        backward_cpu_gemm(top_diff + n * top_dim_, weights,
+            bottom_diff + n * bottom_dim_);
+      }
+    }
+    return;
+  }
+  while (col_buffers_.size() < num_workers - 1) {
+    col_buffers_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  for (int i = 0; i < num_workers - 1; ++i) {
+    col_buffers_[i]->Reshape(col_buffer_shape_);
+  }
+  // Per-image bottom diffs are disjoint, but every image accumulates
+  // into the one weight gradient; workers 1..N-1 each get a private
+  // zeroed partial, while worker 0 keeps accumulating into the real
+  // diff, which already carries contributions from earlier passes.
+  const int weight_count = this->blobs_[0]->count();
+  if (weight_diff) {
+    while (weight_diff_buffers_.size() < num_workers - 1) {
+      weight_diff_buffers_.push_back(
+          shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    }
+    for (int i = 0; i < num_workers - 1; ++i) {
+      weight_diff_buffers_[i]->ReshapeLike(*this->blobs_[0]);
+      caffe_set(weight_count, Dtype(0),
+          weight_diff_buffers_[i]->mutable_cpu_data());
+    }
+  }
+  boost::thread_group workers;
+  for (int t = 1; t < num_workers; ++t) {
+    Dtype* partial = weight_diff ?
+        weight_diff_buffers_[t - 1]->mutable_cpu_data() : NULL;
+    workers.add_thread(new boost::thread(
+        &BaseConvolutionLayer<Dtype>::BackwardWorker, this, top_diff,
+        bottom_data, weights, partial, bottom_diff, t, num_workers));
+  }
+  BackwardWorker(top_diff, bottom_data, weights, weight_diff, bottom_diff,
+      0, num_workers);
+  workers.join_all();
+  if (!weight_diff) {
+    return;
+  }
+  // Tree reduction of the partials: each round folds the upper half of
+  // the survivors into the lower half pairwise, so the adds of one round
+  // run concurrently and the chain is log2(workers) rounds deep.
+  // Partial 0 is weight_diff itself; partial i is weight_diff_buffers_
+  // [i - 1]. The pair landing in weight_diff runs on the calling thread.
+  int live = num_workers;
+  while (live > 1) {
+    const int half = (live + 1) / 2;
+    boost::thread_group adders;
+    for (int i = half + 1; i < live; ++i) {
+      adders.add_thread(new boost::thread(&caffe_axpy<Dtype>, weight_count,
+          Dtype(1), weight_diff_buffers_[i - 1]->cpu_data(),
+          weight_diff_buffers_[i - half - 1]->mutable_cpu_data()));
+    }
+    caffe_axpy(weight_count, Dtype(1),
+        weight_diff_buffers_[half - 1]->cpu_data(), weight_diff);
+    adders.join_all();
+    live = half;
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
     const Dtype* input) {
@@ -328,16 +646,16 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
+      conv_im2col_gpu(input, col_buffer()->mutable_gpu_data());
     }
-    col_buff = col_buffer_.gpu_data();
-  }
-  for (int g = 0; g < group_; ++g) {
-    caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
-        group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)0., output + output_offset_ * g);
+    col_buff = col_buffer()->gpu_data();
   }
+  // All groups in one strided-batched call; group_ == 1 degenerates to a
+  // plain gemm inside cublas.
+  caffe_gpu_gemm_batched<Dtype>(CblasNoTrans, CblasNoTrans,
+      conv_out_channels_ / group_, conv_out_spatial_dim_, kernel_dim_,
+      (Dtype)1., weights, weight_offset_, col_buff, col_offset_,
+      (Dtype)0., output, output_offset_, group_);
 }
 
 template <typename Dtype>
@@ -351,16 +669,14 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_gpu_data();
+  Dtype* col_buff = col_buffer()->mutable_gpu_data();
   if (is_1x1_) {
     col_buff = input;
   }
-  for (int g = 0; g < group_; ++g) {
-    caffe_gpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
-        conv_out_spatial_dim_, conv_out_channels_ / group_,
-        (Dtype)1., weights + weight_offset_ * g, output + output_offset_ * g,
-        (Dtype)0., col_buff + col_offset_ * g);
-  }
+  caffe_gpu_gemm_batched<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+      conv_out_spatial_dim_, conv_out_channels_ / group_,
+      (Dtype)1., weights, weight_offset_, output, output_offset_,
+      (Dtype)0., col_buff, col_offset_, group_);
   if (!is_1x1_) {
     conv_col2im_gpu(col_buff, input);
   }
@@ -371,15 +687,13 @@ void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
-    col_buff = col_buffer_.gpu_data();
-  }
-  for (int g = 0; g < group_; ++g) {
-    caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
-        kernel_dim_, conv_out_spatial_dim_,
-        (Dtype)1., output + output_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)1., weights + weight_offset_ * g);
+    conv_im2col_gpu(input, col_buffer()->mutable_gpu_data());
+    col_buff = col_buffer()->gpu_data();
   }
+  caffe_gpu_gemm_batched<Dtype>(CblasNoTrans, CblasTrans,
+      conv_out_channels_ / group_, kernel_dim_, conv_out_spatial_dim_,
+      (Dtype)1., output, output_offset_, col_buff, col_offset_,
+      (Dtype)1., weights, weight_offset_, group_);
 }
 
 template <typename Dtype>
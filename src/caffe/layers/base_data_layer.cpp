@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -7,7 +8,10 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/chrome_trace.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -32,36 +36,128 @@ void BaseDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   DataLayerSetUp(bottom, top);
 }
 
+// Serializes the hand-off of loaded batches to prefetch_full_ so that, with
+// several prefetch threads, batches still come out in the order their loads
+// were started.
+template <typename Dtype>
+class BasePrefetchingDataLayer<Dtype>::Order {
+ public:
+  explicit Order(bool enforce)
+      : enforce_(enforce), next_load_(0), next_push_(0) {}
+
+  size_t TakeTicket() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return next_load_++;
+  }
+
+  void WaitTurn(size_t ticket) {
+    if (!enforce_) { return; }
+    boost::mutex::scoped_lock lock(mutex_);
+    while (next_push_ != ticket) {
+      condition_.wait(lock);
+    }
+  }
+
+  void Release(size_t ticket) {
+    if (!enforce_) { return; }
+    boost::mutex::scoped_lock lock(mutex_);
+    next_push_ = ticket + 1;
+    condition_.notify_all();
+  }
+
+ private:
+  const bool enforce_;
+  size_t next_load_, next_push_;
+  boost::mutex mutex_;
+  boost::condition_variable_any condition_;
+};
+
+// One lazily created staging blob per prefetch thread. The blobs are
+// views into the destination batch (set_cpu_data), so they stay small;
+// they die with the layer, after the threads are joined.
+template <typename Dtype>
+class BasePrefetchingDataLayer<Dtype>::TransformScratch {
+ public:
+  Blob<Dtype>* get() {
+    Blob<Dtype>* blob = tls_.get();
+    if (blob == NULL) {
+      blob = new Blob<Dtype>();
+      tls_.reset(blob);
+    }
+    return blob;
+  }
+
+ private:
+  boost::thread_specific_ptr<Blob<Dtype> > tls_;
+};
+
+template <typename Dtype>
+Blob<Dtype>* BasePrefetchingDataLayer<Dtype>::transform_scratch() {
+  return scratch_->get();
+}
+
+template <typename Dtype>
+size_t BasePrefetchingDataLayer<Dtype>::prefetch_queue_capacity(
+    const LayerParameter& param) {
+  // Keep at least one batch per thread plus one for the consumer.
+  return std::max(static_cast<size_t>(param.data_param().prefetch()),
+      static_cast<size_t>(param.data_param().prefetch_threads()) + 1);
+}
+
 template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_free_.push(&prefetch_[i]);
+      prefetch_free_(prefetch_queue_capacity(param)),
+      prefetch_full_(prefetch_queue_capacity(param)),
+      batches_loaded_(0), batches_consumed_(0),
+      producer_wait_us_(0), consumer_wait_us_(0),
+      read_us_(0), transform_us_(0) {
+  prefetch_threads_ =
+      std::max(1, static_cast<int>(param.data_param().prefetch_threads()));
+  const int queue_depth = prefetch_queue_capacity(param);
+  for (int i = 0; i < queue_depth; ++i) {
+    prefetch_.push_back(shared_ptr<Batch<Dtype> >(new Batch<Dtype>()));
+    prefetch_free_.push(prefetch_[i].get());
   }
+  order_.reset(new Order(param.data_param().deterministic_prefetch()));
+  scratch_.reset(new TransformScratch());
 }
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   BaseDataLayer<Dtype>::LayerSetUp(bottom, top);
+  if (prefetch_threads_ > 1 && !reentrant_load_batch()) {
+    LOG(WARNING) << "Layer " << this->layer_param_.name() << " ("
+        << this->type() << ") has a non-reentrant load_batch(); clamping "
+        << "prefetch_threads from " << prefetch_threads_ << " to 1.";
+    prefetch_threads_ = 1;
+  }
   // Before starting the prefetch thread, we make cpu_data and gpu_data
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
   // seems to cause failures if we do not so.
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_[i].data_.mutable_cpu_data();
+  // With the GPU transform engine the float data_ blobs only carry shape;
+  // the raw uint8 staging is allocated by load_batch instead.
+  const bool skip_data = this->transform_param_.engine() ==
+      TransformationParameter_Engine_GPU;
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    if (!skip_data) {
+      prefetch_[i]->data_.mutable_cpu_data();
+    }
     if (this->output_labels_) {
-      prefetch_[i].label_.mutable_cpu_data();
+      prefetch_[i]->label_.mutable_cpu_data();
     }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-      prefetch_[i].data_.mutable_gpu_data();
+    for (int i = 0; i < prefetch_.size(); ++i) {
+      if (!skip_data) {
+        prefetch_[i]->data_.mutable_gpu_data();
+      }
       if (this->output_labels_) {
-        prefetch_[i].label_.mutable_gpu_data();
+        prefetch_[i]->label_.mutable_gpu_data();
       }
     }
   }
@@ -74,39 +170,108 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
+  if (prefetch_threads_ > 1) {
+    // Extra threads inherit this thread's Caffe state, same as
+    // InternalThread::entry does for this one. load_batch() must be
+    // reentrant for this mode, see DataParameter.prefetch_threads.
+    int device = -1;
 #ifndef CPU_ONLY
-  cudaStream_t stream;
+    if (Caffe::mode() == Caffe::GPU) {
+      CUDA_CHECK(cudaGetDevice(&device));
+    }
+#endif
+    boost::thread_group workers;
+    for (int t = 1; t < prefetch_threads_; ++t) {
+      workers.add_thread(new boost::thread(
+          &BasePrefetchingDataLayer<Dtype>::PrefetchWorker, this, device,
+          Caffe::mode(), caffe_rng_rand(), Caffe::solver_count(),
+          Caffe::root_solver()));
+    }
+    PrefetchLoop();
+    workers.interrupt_all();
+    workers.join_all();
+  } else {
+    PrefetchLoop();
+  }
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::PrefetchWorker(int device,
+    Caffe::Brew mode, int rand_seed, int solver_count, bool root_solver) {
+#ifndef CPU_ONLY
+  if (device >= 0) {
+    CUDA_CHECK(cudaSetDevice(device));
+  }
+#endif
+  Caffe::set_mode(mode);
+  Caffe::set_random_seed(rand_seed);
+  Caffe::set_solver_count(solver_count);
+  Caffe::set_root_solver(root_solver);
+  PrefetchLoop();
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::PrefetchLoop() {
+#ifndef CPU_ONLY
+  // First pooled stream of this prefetch thread; released with the
+  // thread-local Caffe singleton when the thread exits.
+  cudaStream_t stream = NULL;
   if (Caffe::mode() == Caffe::GPU) {
-    CUDA_CHECK(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+    stream = Caffe::stream(0);
   }
 #endif
 
+  ChromeTrace::SetThreadName("prefetch " + this->layer_param_.name());
   try {
+    CPUTimer wait_timer;
     while (!must_stop()) {
+      wait_timer.Start();
       Batch<Dtype>* batch = prefetch_free_.pop();
-      load_batch(batch);
+      wait_timer.Stop();
+      producer_wait_us_ += wait_timer.MicroSeconds();
+      const size_t ticket = order_->TakeTicket();
+      {
+        TraceSpan trace("prefetch", this->layer_param_.name());
+        load_batch(batch);
+      }
+      ++batches_loaded_;
 #ifndef CPU_ONLY
       if (Caffe::mode() == Caffe::GPU) {
-        batch->data_.data().get()->async_gpu_push(stream);
-        CUDA_CHECK(cudaStreamSynchronize(stream));
+        if (batch->raw_data_.count() > 0) {
+          // GPU transform engine: the uint8 pixels and per-item transform
+          // decisions travel instead of the transformed float batch.
+          batch->raw_data_.data().get()->async_gpu_push(stream);
+          batch->raw_params_.data().get()->async_gpu_push(stream);
+        } else {
+          batch->data_.data().get()->async_gpu_push(stream);
+        }
+        // Hand the in-flight copy to the consumer through an event instead
+        // of blocking this thread until the transfer lands.
+        if (batch->copy_done_ == NULL) {
+          CUDA_CHECK(cudaEventCreateWithFlags(&batch->copy_done_,
+              cudaEventDisableTiming));
+        }
+        CUDA_CHECK(cudaEventRecord(batch->copy_done_, stream));
       }
 #endif
+      order_->WaitTurn(ticket);
       prefetch_full_.push(batch);
+      order_->Release(ticket);
     }
   } catch (boost::thread_interrupted&) {
     // Interrupted exception is expected on shutdown
   }
-#ifndef CPU_ONLY
-  if (Caffe::mode() == Caffe::GPU) {
-    CUDA_CHECK(cudaStreamDestroy(stream));
-  }
-#endif
 }
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CPUTimer wait_timer;
+  wait_timer.Start();
   Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  wait_timer.Stop();
+  consumer_wait_us_ += wait_timer.MicroSeconds();
+  ++batches_consumed_;
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
@@ -124,6 +289,20 @@ void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
   prefetch_free_.push(batch);
 }
 
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::prefetch_stats(
+    PrefetchStats* stats) const {
+  stats->layer_name = this->layer_param_.name();
+  stats->batches_loaded = batches_loaded_;
+  stats->batches_consumed = batches_consumed_;
+  stats->producer_wait_us = producer_wait_us_;
+  stats->consumer_wait_us = consumer_wait_us_;
+  stats->read_us = read_us_;
+  stats->transform_us = transform_us_;
+  stats->free_queue_size = prefetch_free_.size();
+  stats->full_queue_size = prefetch_full_.size();
+}
+
 #ifdef CPU_ONLY
 STUB_GPU_FORWARD(BasePrefetchingDataLayer, Forward);
 #endif
@@ -1,28 +1,47 @@
 #include <vector>
 
 #include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/benchmark.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CPUTimer wait_timer;
+  wait_timer.Start();
   Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  wait_timer.Stop();
+  consumer_wait_us_ += wait_timer.MicroSeconds();
+  ++batches_consumed_;
+  // A pooled stream keeps these copies off the default stream so they
+  // can overlap still-running compute; unbound layers keep the default.
+  cudaStream_t copy_stream = cudaStreamDefault;
+  if (this->stream_id() >= 0) {
+    copy_stream = Caffe::stream(this->stream_id());
+  }
+  if (batch->copy_done_ != NULL) {
+    // Wait for the prefetch thread's async H2D push from this stream only;
+    // the copy itself overlapped compute on the previous batch.
+    CUDA_CHECK(cudaStreamWaitEvent(copy_stream, batch->copy_done_, 0));
+  }
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
-  caffe_copy(batch->data_.count(), batch->data_.gpu_data(),
-      top[0]->mutable_gpu_data());
+  CUDA_CHECK(cudaMemcpyAsync(top[0]->mutable_gpu_data(),
+      batch->data_.gpu_data(), batch->data_.count() * sizeof(Dtype),
+      cudaMemcpyDeviceToDevice, copy_stream));
   if (this->output_labels_) {
     // Reshape to loaded labels.
     top[1]->ReshapeLike(batch->label_);
     // Copy the labels.
-    caffe_copy(batch->label_.count(), batch->label_.gpu_data(),
-        top[1]->mutable_gpu_data());
+    CUDA_CHECK(cudaMemcpyAsync(top[1]->mutable_gpu_data(),
+        batch->label_.gpu_data(), batch->label_.count() * sizeof(Dtype),
+        cudaMemcpyDeviceToDevice, copy_stream));
   }
   // Ensure the copy is synchronous wrt the host, so that the next batch isn't
   // copied in meanwhile.
-  CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+  CUDA_CHECK(cudaStreamSynchronize(copy_stream));
   prefetch_free_.push(batch);
 }
 
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
@@ -47,27 +48,15 @@ void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   sz.push_back(channels_);
   mean_.Reshape(sz);
   variance_.Reshape(sz);
-  temp_.ReshapeLike(*bottom[0]);
-  x_norm_.ReshapeLike(*bottom[0]);
-  sz[0]=bottom[0]->shape(0);
-  batch_sum_multiplier_.Reshape(sz);
-
-  int spatial_dim = bottom[0]->count()/(channels_*bottom[0]->shape(0));
-  if (spatial_sum_multiplier_.num_axes() == 0 ||
-      spatial_sum_multiplier_.shape(0) != spatial_dim) {
-    sz[0] = spatial_dim;
-    spatial_sum_multiplier_.Reshape(sz);
-    Dtype* multiplier_data = spatial_sum_multiplier_.mutable_cpu_data();
-    caffe_set(spatial_sum_multiplier_.count(), Dtype(1), multiplier_data);
-  }
-
-  int numbychans = channels_*bottom[0]->shape(0);
-  if (num_by_chans_.num_axes() == 0 ||
-      num_by_chans_.shape(0) != numbychans) {
-    sz[0] = numbychans;
-    num_by_chans_.Reshape(sz);
-    caffe_set(batch_sum_multiplier_.count(), Dtype(1),
-        batch_sum_multiplier_.mutable_cpu_data());
+  inv_std_.Reshape(sz);
+  vector<int> sums_sz;
+  sums_sz.push_back(2);
+  sums_sz.push_back(channels_);
+  channel_sums_.Reshape(sums_sz);
+  // The normalized output only needs a full-size cache when the layer runs
+  // in place during training; see the member comment.
+  if (bottom[0] == top[0] && !use_global_stats_) {
+    x_norm_.ReshapeLike(*bottom[0]);
   }
 }
 
@@ -79,99 +68,94 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
 
-  if (bottom[0] != top[0]) {
-    caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  }
-
+  Dtype* mean = mean_.mutable_cpu_data();
+  Dtype* variance = variance_.mutable_cpu_data();
   if (use_global_stats_) {
     // use the stored mean/variance estimates.
     const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
         0 : 1 / this->blobs_[2]->cpu_data()[0];
     caffe_cpu_scale(variance_.count(), scale_factor,
-        this->blobs_[0]->cpu_data(), mean_.mutable_cpu_data());
+        this->blobs_[0]->cpu_data(), mean);
     caffe_cpu_scale(variance_.count(), scale_factor,
-        this->blobs_[1]->cpu_data(), variance_.mutable_cpu_data());
+        this->blobs_[1]->cpu_data(), variance);
   } else {
-    // compute mean
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), bottom_data,
-        spatial_sum_multiplier_.cpu_data(), 0.,
-        num_by_chans_.mutable_cpu_data());
-    caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-        mean_.mutable_cpu_data());
-  }
-
-  // subtract mean
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, -1, num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., top_data);
-
-  if (!use_global_stats_) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_powx(top[0]->count(), top_data, Dtype(2),
-        temp_.mutable_cpu_data());  // (X-EX)^2
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), temp_.cpu_data(),
-        spatial_sum_multiplier_.cpu_data(), 0.,
-        num_by_chans_.mutable_cpu_data());
-    caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-        variance_.mutable_cpu_data());  // E((X_EX)^2)
+    // One fused pass over the input: per-(num, channel) slice sums and
+    // sums of squares, merged per channel, give the mean and
+    // var(X) = E(X^2) - (EX)^2 without materializing (X-EX)^2.
+    caffe_set(channels_, Dtype(0), mean);
+    caffe_set(channels_, Dtype(0), variance);
+    for (int n = 0; n < num; ++n) {
+      for (int c = 0; c < channels_; ++c) {
+        Dtype sum, sumsq;
+        caffe_cpu_sum_sumsq(spatial_dim,
+            bottom_data + (n * channels_ + c) * spatial_dim, &sum, &sumsq);
+        mean[c] += sum;
+        variance[c] += sumsq;
+      }
+    }
+    const Dtype inv_m = Dtype(1) / (num * spatial_dim);
+    for (int c = 0; c < channels_; ++c) {
+      mean[c] *= inv_m;
+      const Dtype var = variance[c] * inv_m - mean[c] * mean[c];
+      variance[c] = var > 0 ? var : 0;
+    }
 
     // compute and save moving average
     this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
     this->blobs_[2]->mutable_cpu_data()[0] += 1;
-    caffe_cpu_axpby(mean_.count(), Dtype(1), mean_.cpu_data(),
+    caffe_cpu_axpby(mean_.count(), Dtype(1), mean,
         moving_average_fraction_, this->blobs_[0]->mutable_cpu_data());
     int m = bottom[0]->count()/channels_;
     Dtype bias_correction_factor = m > 1 ? Dtype(m)/(m-1) : 1;
     caffe_cpu_axpby(variance_.count(), bias_correction_factor,
-        variance_.cpu_data(), moving_average_fraction_,
+        variance, moving_average_fraction_,
         this->blobs_[1]->mutable_cpu_data());
   }
 
-  // normalize variance
-  caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
-  caffe_powx(variance_.count(), variance_.cpu_data(), Dtype(0.5),
-             variance_.mutable_cpu_data());
-
-  // replicate variance to input size
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), variance_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., temp_.mutable_cpu_data());
-  caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
-  // TODO(cdoersch): The caching is only needed because later in-place layers
-  //                 might clobber the data.  Can we skip this if they won't?
-  caffe_copy(x_norm_.count(), top_data,
-      x_norm_.mutable_cpu_data());
+  // normalize: Y = (X - mean) / sqrt(var + eps), broadcasting the channel
+  // statistics in place of the full-size replicated scratch tensor.
+  Dtype* inv_std = inv_std_.mutable_cpu_data();
+  for (int c = 0; c < channels_; ++c) {
+    inv_std[c] = Dtype(1) / std::sqrt(variance[c] + eps_);
+  }
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels_; ++c) {
+      const int offset = (n * channels_ + c) * spatial_dim;
+      const Dtype mu = mean[c];
+      const Dtype is = inv_std[c];
+      for (int i = 0; i < spatial_dim; ++i) {
+        top_data[offset + i] = (bottom_data[offset + i] - mu) * is;
+      }
+    }
+  }
+  if (bottom[0] == top[0] && !use_global_stats_) {
+    // Running in place destroyed X, which the backward would otherwise use
+    // to recompute Y; keep a copy of the normalized output instead.
+    caffe_copy(top[0]->count(), top_data, x_norm_.mutable_cpu_data());
+  }
 }
 
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff;
-  if (bottom[0] != top[0]) {
-    top_diff = top[0]->cpu_diff();
-  } else {
-    caffe_copy(x_norm_.count(), top[0]->cpu_diff(), x_norm_.mutable_cpu_diff());
-    top_diff = x_norm_.cpu_diff();
-  }
+  const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const Dtype* inv_std = inv_std_.cpu_data();
+  int num = bottom[0]->shape()[0];
+  int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
   if (use_global_stats_) {
-    caffe_div(temp_.count(), top_diff, temp_.cpu_data(), bottom_diff);
+    // dE/dX = dE/dY ./ sqrt(var(X) + eps); element i only depends on
+    // element i, so this is safe even when bottom and top share storage.
+    for (int n = 0; n < num; ++n) {
+      for (int c = 0; c < channels_; ++c) {
+        const int offset = (n * channels_ + c) * spatial_dim;
+        caffe_cpu_scale(spatial_dim, inv_std[c], top_diff + offset,
+            bottom_diff + offset);
+      }
+    }
     return;
   }
-  const Dtype* top_data = x_norm_.cpu_data();
-  int num = bottom[0]->shape()[0];
-  int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
   // if Y = (X-mean(X))/(sqrt(var(X)+eps)), then
   //
   // dE(Y)/dX =
@@ -180,53 +164,58 @@ void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   //
   // where \cdot and ./ are hadamard product and elementwise division,
   // respectively, dE/dY is the top diff, and mean/var/sum are all computed
-  // along all dimensions except the channels dimension.  In the above
-  // equation, the operations allow for expansion (i.e. broadcast) along all
-  // dimensions except the channels dimension where required.
-
-  // sum(dE/dY \cdot Y)
-  caffe_mul(temp_.count(), top_data, top_diff, bottom_diff);
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      bottom_diff, spatial_sum_multiplier_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-      mean_.mutable_cpu_data());
-
-  // reshape (broadcast) the above
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 0., bottom_diff);
-
-  // sum(dE/dY \cdot Y) \cdot Y
-  caffe_mul(temp_.count(), top_data, bottom_diff, bottom_diff);
-
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      top_diff, spatial_sum_multiplier_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.cpu_data(), batch_sum_multiplier_.cpu_data(), 0.,
-      mean_.mutable_cpu_data());
-  // reshape (broadcast) the above to make
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.cpu_data(), mean_.cpu_data(), 0.,
-      num_by_chans_.mutable_cpu_data());
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num * channels_,
-      spatial_dim, 1, 1., num_by_chans_.cpu_data(),
-      spatial_sum_multiplier_.cpu_data(), 1., bottom_diff);
-
-  // dE/dY - mean(dE/dY)-mean(dE/dY \cdot Y) \cdot Y
-  caffe_cpu_axpby(temp_.count(), Dtype(1), top_diff,
-      Dtype(-1. / (num * spatial_dim)), bottom_diff);
-
-  // note: temp_ still contains sqrt(var(X)+eps), computed during the forward
-  // pass.
-  caffe_div(temp_.count(), bottom_diff, temp_.cpu_data(), bottom_diff);
+  // along all dimensions except the channels dimension.
+  //
+  // Two passes: per-channel reductions of the top diff, then the
+  // elementwise combination. Y is recomputed on the fly from the intact
+  // bottom except in place, where the forward cached it.
+  const bool in_place = (bottom[0] == top[0]);
+  const Dtype* src = in_place ? x_norm_.cpu_data() : bottom[0]->cpu_data();
+  const Dtype* mean = mean_.cpu_data();
+  Dtype* dy_sum = channel_sums_.mutable_cpu_data();
+  Dtype* dy_dot = dy_sum + channels_;
+  caffe_set(channel_sums_.count(), Dtype(0), dy_sum);
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels_; ++c) {
+      const int offset = (n * channels_ + c) * spatial_dim;
+      Dtype sum = 0, dot = 0;
+      for (int i = 0; i < spatial_dim; ++i) {
+        sum += top_diff[offset + i];
+        dot += top_diff[offset + i] * src[offset + i];
+      }
+      dy_sum[c] += sum;
+      dy_dot[c] += dot;
+    }
+  }
+  if (!in_place) {
+    // src held X, not Y: sum(dE/dY . Y) = (sum(dE/dY . X)
+    //   - mean . sum(dE/dY)) / sqrt(var + eps).
+    for (int c = 0; c < channels_; ++c) {
+      dy_dot[c] = (dy_dot[c] - mean[c] * dy_sum[c]) * inv_std[c];
+    }
+  }
+  const Dtype inv_m = Dtype(1) / (num * spatial_dim);
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels_; ++c) {
+      const int offset = (n * channels_ + c) * spatial_dim;
+      const Dtype mean_dy = dy_sum[c] * inv_m;
+      const Dtype mean_dy_y = dy_dot[c] * inv_m;
+      const Dtype mu = mean[c];
+      const Dtype is = inv_std[c];
+      if (in_place) {
+        for (int i = 0; i < spatial_dim; ++i) {
+          bottom_diff[offset + i] = (top_diff[offset + i] - mean_dy
+              - mean_dy_y * src[offset + i]) * is;
+        }
+      } else {
+        for (int i = 0; i < spatial_dim; ++i) {
+          const Dtype y = (src[offset + i] - mu) * is;
+          bottom_diff[offset + i] = (top_diff[offset + i] - mean_dy
+              - mean_dy_y * y) * is;
+        }
+      }
+    }
+  }
 }
 
 
@@ -235,5 +224,6 @@ STUB_GPU(BatchNormLayer);
 #endif
 
 INSTANTIATE_CLASS(BatchNormLayer);
-REGISTER_LAYER_CLASS(BatchNorm);
+// BatchNorm is registered in layer_factory.cpp: the CUDNN engine maps to
+// CuDNNBatchNormLayer.
 }  // namespace caffe
@@ -6,19 +6,130 @@
 
 namespace caffe {
 
+// One block per channel: a single fused pass accumulates the per-channel
+// sum and sum of squares, giving the mean and var(X) = E(X^2) - (EX)^2 in
+// one read of the input instead of a square into a full-size scratch
+// tensor plus four gemv reductions.
+template <typename Dtype>
+__global__ void BatchNormStatsKernel(const int num, const int channels,
+    const int spatial_dim, const Dtype* data, Dtype* mean, Dtype* variance) {
+  __shared__ Dtype sum_buf[CAFFE_CUDA_NUM_THREADS];
+  __shared__ Dtype sumsq_buf[CAFFE_CUDA_NUM_THREADS];
+  const int c = blockIdx.x;
+  const int count = num * spatial_dim;
+  Dtype sum = 0, sumsq = 0;
+  for (int i = threadIdx.x; i < count; i += blockDim.x) {
+    const Dtype v = data[((i / spatial_dim) * channels + c) * spatial_dim
+        + i % spatial_dim];
+    sum += v;
+    sumsq += v * v;
+  }
+  sum_buf[threadIdx.x] = sum;
+  sumsq_buf[threadIdx.x] = sumsq;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) {
+      sum_buf[threadIdx.x] += sum_buf[threadIdx.x + s];
+      sumsq_buf[threadIdx.x] += sumsq_buf[threadIdx.x + s];
+    }
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) {
+    const Dtype m = sum_buf[0] / count;
+    const Dtype var = sumsq_buf[0] / count - m * m;
+    mean[c] = m;
+    variance[c] = var > 0 ? var : 0;
+  }
+}
+
+template <typename Dtype>
+__global__ void BatchNormInvStdKernel(const int channels, const Dtype eps,
+    const Dtype* variance, Dtype* inv_std) {
+  CUDA_KERNEL_LOOP(c, channels) {
+    inv_std[c] = Dtype(1) / sqrt(variance[c] + eps);
+  }
+}
+
+template <typename Dtype>
+__global__ void BatchNormForwardKernel(const int count, const int channels,
+    const int spatial_dim, const Dtype* mean, const Dtype* inv_std,
+    const Dtype* bottom_data, Dtype* top_data) {
+  CUDA_KERNEL_LOOP(i, count) {
+    const int c = (i / spatial_dim) % channels;
+    top_data[i] = (bottom_data[i] - mean[c]) * inv_std[c];
+  }
+}
+
+// Per-channel reductions of the top diff: dy_sum = sum(dE/dY) and
+// dy_dot = sum(dE/dY . Y). src holds the cached normalized output when
+// normalized is true (the in-place case), the intact bottom otherwise, in
+// which case the dot against X is converted to the dot against Y by the
+// final thread.
+template <typename Dtype>
+__global__ void BatchNormBackwardStatsKernel(const int num,
+    const int channels, const int spatial_dim, const bool normalized,
+    const Dtype* top_diff, const Dtype* src, const Dtype* mean,
+    const Dtype* inv_std, Dtype* dy_sum, Dtype* dy_dot) {
+  __shared__ Dtype sum_buf[CAFFE_CUDA_NUM_THREADS];
+  __shared__ Dtype dot_buf[CAFFE_CUDA_NUM_THREADS];
+  const int c = blockIdx.x;
+  const int count = num * spatial_dim;
+  Dtype sum = 0, dot = 0;
+  for (int i = threadIdx.x; i < count; i += blockDim.x) {
+    const int index = ((i / spatial_dim) * channels + c) * spatial_dim
+        + i % spatial_dim;
+    sum += top_diff[index];
+    dot += top_diff[index] * src[index];
+  }
+  sum_buf[threadIdx.x] = sum;
+  dot_buf[threadIdx.x] = dot;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) {
+      sum_buf[threadIdx.x] += sum_buf[threadIdx.x + s];
+      dot_buf[threadIdx.x] += dot_buf[threadIdx.x + s];
+    }
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) {
+    dy_sum[c] = sum_buf[0];
+    dy_dot[c] = normalized ? dot_buf[0]
+        : (dot_buf[0] - mean[c] * sum_buf[0]) * inv_std[c];
+  }
+}
+
+template <typename Dtype>
+__global__ void BatchNormBackwardKernel(const int count, const int channels,
+    const int spatial_dim, const Dtype scale, const bool normalized,
+    const Dtype* top_diff, const Dtype* src, const Dtype* mean,
+    const Dtype* inv_std, const Dtype* dy_sum, const Dtype* dy_dot,
+    Dtype* bottom_diff) {
+  CUDA_KERNEL_LOOP(i, count) {
+    const int c = (i / spatial_dim) % channels;
+    const Dtype y = normalized ? src[i] : (src[i] - mean[c]) * inv_std[c];
+    bottom_diff[i] = (top_diff[i] - (dy_sum[c] + dy_dot[c] * y) * scale)
+        * inv_std[c];
+  }
+}
+
+template <typename Dtype>
+__global__ void BatchNormScaleDiffKernel(const int count, const int channels,
+    const int spatial_dim, const Dtype* inv_std, const Dtype* top_diff,
+    Dtype* bottom_diff) {
+  CUDA_KERNEL_LOOP(i, count) {
+    bottom_diff[i] = top_diff[i] * inv_std[(i / spatial_dim) % channels];
+  }
+}
+
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
+  const int count = bottom[0]->count();
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(channels_*bottom[0]->shape(0));
 
-  if (bottom[0] != top[0]) {
-    caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  }
-
-
   if (use_global_stats_) {
     // use the stored mean/variance estimates.
     const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
@@ -28,35 +139,11 @@ void BatchNormLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     caffe_gpu_scale(variance_.count(), scale_factor,
         this->blobs_[1]->gpu_data(), variance_.mutable_gpu_data());
   } else {
-    // compute mean
-    caffe_gpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), bottom_data,
-        spatial_sum_multiplier_.gpu_data(), 0.,
-        num_by_chans_.mutable_gpu_data());
-    caffe_gpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.gpu_data(), batch_sum_multiplier_.gpu_data(), 0.,
-        mean_.mutable_gpu_data());
-  }
-
-  // subtract mean
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.gpu_data(), mean_.gpu_data(), 0.,
-      num_by_chans_.mutable_gpu_data());
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, -1, num_by_chans_.gpu_data(),
-      spatial_sum_multiplier_.gpu_data(), 1., top_data);
-
-  if (!use_global_stats_) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_gpu_powx(top[0]->count(), top_data, Dtype(2),
-        temp_.mutable_gpu_data());  // (X-EX)^2
-    caffe_gpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim,
-        1. / (num * spatial_dim), temp_.gpu_data(),
-        spatial_sum_multiplier_.gpu_data(), 0.,
-        num_by_chans_.mutable_gpu_data());
-    caffe_gpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-        num_by_chans_.gpu_data(), batch_sum_multiplier_.gpu_data(), 0.,
-        variance_.mutable_gpu_data());  // E((X_EX)^2)
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    BatchNormStatsKernel<Dtype><<<channels_, CAFFE_CUDA_NUM_THREADS>>>(
+        num, channels_, spatial_dim, bottom_data,
+        mean_.mutable_gpu_data(), variance_.mutable_gpu_data());
+    CUDA_POST_KERNEL_CHECK;
 
     // compute and save moving average
     this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
@@ -70,99 +157,58 @@ void BatchNormLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
         this->blobs_[1]->mutable_gpu_data());
   }
 
-  // normalize variance
-  caffe_gpu_add_scalar(variance_.count(), eps_, variance_.mutable_gpu_data());
-  caffe_gpu_powx(variance_.count(), variance_.gpu_data(), Dtype(0.5),
-      variance_.mutable_gpu_data());
-
-  // replicate variance to input size
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.gpu_data(), variance_.gpu_data(), 0.,
-      num_by_chans_.mutable_gpu_data());
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.gpu_data(),
-      spatial_sum_multiplier_.gpu_data(), 0., temp_.mutable_gpu_data());
-  caffe_gpu_div(temp_.count(), top_data, temp_.gpu_data(), top_data);
-  // TODO(cdoersch): The caching is only needed because later in-place layers
-  //                 might clobber the data.  Can we skip this if they won't?
-  caffe_copy(x_norm_.count(), top_data,
-      x_norm_.mutable_gpu_data());
+  // normalize: Y = (X - mean) / sqrt(var + eps), broadcasting the channel
+  // statistics in place of the full-size replicated scratch tensor.
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  BatchNormInvStdKernel<Dtype><<<CAFFE_GET_BLOCKS(channels_),
+      CAFFE_CUDA_NUM_THREADS>>>(channels_, eps_, variance_.gpu_data(),
+      inv_std_.mutable_gpu_data());
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  BatchNormForwardKernel<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count, channels_, spatial_dim,
+      mean_.gpu_data(), inv_std_.gpu_data(), bottom_data, top_data);
+  CUDA_POST_KERNEL_CHECK;
+  if (bottom[0] == top[0] && !use_global_stats_) {
+    // Running in place destroyed X, which the backward would otherwise use
+    // to recompute Y; keep a copy of the normalized output instead.
+    caffe_copy(count, top_data, x_norm_.mutable_gpu_data());
+  }
 }
 
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
-  const Dtype* top_diff;
-  if (bottom[0] != top[0]) {
-    top_diff = top[0]->gpu_diff();
-  } else {
-    caffe_copy(x_norm_.count(), top[0]->gpu_diff(), x_norm_.mutable_gpu_diff());
-    top_diff = x_norm_.gpu_diff();
-  }
+  const Dtype* top_diff = top[0]->gpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+  const int count = bottom[0]->count();
+  int num = bottom[0]->shape()[0];
+  int spatial_dim = bottom[0]->count()/(channels_*bottom[0]->shape(0));
   if (use_global_stats_) {
-    caffe_gpu_div(temp_.count(), top_diff, temp_.gpu_data(), bottom_diff);
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    BatchNormScaleDiffKernel<Dtype><<<CAFFE_GET_BLOCKS(count),
+        CAFFE_CUDA_NUM_THREADS>>>(count, channels_, spatial_dim,
+        inv_std_.gpu_data(), top_diff, bottom_diff);
+    CUDA_POST_KERNEL_CHECK;
     return;
   }
-  const Dtype* top_data = x_norm_.gpu_data();
-  int num = bottom[0]->shape()[0];
-  int spatial_dim = bottom[0]->count()/(channels_*bottom[0]->shape(0));
-  // if Y = (X-mean(X))/(sqrt(var(X)+eps)), then
-  //
-  // dE(Y)/dX =
-  //   (dE/dY - mean(dE/dY) - mean(dE/dY \cdot Y) \cdot Y)
-  //     ./ sqrt(var(X) + eps)
-  //
-  // where \cdot and ./ are hadamard product and elementwise division,
-  // respectively, dE/dY is the top diff, and mean/var/sum are all computed
-  // along all dimensions except the channels dimension.  In the above
-  // equation, the operations allow for expansion (i.e. broadcast) along all
-  // dimensions except the channels dimension where required.
-
-  // sum(dE/dY \cdot Y)
-  caffe_gpu_mul(temp_.count(), top_data, top_diff, bottom_diff);
-  caffe_gpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      bottom_diff, spatial_sum_multiplier_.gpu_data(), 0.,
-      num_by_chans_.mutable_gpu_data());
-  caffe_gpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.gpu_data(), batch_sum_multiplier_.gpu_data(), 0.,
-      mean_.mutable_gpu_data());
-
-  // reshape (broadcast) the above
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.gpu_data(), mean_.gpu_data(), 0.,
-      num_by_chans_.mutable_gpu_data());
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_ * num,
-      spatial_dim, 1, 1., num_by_chans_.gpu_data(),
-      spatial_sum_multiplier_.gpu_data(), 0., bottom_diff);
-
-  // sum(dE/dY \cdot Y) \cdot Y
-  caffe_gpu_mul(temp_.count(), top_data, bottom_diff, bottom_diff);
-
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_gpu_gemv<Dtype>(CblasNoTrans, channels_ * num, spatial_dim, 1.,
-      top_diff, spatial_sum_multiplier_.gpu_data(), 0.,
-      num_by_chans_.mutable_gpu_data());
-  caffe_gpu_gemv<Dtype>(CblasTrans, num, channels_, 1.,
-      num_by_chans_.gpu_data(), batch_sum_multiplier_.gpu_data(), 0.,
-      mean_.mutable_gpu_data());
-  // reshape (broadcast) the above to make
-  // sum(dE/dY)-sum(dE/dY \cdot Y) \cdot Y
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, channels_, 1, 1,
-      batch_sum_multiplier_.gpu_data(), mean_.gpu_data(), 0.,
-      num_by_chans_.mutable_gpu_data());
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num * channels_,
-      spatial_dim, 1, 1., num_by_chans_.gpu_data(),
-      spatial_sum_multiplier_.gpu_data(), 1., bottom_diff);
-
-  // dE/dY - mean(dE/dY)-mean(dE/dY \cdot Y) \cdot Y
-  caffe_gpu_axpby(temp_.count(), Dtype(1), top_diff,
-      Dtype(-1. / (num * spatial_dim)), bottom_diff);
-
-  // note: temp_ still contains sqrt(var(X)+eps), computed during the forward
-  // pass.
-  caffe_gpu_div(temp_.count(), bottom_diff, temp_.gpu_data(), bottom_diff);
+  // Same gradient as the CPU path (see Backward_cpu): per-channel
+  // reductions of the top diff followed by one elementwise combination.
+  const bool in_place = (bottom[0] == top[0]);
+  const Dtype* src = in_place ? x_norm_.gpu_data() : bottom[0]->gpu_data();
+  Dtype* dy_sum = channel_sums_.mutable_gpu_data();
+  Dtype* dy_dot = dy_sum + channels_;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  BatchNormBackwardStatsKernel<Dtype><<<channels_, CAFFE_CUDA_NUM_THREADS>>>(
+      num, channels_, spatial_dim, in_place, top_diff, src,
+      mean_.gpu_data(), inv_std_.gpu_data(), dy_sum, dy_dot);
+  CUDA_POST_KERNEL_CHECK;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  BatchNormBackwardKernel<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count, channels_, spatial_dim,
+      Dtype(1. / (num * spatial_dim)), in_place, top_diff, src,
+      mean_.gpu_data(), inv_std_.gpu_data(), dy_sum, dy_dot, bottom_diff);
+  CUDA_POST_KERNEL_CHECK;
 }
 
 INSTANTIATE_LAYER_GPU_FUNCS(BatchNormLayer);
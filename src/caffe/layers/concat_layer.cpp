@@ -51,6 +51,19 @@ void ConcatLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
   }
+  // Bottoms wired as zero-copy views into the top (see
+  // Net::WireZeroCopyViews) are only valid at the offsets they were
+  // created for; if a reshape moved a bottom, drop its view so Forward
+  // falls back to copying instead of aliasing the wrong range.
+  const SyncedMemory* top_mem = top[0]->data().get();
+  size_t offset = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    if (bottom[i]->data()->view_parent() == top_mem &&
+        bottom[i]->data()->view_offset() != offset * sizeof(Dtype)) {
+      bottom[i]->UnshareViews();
+    }
+    offset += bottom[i]->count();
+  }
 }
 
 template <typename Dtype>
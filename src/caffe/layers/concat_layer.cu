@@ -33,8 +33,16 @@ void ConcatLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   const int top_concat_axis = top[0]->shape(concat_axis_);
   const bool kForward = true;
   for (int i = 0; i < bottom.size(); ++i) {
-    const Dtype* bottom_data = bottom[i]->gpu_data();
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    // A bottom wired as a zero-copy view of the top already lives at
+    // its destination (see Net::WireZeroCopyViews).
+    if (bottom[i]->data()->is_view_of(top[0]->data().get(),
+        static_cast<size_t>(offset_concat_axis) * concat_input_size_ *
+        sizeof(Dtype))) {
+      offset_concat_axis += bottom_concat_axis;
+      continue;
+    }
+    const Dtype* bottom_data = bottom[i]->gpu_data();
     const int bottom_concat_size = bottom_concat_axis * concat_input_size_;
     const int nthreads = bottom_concat_size * num_concats_;
     Concat<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
@@ -55,7 +63,10 @@ void ConcatLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   const bool kForward = false;
   for (int i = 0; i < bottom.size(); ++i) {
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
-    if (propagate_down[i]) {
+    if (propagate_down[i] &&
+        !bottom[i]->diff()->is_view_of(top[0]->diff().get(),
+            static_cast<size_t>(offset_concat_axis) * concat_input_size_ *
+            sizeof(Dtype))) {
       Dtype* bottom_diff = bottom[i]->mutable_gpu_diff();
       const int bottom_concat_size = bottom_concat_axis * concat_input_size_;
       const int nthreads = bottom_concat_size * num_concats_;
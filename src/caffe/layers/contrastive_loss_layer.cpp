@@ -19,32 +19,28 @@ void ContrastiveLossLayer<Dtype>::LayerSetUp(
   CHECK_EQ(bottom[2]->height(), 1);
   CHECK_EQ(bottom[2]->width(), 1);
   diff_.Reshape(bottom[0]->num(), bottom[0]->channels(), 1, 1);
-  diff_sq_.Reshape(bottom[0]->num(), bottom[0]->channels(), 1, 1);
   dist_sq_.Reshape(bottom[0]->num(), 1, 1, 1);
-  // vector of ones used to sum along channels
-  summer_vec_.Reshape(bottom[0]->channels(), 1, 1, 1);
-  for (int i = 0; i < bottom[0]->channels(); ++i)
-    summer_vec_.mutable_cpu_data()[i] = Dtype(1);
 }
 
 template <typename Dtype>
 void ContrastiveLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  int count = bottom[0]->count();
-  caffe_sub(
-      count,
+  const int channels = bottom[0]->channels();
+  // One fused pass per pair: writes a_i-b_i (kept for backward) and its
+  // squared distance, instead of a full subtract sweep plus per-pair dots.
+  caffe_cpu_slice_sub_sumsq(
+      bottom[0]->num(),
+      channels,
       bottom[0]->cpu_data(),  // a
       bottom[1]->cpu_data(),  // b
-      diff_.mutable_cpu_data());  // a_i-b_i
-  const int channels = bottom[0]->channels();
+      diff_.mutable_cpu_data(),  // a_i-b_i
+      dist_sq_.mutable_cpu_data());  // \Sum (a_i-b_i)^2
   Dtype margin = this->layer_param_.contrastive_loss_param().margin();
   bool legacy_version =
       this->layer_param_.contrastive_loss_param().legacy_version();
   Dtype loss(0.0);
   for (int i = 0; i < bottom[0]->num(); ++i) {
-    dist_sq_.mutable_cpu_data()[i] = caffe_cpu_dot(channels,
-        diff_.cpu_data() + (i*channels), diff_.cpu_data() + (i*channels));
     if (static_cast<int>(bottom[2]->cpu_data()[i])) {  // similar pairs
       loss += dist_sq_.cpu_data()[i];
     } else {  // dissimilar pairs
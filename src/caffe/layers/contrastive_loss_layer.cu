@@ -9,25 +9,15 @@ namespace caffe {
 template <typename Dtype>
 void ContrastiveLossLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  const int count = bottom[0]->count();
-  caffe_gpu_sub(
-      count,
+  // One fused kernel per pair: writes a_i-b_i (kept for backward) and
+  // its squared distance, replacing the subtract, square-into-scratch
+  // and ones-vector gemv sweeps.
+  caffe_gpu_slice_sub_sumsq(
+      bottom[0]->num(),
+      bottom[0]->channels(),
       bottom[0]->gpu_data(),  // a
       bottom[1]->gpu_data(),  // b
-      diff_.mutable_gpu_data());  // a_i-b_i
-  caffe_gpu_powx(
-      count,
       diff_.mutable_gpu_data(),  // a_i-b_i
-      Dtype(2),
-      diff_sq_.mutable_gpu_data());  // (a_i-b_i)^2
-  caffe_gpu_gemv(
-      CblasNoTrans,
-      bottom[0]->num(),
-      bottom[0]->channels(),
-      Dtype(1.0),
-      diff_sq_.gpu_data(),  // (a_i-b_i)^2
-      summer_vec_.gpu_data(),
-      Dtype(0.0),
       dist_sq_.mutable_gpu_data());  // \Sum (a_i-b_i)^2
   Dtype margin = this->layer_param_.contrastive_loss_param().margin();
   bool legacy_version =
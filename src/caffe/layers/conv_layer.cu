@@ -1,9 +1,22 @@
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// Fused output epilogue: bias-add (bias may be NULL) and max(0, x) in one
+// pass over an image, replacing the bias GEMM plus a separate ReLU layer
+// pass; see BaseConvolutionLayer::set_fused_relu.
+template <typename Dtype>
+__global__ void ConvEpilogueReLU(const int n, const int spatial_dim,
+    const Dtype* bias, Dtype* out) {
+  CUDA_KERNEL_LOOP(index, n) {
+    const Dtype b = bias != NULL ? bias[index / spatial_dim] : Dtype(0);
+    out[index] = max(out[index] + b, Dtype(0));
+  }
+}
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -11,11 +24,32 @@ void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->gpu_data();
     Dtype* top_data = top[i]->mutable_gpu_data();
+    if (this->is_1x1_ && this->group_ == 1 && this->num_ > 1) {
+      // For 1x1 the column buffer is the input itself, so the whole
+      // batch collapses into one strided-batched cuBLAS call with the
+      // weights reused at stride zero.
+      caffe_gpu_gemm_batched<Dtype>(CblasNoTrans, CblasNoTrans,
+          this->conv_out_channels_, this->conv_out_spatial_dim_,
+          this->kernel_dim_, (Dtype)1., weight, 0,
+          bottom_data, this->bottom_dim_, (Dtype)0.,
+          top_data, this->top_dim_, this->num_);
+    }
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_gpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->gpu_data();
+      if (!(this->is_1x1_ && this->group_ == 1 && this->num_ > 1)) {
+        this->forward_gpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
+      const Dtype* bias =
+          this->bias_term_ ? this->blobs_[1]->gpu_data() : NULL;
+      if (this->fused_relu_) {
+        const int count = this->num_output_ * this->out_spatial_dim_;
+        // NOLINT_NEXT_LINE(whitespace/operators)
+        ConvEpilogueReLU<Dtype><<<CAFFE_GET_BLOCKS(count),
+                                  CAFFE_CUDA_NUM_THREADS>>>(
+            count, this->out_spatial_dim_, bias,
+            top_data + n * this->top_dim_);
+        CUDA_POST_KERNEL_CHECK;
+      } else if (bias != NULL) {
         this->forward_gpu_bias(top_data + n * this->top_dim_, bias);
       }
     }
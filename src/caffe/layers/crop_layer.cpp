@@ -72,48 +72,63 @@ void CropLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     offsets[i] = crop_offset;
   }
   top[0]->Reshape(new_shape);
+  // Find the outermost axis whose trailing axes are all uncropped: the
+  // axes from it inward form contiguous runs, one per index over the
+  // axes outside it, so the copy moves whole runs instead of innermost
+  // lines. When every outer axis has extent one, the region is a single
+  // run and the copy can be elided entirely (Net::WireZeroCopyViews).
+  run_axis_ = input_dim - 1;
+  while (run_axis_ > 0 && offsets[run_axis_] == 0 &&
+         top[0]->shape(run_axis_) == bottom[0]->shape(run_axis_)) {
+    --run_axis_;
+  }
+  contiguous_ = top[0]->count(0, run_axis_) == 1;
+  region_offset_ = bottom[0]->offset(offsets);
+  // A top wired as a zero-copy view into the bottom (see
+  // Net::WireZeroCopyViews) is only valid at the offset it was created
+  // for; if a reshape moved the region or broke its contiguity, drop
+  // the view so the copy resumes.
+  if (top[0]->data()->view_parent() == bottom[0]->data().get() &&
+      (!contiguous_ || top[0]->data()->view_offset() !=
+          static_cast<size_t>(region_offset_) * sizeof(Dtype))) {
+    top[0]->UnshareViews();
+  }
+}
+
+template <typename Dtype>
+bool CropLayer<Dtype>::contiguous_region(int* offset) const {
+  *offset = region_offset_;
+  return contiguous_;
 }
 
-// recursive copy function
 template <typename Dtype>
 void CropLayer<Dtype>::crop_copy(const vector<Blob<Dtype>*>& bottom,
              const vector<Blob<Dtype>*>& top,
-             const vector<int>& offsets,
-             vector<int> indices,
-             int cur_dim,
              const Dtype* src_data,
              Dtype* dest_data,
              bool is_forward) {
-  if (cur_dim + 1 < top[0]->num_axes()) {
-    // We are not yet at the final dimension, call copy recursively
-    for (int i = 0; i < top[0]->shape(cur_dim); ++i) {
-      indices[cur_dim] = i;
-      crop_copy(bottom, top, offsets, indices, cur_dim+1,
-                src_data, dest_data, is_forward);
+  const int num_axes = top[0]->num_axes();
+  const int run_length = top[0]->count(run_axis_);
+  const int num_runs = top[0]->count(0, run_axis_);
+  std::vector<int> ind_off(num_axes, 0);
+  for (int r = 0; r < num_runs; ++r) {
+    // Decompose the run index into indices over the outer axes and
+    // shift each by its crop offset; the run axis starts at its offset
+    // and the inner axes are uncropped.
+    int rem = r;
+    for (int a = run_axis_ - 1; a >= 0; --a) {
+      ind_off[a] = rem % top[0]->shape(a) + offsets[a];
+      rem /= top[0]->shape(a);
     }
-  } else {
-    // We are at the last dimensions, which is stored continously in memory
-    for (int i = 0; i < top[0]->shape(cur_dim); ++i) {
-      // prepare index vector reduced(red) and with offsets(off)
-      std::vector<int> ind_red(cur_dim, 0);
-      std::vector<int> ind_off(cur_dim+1, 0);
-      for (int j = 0; j < cur_dim; ++j) {
-          ind_red[j] = indices[j];
-          ind_off[j] = indices[j] + offsets[j];
-      }
-      ind_off[cur_dim] = offsets[cur_dim];
-      // do the copy
-      if (is_forward) {
-        caffe_copy(top[0]->shape(cur_dim),
-            src_data + bottom[0]->offset(ind_off),
-            dest_data + top[0]->offset(ind_red));
-      } else {
-        // in the backwards pass the src_data is top_diff
-        // and the dest_data is bottom_diff
-        caffe_copy(top[0]->shape(cur_dim),
-            src_data + top[0]->offset(ind_red),
-            dest_data + bottom[0]->offset(ind_off));
-      }
+    ind_off[run_axis_] = offsets[run_axis_];
+    const int src_off = bottom[0]->offset(ind_off);
+    const int dest_off = r * run_length;
+    if (is_forward) {
+      caffe_copy(run_length, src_data + src_off, dest_data + dest_off);
+    } else {
+      // in the backwards pass the src_data is top_diff
+      // and the dest_data is bottom_diff
+      caffe_copy(run_length, src_data + dest_off, dest_data + src_off);
     }
   }
 }
@@ -121,10 +136,11 @@ void CropLayer<Dtype>::crop_copy(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void CropLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  std::vector<int> indices(top[0]->num_axes(), 0);
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  crop_copy(bottom, top, offsets, indices, 0, bottom_data, top_data, true);
+  // A top wired as a view into the bottom no-ops through caffe_copy's
+  // pointer-equality check (the region is then a single run).
+  crop_copy(bottom, top, bottom_data, top_data, true);
 }
 
 template <typename Dtype>
@@ -134,9 +150,18 @@ void CropLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
 
   if (propagate_down[0]) {
+    if (contiguous_ && top_diff == bottom_diff + region_offset_) {
+      // The top diff is a wired view into the bottom diff, so the
+      // region already holds the gradient; only the margins around it
+      // need zeroing.
+      caffe_set(region_offset_, static_cast<Dtype>(0), bottom_diff);
+      const int region_end = region_offset_ + top[0]->count();
+      caffe_set(bottom[0]->count() - region_end, static_cast<Dtype>(0),
+          bottom_diff + region_end);
+      return;
+    }
     caffe_set(bottom[0]->count(), static_cast<Dtype>(0), bottom_diff);
-    std::vector<int> indices(top[0]->num_axes(), 0);
-    crop_copy(bottom, top, offsets, indices, 0, top_diff, bottom_diff, false);
+    crop_copy(bottom, top, top_diff, bottom_diff, false);
   }
 }
 
@@ -99,6 +99,11 @@ void CropLayer<Dtype>::crop_copy_gpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void CropLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  if (top[0]->data()->is_view_of(bottom[0]->data().get(),
+      static_cast<size_t>(region_offset_) * sizeof(Dtype))) {
+    // The top was wired as a view into the bottom; nothing to copy.
+    return;
+  }
   std::vector<int> indices(top[0]->num_axes(), 0);
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
@@ -108,15 +113,24 @@ void CropLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void CropLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  if (top[0]->diff()->is_view_of(bottom[0]->diff().get(),
+      static_cast<size_t>(region_offset_) * sizeof(Dtype))) {
+    // The top diff is a wired view into the bottom diff, so the region
+    // already holds the gradient; only the margins need zeroing.
+    Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+    caffe_gpu_set(region_offset_, static_cast<Dtype>(0), bottom_diff);
+    const int region_end = region_offset_ + top[0]->count();
+    caffe_gpu_set(bottom[0]->count() - region_end, static_cast<Dtype>(0),
+        bottom_diff + region_end);
+    return;
+  }
   const Dtype* top_diff = top[0]->gpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
-
-  if (propagate_down[0]) {
-    caffe_gpu_set(bottom[0]->count(), static_cast<Dtype>(0), bottom_diff);
-    std::vector<int> indices(top[0]->num_axes(), 0);
-    crop_copy_gpu(bottom, top, offsets, indices, 0, top_diff, bottom_diff,
-                  false);
-  }
+  caffe_gpu_set(bottom[0]->count(), static_cast<Dtype>(0), bottom_diff);
+  std::vector<int> indices(top[0]->num_axes(), 0);
+  crop_copy_gpu(bottom, top, offsets, indices, 0, top_diff, bottom_diff,
+                false);
 }
 
 INSTANTIATE_LAYER_GPU_FUNCS(CropLayer);
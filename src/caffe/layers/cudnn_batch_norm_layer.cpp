@@ -0,0 +1,113 @@
+#ifdef USE_CUDNN
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/cudnn_batch_norm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  BatchNormLayer<Dtype>::LayerSetUp(bottom, top);
+  if (this->blobs_.size() == 3) {
+    // Fused per-channel scale and bias, initialized to the identity.
+    vector<int> sz(1, this->channels_);
+    this->blobs_.resize(5);
+    this->blobs_[3].reset(new Blob<Dtype>(sz));
+    this->blobs_[4].reset(new Blob<Dtype>(sz));
+    caffe_set(this->channels_, Dtype(1),
+        this->blobs_[3]->mutable_cpu_data());
+    caffe_set(this->channels_, Dtype(0),
+        this->blobs_[4]->mutable_cpu_data());
+  } else {
+    CHECK_EQ(this->blobs_.size(), 5)
+        << "CuDNNBatchNormLayer expects mean, variance, counter, scale and "
+        << "bias blobs.";
+  }
+
+  CUDNN_CHECK(cudnnCreate(&handle_));
+  cudnn::createTensor4dDesc<Dtype>(&bottom_desc_);
+  cudnn::createTensor4dDesc<Dtype>(&top_desc_);
+  CUDNN_CHECK(cudnnCreateTensorDescriptor(&scale_bias_desc_));
+  handles_setup_ = true;
+}
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  BatchNormLayer<Dtype>::Reshape(bottom, top);
+  // cuDNN operates on 4D tensors; fold all trailing axes into the width so
+  // CUDNN_BATCHNORM_SPATIAL reduces over everything but the channels.
+  const int num = bottom[0]->shape(0);
+  const int spatial_dim = bottom[0]->count() / (num * this->channels_);
+  cudnn::setTensor4dDesc<Dtype>(&bottom_desc_, num, this->channels_, 1,
+      spatial_dim);
+  cudnn::setTensor4dDesc<Dtype>(&top_desc_, num, this->channels_, 1,
+      spatial_dim);
+  CUDNN_CHECK(cudnnDeriveBNTensorDescriptor(scale_bias_desc_, bottom_desc_,
+      CUDNN_BATCHNORM_SPATIAL));
+  if (bottom[0] == top[0]) {
+    save_bottom_.ReshapeLike(*bottom[0]);
+  }
+}
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::ConvertLegacyStats() {
+  const Dtype counter = this->blobs_[2]->cpu_data()[0];
+  if (counter == Dtype(1)) { return; }
+  const Dtype scale_factor = counter == 0 ? 0 : 1 / counter;
+  caffe_scal(this->blobs_[0]->count(), scale_factor,
+      this->blobs_[0]->mutable_cpu_data());
+  caffe_scal(this->blobs_[1]->count(), scale_factor,
+      this->blobs_[1]->mutable_cpu_data());
+  this->blobs_[2]->mutable_cpu_data()[0] = 1;
+}
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // CPU fallback (e.g. TEST-time inference of a deployed net): the base
+  // normalization followed by the fused scale and bias.
+  ConvertLegacyStats();
+  BatchNormLayer<Dtype>::Forward_cpu(bottom, top);
+  const Dtype* scale = this->blobs_[3]->cpu_data();
+  const Dtype* bias = this->blobs_[4]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int num = bottom[0]->shape(0);
+  const int spatial_dim = bottom[0]->count() / (num * this->channels_);
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < this->channels_; ++c) {
+      const int offset = (n * this->channels_ + c) * spatial_dim;
+      const Dtype s = scale[c];
+      const Dtype b = bias[c];
+      for (int i = 0; i < spatial_dim; ++i) {
+        top_data[offset + i] = top_data[offset + i] * s + b;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  NOT_IMPLEMENTED;
+}
+
+template <typename Dtype>
+CuDNNBatchNormLayer<Dtype>::~CuDNNBatchNormLayer() {
+  // Check that handles have been setup before destroying.
+  if (!handles_setup_) { return; }
+
+  cudnnDestroyTensorDescriptor(bottom_desc_);
+  cudnnDestroyTensorDescriptor(top_desc_);
+  cudnnDestroyTensorDescriptor(scale_bias_desc_);
+  cudnnDestroy(handle_);
+}
+
+INSTANTIATE_CLASS(CuDNNBatchNormLayer);
+
+}   // namespace caffe
+#endif
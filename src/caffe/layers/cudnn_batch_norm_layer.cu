@@ -0,0 +1,98 @@
+#ifdef USE_CUDNN
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/cudnn_batch_norm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::Forward_gpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->gpu_data();
+  Dtype* top_data = top[0]->mutable_gpu_data();
+  const double eps = std::max(static_cast<double>(this->eps_),
+      CUDNN_BN_MIN_EPSILON);
+  ConvertLegacyStats();
+  const Dtype* scale_data = this->blobs_[3]->gpu_data();
+  const Dtype* bias_data = this->blobs_[4]->gpu_data();
+
+  if (this->use_global_stats_) {
+    CUDNN_CHECK(cudnnBatchNormalizationForwardInference(handle_,
+        CUDNN_BATCHNORM_SPATIAL,
+        cudnn::dataType<Dtype>::one, cudnn::dataType<Dtype>::zero,
+        bottom_desc_, bottom_data,
+        top_desc_, top_data,
+        scale_bias_desc_, scale_data, bias_data,
+        this->blobs_[0]->gpu_data(), this->blobs_[1]->gpu_data(), eps));
+    return;
+  }
+
+  if (bottom[0] == top[0]) {
+    // The backward needs the original input; an in-place forward would
+    // destroy it, so normalize out of a private copy.
+    caffe_copy(bottom[0]->count(), bottom_data,
+        save_bottom_.mutable_gpu_data());
+    bottom_data = save_bottom_.gpu_data();
+  }
+  // cuDNN keeps running averages directly: running = (1 - factor) *
+  // running + factor * batch statistic, so the caffe momentum maps to
+  // factor = 1 - moving_average_fraction. The batch mean and inverse
+  // standard deviation are saved for the backward pass.
+  CUDNN_CHECK(cudnnBatchNormalizationForwardTraining(handle_,
+      CUDNN_BATCHNORM_SPATIAL,
+      cudnn::dataType<Dtype>::one, cudnn::dataType<Dtype>::zero,
+      bottom_desc_, bottom_data,
+      top_desc_, top_data,
+      scale_bias_desc_, scale_data, bias_data,
+      1 - this->moving_average_fraction_,
+      this->blobs_[0]->mutable_gpu_data(),
+      this->blobs_[1]->mutable_gpu_data(),
+      eps, this->mean_.mutable_gpu_data(),
+      this->inv_std_.mutable_gpu_data()));
+}
+
+template <typename Dtype>
+void CuDNNBatchNormLayer<Dtype>::Backward_gpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->use_global_stats_)
+      << "CuDNNBatchNormLayer backward requires batch statistics; to "
+      << "fine-tune with frozen statistics use engine: CAFFE with a "
+      << "separate ScaleLayer.";
+  const Dtype* top_diff;
+  const Dtype* bottom_data;
+  if (bottom[0] == top[0]) {
+    // Stage the top diff next to the saved input; cuDNN may not alias
+    // dy and dx.
+    caffe_copy(top[0]->count(), top[0]->gpu_diff(),
+        save_bottom_.mutable_gpu_diff());
+    top_diff = save_bottom_.gpu_diff();
+    bottom_data = save_bottom_.gpu_data();
+  } else {
+    top_diff = top[0]->gpu_diff();
+    bottom_data = bottom[0]->gpu_data();
+  }
+  Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+  const double eps = std::max(static_cast<double>(this->eps_),
+      CUDNN_BN_MIN_EPSILON);
+  // Scale and bias diffs accumulate (beta = 1) like every other caffe
+  // parameter gradient; the solver clears them between iterations.
+  CUDNN_CHECK(cudnnBatchNormalizationBackward(handle_,
+      CUDNN_BATCHNORM_SPATIAL,
+      cudnn::dataType<Dtype>::one, cudnn::dataType<Dtype>::zero,
+      cudnn::dataType<Dtype>::one, cudnn::dataType<Dtype>::one,
+      bottom_desc_, bottom_data,
+      top_desc_, top_diff,
+      bottom_desc_, bottom_diff,
+      scale_bias_desc_, this->blobs_[3]->gpu_data(),
+      this->blobs_[3]->mutable_gpu_diff(),
+      this->blobs_[4]->mutable_gpu_diff(),
+      eps, this->mean_.gpu_data(), this->inv_std_.gpu_data()));
+}
+
+INSTANTIATE_LAYER_GPU_FUNCS(CuDNNBatchNormLayer);
+
+}   // namespace caffe
+#endif
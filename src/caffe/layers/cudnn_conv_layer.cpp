@@ -1,8 +1,14 @@
 #ifdef USE_CUDNN
+#include <boost/thread.hpp>
 #include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "caffe/layers/cudnn_conv_layer.hpp"
+#include "caffe/util/gpu_allocator.hpp"
 
 namespace caffe {
 
@@ -11,6 +17,139 @@ namespace caffe {
 // bias, filter weights, and bottom data for each group independently
 #define CUDNN_STREAMS_PER_GROUP 3
 
+namespace {
+
+// Benchmarked algorithm choices, cached by convolution geometry so that
+// repeated reshapes and layers with identical shapes benchmark once per
+// process instead of once per layer.
+struct CuDNNConvAlgos {
+  cudnnConvolutionFwdAlgo_t fwd;
+  cudnnConvolutionBwdFilterAlgo_t bwd_filter;
+  cudnnConvolutionBwdDataAlgo_t bwd_data;
+  size_t fwd_ws, bwd_filter_ws, bwd_data_ws;
+};
+
+boost::mutex cudnn_algo_mutex;
+map<string, CuDNNConvAlgos> cudnn_algo_cache;
+
+// One workspace per device, shared by every cuDNN convolution layer on
+// it. Layers run sequentially within a net and parallel solvers pin
+// distinct devices, so a single allocation sized to the largest request
+// replaces the per-layer buffers that fragmented device memory.
+struct CuDNNWorkspace {
+  CuDNNWorkspace() : data(NULL), size(0), refs(0) {}
+  void* data;
+  size_t size;
+  int refs;
+};
+
+boost::mutex cudnn_workspace_mutex;
+map<int, CuDNNWorkspace> cudnn_workspaces;
+
+// Returns a device buffer of at least the given size, or NULL when the
+// allocation fails (callers fall back to workspace-free algorithms).
+void* cudnn_workspace_reserve(int device, size_t size) {
+  boost::mutex::scoped_lock lock(cudnn_workspace_mutex);
+  CuDNNWorkspace& workspace = cudnn_workspaces[device];
+  if (size > workspace.size) {
+    if (workspace.data != NULL) {
+      GPUAllocator::Put(workspace.data, workspace.size, device);
+      workspace.data = NULL;
+      workspace.size = 0;
+    }
+    int data_device;
+    if (!GPUAllocator::Get(&workspace.data, size, &data_device)) {
+      workspace.data = NULL;
+      return NULL;
+    }
+    workspace.size = size;
+  }
+  return workspace.data;
+}
+
+void cudnn_workspace_retain(int device) {
+  boost::mutex::scoped_lock lock(cudnn_workspace_mutex);
+  ++cudnn_workspaces[device].refs;
+}
+
+void cudnn_workspace_release(int device) {
+  boost::mutex::scoped_lock lock(cudnn_workspace_mutex);
+  CuDNNWorkspace& workspace = cudnn_workspaces[device];
+  if (--workspace.refs == 0) {
+    if (workspace.data != NULL) {
+      GPUAllocator::Put(workspace.data, workspace.size, device);
+    }
+    cudnn_workspaces.erase(device);
+  }
+}
+
+// The plan file header; a plan only applies to the cuDNN build and
+// device model it was benchmarked on.
+std::string cudnn_plan_header() {
+  int device = 0;
+  CUDA_CHECK(cudaGetDevice(&device));
+  cudaDeviceProp prop;
+  CUDA_CHECK(cudaGetDeviceProperties(&prop, device));
+  std::ostringstream header;
+  header << "caffe_cudnn_plan " << CUDNN_VERSION << " " << prop.name;
+  return header.str();
+}
+
+}  // namespace
+
+bool CuDNNAlgoCacheLoad(const string& path) {
+  std::ifstream in(path.c_str());
+  if (!in) { return false; }
+  string header;
+  std::getline(in, header);
+  if (header != cudnn_plan_header()) {
+    LOG(WARNING) << "Ignoring cuDNN plan " << path << ": stamped '"
+        << header << "' but this process is '" << cudnn_plan_header()
+        << "'";
+    return false;
+  }
+  boost::mutex::scoped_lock lock(cudnn_algo_mutex);
+  int loaded = 0;
+  string key;
+  int fwd, bwd_filter, bwd_data;
+  size_t fwd_ws, bwd_filter_ws, bwd_data_ws;
+  while (in >> key >> fwd >> bwd_filter >> bwd_data
+      >> fwd_ws >> bwd_filter_ws >> bwd_data_ws) {
+    CuDNNConvAlgos algos;
+    algos.fwd = static_cast<cudnnConvolutionFwdAlgo_t>(fwd);
+    algos.bwd_filter = static_cast<cudnnConvolutionBwdFilterAlgo_t>(bwd_filter);
+    algos.bwd_data = static_cast<cudnnConvolutionBwdDataAlgo_t>(bwd_data);
+    algos.fwd_ws = fwd_ws;
+    algos.bwd_filter_ws = bwd_filter_ws;
+    algos.bwd_data_ws = bwd_data_ws;
+    cudnn_algo_cache[key] = algos;
+    ++loaded;
+  }
+  LOG(INFO) << "Loaded " << loaded
+      << " benchmarked cuDNN algorithm choices from " << path;
+  return true;
+}
+
+bool CuDNNAlgoCacheSave(const string& path) {
+  boost::mutex::scoped_lock lock(cudnn_algo_mutex);
+  std::ofstream out(path.c_str(), std::ios::trunc);
+  if (!out) {
+    LOG(ERROR) << "Could not write cuDNN plan " << path;
+    return false;
+  }
+  out << cudnn_plan_header() << "\n";
+  for (map<string, CuDNNConvAlgos>::const_iterator it =
+      cudnn_algo_cache.begin(); it != cudnn_algo_cache.end(); ++it) {
+    out << it->first << " " << static_cast<int>(it->second.fwd)
+        << " " << static_cast<int>(it->second.bwd_filter)
+        << " " << static_cast<int>(it->second.bwd_data)
+        << " " << it->second.fwd_ws
+        << " " << it->second.bwd_filter_ws
+        << " " << it->second.bwd_data_ws << "\n";
+  }
+  return out.good();
+}
+
 /**
  * TODO(dox) explain cuDNN interface
  */
@@ -66,24 +205,28 @@ void CuDNNConvolutionLayer<Dtype>::LayerSetUp(
       this->num_output_ / this->group_, this->channels_ / this->group_,
       kernel_h, kernel_w);
 
-  // Create tensor descriptor(s) for data and corresponding convolution(s).
-  for (int i = 0; i < bottom.size(); i++) {
-    cudnnTensorDescriptor_t bottom_desc;
-    cudnn::createTensor4dDesc<Dtype>(&bottom_desc);
-    bottom_descs_.push_back(bottom_desc);
-    cudnnTensorDescriptor_t top_desc;
-    cudnn::createTensor4dDesc<Dtype>(&top_desc);
-    top_descs_.push_back(top_desc);
-    cudnnConvolutionDescriptor_t conv_desc;
-    cudnn::createConvolutionDesc<Dtype>(&conv_desc);
-    conv_descs_.push_back(conv_desc);
-  }
+  // Tensor and convolution descriptors are owned by the per-shape
+  // buckets built in Reshape; these vectors alias the active bucket.
+  bottom_descs_.resize(bottom.size());
+  top_descs_.resize(bottom.size());
+  conv_descs_.resize(bottom.size());
 
   // Tensor descriptor for bias.
   if (this->bias_term_) {
     cudnn::createTensor4dDesc<Dtype>(&bias_desc_);
   }
 
+#if CUDNN_VERSION_MIN(5, 0, 0)
+  if (this->fused_relu_) {
+    CUDNN_CHECK(cudnnCreateActivationDescriptor(&activ_desc_));
+    CUDNN_CHECK(cudnnSetActivationDescriptor(activ_desc_,
+        CUDNN_ACTIVATION_RELU, CUDNN_NOT_PROPAGATE_NAN, 0.));
+  }
+#endif
+
+  CUDA_CHECK(cudaGetDevice(&workspace_device_));
+  cudnn_workspace_retain(workspace_device_);
+
   handles_setup_ = true;
 }
 
@@ -97,6 +240,35 @@ void CuDNNConvolutionLayer<Dtype>::Reshape(
       << "Use 'engine: CAFFE' for general ND convolution.";
   bottom_offset_ = this->bottom_dim_ / this->group_;
   top_offset_ = this->top_dim_ / this->group_;
+  // All remaining state depends only on the input shape, so it is kept
+  // in per-shape buckets: reshaping back to a shape this layer has
+  // already seen just reinstalls its bucket instead of redoing the
+  // descriptor, algorithm and workspace setup.
+  const string shape_key = bottom[0]->shape_string();
+  if (shape_key == active_shape_) { return; }
+  typename map<string, ShapeBucket>::iterator bucket =
+      shape_buckets_.find(shape_key);
+  if (bucket == shape_buckets_.end()) {
+    const size_t capacity = std::max(1u,
+        this->layer_param_.convolution_param().cudnn_shape_buckets());
+    while (shape_buckets_.size() >= capacity) {
+      // Evicting the active bucket is safe: its descriptors are not
+      // touched again before InstallBucket repoints the aliases below.
+      DestroyBucket(&shape_buckets_.begin()->second);
+      shape_buckets_.erase(shape_buckets_.begin());
+    }
+    bucket = shape_buckets_.insert(
+        make_pair(shape_key, ShapeBucket())).first;
+    BuildBucket(bottom, top, &bucket->second);
+  }
+  active_shape_ = shape_key;
+  InstallBucket(bucket->second);
+}
+
+template <typename Dtype>
+void CuDNNConvolutionLayer<Dtype>::BuildBucket(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top,
+    ShapeBucket* bucket) {
   const int height = bottom[0]->shape(this->channel_axis_ + 1);
   const int width = bottom[0]->shape(this->channel_axis_ + 2);
   const int height_out = top[0]->shape(this->channel_axis_ + 1);
@@ -108,66 +280,183 @@ void CuDNNConvolutionLayer<Dtype>::Reshape(
   const int stride_h = stride_data[0];
   const int stride_w = stride_data[1];
 
-  // Specify workspace limit for kernels directly until we have a
-  // planning strategy and a rewrite of Caffe's GPU memory mangagement
+  const int* kernel_data = this->kernel_shape_.cpu_data();
+
+  // Workspace limit for the heuristic fallback path only; the
+  // benchmarked path lets the winning algorithm ask for what it needs.
   size_t workspace_limit_bytes = 8*1024*1024;
 
+  bucket->fwd_algo.resize(bottom.size());
+  bucket->bwd_filter_algo.resize(bottom.size());
+  bucket->bwd_data_algo.resize(bottom.size());
+  bucket->fwd_ws.resize(bottom.size());
+  bucket->bwd_filter_ws.resize(bottom.size());
+  bucket->bwd_data_ws.resize(bottom.size());
   for (int i = 0; i < bottom.size(); i++) {
-    cudnn::setTensor4dDesc<Dtype>(&bottom_descs_[i],
+    cudnnTensorDescriptor_t bottom_desc;
+    cudnn::createTensor4dDesc<Dtype>(&bottom_desc);
+    bucket->bottom_descs.push_back(bottom_desc);
+    cudnnTensorDescriptor_t top_desc;
+    cudnn::createTensor4dDesc<Dtype>(&top_desc);
+    bucket->top_descs.push_back(top_desc);
+    cudnnConvolutionDescriptor_t conv_desc;
+    cudnn::createConvolutionDesc<Dtype>(&conv_desc);
+    bucket->conv_descs.push_back(conv_desc);
+    cudnn::setTensor4dDesc<Dtype>(&bucket->bottom_descs[i],
         this->num_,
         this->channels_ / this->group_, height, width,
         this->channels_ * height * width,
         height * width, width, 1);
-    cudnn::setTensor4dDesc<Dtype>(&top_descs_[i],
+    cudnn::setTensor4dDesc<Dtype>(&bucket->top_descs[i],
         this->num_,
         this->num_output_ / this->group_, height_out, width_out,
         this->num_output_ * this->out_spatial_dim_,
         this->out_spatial_dim_, width_out, 1);
-    cudnn::setConvolutionDesc<Dtype>(&conv_descs_[i], bottom_descs_[i],
-        filter_desc_, pad_h, pad_w,
+    cudnn::setConvolutionDesc<Dtype>(&bucket->conv_descs[i],
+        bucket->bottom_descs[i], filter_desc_, pad_h, pad_w,
         stride_h, stride_w);
+#if CUDNN_VERSION_MIN(7, 2, 0)
+    // Pseudo-fp16: storage stays fp32 and cuDNN converts operands to
+    // half at the kernel boundary, so V100-class tensor cores run the
+    // convolution. Accumulation is fp32 inside the tensor op.
+    if (this->layer_param_.convolution_param().fp16_math() &&
+        sizeof(Dtype) == sizeof(float)) {
+      CUDNN_CHECK(cudnnSetConvolutionMathType(bucket->conv_descs[i],
+          CUDNN_TENSOR_OP_MATH_ALLOW_CONVERSION));
+    }
+#endif
+  }
 
-    // choose forward and backward algorithms + workspace(s)
-    CUDNN_CHECK(cudnnGetConvolutionForwardAlgorithm(handle_[0],
-      bottom_descs_[i],
-      filter_desc_,
-      conv_descs_[i],
-      top_descs_[i],
-      CUDNN_CONVOLUTION_FWD_SPECIFY_WORKSPACE_LIMIT,
-      workspace_limit_bytes,
-      &fwd_algo_[i]));
-
-    CUDNN_CHECK(cudnnGetConvolutionForwardWorkspaceSize(handle_[0],
-      bottom_descs_[i],
-      filter_desc_,
-      conv_descs_[i],
-      top_descs_[i],
-      fwd_algo_[i],
-      &(workspace_fwd_sizes_[i])));
-
-    // choose backward algorithm for filter
-    CUDNN_CHECK(cudnnGetConvolutionBackwardFilterAlgorithm(handle_[0],
-          bottom_descs_[i], top_descs_[i], conv_descs_[i], filter_desc_,
-          CUDNN_CONVOLUTION_BWD_FILTER_SPECIFY_WORKSPACE_LIMIT,
-          workspace_limit_bytes, &bwd_filter_algo_[i]) );
-
-    // get workspace for backwards filter algorithm
-    CUDNN_CHECK(cudnnGetConvolutionBackwardFilterWorkspaceSize(handle_[0],
-          bottom_descs_[i], top_descs_[i], conv_descs_[i], filter_desc_,
-          bwd_filter_algo_[i], &workspace_bwd_filter_sizes_[i]));
-
-    // choose backward algo for data
-    CUDNN_CHECK(cudnnGetConvolutionBackwardDataAlgorithm(handle_[0],
-          filter_desc_, top_descs_[i], conv_descs_[i], bottom_descs_[i],
-          CUDNN_CONVOLUTION_BWD_DATA_SPECIFY_WORKSPACE_LIMIT,
-        workspace_limit_bytes, &bwd_data_algo_[i]));
-
-    // get workspace size
-    CUDNN_CHECK(cudnnGetConvolutionBackwardDataWorkspaceSize(handle_[0],
-          filter_desc_, top_descs_[i], conv_descs_[i], bottom_descs_[i],
-          bwd_data_algo_[i], &workspace_bwd_data_sizes_[i]) );
+  // All bottoms of this layer share one geometry (the descriptors above
+  // are identical), so a single tuning result serves every index.
+  const Caffe::CuDNNBackward policy = Caffe::cudnn_backward_policy();
+  CuDNNConvAlgos algos;
+  {
+    std::ostringstream key_stream;
+    key_stream << sizeof(Dtype) << "_" << this->num_ << "_"
+        << this->channels_ << "_" << height << "_" << width << "_"
+        << this->num_output_ << "_" << kernel_data[0] << "_"
+        << kernel_data[1] << "_" << pad_h << "_" << pad_w << "_"
+        << stride_h << "_" << stride_w << "_" << this->group_
+        << "_" << static_cast<int>(policy);
+    const string key = key_stream.str();
+    const cudnnTensorDescriptor_t bottom_desc = bucket->bottom_descs[0];
+    const cudnnTensorDescriptor_t top_desc = bucket->top_descs[0];
+    const cudnnConvolutionDescriptor_t conv_desc = bucket->conv_descs[0];
+    boost::mutex::scoped_lock lock(cudnn_algo_mutex);
+    map<string, CuDNNConvAlgos>::const_iterator cached =
+        cudnn_algo_cache.find(key);
+    if (cached != cudnn_algo_cache.end()) {
+      algos = cached->second;
+    } else {
+      // Benchmark instead of trusting the heuristics; the measured
+      // winner is regularly 20-30% faster. cuDNN allocates its own
+      // trial workspaces here, so this runs before ours is sized.
+      const int kRequested = 8;
+      int returned = 0;
+      cudnnConvolutionFwdAlgoPerf_t fwd_perf[kRequested];
+      if (cudnnFindConvolutionForwardAlgorithm(handle_[0],
+          bottom_desc, filter_desc_, conv_desc, top_desc,
+          kRequested, &returned, fwd_perf) == CUDNN_STATUS_SUCCESS
+          && returned > 0 && fwd_perf[0].status == CUDNN_STATUS_SUCCESS) {
+        algos.fwd = fwd_perf[0].algo;
+        algos.fwd_ws = fwd_perf[0].memory;
+      } else {
+        CUDNN_CHECK(cudnnGetConvolutionForwardAlgorithm(handle_[0],
+            bottom_desc, filter_desc_, conv_desc, top_desc,
+            CUDNN_CONVOLUTION_FWD_SPECIFY_WORKSPACE_LIMIT,
+            workspace_limit_bytes, &algos.fwd));
+        CUDNN_CHECK(cudnnGetConvolutionForwardWorkspaceSize(handle_[0],
+            bottom_desc, filter_desc_, conv_desc, top_desc,
+            algos.fwd, &algos.fwd_ws));
+      }
+      if (policy == Caffe::CUDNN_BACKWARD_DETERMINISTIC) {
+        // The only backward algorithms cuDNN documents as deterministic;
+        // the atomics-based winners of the benchmark below are not.
+        algos.bwd_filter = CUDNN_CONVOLUTION_BWD_FILTER_ALGO_1;
+        CUDNN_CHECK(cudnnGetConvolutionBackwardFilterWorkspaceSize(
+            handle_[0], bottom_desc, top_desc, conv_desc,
+            filter_desc_, algos.bwd_filter, &algos.bwd_filter_ws));
+        algos.bwd_data = CUDNN_CONVOLUTION_BWD_DATA_ALGO_1;
+        CUDNN_CHECK(cudnnGetConvolutionBackwardDataWorkspaceSize(
+            handle_[0], filter_desc_, top_desc, conv_desc,
+            bottom_desc, algos.bwd_data, &algos.bwd_data_ws));
+      } else if (policy == Caffe::CUDNN_BACKWARD_MEMORY_LEAN) {
+        CUDNN_CHECK(cudnnGetConvolutionBackwardFilterAlgorithm(handle_[0],
+            bottom_desc, top_desc, conv_desc, filter_desc_,
+            CUDNN_CONVOLUTION_BWD_FILTER_NO_WORKSPACE, 0,
+            &algos.bwd_filter));
+        CUDNN_CHECK(cudnnGetConvolutionBackwardFilterWorkspaceSize(
+            handle_[0], bottom_desc, top_desc, conv_desc,
+            filter_desc_, algos.bwd_filter, &algos.bwd_filter_ws));
+        CUDNN_CHECK(cudnnGetConvolutionBackwardDataAlgorithm(handle_[0],
+            filter_desc_, top_desc, conv_desc, bottom_desc,
+            CUDNN_CONVOLUTION_BWD_DATA_NO_WORKSPACE, 0, &algos.bwd_data));
+        CUDNN_CHECK(cudnnGetConvolutionBackwardDataWorkspaceSize(
+            handle_[0], filter_desc_, top_desc, conv_desc,
+            bottom_desc, algos.bwd_data, &algos.bwd_data_ws));
+      } else {
+        cudnnConvolutionBwdFilterAlgoPerf_t bwd_filter_perf[kRequested];
+        if (cudnnFindConvolutionBackwardFilterAlgorithm(handle_[0],
+            bottom_desc, top_desc, conv_desc, filter_desc_,
+            kRequested, &returned, bwd_filter_perf) == CUDNN_STATUS_SUCCESS
+            && returned > 0
+            && bwd_filter_perf[0].status == CUDNN_STATUS_SUCCESS) {
+          algos.bwd_filter = bwd_filter_perf[0].algo;
+          algos.bwd_filter_ws = bwd_filter_perf[0].memory;
+        } else {
+          CUDNN_CHECK(cudnnGetConvolutionBackwardFilterAlgorithm(handle_[0],
+              bottom_desc, top_desc, conv_desc, filter_desc_,
+              CUDNN_CONVOLUTION_BWD_FILTER_SPECIFY_WORKSPACE_LIMIT,
+              workspace_limit_bytes, &algos.bwd_filter));
+          CUDNN_CHECK(cudnnGetConvolutionBackwardFilterWorkspaceSize(
+              handle_[0], bottom_desc, top_desc, conv_desc,
+              filter_desc_, algos.bwd_filter, &algos.bwd_filter_ws));
+        }
+        cudnnConvolutionBwdDataAlgoPerf_t bwd_data_perf[kRequested];
+        if (cudnnFindConvolutionBackwardDataAlgorithm(handle_[0],
+            filter_desc_, top_desc, conv_desc, bottom_desc,
+            kRequested, &returned, bwd_data_perf) == CUDNN_STATUS_SUCCESS
+            && returned > 0
+            && bwd_data_perf[0].status == CUDNN_STATUS_SUCCESS) {
+          algos.bwd_data = bwd_data_perf[0].algo;
+          algos.bwd_data_ws = bwd_data_perf[0].memory;
+        } else {
+          CUDNN_CHECK(cudnnGetConvolutionBackwardDataAlgorithm(handle_[0],
+              filter_desc_, top_desc, conv_desc, bottom_desc,
+              CUDNN_CONVOLUTION_BWD_DATA_SPECIFY_WORKSPACE_LIMIT,
+              workspace_limit_bytes, &algos.bwd_data));
+          CUDNN_CHECK(cudnnGetConvolutionBackwardDataWorkspaceSize(
+              handle_[0], filter_desc_, top_desc, conv_desc,
+              bottom_desc, algos.bwd_data, &algos.bwd_data_ws));
+        }
+      }
+      cudnn_algo_cache[key] = algos;
+    }
+  }
+  for (int i = 0; i < bottom.size(); i++) {
+    bucket->fwd_algo[i] = algos.fwd;
+    bucket->fwd_ws[i] = algos.fwd_ws;
+    bucket->bwd_filter_algo[i] = algos.bwd_filter;
+    bucket->bwd_filter_ws[i] = algos.bwd_filter_ws;
+    bucket->bwd_data_algo[i] = algos.bwd_data;
+    bucket->bwd_data_ws[i] = algos.bwd_data_ws;
   }
 
+#if CUDNN_VERSION_MIN(7, 0, 0)
+  // cudnnConvolutionBiasActivationForward only supports the implicit
+  // precomp GEMM algorithm with a ReLU activation; pin it here so the
+  // workspace below is sized for it. See Forward_gpu.
+  if (this->fused_relu_ && this->bias_term_) {
+    for (int i = 0; i < bottom.size(); i++) {
+      bucket->fwd_algo[i] = CUDNN_CONVOLUTION_FWD_ALGO_IMPLICIT_PRECOMP_GEMM;
+      CUDNN_CHECK(cudnnGetConvolutionForwardWorkspaceSize(handle_[0],
+          bucket->bottom_descs[i], filter_desc_, bucket->conv_descs[i],
+          bucket->top_descs[i], bucket->fwd_algo[i], &bucket->fwd_ws[i]));
+    }
+  }
+#endif
+
   // reduce over all workspace sizes to get a maximum to allocate / reallocate
   size_t total_workspace_fwd = 0;
   size_t total_workspace_bwd_data = 0;
@@ -175,53 +464,61 @@ void CuDNNConvolutionLayer<Dtype>::Reshape(
 
   for (size_t i = 0; i < bottom.size(); i++) {
     total_workspace_fwd        = std::max(total_workspace_fwd,
-                                     workspace_fwd_sizes_[i]);
+                                     bucket->fwd_ws[i]);
     total_workspace_bwd_data   = std::max(total_workspace_bwd_data,
-                                     workspace_bwd_data_sizes_[i]);
+                                     bucket->bwd_data_ws[i]);
     total_workspace_bwd_filter = std::max(total_workspace_bwd_filter,
-                                     workspace_bwd_filter_sizes_[i]);
+                                     bucket->bwd_filter_ws[i]);
   }
-  // get max over all operations
+  // get max over all operations; the per-group/stream total is taken at
+  // install time
   size_t max_workspace = std::max(total_workspace_fwd,
                              total_workspace_bwd_data);
-  max_workspace = std::max(max_workspace, total_workspace_bwd_filter);
+  bucket->max_workspace = std::max(max_workspace, total_workspace_bwd_filter);
+}
+
+template <typename Dtype>
+void CuDNNConvolutionLayer<Dtype>::InstallBucket(const ShapeBucket& bucket) {
+  const int num_bottoms = static_cast<int>(bucket.bottom_descs.size());
+  for (int i = 0; i < num_bottoms; i++) {
+    bottom_descs_[i] = bucket.bottom_descs[i];
+    top_descs_[i] = bucket.top_descs[i];
+    conv_descs_[i] = bucket.conv_descs[i];
+    fwd_algo_[i] = bucket.fwd_algo[i];
+    bwd_filter_algo_[i] = bucket.bwd_filter_algo[i];
+    bwd_data_algo_[i] = bucket.bwd_data_algo[i];
+    workspace_fwd_sizes_[i] = bucket.fwd_ws[i];
+    workspace_bwd_filter_sizes_[i] = bucket.bwd_filter_ws[i];
+    workspace_bwd_data_sizes_[i] = bucket.bwd_data_ws[i];
+  }
   // ensure all groups have enough workspace
+  size_t max_workspace = bucket.max_workspace;
   size_t total_max_workspace = max_workspace *
                                (this->group_ * CUDNN_STREAMS_PER_GROUP);
 
-  // this is the total amount of storage needed over all groups + streams
-  if (total_max_workspace > workspaceSizeInBytes) {
-    DLOG(INFO) << "Reallocating workspace storage: " << total_max_workspace;
-    workspaceSizeInBytes = total_max_workspace;
-
-    // free the existing workspace and allocate a new (larger) one
-    cudaFree(this->workspaceData);
-
-    cudaError_t err = cudaMalloc(&(this->workspaceData), workspaceSizeInBytes);
-    if (err != cudaSuccess) {
-      // force zero memory path
-      for (int i = 0; i < bottom.size(); i++) {
-        workspace_fwd_sizes_[i] = 0;
-        workspace_bwd_filter_sizes_[i] = 0;
-        workspace_bwd_data_sizes_[i] = 0;
-        fwd_algo_[i] = CUDNN_CONVOLUTION_FWD_ALGO_IMPLICIT_GEMM;
-        bwd_filter_algo_[i] = CUDNN_CONVOLUTION_BWD_FILTER_ALGO_0;
-        bwd_data_algo_[i] = CUDNN_CONVOLUTION_BWD_DATA_ALGO_0;
-      }
-
-      // NULL out all workspace pointers
-      for (int g = 0; g < (this->group_ * CUDNN_STREAMS_PER_GROUP); g++) {
-        workspace[g] = NULL;
-      }
-      // NULL out underlying data
-      workspaceData = NULL;
-      workspaceSizeInBytes = 0;
-    }
-
-    // if we succeed in the allocation, set pointer aliases for workspaces
-    for (int g = 0; g < (this->group_ * CUDNN_STREAMS_PER_GROUP); g++) {
-      workspace[g] = reinterpret_cast<char *>(workspaceData) + g*max_workspace;
+  // this is the total amount of storage needed over all groups + streams,
+  // taken from the device-wide pool shared with the other layers
+  workspaceSizeInBytes = total_max_workspace;
+  workspaceData =
+      cudnn_workspace_reserve(workspace_device_, total_max_workspace);
+  if (workspaceData == NULL && total_max_workspace > 0) {
+    // force zero memory path; only the active arrays are downgraded, so
+    // the bucket retries its full request when installed again
+    for (int i = 0; i < num_bottoms; i++) {
+      workspace_fwd_sizes_[i] = 0;
+      workspace_bwd_filter_sizes_[i] = 0;
+      workspace_bwd_data_sizes_[i] = 0;
+      fwd_algo_[i] = CUDNN_CONVOLUTION_FWD_ALGO_IMPLICIT_GEMM;
+      bwd_filter_algo_[i] = CUDNN_CONVOLUTION_BWD_FILTER_ALGO_0;
+      bwd_data_algo_[i] = CUDNN_CONVOLUTION_BWD_DATA_ALGO_0;
     }
+    workspaceSizeInBytes = 0;
+    max_workspace = 0;
+  }
+  // set pointer aliases for the per-group/stream slices
+  for (int g = 0; g < (this->group_ * CUDNN_STREAMS_PER_GROUP); g++) {
+    workspace[g] = workspaceData == NULL ? NULL :
+        reinterpret_cast<char *>(workspaceData) + g * max_workspace;
   }
 
   // Tensor descriptor for bias.
@@ -231,15 +528,29 @@ void CuDNNConvolutionLayer<Dtype>::Reshape(
   }
 }
 
+template <typename Dtype>
+void CuDNNConvolutionLayer<Dtype>::DestroyBucket(ShapeBucket* bucket) {
+  for (size_t i = 0; i < bucket->bottom_descs.size(); i++) {
+    cudnnDestroyTensorDescriptor(bucket->bottom_descs[i]);
+    cudnnDestroyTensorDescriptor(bucket->top_descs[i]);
+    cudnnDestroyConvolutionDescriptor(bucket->conv_descs[i]);
+  }
+}
+
 template <typename Dtype>
 CuDNNConvolutionLayer<Dtype>::~CuDNNConvolutionLayer() {
   // Check that handles have been setup before destroying.
   if (!handles_setup_) { return; }
 
-  for (int i = 0; i < bottom_descs_.size(); i++) {
-    cudnnDestroyTensorDescriptor(bottom_descs_[i]);
-    cudnnDestroyTensorDescriptor(top_descs_[i]);
-    cudnnDestroyConvolutionDescriptor(conv_descs_[i]);
+#if CUDNN_VERSION_MIN(5, 0, 0)
+  if (this->fused_relu_) {
+    cudnnDestroyActivationDescriptor(activ_desc_);
+  }
+#endif
+
+  for (typename map<string, ShapeBucket>::iterator it =
+      shape_buckets_.begin(); it != shape_buckets_.end(); ++it) {
+    DestroyBucket(&it->second);
   }
   if (this->bias_term_) {
     cudnnDestroyTensorDescriptor(bias_desc_);
@@ -251,7 +562,7 @@ CuDNNConvolutionLayer<Dtype>::~CuDNNConvolutionLayer() {
     cudnnDestroy(handle_[g]);
   }
 
-  cudaFree(workspaceData);
+  cudnn_workspace_release(workspace_device_);
   delete [] stream_;
   delete [] handle_;
   delete [] fwd_algo_;
@@ -17,6 +17,26 @@ void CuDNNConvolutionLayer<Dtype>::Forward_gpu(
 
     // Forward through cuDNN in parallel over groups.
     for (int g = 0; g < this->group_; g++) {
+#if CUDNN_VERSION_MIN(7, 0, 0)
+      if (this->fused_relu_ && this->bias_term_ && fwd_algo_[i] ==
+          CUDNN_CONVOLUTION_FWD_ALGO_IMPLICIT_PRECOMP_GEMM) {
+        // Bias-add and ReLU run inside the convolution epilogue, saving
+        // two full passes over the output tensor.
+        const Dtype* bias_data = this->blobs_[1]->gpu_data();
+        CUDNN_CHECK(cudnnConvolutionBiasActivationForward(handle_[g],
+              cudnn::dataType<Dtype>::one,
+              bottom_descs_[i], bottom_data + bottom_offset_ * g,
+              filter_desc_, weight + this->weight_offset_ * g,
+              conv_descs_[i],
+              fwd_algo_[i], workspace[g], workspace_fwd_sizes_[i],
+              cudnn::dataType<Dtype>::zero,
+              top_descs_[i], top_data + top_offset_ * g,
+              bias_desc_, bias_data + bias_offset_ * g,
+              activ_desc_,
+              top_descs_[i], top_data + top_offset_ * g));
+        continue;
+      }
+#endif
       // Filters.
       CUDNN_CHECK(cudnnConvolutionForward(handle_[g],
             cudnn::dataType<Dtype>::one,
@@ -42,6 +62,27 @@ void CuDNNConvolutionLayer<Dtype>::Forward_gpu(
               bias_desc_, bias_data + bias_offset_ * g,
               cudnn::dataType<Dtype>::one,
               top_descs_[i], top_data + top_offset_ * g));
+#endif
+      }
+
+      if (this->fused_relu_) {
+        // The fused ReLU layer was dropped from the forward schedule, so
+        // configurations the fused call above does not cover (no bias,
+        // zero-workspace fallback algorithms) rectify in place here.
+#if CUDNN_VERSION_MIN(5, 0, 0)
+        CUDNN_CHECK(cudnnActivationForward(handle_[g],
+              activ_desc_,
+              cudnn::dataType<Dtype>::one,
+              top_descs_[i], top_data + top_offset_ * g,
+              cudnn::dataType<Dtype>::zero,
+              top_descs_[i], top_data + top_offset_ * g));
+#else
+        CUDNN_CHECK(cudnnActivationForward(handle_[g],
+              CUDNN_ACTIVATION_RELU,
+              cudnn::dataType<Dtype>::one,
+              top_descs_[i], top_data + top_offset_ * g,
+              cudnn::dataType<Dtype>::zero,
+              top_descs_[i], top_data + top_offset_ * g));
 #endif
       }
     }
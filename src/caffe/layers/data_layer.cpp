@@ -3,6 +3,7 @@
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <cstring>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
@@ -14,7 +15,9 @@ namespace caffe {
 template <typename Dtype>
 DataLayer<Dtype>::DataLayer(const LayerParameter& param)
   : BasePrefetchingDataLayer<Dtype>(param),
-    reader_(param) {
+    reader_(param),
+    use_gpu_transform_(param.transform_param().engine() ==
+        TransformationParameter_Engine_GPU) {
 }
 
 template <typename Dtype>
@@ -29,14 +32,25 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Read a data point, and use it to initialize the top blob.
   Datum& datum = *(reader_.full().peek());
 
+  if (use_gpu_transform_) {
+#ifdef CPU_ONLY
+    LOG(FATAL) << "TransformationParameter engine GPU requires CUDA; "
+        << "compile without CPU_ONLY.";
+#endif
+    CHECK(!datum.encoded()) << "The GPU transform engine requires "
+        << "unencoded uint8 datums";
+    CHECK_GT(datum.data().size(), 0) << "The GPU transform engine requires "
+        << "unencoded uint8 datums";
+  }
+
   // Use data_transformer to infer the expected blob shape from datum.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
   this->transformed_data_.Reshape(top_shape);
   // Reshape top[0] and prefetch_data according to the batch_size.
   top_shape[0] = batch_size;
   top[0]->Reshape(top_shape);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].data_.Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
   }
   LOG(INFO) << "output data size: " << top[0]->num() << ","
       << top[0]->channels() << "," << top[0]->height() << ","
@@ -45,12 +59,19 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   if (this->output_labels_) {
     vector<int> label_shape(1, batch_size);
     top[1]->Reshape(label_shape);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].label_.Reshape(label_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(label_shape);
     }
   }
 }
 
+template <typename Dtype>
+void DataLayer<Dtype>::prefetch_stats(PrefetchStats* stats) const {
+  BasePrefetchingDataLayer<Dtype>::prefetch_stats(stats);
+  stats->reader_free_size = reader_.free().size();
+  stats->reader_full_size = reader_.full().size();
+}
+
 // This function is called on prefetch thread
 template<typename Dtype>
 void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
@@ -73,37 +94,91 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   top_shape[0] = batch_size;
   batch->data_.Reshape(top_shape);
 
-  Dtype* top_data = batch->data_.mutable_cpu_data();
+  unsigned char* raw_data = NULL;
+  int* raw_params = NULL;
+  size_t datum_size = 0;
+  if (use_gpu_transform_) {
+    // Stage the raw uint8 pixels and per-item transform decisions; the
+    // pixel work happens on the device in Forward_gpu.
+    datum_size = static_cast<size_t>(top_shape[1]) * datum.height()
+        * datum.width();
+    vector<int> raw_shape(4);
+    raw_shape[0] = batch_size;
+    raw_shape[1] = top_shape[1];
+    raw_shape[2] = datum.height();
+    raw_shape[3] = datum.width();
+    batch->raw_data_.Reshape(raw_shape);
+    vector<int> params_shape(2);
+    params_shape[0] = batch_size;
+    params_shape[1] = 3;
+    batch->raw_params_.Reshape(params_shape);
+    raw_data = batch->raw_data_.mutable_cpu_data();
+    raw_params = batch->raw_params_.mutable_cpu_data();
+  }
   Dtype* top_label = NULL;  // suppress warnings about uninitialized variables
 
   if (this->output_labels_) {
     top_label = batch->label_.mutable_cpu_data();
   }
-  for (int item_id = 0; item_id < batch_size; ++item_id) {
-    timer.Start();
-    // get a datum
-    Datum& datum = *(reader_.full().pop("Waiting for data"));
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply data transformations (mirror, scale, crop...)
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
-    // Copy label.
-    if (this->output_labels_) {
-      top_label[item_id] = datum.label();
+  if (use_gpu_transform_) {
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      timer.Start();
+      // get a datum
+      Datum& datum = *(reader_.full().pop("Waiting for data"));
+      read_time += timer.MicroSeconds();
+      timer.Start();
+      CHECK_EQ(datum.data().size(), datum_size)
+          << "The GPU transform engine requires uniformly sized datums";
+      memcpy(raw_data + item_id * datum_size,  // NOLINT(caffe/alt_fn)
+          datum.data().data(), datum_size);
+      bool do_mirror;
+      int h_off, w_off;
+      this->data_transformer_->SampleTransformParams(datum.height(),
+          datum.width(), &h_off, &w_off, &do_mirror);
+      raw_params[item_id * 3] = h_off;
+      raw_params[item_id * 3 + 1] = w_off;
+      raw_params[item_id * 3 + 2] = do_mirror;
+      // Copy label.
+      if (this->output_labels_) {
+        top_label[item_id] = datum.label();
+      }
+      trans_time += timer.MicroSeconds();
+
+      reader_.free().push(const_cast<Datum*>(&datum));
     }
+  } else {
+    // Pop the whole batch, then transform it in one call: shapes are
+    // validated and random decisions drawn once, and the pixel loops run
+    // back to back (across transform threads when configured).
+    vector<Datum*> datums(batch_size);
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      timer.Start();
+      datums[item_id] = reader_.full().pop("Waiting for data");
+      read_time += timer.MicroSeconds();
+      if (this->output_labels_) {
+        top_label[item_id] = datums[item_id]->label();
+      }
+    }
+    timer.Start();
+    this->data_transformer_->TransformBatch(datums, &batch->data_);
     trans_time += timer.MicroSeconds();
-
-    reader_.free().push(const_cast<Datum*>(&datum));
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      reader_.free().push(datums[item_id]);
+    }
   }
   timer.Stop();
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  this->read_us_ += read_time;
+  this->transform_us_ += trans_time;
 }
 
+#ifdef CPU_ONLY
+STUB_GPU_FORWARD(DataLayer, Forward);
+#endif
+
 INSTANTIATE_CLASS(DataLayer);
 REGISTER_LAYER_CLASS(Data);
 
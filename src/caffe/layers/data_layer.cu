@@ -0,0 +1,49 @@
+#include <vector>
+
+#include "caffe/layers/data_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  if (!use_gpu_transform_) {
+    BasePrefetchingDataLayer<Dtype>::Forward_gpu(bottom, top);
+    return;
+  }
+  CPUTimer wait_timer;
+  wait_timer.Start();
+  Batch<Dtype>* batch =
+      this->prefetch_full_.pop("Data layer prefetch queue empty");
+  wait_timer.Stop();
+  this->consumer_wait_us_ += wait_timer.MicroSeconds();
+  ++this->batches_consumed_;
+  // Order the raw uint8 copy before the transform kernel.
+  if (batch->copy_done_ != NULL) {
+    CUDA_CHECK(cudaStreamWaitEvent(cudaStreamDefault, batch->copy_done_, 0));
+  }
+  // Reshape to loaded data; data_ carries the shape, its float memory is
+  // never populated in this mode.
+  top[0]->ReshapeLike(batch->data_);
+  this->data_transformer_->TransformGPU(top[0]->num(), top[0]->channels(),
+      batch->raw_data_.height(), batch->raw_data_.width(),
+      batch->raw_data_.gpu_data(), batch->raw_params_.gpu_data(),
+      top[0]->mutable_gpu_data());
+  if (this->output_labels_) {
+    // Reshape to loaded labels.
+    top[1]->ReshapeLike(batch->label_);
+    // Copy the labels.
+    caffe_copy(batch->label_.count(), batch->label_.gpu_data(),
+        top[1]->mutable_gpu_data());
+  }
+  // Ensure the copy is synchronous wrt the host, so that the next batch
+  // isn't copied in meanwhile.
+  CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+  this->prefetch_free_.push(batch);
+}
+
+INSTANTIATE_LAYER_GPU_FORWARD(DataLayer);
+
+}  // namespace caffe
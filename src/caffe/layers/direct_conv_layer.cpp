@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  use_direct_ = !this->force_nd_im2col_ && this->num_spatial_axes_ == 2
+      && kernel[0] == 3 && kernel[1] == 3
+      && stride[0] == 1 && stride[1] == 1
+      && dilation[0] == 1 && dilation[1] == 1;
+}
+
+// Accumulates one 3x3 tap over a contiguous output row. Shift is the
+// column offset into the input row; the bounds clip the zero-padded
+// borders so the loop body stays branch-free.
+template <typename Dtype>
+inline void DirectConvTap(const Dtype* in_row, const Dtype weight,
+    const int shift, const int width, const int width_out, Dtype* out_row) {
+  const int ow_start = std::max(0, -shift);
+  const int ow_end = std::min(width_out, width - shift);
+  const Dtype* in_ptr = in_row + ow_start + shift;
+  Dtype* out_ptr = out_row + ow_start;
+  for (int ow = ow_start; ow < ow_end; ++ow) {
+    *out_ptr++ += weight * *in_ptr++;
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_direct_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int height_out = this->output_shape_[0];
+  const int width_out = this->output_shape_[1];
+  const int in_channels = this->conv_in_channels_ / this->group_;
+  const int out_channels = this->conv_out_channels_ / this->group_;
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      for (int g = 0; g < this->group_; ++g) {
+        const Dtype* in_group = bottom_data + n * this->bottom_dim_
+            + g * in_channels * height * width;
+        Dtype* out_group = top_data + n * this->top_dim_
+            + g * out_channels * height_out * width_out;
+        const Dtype* weight_group = weight + this->weight_offset_ * g;
+        // One output plane at a time: it accumulates in cache while the
+        // input planes stream past once per output channel.
+        for (int oc = 0; oc < out_channels; ++oc) {
+          Dtype* out = out_group + oc * height_out * width_out;
+          caffe_set(height_out * width_out, Dtype(0), out);
+          for (int ic = 0; ic < in_channels; ++ic) {
+            const Dtype* in = in_group + ic * height * width;
+            const Dtype* wk = weight_group + (oc * in_channels + ic) * 9;
+            for (int oh = 0; oh < height_out; ++oh) {
+              Dtype* out_row = out + oh * width_out;
+              for (int kh = 0; kh < 3; ++kh) {
+                const int ih = oh + kh - pad_h;
+                if (ih < 0 || ih >= height) { continue; }
+                const Dtype* in_row = in + ih * width;
+                for (int kw = 0; kw < 3; ++kw) {
+                  DirectConvTap(in_row, wk[kh * 3 + kw], kw - pad_w,
+                      width, width_out, out_row);
+                }
+              }
+            }
+          }
+        }
+      }
+      this->forward_cpu_epilogue(top_data + n * this->top_dim_,
+          this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(DirectConvolutionLayer);
+
+}  // namespace caffe
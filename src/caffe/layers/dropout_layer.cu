@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/dropout_layer.hpp"
+#include "caffe/util/dropout_mask_pool.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -21,13 +22,13 @@ void DropoutLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_gpu_data();
   const int count = bottom[0]->count();
   if (this->phase_ == TRAIN) {
-    unsigned int* mask =
-        static_cast<unsigned int*>(rand_vec_.mutable_gpu_data());
-    caffe_gpu_rng_uniform(count, mask);
-    // set thresholds
+    // Masks for every dropout layer of the iteration come from one
+    // batched generation pipelined an iteration ahead, instead of a
+    // per-layer curand launch into rand_vec_.
+    gpu_mask_ = DropoutMaskPool::Acquire(count);
     // NOLINT_NEXT_LINE(whitespace/operators)
     DropoutForward<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
-        count, bottom_data, mask, uint_thres_, scale_, top_data);
+        count, bottom_data, gpu_mask_, uint_thres_, scale_, top_data);
     CUDA_POST_KERNEL_CHECK;
   } else {
     caffe_copy(count, bottom_data, top_data);
@@ -51,8 +52,7 @@ void DropoutLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->gpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
     if (this->phase_ == TRAIN) {
-      const unsigned int* mask =
-          static_cast<const unsigned int*>(rand_vec_.gpu_data());
+      const unsigned int* mask = gpu_mask_;
       const int count = bottom[0]->count();
       // NOLINT_NEXT_LINE(whitespace/operators)
       DropoutBackward<Dtype><<<CAFFE_GET_BLOCKS(count),
@@ -33,6 +33,12 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   for (int i = 1; i < bottom.size(); ++i) {
     CHECK(bottom[i]->shape() == bottom[0]->shape());
   }
+  // PROD and MAX read bottom[0] data during Forward/Backward after top has
+  // been written, so only SUM supports in-place computation.
+  CHECK(bottom[0] != top[0]
+      || this->layer_param_.eltwise_param().operation()
+      == EltwiseParameter_EltwiseOp_SUM)
+      << "Eltwise layer only supports in-place computation for SUM.";
   top[0]->ReshapeLike(*bottom[0]);
   // If max operation, we will initialize the vector index part.
   if (this->layer_param_.eltwise_param().operation() ==
@@ -57,9 +63,18 @@ void EltwiseLayer<Dtype>::Forward_cpu(
     }
     break;
   case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
+    // Initialize top from bottom[0] instead of zero-filling; saves one full
+    // pass, and is a no-op for in-place computation with unit coefficient.
+    if (bottom[0] == top[0]) {
+      if (coeffs_[0] != Dtype(1)) {
+        caffe_scal(count, coeffs_[0], top_data);
+      }
+    } else if (coeffs_[0] == Dtype(1)) {
+      caffe_copy(count, bottom[0]->cpu_data(), top_data);
+    } else {
+      caffe_cpu_scale(count, coeffs_[0], bottom[0]->cpu_data(), top_data);
+    }
+    for (int i = 1; i < bottom.size(); ++i) {
       caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
     }
     break;
@@ -129,6 +144,9 @@ void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       case EltwiseParameter_EltwiseOp_SUM:
         if (coeffs_[i] == Dtype(1)) {
           caffe_copy(count, top_diff, bottom_diff);
+        } else if (i == 0 && bottom[0] == top[0]) {
+          // In-place: bottom[0]'s diff aliases top's diff, which the other
+          // bottoms still need to read; scale it after the loop instead.
         } else {
           caffe_cpu_scale(count, coeffs_[i], top_diff, bottom_diff);
         }
@@ -148,6 +166,10 @@ void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       }
     }
   }
+  if (op_ == EltwiseParameter_EltwiseOp_SUM && bottom[0] == top[0] &&
+      propagate_down[0] && coeffs_[0] != Dtype(1)) {
+    caffe_scal(count, coeffs_[0], bottom[0]->mutable_cpu_diff());
+  }
 }
 
 #ifdef CPU_ONLY
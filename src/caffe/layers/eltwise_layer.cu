@@ -45,9 +45,18 @@ void EltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     }
     break;
   case EltwiseParameter_EltwiseOp_SUM:
-    caffe_gpu_set(count, Dtype(0.), top_data);
-    // TODO(shelhamer) does cuBLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
+    // Initialize top from bottom[0] instead of zero-filling; saves one full
+    // pass, and is a no-op for in-place computation with unit coefficient.
+    if (bottom[0] == top[0]) {
+      if (coeffs_[0] != Dtype(1.)) {
+        caffe_gpu_scal(count, coeffs_[0], top_data);
+      }
+    } else if (coeffs_[0] == Dtype(1.)) {
+      caffe_copy(count, bottom[0]->gpu_data(), top_data);
+    } else {
+      caffe_gpu_scale(count, coeffs_[0], bottom[0]->gpu_data(), top_data);
+    }
+    for (int i = 1; i < bottom.size(); ++i) {
       caffe_gpu_axpy(count, coeffs_[i], bottom[i]->gpu_data(), top_data);
     }
     break;
@@ -112,6 +121,9 @@ void EltwiseLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
       case EltwiseParameter_EltwiseOp_SUM:
         if (coeffs_[i] == Dtype(1.)) {
           caffe_copy(count, top_diff, bottom_diff);
+        } else if (i == 0 && bottom[0] == top[0]) {
+          // In-place: bottom[0]'s diff aliases top's diff, which the other
+          // bottoms still need to read; scale it after the loop instead.
         } else {
           caffe_gpu_scale(count, coeffs_[i], top_diff, bottom_diff);
         }
@@ -127,6 +139,10 @@ void EltwiseLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
       }
     }
   }
+  if (op_ == EltwiseParameter_EltwiseOp_SUM && bottom[0] == top[0] &&
+      propagate_down[0] && coeffs_[0] != Dtype(1.)) {
+    caffe_gpu_scal(count, coeffs_[0], bottom[0]->mutable_gpu_diff());
+  }
 }
 
 INSTANTIATE_LAYER_GPU_FUNCS(EltwiseLayer);
@@ -91,6 +91,7 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* bottom_data = bottom[0]->cpu_data();
     // Gradient with respect to weight
     Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+    vector<int> touched_rows(M_);
     int index;
     for (int n = 0; n < M_; ++n) {
       index = static_cast<int>(bottom_data[n]);
@@ -99,7 +100,11 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      touched_rows[n] = index;
     }
+    // A batch touches a tiny fraction of a large vocabulary; annotate the
+    // rows so the solver and diff clearing skip the untouched remainder.
+    this->blobs_[0]->accumulate_sparse_diff_rows(touched_rows);
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
     const Dtype* top_diff = top[0]->cpu_diff();
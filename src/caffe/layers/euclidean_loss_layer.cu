@@ -9,14 +9,16 @@ template <typename Dtype>
 void EuclideanLossLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   int count = bottom[0]->count();
-  caffe_gpu_sub(
+  // One fused kernel writes the diff (kept for backward) and reduces its
+  // sum of squares into a device scalar; the only sync is the readback.
+  caffe_gpu_set(1, Dtype(0), sumsq_.mutable_gpu_data());
+  caffe_gpu_sub_sumsq_acc(
       count,
       bottom[0]->gpu_data(),
       bottom[1]->gpu_data(),
-      diff_.mutable_gpu_data());
-  Dtype dot;
-  caffe_gpu_dot(count, diff_.gpu_data(), diff_.gpu_data(), &dot);
-  Dtype loss = dot / bottom[0]->num() / Dtype(2);
+      diff_.mutable_gpu_data(),
+      sumsq_.mutable_gpu_data());
+  Dtype loss = sumsq_.cpu_data()[0] / bottom[0]->num() / Dtype(2);
   top[0]->mutable_cpu_data()[0] = loss;
 }
 
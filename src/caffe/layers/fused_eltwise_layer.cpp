@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/layers/fused_eltwise_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+bool FusedEltwiseLayer<Dtype>::IsFusableStage(const LayerParameter& param,
+    bool head) {
+  if (param.top_size() != 1) { return false; }
+  const string& type = param.type();
+  if (head && type == "Eltwise") { return param.bottom_size() >= 2; }
+  if (param.bottom_size() != 1) { return false; }
+  return type == "ReLU" || type == "Power" || type == "TanH" ||
+      type == "Sigmoid" || type == "AbsVal";
+}
+
+template <typename Dtype>
+void FusedEltwiseLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const FusedEltwiseParameter& fused_param =
+      this->layer_param_.fused_eltwise_param();
+  CHECK_GT(fused_param.stage_size(), 0)
+      << "FusedEltwise needs at least one stage.";
+  int first_unary = 0;
+  if (fused_param.stage(0).type() == "Eltwise") {
+    const EltwiseParameter& eltwise_param =
+        fused_param.stage(0).eltwise_param();
+    head_op_ = eltwise_param.operation();
+    CHECK(eltwise_param.coeff_size() == 0 ||
+          eltwise_param.coeff_size() == bottom.size())
+        << "Eltwise head takes one coefficient per bottom blob.";
+    CHECK(head_op_ == EltwiseParameter_EltwiseOp_SUM ||
+          eltwise_param.coeff_size() == 0)
+        << "Eltwise head only takes coefficients for summation.";
+    coeffs_.assign(bottom.size(), Dtype(1));
+    for (int i = 0; i < eltwise_param.coeff_size(); ++i) {
+      coeffs_[i] = eltwise_param.coeff(i);
+    }
+    first_unary = 1;
+  } else {
+    head_op_ = -1;
+    CHECK_EQ(bottom.size(), 1)
+        << "A fused chain without an Eltwise head is unary.";
+  }
+  unary_ops_.clear();
+  unary_params_.clear();
+  for (int i = first_unary; i < fused_param.stage_size(); ++i) {
+    const LayerParameter& stage = fused_param.stage(i);
+    CHECK(IsFusableStage(stage, false))
+        << "Unsupported fused stage " << stage.name()
+        << " of type " << stage.type();
+    const string& type = stage.type();
+    Dtype a = 0, b = 0, c = 0;
+    int op = -1;
+    if (type == "ReLU") {
+      op = RELU;
+      a = stage.relu_param().negative_slope();
+    } else if (type == "Power") {
+      op = POWER;
+      a = stage.power_param().power();
+      b = stage.power_param().scale();
+      c = stage.power_param().shift();
+    } else if (type == "TanH") {
+      op = TANH;
+    } else if (type == "Sigmoid") {
+      op = SIGMOID;
+    } else {
+      op = ABSVAL;
+    }
+    unary_ops_.push_back(op);
+    unary_params_.push_back(a);
+    unary_params_.push_back(b);
+    unary_params_.push_back(c);
+  }
+}
+
+template <typename Dtype>
+void FusedEltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  for (int i = 1; i < bottom.size(); ++i) {
+    CHECK(bottom[0]->shape() == bottom[i]->shape());
+  }
+  top[0]->ReshapeLike(*bottom[0]);
+}
+
+template <typename Dtype>
+void FusedEltwiseLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int count = top[0]->count();
+  const int num_bottoms = bottom.size();
+  const int num_stages = unary_ops_.size();
+  vector<const Dtype*> bottom_data(num_bottoms);
+  for (int i = 0; i < num_bottoms; ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+  }
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  for (int index = 0; index < count; ++index) {
+    Dtype value;
+    switch (head_op_) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      value = bottom_data[0][index];
+      for (int i = 1; i < num_bottoms; ++i) {
+        value *= bottom_data[i][index];
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      value = 0;
+      for (int i = 0; i < num_bottoms; ++i) {
+        value += coeffs_[i] * bottom_data[i][index];
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX:
+      value = bottom_data[0][index];
+      for (int i = 1; i < num_bottoms; ++i) {
+        value = std::max(value, bottom_data[i][index]);
+      }
+      break;
+    default:  // unary chain; single bottom
+      value = bottom_data[0][index];
+      break;
+    }
+    for (int s = 0; s < num_stages; ++s) {
+      const Dtype a = unary_params_[3 * s];
+      switch (unary_ops_[s]) {
+      case RELU:
+        value = std::max(value, Dtype(0)) + a * std::min(value, Dtype(0));
+        break;
+      case POWER:
+        value = unary_params_[3 * s + 2] + unary_params_[3 * s + 1] * value;
+        if (a != Dtype(1)) { value = pow(value, a); }
+        break;
+      case TANH:
+        value = tanh(value);
+        break;
+      case SIGMOID:
+        value = 1. / (1. + exp(-value));
+        break;
+      case ABSVAL:
+        value = fabs(value);
+        break;
+      }
+    }
+    top_data[index] = value;
+  }
+}
+
+#ifdef CPU_ONLY
+STUB_GPU_FORWARD(FusedEltwiseLayer, Forward);
+#endif
+
+INSTANTIATE_CLASS(FusedEltwiseLayer);
+REGISTER_LAYER_CLASS(FusedEltwise);
+
+}  // namespace caffe
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/fused_eltwise_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+__global__ void FusedEltwiseForward(const int n, const int num_bottoms,
+    const Dtype* const* bottoms, const int head_op, const Dtype* coeffs,
+    const int num_stages, const int* ops, const Dtype* params, Dtype* out) {
+  CUDA_KERNEL_LOOP(index, n) {
+    Dtype value;
+    switch (head_op) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      value = bottoms[0][index];
+      for (int i = 1; i < num_bottoms; ++i) {
+        value *= bottoms[i][index];
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      value = 0;
+      for (int i = 0; i < num_bottoms; ++i) {
+        value += coeffs[i] * bottoms[i][index];
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX:
+      value = bottoms[0][index];
+      for (int i = 1; i < num_bottoms; ++i) {
+        value = max(value, bottoms[i][index]);
+      }
+      break;
+    default:  // unary chain; single bottom
+      value = bottoms[0][index];
+      break;
+    }
+    for (int s = 0; s < num_stages; ++s) {
+      const Dtype a = params[3 * s];
+      switch (ops[s]) {
+      case FusedEltwiseLayer<Dtype>::RELU:
+        value = max(value, Dtype(0)) + a * min(value, Dtype(0));
+        break;
+      case FusedEltwiseLayer<Dtype>::POWER:
+        value = params[3 * s + 2] + params[3 * s + 1] * value;
+        if (a != Dtype(1)) { value = pow(value, a); }
+        break;
+      case FusedEltwiseLayer<Dtype>::TANH:
+        value = tanh(value);
+        break;
+      case FusedEltwiseLayer<Dtype>::SIGMOID:
+        value = Dtype(1) / (Dtype(1) + exp(-value));
+        break;
+      case FusedEltwiseLayer<Dtype>::ABSVAL:
+        value = abs(value);
+        break;
+      }
+    }
+    out[index] = value;
+  }
+}
+
+template <typename Dtype>
+void FusedEltwiseLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int count = top[0]->count();
+  const int num_bottoms = bottom.size();
+  const int num_stages = unary_ops_.size();
+  // Mirror the pipeline description and the bottom data pointers onto
+  // the device. The pipeline is static after LayerSetUp; the pointers
+  // can change between iterations, so they are refreshed every call.
+  if (!gpu_ops_ && num_stages > 0) {
+    gpu_ops_.reset(new SyncedMemory(num_stages * sizeof(int)));
+    caffe_copy(num_stages, &unary_ops_[0],
+        static_cast<int*>(gpu_ops_->mutable_cpu_data()));
+    gpu_params_.reset(new SyncedMemory(3 * num_stages * sizeof(Dtype)));
+    caffe_copy(3 * num_stages, &unary_params_[0],
+        static_cast<Dtype*>(gpu_params_->mutable_cpu_data()));
+  }
+  if (!gpu_coeffs_ && head_op_ == EltwiseParameter_EltwiseOp_SUM) {
+    gpu_coeffs_.reset(new SyncedMemory(num_bottoms * sizeof(Dtype)));
+    caffe_copy(num_bottoms, &coeffs_[0],
+        static_cast<Dtype*>(gpu_coeffs_->mutable_cpu_data()));
+  }
+  if (!gpu_bottoms_) {
+    gpu_bottoms_.reset(new SyncedMemory(num_bottoms * sizeof(const Dtype*)));
+  }
+  const Dtype** bottom_ptrs =
+      static_cast<const Dtype**>(gpu_bottoms_->mutable_cpu_data());
+  for (int i = 0; i < num_bottoms; ++i) {
+    bottom_ptrs[i] = bottom[i]->gpu_data();
+  }
+  const int* ops = num_stages > 0 ?
+      static_cast<const int*>(gpu_ops_->gpu_data()) : NULL;
+  const Dtype* params = num_stages > 0 ?
+      static_cast<const Dtype*>(gpu_params_->gpu_data()) : NULL;
+  const Dtype* coeffs = gpu_coeffs_ ?
+      static_cast<const Dtype*>(gpu_coeffs_->gpu_data()) : NULL;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  FusedEltwiseForward<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count, num_bottoms,
+      static_cast<const Dtype* const*>(gpu_bottoms_->gpu_data()), head_op_,
+      coeffs, num_stages, ops, params, top[0]->mutable_gpu_data());
+  CUDA_POST_KERNEL_CHECK;
+}
+
+INSTANTIATE_LAYER_GPU_FORWARD(FusedEltwiseLayer);
+
+}  // namespace caffe
@@ -6,10 +6,14 @@ TODO:
   :: don't forget to update hdf5_daa_layer.cu accordingly
 - add ability to shuffle filenames if flag is set
 */
+#include <algorithm>
+#include <deque>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
 #include "hdf5.h"
 #include "hdf5_hl.h"
 #include "stdint.h"
@@ -19,6 +23,120 @@ TODO:
 
 namespace caffe {
 
+// Streams row windows of the HDF5 files on its own thread, at most two
+// in flight, so the consumer never waits on a whole-file load and host
+// memory stays bounded regardless of file size. Each chunk carries its
+// own within-window permutation, already shuffled if requested.
+template <typename Dtype>
+class HDF5DataLayer<Dtype>::Stream {
+ public:
+  struct Chunk {
+    vector<shared_ptr<Blob<Dtype> > > blobs;
+    vector<unsigned int> permutation;
+  };
+
+  Stream(const LayerParameter& param,
+         const vector<std::string>& filenames,
+         const vector<unsigned int>& file_permutation)
+      : param_(param), filenames_(filenames),
+        file_permutation_(file_permutation), stop_(false) {
+    thread_.reset(new boost::thread(boost::bind(&Stream::Run, this)));
+  }
+  ~Stream() {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stop_ = true;
+      chunk_needed_.notify_all();
+    }
+    thread_->join();
+  }
+
+  // Blocks until the loader has the next chunk ready.
+  shared_ptr<Chunk> Pop() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (chunks_.empty()) {
+      chunk_ready_.wait(lock);
+    }
+    shared_ptr<Chunk> chunk = chunks_.front();
+    chunks_.pop_front();
+    chunk_needed_.notify_one();
+    return chunk;
+  }
+
+ private:
+  // Blocks while two chunks are already buffered; false once stopping.
+  bool Push(const shared_ptr<Chunk>& chunk) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (chunks_.size() >= 2 && !stop_) {
+      chunk_needed_.wait(lock);
+    }
+    if (stop_) {
+      return false;
+    }
+    chunks_.push_back(chunk);
+    chunk_ready_.notify_one();
+    return true;
+  }
+
+  void Run() {
+    const HDF5DataParameter& hdf5_param = param_.hdf5_data_param();
+    const hsize_t chunk_rows = hdf5_param.chunk_rows();
+    const int top_size = param_.top_size();
+    int file = 0;
+    while (true) {
+      const char* filename =
+          filenames_[file_permutation_[file]].c_str();
+      hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+      CHECK_GE(file_id, 0) << "Failed opening HDF5 file: " << filename;
+      const hsize_t rows =
+          hdf5_get_dataset_rows(file_id, param_.top(0).c_str());
+      for (hsize_t start = 0; start < rows; start += chunk_rows) {
+        const hsize_t count = std::min(chunk_rows, rows - start);
+        shared_ptr<Chunk> chunk(new Chunk());
+        chunk->blobs.resize(top_size);
+        for (int i = 0; i < top_size; ++i) {
+          chunk->blobs[i].reset(new Blob<Dtype>());
+          hdf5_load_nd_dataset_rows(file_id, param_.top(i).c_str(),
+              1, INT_MAX, chunk->blobs[i].get(), start, count);
+          CHECK_EQ(chunk->blobs[i]->shape(0), static_cast<int>(count));
+        }
+        chunk->permutation.resize(count);
+        for (unsigned int i = 0; i < count; ++i) {
+          chunk->permutation[i] = i;
+        }
+        if (hdf5_param.shuffle()) {
+          std::random_shuffle(chunk->permutation.begin(),
+                              chunk->permutation.end());
+        }
+        if (!Push(chunk)) {
+          herr_t status = H5Fclose(file_id);
+          CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+          return;
+        }
+      }
+      herr_t status = H5Fclose(file_id);
+      CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+      if (++file == static_cast<int>(filenames_.size())) {
+        file = 0;
+        if (hdf5_param.shuffle()) {
+          std::random_shuffle(file_permutation_.begin(),
+                              file_permutation_.end());
+        }
+        DLOG(INFO) << "Looping around to first file.";
+      }
+    }
+  }
+
+  const LayerParameter param_;
+  const vector<std::string> filenames_;
+  vector<unsigned int> file_permutation_;
+  bool stop_;
+  boost::mutex mutex_;
+  boost::condition_variable chunk_ready_, chunk_needed_;
+  std::deque<shared_ptr<Chunk> > chunks_;
+  shared_ptr<boost::thread> thread_;
+};
+
 template <typename Dtype>
 HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
 
@@ -106,8 +224,15 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  // Load the first HDF5 file (or first streamed chunk) and initialize
+  // the line counter.
+  if (this->layer_param_.hdf5_data_param().chunk_rows() > 0) {
+    stream_.reset(new Stream(this->layer_param_, hdf_filenames_,
+        file_permutation_));
+    Next();
+  } else {
+    LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  }
   current_row_ = 0;
 
   // Reshape blobs.
@@ -124,28 +249,42 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::Next() {
+  if (stream_) {
+    // Swap in the next streamed chunk, waiting only if the loader is
+    // behind; its permutation is already shuffled when requested.
+    shared_ptr<typename Stream::Chunk> next = stream_->Pop();
+    hdf_blobs_ = next->blobs;
+    data_permutation_ = next->permutation;
+    current_row_ = 0;
+    return;
+  }
+  if (num_files_ > 1) {
+    ++current_file_;
+    if (current_file_ == num_files_) {
+      current_file_ = 0;
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        std::random_shuffle(file_permutation_.begin(),
+                            file_permutation_.end());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+    LoadHDF5FileData(
+        hdf_filenames_[file_permutation_[current_file_]].c_str());
+  }
+  current_row_ = 0;
+  if (this->layer_param_.hdf5_data_param().shuffle())
+    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
+}
+
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   for (int i = 0; i < batch_size; ++i, ++current_row_) {
     if (current_row_ == hdf_blobs_[0]->shape(0)) {
-      if (num_files_ > 1) {
-        ++current_file_;
-        if (current_file_ == num_files_) {
-          current_file_ = 0;
-          if (this->layer_param_.hdf5_data_param().shuffle()) {
-            std::random_shuffle(file_permutation_.begin(),
-                                file_permutation_.end());
-          }
-          DLOG(INFO) << "Looping around to first file.";
-        }
-        LoadHDF5FileData(
-            hdf_filenames_[file_permutation_[current_file_]].c_str());
-      }
-      current_row_ = 0;
-      if (this->layer_param_.hdf5_data_param().shuffle())
-        std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
+      Next();
     }
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
@@ -1,5 +1,9 @@
 #ifdef USE_OPENCV
+#include <boost/thread.hpp>
 #include <opencv2/core/core.hpp>
+#ifdef USE_TURBOJPEG
+#include <opencv2/imgproc/imgproc.hpp>
+#endif
 
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
@@ -12,11 +16,35 @@
 #include "caffe/layers/image_data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/jpeg_decoder.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+class ImageDataLayer<Dtype>::DecodeScratch {
+ public:
+  struct Buffers {
+    std::vector<char> file_bytes;
+    cv::Mat decoded;
+    cv::Mat resized;
+  };
+
+  // The calling thread's buffers, created on first use.
+  Buffers* get() {
+    Buffers* buffers = tls_.get();
+    if (buffers == NULL) {
+      buffers = new Buffers();
+      tls_.reset(buffers);
+    }
+    return buffers;
+  }
+
+ private:
+  boost::thread_specific_ptr<Buffers> tls_;
+};
+
 template <typename Dtype>
 ImageDataLayer<Dtype>::~ImageDataLayer<Dtype>() {
   this->StopInternalThread();
@@ -33,14 +61,29 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   CHECK((new_height == 0 && new_width == 0) ||
       (new_height > 0 && new_width > 0)) << "Current implementation requires "
       "new_height and new_width to be set at the same time.";
-  // Read the file with filenames and labels
+#ifndef USE_TURBOJPEG
+  CHECK_NE(this->layer_param_.image_data_param().decode_engine(),
+      ImageDataParameter_DecodeEngine_TURBOJPEG)
+      << "decode_engine: TURBOJPEG requires compiling with USE_TURBOJPEG.";
+#endif
+  decode_scratch_.reset(new DecodeScratch());
+  // Read the file with filenames and labels. A binary index written by the
+  // build_image_index tool is detected by its magic and loaded with a few
+  // bulk reads; anything else is parsed as a plain text listing.
   const string& source = this->layer_param_.image_data_param().source();
   LOG(INFO) << "Opening file " << source;
-  std::ifstream infile(source.c_str());
-  string filename;
-  int label;
-  while (infile >> filename >> label) {
-    lines_.push_back(std::make_pair(filename, label));
+  use_index_ = index_.Load(source);
+  if (!use_index_) {
+    std::ifstream infile(source.c_str());
+    string filename;
+    int label;
+    while (infile >> filename >> label) {
+      lines_.push_back(std::make_pair(filename, label));
+    }
+  }
+  order_.resize(use_index_ ? index_.size() : lines_.size());
+  for (size_t i = 0; i < order_.size(); ++i) {
+    order_[i] = i;
   }
 
   if (this->layer_param_.image_data_param().shuffle()) {
@@ -50,7 +93,7 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     prefetch_rng_.reset(new Caffe::RNG(prefetch_rng_seed));
     ShuffleImages();
   }
-  LOG(INFO) << "A total of " << lines_.size() << " images.";
+  LOG(INFO) << "A total of " << num_images() << " images.";
 
   lines_id_ = 0;
   // Check if we would need to randomly skip a few data points
@@ -58,13 +101,13 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     unsigned int skip = caffe_rng_rand() %
         this->layer_param_.image_data_param().rand_skip();
     LOG(INFO) << "Skipping first " << skip << " data points.";
-    CHECK_GT(lines_.size(), skip) << "Not enough points to skip";
+    CHECK_GT(num_images(), skip) << "Not enough points to skip";
     lines_id_ = skip;
   }
   // Read an image, and use it to initialize the top blob.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
+  cv::Mat cv_img = ReadImageToCVMat(root_folder + image_path(lines_id_),
                                     new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+  CHECK(cv_img.data) << "Could not load " << image_path(lines_id_);
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
   this->transformed_data_.Reshape(top_shape);
@@ -72,8 +115,8 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const int batch_size = this->layer_param_.image_data_param().batch_size();
   CHECK_GT(batch_size, 0) << "Positive batch size required";
   top_shape[0] = batch_size;
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].data_.Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
   }
   top[0]->Reshape(top_shape);
 
@@ -83,8 +126,8 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // label
   vector<int> label_shape(1, batch_size);
   top[1]->Reshape(label_shape);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].label_.Reshape(label_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->label_.Reshape(label_shape);
   }
 }
 
@@ -92,10 +135,47 @@ template <typename Dtype>
 void ImageDataLayer<Dtype>::ShuffleImages() {
   caffe::rng_t* prefetch_rng =
       static_cast<caffe::rng_t*>(prefetch_rng_->generator());
-  shuffle(lines_.begin(), lines_.end(), prefetch_rng);
+  shuffle(order_.begin(), order_.end(), prefetch_rng);
 }
 
 // This function is called on prefetch thread
+template <typename Dtype>
+cv::Mat ImageDataLayer<Dtype>::ReadImage(const string& filename) {
+  const ImageDataParameter& param = this->layer_param_.image_data_param();
+  const int new_height = param.new_height();
+  const int new_width = param.new_width();
+  const bool is_color = param.is_color();
+#ifdef USE_TURBOJPEG
+  if (param.decode_engine() != ImageDataParameter_DecodeEngine_OPENCV) {
+    std::ifstream file(filename.c_str(),
+        std::ios::in | std::ios::binary | std::ios::ate);
+    if (file) {
+      const size_t size = file.tellg();
+      string bytes(size, 0);
+      file.seekg(0);
+      file.read(&bytes[0], size);
+      cv::Mat img;
+      // Scaled decode straight towards the target size; non-JPEG files
+      // fall through to OpenCV below.
+      if (DecodeJpegToCVMat(bytes.data(), size, new_height, new_width,
+              is_color ? 1 : 0, &img)) {
+        if (new_height > 0 && new_width > 0
+            && (img.rows != new_height || img.cols != new_width)) {
+          cv::resize(img, img, cv::Size(new_width, new_height));
+        }
+        return img;
+      }
+    }
+  }
+#endif  // USE_TURBOJPEG
+  typename DecodeScratch::Buffers* scratch = decode_scratch_->get();
+  if (!ReadImageToCVMat(filename, new_height, new_width, is_color,
+          &scratch->file_bytes, &scratch->decoded, &scratch->resized)) {
+    return cv::Mat();
+  }
+  return scratch->resized;
+}
+
 template <typename Dtype>
 void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer batch_timer;
@@ -107,19 +187,18 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CHECK(this->transformed_data_.count());
   ImageDataParameter image_data_param = this->layer_param_.image_data_param();
   const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
   string root_folder = image_data_param.root_folder();
 
   // Reshape according to the first image of each batch
   // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+  cv::Mat cv_img = ReadImage(root_folder + image_path(lines_id_));
+  CHECK(cv_img.data) << "Could not load " << image_path(lines_id_);
   // Use data_transformer to infer the expected blob shape from a cv_img.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
-  this->transformed_data_.Reshape(top_shape);
+  // Stage through this thread's own scratch blob so load_batch stays
+  // reentrant with prefetch_threads > 1.
+  Blob<Dtype>* transformed_data = this->transform_scratch();
+  transformed_data->Reshape(top_shape);
   // Reshape batch according to the batch_size.
   top_shape[0] = batch_size;
   batch->data_.Reshape(top_shape);
@@ -128,23 +207,22 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
   // datum scales
-  const int lines_size = lines_.size();
+  const int lines_size = num_images();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
     // get a blob
     timer.Start();
     CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+    cv::Mat cv_img = ReadImage(root_folder + image_path(lines_id_));
+    CHECK(cv_img.data) << "Could not load " << image_path(lines_id_);
     read_time += timer.MicroSeconds();
     timer.Start();
     // Apply transformations (mirror, crop...) to the image
     int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(prefetch_data + offset);
-    this->data_transformer_->Transform(cv_img, &(this->transformed_data_));
+    transformed_data->set_cpu_data(prefetch_data + offset);
+    this->data_transformer_->Transform(cv_img, transformed_data);
     trans_time += timer.MicroSeconds();
 
-    prefetch_label[item_id] = lines_[lines_id_].second;
+    prefetch_label[item_id] = image_label(lines_id_);
     // go to the next iter
     lines_id_++;
     if (lines_id_ >= lines_size) {
@@ -160,6 +238,8 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  this->read_us_ += read_time;
+  this->transform_us_ += trans_time;
 }
 
 INSTANTIATE_CLASS(ImageDataLayer);
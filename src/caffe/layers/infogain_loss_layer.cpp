@@ -4,6 +4,7 @@
 
 #include "caffe/layers/infogain_loss_layer.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -40,6 +41,11 @@ void InfogainLossLayer<Dtype>::Reshape(
   CHECK_EQ(infogain->channels(), 1);
   CHECK_EQ(infogain->height(), dim);
   CHECK_EQ(infogain->width(), dim);
+  // The H matrix layout is fixed here (row l is the dim-long weight
+  // vector of label l), so Forward and Backward index rows by pointer
+  // instead of re-deriving offsets per sample; the matrix itself may
+  // still change between passes when supplied as bottom[2].
+  log_prob_.ReshapeLike(*bottom[0]);
 }
 
 
@@ -56,13 +62,17 @@ void InfogainLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
   int num = bottom[0]->num();
   int dim = bottom[0]->count() / bottom[0]->num();
+  // One vectorized clamp+log over all probabilities, then a BLAS dot
+  // of each sample's log row against its cached H row, instead of a
+  // scalar log and matrix re-read per element.
+  Dtype* log_prob = log_prob_.mutable_cpu_data();
+  caffe_cpu_clipped_log(bottom[0]->count(), bottom_data,
+      Dtype(kLOG_THRESHOLD), log_prob);
   Dtype loss = 0;
   for (int i = 0; i < num; ++i) {
-    int label = static_cast<int>(bottom_label[i]);
-    for (int j = 0; j < dim; ++j) {
-      Dtype prob = std::max(bottom_data[i * dim + j], Dtype(kLOG_THRESHOLD));
-      loss -= infogain_mat[label * dim + j] * log(prob);
-    }
+    const int label = static_cast<int>(bottom_label[i]);
+    const Dtype* h_row = infogain_mat + label * dim;
+    loss -= caffe_cpu_dot(dim, h_row, log_prob + i * dim);
   }
   top[0]->mutable_cpu_data()[0] = loss / num;
 }
@@ -94,9 +104,10 @@ void InfogainLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype scale = - top[0]->cpu_diff()[0] / num;
     for (int i = 0; i < num; ++i) {
       const int label = static_cast<int>(bottom_label[i]);
+      const Dtype* h_row = infogain_mat + label * dim;
       for (int j = 0; j < dim; ++j) {
         Dtype prob = std::max(bottom_data[i * dim + j], Dtype(kLOG_THRESHOLD));
-        bottom_diff[i * dim + j] = scale * infogain_mat[label * dim + j] / prob;
+        bottom_diff[i * dim + j] = scale * h_row[j] / prob;
       }
     }
   }
@@ -52,6 +52,7 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  quant_.Init(this->layer_param_.quant_param());
 }
 
 template <typename Dtype>
@@ -86,9 +87,62 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  const float sparse_threshold =
+      this->layer_param_.inner_product_param().sparse_weight_threshold();
+  if (sparse_threshold > 0 && !transpose_ && !sparse_checked_) {
+    // Decided once: inference weights are static, and re-checking a dense
+    // matrix every forward would cost a full pass over it.
+    const float sparsity = this->blobs_[0]->sparsity();
+    if (sparsity >= sparse_threshold) {
+      sparse_row_ptr_.reserve(N_ + 1);
+      sparse_row_ptr_.push_back(0);
+      for (int n = 0; n < N_; ++n) {
+        for (int k = 0; k < K_; ++k) {
+          const Dtype w = weight[n * K_ + k];
+          if (w != Dtype(0)) {
+            sparse_val_.push_back(w);
+            sparse_col_.push_back(k);
+          }
+        }
+        sparse_row_ptr_.push_back(static_cast<int>(sparse_val_.size()));
+      }
+      LOG(INFO) << "Layer " << this->layer_param_.name() << ": weights "
+          << sparsity << " sparse, using CSR forward";
+    }
+    sparse_checked_ = true;
+  }
+  if (!sparse_row_ptr_.empty()) {
+    for (int m = 0; m < M_; ++m) {
+      const Dtype* x = bottom_data + m * K_;
+      Dtype* y = top_data + m * N_;
+      for (int n = 0; n < N_; ++n) {
+        Dtype acc = 0;
+        for (int i = sparse_row_ptr_[n]; i < sparse_row_ptr_[n + 1]; ++i) {
+          acc += sparse_val_[i] * x[sparse_col_[i]];
+        }
+        y[n] = acc;
+      }
+    }
+  } else if (quant_.enabled() && !transpose_ &&
+      quant_.ObserveInput(M_ * K_, bottom_data)) {
+    quant_.QuantizeWeights(N_, K_, weight);
+    int8_t* bottom_q = quant_.input_buffer(M_ * K_);
+    quant_.QuantizeInput(M_ * K_, bottom_data, bottom_q);
+    int* acc = quant_.acc_buffer(M_ * N_);
+    caffe_cpu_igemm_nt(M_, N_, K_, bottom_q, quant_.weights(), acc);
+    const Dtype input_scale = quant_.input_scale();
+    for (int m = 0; m < M_; ++m) {
+      for (int n = 0; n < N_; ++n) {
+        top_data[m * N_ + n] =
+            acc[m * N_ + n] * input_scale * quant_.weight_scale(n);
+      }
+    }
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans,
+        transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -1,3 +1,7 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
@@ -14,6 +18,8 @@ void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   alpha_ = this->layer_param_.lrn_param().alpha();
   beta_ = this->layer_param_.lrn_param().beta();
   k_ = this->layer_param_.lrn_param().k();
+  forward_threads_ = this->layer_param_.lrn_param().forward_threads();
+  CHECK_GE(forward_threads_, 1) << "forward_threads must be positive.";
   if (this->layer_param_.lrn_param().norm_region() ==
       LRNParameter_NormRegion_WITHIN_CHANNEL) {
     // Set up split_layer_ to use inputs in the numerator and denominator.
@@ -104,51 +110,93 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+// Spatial positions handled per work unit of the fused cross-channel
+// forward; small enough that a unit's scale rows stay cache-resident
+// across the channel sweep.
+const int kLRNBlockSize = 1024;
+
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelRegions(const Dtype* bottom_data,
+    Dtype* scale_data, Dtype* top_data, const int num_units,
+    const int worker, const int num_workers) {
+  const int spatial = height_ * width_;
+  const int blocks_per_image = (spatial + kLRNBlockSize - 1) / kLRNBlockSize;
+  const Dtype alpha_over_size = alpha_ / size_;
+  for (int u = worker; u < num_units; u += num_workers) {
+    const int n = u / blocks_per_image;
+    const int s0 = (u % blocks_per_image) * kLRNBlockSize;
+    const int len = std::min(kLRNBlockSize, spatial - s0);
+    const Dtype* x = bottom_data + n * channels_ * spatial + s0;
+    Dtype* scale = scale_data + n * channels_ * spatial + s0;
+    Dtype* y = top_data + n * channels_ * spatial + s0;
+    // First channel: k + alpha/n * sum of the leading half window.
+    for (int s = 0; s < len; ++s) {
+      scale[s] = k_;
+    }
+    for (int c = 0; c <= pre_pad_ && c < channels_; ++c) {
+      const Dtype* head = x + c * spatial;
+      for (int s = 0; s < len; ++s) {
+        scale[s] += alpha_over_size * head[s] * head[s];
+      }
+    }
+    // Slide the window one channel at a time; the head/tail bounds are
+    // hoisted out of the inner loops so each one is branch-free over s.
+    for (int c = 1; c < channels_; ++c) {
+      const Dtype* prev = scale + (c - 1) * spatial;
+      Dtype* cur = scale + c * spatial;
+      const int head_c = c + pre_pad_;
+      const int tail_c = c - pre_pad_ - 1;
+      const Dtype* head = x + head_c * spatial;
+      const Dtype* tail = x + tail_c * spatial;
+      if (head_c < channels_ && tail_c >= 0) {
+        for (int s = 0; s < len; ++s) {
+          cur[s] = prev[s] +
+              alpha_over_size * (head[s] * head[s] - tail[s] * tail[s]);
+        }
+      } else if (head_c < channels_) {
+        for (int s = 0; s < len; ++s) {
+          cur[s] = prev[s] + alpha_over_size * head[s] * head[s];
+        }
+      } else if (tail_c >= 0) {
+        for (int s = 0; s < len; ++s) {
+          cur[s] = prev[s] - alpha_over_size * tail[s] * tail[s];
+        }
+      } else {
+        caffe_copy(len, prev, cur);
+      }
+    }
+    // Output while the scale rows are still hot.
+    for (int c = 0; c < channels_; ++c) {
+      caffe_powx<Dtype>(len, scale + c * spatial, -beta_, y + c * spatial);
+      caffe_mul<Dtype>(len, y + c * spatial, x + c * spatial,
+          y + c * spatial);
+    }
+  }
+}
+
 template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelForward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
+  const int spatial = height_ * width_;
+  const int blocks_per_image = (spatial + kLRNBlockSize - 1) / kLRNBlockSize;
+  const int num_units = num_ * blocks_per_image;
+  const int num_workers = std::min(forward_threads_, num_units);
+  if (num_workers <= 1) {
+    CrossChannelRegions(bottom_data, scale_data, top_data, num_units, 0, 1);
+    return;
   }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
-    }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
-    }
+  boost::thread_group workers;
+  for (int t = 1; t < num_workers; ++t) {
+    workers.add_thread(new boost::thread(
+        &LRNLayer<Dtype>::CrossChannelRegions, this, bottom_data,
+        scale_data, top_data, num_units, t, num_workers));
   }
-
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+  CrossChannelRegions(bottom_data, scale_data, top_data, num_units, 0,
+      num_workers);
+  workers.join_all();
 }
 
 template <typename Dtype>
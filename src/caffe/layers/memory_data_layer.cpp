@@ -2,12 +2,120 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <deque>
 #include <vector>
 
 #include "caffe/layers/memory_data_layer.hpp"
 
 namespace caffe {
 
+#ifdef USE_OPENCV
+// Runs the transform for AddMatVectorAsync on its own thread. Jobs are
+// cloned mats; results are freshly allocated blob pairs that Forward
+// swaps in, so the worker never touches the blobs the net is reading.
+template <typename Dtype>
+class MemoryDataLayer<Dtype>::Async {
+ public:
+  struct Result {
+    shared_ptr<Blob<Dtype> > data, label;
+  };
+
+  explicit Async(MemoryDataLayer<Dtype>* layer)
+      : layer_(layer), busy_(false), stop_(false) {
+    thread_.reset(new boost::thread(boost::bind(&Async::Run, this)));
+  }
+  ~Async() {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stop_ = true;
+      jobs_ready_.notify_all();
+    }
+    thread_->join();
+  }
+
+  void Push(const vector<cv::Mat>& mat_vector, const vector<int>& labels) {
+    Job job;
+    job.mats.reserve(mat_vector.size());
+    for (int i = 0; i < mat_vector.size(); ++i) {
+      job.mats.push_back(mat_vector[i].clone());
+    }
+    job.labels = labels;
+    boost::mutex::scoped_lock lock(mutex_);
+    jobs_.push_back(job);
+    jobs_ready_.notify_one();
+  }
+
+  // Whether a queued, in-flight or finished batch exists.
+  bool HasPending() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return !jobs_.empty() || busy_ || !results_.empty();
+  }
+
+  // Blocks until the next transformed batch is ready.
+  Result Pop() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (results_.empty()) {
+      results_ready_.wait(lock);
+    }
+    Result result = results_.front();
+    results_.pop_front();
+    return result;
+  }
+
+ private:
+  struct Job {
+    vector<cv::Mat> mats;
+    vector<int> labels;
+  };
+
+  void Run() {
+    while (true) {
+      Job job;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (jobs_.empty() && !stop_) {
+          jobs_ready_.wait(lock);
+        }
+        if (stop_) {
+          return;
+        }
+        job = jobs_.front();
+        jobs_.pop_front();
+        busy_ = true;
+      }
+      Result result;
+      const int num = job.mats.size();
+      result.data.reset(new Blob<Dtype>(num, layer_->channels_,
+          layer_->height_, layer_->width_));
+      result.label.reset(new Blob<Dtype>(num, 1, 1, 1));
+      layer_->data_transformer_->Transform(job.mats, result.data.get());
+      Dtype* top_label = result.label->mutable_cpu_data();
+      for (int item_id = 0; item_id < num; ++item_id) {
+        top_label[item_id] = job.labels[item_id];
+      }
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        busy_ = false;
+        results_.push_back(result);
+        results_ready_.notify_one();
+      }
+    }
+  }
+
+  MemoryDataLayer<Dtype>* const layer_;
+  bool busy_, stop_;
+  boost::mutex mutex_;
+  boost::condition_variable jobs_ready_, results_ready_;
+  std::deque<Job> jobs_;
+  std::deque<Result> results_;
+  shared_ptr<boost::thread> thread_;
+};
+#endif  // USE_OPENCV
+
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
      const vector<Blob<Dtype>*>& top) {
@@ -36,8 +144,6 @@ void MemoryDataLayer<Dtype>::AddDatumVector(const vector<Datum>& datum_vector) {
       "Can't add data until current data has been consumed.";
   size_t num = datum_vector.size();
   CHECK_GT(num, 0) << "There is no datum to add.";
-  CHECK_EQ(num % batch_size_, 0) <<
-      "The added data must be a multiple of the batch size.";
   added_data_.Reshape(num, channels_, height_, width_);
   added_label_.Reshape(num, 1, 1, 1);
   // Apply data transformations (mirror, scale, crop...)
@@ -61,8 +167,6 @@ void MemoryDataLayer<Dtype>::AddMatVector(const vector<cv::Mat>& mat_vector,
   CHECK(!has_new_data_) <<
       "Can't add mat until current data has been consumed.";
   CHECK_GT(num, 0) << "There is no mat to add";
-  CHECK_EQ(num % batch_size_, 0) <<
-      "The added data must be a multiple of the batch size.";
   added_data_.Reshape(num, channels_, height_, width_);
   added_label_.Reshape(num, 1, 1, 1);
   // Apply data transformations (mirror, scale, crop...)
@@ -77,13 +181,24 @@ void MemoryDataLayer<Dtype>::AddMatVector(const vector<cv::Mat>& mat_vector,
   Reset(top_data, top_label, num);
   has_new_data_ = true;
 }
+
+template <typename Dtype>
+void MemoryDataLayer<Dtype>::AddMatVectorAsync(
+    const vector<cv::Mat>& mat_vector, const vector<int>& labels) {
+  CHECK_GT(mat_vector.size(), 0) << "There is no mat to add";
+  CHECK_EQ(mat_vector.size(), labels.size());
+  if (!async_) {
+    async_.reset(new Async(this));
+  }
+  async_->Push(mat_vector, labels);
+}
 #endif  // USE_OPENCV
 
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::Reset(Dtype* data, Dtype* labels, int n) {
   CHECK(data);
   CHECK(labels);
-  CHECK_EQ(n % batch_size_, 0) << "n must be a multiple of batch size";
+  CHECK_GT(n, 0) << "n must be positive";
   // Warn with transformation parameters since a memory array is meant to
   // be generic and no transformations are done with Reset().
   if (this->layer_param_.has_transform_param()) {
@@ -107,12 +222,29 @@ void MemoryDataLayer<Dtype>::set_batch_size(int new_size) {
 template <typename Dtype>
 void MemoryDataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+#ifdef USE_OPENCV
+  // Once the current data is consumed, pick up the next asynchronously
+  // transformed batch, waiting for the worker if it is still running.
+  if (!has_new_data_ && async_ && async_->HasPending()) {
+    typename Async::Result result = async_->Pop();
+    async_data_ = result.data;
+    async_label_ = result.label;
+    data_ = async_data_->mutable_cpu_data();
+    labels_ = async_label_->mutable_cpu_data();
+    n_ = async_data_->num();
+    pos_ = 0;
+    has_new_data_ = true;
+  }
+#endif  // USE_OPENCV
   CHECK(data_) << "MemoryDataLayer needs to be initalized by calling Reset";
-  top[0]->Reshape(batch_size_, channels_, height_, width_);
-  top[1]->Reshape(batch_size_, 1, 1, 1);
+  // Slice the effective batch, so added counts need not be a multiple
+  // of batch_size: the final slice just comes up short.
+  const int num = std::min<int>(batch_size_, n_ - pos_);
+  top[0]->Reshape(num, channels_, height_, width_);
+  top[1]->Reshape(num, 1, 1, 1);
   top[0]->set_cpu_data(data_ + pos_ * size_);
   top[1]->set_cpu_data(labels_ + pos_);
-  pos_ = (pos_ + batch_size_) % n_;
+  pos_ = (pos_ + num) % n_;
   if (pos_ == 0)
     has_new_data_ = false;
 }
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/mvn_layer.hpp"
@@ -40,33 +42,35 @@ void MVNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 
   int dim = bottom[0]->count() / num;
 
-  // subtract mean
-  caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, bottom_data,
-      sum_multiplier_.cpu_data(), 0., mean_.mutable_cpu_data());  // EX
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, -1.,
-      mean_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-      temp_.mutable_cpu_data());
-  caffe_add(temp_.count(), bottom_data, temp_.cpu_data(), top_data);  // X-EX
-
-  if (this->layer_param_.mvn_param().normalize_variance()) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_powx(bottom[0]->count(), top_data, Dtype(2),
-        temp_.mutable_cpu_data());  // (X-EX)^2
-    caffe_cpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, temp_.cpu_data(),
-        sum_multiplier_.cpu_data(), 0.,
-        variance_.mutable_cpu_data());  // E((X-EX)^2)
-
-    // normalize variance
-    caffe_powx(variance_.count(), variance_.cpu_data(), Dtype(0.5),
-          variance_.mutable_cpu_data());
-
-    caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
-
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-          variance_.cpu_data(), sum_multiplier_.cpu_data(), 0.,
-          temp_.mutable_cpu_data());
-
-    caffe_div(temp_.count(), top_data, temp_.cpu_data(), top_data);
+  const bool normalize_variance =
+      this->layer_param_.mvn_param().normalize_variance();
+  Dtype* mean = mean_.mutable_cpu_data();
+  Dtype* variance = variance_.mutable_cpu_data();
+  // One fused pass over the data gathers the per-slice sums (and sums
+  // of squares when normalizing), replacing the ones-vector gemv plus
+  // broadcast gemm idiom and its input-sized scratch; the statistics
+  // use var(X) = E(X^2) - (EX)^2.
+  if (normalize_variance) {
+    caffe_cpu_slice_sum_sumsq(num, dim, bottom_data, mean, variance);
+  } else {
+    caffe_cpu_slice_sum(num, dim, bottom_data, mean);
+  }
+  for (int i = 0; i < num; ++i) {
+    const Dtype slice_mean = mean[i] / dim;
+    mean[i] = slice_mean;
+    if (normalize_variance) {
+      // Clamp the tiny negative values rounding can produce.
+      const Dtype var = std::max(Dtype(0),
+          variance[i] / dim - slice_mean * slice_mean);
+      // Backward divides by this, so keep sqrt(var) + eps in variance_.
+      const Dtype denom = std::sqrt(var) + eps_;
+      variance[i] = denom;
+      caffe_cpu_axpb(dim, Dtype(1) / denom, bottom_data + i * dim,
+          -slice_mean / denom, top_data + i * dim);
+    } else {
+      caffe_cpu_axpb(dim, Dtype(1), bottom_data + i * dim, -slice_mean,
+          top_data + i * dim);
+    }
   }
 }
 
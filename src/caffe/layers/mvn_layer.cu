@@ -5,6 +5,38 @@
 
 namespace caffe {
 
+// Turns the raw per-slice sums into the mean and, when normalizing,
+// sqrt(var) + eps (which Backward divides by), using
+// var(X) = E(X^2) - (EX)^2 from the fused reduction.
+template <typename Dtype>
+__global__ void MVNStatsKernel(const int num, const int dim,
+    const Dtype eps, const bool normalize_variance, Dtype* mean,
+    Dtype* variance) {
+  CUDA_KERNEL_LOOP(index, num) {
+    const Dtype slice_mean = mean[index] / dim;
+    mean[index] = slice_mean;
+    if (normalize_variance) {
+      Dtype var = variance[index] / dim - slice_mean * slice_mean;
+      var = var > 0 ? var : 0;
+      variance[index] = sqrt(var) + eps;
+    }
+  }
+}
+
+template <typename Dtype>
+__global__ void MVNNormalizeKernel(const int count, const int dim,
+    const bool normalize_variance, const Dtype* bottom_data,
+    const Dtype* mean, const Dtype* variance, Dtype* top_data) {
+  CUDA_KERNEL_LOOP(index, count) {
+    const int slice = index / dim;
+    Dtype value = bottom_data[index] - mean[slice];
+    if (normalize_variance) {
+      value /= variance[slice];
+    }
+    top_data[index] = value;
+  }
+}
+
 template <typename Dtype>
 void MVNLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -18,35 +50,28 @@ void MVNLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 
   int dim = bottom[0]->count() / num;
 
-  // subtract mean
-  caffe_gpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, bottom_data,
-      sum_multiplier_.gpu_data(), 0., mean_.mutable_gpu_data());  // EX
-  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, -1.,
-      mean_.gpu_data(), sum_multiplier_.gpu_data(), 0.,
-      temp_.mutable_gpu_data());
-  caffe_gpu_add(temp_.count(), bottom_data, temp_.gpu_data(),
-      top_data);  // X-EX
-
-  if (this->layer_param_.mvn_param().normalize_variance()) {
-    // compute variance using var(X) = E((X-EX)^2)
-    caffe_gpu_powx(bottom[0]->count(), top_data, Dtype(2),
-        temp_.mutable_gpu_data());  // (X-EX)^2
-    caffe_gpu_gemv<Dtype>(CblasNoTrans, num, dim, 1. / dim, temp_.gpu_data(),
-        sum_multiplier_.gpu_data(), 0.,
-        variance_.mutable_gpu_data());  // E((X-EX)^2)
-
-    // normalize variance
-    caffe_gpu_powx(variance_.count(), variance_.gpu_data(), Dtype(0.5),
-          variance_.mutable_gpu_data());
-
-    caffe_gpu_add_scalar(variance_.count(), eps_, variance_.mutable_gpu_data());
-
-    caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, 1, 1.,
-          variance_.gpu_data(), sum_multiplier_.gpu_data(), 0.,
-          temp_.mutable_gpu_data());
-
-    caffe_gpu_div(temp_.count(), top_data, temp_.gpu_data(), top_data);
+  const bool normalize_variance =
+      this->layer_param_.mvn_param().normalize_variance();
+  Dtype* mean = mean_.mutable_gpu_data();
+  Dtype* variance = variance_.mutable_gpu_data();
+  // One fused block-per-slice reduction gathers the statistics and one
+  // elementwise pass applies them, replacing the gemv/broadcast-gemm
+  // pipeline and its input-sized scratch.
+  if (normalize_variance) {
+    caffe_gpu_slice_sum_sumsq(num, dim, bottom_data, mean, variance);
+  } else {
+    caffe_gpu_slice_sum(num, dim, bottom_data, mean);
   }
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  MVNStatsKernel<Dtype><<<CAFFE_GET_BLOCKS(num), CAFFE_CUDA_NUM_THREADS>>>(
+      num, dim, Dtype(eps_), normalize_variance, mean, variance);
+  CUDA_POST_KERNEL_CHECK;
+  const int count = bottom[0]->count();
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  MVNNormalizeKernel<Dtype><<<CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS>>>(count, dim, normalize_variance, bottom_data,
+      mean, variance, top_data);
+  CUDA_POST_KERNEL_CHECK;
 }
 
 template <typename Dtype>
@@ -1,3 +1,5 @@
+#include <boost/thread.hpp>
+
 #include <algorithm>
 #include <cfloat>
 #include <vector>
@@ -73,6 +75,8 @@ void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     CHECK_LT(pad_h_, kernel_h_);
     CHECK_LT(pad_w_, kernel_w_);
   }
+  forward_threads_ = pool_param.forward_threads();
+  CHECK_GE(forward_threads_, 1) << "forward_threads must be positive.";
 }
 
 template <typename Dtype>
@@ -108,11 +112,39 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
   }
-  // If max pooling, we will initialize the vector index part.
+  // Clamp each output row's and column's pooling window once here instead
+  // of re-deriving it with min/max per output element in every pass.
+  win_hstart_.resize(pooled_height_);
+  win_hend_.resize(pooled_height_);
+  win_hspan_.resize(pooled_height_);
+  for (int ph = 0; ph < pooled_height_; ++ph) {
+    const int hstart = ph * stride_h_ - pad_h_;
+    win_hspan_[ph] = min(hstart + kernel_h_, height_ + pad_h_) - hstart;
+    win_hstart_[ph] = max(hstart, 0);
+    win_hend_[ph] = min(hstart + kernel_h_, height_);
+  }
+  win_wstart_.resize(pooled_width_);
+  win_wend_.resize(pooled_width_);
+  win_wspan_.resize(pooled_width_);
+  for (int pw = 0; pw < pooled_width_; ++pw) {
+    const int wstart = pw * stride_w_ - pad_w_;
+    win_wspan_[pw] = min(wstart + kernel_w_, width_ + pad_w_) - wstart;
+    win_wstart_[pw] = max(wstart, 0);
+    win_wend_[pw] = min(wstart + kernel_w_, width_);
+  }
+  // If max pooling, we will initialize the vector index part. On the CPU
+  // in TRAIN phase a byte-sized in-window argmax replaces the int blob
+  // whenever the window offsets fit; max_idx_ allocates lazily, so keeping
+  // its shape current for the other paths costs nothing.
+  max_off_.clear();
   if (this->layer_param_.pooling_param().pool() ==
       PoolingParameter_PoolMethod_MAX && top.size() == 1) {
     max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
         pooled_width_);
+    if (Caffe::mode() == Caffe::CPU && this->phase_ == TRAIN &&
+        kernel_h_ * kernel_w_ <= 256) {
+      max_off_.resize(top[0]->count());
+    }
   }
   // If stochastic pooling, we will initialize the random index part.
   if (this->layer_param_.pooling_param().pool() ==
@@ -124,6 +156,171 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 
 // TODO(Yangqing): Is there a faster way to do pooling in the channel-first
 // case?
+
+// One (num, channel) plane of MAX pooling with argmax bookkeeping: the
+// per-element compare-and-record loop, needed whenever the backward pass
+// or an explicit top mask wants the winning indices. Window extents come
+// from the tables clamped at Reshape time.
+template <typename Dtype>
+void MaxPoolPlaneMasked(const Dtype* bottom, const int width,
+    const int pooled_height, const int pooled_width, const int* hstart,
+    const int* hend, const int* wstart, const int* wend, Dtype* top,
+    int* mask, Dtype* top_mask) {
+  for (int ph = 0; ph < pooled_height; ++ph) {
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      const int pool_index = ph * pooled_width + pw;
+      for (int h = hstart[ph]; h < hend[ph]; ++h) {
+        for (int w = wstart[pw]; w < wend[pw]; ++w) {
+          const int index = h * width + w;
+          if (bottom[index] > top[pool_index]) {
+            top[pool_index] = bottom[index];
+            if (top_mask) {
+              top_mask[pool_index] = static_cast<Dtype>(index);
+            } else {
+              mask[pool_index] = index;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Like MaxPoolPlaneMasked, but records the argmax as a byte offset within
+// the clamped window ((h - hstart) * kernel_w + (w - wstart)); Backward_cpu
+// rebuilds the image index from the same extent tables. Only used when
+// kernel_h * kernel_w <= 256.
+template <typename Dtype>
+void MaxPoolPlaneOffsets(const Dtype* bottom, const int width,
+    const int pooled_height, const int pooled_width, const int kernel_w,
+    const int* hstart, const int* hend, const int* wstart, const int* wend,
+    Dtype* top, unsigned char* off_mask) {
+  for (int ph = 0; ph < pooled_height; ++ph) {
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      const int pool_index = ph * pooled_width + pw;
+      for (int h = hstart[ph]; h < hend[ph]; ++h) {
+        for (int w = wstart[pw]; w < wend[pw]; ++w) {
+          if (bottom[h * width + w] > top[pool_index]) {
+            top[pool_index] = bottom[h * width + w];
+            off_mask[pool_index] = static_cast<unsigned char>(
+                (h - hstart[ph]) * kernel_w + (w - wstart[pw]));
+          }
+        }
+      }
+    }
+  }
+}
+
+// Maskless MAX pooling over one plane, for inference where nothing reads
+// the argmax indices: each kernel column becomes a branch-free max over
+// a contiguous output row that the compiler vectorizes. KERNEL/STRIDE
+// specialize the common square shapes at compile time the same way the
+// im2col GPU kernels do; KERNEL == 0 reads the runtime arguments.
+template <typename Dtype, int KERNEL, int STRIDE>
+void MaxPoolPlane(const Dtype* bottom, const int height, const int width,
+    const int pooled_height, const int pooled_width, const int kernel_h_arg,
+    const int kernel_w_arg, const int stride_h_arg, const int stride_w_arg,
+    const int pad_h, const int pad_w, Dtype* top) {
+  const int kernel_h = KERNEL > 0 ? KERNEL : kernel_h_arg;
+  const int kernel_w = KERNEL > 0 ? KERNEL : kernel_w_arg;
+  const int stride_h = KERNEL > 0 ? STRIDE : stride_h_arg;
+  const int stride_w = KERNEL > 0 ? STRIDE : stride_w_arg;
+  for (int ph = 0; ph < pooled_height; ++ph) {
+    Dtype* top_row = top + ph * pooled_width;
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      top_row[pw] = Dtype(-FLT_MAX);
+    }
+    const int hstart = max(ph * stride_h - pad_h, 0);
+    const int hend = min(ph * stride_h - pad_h + kernel_h, height);
+    for (int h = hstart; h < hend; ++h) {
+      const Dtype* in_row = bottom + h * width;
+      for (int kw = 0; kw < kernel_w; ++kw) {
+        const int shift = kw - pad_w;
+        const int pw_start =
+            shift < 0 ? (-shift + stride_w - 1) / stride_w : 0;
+        const int pw_end = min(pooled_width,
+            shift < width ? (width - shift + stride_w - 1) / stride_w : 0);
+        const Dtype* in = in_row + pw_start * stride_w + shift;
+        Dtype* out = top_row + pw_start;
+        for (int pw = pw_start; pw < pw_end; ++pw) {
+          *out = max(*out, *in);
+          ++out;
+          in += stride_w;
+        }
+      }
+    }
+  }
+}
+
+// One plane of AVE pooling; the window sum accumulates in a register
+// instead of re-reading the output element, and the divisor comes from
+// the precomputed padded spans.
+template <typename Dtype>
+void AvePoolPlane(const Dtype* bottom, const int width,
+    const int pooled_height, const int pooled_width, const int* hstart,
+    const int* hend, const int* hspan, const int* wstart, const int* wend,
+    const int* wspan, Dtype* top) {
+  for (int ph = 0; ph < pooled_height; ++ph) {
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      const int pool_size = hspan[ph] * wspan[pw];
+      Dtype sum = 0;
+      for (int h = hstart[ph]; h < hend[ph]; ++h) {
+        for (int w = wstart[pw]; w < wend[pw]; ++w) {
+          sum += bottom[h * width + w];
+        }
+      }
+      top[ph * pooled_width + pw] = sum / pool_size;
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardPlanes(const Dtype* bottom_data,
+    Dtype* top_data, int* mask, unsigned char* off_mask, Dtype* top_mask,
+    const int num_planes, const int worker, const int num_workers) {
+  const int bottom_plane = height_ * width_;
+  const int top_plane = pooled_height_ * pooled_width_;
+  const bool pool_2x2_s2 = kernel_h_ == 2 && kernel_w_ == 2 &&
+      stride_h_ == 2 && stride_w_ == 2;
+  const bool pool_3x3_s2 = kernel_h_ == 3 && kernel_w_ == 3 &&
+      stride_h_ == 2 && stride_w_ == 2;
+  const bool average = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_AVE;
+  const int* hstart = &win_hstart_[0];
+  const int* hend = &win_hend_[0];
+  const int* wstart = &win_wstart_[0];
+  const int* wend = &win_wend_[0];
+  for (int p = worker; p < num_planes; p += num_workers) {
+    const Dtype* bottom = bottom_data + p * bottom_plane;
+    Dtype* top = top_data + p * top_plane;
+    if (average) {
+      AvePoolPlane(bottom, width_, pooled_height_, pooled_width_,
+          hstart, hend, &win_hspan_[0], wstart, wend, &win_wspan_[0], top);
+    } else if (mask != NULL || top_mask != NULL) {
+      MaxPoolPlaneMasked(bottom, width_, pooled_height_, pooled_width_,
+          hstart, hend, wstart, wend, top,
+          mask == NULL ? NULL : mask + p * top_plane,
+          top_mask == NULL ? NULL : top_mask + p * top_plane);
+    } else if (off_mask != NULL) {
+      MaxPoolPlaneOffsets(bottom, width_, pooled_height_, pooled_width_,
+          kernel_w_, hstart, hend, wstart, wend, top,
+          off_mask + p * top_plane);
+    } else if (pool_2x2_s2) {
+      MaxPoolPlane<Dtype, 2, 2>(bottom, height_, width_, pooled_height_,
+          pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_,
+          pad_h_, pad_w_, top);
+    } else if (pool_3x3_s2) {
+      MaxPoolPlane<Dtype, 3, 2>(bottom, height_, width_, pooled_height_,
+          pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_,
+          pad_h_, pad_w_, top);
+    } else {
+      MaxPoolPlane<Dtype, 0, 0>(bottom, height_, width_, pooled_height_,
+          pooled_width_, kernel_h_, kernel_w_, stride_h_, stride_w_,
+          pad_h_, pad_w_, top);
+    }
+  }
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -133,90 +330,29 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitalized variables
+  unsigned char* off_mask = NULL;
   Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
+    // The argmax bookkeeping is only needed when the backward pass will
+    // read it or a mask top was requested; at inference time the planes
+    // take the maskless vectorized path instead. Reshape decides between
+    // the byte-sized in-window offsets and the int index blob.
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
       caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
+      caffe_set(top_count, Dtype(-FLT_MAX), top_data);
+    } else if (this->phase_ == TRAIN) {
+      if (max_off_.size()) {
+        off_mask = &max_off_[0];
+      } else {
+        mask = max_idx_.mutable_cpu_data();
+        caffe_set(top_count, -1, mask);
       }
+      caffe_set(top_count, Dtype(-FLT_MAX), top_data);
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
-    }
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -224,6 +360,24 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   default:
     LOG(FATAL) << "Unknown pooling method.";
   }
+  // The planes are independent, so they split across forward_threads
+  // workers the same way forward_cpu_batch splits convolution images.
+  const int num_planes = bottom[0]->num() * channels_;
+  const int num_workers = std::min(forward_threads_, num_planes);
+  if (num_workers <= 1) {
+    ForwardPlanes(bottom_data, top_data, mask, off_mask, top_mask,
+        num_planes, 0, 1);
+    return;
+  }
+  boost::thread_group workers;
+  for (int t = 1; t < num_workers; ++t) {
+    workers.add_thread(new boost::thread(
+        &PoolingLayer<Dtype>::ForwardPlanes, this, bottom_data, top_data,
+        mask, off_mask, top_mask, num_planes, t, num_workers));
+  }
+  ForwardPlanes(bottom_data, top_data, mask, off_mask, top_mask, num_planes,
+      0, num_workers);
+  workers.join_all();
 }
 
 template <typename Dtype>
@@ -240,6 +394,7 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   const int* mask = NULL;  // suppress warnings about uninitialized variables
+  const unsigned char* off_mask = NULL;
   const Dtype* top_mask = NULL;
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
@@ -247,15 +402,35 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
-      mask = max_idx_.cpu_data();
+      // The maskless TEST-phase forward skips the argmax bookkeeping,
+      // so a backward without a mask top (e.g. force_backward saliency
+      // passes) would read an uninitialized mask and scatter every
+      // window's gradient to index 0. Fail loudly instead.
+      CHECK(this->phase_ == TRAIN)
+          << "MAX pooling backward needs the argmax mask, which the "
+          << "maskless TEST-phase forward does not produce; add a mask "
+          << "top or run the net in TRAIN phase.";
+      if (max_off_.size()) {
+        off_mask = &max_off_[0];
+      } else {
+        mask = max_idx_.cpu_data();
+      }
     }
     for (int n = 0; n < top[0]->num(); ++n) {
       for (int c = 0; c < channels_; ++c) {
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
             const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
+            int bottom_index;
+            if (off_mask) {
+              // Rebuild the image index from the in-window byte offset
+              // and the window extent tables.
+              const int local = off_mask[index];
+              bottom_index = (win_hstart_[ph] + local / kernel_w_) * width_
+                  + win_wstart_[pw] + local % kernel_w_;
+            } else {
+              bottom_index = use_top_mask ? top_mask[index] : mask[index];
+            }
             bottom_diff[bottom_index] += top_diff[index];
           }
         }
@@ -263,6 +438,8 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         top_diff += top[0]->offset(0, 1);
         if (use_top_mask) {
           top_mask += top[0]->offset(0, 1);
+        } else if (off_mask) {
+          off_mask += top[0]->offset(0, 1);
         } else {
           mask += top[0]->offset(0, 1);
         }
@@ -275,17 +452,9 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       for (int c = 0; c < channels_; ++c) {
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
+            const int pool_size = win_hspan_[ph] * win_wspan_[pw];
+            for (int h = win_hstart_[ph]; h < win_hend_[ph]; ++h) {
+              for (int w = win_wstart_[pw]; w < win_wend_[pw]; ++w) {
                 bottom_diff[h * width_ + w] +=
                   top_diff[ph * pooled_width_ + pw] / pool_size;
               }
@@ -29,17 +29,58 @@ __global__ void PReLUBackward(const int n, const int channels, const int dim,
   }
 }
 
-// CUDA kernel for element-wise parameter backward
+// CUDA kernel for the first stage of the parameter backward reduction.
+// Each block covers a chunk of one channel's num x dim elements, folds
+// dy * x * (x <= 0) in shared memory, and writes a single partial sum;
+// nothing element-wise ever hits global memory.
 template <typename Dtype>
-__global__ void PReLUParamBackward(const int n,
-    const int rows, const int rowPitch, const Dtype* in_diff,
-    const Dtype* in_data, Dtype* out_diff) {
-  CUDA_KERNEL_LOOP(index, n) {
-    out_diff[index] = in_diff[index] * in_data[index] * (in_data[index] <= 0);
-    for ( int k = 1; k < rows; k++ ) {
-        out_diff[index] += in_diff[index + k*rowPitch]
-           * in_data[index + k*rowPitch] * (in_data[index + k*rowPitch] <= 0);
+__global__ void PReLUParamBackwardStage1(const int num, const int channels,
+    const int dim, const int blocks_per_channel, const Dtype* in_diff,
+    const Dtype* in_data, Dtype* partials) {
+  __shared__ Dtype buffer[CAFFE_CUDA_NUM_THREADS];
+  const int c = blockIdx.x / blocks_per_channel;
+  const int b = blockIdx.x % blocks_per_channel;
+  const int total = num * dim;
+  Dtype sum = 0;
+  for (int j = b * blockDim.x + threadIdx.x; j < total;
+       j += blocks_per_channel * blockDim.x) {
+    const int index = (j / dim * channels + c) * dim + j % dim;
+    sum += in_diff[index] * in_data[index] * (in_data[index] <= 0);
+  }
+  buffer[threadIdx.x] = sum;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) {
+      buffer[threadIdx.x] += buffer[threadIdx.x + s];
+    }
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) {
+    partials[blockIdx.x] = buffer[0];
+  }
+}
+
+// Second stage: one block per slope element folds that channel's
+// partials and accumulates the result into the parameter diff.
+template <typename Dtype>
+__global__ void PReLUParamBackwardStage2(const int blocks_per_channel,
+    const Dtype* partials, Dtype* slope_diff) {
+  __shared__ Dtype buffer[CAFFE_CUDA_NUM_THREADS];
+  const int c = blockIdx.x;
+  Dtype sum = 0;
+  for (int j = threadIdx.x; j < blocks_per_channel; j += blockDim.x) {
+    sum += partials[c * blocks_per_channel + j];
+  }
+  buffer[threadIdx.x] = sum;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) {
+      buffer[threadIdx.x] += buffer[threadIdx.x + s];
     }
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) {
+    slope_diff[c] += buffer[0];
   }
 }
 
@@ -86,26 +127,22 @@ void PReLULayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   // keep top_diff unchanged.
   if (this->param_propagate_down_[0]) {
     Dtype* slope_diff = this->blobs_[0]->mutable_gpu_diff();
-    int cdim = channels * dim;
-
-    // compute element-wise diff
-    // NOLINT_NEXT_LINE(whitespace/operators)
-    PReLUParamBackward<Dtype><<<CAFFE_GET_BLOCKS(cdim),
-      CAFFE_CUDA_NUM_THREADS>>>(
-      cdim, bottom[0]->num(), top[0]->offset(1), top_diff ,
-      bottom_data ,
-      backward_buff_.mutable_gpu_diff());
+    // A shared slope reduces over the whole blob as a single "channel".
+    const int red_num = channel_shared_ ? 1 : bottom[0]->num();
+    const int red_channels = channel_shared_ ? 1 : channels;
+    const int red_dim = channel_shared_ ? count : dim;
+    const int blocks_per_channel =
+        std::min(CAFFE_GET_BLOCKS(red_num * red_dim), 64);
+    param_buff_.Reshape(vector<int>(1, red_channels * blocks_per_channel));
+    PReLUParamBackwardStage1<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
+        <<<red_channels * blocks_per_channel, CAFFE_CUDA_NUM_THREADS>>>(
+        red_num, red_channels, red_dim, blocks_per_channel, top_diff,
+        bottom_data, param_buff_.mutable_gpu_data());
+    CUDA_POST_KERNEL_CHECK;
+    PReLUParamBackwardStage2<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
+        <<<red_channels, CAFFE_CUDA_NUM_THREADS>>>(
+        blocks_per_channel, param_buff_.gpu_data(), slope_diff);
     CUDA_POST_KERNEL_CHECK;
-    if (channel_shared_) {
-      Dtype dsum;
-      caffe_gpu_dot<Dtype>(channels * dim, backward_buff_.gpu_diff(),
-       multiplier_.gpu_data(), &dsum);
-      caffe_gpu_add_scalar(this->blobs_[0]->count(), Dtype(dsum), slope_diff);
-    } else {
-      caffe_gpu_gemv<Dtype>(CblasNoTrans, channels, dim, 1.,
-        backward_buff_.gpu_diff(), multiplier_.gpu_data(), 1.,
-        slope_diff);
-    }
   }
   // Propagate to bottom
   if (propagate_down[0]) {
@@ -26,12 +26,6 @@ void ReductionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   num_ = bottom[0]->count(0, axis_);
   dim_ = bottom[0]->count(axis_);
   CHECK_EQ(num_, top[0]->count());
-  if (op_ == ReductionParameter_ReductionOp_SUM ||
-      op_ == ReductionParameter_ReductionOp_MEAN) {
-    vector<int> sum_mult_shape(1, dim_);
-    sum_multiplier_.Reshape(sum_mult_shape);
-    caffe_set(dim_, Dtype(1), sum_multiplier_.mutable_cpu_data());
-  }
   coeff_ = this->layer_param().reduction_param().coeff();
   if (op_ == ReductionParameter_ReductionOp_MEAN) {
     coeff_ /= dim_;
@@ -42,33 +36,23 @@ template <typename Dtype>
 void ReductionLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* mult_data = NULL;
-  if (sum_multiplier_.count() > 0) {
-    mult_data = sum_multiplier_.cpu_data();
-  }
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int i = 0; i < num_; ++i) {
-    switch (op_) {
-    case ReductionParameter_ReductionOp_SUM:
-    case ReductionParameter_ReductionOp_MEAN:
-      *top_data = caffe_cpu_dot(dim_, mult_data, bottom_data);
-      break;
-    case ReductionParameter_ReductionOp_ASUM:
-      *top_data = caffe_cpu_asum(dim_, bottom_data);
-      break;
-    case ReductionParameter_ReductionOp_SUMSQ:
-      *top_data = caffe_cpu_dot(dim_, bottom_data, bottom_data);
-      break;
-    default:
-      LOG(FATAL) << "Unknown reduction op: "
-          << ReductionParameter_ReductionOp_Name(op_);
-    }
-    bottom_data += dim_;
-    ++top_data;
+  switch (op_) {
+  case ReductionParameter_ReductionOp_SUM:
+  case ReductionParameter_ReductionOp_MEAN:
+    caffe_cpu_slice_sum(num_, dim_, bottom_data, top_data);
+    break;
+  case ReductionParameter_ReductionOp_ASUM:
+    caffe_cpu_slice_asum(num_, dim_, bottom_data, top_data);
+    break;
+  case ReductionParameter_ReductionOp_SUMSQ:
+    caffe_cpu_slice_sumsq(num_, dim_, bottom_data, top_data);
+    break;
+  default:
+    LOG(FATAL) << "Unknown reduction op: "
+        << ReductionParameter_ReductionOp_Name(op_);
   }
   if (coeff_ != Dtype(1)) {
-    // Reset the top_data pointer.
-    top_data = top[0]->mutable_cpu_data();
     caffe_scal(num_, coeff_, top_data);
   }
 }
@@ -9,33 +9,25 @@ template <typename Dtype>
 void ReductionLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->gpu_data();
-  const Dtype* mult_data = NULL;
-  if (sum_multiplier_.count() > 0) {
-    mult_data = sum_multiplier_.gpu_data();
-  }
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int i = 0; i < num_; ++i) {
-    switch (op_) {
-    case ReductionParameter_ReductionOp_SUM:
-    case ReductionParameter_ReductionOp_MEAN:
-      caffe_gpu_dot(dim_, mult_data, bottom_data, top_data);
-      break;
-    case ReductionParameter_ReductionOp_ASUM:
-      caffe_gpu_asum(dim_, bottom_data, top_data);
-      break;
-    case ReductionParameter_ReductionOp_SUMSQ:
-      caffe_gpu_dot(dim_, bottom_data, bottom_data, top_data);
-      break;
-    default:
-      LOG(FATAL) << "Unknown reduction op: "
-          << ReductionParameter_ReductionOp_Name(op_);
-    }
-    bottom_data += dim_;
-    ++top_data;
+  // One launch reduces every slice on the device; the old per-slice
+  // dot/asum calls each synced the result back to the host.
+  Dtype* top_data = top[0]->mutable_gpu_data();
+  switch (op_) {
+  case ReductionParameter_ReductionOp_SUM:
+  case ReductionParameter_ReductionOp_MEAN:
+    caffe_gpu_slice_sum(num_, dim_, bottom_data, top_data);
+    break;
+  case ReductionParameter_ReductionOp_ASUM:
+    caffe_gpu_slice_asum(num_, dim_, bottom_data, top_data);
+    break;
+  case ReductionParameter_ReductionOp_SUMSQ:
+    caffe_gpu_slice_sumsq(num_, dim_, bottom_data, top_data);
+    break;
+  default:
+    LOG(FATAL) << "Unknown reduction op: "
+        << ReductionParameter_ReductionOp_Name(op_);
   }
   if (coeff_ != Dtype(1)) {
-    // Reset the top_data pointer.
-    top_data = top[0]->mutable_gpu_data();
     caffe_gpu_scal(num_, coeff_, top_data);
   }
 }
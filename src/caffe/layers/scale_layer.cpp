@@ -120,15 +120,27 @@ void ScaleLayer<Dtype>::Forward_cpu(
   const Dtype* scale_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
+  // When the bias broadcasts exactly like the scale (the only shape the
+  // setup above produces), apply both in one fused pass over the tensor
+  // instead of a second full pass through BiasLayer.
+  const Dtype* bias_data = NULL;
+  if (bias_layer_ && this->blobs_[bias_param_id_]->count() == scale_dim_) {
+    bias_data = this->blobs_[bias_param_id_]->cpu_data();
+  }
   for (int n = 0; n < outer_dim_; ++n) {
     for (int d = 0; d < scale_dim_; ++d) {
       const Dtype factor = scale_data[d];
-      caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
+      if (bias_data != NULL) {
+        caffe_cpu_axpb(inner_dim_, factor, bottom_data, bias_data[d],
+            top_data);
+      } else {
+        caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
+      }
       bottom_data += inner_dim_;
       top_data += inner_dim_;
     }
   }
-  if (bias_layer_) {
+  if (bias_layer_ && bias_data == NULL) {
     bias_layer_->Forward(bias_bottom_vec_, top);
   }
 }
@@ -70,6 +70,19 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top[0]->ShareData(*bottom[0]);
     top[0]->ShareDiff(*bottom[0]);
   }
+  // Tops wired as zero-copy views into the bottom (see
+  // Net::WireZeroCopyViews) are only valid at the offsets they were
+  // created for; if a reshape moved a slice, drop its view so Forward
+  // falls back to copying instead of aliasing the wrong range.
+  const SyncedMemory* bottom_mem = bottom[0]->data().get();
+  size_t offset = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    if (top[i]->data()->view_parent() == bottom_mem &&
+        top[i]->data()->view_offset() != offset * sizeof(Dtype)) {
+      top[i]->UnshareViews();
+    }
+    offset += top[i]->count();
+  }
 }
 
 template <typename Dtype>
@@ -33,8 +33,16 @@ void SliceLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
   const bool kForward = true;
   for (int i = 0; i < top.size(); ++i) {
-    Dtype* top_data = top[i]->mutable_gpu_data();
     const int top_slice_axis = top[i]->shape(slice_axis_);
+    // A top wired as a zero-copy view of the bottom already holds its
+    // slice (see Net::WireZeroCopyViews).
+    if (top[i]->data()->is_view_of(bottom[0]->data().get(),
+        static_cast<size_t>(offset_slice_axis) * slice_size_ *
+        sizeof(Dtype))) {
+      offset_slice_axis += top_slice_axis;
+      continue;
+    }
+    Dtype* top_data = top[i]->mutable_gpu_data();
     const int top_slice_size = top_slice_axis * slice_size_;
     const int nthreads = top_slice_size * num_slices_;
     Slice<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
@@ -54,8 +62,14 @@ void SliceLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
   const bool kForward = false;
   for (int i = 0; i < top.size(); ++i) {
-    const Dtype* top_diff = top[i]->gpu_diff();
     const int top_slice_axis = top[i]->shape(slice_axis_);
+    if (top[i]->diff()->is_view_of(bottom[0]->diff().get(),
+        static_cast<size_t>(offset_slice_axis) * slice_size_ *
+        sizeof(Dtype))) {
+      offset_slice_axis += top_slice_axis;
+      continue;
+    }
+    const Dtype* top_diff = top[i]->gpu_diff();
     const int top_slice_size = top_slice_axis * slice_size_;
     const int nthreads = top_slice_size * num_slices_;
     Slice<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
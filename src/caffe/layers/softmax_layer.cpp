@@ -6,6 +6,11 @@
 
 namespace caffe {
 
+// Spatial positions per tile of the blocked CPU engine, and the inner_num_
+// at which it takes over from the gemm/gemv broadcast path. 64 positions of
+// a 21-class float softmax keep the transposed tile well inside L1.
+const int kSoftmaxTileSize = 64;
+
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -21,6 +26,64 @@ void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   vector<int> scale_dims = bottom[0]->shape();
   scale_dims[softmax_axis_] = 1;
   scale_.Reshape(scale_dims);
+  if (inner_num_ >= kSoftmaxTileSize) {
+    vector<int> tile_dims(1,
+        kSoftmaxTileSize * bottom[0]->shape(softmax_axis_));
+    tile_buffer_.Reshape(tile_dims);
+  }
+}
+
+template <typename Dtype>
+void SoftmaxLayer<Dtype>::forward_cpu_blocked(const int channels,
+    const Dtype* bottom_data, Dtype* top_data) {
+  Dtype* tile = tile_buffer_.mutable_cpu_data();
+  const int dim = channels * inner_num_;
+  for (int i = 0; i < outer_num_; ++i) {
+    const Dtype* bottom = bottom_data + i * dim;
+    Dtype* top = top_data + i * dim;
+    for (int k0 = 0; k0 < inner_num_; k0 += kSoftmaxTileSize) {
+      const int block = std::min(kSoftmaxTileSize, inner_num_ - k0);
+      // Gather the tile position-major, so every channel vector below is
+      // contiguous. Each channel contributes one contiguous run of reads.
+      for (int j = 0; j < channels; ++j) {
+        const Dtype* in = bottom + j * inner_num_ + k0;
+        Dtype* out = tile + j;
+        for (int k = 0; k < block; ++k) {
+          out[k * channels] = in[k];
+        }
+      }
+      for (int k = 0; k < block; ++k) {
+        Dtype* row = tile + k * channels;
+        Dtype maxval = row[0];
+        for (int j = 1; j < channels; ++j) {
+          maxval = std::max(maxval, row[j]);
+        }
+        for (int j = 0; j < channels; ++j) {
+          row[j] -= maxval;
+        }
+      }
+      caffe_exp<Dtype>(block * channels, tile, tile);
+      for (int k = 0; k < block; ++k) {
+        Dtype* row = tile + k * channels;
+        Dtype sum = 0;
+        for (int j = 0; j < channels; ++j) {
+          sum += row[j];
+        }
+        const Dtype scale = Dtype(1) / sum;
+        for (int j = 0; j < channels; ++j) {
+          row[j] *= scale;
+        }
+      }
+      // Scatter back to the channel-major blob layout.
+      for (int j = 0; j < channels; ++j) {
+        const Dtype* in = tile + j;
+        Dtype* out = top + j * inner_num_ + k0;
+        for (int k = 0; k < block; ++k) {
+          out[k] = in[k * channels];
+        }
+      }
+    }
+  }
 }
 
 template <typename Dtype>
@@ -31,6 +94,13 @@ void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* scale_data = scale_.mutable_cpu_data();
   int channels = bottom[0]->shape(softmax_axis_);
   int dim = bottom[0]->count() / outer_num_;
+  // Large spatial softmax (e.g. dense prediction) walks the blob with
+  // stride inner_num_ in every step below; the blocked engine transposes a
+  // tile at a time and works on contiguous channel vectors instead.
+  if (inner_num_ >= kSoftmaxTileSize) {
+    forward_cpu_blocked(channels, bottom_data, top_data);
+    return;
+  }
   caffe_copy(bottom[0]->count(), bottom_data, top_data);
   // We need to subtract the max to avoid numerical issues, compute the exp,
   // and then normalize.
@@ -11,6 +11,12 @@ template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   LossLayer<Dtype>::LayerSetUp(bottom, top);
+  // With a single top nothing ever reads prob_, so the loss and gradient
+  // come straight from the bottom data via log-sum-exp and the prob blob
+  // (outer_num_ * channels * inner_num_, prohibitive for very wide
+  // classifiers) is never allocated. A second top needs the actual
+  // probabilities and keeps the internal softmax.
+  fused_ = top.size() == 1;
   LayerParameter softmax_param(this->layer_param_);
   softmax_param.set_type("Softmax");
   softmax_layer_ = LayerRegistry<Dtype>::CreateLayer(softmax_param);
@@ -53,6 +59,10 @@ void SoftmaxWithLossLayer<Dtype>::Reshape(
     // softmax output
     top[1]->ReshapeLike(*bottom[0]);
   }
+  if (fused_) {
+    vector<int> lse_dims(1, outer_num_ * inner_num_);
+    lse_.Reshape(lse_dims);
+  }
 }
 
 template <typename Dtype>
@@ -85,9 +95,51 @@ Dtype SoftmaxWithLossLayer<Dtype>::get_normalizer(
   return std::max(Dtype(1.0), normalizer);
 }
 
+template <typename Dtype>
+void SoftmaxWithLossLayer<Dtype>::forward_cpu_fused(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* label = bottom[1]->cpu_data();
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = bottom[0]->count() / outer_num_;
+  Dtype* lse_data = lse_.mutable_cpu_data();
+  int count = 0;
+  Dtype loss = 0;
+  for (int i = 0; i < outer_num_; ++i) {
+    for (int j = 0; j < inner_num_; ++j) {
+      const Dtype* x = bottom_data + i * dim + j;
+      Dtype maxval = x[0];
+      for (int c = 1; c < channels; ++c) {
+        maxval = std::max(maxval, x[c * inner_num_]);
+      }
+      Dtype sum = 0;
+      for (int c = 0; c < channels; ++c) {
+        sum += exp(x[c * inner_num_] - maxval);
+      }
+      const Dtype lse = maxval + log(sum);
+      lse_data[i * inner_num_ + j] = lse;
+      const int label_value = static_cast<int>(label[i * inner_num_ + j]);
+      if (has_ignore_label_ && label_value == ignore_label_) {
+        continue;
+      }
+      DCHECK_GE(label_value, 0);
+      DCHECK_LT(label_value, channels);
+      // -log(prob[label]) without forming the probability:
+      // lse - x[label] == -log(exp(x[label]) / sum exp(x)).
+      loss += lse - x[label_value * inner_num_];
+      ++count;
+    }
+  }
+  top[0]->mutable_cpu_data()[0] = loss / get_normalizer(normalization_, count);
+}
+
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (fused_) {
+    forward_cpu_fused(bottom, top);
+    return;
+  }
   // The forward pass computes the softmax prob values.
   softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
   const Dtype* prob_data = prob_.cpu_data();
@@ -114,6 +166,42 @@ void SoftmaxWithLossLayer<Dtype>::Forward_cpu(
   }
 }
 
+template <typename Dtype>
+void SoftmaxWithLossLayer<Dtype>::backward_cpu_fused(
+    const vector<Blob<Dtype>*>& top, const vector<Blob<Dtype>*>& bottom) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  const Dtype* label = bottom[1]->cpu_data();
+  const Dtype* lse_data = lse_.cpu_data();
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = bottom[0]->count() / outer_num_;
+  int count = 0;
+  for (int i = 0; i < outer_num_; ++i) {
+    for (int j = 0; j < inner_num_; ++j) {
+      const int label_value = static_cast<int>(label[i * inner_num_ + j]);
+      if (has_ignore_label_ && label_value == ignore_label_) {
+        for (int c = 0; c < channels; ++c) {
+          bottom_diff[i * dim + c * inner_num_ + j] = 0;
+        }
+        continue;
+      }
+      // The softmax probabilities come back from the cached log-sum-exp:
+      // prob[c] = exp(x[c] - lse).
+      const Dtype lse = lse_data[i * inner_num_ + j];
+      const Dtype* x = bottom_data + i * dim + j;
+      Dtype* dx = bottom_diff + i * dim + j;
+      for (int c = 0; c < channels; ++c) {
+        dx[c * inner_num_] = exp(x[c * inner_num_] - lse);
+      }
+      dx[label_value * inner_num_] -= 1;
+      ++count;
+    }
+  }
+  const Dtype loss_weight = top[0]->cpu_diff()[0] /
+                            get_normalizer(normalization_, count);
+  caffe_scal(bottom[0]->count(), loss_weight, bottom_diff);
+}
+
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
@@ -122,6 +210,10 @@ void SoftmaxWithLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
+    if (fused_) {
+      backward_cpu_fused(top, bottom);
+      return;
+    }
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const Dtype* prob_data = prob_.cpu_data();
     caffe_copy(prob_.count(), prob_data, bottom_diff);
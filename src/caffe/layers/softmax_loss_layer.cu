@@ -28,9 +28,71 @@ __global__ void SoftmaxLossForwardGPU(const int nthreads,
   }
 }
 
+// Fused forward: one thread per (n, s) position reduces its channel
+// column to a log-sum-exp and reads the loss straight off the bottom
+// data, so no prob blob exists. Adjacent threads touch adjacent memory
+// in every iteration of the channel loop.
+template <typename Dtype>
+__global__ void SoftmaxLossFusedForwardGPU(const int nthreads,
+          const Dtype* bottom_data, const Dtype* label, Dtype* lse,
+          Dtype* loss, const int num, const int dim, const int spatial_dim,
+          const bool has_ignore_label_, const int ignore_label_,
+          Dtype* counts) {
+  const int channels = dim / spatial_dim;
+  CUDA_KERNEL_LOOP(index, nthreads) {
+    const int n = index / spatial_dim;
+    const int s = index % spatial_dim;
+    const Dtype* x = bottom_data + n * dim + s;
+    Dtype maxval = x[0];
+    for (int c = 1; c < channels; ++c) {
+      maxval = max(maxval, x[c * spatial_dim]);
+    }
+    Dtype sum = 0;
+    for (int c = 0; c < channels; ++c) {
+      sum += exp(x[c * spatial_dim] - maxval);
+    }
+    const Dtype lse_val = maxval + log(sum);
+    lse[index] = lse_val;
+    const int label_value = static_cast<int>(label[n * spatial_dim + s]);
+    if (has_ignore_label_ && label_value == ignore_label_) {
+      loss[index] = 0;
+      counts[index] = 0;
+    } else {
+      loss[index] = lse_val - x[label_value * spatial_dim];
+      counts[index] = 1;
+    }
+  }
+}
+
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (fused_) {
+    const Dtype* bottom_data = bottom[0]->gpu_data();
+    const Dtype* label = bottom[1]->gpu_data();
+    const int dim = bottom[0]->count() / outer_num_;
+    const int nthreads = outer_num_ * inner_num_;
+    // As below, the bottom diff is dead until the backward pass
+    // overwrites it, so it doubles as the per-position loss buffer; the
+    // lse diff serves the same role for the counts.
+    Dtype* loss_data = bottom[0]->mutable_gpu_diff();
+    Dtype* counts = lse_.mutable_gpu_diff();
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    SoftmaxLossFusedForwardGPU<Dtype><<<CAFFE_GET_BLOCKS(nthreads),
+        CAFFE_CUDA_NUM_THREADS>>>(nthreads, bottom_data, label,
+        lse_.mutable_gpu_data(), loss_data, outer_num_, dim, inner_num_,
+        has_ignore_label_, ignore_label_, counts);
+    Dtype loss;
+    caffe_gpu_asum(nthreads, loss_data, &loss);
+    Dtype valid_count = -1;
+    if (normalization_ == LossParameter_NormalizationMode_VALID &&
+        has_ignore_label_) {
+      caffe_gpu_asum(nthreads, counts, &valid_count);
+    }
+    top[0]->mutable_cpu_data()[0] = loss / get_normalizer(normalization_,
+                                                          valid_count);
+    return;
+  }
   softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
   const Dtype* prob_data = prob_.gpu_data();
   const Dtype* label = bottom[1]->gpu_data();
@@ -63,6 +125,37 @@ void SoftmaxWithLossLayer<Dtype>::Forward_gpu(
   }
 }
 
+template <typename Dtype>
+__global__ void SoftmaxLossFusedBackwardGPU(const int nthreads,
+          const Dtype* bottom_data, const Dtype* label, const Dtype* lse,
+          Dtype* bottom_diff, const int num, const int dim,
+          const int spatial_dim, const bool has_ignore_label_,
+          const int ignore_label_, Dtype* counts) {
+  const int channels = dim / spatial_dim;
+  CUDA_KERNEL_LOOP(index, nthreads) {
+    const int n = index / spatial_dim;
+    const int s = index % spatial_dim;
+    const int label_value = static_cast<int>(label[n * spatial_dim + s]);
+    if (has_ignore_label_ && label_value == ignore_label_) {
+      for (int c = 0; c < channels; ++c) {
+        bottom_diff[n * dim + c * spatial_dim + s] = 0;
+      }
+      counts[index] = 0;
+    } else {
+      // prob[c] = exp(x[c] - lse), recovered from the cached forward
+      // reduction instead of a materialized prob blob.
+      const Dtype lse_val = lse[index];
+      const Dtype* x = bottom_data + n * dim + s;
+      Dtype* dx = bottom_diff + n * dim + s;
+      for (int c = 0; c < channels; ++c) {
+        dx[c * spatial_dim] = exp(x[c * spatial_dim] - lse_val);
+      }
+      dx[label_value * spatial_dim] -= 1;
+      counts[index] = 1;
+    }
+  }
+}
+
 template <typename Dtype>
 __global__ void SoftmaxLossBackwardGPU(const int nthreads, const Dtype* top,
           const Dtype* label, Dtype* bottom_diff, const int num, const int dim,
@@ -95,6 +188,27 @@ void SoftmaxWithLossLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
                << " Layer cannot backpropagate to label inputs.";
   }
   if (propagate_down[0]) {
+    if (fused_) {
+      Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+      const Dtype* label = bottom[1]->gpu_data();
+      const int dim = bottom[0]->count() / outer_num_;
+      const int nthreads = outer_num_ * inner_num_;
+      Dtype* counts = lse_.mutable_gpu_diff();
+      // NOLINT_NEXT_LINE(whitespace/operators)
+      SoftmaxLossFusedBackwardGPU<Dtype><<<CAFFE_GET_BLOCKS(nthreads),
+          CAFFE_CUDA_NUM_THREADS>>>(nthreads, bottom[0]->gpu_data(), label,
+          lse_.gpu_data(), bottom_diff, outer_num_, dim, inner_num_,
+          has_ignore_label_, ignore_label_, counts);
+      Dtype valid_count = -1;
+      if (normalization_ == LossParameter_NormalizationMode_VALID &&
+          has_ignore_label_) {
+        caffe_gpu_asum(nthreads, counts, &valid_count);
+      }
+      const Dtype loss_weight = top[0]->cpu_diff()[0] /
+                                get_normalizer(normalization_, valid_count);
+      caffe_gpu_scal(bottom[0]->count(), loss_weight, bottom_diff);
+      return;
+    }
     Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
     const Dtype* prob_data = prob_.gpu_data();
     const Dtype* top_data = top[0]->gpu_data();
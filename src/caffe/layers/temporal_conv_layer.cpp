@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/temporal_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void TemporalConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  use_temporal_ = !this->force_nd_im2col_ && this->num_spatial_axes_ == 2;
+  if (kernel[0] == 1 && kernel[1] > 1) {
+    // 1xK: time runs along the width; the height axis must pass through.
+    use_temporal_ = use_temporal_ && stride[0] == 1 && pad[0] == 0;
+  } else if (kernel[1] == 1 && kernel[0] > 1) {
+    // Kx1: time runs along the height; the width axis must pass through.
+    use_temporal_ = use_temporal_ && stride[1] == 1 && pad[1] == 0;
+  } else {
+    use_temporal_ = false;
+  }
+}
+
+// Accumulates one kernel tap over a contiguous run of time steps. Shift
+// is the tap's offset into the input (kw * dilation - pad); the bounds
+// clip the zero-padded borders so the loop body stays branch-free.
+template <typename Dtype>
+inline void TemporalConvTap(const Dtype* in, const Dtype weight,
+    const int shift, const int len_in, const int len_out, Dtype* out) {
+  const int start = std::max(0, -shift);
+  const int end = std::min(len_out, len_in - shift);
+  const Dtype* in_ptr = in + start + shift;
+  Dtype* out_ptr = out + start;
+  for (int o = start; o < end; ++o) {
+    *out_ptr++ += weight * *in_ptr++;
+  }
+}
+
+template <typename Dtype>
+void TemporalConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_temporal_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const bool time_on_width = kernel[0] == 1;
+  const int kernel_size = time_on_width ? kernel[1] : kernel[0];
+  const int time_stride = time_on_width ? stride[1] : stride[0];
+  const int time_pad = time_on_width ? pad[1] : pad[0];
+  const int time_dilation = time_on_width ? dilation[1] : dilation[0];
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int height_out = this->output_shape_[0];
+  const int width_out = this->output_shape_[1];
+  const int in_channels = this->conv_in_channels_ / this->group_;
+  const int out_channels = this->conv_out_channels_ / this->group_;
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      for (int g = 0; g < this->group_; ++g) {
+        const Dtype* in_group = bottom_data + n * this->bottom_dim_
+            + g * in_channels * height * width;
+        Dtype* out_group = top_data + n * this->top_dim_
+            + g * out_channels * height_out * width_out;
+        const Dtype* weight_group = weight + this->weight_offset_ * g;
+        for (int oc = 0; oc < out_channels; ++oc) {
+          Dtype* out = out_group + oc * height_out * width_out;
+          caffe_set(height_out * width_out, Dtype(0), out);
+          for (int ic = 0; ic < in_channels; ++ic) {
+            const Dtype* in = in_group + ic * height * width;
+            const Dtype* wk = weight_group
+                + (oc * in_channels + ic) * kernel_size;
+            if (time_on_width) {
+              // 1xK: every output row convolves the matching input row.
+              for (int oh = 0; oh < height_out; ++oh) {
+                const Dtype* in_row = in + oh * width;
+                Dtype* out_row = out + oh * width_out;
+                for (int k = 0; k < kernel_size; ++k) {
+                  const int shift = k * time_dilation - time_pad;
+                  if (time_stride == 1) {
+                    TemporalConvTap(in_row, wk[k], shift, width, width_out,
+                        out_row);
+                  } else {
+                    for (int ow = 0; ow < width_out; ++ow) {
+                      const int iw = ow * time_stride + shift;
+                      if (iw < 0 || iw >= width) { continue; }
+                      out_row[ow] += wk[k] * in_row[iw];
+                    }
+                  }
+                }
+              }
+            } else if (width == 1 && time_stride == 1) {
+              // Kx1 on a (num, channels, time, 1) blob: the time axis is
+              // contiguous, so each tap is one shifted vector accumulate.
+              for (int k = 0; k < kernel_size; ++k) {
+                TemporalConvTap(in, wk[k], k * time_dilation - time_pad,
+                    height, height_out, out);
+              }
+            } else {
+              // Kx1 with a true width axis: each tap adds a whole input
+              // row into the output row (contiguous along the width).
+              for (int oh = 0; oh < height_out; ++oh) {
+                Dtype* out_row = out + oh * width_out;
+                for (int k = 0; k < kernel_size; ++k) {
+                  const int ih = oh * time_stride + k * time_dilation
+                      - time_pad;
+                  if (ih < 0 || ih >= height) { continue; }
+                  caffe_axpy(width, wk[k], in + ih * width, out_row);
+                }
+              }
+            }
+          }
+        }
+      }
+      this->forward_cpu_epilogue(top_data + n * this->top_dim_,
+          this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(TemporalConvolutionLayer);
+
+}  // namespace caffe
@@ -3,11 +3,14 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <list>
 #include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
 #include "opencv2/core/core.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
@@ -27,6 +30,46 @@
 
 namespace caffe {
 
+// LRU cache of decoded images keyed by image index, bounded by the total
+// pixel bytes held. Only the prefetch thread touches it, so no locking;
+// an evicted cv::Mat stays valid for a caller still holding it because
+// cv::Mat refcounts its data.
+template <typename Dtype>
+class WindowDataLayer<Dtype>::DecodedCache {
+ public:
+  explicit DecodedCache(size_t capacity) : capacity_(capacity), size_(0) {}
+
+  bool Get(int image_index, cv::Mat* cv_img) {
+    typename EntryMap::iterator it = entries_.find(image_index);
+    if (it == entries_.end()) {
+      return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.second);
+    *cv_img = it->second.first;
+    return true;
+  }
+
+  void Put(int image_index, const cv::Mat& cv_img) {
+    lru_.push_front(image_index);
+    entries_[image_index] = std::make_pair(cv_img, lru_.begin());
+    size_ += cv_img.total() * cv_img.elemSize();
+    while (size_ > capacity_ && !lru_.empty()) {
+      const cv::Mat& victim = entries_[lru_.back()].first;
+      size_ -= victim.total() * victim.elemSize();
+      entries_.erase(lru_.back());
+      lru_.pop_back();
+    }
+  }
+
+ private:
+  typedef std::map<int, std::pair<cv::Mat, std::list<int>::iterator> >
+      EntryMap;
+  const size_t capacity_;
+  size_t size_;
+  std::list<int> lru_;
+  EntryMap entries_;
+};
+
 template <typename Dtype>
 WindowDataLayer<Dtype>::~WindowDataLayer<Dtype>() {
   this->StopInternalThread();
@@ -59,10 +102,21 @@ void WindowDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       << this->layer_param_.window_data_param().fg_fraction() << std::endl
       << "  cache_images: "
       << this->layer_param_.window_data_param().cache_images() << std::endl
+      << "  decoded_cache_size_mb: "
+      << this->layer_param_.window_data_param().decoded_cache_size_mb()
+      << std::endl
+      << "  crop_threads: "
+      << this->layer_param_.window_data_param().crop_threads() << std::endl
       << "  root_folder: "
       << this->layer_param_.window_data_param().root_folder();
 
   cache_images_ = this->layer_param_.window_data_param().cache_images();
+  const uint32_t decoded_cache_size_mb =
+      this->layer_param_.window_data_param().decoded_cache_size_mb();
+  if (decoded_cache_size_mb > 0) {
+    decoded_cache_.reset(new DecodedCache(
+        static_cast<size_t>(decoded_cache_size_mb) * 1024 * 1024));
+  }
   string root_folder = this->layer_param_.window_data_param().root_folder();
 
   const bool prefetch_needs_rand =
@@ -173,8 +227,8 @@ void WindowDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   CHECK_GT(crop_size, 0);
   const int batch_size = this->layer_param_.window_data_param().batch_size();
   top[0]->Reshape(batch_size, channels, crop_size, crop_size);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i)
-    this->prefetch_[i].data_.Reshape(
+  for (int i = 0; i < this->prefetch_.size(); ++i)
+    this->prefetch_[i]->data_.Reshape(
         batch_size, channels, crop_size, crop_size);
 
   LOG(INFO) << "output data size: " << top[0]->num() << ","
@@ -183,8 +237,8 @@ void WindowDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // label
   vector<int> label_shape(1, batch_size);
   top[1]->Reshape(label_shape);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].label_.Reshape(label_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->label_.Reshape(label_shape);
   }
 
   // data mean
@@ -235,27 +289,16 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer timer;
   Dtype* top_data = batch->data_.mutable_cpu_data();
   Dtype* top_label = batch->label_.mutable_cpu_data();
-  const Dtype scale = this->layer_param_.window_data_param().scale();
   const int batch_size = this->layer_param_.window_data_param().batch_size();
-  const int context_pad = this->layer_param_.window_data_param().context_pad();
-  const int crop_size = this->transform_param_.crop_size();
   const bool mirror = this->transform_param_.mirror();
   const float fg_fraction =
       this->layer_param_.window_data_param().fg_fraction();
-  Dtype* mean = NULL;
-  int mean_off = 0;
-  int mean_width = 0;
-  int mean_height = 0;
+  const int crop_threads = std::max(1,
+      static_cast<int>(this->layer_param_.window_data_param().crop_threads()));
+  const Dtype* mean = NULL;
   if (this->has_mean_file_) {
-    mean = this->data_mean_.mutable_cpu_data();
-    mean_off = (this->data_mean_.width() - crop_size) / 2;
-    mean_width = this->data_mean_.width();
-    mean_height = this->data_mean_.height();
+    mean = this->data_mean_.cpu_data();
   }
-  cv::Size cv_crop_size(crop_size, crop_size);
-  const string& crop_mode = this->layer_param_.window_data_param().crop_mode();
-
-  bool use_square = (crop_mode == "square") ? true : false;
 
   // zero out batch
   caffe_set(batch->data_.count(), Dtype(0), top_data);
@@ -264,6 +307,13 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       * fg_fraction);
   const int num_samples[2] = { batch_size - num_fg, num_fg };
 
+  // First pass: sample the windows and decode their source images, going
+  // through the decoded LRU cache so an image sampled for several windows
+  // (or still resident from a previous batch) is decoded only once.
+  // Sampling stays on this thread so the RNG sequence is unchanged.
+  vector<vector<float> > windows(batch_size);
+  vector<cv::Mat> images(batch_size);
+  vector<bool> mirrors(batch_size);
   int item_id = 0;
   // sample from bg set then fg set
   for (int is_fg = 0; is_fg < 2; ++is_fg) {
@@ -278,192 +328,245 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       bool do_mirror = mirror && PrefetchRand() % 2;
 
       // load the image containing the window
-      pair<std::string, vector<int> > image =
-          image_database_[window[WindowDataLayer<Dtype>::IMAGE_INDEX]];
-
+      const int image_index = window[WindowDataLayer<Dtype>::IMAGE_INDEX];
       cv::Mat cv_img;
-      if (this->cache_images_) {
-        pair<std::string, Datum> image_cached =
-          image_database_cache_[window[WindowDataLayer<Dtype>::IMAGE_INDEX]];
-        cv_img = DecodeDatumToCVMat(image_cached.second, true);
-      } else {
-        cv_img = cv::imread(image.first, CV_LOAD_IMAGE_COLOR);
-        if (!cv_img.data) {
-          LOG(ERROR) << "Could not open or find file " << image.first;
-          return;
-        }
-      }
-      read_time += timer.MicroSeconds();
-      timer.Start();
-      const int channels = cv_img.channels();
-
-      // crop window out of image and warp it
-      int x1 = window[WindowDataLayer<Dtype>::X1];
-      int y1 = window[WindowDataLayer<Dtype>::Y1];
-      int x2 = window[WindowDataLayer<Dtype>::X2];
-      int y2 = window[WindowDataLayer<Dtype>::Y2];
-
-      int pad_w = 0;
-      int pad_h = 0;
-      if (context_pad > 0 || use_square) {
-        // scale factor by which to expand the original region
-        // such that after warping the expanded region to crop_size x crop_size
-        // there's exactly context_pad amount of padding on each side
-        Dtype context_scale = static_cast<Dtype>(crop_size) /
-            static_cast<Dtype>(crop_size - 2*context_pad);
-
-        // compute the expanded region
-        Dtype half_height = static_cast<Dtype>(y2-y1+1)/2.0;
-        Dtype half_width = static_cast<Dtype>(x2-x1+1)/2.0;
-        Dtype center_x = static_cast<Dtype>(x1) + half_width;
-        Dtype center_y = static_cast<Dtype>(y1) + half_height;
-        if (use_square) {
-          if (half_height > half_width) {
-            half_width = half_height;
-          } else {
-            half_height = half_width;
-          }
-        }
-        x1 = static_cast<int>(round(center_x - half_width*context_scale));
-        x2 = static_cast<int>(round(center_x + half_width*context_scale));
-        y1 = static_cast<int>(round(center_y - half_height*context_scale));
-        y2 = static_cast<int>(round(center_y + half_height*context_scale));
-
-        // the expanded region may go outside of the image
-        // so we compute the clipped (expanded) region and keep track of
-        // the extent beyond the image
-        int unclipped_height = y2-y1+1;
-        int unclipped_width = x2-x1+1;
-        int pad_x1 = std::max(0, -x1);
-        int pad_y1 = std::max(0, -y1);
-        int pad_x2 = std::max(0, x2 - cv_img.cols + 1);
-        int pad_y2 = std::max(0, y2 - cv_img.rows + 1);
-        // clip bounds
-        x1 = x1 + pad_x1;
-        x2 = x2 - pad_x2;
-        y1 = y1 + pad_y1;
-        y2 = y2 - pad_y2;
-        CHECK_GT(x1, -1);
-        CHECK_GT(y1, -1);
-        CHECK_LT(x2, cv_img.cols);
-        CHECK_LT(y2, cv_img.rows);
-
-        int clipped_height = y2-y1+1;
-        int clipped_width = x2-x1+1;
-
-        // scale factors that would be used to warp the unclipped
-        // expanded region
-        Dtype scale_x =
-            static_cast<Dtype>(crop_size)/static_cast<Dtype>(unclipped_width);
-        Dtype scale_y =
-            static_cast<Dtype>(crop_size)/static_cast<Dtype>(unclipped_height);
-
-        // size to warp the clipped expanded region to
-        cv_crop_size.width =
-            static_cast<int>(round(static_cast<Dtype>(clipped_width)*scale_x));
-        cv_crop_size.height =
-            static_cast<int>(round(static_cast<Dtype>(clipped_height)*scale_y));
-        pad_x1 = static_cast<int>(round(static_cast<Dtype>(pad_x1)*scale_x));
-        pad_x2 = static_cast<int>(round(static_cast<Dtype>(pad_x2)*scale_x));
-        pad_y1 = static_cast<int>(round(static_cast<Dtype>(pad_y1)*scale_y));
-        pad_y2 = static_cast<int>(round(static_cast<Dtype>(pad_y2)*scale_y));
-
-        pad_h = pad_y1;
-        // if we're mirroring, we mirror the padding too (to be pedantic)
-        if (do_mirror) {
-          pad_w = pad_x2;
+      if (!decoded_cache_ || !decoded_cache_->Get(image_index, &cv_img)) {
+        if (this->cache_images_) {
+          cv_img = DecodeDatumToCVMat(
+              image_database_cache_[image_index].second, true);
         } else {
-          pad_w = pad_x1;
-        }
-
-        // ensure that the warped, clipped region plus the padding fits in the
-        // crop_size x crop_size image (it might not due to rounding)
-        if (pad_h + cv_crop_size.height > crop_size) {
-          cv_crop_size.height = crop_size - pad_h;
+          cv_img = cv::imread(image_database_[image_index].first,
+              CV_LOAD_IMAGE_COLOR);
+          if (!cv_img.data) {
+            LOG(ERROR) << "Could not open or find file "
+                << image_database_[image_index].first;
+            return;
+          }
         }
-        if (pad_w + cv_crop_size.width > crop_size) {
-          cv_crop_size.width = crop_size - pad_w;
+        if (decoded_cache_) {
+          decoded_cache_->Put(image_index, cv_img);
         }
       }
+      read_time += timer.MicroSeconds();
 
-      cv::Rect roi(x1, y1, x2-x1+1, y2-y1+1);
-      cv::Mat cv_cropped_img = cv_img(roi);
-      cv::resize(cv_cropped_img, cv_cropped_img,
-          cv_crop_size, 0, 0, cv::INTER_LINEAR);
+      windows[item_id] = window;
+      images[item_id] = cv_img;
+      mirrors[item_id] = do_mirror;
+      // get window label
+      top_label[item_id] = window[WindowDataLayer<Dtype>::LABEL];
+      item_id++;
+    }
+  }
 
-      // horizontal flip at random
-      if (do_mirror) {
-        cv::flip(cv_cropped_img, cv_cropped_img, 1);
-      }
+  // Second pass: crop and warp the sampled windows, in parallel when
+  // requested. Each item writes only its own batch slice.
+  timer.Start();
+  if (crop_threads > 1) {
+    boost::thread_group workers;
+    for (int w = 0; w < crop_threads; ++w) {
+      workers.add_thread(new boost::thread(boost::bind(
+          &WindowDataLayer<Dtype>::CropWorker, this, &windows, &images,
+          &mirrors, mean, w, crop_threads, top_data)));
+    }
+    workers.join_all();
+  } else {
+    for (int i = 0; i < batch_size; ++i) {
+      ProcessWindow(windows[i], images[i], mirrors[i], mean, i, top_data);
+    }
+  }
+  trans_time += timer.MicroSeconds();
+  batch_timer.Stop();
+  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+}
 
-      // copy the warped window into top_data
-      for (int h = 0; h < cv_cropped_img.rows; ++h) {
-        const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
-        int img_index = 0;
-        for (int w = 0; w < cv_cropped_img.cols; ++w) {
-          for (int c = 0; c < channels; ++c) {
-            int top_index = ((item_id * channels + c) * crop_size + h + pad_h)
-                     * crop_size + w + pad_w;
-            // int top_index = (c * height + h) * width + w;
-            Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
-            if (this->has_mean_file_) {
-              int mean_index = (c * mean_height + h + mean_off + pad_h)
-                           * mean_width + w + mean_off + pad_w;
-              top_data[top_index] = (pixel - mean[mean_index]) * scale;
-            } else {
-              if (this->has_mean_values_) {
-                top_data[top_index] = (pixel - this->mean_values_[c]) * scale;
-              } else {
-                top_data[top_index] = pixel * scale;
-              }
-            }
-          }
-        }
+template <typename Dtype>
+void WindowDataLayer<Dtype>::CropWorker(const vector<vector<float> >* windows,
+    const vector<cv::Mat>* images, const vector<bool>* mirrors,
+    const Dtype* mean, int first, int stride, Dtype* top_data) {
+  for (int i = first; i < static_cast<int>(windows->size()); i += stride) {
+    ProcessWindow((*windows)[i], (*images)[i], (*mirrors)[i], mean, i,
+        top_data);
+  }
+}
+
+template <typename Dtype>
+void WindowDataLayer<Dtype>::ProcessWindow(const vector<float>& window,
+    const cv::Mat& cv_img, bool do_mirror, const Dtype* mean, int item_id,
+    Dtype* top_data) {
+  const Dtype scale = this->layer_param_.window_data_param().scale();
+  const int context_pad = this->layer_param_.window_data_param().context_pad();
+  const int crop_size = this->transform_param_.crop_size();
+  const string& crop_mode = this->layer_param_.window_data_param().crop_mode();
+  const bool use_square = (crop_mode == "square") ? true : false;
+  int mean_off = 0;
+  int mean_width = 0;
+  int mean_height = 0;
+  if (this->has_mean_file_) {
+    mean_off = (this->data_mean_.width() - crop_size) / 2;
+    mean_width = this->data_mean_.width();
+    mean_height = this->data_mean_.height();
+  }
+  cv::Size cv_crop_size(crop_size, crop_size);
+  const int channels = cv_img.channels();
+
+  // crop window out of image and warp it
+  int x1 = window[WindowDataLayer<Dtype>::X1];
+  int y1 = window[WindowDataLayer<Dtype>::Y1];
+  int x2 = window[WindowDataLayer<Dtype>::X2];
+  int y2 = window[WindowDataLayer<Dtype>::Y2];
+
+  int pad_w = 0;
+  int pad_h = 0;
+  if (context_pad > 0 || use_square) {
+    // scale factor by which to expand the original region
+    // such that after warping the expanded region to crop_size x crop_size
+    // there's exactly context_pad amount of padding on each side
+    Dtype context_scale = static_cast<Dtype>(crop_size) /
+        static_cast<Dtype>(crop_size - 2*context_pad);
+
+    // compute the expanded region
+    Dtype half_height = static_cast<Dtype>(y2-y1+1)/2.0;
+    Dtype half_width = static_cast<Dtype>(x2-x1+1)/2.0;
+    Dtype center_x = static_cast<Dtype>(x1) + half_width;
+    Dtype center_y = static_cast<Dtype>(y1) + half_height;
+    if (use_square) {
+      if (half_height > half_width) {
+        half_width = half_height;
+      } else {
+        half_height = half_width;
       }
-      trans_time += timer.MicroSeconds();
-      // get window label
-      top_label[item_id] = window[WindowDataLayer<Dtype>::LABEL];
+    }
+    x1 = static_cast<int>(round(center_x - half_width*context_scale));
+    x2 = static_cast<int>(round(center_x + half_width*context_scale));
+    y1 = static_cast<int>(round(center_y - half_height*context_scale));
+    y2 = static_cast<int>(round(center_y + half_height*context_scale));
+
+    // the expanded region may go outside of the image
+    // so we compute the clipped (expanded) region and keep track of
+    // the extent beyond the image
+    int unclipped_height = y2-y1+1;
+    int unclipped_width = x2-x1+1;
+    int pad_x1 = std::max(0, -x1);
+    int pad_y1 = std::max(0, -y1);
+    int pad_x2 = std::max(0, x2 - cv_img.cols + 1);
+    int pad_y2 = std::max(0, y2 - cv_img.rows + 1);
+    // clip bounds
+    x1 = x1 + pad_x1;
+    x2 = x2 - pad_x2;
+    y1 = y1 + pad_y1;
+    y2 = y2 - pad_y2;
+    CHECK_GT(x1, -1);
+    CHECK_GT(y1, -1);
+    CHECK_LT(x2, cv_img.cols);
+    CHECK_LT(y2, cv_img.rows);
+
+    int clipped_height = y2-y1+1;
+    int clipped_width = x2-x1+1;
+
+    // scale factors that would be used to warp the unclipped
+    // expanded region
+    Dtype scale_x =
+        static_cast<Dtype>(crop_size)/static_cast<Dtype>(unclipped_width);
+    Dtype scale_y =
+        static_cast<Dtype>(crop_size)/static_cast<Dtype>(unclipped_height);
+
+    // size to warp the clipped expanded region to
+    cv_crop_size.width =
+        static_cast<int>(round(static_cast<Dtype>(clipped_width)*scale_x));
+    cv_crop_size.height =
+        static_cast<int>(round(static_cast<Dtype>(clipped_height)*scale_y));
+    pad_x1 = static_cast<int>(round(static_cast<Dtype>(pad_x1)*scale_x));
+    pad_x2 = static_cast<int>(round(static_cast<Dtype>(pad_x2)*scale_x));
+    pad_y1 = static_cast<int>(round(static_cast<Dtype>(pad_y1)*scale_y));
+    pad_y2 = static_cast<int>(round(static_cast<Dtype>(pad_y2)*scale_y));
+
+    pad_h = pad_y1;
+    // if we're mirroring, we mirror the padding too (to be pedantic)
+    if (do_mirror) {
+      pad_w = pad_x2;
+    } else {
+      pad_w = pad_x1;
+    }
+
+    // ensure that the warped, clipped region plus the padding fits in the
+    // crop_size x crop_size image (it might not due to rounding)
+    if (pad_h + cv_crop_size.height > crop_size) {
+      cv_crop_size.height = crop_size - pad_h;
+    }
+    if (pad_w + cv_crop_size.width > crop_size) {
+      cv_crop_size.width = crop_size - pad_w;
+    }
+  }
+
+  cv::Rect roi(x1, y1, x2-x1+1, y2-y1+1);
+  cv::Mat cv_cropped_img = cv_img(roi);
+  cv::resize(cv_cropped_img, cv_cropped_img,
+      cv_crop_size, 0, 0, cv::INTER_LINEAR);
+
+  // horizontal flip at random
+  if (do_mirror) {
+    cv::flip(cv_cropped_img, cv_cropped_img, 1);
+  }
 
-      #if 0
-      // useful debugging code for dumping transformed windows to disk
-      string file_id;
-      std::stringstream ss;
-      ss << PrefetchRand();
-      ss >> file_id;
-      std::ofstream inf((string("dump/") + file_id +
-          string("_info.txt")).c_str(), std::ofstream::out);
-      inf << image.first << std::endl
-          << window[WindowDataLayer<Dtype>::X1]+1 << std::endl
-          << window[WindowDataLayer<Dtype>::Y1]+1 << std::endl
-          << window[WindowDataLayer<Dtype>::X2]+1 << std::endl
-          << window[WindowDataLayer<Dtype>::Y2]+1 << std::endl
-          << do_mirror << std::endl
-          << top_label[item_id] << std::endl
-          << is_fg << std::endl;
-      inf.close();
-      std::ofstream top_data_file((string("dump/") + file_id +
-          string("_data.txt")).c_str(),
-          std::ofstream::out | std::ofstream::binary);
+  // copy the warped window into top_data
+  for (int h = 0; h < cv_cropped_img.rows; ++h) {
+    const uchar* ptr = cv_cropped_img.ptr<uchar>(h);
+    int img_index = 0;
+    for (int w = 0; w < cv_cropped_img.cols; ++w) {
       for (int c = 0; c < channels; ++c) {
-        for (int h = 0; h < crop_size; ++h) {
-          for (int w = 0; w < crop_size; ++w) {
-            top_data_file.write(reinterpret_cast<char*>(
-                &top_data[((item_id * channels + c) * crop_size + h)
-                          * crop_size + w]),
-                sizeof(Dtype));
+        int top_index = ((item_id * channels + c) * crop_size + h + pad_h)
+                 * crop_size + w + pad_w;
+        // int top_index = (c * height + h) * width + w;
+        Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
+        if (this->has_mean_file_) {
+          int mean_index = (c * mean_height + h + mean_off + pad_h)
+                       * mean_width + w + mean_off + pad_w;
+          top_data[top_index] = (pixel - mean[mean_index]) * scale;
+        } else {
+          if (this->has_mean_values_) {
+            top_data[top_index] = (pixel - this->mean_values_[c]) * scale;
+          } else {
+            top_data[top_index] = pixel * scale;
           }
         }
       }
-      top_data_file.close();
-      #endif
+    }
+  }
 
-      item_id++;
+  #if 0
+  // useful debugging code for dumping transformed windows to disk
+  string file_id;
+  std::stringstream ss;
+  ss << item_id;
+  ss >> file_id;
+  std::ofstream inf((string("dump/") + file_id +
+      string("_info.txt")).c_str(), std::ofstream::out);
+  inf << image_database_[window[WindowDataLayer<Dtype>::IMAGE_INDEX]].first
+      << std::endl
+      << window[WindowDataLayer<Dtype>::X1]+1 << std::endl
+      << window[WindowDataLayer<Dtype>::Y1]+1 << std::endl
+      << window[WindowDataLayer<Dtype>::X2]+1 << std::endl
+      << window[WindowDataLayer<Dtype>::Y2]+1 << std::endl
+      << do_mirror << std::endl
+      << window[WindowDataLayer<Dtype>::LABEL] << std::endl;
+  inf.close();
+  std::ofstream top_data_file((string("dump/") + file_id +
+      string("_data.txt")).c_str(),
+      std::ofstream::out | std::ofstream::binary);
+  for (int c = 0; c < channels; ++c) {
+    for (int h = 0; h < crop_size; ++h) {
+      for (int w = 0; w < crop_size; ++w) {
+        top_data_file.write(reinterpret_cast<char*>(
+            &top_data[((item_id * channels + c) * crop_size + h)
+                      * crop_size + w]),
+            sizeof(Dtype));
+      }
     }
   }
-  batch_timer.Stop();
-  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  top_data_file.close();
+  #endif
 }
 
 INSTANTIATE_CLASS(WindowDataLayer);
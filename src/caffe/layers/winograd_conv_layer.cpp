@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// F(2x2,3x3) transform matrices, applied as two passes of the same
+// one-dimensional operation (rows, then columns of the intermediate):
+//   weights:  U = G g G^T,    G   = [1 0 0; .5 .5 .5; .5 -.5 .5; 0 0 1]
+//   input:    V = B^T d B,    B^T = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1]
+//   output:   Y = A^T m A,    A^T = [1 1 1 0; 0 1 -1 -1]
+
+template <typename Dtype>
+inline void WinogradWeightTransform(const Dtype* g, Dtype* u) {
+  Dtype t[4][3];
+  for (int i = 0; i < 3; ++i) {
+    const Dtype g0 = g[i], g1 = g[3 + i], g2 = g[6 + i];
+    t[0][i] = g0;
+    t[1][i] = (g0 + g1 + g2) * Dtype(0.5);
+    t[2][i] = (g0 - g1 + g2) * Dtype(0.5);
+    t[3][i] = g2;
+  }
+  for (int i = 0; i < 4; ++i) {
+    const Dtype g0 = t[i][0], g1 = t[i][1], g2 = t[i][2];
+    u[i * 4 + 0] = g0;
+    u[i * 4 + 1] = (g0 + g1 + g2) * Dtype(0.5);
+    u[i * 4 + 2] = (g0 - g1 + g2) * Dtype(0.5);
+    u[i * 4 + 3] = g2;
+  }
+}
+
+template <typename Dtype>
+inline void WinogradInputTransform(const Dtype* d, Dtype* v) {
+  Dtype t[4][4];
+  for (int i = 0; i < 4; ++i) {
+    const Dtype d0 = d[i], d1 = d[4 + i], d2 = d[8 + i], d3 = d[12 + i];
+    t[0][i] = d0 - d2;
+    t[1][i] = d1 + d2;
+    t[2][i] = d2 - d1;
+    t[3][i] = d1 - d3;
+  }
+  for (int i = 0; i < 4; ++i) {
+    const Dtype d0 = t[i][0], d1 = t[i][1], d2 = t[i][2], d3 = t[i][3];
+    v[i * 4 + 0] = d0 - d2;
+    v[i * 4 + 1] = d1 + d2;
+    v[i * 4 + 2] = d2 - d1;
+    v[i * 4 + 3] = d1 - d3;
+  }
+}
+
+template <typename Dtype>
+inline void WinogradOutputTransform(const Dtype* m, Dtype* y) {
+  Dtype t[2][4];
+  for (int i = 0; i < 4; ++i) {
+    const Dtype m0 = m[i], m1 = m[4 + i], m2 = m[8 + i], m3 = m[12 + i];
+    t[0][i] = m0 + m1 + m2;
+    t[1][i] = m1 - m2 - m3;
+  }
+  for (int i = 0; i < 2; ++i) {
+    const Dtype m0 = t[i][0], m1 = t[i][1], m2 = t[i][2], m3 = t[i][3];
+    y[i * 2 + 0] = m0 + m1 + m2;
+    y[i * 2 + 1] = m1 - m2 - m3;
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  use_winograd_ = !this->force_nd_im2col_ && this->num_spatial_axes_ == 2
+      && kernel[0] == 3 && kernel[1] == 3
+      && stride[0] == 1 && stride[1] == 1
+      && dilation[0] == 1 && dilation[1] == 1;
+  if (!use_winograd_) { return; }
+  const int in_channels = this->conv_in_channels_ / this->group_;
+  const int out_channels = this->conv_out_channels_ / this->group_;
+  const int tiles_h = (this->output_shape_[0] + 1) / 2;
+  const int tiles_w = (this->output_shape_[1] + 1) / 2;
+  vector<int> shape(3);
+  shape[0] = 16;
+  shape[1] = this->conv_out_channels_;
+  shape[2] = in_channels;
+  weight_wino_.Reshape(shape);
+  shape[1] = in_channels;
+  shape[2] = tiles_h * tiles_w;
+  input_wino_.Reshape(shape);
+  shape[1] = out_channels;
+  output_wino_.Reshape(shape);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformWeights() {
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const int in_channels = this->conv_in_channels_ / this->group_;
+  Dtype* u_data = weight_wino_.mutable_cpu_data();
+  const int filters = this->conv_out_channels_ * in_channels;
+  Dtype u[16];
+  for (int f = 0; f < filters; ++f) {
+    WinogradWeightTransform(weight + f * 9, u);
+    // Scatter into the 16 per-frequency [num_output x channels] matrices.
+    for (int k = 0; k < 16; ++k) {
+      u_data[k * filters + f] = u[k];
+    }
+  }
+  weights_transformed_ = true;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  if (!weights_transformed_ || this->phase_ == TRAIN) {
+    TransformWeights();
+  }
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int height_out = this->output_shape_[0];
+  const int width_out = this->output_shape_[1];
+  const int in_channels = this->conv_in_channels_ / this->group_;
+  const int out_channels = this->conv_out_channels_ / this->group_;
+  const int tiles_h = (height_out + 1) / 2;
+  const int tiles_w = (width_out + 1) / 2;
+  const int tiles = tiles_h * tiles_w;
+  const int filters = this->conv_out_channels_ * in_channels;
+  const Dtype* u_data = weight_wino_.cpu_data();
+  Dtype* v_data = input_wino_.mutable_cpu_data();
+  Dtype* m_data = output_wino_.mutable_cpu_data();
+  Dtype d[16], v[16], m[16], y[4];
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      for (int g = 0; g < this->group_; ++g) {
+        const Dtype* in_group = bottom_data + n * this->bottom_dim_
+            + g * in_channels * height * width;
+        Dtype* out_group = top_data + n * this->top_dim_
+            + g * out_channels * height_out * width_out;
+        // Transform the input tiles, one 4x4 patch per 2x2 output tile.
+        for (int ic = 0; ic < in_channels; ++ic) {
+          const Dtype* in = in_group + ic * height * width;
+          for (int p = 0; p < tiles; ++p) {
+            const int ih0 = (p / tiles_w) * 2 - pad_h;
+            const int iw0 = (p % tiles_w) * 2 - pad_w;
+            for (int r = 0; r < 4; ++r) {
+              const int ih = ih0 + r;
+              for (int c = 0; c < 4; ++c) {
+                const int iw = iw0 + c;
+                d[r * 4 + c] =
+                    (ih >= 0 && ih < height && iw >= 0 && iw < width) ?
+                    in[ih * width + iw] : Dtype(0);
+              }
+            }
+            WinogradInputTransform(d, v);
+            for (int k = 0; k < 16; ++k) {
+              v_data[(k * in_channels + ic) * tiles + p] = v[k];
+            }
+          }
+        }
+        // The elementwise products across channels are 16 GEMMs.
+        for (int k = 0; k < 16; ++k) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_channels,
+              tiles, in_channels, (Dtype)1.,
+              u_data + k * filters + g * out_channels * in_channels,
+              v_data + k * in_channels * tiles, (Dtype)0.,
+              m_data + k * out_channels * tiles);
+        }
+        // Inverse-transform each tile into the output, clipping edge
+        // tiles that extend past odd output sizes.
+        for (int oc = 0; oc < out_channels; ++oc) {
+          Dtype* out = out_group + oc * height_out * width_out;
+          for (int p = 0; p < tiles; ++p) {
+            for (int k = 0; k < 16; ++k) {
+              m[k] = m_data[(k * out_channels + oc) * tiles + p];
+            }
+            WinogradOutputTransform(m, y);
+            const int oh0 = (p / tiles_w) * 2;
+            const int ow0 = (p % tiles_w) * 2;
+            for (int r = 0; r < 2; ++r) {
+              if (oh0 + r >= height_out) { continue; }
+              for (int c = 0; c < 2; ++c) {
+                if (ow0 + c >= width_out) { continue; }
+                out[(oh0 + r) * width_out + ow0 + c] = y[r * 2 + c];
+              }
+            }
+          }
+        }
+      }
+      this->forward_cpu_epilogue(top_data + n * this->top_dim_,
+          this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
@@ -1,6 +1,15 @@
+#include <boost/thread.hpp>
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <sys/time.h>
+
 #include <algorithm>
+#include <climits>
+#include <cmath>
 #include <map>
 #include <set>
+#include <sstream>  // NOLINT(readability/streams)
 #include <string>
 #include <utility>
 #include <vector>
@@ -9,33 +18,61 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/crop_layer.hpp"
+#include "caffe/layers/fused_eltwise_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blas_threads.hpp"
+#include "caffe/util/chrome_trace.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/nvtx.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
 namespace caffe {
 
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::FileInputStream;
+
 template <typename Dtype>
-Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
-    : root_net_(root_net) {
+Net<Dtype>::Net(const NetParameter& param, const Net* root_net,
+    const Net* share_params_from)
+    : root_net_(root_net), share_params_from_(share_params_from) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), share_params_from_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   param.mutable_state()->set_phase(phase);
   Init(param);
 }
 
+template <typename Dtype>
+Net<Dtype>::~Net() {
+  if (async_loss_) { set_async_loss(false); }
+#ifndef CPU_ONLY
+  InvalidateForwardGraph();
+  for (int i = 0; i < update_events_.size(); ++i) {
+    cudaEventDestroy(update_events_[i]);
+  }
+  for (int i = 0; i < profile_events_.size(); ++i) {
+    cudaEventDestroy(profile_events_[i]);
+  }
+#endif
+}
+
 template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   CHECK(Caffe::root_solver() || root_net_)
@@ -49,14 +86,54 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
+  // Fold inference BatchNorm/Scale chains into their convolutions before
+  // splits are inserted; the parameter arithmetic happens at load time in
+  // CopyTrainedLayersFrom.
+  if (phase_ == TEST && filtered_param.fold_batch_norm()) {
+    NetParameter folded_param;
+    FoldBatchNorm(filtered_param, &folded_param);
+    filtered_param.Swap(&folded_param);
+  }
+  // Apply the host memory placement policy before any layer is set up:
+  // blobs and prefetch Batch buffers fault their pages in from here on,
+  // and internal threads started below inherit the policy.
+  if (filtered_param.has_numa_policy()) {
+    Caffe::set_numa_policy(
+        static_cast<Caffe::NumaPolicy>(filtered_param.numa_policy()));
+  }
+  // Compile step: drop layers that are identities in this phase.
+  {
+    NetParameter compiled_param;
+    CompileNet(filtered_param, &compiled_param);
+    filtered_param.Swap(&compiled_param);
+  }
   // Create a copy of filtered_param with splits added where necessary.
+  // A forward-only net elides them: SplitLayer's forward is a ShareData
+  // no-op, every consumer can read the shared blob directly, and the
+  // gradient accumulation splits exist for can never run.
   NetParameter param;
-  InsertSplits(filtered_param, &param);
+  if (filtered_param.forward_only()) {
+    param.CopyFrom(filtered_param);
+  } else {
+    InsertSplits(filtered_param, &param);
+  }
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
   set<string> available_blobs;
   memory_used_ = 0;
+  forward_parallelism_ = 1;
+  async_loss_ = false;
+  async_loss_pinned_ = NULL;
+  async_loss_slot_count_ = 0;
+  async_loss_pending_ = false;
+  async_loss_last_ = 0;
+  activations_shared_ = false;
+  forward_only_ = false;
+  checkpointing_ = false;
+  debug_info_sample_ = 0;
+  debug_sample_iter_ = 0;
+  debug_sample_this_iter_ = false;
   // For each layer, set up its input and output
   bottom_vecs_.resize(param.layer_size());
   top_vecs_.resize(param.layer_size());
@@ -64,6 +141,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   param_id_vecs_.resize(param.layer_size());
   top_id_vecs_.resize(param.layer_size());
   bottom_need_backward_.resize(param.layer_size());
+  layer_fused_.resize(param.layer_size(), false);
   for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
     // For non-root solvers, whether this layer is shared from root_net_.
     bool share_from_root = !Caffe::root_solver()
@@ -136,7 +214,61 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
             << layer_param.name();
       }
     } else {
+      // Convolution layers borrow one net-owned column buffer: they run
+      // sequentially, so the scratch can be common instead of per-layer,
+      // and Blob::Reshape sizes it to the largest layer's needs. Under
+      // dataflow parallelism convolutions in independent branches run
+      // concurrently and would race on the shared arena, so they keep
+      // their private buffers.
+      if (param.forward_parallelism() <= 1) {
+        BaseConvolutionLayer<Dtype>* conv_layer =
+            dynamic_cast<BaseConvolutionLayer<Dtype>*>(
+                layers_[layer_id].get());
+        if (conv_layer != NULL) {
+          if (!col_buffer_arena_) {
+            col_buffer_arena_.reset(new Blob<Dtype>());
+          }
+          conv_layer->set_shared_col_buffer(col_buffer_arena_);
+        }
+      }
+      // At inference time, fold an in-place ReLU that is the sole
+      // consumer of a convolution output into the convolution epilogue:
+      // the ReLU layer drops out of the forward schedule and bias-add
+      // plus max(0, x) happen in the same pass as the GEMM output.
+      // Deconvolution is excluded; only ConvolutionLayer and its engine
+      // subclasses implement the fused epilogue.
+      if (phase_ == TEST && layer_param.top_size() == 1 &&
+          dynamic_cast<ConvolutionLayer<Dtype>*>(layers_[layer_id].get())) {
+        const string& top_name = layer_param.top(0);
+        for (int next_id = layer_id + 1; next_id < param.layer_size();
+             ++next_id) {
+          const LayerParameter& next_param = param.layer(next_id);
+          bool consumes = false;
+          for (int k = 0; k < next_param.bottom_size(); ++k) {
+            consumes |= next_param.bottom(k) == top_name;
+          }
+          if (!consumes) { continue; }
+          // Only the first consumer may be fused; anything else reading
+          // the blob in between would see rectified data too early.
+          if (next_param.type() == "ReLU" && next_param.bottom_size() == 1 &&
+              next_param.top_size() == 1 && next_param.top(0) == top_name &&
+              next_param.relu_param().negative_slope() == 0) {
+            dynamic_cast<ConvolutionLayer<Dtype>*>(layers_[layer_id].get())
+                ->set_fused_relu(true);
+            layer_fused_[next_id] = true;
+            LOG_IF(INFO, Caffe::root_solver())
+                << "Fusing ReLU layer " << next_param.name()
+                << " into convolution layer " << layer_param.name();
+          }
+          break;
+        }
+      }
       layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+      if (share_params_from_) {
+        // Share the owner's param storage right away, so the transient
+        // second copy never outlives this one layer's setup.
+        ShareLayerParamsFrom(share_params_from_, layer_id);
+      }
     }
     LOG_IF(INFO, Caffe::root_solver())
         << "Setting up " << layer_names_[layer_id];
@@ -185,18 +317,20 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // Also checks if all bottom blobs don't need backward computation (possible
   // because the skip_propagate_down param) and so we can skip bacward
   // computation for the entire layer
-  set<string> blobs_under_loss;
-  set<string> blobs_skip_backp;
+  // Blob names were already resolved to ids during the layer walk above,
+  // so the analysis tracks blob ids directly; on deeply unrolled nets the
+  // string-set lookups this replaces used to dominate Init.
+  vector<bool> blob_under_loss(blobs_.size(), false);
+  vector<bool> blob_skip_backp(blobs_.size(), false);
   for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
     bool layer_contributes_loss = false;
     bool layer_skip_propagate_down = true;
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
-      const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
-      if (layers_[layer_id]->loss(top_id) ||
-          (blobs_under_loss.find(blob_name) != blobs_under_loss.end())) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (layers_[layer_id]->loss(top_id) || blob_under_loss[blob_id]) {
         layer_contributes_loss = true;
       }
-      if (blobs_skip_backp.find(blob_name) == blobs_skip_backp.end()) {
+      if (!blob_skip_backp[blob_id]) {
         layer_skip_propagate_down = false;
       }
       if (layer_contributes_loss && !layer_skip_propagate_down)
@@ -222,17 +356,14 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     }
     for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
          ++bottom_id) {
+      const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
       if (layer_contributes_loss) {
-        const string& blob_name =
-            blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_under_loss.insert(blob_name);
+        blob_under_loss[blob_id] = true;
       } else {
         bottom_need_backward_[layer_id][bottom_id] = false;
       }
       if (!bottom_need_backward_[layer_id][bottom_id]) {
-        const string& blob_name =
-                   blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_skip_backp.insert(blob_name);
+        blob_skip_backp[blob_id] = true;
       }
     }
   }
@@ -255,6 +386,36 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       }
     }
   }
+  // Cache the backward pruning analysis: where the backward walk may
+  // stop, and which learnable params ever receive a gradient. For
+  // fine-tuning nets that freeze their early layers (param lr_mult 0)
+  // this keeps Backward and the per-iteration diff bookkeeping off the
+  // frozen prefix entirely -- its diff blobs are never even allocated.
+  first_backward_layer_ = layers_.size();
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (layer_need_backward_[layer_id]) {
+      first_backward_layer_ = layer_id;
+      break;
+    }
+  }
+  learnable_param_need_backward_.assign(learnable_params_.size(), false);
+  // Each learnable param also remembers its earliest consuming layer;
+  // the overlapped update path records that layer's event after the
+  // param is updated, and Forward waits on it before the layer runs.
+  learnable_param_layer_ids_.assign(learnable_params_.size(), -1);
+  for (int net_param_id = 0; net_param_id < params_.size(); ++net_param_id) {
+    const pair<int, int>& index = param_layer_indices_[net_param_id];
+    if (layer_need_backward_[index.first] &&
+        layers_[index.first]->param_propagate_down(index.second)) {
+      learnable_param_need_backward_[learnable_param_ids_[net_param_id]] =
+          true;
+    }
+    int& layer_id = learnable_param_layer_ids_[
+        learnable_param_ids_[net_param_id]];
+    if (layer_id < 0 || index.first < layer_id) {
+      layer_id = index.first;
+    }
+  }
   // In the end, all remaining blobs are considered output blobs.
   for (set<string>::iterator it = available_blobs.begin();
       it != available_blobs.end(); ++it) {
@@ -271,9 +432,726 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   }
   ShareWeights();
   debug_info_ = param.debug_info();
+  loss_scale_ = Dtype(1);
+  profile_layers_ = param.profile_layers();
+#ifndef CPU_ONLY
+  graph_replay_ = param.cuda_graph_replay();
+  graph_replay_disabled_ = false;
+  forward_graph_exec_ = NULL;
+#endif
+  if (profile_layers_) {
+    forward_times_.resize(layers_.size());
+    backward_times_.resize(layers_.size());
+    forward_times_next_.resize(layers_.size(), 0);
+    backward_times_next_.resize(layers_.size(), 0);
+    profile_start_ms_.resize(layers_.size(), 0);
+  }
+  forward_parallelism_ = std::max(1,
+      static_cast<int>(param.forward_parallelism()));
+  if (forward_parallelism_ > 1) {
+    // Build the forward dependency DAG from blob connectivity. A layer
+    // waits for the latest writer of each bottom blob; overwriting a
+    // blob additionally waits for its earlier readers and writer, which
+    // serializes in-place chains but leaves independent branches free
+    // to run concurrently.
+    layer_succ_.assign(layers_.size(), vector<int>());
+    layer_pred_count_.assign(layers_.size(), 0);
+    vector<int> last_writer(blobs_.size(), -1);
+    vector<vector<int> > readers_since(blobs_.size());
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      set<int> preds;
+      for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+           ++bottom_id) {
+        const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
+        if (last_writer[blob_id] >= 0) {
+          preds.insert(last_writer[blob_id]);
+        }
+        readers_since[blob_id].push_back(layer_id);
+      }
+      for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+        const int blob_id = top_id_vecs_[layer_id][top_id];
+        if (last_writer[blob_id] >= 0) {
+          preds.insert(last_writer[blob_id]);
+        }
+        for (int r = 0; r < readers_since[blob_id].size(); ++r) {
+          preds.insert(readers_since[blob_id][r]);
+        }
+        last_writer[blob_id] = layer_id;
+        readers_since[blob_id].clear();
+      }
+      preds.erase(layer_id);
+      for (set<int>::const_iterator it = preds.begin(); it != preds.end();
+           ++it) {
+        layer_succ_[*it].push_back(layer_id);
+        ++layer_pred_count_[layer_id];
+      }
+    }
+  }
+  // Pool activation storage once the graph and the setup shapes are final.
+  if (phase_ == TEST && param.share_activations()) {
+    ShareActivations();
+  }
+  if (param.forward_only()) {
+    CHECK_EQ(phase_, TEST) << "forward_only requires a TEST-phase net.";
+    forward_only_ = true;
+    // Some loss layers scribble on their (otherwise dead) bottom diff
+    // during Forward, so those blobs keep diff access.
+    vector<bool> loss_scratch(blobs_.size(), false);
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      bool has_loss = false;
+      for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+        has_loss |= layers_[layer_id]->loss(top_id) != Dtype(0);
+      }
+      if (!has_loss) { continue; }
+      for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+           ++bottom_id) {
+        loss_scratch[bottom_id_vecs_[layer_id][bottom_id]] = true;
+      }
+    }
+    for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+      if (!loss_scratch[blob_id]) {
+        blobs_[blob_id]->set_forward_only(true);
+      }
+    }
+    for (int param_id = 0; param_id < params_.size(); ++param_id) {
+      params_[param_id]->set_forward_only(true);
+    }
+  }
+  SetupCheckpointing();
+  WireZeroCopyViews();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::SetupCheckpointing() {
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (layers_[i]->layer_param().checkpoint()) { checkpointing_ = true; }
+  }
+  if (!checkpointing_) { return; }
+  CHECK(!forward_only_) << "Checkpointing is pointless without Backward.";
+  CHECK(!activations_shared_)
+      << "Checkpointing cannot combine with share_activations.";
+  CHECK_EQ(forward_parallelism_, 1)
+      << "Checkpointing cannot combine with forward_parallelism.";
+  int segment = 0;
+  layer_checkpoint_segment_.resize(layers_.size());
+  for (int i = 0; i < layers_.size(); ++i) {
+    layer_checkpoint_segment_[i] = segment;
+    if (layers_[i]->layer_param().checkpoint()) { ++segment; }
+  }
+  const int num_segments = layer_checkpoint_segment_.back() + 1;
+  checkpoint_segment_starts_.assign(num_segments, -1);
+  checkpoint_segment_ends_.assign(num_segments, -1);
+  for (int i = 0; i < layers_.size(); ++i) {
+    const int seg = layer_checkpoint_segment_[i];
+    if (checkpoint_segment_starts_[seg] < 0) {
+      checkpoint_segment_starts_[seg] = i;
+    }
+    checkpoint_segment_ends_[seg] = i;
+  }
+  // A blob stays resident when anything outside its segment needs it:
+  // net inputs and outputs, tops of checkpoint and bottomless (data)
+  // layers, and blobs consumed in a segment other than their producer's.
+  vector<bool> kept(blobs_.size(), false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    kept[net_input_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    kept[net_output_blob_indices_[i]] = true;
+  }
+  vector<int> producer_segment(blobs_.size(), -1);
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      const int blob_id = top_id_vecs_[i][j];
+      if (producer_segment[blob_id] < 0) {
+        producer_segment[blob_id] = layer_checkpoint_segment_[i];
+      }
+      if (bottom_id_vecs_[i].empty() ||
+          layers_[i]->layer_param().checkpoint()) {
+        kept[blob_id] = true;
+      }
+    }
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      const int blob_id = bottom_id_vecs_[i][j];
+      if (layer_checkpoint_segment_[i] != producer_segment[blob_id]) {
+        kept[blob_id] = true;
+      }
+    }
+  }
+  checkpoint_droppable_blobs_.assign(num_segments, vector<int>());
+  checkpoint_layer_recompute_.assign(layers_.size(), false);
+  checkpoint_segment_dropped_.assign(num_segments, false);
+  vector<bool> listed(blobs_.size(), false);
+  size_t droppable_bytes = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      const int blob_id = top_id_vecs_[i][j];
+      if (kept[blob_id]) { continue; }
+      // Every producer of a droppable blob re-runs during recompute,
+      // including the later links of in-place chains.
+      if (!layer_fused_[i]) { checkpoint_layer_recompute_[i] = true; }
+      if (listed[blob_id]) { continue; }
+      listed[blob_id] = true;
+      checkpoint_droppable_blobs_[producer_segment[blob_id]].push_back(
+          blob_id);
+      droppable_bytes += blobs_[blob_id]->count() * sizeof(Dtype);
+    }
+  }
+  checkpoint_segment_after_.assign(layers_.size(), -1);
+  for (int seg = 0; seg < num_segments; ++seg) {
+    checkpoint_segment_after_[checkpoint_segment_ends_[seg]] = seg;
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Activation checkpointing: "
+      << num_segments << " segments, "
+      << droppable_bytes / (1024 * 1024) << " MB of activations "
+      << "released after forward and recomputed during backward";
+}
+
+template <typename Dtype>
+void Net<Dtype>::DropCheckpointSegment(int segment) {
+  const vector<int>& blobs = checkpoint_droppable_blobs_[segment];
+  for (int i = 0; i < blobs.size(); ++i) {
+    blobs_[blobs[i]]->ReleaseData();
+  }
+  checkpoint_segment_dropped_[segment] = true;
+}
+
+// Number of bottom references to blob_name among layers [start, end).
+static int CountConsumers(const NetParameter& param, int start,
+    const string& blob_name) {
+  int consumers = 0;
+  for (int i = start; i < param.layer_size(); ++i) {
+    for (int j = 0; j < param.layer(i).bottom_size(); ++j) {
+      if (param.layer(i).bottom(j) == blob_name) { ++consumers; }
+    }
+  }
+  return consumers;
+}
+
+// True if some layer at or after start lists blob_name as a top, i.e.
+// rewrites an existing blob of that name in place.
+static bool HasInPlaceWriter(const NetParameter& param, int start,
+    const string& blob_name) {
+  for (int i = start; i < param.layer_size(); ++i) {
+    for (int j = 0; j < param.layer(i).top_size(); ++j) {
+      if (param.layer(i).top(j) == blob_name) { return true; }
+    }
+  }
+  return false;
+}
+
+// Eliding the dropout at index i redirects its top's readers -- and any
+// in-place rewriter of the top -- onto its bottom, so the elision is
+// only sound if the bottom still holds the expected values whenever
+// they run: nothing after the dropout may rewrite the bottom in place,
+// and folding an in-place rewrite of the top onto the bottom is only
+// legal if the dropout was the bottom's sole reader. layer_param is the
+// dropout with renames already applied; the raw (pre-rename) bottom
+// name is checked as well since later layers still refer to it.
+static bool DropoutElisionSafe(const NetParameter& param, int i,
+    const LayerParameter& layer_param) {
+  const string& bottom_name = layer_param.bottom(0);
+  const string& top_name = layer_param.top(0);
+  if (top_name == bottom_name) { return true; }
+  const string& raw_bottom = param.layer(i).bottom(0);
+  if (HasInPlaceWriter(param, i + 1, bottom_name) ||
+      (raw_bottom != bottom_name &&
+       HasInPlaceWriter(param, i + 1, raw_bottom))) {
+    return false;
+  }
+  if (HasInPlaceWriter(param, i + 1, top_name)) {
+    int consumers = CountConsumers(param, i + 1, bottom_name);
+    if (raw_bottom != bottom_name) {
+      consumers += CountConsumers(param, i + 1, raw_bottom);
+    }
+    if (consumers > 0) { return false; }
+  }
+  return true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::CompileNet(const NetParameter& param,
+    NetParameter* param_compiled) {
+  param_compiled->CopyFrom(param);
+  param_compiled->clear_layer();
+  // Tops of dropped layers, mapped to the blob that stands in for them.
+  map<string, string> rename;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter layer_param = param.layer(i);
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      map<string, string>::const_iterator it =
+          rename.find(layer_param.bottom(j));
+      if (it != rename.end()) {
+        layer_param.set_bottom(j, it->second);
+      }
+    }
+    // A layer that rewrote an elided blob in place continues in place
+    // on the blob that stands in for it.
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      map<string, string>::const_iterator it =
+          rename.find(layer_param.top(j));
+      if (it != rename.end()) {
+        layer_param.set_top(j, it->second);
+      }
+    }
+    // Dropout is an identity at TEST time (inverted scaling is applied
+    // at TRAIN time), so the layer and its blob disappear outright.
+    if (phase_ == TEST && layer_param.type() == "Dropout" &&
+        layer_param.bottom_size() == 1 && layer_param.top_size() == 1 &&
+        DropoutElisionSafe(param, i, layer_param)) {
+      LOG_IF(INFO, Caffe::root_solver())
+          << "Compiled out TEST-phase dropout layer " << layer_param.name();
+      if (layer_param.top(0) != layer_param.bottom(0)) {
+        rename[layer_param.top(0)] = layer_param.bottom(0);
+      }
+      continue;
+    }
+    param_compiled->add_layer()->CopyFrom(layer_param);
+  }
+  if (phase_ != TEST || param.force_backward()) { return; }
+  // Collapse chains of parameterless element-wise layers into a single
+  // FusedEltwiseLayer, which makes one pass over memory instead of a
+  // full read-modify-write round trip per stage; see the layer for the
+  // supported stage types. Never on nets that run backward.
+  NetParameter fused;
+  fused.CopyFrom(*param_compiled);
+  fused.clear_layer();
+  int i = 0;
+  while (i < param_compiled->layer_size()) {
+    const LayerParameter& head = param_compiled->layer(i);
+    int chain_end = i;
+    if (FusedEltwiseLayer<Dtype>::IsFusableStage(head, true) &&
+        head.loss_weight_size() == 0 && head.param_size() == 0) {
+      while (chain_end + 1 < param_compiled->layer_size()) {
+        const LayerParameter& cur = param_compiled->layer(chain_end);
+        const LayerParameter& next = param_compiled->layer(chain_end + 1);
+        if (!FusedEltwiseLayer<Dtype>::IsFusableStage(next, false) ||
+            next.bottom(0) != cur.top(0) ||
+            next.loss_weight_size() > 0 || next.param_size() > 0) {
+          break;
+        }
+        // The intermediate value must not escape the chain. If the next
+        // stage rewrites the blob in place, later readers see the fused
+        // result under the same name provided the chain stops there;
+        // otherwise nothing else may read it at all.
+        const bool in_place = next.top(0) == cur.top(0);
+        const bool escapes =
+            CountConsumers(*param_compiled, chain_end + 2, cur.top(0)) > 0;
+        if (!in_place && escapes) { break; }
+        ++chain_end;
+        if (in_place && escapes) { break; }
+      }
+    }
+    if (chain_end > i) {
+      LayerParameter* fused_layer = fused.add_layer();
+      fused_layer->set_name(head.name());
+      fused_layer->set_type("FusedEltwise");
+      for (int j = 0; j < head.bottom_size(); ++j) {
+        fused_layer->add_bottom(head.bottom(j));
+      }
+      fused_layer->add_top(param_compiled->layer(chain_end).top(0));
+      for (int j = i; j <= chain_end; ++j) {
+        fused_layer->mutable_fused_eltwise_param()->add_stage()->CopyFrom(
+            param_compiled->layer(j));
+      }
+      LOG_IF(INFO, Caffe::root_solver())
+          << "Fused element-wise chain of " << chain_end - i + 1
+          << " layers starting at " << head.name();
+      i = chain_end + 1;
+    } else {
+      fused.add_layer()->CopyFrom(head);
+      ++i;
+    }
+  }
+  param_compiled->CopyFrom(fused);
+}
+
+// A BatchNorm layer folds if it normalizes the convolution output in
+// place with global statistics, which is the TEST-phase default.
+bool IsFoldableBatchNorm(const LayerParameter& layer_param,
+    const string& conv_top) {
+  return layer_param.type() == "BatchNorm" &&
+      layer_param.bottom_size() == 1 && layer_param.top_size() == 1 &&
+      layer_param.bottom(0) == conv_top && layer_param.top(0) == conv_top &&
+      (!layer_param.batch_norm_param().has_use_global_stats() ||
+       layer_param.batch_norm_param().use_global_stats());
+}
+
+// A Scale layer folds if it applies a learned per-channel scale (and
+// optionally bias) to the convolution output in place.
+bool IsFoldableScale(const LayerParameter& layer_param,
+    const string& conv_top) {
+  return layer_param.type() == "Scale" &&
+      layer_param.bottom_size() == 1 && layer_param.top_size() == 1 &&
+      layer_param.bottom(0) == conv_top && layer_param.top(0) == conv_top &&
+      layer_param.scale_param().axis() == 1 &&
+      layer_param.scale_param().num_axes() == 1;
+}
+
+template <typename Dtype>
+void Net<Dtype>::FoldBatchNorm(const NetParameter& param,
+    NetParameter* param_fold) {
+  param_fold->CopyFrom(param);
+  param_fold->clear_layer();
+  int i = 0;
+  while (i < param.layer_size()) {
+    const LayerParameter& layer_param = param.layer(i);
+    LayerParameter* kept_layer = param_fold->add_layer();
+    kept_layer->CopyFrom(layer_param);
+    ++i;
+    if (layer_param.type() != "Convolution" || layer_param.top_size() != 1) {
+      continue;
+    }
+    const string& conv_top = layer_param.top(0);
+    if (i >= param.layer_size() ||
+        !IsFoldableBatchNorm(param.layer(i), conv_top)) {
+      continue;
+    }
+    const LayerParameter& bn_param = param.layer(i);
+    bn_fold_targets_[bn_param.name()] = layer_param.name();
+    bn_fold_eps_[bn_param.name()] = bn_param.batch_norm_param().eps();
+    LOG_IF(INFO, Caffe::root_solver()) << "Folding BatchNorm layer "
+        << bn_param.name() << " into convolution " << layer_param.name();
+    ++i;
+    if (i < param.layer_size() && IsFoldableScale(param.layer(i), conv_top)) {
+      bn_fold_targets_[param.layer(i).name()] = layer_param.name();
+      LOG_IF(INFO, Caffe::root_solver()) << "Folding Scale layer "
+          << param.layer(i).name() << " into convolution "
+          << layer_param.name();
+      ++i;
+    }
+    // The folded bias absorbs the normalization shift, so the convolution
+    // needs one even if the original net left it out.
+    if (!kept_layer->convolution_param().bias_term()) {
+      kept_layer->mutable_convolution_param()->set_bias_term(true);
+      bn_fold_bias_convs_.insert(layer_param.name());
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareActivations() {
+  CHECK_EQ(phase_, TEST)
+      << "Activation sharing needs a TEST-phase net; Backward would read "
+      << "activations that a later layer has already overwritten.";
+  const int num_blobs = blobs_.size();
+  // A blob's forward lifetime runs from the layer that produces it to its
+  // last consumer; blobs whose lifetimes do not overlap may occupy the same
+  // buffer (greedy interval coloring). In-place layers reuse the producing
+  // blob id, so their chains extend one lifetime rather than adding blobs.
+  vector<int> first_def(num_blobs, -1);
+  vector<int> last_use(num_blobs, -1);
+  // Pinned blobs keep private storage: net inputs and outputs are read by
+  // the caller outside the forward pass, and tops of bottomless (data)
+  // layers are not necessarily rewritten on every forward.
+  vector<bool> pinned(num_blobs, false);
+  // Split/Flatten/Reshape tops alias their bottom's SyncedMemory in
+  // Forward; they get no buffer of their own and instead extend (and, for
+  // net outputs, pin) the bottom's lifetime.
+  vector<bool> aliased(num_blobs, false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    pinned[net_input_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    pinned[net_output_blob_indices_[i]] = true;
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (first_def[blob_id] < 0) { first_def[blob_id] = layer_id; }
+      last_use[blob_id] = std::max(last_use[blob_id], layer_id);
+      if (bottom_id_vecs_[layer_id].empty()) { pinned[blob_id] = true; }
+    }
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
+      last_use[blob_id] = std::max(last_use[blob_id], layer_id);
+    }
+  }
+  // Reverse order resolves chains of aliasing layers in a single pass.
+  for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
+    const string type(layers_[layer_id]->type());
+    if (type != "Split" && type != "Flatten" && type != "Reshape") {
+      continue;
+    }
+    const int bottom_id = bottom_id_vecs_[layer_id][0];
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (blob_id == bottom_id) { continue; }
+      aliased[blob_id] = true;
+      last_use[bottom_id] = std::max(last_use[bottom_id], last_use[blob_id]);
+      if (pinned[blob_id]) { pinned[bottom_id] = true; }
+    }
+  }
+  // Walk blobs in definition order (AppendTop creates ids in layer order)
+  // and place each in the first slot freed strictly before its producer
+  // runs: a layer may read a slot's old tenant while writing its own top.
+  vector<int> slot_free_at;
+  vector<size_t> slot_bytes;
+  vector<int> slot_of(num_blobs, -1);
+  size_t pooled_bytes = 0;
+  int num_pooled = 0;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (first_def[blob_id] < 0 || pinned[blob_id] || aliased[blob_id] ||
+        blobs_[blob_id]->count() == 0) {
+      continue;
+    }
+    int slot = -1;
+    for (int s = 0; s < slot_free_at.size(); ++s) {
+      if (slot_free_at[s] < first_def[blob_id]) { slot = s; break; }
+    }
+    if (slot < 0) {
+      slot = slot_free_at.size();
+      slot_free_at.push_back(-1);
+      slot_bytes.push_back(0);
+    }
+    slot_free_at[slot] = last_use[blob_id];
+    const size_t bytes = blobs_[blob_id]->count() * sizeof(Dtype);
+    slot_bytes[slot] = std::max(slot_bytes[slot], bytes);
+    slot_of[blob_id] = slot;
+    pooled_bytes += bytes;
+    ++num_pooled;
+  }
+  if (num_pooled == 0) { return; }
+  activation_arenas_.clear();
+  size_t arena_bytes = 0;
+  for (int s = 0; s < slot_bytes.size(); ++s) {
+    activation_arenas_.push_back(
+        shared_ptr<SyncedMemory>(new SyncedMemory(slot_bytes[s])));
+    arena_bytes += slot_bytes[s];
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (slot_of[blob_id] >= 0) {
+      blobs_[blob_id]->ShareDataBuffer(activation_arenas_[slot_of[blob_id]]);
+    }
+  }
+  activations_shared_ = true;
+  LOG_IF(INFO, Caffe::root_solver()) << "Sharing " << num_pooled
+      << " activation blobs (" << pooled_bytes << " bytes) across "
+      << activation_arenas_.size() << " buffers (" << arena_bytes
+      << " bytes)";
+}
+
+// Rewires blob's data as an offset view into owner, carrying over any
+// contents a producer already wrote (e.g. a constant DummyData filled
+// during setup, which will never be rewritten in Forward).
+template <typename Dtype>
+static void WireDataView(Blob<Dtype>* blob, Blob<Dtype>* owner, int offset) {
+  shared_ptr<SyncedMemory> old_data = blob->data();
+  blob->ShareDataRange(*owner, offset);
+  if (old_data->head() != SyncedMemory::UNINITIALIZED) {
+    caffe_copy(blob->count(),
+        static_cast<const Dtype*>(old_data->cpu_data()),
+        blob->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::WireZeroCopyViews() {
+  // A Concat whose concatenated axis is outermost-contiguous
+  // (count(0, axis) == 1, e.g. axis 0 or a singleton batch) writes each
+  // bottom to one contiguous range of its top, so the bottoms can be
+  // allocated as offset views into the top's storage up front and the
+  // per-iteration copies degenerate to pointer-equal no-ops (caffe_copy
+  // and the GPU paths both skip aliased ranges). Slice is the same in
+  // reverse: its tops become views into the bottom. Wiring is
+  // best-effort per blob; anything that cannot alias simply keeps its
+  // copy, and a blob reshaped away from its wired offset falls back in
+  // the layer's Reshape.
+  if (activations_shared_ || checkpointing_ || forward_parallelism_ > 1) {
+    // Pooled, droppable or concurrently written storage is not a stable
+    // single-writer range, so keep the copies.
+    return;
+  }
+  vector<bool> is_net_input(blobs_.size(), false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    is_net_input[net_input_blob_indices_[i]] = true;
+  }
+  int wired = 0;
+  // Reverse order so chained layers (a concat feeding a concat) wire
+  // the outer storage first and inner blobs become views of views.
+  for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
+    const string type(layers_[layer_id]->type());
+    const LayerParameter& layer_param = layers_[layer_id]->layer_param();
+    if (type == "Concat" && bottom_vecs_[layer_id].size() > 1) {
+      Blob<Dtype>* top = top_vecs_[layer_id][0];
+      const ConcatParameter& concat_param = layer_param.concat_param();
+      const int axis = concat_param.has_concat_dim() ?
+          static_cast<int>(concat_param.concat_dim()) :
+          top->CanonicalAxisIndex(concat_param.axis());
+      if (top->count(0, axis) != 1 || top->data()->is_view()) { continue; }
+      int offset = 0;
+      for (int j = 0; j < bottom_vecs_[layer_id].size(); ++j) {
+        Blob<Dtype>* bottom = bottom_vecs_[layer_id][j];
+        if (bottom != top && bottom->count() > 0 &&
+            !bottom->data()->is_view() &&
+            !is_net_input[bottom_id_vecs_[layer_id][j]]) {
+          WireDataView(bottom, top, offset);
+          if (!bottom->forward_only() && !top->forward_only()) {
+            bottom->ShareDiffRange(*top, offset);
+          }
+          ++wired;
+        }
+        offset += bottom->count();
+      }
+    } else if (type == "Slice" && top_vecs_[layer_id].size() > 1) {
+      Blob<Dtype>* bottom = bottom_vecs_[layer_id][0];
+      const SliceParameter& slice_param = layer_param.slice_param();
+      const int axis = slice_param.has_slice_dim() ?
+          static_cast<int>(slice_param.slice_dim()) :
+          bottom->CanonicalAxisIndex(slice_param.axis());
+      if (bottom->count(0, axis) != 1) { continue; }
+      int offset = 0;
+      for (int j = 0; j < top_vecs_[layer_id].size(); ++j) {
+        Blob<Dtype>* top = top_vecs_[layer_id][j];
+        if (top != bottom && top->count() > 0 &&
+            !top->data()->is_view()) {
+          WireDataView(top, bottom, offset);
+          if (!top->forward_only() && !bottom->forward_only()) {
+            top->ShareDiffRange(*bottom, offset);
+          }
+          ++wired;
+        }
+        offset += top->count();
+      }
+    } else if (type == "Crop") {
+      // A crop whose region is one contiguous range of the bottom (only
+      // outer axes trimmed) is a slice of a single range: the top
+      // becomes a view at the region's offset and the strided copy is
+      // elided. Crop's backward zeroes only the margins when its top
+      // diff is wired.
+      CropLayer<Dtype>* crop =
+          dynamic_cast<CropLayer<Dtype>*>(layers_[layer_id].get());
+      int offset = 0;
+      if (!crop || !crop->contiguous_region(&offset)) { continue; }
+      Blob<Dtype>* bottom = bottom_vecs_[layer_id][0];
+      Blob<Dtype>* top = top_vecs_[layer_id][0];
+      if (top == bottom || top->count() == 0 || top->data()->is_view()) {
+        continue;
+      }
+      WireDataView(top, bottom, offset);
+      if (!top->forward_only() && !bottom->forward_only()) {
+        top->ShareDiffRange(*bottom, offset);
+      }
+      ++wired;
+    }
+  }
+  if (wired > 0) {
+    LOG_IF(INFO, Caffe::root_solver()) << "Wired " << wired
+        << " zero-copy concat/slice/crop views";
+  }
+}
+
+// Counts a SyncedMemory's bytes towards whichever sides currently hold
+// a copy, once per distinct memory even when several blobs share it.
+static void TallyResidency(const shared_ptr<SyncedMemory>& mem,
+    set<const SyncedMemory*>* seen, size_t* host, size_t* device) {
+  if (!mem || !seen->insert(mem.get()).second) { return; }
+  switch (mem->head()) {
+  case SyncedMemory::HEAD_AT_CPU:
+    *host += mem->size();
+    break;
+  case SyncedMemory::HEAD_AT_GPU:
+    *device += mem->size();
+    break;
+  case SyncedMemory::SYNCED:
+    *host += mem->size();
+    *device += mem->size();
+    break;
+  default:
+    break;
+  }
+}
+
+template <typename Dtype>
+string Net<Dtype>::memory_report() const {
+  // Attribute each activation blob to the layer whose top created it;
+  // in-place layers reuse their bottom's blob and so add nothing.
+  vector<size_t> act_bytes(layers_.size(), 0);
+  size_t input_bytes = 0;
+  vector<int> def_layer(blobs_.size(), -1);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (def_layer[blob_id] < 0) { def_layer[blob_id] = layer_id; }
+    }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const size_t bytes = blobs_[blob_id]->count() * sizeof(Dtype);
+    if (def_layer[blob_id] >= 0) {
+      act_bytes[def_layer[blob_id]] += bytes;
+    } else {
+      input_bytes += bytes;
+    }
+  }
+  vector<size_t> param_bytes(layers_.size(), 0);
+  vector<size_t> shared_param_bytes(layers_.size(), 0);
+  for (int i = 0; i < params_.size(); ++i) {
+    const int layer_id = param_layer_indices_[i].first;
+    const size_t bytes = params_[i]->count() * sizeof(Dtype);
+    if (param_owners_[i] < 0) {
+      param_bytes[layer_id] += bytes;
+    } else {
+      shared_param_bytes[layer_id] += bytes;
+    }
+  }
+  ostringstream report;
+  report << "Memory report for net " << name_
+         << " (bytes; parameters and activations are data only, diffs"
+         << " allocate the same again on first use)";
+  size_t total_act = 0;
+  size_t total_param = 0;
+  size_t total_scratch = 0;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const size_t scratch = layers_[layer_id]->scratch_memory();
+    report << "\n  " << layer_names_[layer_id]
+           << " (" << layers_[layer_id]->type() << "):"
+           << " activations " << act_bytes[layer_id]
+           << ", params " << param_bytes[layer_id];
+    if (shared_param_bytes[layer_id] > 0) {
+      report << " (+" << shared_param_bytes[layer_id] << " shared)";
+    }
+    report << ", scratch " << scratch;
+    total_act += act_bytes[layer_id];
+    total_param += param_bytes[layer_id];
+    total_scratch += scratch;
+  }
+  report << "\n  totals: activations " << total_act
+         << ", inputs " << input_bytes
+         << ", params " << total_param
+         << ", scratch " << total_scratch;
+  if (col_buffer_arena_) {
+    report << "\n  shared column buffer: "
+           << col_buffer_arena_->count() * sizeof(Dtype);
+  }
+  if (!activation_arenas_.empty()) {
+    size_t arena_bytes = 0;
+    for (int i = 0; i < activation_arenas_.size(); ++i) {
+      arena_bytes += activation_arenas_[i]->size();
+    }
+    report << "\n  shared activation arenas: " << arena_bytes
+           << " backing " << total_act << " of logical activations";
+  }
+  // What is actually materialized right now, per side. Lazy allocation
+  // means this starts near zero and grows as blobs are first touched.
+  set<const SyncedMemory*> seen;
+  size_t host_bytes = 0;
+  size_t device_bytes = 0;
+  for (int i = 0; i < blobs_.size(); ++i) {
+    TallyResidency(blobs_[i]->data(), &seen, &host_bytes, &device_bytes);
+    TallyResidency(blobs_[i]->diff(), &seen, &host_bytes, &device_bytes);
+  }
+  for (int i = 0; i < params_.size(); ++i) {
+    TallyResidency(params_[i]->data(), &seen, &host_bytes, &device_bytes);
+    TallyResidency(params_[i]->diff(), &seen, &host_bytes, &device_bytes);
+  }
+  report << "\n  resident: host " << host_bytes
+         << ", device " << device_bytes;
+  return report.str();
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -458,8 +1336,14 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   ParamSpec default_param_spec;
   const ParamSpec* param_spec = (layer_param.param_size() > param_id) ?
       &layer_param.param(param_id) : &default_param_spec;
-  if (!param_size || !param_name.size() || (param_name.size() &&
-      param_names_index_.find(param_name) == param_names_index_.end())) {
+  // Resolve a named param to its owner with a single lookup; the
+  // iterator doubles as the "seen before" test and the owner id.
+  map<string, int>::iterator owner_it = param_names_index_.end();
+  if (param_name.size()) {
+    owner_it = param_names_index_.find(param_name);
+  }
+  if (!param_size || !param_name.size() ||
+      owner_it == param_names_index_.end()) {
     // This layer "owns" this parameter blob -- it is either anonymous
     // (i.e., not given a param_name) or explicitly given a name that we
     // haven't already seen.
@@ -476,7 +1360,7 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     params_weight_decay_.push_back(param_spec->decay_mult());
   } else {
     // Named param blob with name we've seen before: share params
-    const int owner_net_param_id = param_names_index_[param_name];
+    const int owner_net_param_id = owner_it->second;
     param_owners_.push_back(owner_net_param_id);
     const pair<int, int>& owner_index =
         param_layer_indices_[owner_net_param_id];
@@ -533,114 +1417,822 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
 }
 
 template <typename Dtype>
-Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
-  CHECK_GE(start, 0);
-  CHECK_LT(end, layers_.size());
-  Dtype loss = 0;
-  for (int i = start; i <= end; ++i) {
-    // LOG(ERROR) << "Forwarding " << layer_names_[i];
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
-    loss += layer_loss;
-    if (debug_info_) { ForwardDebugInfo(i); }
+void Net<Dtype>::set_async_loss(bool async_loss) {
+  if (async_loss == async_loss_) { return; }
+#ifndef CPU_ONLY
+  if (async_loss) {
+    CHECK_EQ(Caffe::mode(), Caffe::GPU)
+        << "Asynchronous loss readback requires GPU mode.";
+    async_loss_slot_count_ = 0;
+    for (int i = 0; i < layers_.size(); ++i) {
+      async_loss_slot_count_ += top_vecs_[i].size();
+    }
+    async_loss_device_.reset(
+        new SyncedMemory(async_loss_slot_count_ * sizeof(Dtype)));
+    Dtype* slots = static_cast<Dtype*>(async_loss_device_->mutable_gpu_data());
+    // Zero once; only loss tops ever write their slot, so summing the
+    // whole buffer on the host stays correct.
+    caffe_gpu_set(async_loss_slot_count_, Dtype(0), slots);
+    void* pinned = NULL;
+    CUDA_CHECK(cudaMallocHost(&pinned,
+        async_loss_slot_count_ * sizeof(Dtype)));
+    async_loss_pinned_ = static_cast<Dtype*>(pinned);
+    CUDA_CHECK(cudaEventCreateWithFlags(&async_loss_event_,
+        cudaEventDisableTiming));
+    int slot = 0;
+    for (int i = 0; i < layers_.size(); ++i) {
+      bool has_loss = false;
+      for (int t = 0; t < top_vecs_[i].size(); ++t) {
+        if (layers_[i]->loss(t) != Dtype(0)) { has_loss = true; }
+      }
+      if (has_loss) {
+        layers_[i]->set_async_loss_slots(slots + slot);
+      }
+      slot += top_vecs_[i].size();
+    }
+    async_loss_pending_ = false;
+    async_loss_last_ = 0;
+  } else {
+    for (int i = 0; i < layers_.size(); ++i) {
+      layers_[i]->set_async_loss_slots(NULL);
+    }
+    if (async_loss_pending_) {
+      CUDA_CHECK(cudaEventSynchronize(async_loss_event_));
+    }
+    CUDA_CHECK(cudaEventDestroy(async_loss_event_));
+    CUDA_CHECK(cudaFreeHost(async_loss_pinned_));
+    async_loss_pinned_ = NULL;
+    async_loss_device_.reset();
+    async_loss_pending_ = false;
   }
-  return loss;
-}
-
-template <typename Dtype>
-Dtype Net<Dtype>::ForwardFrom(int start) {
-  return ForwardFromTo(start, layers_.size() - 1);
-}
-
-template <typename Dtype>
-Dtype Net<Dtype>::ForwardTo(int end) {
-  return ForwardFromTo(0, end);
+  async_loss_ = async_loss;
+#else
+  NO_GPU;
+#endif
 }
 
 template <typename Dtype>
-const vector<Blob<Dtype>*>& Net<Dtype>::Forward(Dtype* loss) {
-  if (loss != NULL) {
-    *loss = ForwardFromTo(0, layers_.size() - 1);
+void Net<Dtype>::set_debug_info_sample(const int every) {
+  debug_info_sample_ = every;
+  debug_sample_iter_ = 0;
+  debug_sample_this_iter_ = false;
+  debug_slots_.clear();
+#ifndef CPU_ONLY
+  if (every > 0 && Caffe::mode() == Caffe::GPU) {
+    // Upper bound on the reductions one sampled iteration can queue:
+    // forward tops and params plus backward bottoms and params.
+    int max_slots = 0;
+    for (int i = 0; i < layers_.size(); ++i) {
+      max_slots += top_vecs_[i].size() + bottom_vecs_[i].size() +
+          2 * layers_[i]->blobs().size();
+    }
+    debug_asum_buffer_.reset(
+        new SyncedMemory(std::max(max_slots, 1) * sizeof(Dtype)));
+    nonfinite_flag_.reset(new SyncedMemory(sizeof(int)));
+    *static_cast<int*>(nonfinite_flag_->mutable_cpu_data()) = 0;
   } else {
-    ForwardFromTo(0, layers_.size() - 1);
+    debug_asum_buffer_.reset();
+    nonfinite_flag_.reset();
   }
-  return net_output_blobs_;
+#endif
 }
 
 template <typename Dtype>
-const vector<Blob<Dtype>*>& Net<Dtype>::Forward(
-    const vector<Blob<Dtype>*> & bottom, Dtype* loss) {
-  LOG_EVERY_N(WARNING, 1000) << "DEPRECATED: Forward(bottom, loss) "
-      << "will be removed in a future version. Use Forward(loss).";
-  // Copy bottom to net bottoms
-  for (int i = 0; i < bottom.size(); ++i) {
-    net_input_blobs_[i]->CopyFrom(*bottom[i]);
-  }
-  return Forward(loss);
+void Net<Dtype>::QueueDebugAsum(const Blob<Dtype>& blob, const bool diff,
+    const string& prefix) {
+#ifndef CPU_ONLY
+  CHECK_LT(debug_slots_.size() * sizeof(Dtype), debug_asum_buffer_->size());
+  Dtype* slots = static_cast<Dtype*>(debug_asum_buffer_->mutable_gpu_data());
+  const Dtype* x = diff ? blob.gpu_diff() : blob.gpu_data();
+  caffe_gpu_asum_device(blob.count(), x, slots + debug_slots_.size());
+  DebugInfoSlot slot;
+  slot.prefix = prefix;
+  slot.scale = Dtype(1) / blob.count();
+  debug_slots_.push_back(slot);
+#endif
 }
 
 template <typename Dtype>
-void Net<Dtype>::BackwardFromTo(int start, int end) {
-  CHECK_GE(end, 0);
-  CHECK_LT(start, layers_.size());
-  for (int i = start; i >= end; --i) {
-    if (layer_need_backward_[i]) {
-      layers_[i]->Backward(
-          top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
-      if (debug_info_) { BackwardDebugInfo(i); }
+void Net<Dtype>::FlushDebugInfo() {
+#ifndef CPU_ONLY
+  if (debug_slots_.size() > 0) {
+    // The cpu_data() call is the one device-to-host copy for every
+    // reduction queued since the last flush.
+    const Dtype* sums =
+        static_cast<const Dtype*>(debug_asum_buffer_->cpu_data());
+    for (int i = 0; i < debug_slots_.size(); ++i) {
+      LOG_IF(INFO, Caffe::root_solver())
+          << debug_slots_[i].prefix << sums[i] * debug_slots_[i].scale;
     }
+    debug_slots_.clear();
+  }
+  if (nonfinite_flag_ &&
+      *static_cast<const int*>(nonfinite_flag_->cpu_data())) {
+    LOG_IF(ERROR, Caffe::root_solver())
+        << "Non-finite activation values detected within the last "
+        << debug_info_sample_ << " iterations.";
+    *static_cast<int*>(nonfinite_flag_->mutable_cpu_data()) = 0;
   }
+#endif
 }
 
 template <typename Dtype>
-void Net<Dtype>::ForwardDebugInfo(const int layer_id) {
+Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
+#ifndef CAFFE_RELEASE_CHECKS
+  // Release-serving builds define CAFFE_RELEASE_CHECKS to drop these
+  // range checks: the bounds are fixed at Init and Forward runs once
+  // per request there.
+  CHECK_GE(start, 0);
+  CHECK_LT(end, layers_.size());
+#endif
+  if (start == 0 && debug_info_sample_ > 0) {
+    debug_sample_this_iter_ =
+        debug_sample_iter_ % debug_info_sample_ == 0;
+    ++debug_sample_iter_;
+  }
+  if (forward_parallelism_ > 1 && start == 0 && end == layers_.size() - 1 &&
+      Caffe::mode() == Caffe::CPU && !debug_info_ && !profile_layers_ &&
+      debug_info_sample_ <= 0 && !SyncedMemoryTrace::enabled()) {
+    return ForwardParallel();
+  }
+  Dtype loss = 0;
+  for (int i = start; i <= end; ++i) {
+    // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    if (layer_fused_[i]) { continue; }
+#ifndef CPU_ONLY
+    if (update_events_.size() > 0) {
+      // The solver may still be updating this layer's params on its
+      // side stream; order this layer's kernels after that event
+      // without stalling the host.
+      CUDA_CHECK(cudaStreamWaitEvent(cudaStreamDefault,
+          update_events_[i], 0));
+    }
+#endif
+    if (SyncedMemoryTrace::enabled()) {
+      SyncedMemoryTrace::set_context(layer_names_[i]);
+    }
+    if (profile_layers_) { ProfileLayerStart(i, true); }
+    Dtype layer_loss;
+    {
+      TraceSpan trace("forward", layer_names_[i]);
+      NvtxRange nvtx("forward", layer_names_[i]);
+      BlasThreadScope blas(BlasThreadHint(i));
+      layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    }
+    loss += layer_loss;
+    if (profile_layers_) { ProfileLayerStop(i, true); }
+#ifndef CPU_ONLY
+    if (nonfinite_flag_ && Caffe::mode() == Caffe::GPU) {
+      // Always-on canary: sticky flag, read back on sampled iterations.
+      int* flag = static_cast<int*>(nonfinite_flag_->mutable_gpu_data());
+      for (int t = 0; t < top_vecs_[i].size(); ++t) {
+        const Blob<Dtype>& top_blob = *top_vecs_[i][t];
+        if (top_blob.count() > 0) {
+          caffe_gpu_nonfinite_check(top_blob.count(), top_blob.gpu_data(),
+              flag);
+        }
+      }
+    }
+#endif
+    if (debug_info_ || debug_sample_this_iter_) { ForwardDebugInfo(i); }
+    if (checkpointing_ && checkpoint_segment_after_[i] >= 0) {
+      const int seg = checkpoint_segment_after_[i];
+      if (seg + 1 < checkpoint_segment_dropped_.size()) {
+        DropCheckpointSegment(seg);
+      } else {
+        // The final segment stays live so Backward can start on it.
+        checkpoint_segment_dropped_[seg] = false;
+      }
+    }
+  }
+#ifndef CPU_ONLY
+  if (async_loss_ && Caffe::mode() == Caffe::GPU) {
+    // The copy for this iteration queues behind the forward kernels;
+    // the value returned is last iteration's, whose copy precedes the
+    // kernels just enqueued, so waiting on its event never drains the
+    // pipeline beyond work that had to finish anyway.
+    if (async_loss_pending_) {
+      CUDA_CHECK(cudaEventSynchronize(async_loss_event_));
+      async_loss_last_ = 0;
+      for (int i = 0; i < async_loss_slot_count_; ++i) {
+        async_loss_last_ += async_loss_pinned_[i];
+      }
+    }
+    CUDA_CHECK(cudaMemcpyAsync(async_loss_pinned_,
+        async_loss_device_->gpu_data(),
+        async_loss_slot_count_ * sizeof(Dtype), cudaMemcpyDeviceToHost));
+    CUDA_CHECK(cudaEventRecord(async_loss_event_, 0));
+    async_loss_pending_ = true;
+    loss += async_loss_last_;
+  }
+#endif
+  if (debug_sample_this_iter_) { FlushDebugInfo(); }
+  return loss;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ForwardParallelWorker(ForwardSchedule* schedule) {
+  Caffe::set_mode(schedule->mode);
+  Caffe::set_numa_policy(schedule->numa_policy);
+  boost::unique_lock<boost::mutex> lock(*schedule->mutex);
+  while (schedule->remaining > 0) {
+    if (schedule->ready.empty()) {
+      schedule->cond->wait(lock);
+      continue;
+    }
+    const int layer_id = schedule->ready.back();
+    schedule->ready.pop_back();
+    lock.unlock();
+    Dtype layer_loss = 0;
+    if (!layer_fused_[layer_id]) {
+      layer_loss = layers_[layer_id]->Forward(bottom_vecs_[layer_id],
+          top_vecs_[layer_id]);
+    }
+    lock.lock();
+    schedule->loss += layer_loss;
+    --schedule->remaining;
+    const vector<int>& succ = layer_succ_[layer_id];
+    for (int i = 0; i < succ.size(); ++i) {
+      if (--schedule->pending[succ[i]] == 0) {
+        schedule->ready.push_back(succ[i]);
+      }
+    }
+    schedule->cond->notify_all();
+  }
+  schedule->cond->notify_all();
+}
+
+template <typename Dtype>
+int Net<Dtype>::BlasThreadHint(const int layer_id) const {
+  if (Caffe::mode() != Caffe::CPU) { return 0; }
+  int threads = layers_[layer_id]->layer_param().blas_threads();
+  const int budget = Caffe::cpu_core_budget();
+  if (threads > 0 && budget > 0) {
+    threads = std::min(threads, budget);
+  }
+  return threads;
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardParallel() {
+  boost::mutex mutex;
+  boost::condition_variable cond;
+  ForwardSchedule schedule;
+  schedule.pending = layer_pred_count_;
+  schedule.remaining = layers_.size();
+  schedule.loss = 0;
+  schedule.mode = Caffe::mode();
+  schedule.numa_policy = Caffe::numa_policy();
+  schedule.mutex = &mutex;
+  schedule.cond = &cond;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (schedule.pending[layer_id] == 0) {
+      schedule.ready.push_back(layer_id);
+    }
+  }
+  int num_workers = std::min(forward_parallelism_,
+      static_cast<int>(layers_.size()));
+  const int budget = Caffe::cpu_core_budget();
+  if (budget > 0) {
+    num_workers = std::min(num_workers, budget);
+  }
+  vector<shared_ptr<boost::thread> > workers;
+  for (int i = 0; i < num_workers - 1; ++i) {
+    workers.push_back(shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&Net<Dtype>::ForwardParallelWorker, this, &schedule))));
+  }
+  // The calling thread is worker zero.
+  ForwardParallelWorker(&schedule);
+  for (int i = 0; i < workers.size(); ++i) {
+    workers[i]->join();
+  }
+  return schedule.loss;
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardFrom(int start) {
+  return ForwardFromTo(start, layers_.size() - 1);
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardTo(int end) {
+  return ForwardFromTo(0, end);
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardTo(const vector<string>& blob_names) {
+  CHECK_GT(blob_names.size(), 0) << "ForwardTo needs at least one blob name.";
+  // Producer of each bottom blob: the latest earlier writer, so that
+  // in-place chains pull in every layer up to the requested state.
+  vector<int> last_writer(blobs_.size(), -1);
+  vector<vector<int> > bottom_writer(layers_.size());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      bottom_writer[layer_id].push_back(
+          last_writer[bottom_id_vecs_[layer_id][bottom_id]]);
+    }
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      last_writer[top_id_vecs_[layer_id][top_id]] = layer_id;
+    }
+  }
+  // Mark the ancestor subgraph of the requested blobs.
+  vector<bool> needed(layers_.size(), false);
+  vector<int> stack;
+  for (int i = 0; i < blob_names.size(); ++i) {
+    CHECK(has_blob(blob_names[i]))
+        << "Unknown blob name " << blob_names[i];
+    const int writer =
+        last_writer[blob_names_index_.find(blob_names[i])->second];
+    if (writer >= 0 && !needed[writer]) {
+      needed[writer] = true;
+      stack.push_back(writer);
+    }
+  }
+  while (!stack.empty()) {
+    const int layer_id = stack.back();
+    stack.pop_back();
+    for (int i = 0; i < bottom_writer[layer_id].size(); ++i) {
+      const int writer = bottom_writer[layer_id][i];
+      if (writer >= 0 && !needed[writer]) {
+        needed[writer] = true;
+        stack.push_back(writer);
+      }
+    }
+  }
+  Dtype loss = 0;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (!needed[layer_id] || layer_fused_[layer_id]) { continue; }
+    if (SyncedMemoryTrace::enabled()) {
+      SyncedMemoryTrace::set_context(layer_names_[layer_id]);
+    }
+    loss += layers_[layer_id]->Forward(bottom_vecs_[layer_id],
+        top_vecs_[layer_id]);
+    if (debug_info_) { ForwardDebugInfo(layer_id); }
+  }
+  return loss;
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Net<Dtype>::Forward(Dtype* loss) {
+  if (loss != NULL) {
+    *loss = ForwardFromTo(0, layers_.size() - 1);
+  } else {
+    ForwardFromTo(0, layers_.size() - 1);
+  }
+  return net_output_blobs_;
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Net<Dtype>::ForwardInference() {
+  if (debug_info_ || profile_layers_) {
+    // Keep the diagnostic paths authoritative when they are switched
+    // on; the trimmed loop below deliberately skips them.
+    return Forward();
+  }
+  if (forward_parallelism_ > 1 && Caffe::mode() == Caffe::CPU &&
+      !SyncedMemoryTrace::enabled()) {
+    ForwardParallel();
+    return net_output_blobs_;
+  }
+#ifndef CPU_ONLY
+  if (graph_replay_ && Caffe::mode() == Caffe::GPU &&
+      !SyncedMemoryTrace::enabled() && GraphReplayForward()) {
+    return net_output_blobs_;
+  }
+#endif
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (layer_fused_[i]) { continue; }
+#ifndef CPU_ONLY
+    if (update_events_.size() > 0) {
+      CUDA_CHECK(cudaStreamWaitEvent(cudaStreamDefault,
+          update_events_[i], 0));
+    }
+#endif
+    layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+  }
+  return net_output_blobs_;
+}
+
+#ifndef CPU_ONLY
+
+template <typename Dtype>
+void Net<Dtype>::InvalidateForwardGraph() {
+#if defined(USE_PER_THREAD_STREAMS) && CUDART_VERSION >= 10000
+  if (forward_graph_exec_ != NULL) {
+    cudaGraphExecDestroy(
+        static_cast<cudaGraphExec_t>(forward_graph_exec_));
+    forward_graph_exec_ = NULL;
+  }
+  graph_shapes_.clear();
+  graph_inputs_.clear();
+#endif
+}
+
+template <typename Dtype>
+bool Net<Dtype>::GraphReplayForward() {
+#if !defined(USE_PER_THREAD_STREAMS) || CUDART_VERSION < 10000
+  // Capture needs every launch on a capturable stream; the legacy
+  // default stream the plain build uses is not one.
+  LOG_EVERY_N(WARNING, 1000) << "cuda_graph_replay requires building "
+      << "with USE_PER_THREAD_STREAMS and CUDA 10+; running uncaptured.";
+  return false;
+#else
+  if (graph_replay_disabled_ || checkpointing_ || !update_events_.empty()) {
+    return false;
+  }
+  // Sync host-written inputs to the device outside the graph and
+  // snapshot the geometry and storage the recorded launches depend on.
+  vector<string> shapes(net_input_blobs_.size());
+  vector<const void*> ptrs(net_input_blobs_.size());
+  for (int i = 0; i < net_input_blobs_.size(); ++i) {
+    shapes[i] = net_input_blobs_[i]->shape_string();
+    ptrs[i] = net_input_blobs_[i]->gpu_data();
+  }
+  cudaGraphExec_t exec = static_cast<cudaGraphExec_t>(forward_graph_exec_);
+  if (exec != NULL && (shapes != graph_shapes_ || ptrs != graph_inputs_)) {
+    CUDA_CHECK(cudaGraphExecDestroy(exec));
+    forward_graph_exec_ = NULL;
+    exec = NULL;
+  }
+  if (exec == NULL) {
+    if (shapes != graph_shapes_ || ptrs != graph_inputs_) {
+      // Shapes have not stabilized yet; remember them and run this
+      // pass uncaptured. Capture starts once two consecutive passes
+      // agree.
+      graph_shapes_.swap(shapes);
+      graph_inputs_.swap(ptrs);
+      return false;
+    }
+    cudaGraph_t graph;
+    cudaError_t err = cudaStreamBeginCapture(cudaStreamPerThread,
+        cudaStreamCaptureModeThreadLocal);
+    if (err != cudaSuccess) {
+      cudaGetLastError();
+      LOG(WARNING) << "cuda_graph_replay: capture unavailable ("
+          << cudaGetErrorString(err) << "); running uncaptured.";
+      graph_replay_disabled_ = true;
+      return false;
+    }
+    for (int i = 0; i < layers_.size(); ++i) {
+      if (layer_fused_[i]) { continue; }
+      layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    }
+    err = cudaStreamEndCapture(cudaStreamPerThread, &graph);
+    if (err != cudaSuccess) {
+      // A layer issued a non-capturable call. Nothing was executed
+      // during the failed capture, so the caller reruns uncaptured.
+      cudaGetLastError();
+      LOG(WARNING) << "cuda_graph_replay: forward is not capturable ("
+          << cudaGetErrorString(err) << "); running uncaptured.";
+      graph_replay_disabled_ = true;
+      return false;
+    }
+    CUDA_CHECK(cudaGraphInstantiate(&exec, graph, NULL, NULL, 0));
+    CUDA_CHECK(cudaGraphDestroy(graph));
+    forward_graph_exec_ = exec;
+    LOG(INFO) << "cuda_graph_replay: captured forward ("
+        << layers_.size() << " layers); replaying from now on.";
+  }
+  CUDA_CHECK(cudaGraphLaunch(exec, cudaStreamPerThread));
+  // The replayed kernels bypass Blob head bookkeeping: mark the
+  // outputs device-dirty so a host read syncs the fresh values.
+  for (int i = 0; i < net_output_blobs_.size(); ++i) {
+    net_output_blobs_[i]->mutable_gpu_data();
+  }
+  return true;
+#endif
+}
+
+#endif  // CPU_ONLY
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Net<Dtype>::Forward(
+    const vector<Blob<Dtype>*> & bottom, Dtype* loss) {
+  LOG_EVERY_N(WARNING, 1000) << "DEPRECATED: Forward(bottom, loss) "
+      << "will be removed in a future version. Use Forward(loss).";
+  // Copy bottom to net bottoms
+  for (int i = 0; i < bottom.size(); ++i) {
+    net_input_blobs_[i]->CopyFrom(*bottom[i]);
+  }
+  return Forward(loss);
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardFromTo(int start, int end) {
+  CHECK_GE(end, 0);
+  CHECK_LT(start, layers_.size());
+  CHECK(!activations_shared_)
+      << "Cannot run Backward on a net initialized with share_activations: "
+      << "later layers have overwritten the activations it needs.";
+  CHECK(!forward_only_)
+      << "Cannot run Backward on a net initialized with forward_only: "
+      << "its diffs are frozen unallocated.";
+  if (checkpointing_) {
+    BackwardCheckpointed(start, end);
+    if (debug_sample_this_iter_) { FlushDebugInfo(); }
+    return;
+  }
+  for (int i = start; i >= end; --i) {
+    BackwardLayer(i);
+  }
+  if (debug_sample_this_iter_) { FlushDebugInfo(); }
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardLayer(int layer_id) {
+  const int i = layer_id;
+  if (layer_need_backward_[i]) {
+    if (SyncedMemoryTrace::enabled()) {
+      SyncedMemoryTrace::set_context(layer_names_[i]);
+    }
+    if (profile_layers_) { ProfileLayerStart(i, false); }
+    {
+      TraceSpan trace("backward", layer_names_[i]);
+      NvtxRange nvtx("backward", layer_names_[i]);
+      BlasThreadScope blas(BlasThreadHint(i));
+      layers_[i]->Backward(
+          top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+    }
+    if (profile_layers_) { ProfileLayerStop(i, false); }
+    if (debug_info_ || debug_sample_this_iter_) { BackwardDebugInfo(i); }
+  }
+  for (int c = 0; c < after_backward_.size(); ++c) {
+    after_backward_[c]->run(i);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardCheckpointed(int start, int end) {
+  for (int seg = layer_checkpoint_segment_[start];
+       seg >= layer_checkpoint_segment_[end]; --seg) {
+    if (checkpoint_segment_dropped_[seg]) {
+      // Regenerate this segment's released activations from the
+      // checkpoints it reads before walking its backward. Layers whose
+      // tops stayed resident (data layers included) do not re-run.
+      for (int i = checkpoint_segment_starts_[seg];
+           i <= checkpoint_segment_ends_[seg]; ++i) {
+        if (!checkpoint_layer_recompute_[i]) { continue; }
+        TraceSpan trace("recompute", layer_names_[i]);
+        layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+      }
+      checkpoint_segment_dropped_[seg] = false;
+    }
+    const int backward_start = std::min(start, checkpoint_segment_ends_[seg]);
+    const int backward_end = std::max(end, checkpoint_segment_starts_[seg]);
+    for (int i = backward_start; i >= backward_end; --i) {
+      BackwardLayer(i);
+    }
+    // Keep at most one regenerated segment live at a time.
+    DropCheckpointSegment(seg);
+  }
+}
+
+// Iterations of history the per-layer profiler keeps per direction.
+static const size_t kProfileWindow = 256;
+
+static double profile_now_ms() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// q-th percentile by partial sort of a sample copy; q in [0, 1].
+static float timing_percentile(vector<float> samples, const float q) {
+  if (samples.empty()) { return 0; }
+  const int k = static_cast<int>(q * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+  return samples[k];
+}
+
+static float timing_max(const vector<float>& samples) {
+  if (samples.empty()) { return 0; }
+  return *std::max_element(samples.begin(), samples.end());
+}
+
+template <typename Dtype>
+void Net<Dtype>::set_profiling(const bool value) {
+  if (value && forward_times_.empty()) {
+    // First enable after an unprofiled Init; the GPU event pairs are
+    // still created lazily by ProfileLayerStart.
+    forward_times_.resize(layers_.size());
+    backward_times_.resize(layers_.size());
+    forward_times_next_.resize(layers_.size(), 0);
+    backward_times_next_.resize(layers_.size(), 0);
+    profile_start_ms_.resize(layers_.size(), 0);
+  }
+  profile_layers_ = value;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ProfileLayerStart(const int layer_id, const bool forward) {
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    if (profile_events_.empty()) {
+      profile_events_.resize(4 * layers_.size());
+      for (int i = 0; i < profile_events_.size(); ++i) {
+        CUDA_CHECK(cudaEventCreate(&profile_events_[i]));
+      }
+      profile_fwd_recorded_.resize(layers_.size(), false);
+      profile_bwd_recorded_.resize(layers_.size(), false);
+    }
+    const int base = 4 * layer_id + (forward ? 0 : 2);
+    vector<bool>& recorded =
+        forward ? profile_fwd_recorded_ : profile_bwd_recorded_;
+    if (recorded[layer_id]) {
+      // Harvest the previous iteration's pair before reusing it; by now
+      // it has normally long completed, so this is a host-side read. A
+      // pair still in flight is simply dropped, never waited on.
+      if (cudaEventQuery(profile_events_[base + 1]) == cudaSuccess) {
+        float ms;
+        CUDA_CHECK(cudaEventElapsedTime(&ms, profile_events_[base],
+            profile_events_[base + 1]));
+        AddTimingSample(layer_id, forward, ms);
+      } else {
+        cudaGetLastError();  // clear the benign not-ready status
+      }
+    }
+    CUDA_CHECK(cudaEventRecord(profile_events_[base], cudaStreamDefault));
+    return;
+  }
+#endif
+  if (forward) {
+    if (!perf_counters_) {
+      perf_counters_.reset(new PerfCounters());
+    }
+    perf_counters_->Start();
+  }
+  profile_start_ms_[layer_id] = profile_now_ms();
+}
+
+template <typename Dtype>
+void Net<Dtype>::ProfileLayerStop(const int layer_id, const bool forward) {
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    const int base = 4 * layer_id + (forward ? 0 : 2);
+    CUDA_CHECK(cudaEventRecord(profile_events_[base + 1],
+        cudaStreamDefault));
+    if (forward) {
+      profile_fwd_recorded_[layer_id] = true;
+    } else {
+      profile_bwd_recorded_[layer_id] = true;
+    }
+    return;
+  }
+#endif
+  AddTimingSample(layer_id, forward,
+      profile_now_ms() - profile_start_ms_[layer_id]);
+  if (forward && perf_counters_ && perf_counters_->available()) {
+    perf_counters_->Stop();
+    LayerPerfCounts& counts = perf_counts_by_type_[layers_[layer_id]->type()];
+    ++counts.calls;
+    counts.cycles += perf_counters_->cycles();
+    counts.llc_misses += perf_counters_->llc_misses();
+    counts.stalled_backend += perf_counters_->stalled_backend();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::AddTimingSample(const int layer_id, const bool forward,
+    const float ms) {
+  vector<float>& window =
+      forward ? forward_times_[layer_id] : backward_times_[layer_id];
+  size_t& next =
+      forward ? forward_times_next_[layer_id] : backward_times_next_[layer_id];
+  if (window.size() < kProfileWindow) {
+    window.push_back(ms);
+  } else {
+    window[next] = ms;
+    next = (next + 1) % kProfileWindow;
+  }
+}
+
+template <typename Dtype>
+vector<typename Net<Dtype>::LayerTiming> Net<Dtype>::layer_timings() {
+  vector<LayerTiming> timings;
+  if (!profile_layers_) { return timings; }
+  for (int i = 0; i < layers_.size(); ++i) {
+    LayerTiming timing;
+    timing.name = layer_names_[i];
+    timing.forward_samples = forward_times_[i].size();
+    timing.backward_samples = backward_times_[i].size();
+    timing.forward_p50 = timing_percentile(forward_times_[i], 0.5);
+    timing.forward_p90 = timing_percentile(forward_times_[i], 0.9);
+    timing.forward_max = timing_max(forward_times_[i]);
+    timing.backward_p50 = timing_percentile(backward_times_[i], 0.5);
+    timing.backward_p90 = timing_percentile(backward_times_[i], 0.9);
+    timing.backward_max = timing_max(backward_times_[i]);
+    timings.push_back(timing);
+  }
+  return timings;
+}
+
+template <typename Dtype>
+void Net<Dtype>::LogLayerTimings() {
+  const vector<LayerTiming> timings = layer_timings();
+  if (timings.empty()) { return; }
+  LOG(INFO) << "Per-layer timings over the last window "
+            << "(ms, p50/p90/max):";
+  for (int i = 0; i < timings.size(); ++i) {
+    const LayerTiming& t = timings[i];
+    if (t.forward_samples == 0 && t.backward_samples == 0) { continue; }
+    LOG(INFO) << "    " << t.name
+              << " forward " << t.forward_p50 << "/" << t.forward_p90
+              << "/" << t.forward_max
+              << ", backward " << t.backward_p50 << "/" << t.backward_p90
+              << "/" << t.backward_max;
+  }
+  if (!perf_counts_by_type_.empty()) {
+    LOG(INFO) << "Per-layer-type CPU counters since profiling started "
+              << "(Mcycles, LLC misses/kcycle, backend stall %):";
+    for (typename map<string, LayerPerfCounts>::const_iterator it =
+             perf_counts_by_type_.begin();
+         it != perf_counts_by_type_.end(); ++it) {
+      const LayerPerfCounts& c = it->second;
+      if (c.cycles == 0) { continue; }
+      LOG(INFO) << "    " << it->first
+                << " " << c.cycles / 1e6
+                << ", " << 1000.0 * c.llc_misses / c.cycles
+                << ", " << 100.0 * c.stalled_backend / c.cycles
+                << " (" << c.calls << " calls)";
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::ForwardDebugInfo(const int layer_id) {
+  const bool batched = debug_sample_this_iter_ && !debug_info_ &&
+      Caffe::mode() == Caffe::GPU && debug_asum_buffer_;
   for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
     const Blob<Dtype>& blob = *top_vecs_[layer_id][top_id];
     const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
-    const Dtype data_abs_val_mean = blob.asum_data() / blob.count();
-    LOG_IF(INFO, Caffe::root_solver())
-        << "    [Forward] "
+    std::ostringstream prefix;
+    prefix << "    [Forward] "
         << "Layer " << layer_names_[layer_id]
         << ", top blob " << blob_name
-        << " data: " << data_abs_val_mean;
+        << " data: ";
+    if (batched) {
+      QueueDebugAsum(blob, false, prefix.str());
+    } else {
+      const Dtype data_abs_val_mean = blob.asum_data() / blob.count();
+      LOG_IF(INFO, Caffe::root_solver()) << prefix.str() << data_abs_val_mean;
+    }
   }
   for (int param_id = 0; param_id < layers_[layer_id]->blobs().size();
        ++param_id) {
     const Blob<Dtype>& blob = *layers_[layer_id]->blobs()[param_id];
     const int net_param_id = param_id_vecs_[layer_id][param_id];
     const string& blob_name = param_display_names_[net_param_id];
-    const Dtype data_abs_val_mean = blob.asum_data() / blob.count();
-    LOG_IF(INFO, Caffe::root_solver())
-        << "    [Forward] "
+    std::ostringstream prefix;
+    prefix << "    [Forward] "
         << "Layer " << layer_names_[layer_id]
         << ", param blob " << blob_name
-        << " data: " << data_abs_val_mean;
+        << " data: ";
+    if (batched) {
+      QueueDebugAsum(blob, false, prefix.str());
+    } else {
+      const Dtype data_abs_val_mean = blob.asum_data() / blob.count();
+      LOG_IF(INFO, Caffe::root_solver()) << prefix.str() << data_abs_val_mean;
+    }
   }
 }
 
 template <typename Dtype>
 void Net<Dtype>::BackwardDebugInfo(const int layer_id) {
+  const bool batched = debug_sample_this_iter_ && !debug_info_ &&
+      Caffe::mode() == Caffe::GPU && debug_asum_buffer_;
   const vector<Blob<Dtype>*>& bottom_vec = bottom_vecs_[layer_id];
   for (int bottom_id = 0; bottom_id < bottom_vec.size(); ++bottom_id) {
     if (!bottom_need_backward_[layer_id][bottom_id]) { continue; }
     const Blob<Dtype>& blob = *bottom_vec[bottom_id];
     const string& blob_name = blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-    const Dtype diff_abs_val_mean = blob.asum_diff() / blob.count();
-    LOG_IF(INFO, Caffe::root_solver())
-        << "    [Backward] "
+    std::ostringstream prefix;
+    prefix << "    [Backward] "
         << "Layer " << layer_names_[layer_id]
         << ", bottom blob " << blob_name
-        << " diff: " << diff_abs_val_mean;
+        << " diff: ";
+    if (batched) {
+      QueueDebugAsum(blob, true, prefix.str());
+    } else {
+      const Dtype diff_abs_val_mean = blob.asum_diff() / blob.count();
+      LOG_IF(INFO, Caffe::root_solver()) << prefix.str() << diff_abs_val_mean;
+    }
   }
   for (int param_id = 0; param_id < layers_[layer_id]->blobs().size();
        ++param_id) {
     if (!layers_[layer_id]->param_propagate_down(param_id)) { continue; }
     const Blob<Dtype>& blob = *layers_[layer_id]->blobs()[param_id];
-    const Dtype diff_abs_val_mean = blob.asum_diff() / blob.count();
-    LOG_IF(INFO, Caffe::root_solver())
-        << "    [Backward] "
+    std::ostringstream prefix;
+    prefix << "    [Backward] "
         << "Layer " << layer_names_[layer_id]
         << ", param blob " << param_id
-        << " diff: " << diff_abs_val_mean;
+        << " diff: ";
+    if (batched) {
+      QueueDebugAsum(blob, true, prefix.str());
+    } else {
+      const Dtype diff_abs_val_mean = blob.asum_diff() / blob.count();
+      LOG_IF(INFO, Caffe::root_solver()) << prefix.str() << diff_abs_val_mean;
+    }
   }
 }
 
@@ -702,6 +2294,32 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ShareLayerParamsFrom(const Net* other, const int layer_id) {
+  const string& layer_name = layer_names_[layer_id];
+  int source_layer_id = 0;
+  while (source_layer_id != other->layer_names().size() &&
+      other->layer_names()[source_layer_id] != layer_name) {
+    ++source_layer_id;
+  }
+  if (source_layer_id == other->layer_names().size()) {
+    return;
+  }
+  Layer<Dtype>* source_layer = other->layers()[source_layer_id].get();
+  vector<shared_ptr<Blob<Dtype> > >& target_blobs = layers_[layer_id]->blobs();
+  CHECK_EQ(target_blobs.size(), source_layer->blobs().size())
+      << "Incompatible number of blobs for layer " << layer_name;
+  for (int j = 0; j < target_blobs.size(); ++j) {
+    Blob<Dtype>* source_blob = source_layer->blobs()[j].get();
+    CHECK(target_blobs[j]->shape() == source_blob->shape())
+        << "Cannot share param " << j << " weights from layer '"
+        << layer_name << "'; shape mismatch.  Source param shape is "
+        << source_blob->shape_string() << "; target param shape is "
+        << target_blobs[j]->shape_string();
+    target_blobs[j]->ShareData(*source_blob);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::BackwardFrom(int start) {
   BackwardFromTo(start, 0);
@@ -714,7 +2332,9 @@ void Net<Dtype>::BackwardTo(int end) {
 
 template <typename Dtype>
 void Net<Dtype>::Backward() {
-  BackwardFromTo(layers_.size() - 1, 0);
+  if (first_backward_layer_ < layers_.size()) {
+    BackwardFromTo(layers_.size() - 1, first_backward_layer_);
+  }
   if (debug_info_) {
     Dtype asum_data = 0, asum_diff = 0, sumsq_data = 0, sumsq_diff = 0;
     for (int i = 0; i < learnable_params_.size(); ++i) {
@@ -733,17 +2353,201 @@ void Net<Dtype>::Backward() {
 
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
+  // Start from private storage so stale concat/slice views cannot alias
+  // ranges that the new shapes have moved; re-wire once the new
+  // geometry has settled.
+  for (int i = 0; i < blobs_.size(); ++i) {
+    blobs_[i]->UnshareViews();
+  }
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  WireZeroCopyViews();
+#ifndef CPU_ONLY
+  // Blob geometry may have changed under a captured forward graph.
+  InvalidateForwardGraph();
+#endif
+}
+
+template <typename Dtype>
+void Net<Dtype>::Warmup() {
+  // Propagate shapes and let layers size their internal buffers.
+  Reshape();
+  // Touch every activation and parameter allocation so the lazy
+  // SyncedMemory (and, on the GPU, cudaMalloc) faults happen here.
+  const bool touch_diff = (phase_ == TRAIN);
+  for (int i = 0; i < blobs_.size() + params_.size(); ++i) {
+    Blob<Dtype>* blob = i < blobs_.size() ?
+        blobs_[i].get() : params_[i - blobs_.size()].get();
+#ifndef CPU_ONLY
+    if (Caffe::mode() == Caffe::GPU) {
+      blob->mutable_gpu_data();
+      if (touch_diff) { blob->mutable_gpu_diff(); }
+      continue;
+    }
+#endif
+    blob->mutable_cpu_data();
+    if (touch_diff) { blob->mutable_cpu_diff(); }
+  }
+  // One dummy forward pays cuDNN algorithm selection, workspace
+  // reservation and whatever lazily created scratch remains.
+  Forward();
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
   int num_source_layers = param.layer_size();
   for (int i = 0; i < num_source_layers; ++i) {
-    const LayerParameter& source_layer = param.layer(i);
+    CopyTrainedLayerFrom(param.layer(i));
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayerFrom(const LayerParameter& source_layer) {
+  const string& source_layer_name = source_layer.name();
+  int target_layer_id = 0;
+  while (target_layer_id != layer_names_.size() &&
+      layer_names_[target_layer_id] != source_layer_name) {
+    ++target_layer_id;
+  }
+  if (target_layer_id == layer_names_.size()) {
+    map<string, string>::const_iterator fold_it =
+        bn_fold_targets_.find(source_layer_name);
+    if (fold_it != bn_fold_targets_.end()) {
+      FoldSourceLayer(source_layer, fold_it->second);
+    } else {
+      LOG(INFO) << "Ignoring source layer " << source_layer_name;
+    }
+    return;
+  }
+  DLOG(INFO) << "Copying source layer " << source_layer_name;
+  vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+      layers_[target_layer_id]->blobs();
+  if (bn_fold_bias_convs_.count(source_layer_name)) {
+    // FoldBatchNorm synthesized this convolution's bias, so the source
+    // carries one blob fewer; the bias stays zero until its BatchNorm
+    // parameters fold in below.
+    CHECK_EQ(target_blobs.size(), source_layer.blobs_size() + 1)
+        << "Incompatible number of blobs for layer " << source_layer_name;
+  } else {
+    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+  }
+  for (int j = 0; j < source_layer.blobs_size(); ++j) {
+    if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
+      Blob<Dtype> source_blob;
+      const bool kReshape = true;
+      source_blob.FromProto(source_layer.blobs(j), kReshape);
+      LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Source param shape is "
+          << source_blob.shape_string() << "; target param shape is "
+          << target_blobs[j]->shape_string() << ". "
+          << "To learn this layer's parameters from scratch rather than "
+          << "copying from a saved net, rename the layer.";
+    }
+    const bool kReshape = false;
+    target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FoldSourceLayer(const LayerParameter& source_layer,
+    const string& conv_layer_name) {
+  int conv_layer_id = 0;
+  while (conv_layer_id != layer_names_.size() &&
+      layer_names_[conv_layer_id] != conv_layer_name) {
+    ++conv_layer_id;
+  }
+  CHECK_LT(conv_layer_id, layer_names_.size())
+      << "Fold target " << conv_layer_name << " missing from net.";
+  vector<shared_ptr<Blob<Dtype> > >& conv_blobs =
+      layers_[conv_layer_id]->blobs();
+  CHECK_EQ(conv_blobs.size(), 2)
+      << "Fold target " << conv_layer_name << " has no bias blob.";
+  Blob<Dtype>* weight = conv_blobs[0].get();
+  Blob<Dtype>* bias = conv_blobs[1].get();
+  const int num_output = weight->shape(0);
+  const int weight_dim = weight->count() / num_output;
+  CHECK_EQ(bias->count(), num_output);
+  Dtype* weight_data = weight->mutable_cpu_data();
+  Dtype* bias_data = bias->mutable_cpu_data();
+  // Both layers apply a per-channel affine map y = a * x + b, which folds
+  // as w *= a and bias = a * bias + b on top of whatever already folded.
+  if (source_layer.type() == "BatchNorm") {
+    CHECK_EQ(source_layer.blobs_size(), 3)
+        << "BatchNorm layer " << source_layer.name()
+        << " must carry mean, variance and moving average factor.";
+    Blob<Dtype> mean, variance, fraction;
+    mean.FromProto(source_layer.blobs(0));
+    variance.FromProto(source_layer.blobs(1));
+    fraction.FromProto(source_layer.blobs(2));
+    CHECK_EQ(mean.count(), num_output);
+    CHECK_EQ(variance.count(), num_output);
+    const Dtype scale_factor = fraction.cpu_data()[0] == 0 ?
+        0 : 1 / fraction.cpu_data()[0];
+    const Dtype eps = bn_fold_eps_[source_layer.name()];
+    for (int o = 0; o < num_output; ++o) {
+      const Dtype inv_std = Dtype(1) / std::sqrt(
+          variance.cpu_data()[o] * scale_factor + eps);
+      caffe_scal(weight_dim, inv_std, weight_data + o * weight_dim);
+      bias_data[o] = (bias_data[o] - mean.cpu_data()[o] * scale_factor) *
+          inv_std;
+    }
+  } else if (source_layer.type() == "Scale") {
+    CHECK_GE(source_layer.blobs_size(), 1)
+        << "Scale layer " << source_layer.name() << " has no scale blob.";
+    Blob<Dtype> gamma;
+    gamma.FromProto(source_layer.blobs(0));
+    CHECK_EQ(gamma.count(), num_output);
+    Blob<Dtype> beta;
+    const bool has_beta = source_layer.blobs_size() > 1;
+    if (has_beta) {
+      beta.FromProto(source_layer.blobs(1));
+      CHECK_EQ(beta.count(), num_output);
+    }
+    for (int o = 0; o < num_output; ++o) {
+      caffe_scal(weight_dim, gamma.cpu_data()[o],
+          weight_data + o * weight_dim);
+      bias_data[o] = bias_data[o] * gamma.cpu_data()[o] +
+          (has_beta ? beta.cpu_data()[o] : Dtype(0));
+    }
+  } else {
+    LOG(FATAL) << "Cannot fold layer " << source_layer.name() << " of type "
+        << source_layer.type() << " into " << conv_layer_name;
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
+  if (trained_filename.size() >= 3 &&
+      trained_filename.compare(trained_filename.size() - 3, 3, ".h5") == 0) {
+    CopyTrainedLayersFromHDF5(trained_filename);
+  } else if (trained_filename.size() >= 6 &&
+      trained_filename.compare(
+          trained_filename.size() - 6, 6, ".delta") == 0) {
+    CopyTrainedLayersFromDelta(trained_filename);
+  } else if (trained_filename.size() >= 5 &&
+      trained_filename.compare(
+          trained_filename.size() - 5, 5, ".flat") == 0) {
+    CopyTrainedLayersFromFlat(trained_filename);
+  } else {
+    CopyTrainedLayersFromBinaryProto(trained_filename);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromFlat(const string trained_filename) {
+  CHECK(bn_fold_targets_.empty())
+      << "Flat weight files do not support batch norm folding; "
+      << "load the folded binary proto and convert that instead.";
+  flat_weights_ = FlatWeights<Dtype>::Open(trained_filename);
+  const NetParameter& index = flat_weights_->index();
+  int blob_id = 0;
+  for (int i = 0; i < index.layer_size(); ++i) {
+    const LayerParameter& source_layer = index.layer(i);
     const string& source_layer_name = source_layer.name();
+    const int first_blob_id = blob_id;
+    blob_id += source_layer.blobs_size();
     int target_layer_id = 0;
     while (target_layer_id != layer_names_.size() &&
         layer_names_[target_layer_id] != source_layer_name) {
@@ -753,49 +2557,176 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
-    DLOG(INFO) << "Copying source layer " << source_layer_name;
+    DLOG(INFO) << "Mapping source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
         layers_[target_layer_id]->blobs();
     CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
         << "Incompatible number of blobs for layer " << source_layer_name;
-    for (int j = 0; j < target_blobs.size(); ++j) {
-      if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
-        Blob<Dtype> source_blob;
-        const bool kReshape = true;
-        source_blob.FromProto(source_layer.blobs(j), kReshape);
-        LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
-            << source_layer_name << "'; shape mismatch.  Source param shape is "
-            << source_blob.shape_string() << "; target param shape is "
-            << target_blobs[j]->shape_string() << ". "
-            << "To learn this layer's parameters from scratch rather than "
-            << "copying from a saved net, rename the layer.";
+    for (int j = 0; j < source_layer.blobs_size(); ++j) {
+      CHECK(target_blobs[j]->ShapeEquals(source_layer.blobs(j)))
+          << "Cannot map param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.";
+      // Point the param at the mapping instead of copying: the pages
+      // fault in on first use and stay shared across processes. The
+      // mapping is read-only, which training would violate, so this
+      // loader is for inference nets.
+      target_blobs[j]->set_cpu_data(const_cast<Dtype*>(
+          flat_weights_->blob_data(first_blob_id + j)));
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromDelta(const string trained_filename) {
+  NetParameterDelta delta;
+  ReadProtoFromBinaryFileOrDie(trained_filename, &delta);
+  LOG(INFO) << "Applying delta snapshot (iter " << delta.iter()
+            << ") to base " << delta.base();
+  NetParameter param;
+  ReadNetParamsFromBinaryFileOrDie(delta.base(), &param);
+  int blob_id = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer = param.mutable_layer(i);
+    for (int j = 0; j < layer->blobs_size(); ++j) {
+      CHECK_LT(blob_id, delta.blob_size())
+          << "Delta " << trained_filename << " has fewer blobs than its base";
+      const BlobDelta& blob_delta = delta.blob(blob_id);
+      BlobProto* proto = layer->mutable_blobs(j);
+      const string& quantized = blob_delta.quantized();
+      CHECK_EQ(proto->data_size(), quantized.size())
+          << "Delta blob " << blob_id << " does not match its base shape";
+      const float scale = blob_delta.scale();
+      for (int k = 0; k < proto->data_size(); ++k) {
+        proto->set_data(k, proto->data(k)
+            + scale * static_cast<signed char>(quantized[k]));
       }
-      const bool kReshape = false;
-      target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+      ++blob_id;
     }
   }
+  CHECK_EQ(blob_id, delta.blob_size())
+      << "Delta " << trained_filename << " has more blobs than its base";
+  CopyTrainedLayersFrom(param);
 }
 
 template <typename Dtype>
-void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
-  if (trained_filename.size() >= 3 &&
-      trained_filename.compare(trained_filename.size() - 3, 3, ".h5") == 0) {
-    CopyTrainedLayersFromHDF5(trained_filename);
-  } else {
-    CopyTrainedLayersFromBinaryProto(trained_filename);
+bool Net<Dtype>::StreamTrainedLayersFromBinaryProto(
+    const string& trained_filename) {
+  int fd = open(trained_filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << trained_filename;
+  FileInputStream* raw_input = new FileInputStream(fd);
+  CodedInputStream* coded_input = new CodedInputStream(raw_input);
+  coded_input->SetTotalBytesLimit(INT_MAX, 536870912);
+  bool streamed = true;
+  LayerParameter source_layer;
+  google::protobuf::uint32 tag;
+  while (streamed && (tag = coded_input->ReadTag()) != 0) {
+    if (tag >> 3 == NetParameter::kLayerFieldNumber && (tag & 7) == 2) {
+      google::protobuf::uint32 length;
+      if (!coded_input->ReadVarint32(&length)) {
+        streamed = false;
+        break;
+      }
+      const CodedInputStream::Limit limit = coded_input->PushLimit(length);
+      source_layer.Clear();
+      streamed = source_layer.MergeFromCodedStream(coded_input) &&
+          coded_input->ConsumedEntireMessage();
+      coded_input->PopLimit(limit);
+      if (streamed) {
+        CopyTrainedLayerFrom(source_layer);
+      }
+    } else if (tag >> 3 == NetParameter::kLayersFieldNumber) {
+      // Deprecated V1 format; needs the full upgrade parse.
+      streamed = false;
+    } else {
+      streamed = SkipBinaryProtoField(coded_input, tag);
+    }
   }
+  delete coded_input;
+  delete raw_input;
+  close(fd);
+  return streamed;
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
     const string trained_filename) {
+  // Stream the weights one layer at a time, so peak restore memory is
+  // bounded by the largest layer instead of the parsed proto plus the
+  // net (roughly three times the model). Deprecated-format files abort
+  // the stream and take the full parse-and-upgrade path below.
+  if (StreamTrainedLayersFromBinaryProto(trained_filename)) {
+    return;
+  }
   NetParameter param;
   ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
   CopyTrainedLayersFrom(param);
 }
 
+#ifndef CPU_ONLY
+template <typename Dtype>
+void Net<Dtype>::EnableUpdateEvents() {
+  if (update_events_.size() > 0) { return; }
+  update_events_.resize(layers_.size());
+  for (int i = 0; i < update_events_.size(); ++i) {
+    CUDA_CHECK(cudaEventCreateWithFlags(&update_events_[i],
+        cudaEventDisableTiming));
+  }
+}
+#endif
+
+template <typename Dtype>
+void Net<Dtype>::MapSharedWeights(const string& shm_name) {
+  MapSharedWeightsSegment(SharedWeights<Dtype>::Open(shm_name));
+}
+
+template <typename Dtype>
+void Net<Dtype>::MapSharedWeightsSegment(
+    const shared_ptr<SharedWeights<Dtype> >& segment) {
+  shared_weights_ = segment;
+  size_t total = 0;
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    total += learnable_params_[i]->count();
+  }
+  CHECK_EQ(total, shared_weights_->count())
+      << "Shared weight segment does not match this net's learnable params";
+  // Point every learnable param straight into the mapped segment
+  // (flattened in net order, like Params<Dtype>). Forward never writes
+  // param data, and the mapping is read-only, so evaluation is
+  // zero-copy and always sees the publisher's latest weights.
+  Dtype* data = const_cast<Dtype*>(shared_weights_->data());
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    learnable_params_[i]->set_cpu_data(data);
+    data += learnable_params_[i]->count();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromShared(const string& trained_filename) {
+  const string cache_name = trained_filename + ".weights_cache";
+  size_t total = 0;
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    total += learnable_params_[i]->count();
+  }
+  shared_ptr<SharedWeights<Dtype> > segment =
+      SharedWeights<Dtype>::CreateExclusive(cache_name, total);
+  if (segment) {
+    LOG(INFO) << "Loading " << trained_filename
+              << " and publishing the weight cache " << cache_name;
+    CopyTrainedLayersFrom(trained_filename);
+    segment->Publish(learnable_params_);
+  } else {
+    LOG(INFO) << "Mapping the published weight cache " << cache_name;
+    segment = SharedWeights<Dtype>::OpenWhenReady(cache_name);
+  }
+  // Both sides end up serving out of the mapping: the loader's private
+  // copies are dropped here, so the cache is the only physical copy.
+  MapSharedWeightsSegment(segment);
+}
+
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  CHECK(bn_fold_targets_.empty())
+      << "fold_batch_norm requires loading weights from a binary proto.";
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -844,10 +2775,27 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+vector<PrefetchStats> Net<Dtype>::prefetch_stats() const {
+  vector<PrefetchStats> stats;
+  for (int i = 0; i < layers_.size(); ++i) {
+    const BasePrefetchingDataLayer<Dtype>* layer =
+        dynamic_cast<const BasePrefetchingDataLayer<Dtype>*>(layers_[i].get());
+    if (layer != NULL) {
+      stats.push_back(PrefetchStats());
+      layer->prefetch_stats(&stats.back());
+    }
+  }
+  return stats;
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
   param->set_name(name_);
+  // A serialized net is current-format by construction; stamp it so
+  // snapshot restores skip the deprecation scans.
+  param->set_schema_version(kCurrentNetSchemaVersion);
   // Add bottom and top
   DLOG(INFO) << "Serializing " << layers_.size() << " layers";
   for (int i = 0; i < layers_.size(); ++i) {
@@ -857,7 +2805,8 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 }
 
 template <typename Dtype>
-void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+void Net<Dtype>::ToHDF5(const string& filename, bool write_diff,
+    int deflate) const {
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -893,12 +2842,12 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
       if (param_owners_[net_param_id] == -1) {
         // Only save params that own themselves
         hdf5_save_nd_dataset<Dtype>(layer_data_hid, dataset_name.str(),
-            *params_[net_param_id]);
+            *params_[net_param_id], false, deflate);
       }
       if (write_diff) {
         // Write diffs regardless of weight-sharing
         hdf5_save_nd_dataset<Dtype>(layer_diff_hid, dataset_name.str(),
-            *params_[net_param_id], true);
+            *params_[net_param_id], true, deflate);
       }
     }
     H5Gclose(layer_data_hid);
@@ -913,9 +2862,27 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void Net<Dtype>::set_loss_scale(Dtype scale) {
+  if (scale == loss_scale_) { return; }
+  // The loss multipliers live in the loss tops' diffs, written once by
+  // Layer::SetLossWeights; rewrite them so every backward pass from now
+  // on seeds the scaled gradient.
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < top_vecs_[i].size(); ++j) {
+      const Dtype loss_weight = layers_[i]->loss(j);
+      if (loss_weight == Dtype(0)) { continue; }
+      caffe_set(top_vecs_[i][j]->count(), loss_weight * scale,
+                top_vecs_[i][j]->mutable_cpu_diff());
+    }
+  }
+  loss_scale_ = scale;
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
+    if (!learnable_param_need_backward_[i]) { continue; }
     learnable_params_[i]->Update();
   }
 }
@@ -923,9 +2890,24 @@ void Net<Dtype>::Update() {
 template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
+    // Nothing ever writes a frozen param's diff, so there is nothing to
+    // clear -- and touching it here would be what allocates it.
+    if (!learnable_param_need_backward_[i]) { continue; }
     Blob<Dtype>* blob = learnable_params_[i];
     switch (Caffe::mode()) {
     case Caffe::CPU:
+      if (blob->has_sparse_diff_rows()) {
+        // Only the annotated rows were written since the last clear; the
+        // next backward pass re-annotates whatever it touches.
+        const vector<int>& rows = blob->sparse_diff_rows();
+        const int row_dim = blob->count() / blob->shape(0);
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int r = 0; r < rows.size(); ++r) {
+          caffe_set(row_dim, static_cast<Dtype>(0), diff + rows[r] * row_dim);
+        }
+        blob->clear_sparse_diff_rows();
+        break;
+      }
       caffe_set(blob->count(), static_cast<Dtype>(0),
                 blob->mutable_cpu_diff());
       break;
@@ -986,6 +2968,143 @@ const shared_ptr<Layer<Dtype> > Net<Dtype>::layer_by_name(
   return layer_ptr;
 }
 
+template <typename Dtype>
+void Net<Dtype>::ReplaceLayerParams(const string& layer_name,
+    const vector<shared_ptr<Blob<Dtype> > >& blobs) {
+  CHECK(has_layer(layer_name)) << "Unknown layer name " << layer_name;
+  const int layer_id = layer_names_index_.find(layer_name)->second;
+  vector<shared_ptr<Blob<Dtype> > >& targets = layers_[layer_id]->blobs();
+  CHECK_EQ(blobs.size(), targets.size())
+      << "Layer " << layer_name << " has " << targets.size() << " blobs";
+  for (int i = 0; i < targets.size(); ++i) {
+    Blob<Dtype>* target = targets[i].get();
+    const Blob<Dtype>* source = blobs[i].get();
+    CHECK(source->shape() == target->shape())
+        << "Cannot replace param " << i << " of layer " << layer_name
+        << ": shape " << source->shape_string() << " vs. "
+        << target->shape_string();
+    // In-place device copy: the blob's storage is shared with params_
+    // and any sharing layers, so every view sees the new values.
+#ifndef CPU_ONLY
+    if (Caffe::mode() == Caffe::GPU) {
+      caffe_copy(target->count(), source->gpu_data(),
+          target->mutable_gpu_data());
+      continue;
+    }
+#endif
+    caffe_copy(target->count(), source->cpu_data(),
+        target->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckSurgerySupported() {
+  CHECK(!profile_layers_) << "Layer surgery with profiling enabled";
+  CHECK_EQ(forward_parallelism_, 1)
+      << "Layer surgery with a dataflow-parallel forward";
+  CHECK(!activations_shared_) << "Layer surgery with pooled activations";
+  CHECK(!checkpointing_) << "Layer surgery with activation checkpointing";
+#ifndef CPU_ONLY
+  CHECK(update_events_.empty()) << "Layer surgery with overlapped updates";
+#endif
+}
+
+template <typename Dtype>
+void Net<Dtype>::InsertLayer(const LayerParameter& param) {
+  CheckSurgerySupported();
+  CHECK(!has_layer(param.name())) << "Duplicate layer name " << param.name();
+  CHECK_EQ(param.bottom_size(), 1) << "InsertLayer splices in-place layers";
+  CHECK_EQ(param.top_size(), 1) << "InsertLayer splices in-place layers";
+  CHECK_EQ(param.bottom(0), param.top(0))
+      << "InsertLayer splices in-place (element-wise) layers only";
+  CHECK(has_blob(param.bottom(0))) << "Unknown blob name " << param.bottom(0);
+  const int blob_id = blob_names_index_.find(param.bottom(0))->second;
+  // Insert after the last layer writing the blob, so the new layer sees
+  // its final value and downstream readers see the new layer's output.
+  int pos = -1;
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      if (top_id_vecs_[i][j] == blob_id) { pos = i; }
+    }
+  }
+  CHECK_GE(pos, 0) << "Blob " << param.bottom(0) << " has no producing layer";
+  ++pos;
+  shared_ptr<Layer<Dtype> > layer = LayerRegistry<Dtype>::CreateLayer(param);
+  vector<Blob<Dtype>*> blob_vec(1, blobs_[blob_id].get());
+  layer->SetUp(blob_vec, blob_vec);
+  CHECK(layer->blobs().empty())
+      << "InsertLayer supports parameter-free layers only";
+  const bool need_backward = blob_need_backward_[blob_id];
+  layers_.insert(layers_.begin() + pos, layer);
+  layer_names_.insert(layer_names_.begin() + pos, param.name());
+  layer_need_backward_.insert(layer_need_backward_.begin() + pos,
+      need_backward);
+  layer_fused_.insert(layer_fused_.begin() + pos, false);
+  param_id_vecs_.insert(param_id_vecs_.begin() + pos, vector<int>());
+  bottom_vecs_.insert(bottom_vecs_.begin() + pos, blob_vec);
+  bottom_id_vecs_.insert(bottom_id_vecs_.begin() + pos,
+      vector<int>(1, blob_id));
+  bottom_need_backward_.insert(bottom_need_backward_.begin() + pos,
+      vector<bool>(1, need_backward));
+  top_vecs_.insert(top_vecs_.begin() + pos, blob_vec);
+  top_id_vecs_.insert(top_id_vecs_.begin() + pos, vector<int>(1, blob_id));
+  // Layer ids above the splice point shift by one.
+  for (int i = 0; i < param_layer_indices_.size(); ++i) {
+    if (param_layer_indices_[i].first >= pos) {
+      ++param_layer_indices_[i].first;
+    }
+  }
+  for (int i = 0; i < learnable_param_layer_ids_.size(); ++i) {
+    if (learnable_param_layer_ids_[i] >= pos) {
+      ++learnable_param_layer_ids_[i];
+    }
+  }
+  if (pos <= first_backward_layer_) { ++first_backward_layer_; }
+  layer_names_index_.clear();
+  for (int i = 0; i < layer_names_.size(); ++i) {
+    layer_names_index_[layer_names_[i]] = i;
+  }
+  LOG(INFO) << "Inserted layer " << param.name() << " at position " << pos;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RemoveLayer(const string& layer_name) {
+  CheckSurgerySupported();
+  CHECK(has_layer(layer_name)) << "Unknown layer name " << layer_name;
+  const int pos = layer_names_index_.find(layer_name)->second;
+  CHECK(layers_[pos]->blobs().empty())
+      << "RemoveLayer supports parameter-free layers only";
+  CHECK(bottom_id_vecs_[pos].size() == 1 && top_id_vecs_[pos].size() == 1 &&
+        bottom_id_vecs_[pos][0] == top_id_vecs_[pos][0])
+      << "RemoveLayer supports in-place (element-wise) layers only";
+  layers_.erase(layers_.begin() + pos);
+  layer_names_.erase(layer_names_.begin() + pos);
+  layer_need_backward_.erase(layer_need_backward_.begin() + pos);
+  layer_fused_.erase(layer_fused_.begin() + pos);
+  param_id_vecs_.erase(param_id_vecs_.begin() + pos);
+  bottom_vecs_.erase(bottom_vecs_.begin() + pos);
+  bottom_id_vecs_.erase(bottom_id_vecs_.begin() + pos);
+  bottom_need_backward_.erase(bottom_need_backward_.begin() + pos);
+  top_vecs_.erase(top_vecs_.begin() + pos);
+  top_id_vecs_.erase(top_id_vecs_.begin() + pos);
+  for (int i = 0; i < param_layer_indices_.size(); ++i) {
+    if (param_layer_indices_[i].first > pos) {
+      --param_layer_indices_[i].first;
+    }
+  }
+  for (int i = 0; i < learnable_param_layer_ids_.size(); ++i) {
+    if (learnable_param_layer_ids_[i] > pos) {
+      --learnable_param_layer_ids_[i];
+    }
+  }
+  if (pos < first_backward_layer_) { --first_backward_layer_; }
+  layer_names_index_.clear();
+  for (int i = 0; i < layer_names_.size(); ++i) {
+    layer_names_index_[layer_names_[i]] = i;
+  }
+  LOG(INFO) << "Removed layer " << layer_name;
+}
+
 INSTANTIATE_CLASS(Net);
 
 }  // namespace caffe
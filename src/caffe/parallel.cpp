@@ -4,6 +4,9 @@
 #include <glog/logging.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -11,6 +14,8 @@
 #include "boost/thread.hpp"
 #include "caffe/caffe.hpp"
 #include "caffe/parallel.hpp"
+#include "caffe/util/chrome_trace.hpp"
+#include "caffe/util/nvtx.hpp"
 
 namespace caffe {
 
@@ -114,6 +119,32 @@ void GPUParams<Dtype>::configure(Solver<Dtype>* solver) const {
   apply_buffers(net, diff_, size_, replace_gpu_diff);
 }
 
+#ifndef CPU_ONLY
+// Link distance between two devices: lower is closer, and pairs that
+// cannot reach each other over P2P sort last. When the runtime exposes
+// it (CUDA 8+), the P2P performance rank orders accessible pairs too,
+// so NVLink and same-switch PCIe links are preferred over links that
+// cross the inter-socket interconnect. The rank is not guaranteed
+// symmetric, so take the worse direction.
+static int peer_distance(const int a, const int b) {
+  int access;
+  CUDA_CHECK(cudaDeviceCanAccessPeer(&access, a, b));
+  if (!access) {
+    return INT_MAX;
+  }
+#if CUDA_VERSION >= 8000
+  int rank_ab, rank_ba;
+  CUDA_CHECK(cudaDeviceGetP2PAttribute(&rank_ab,
+      cudaDevP2PAttrPerformanceRank, a, b));
+  CUDA_CHECK(cudaDeviceGetP2PAttribute(&rank_ba,
+      cudaDevP2PAttrPerformanceRank, b, a));
+  return std::max(rank_ab, rank_ba);
+#else
+  return 0;
+#endif
+}
+#endif
+
 void DevicePair::compute(const vector<int> devices, vector<DevicePair>* pairs) {
 #ifndef CPU_ONLY
   vector<int> remaining(devices);
@@ -145,28 +176,43 @@ void DevicePair::compute(const vector<int> devices, vector<DevicePair>* pairs) {
   }
   DLOG(INFO) << "GPUs paired by boards, remaining: " << s.str();
 
-  // Group by P2P accessibility
+  // Group by P2P link distance: each reduction round greedily takes the
+  // closest accessible pair left, so exchanges stay within a PCIe switch
+  // or NVLink clique instead of pairing across the CPU interconnect the
+  // way plain index order can on dual-root-complex machines.
   remaining_depth = ceil(log2(remaining.size()));
   for (int d = 0; d < remaining_depth; ++d) {
-    for (int i = 0; i < remaining.size(); ++i) {
-      for (int j = i + 1; j < remaining.size(); ++j) {
-        int access;
-        CUDA_CHECK(
-            cudaDeviceCanAccessPeer(&access, remaining[i], remaining[j]));
-        if (access) {
-          pairs->push_back(DevicePair(remaining[i], remaining[j]));
-          DLOG(INFO) << "P2P pair: " << remaining[i] << ":" << remaining[j];
-          remaining.erase(remaining.begin() + j);
-          break;
+    vector<bool> matched(remaining.size(), false);
+    while (true) {
+      int best_i = -1, best_j = -1, best = INT_MAX;
+      for (int i = 0; i < remaining.size(); ++i) {
+        if (matched[i]) { continue; }
+        for (int j = i + 1; j < remaining.size(); ++j) {
+          if (matched[j]) { continue; }
+          const int dist = peer_distance(remaining[i], remaining[j]);
+          if (dist < best) {
+            best = dist;
+            best_i = i;
+            best_j = j;
+          }
         }
       }
+      if (best == INT_MAX) {
+        break;
+      }
+      pairs->push_back(DevicePair(remaining[best_i], remaining[best_j]));
+      LOG(INFO) << "P2P pair: " << remaining[best_i] << ":"
+                << remaining[best_j] << " (link distance " << best << ")";
+      matched[best_i] = true;
+      remaining.erase(remaining.begin() + best_j);
+      matched.erase(matched.begin() + best_j);
     }
   }
   s.str("");
   for (int i = 0; i < remaining.size(); ++i) {
     s << (i ? ", " : "") << remaining[i];
   }
-  DLOG(INFO) << "GPUs paired by P2P access, remaining: " << s.str();
+  DLOG(INFO) << "GPUs paired by P2P link distance, remaining: " << s.str();
 
   // Group remaining
   remaining_depth = ceil(log2(remaining.size()));
@@ -206,6 +252,7 @@ P2PSync<Dtype>::P2PSync(shared_ptr<Solver<Dtype> > root_solver,
       children_(),
       queue_(),
       initial_iter_(root_solver->iter()),
+      staleness_tick_(0),
       solver_() {
 #ifndef CPU_ONLY
   int initial_device;
@@ -285,6 +332,8 @@ void P2PSync<Dtype>::InternalThreadEntry() {
 
 template<typename Dtype>
 void P2PSync<Dtype>::on_start() {
+  TraceSpan trace("p2p", "on_start");
+  NvtxRange nvtx("p2p on_start");
 #ifndef CPU_ONLY
 #ifdef DEBUG
   int device;
@@ -294,6 +343,55 @@ void P2PSync<Dtype>::on_start() {
 //  CHECK(false);
 #endif
 
+  const int staleness_period = solver_->param().staleness_period();
+  if (staleness_period > 0) {
+    // Bounded staleness: every solver runs on its own params and
+    // applies its own updates; replicas only meet here every
+    // staleness_period iterations for a moving-rate blend along the
+    // tree edges, so a slow board never paces the others in between.
+    if (staleness_tick_++ % staleness_period != 0) {
+      return;
+    }
+    const Dtype blend = solver_->param().staleness_blend();
+    vector<P2PSync<Dtype>*> parked;
+    if (parent_) {
+      // Park at the parent, then wait to be released. Parking children
+      // land in the same queue as the parent's release; drain until the
+      // parent shows up.
+      parent_->queue_.push(this);
+      while (true) {
+        P2PSync<Dtype>* peer = queue_.pop();
+        if (peer == parent_) {
+          break;
+        }
+        parked.push_back(peer);
+      }
+    }
+    for (int i = 0; i < children_.size(); ++i) {
+      P2PSync<Dtype>* child = i < parked.size() ? parked[i] : queue_.pop();
+      // Stage the child's params here (reusing its gradient staging
+      // buffer, idle in this mode), fold them into this replica with
+      // the moving rate, then hand back a blend against the updated
+      // values. Blending against the post-update params is a
+      // Gauss-Seidel flavor of the symmetric elastic blend; it needs
+      // no second staging buffer and couples just as well.
+      CUDA_CHECK(cudaMemcpyAsync(child->parent_grads_, child->data_,
+          size_ * sizeof(Dtype), cudaMemcpyDeviceToDevice,
+          cudaStreamDefault));
+      CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+      caffe_gpu_axpby(static_cast<int>(size_), blend, child->parent_grads_,
+          Dtype(1) - blend, data_);
+      caffe_gpu_axpby(static_cast<int>(size_), blend, data_,
+          Dtype(1) - blend, child->parent_grads_);
+      CUDA_CHECK(cudaMemcpyAsync(child->data_, child->parent_grads_,
+          size_ * sizeof(Dtype), cudaMemcpyDeviceToDevice,
+          cudaStreamDefault));
+      CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+      child->queue_.push(this);
+    }
+    return;
+  }
+
   // Wait for update from parent
   if (parent_) {
     P2PSync<Dtype> *parent = queue_.pop();
@@ -323,7 +421,14 @@ void P2PSync<Dtype>::on_start() {
 
 template<typename Dtype>
 void P2PSync<Dtype>::on_gradients_ready() {
+  TraceSpan trace("p2p", "on_gradients_ready");
+  NvtxRange nvtx("p2p on_gradients_ready");
 #ifndef CPU_ONLY
+  if (solver_->param().staleness_period() > 0) {
+    // Gradients stay local: each solver applies its own full-batch
+    // update and the periodic on_start blend keeps replicas coupled.
+    return;
+  }
 #ifdef DEBUG
   int device;
   CUDA_CHECK(cudaGetDevice(&device));
@@ -436,8 +541,314 @@ void P2PSync<Dtype>::Run(const vector<int>& gpus) {
   }
 }
 
+#ifdef USE_NCCL
+template<typename Dtype>
+NCCLSync<Dtype>::NCCLSync(shared_ptr<Solver<Dtype> > root_solver,
+                          const SolverParameter& param)
+    : GPUParams<Dtype>(root_solver, param.device_id()),
+      comm_(),
+      initial_iter_(root_solver->iter()),
+      solver_() {
+  int initial_device;
+  CUDA_CHECK(cudaGetDevice(&initial_device));
+  CUDA_CHECK(cudaSetDevice(param.device_id()));
+
+  if (param.device_id() == root_solver->param().device_id()) {
+    solver_ = root_solver;
+  } else {
+    Caffe::set_root_solver(false);
+    solver_.reset(new WorkerSolver<Dtype>(param, root_solver.get()));
+    Caffe::set_root_solver(true);
+  }
+  this->configure(solver_.get());
+  solver_->add_callback(this);
+  CUDA_CHECK(cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking));
+  if (param.layer_wise_reduce()) {
+    CHECK_EQ(solver_->net()->params().size(),
+             solver_->net()->learnable_params().size())
+        << "Layer-wise reduce is not supported for nets with shared weights.";
+    solver_->net()->add_after_backward(this);
+  }
+
+  CUDA_CHECK(cudaSetDevice(initial_device));
+}
+
+template<typename Dtype>
+NCCLSync<Dtype>::~NCCLSync() {
+  CUDA_CHECK(cudaStreamDestroy(stream_));
+  if (comm_) {
+    ncclCommDestroy(comm_);
+  }
+}
+
+template<typename Dtype>
+void NCCLSync<Dtype>::BroadcastInitialParams() {
+  NCCL_CHECK(ncclBcast(data_, size_, nccl::dataType<Dtype>::type, 0,
+      comm_, cudaStreamDefault));
+  CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+}
+
+template<typename Dtype>
+void NCCLSync<Dtype>::on_start() {
+  // Nothing to do: after the initial broadcast every rank applies the
+  // same update to the same averaged gradients, so params never drift.
+}
+
+template<typename Dtype>
+void NCCLSync<Dtype>::run(int layer) {
+  CHECK(solver_->param().layer_wise_reduce());
+  vector<shared_ptr<Blob<Dtype> > >& blobs =
+      solver_->net()->layers()[layer]->blobs();
+  if (blobs.size() == 0) {
+    return;
+  }
+  size_t size = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    size += blobs[i]->count();
+  }
+#ifdef DEBUG
+  // A layer's params occupy one contiguous slice of the diff buffer
+  // because configure() replaced them in append order.
+  Dtype* expected = blobs[0]->mutable_gpu_diff();
+  for (int i = 0; i < blobs.size(); ++i) {
+    CHECK_EQ(expected, blobs[i]->mutable_gpu_diff());
+    expected += blobs[i]->count();
+  }
+#endif
+  // The default stream is still producing gradients for the layers
+  // below; wait only for what it has already enqueued -- this layer's
+  // gradients among it -- then reduce on the side stream while the
+  // rest of the backward pass proceeds.
+  CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+  NCCL_CHECK(ncclAllReduce(blobs[0]->mutable_gpu_diff(),
+      blobs[0]->mutable_gpu_diff(), size, nccl::dataType<Dtype>::type,
+      ncclSum, comm_, stream_));
+}
+
+template<typename Dtype>
+void NCCLSync<Dtype>::on_gradients_ready() {
+  if (solver_->param().layer_wise_reduce()) {
+    // The per-layer reductions were issued from run() as Backward
+    // walked the net; only the tail can still be in flight.
+    CUDA_CHECK(cudaStreamSynchronize(stream_));
+  } else {
+    // Ring all-reduce sums the gradients in place on every rank.
+    NCCL_CHECK(ncclAllReduce(diff_, diff_, size_, nccl::dataType<Dtype>::type,
+        ncclSum, comm_, cudaStreamDefault));
+    CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+  }
+  // Each rank divides by the solver count locally to compensate for
+  // the split batch, exactly as the P2PSync root does.
+  caffe_gpu_scal(size_, Dtype(1.0 / Caffe::solver_count()), diff_);
+}
+
+template<typename Dtype>
+void NCCLSync<Dtype>::InternalThreadEntry() {
+  Caffe::SetDevice(solver_->param().device_id());
+  CHECK(Caffe::root_solver());
+  Caffe::set_root_solver(false);
+  if (solver_->param().random_seed() >= 0) {
+    // Modulate the seed by the device ID so workers draw different data
+    // transformations; see P2PSync::InternalThreadEntry.
+    Caffe::set_random_seed(
+        solver_->param().random_seed() + solver_->param().device_id());
+  }
+  BroadcastInitialParams();
+  solver_->Step(solver_->param().max_iter() - initial_iter_);
+}
+
+template<typename Dtype>
+void NCCLSync<Dtype>::Run(const vector<int>& gpus) {
+  // One communicator per device, created in a single call; the root
+  // keeps rank 0 so the initial parameter broadcast originates here.
+  CHECK_EQ(gpus[0], solver_->param().device_id());
+  vector<int> devices(gpus);
+  vector<ncclComm_t> comms(devices.size());
+  NCCL_CHECK(ncclCommInitAll(&comms[0], devices.size(), &devices[0]));
+  comm_ = comms[0];
+
+  vector<shared_ptr<NCCLSync<Dtype> > > syncs(devices.size());
+  SolverParameter param(solver_->param());
+  for (int i = 1; i < devices.size(); ++i) {
+    param.set_device_id(devices[i]);
+    syncs[i].reset(new NCCLSync<Dtype>(solver_, param));
+    syncs[i]->comm_ = comms[i];
+  }
+
+  LOG(INFO) << "Starting Optimization (NCCL ring all-reduce across "
+      << devices.size() << " GPUs)";
+
+  for (int i = 1; i < syncs.size(); ++i) {
+    syncs[i]->StartInternalThread();
+  }
+
+  // The broadcast is a collective: it rendezvouses with the one each
+  // worker thread issues before its first Step.
+  BroadcastInitialParams();
+
+  // Run root solver on current thread
+  solver_->Solve();
+
+  for (int i = 1; i < syncs.size(); ++i) {
+    syncs[i]->StopInternalThread();
+  }
+}
+
+INSTANTIATE_CLASS(NCCLSync);
+#endif  // USE_NCCL
+
+#ifdef USE_MPI
+template<typename Dtype>
+MPITransport<Dtype>::MPITransport() : rank_(0), size_(1), owns_mpi_(false) {
+  int initialized;
+  MPI_CHECK(MPI_Initialized(&initialized));
+  if (!initialized) {
+    MPI_CHECK(MPI_Init(NULL, NULL));
+    owns_mpi_ = true;
+  }
+  MPI_CHECK(MPI_Comm_rank(MPI_COMM_WORLD, &rank_));
+  MPI_CHECK(MPI_Comm_size(MPI_COMM_WORLD, &size_));
+}
+
+template<typename Dtype>
+MPITransport<Dtype>::~MPITransport() {
+  if (owns_mpi_) {
+    MPI_Finalize();
+  }
+}
+
+template<typename Dtype>
+void MPITransport<Dtype>::Broadcast(Dtype* data, size_t count, int root) {
+  MPI_CHECK(MPI_Bcast(data, count, mpi::dataType<Dtype>(), root,
+      MPI_COMM_WORLD));
+}
+
+template<typename Dtype>
+void MPITransport<Dtype>::AllReduceSum(Dtype* data, size_t count) {
+  MPI_CHECK(MPI_Allreduce(MPI_IN_PLACE, data, count, mpi::dataType<Dtype>(),
+      MPI_SUM, MPI_COMM_WORLD));
+}
+
+template<typename Dtype>
+void MPITransport<Dtype>::AllGather(const void* send, void* recv,
+                                    size_t bytes) {
+  MPI_CHECK(MPI_Allgather(const_cast<void*>(send), bytes, MPI_BYTE,
+      recv, bytes, MPI_BYTE, MPI_COMM_WORLD));
+}
+
+template<typename Dtype>
+void MPITransport<Dtype>::Barrier() {
+  MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+}
+
+INSTANTIATE_CLASS(MPITransport);
+#endif  // USE_MPI
+
+template<typename Dtype>
+DistributedSync<Dtype>::DistributedSync(
+    shared_ptr<Solver<Dtype> > root_solver,
+    shared_ptr<DistributedTransport<Dtype> > transport)
+    : GPUParams<Dtype>(root_solver, root_solver->param().device_id()),
+      transport_(transport),
+      solver_(root_solver),
+      staging_() {
+#ifndef CPU_ONLY
+  this->configure(solver_.get());
+  solver_->add_callback(this);
+  CUDA_CHECK(cudaMallocHost(&staging_, size_ * sizeof(Dtype)));
+  if (solver_->param().quantize_gradients()) {
+    residual_.assign(size_, Dtype(0));
+    // Per-rank wire format: one Dtype scale, then size_ signed bytes.
+    quant_send_.resize(sizeof(Dtype) + size_);
+    quant_recv_.resize(quant_send_.size() * transport_->size());
+  }
+  Caffe::set_multiprocess(true);
+  // One solver per process; the rank and process count let the data
+  // readers hand each rank a disjoint shard of the database.
+  Caffe::set_solver_count(1);
+  Caffe::set_solver_rank(transport_->rank());
+  Caffe::set_process_count(transport_->size());
+#else
+  NO_GPU;
+#endif
+}
+
+template<typename Dtype>
+DistributedSync<Dtype>::~DistributedSync() {
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaFreeHost(staging_));
+#endif
+}
+
+template<typename Dtype>
+void DistributedSync<Dtype>::on_start() {
+  // Nothing to do: ranks never drift after the initial broadcast.
+}
+
+template<typename Dtype>
+void DistributedSync<Dtype>::on_gradients_ready() {
+#ifndef CPU_ONLY
+  // Bounce the gradients through pinned host memory: the transport sums
+  // across ranks in place, then every rank averages locally.
+  caffe_copy(static_cast<int>(size_), diff_, staging_);
+  if (solver_->param().quantize_gradients()) {
+    // Fold in last step's quantization error, encode to 8 bits with a
+    // per-step scale, and keep the new error for the next step. The
+    // quantized payloads are gathered rather than reduced -- each rank
+    // has its own scale -- and decoded into a dense sum locally.
+    Dtype max_abs = 0;
+    for (size_t i = 0; i < size_; ++i) {
+      staging_[i] += residual_[i];
+      max_abs = std::max(max_abs, std::abs(staging_[i]));
+    }
+    const Dtype scale = max_abs / 127;
+    *reinterpret_cast<Dtype*>(&quant_send_[0]) = scale;
+    signed char* quantized =
+        reinterpret_cast<signed char*>(&quant_send_[sizeof(Dtype)]);
+    for (size_t i = 0; i < size_; ++i) {
+      const int q = scale > 0 ?
+          static_cast<int>(round(staging_[i] / scale)) : 0;
+      quantized[i] = static_cast<signed char>(q);
+      residual_[i] = staging_[i] - scale * q;
+    }
+    transport_->AllGather(&quant_send_[0], &quant_recv_[0],
+        quant_send_.size());
+    caffe_set(static_cast<int>(size_), Dtype(0), staging_);
+    for (int r = 0; r < transport_->size(); ++r) {
+      const char* payload = &quant_recv_[r * quant_send_.size()];
+      const Dtype rank_scale = *reinterpret_cast<const Dtype*>(payload);
+      const signed char* rank_quantized =
+          reinterpret_cast<const signed char*>(payload + sizeof(Dtype));
+      for (size_t i = 0; i < size_; ++i) {
+        staging_[i] += rank_scale * rank_quantized[i];
+      }
+    }
+  } else {
+    transport_->AllReduceSum(staging_, size_);
+  }
+  caffe_copy(static_cast<int>(size_), staging_, diff_);
+  caffe_gpu_scal(size_, Dtype(1.0 / transport_->size()), diff_);
+#endif
+}
+
+template<typename Dtype>
+void DistributedSync<Dtype>::Run() {
+#ifndef CPU_ONLY
+  caffe_copy(static_cast<int>(size_), data_, staging_);
+  transport_->Broadcast(staging_, size_, 0);
+  caffe_copy(static_cast<int>(size_), staging_, data_);
+
+  LOG(INFO) << "Starting Optimization (distributed rank "
+      << transport_->rank() << " of " << transport_->size() << ")";
+
+  solver_->Solve();
+  transport_->Barrier();
+#endif
+}
+
 INSTANTIATE_CLASS(Params);
 INSTANTIATE_CLASS(GPUParams);
 INSTANTIATE_CLASS(P2PSync);
+INSTANTIATE_CLASS(DistributedSync);
 
 }  // namespace caffe
@@ -1,12 +1,21 @@
 #include <cstdio>
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 
+#include "boost/thread.hpp"
+
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/solver.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/chrome_trace.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/signal_handler.h"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -18,6 +27,11 @@ void Solver<Dtype>::SetActionFunction(ActionCallback func) {
 
 template<typename Dtype>
 SolverAction::Enum Solver<Dtype>::GetRequestedAction() {
+  // One flag load on the no-signal path; the callback indirection only
+  // runs once a signal has actually arrived.
+  if (!SignalHandler::ActionPending()) {
+    return SolverAction::NONE;
+  }
   if (action_request_function_) {
     // If the external request function has been set, call it.
     return action_request_function_();
@@ -27,15 +41,15 @@ SolverAction::Enum Solver<Dtype>::GetRequestedAction() {
 
 template <typename Dtype>
 Solver<Dtype>::Solver(const SolverParameter& param, const Solver* root_solver)
-    : net_(), callbacks_(), root_solver_(root_solver),
-      requested_early_exit_(false) {
+    : net_(), callbacks_(), async_test_done_(true), async_test_iter_(0),
+      root_solver_(root_solver), requested_early_exit_(false) {
   Init(param);
 }
 
 template <typename Dtype>
 Solver<Dtype>::Solver(const string& param_file, const Solver* root_solver)
-    : net_(), callbacks_(), root_solver_(root_solver),
-      requested_early_exit_(false) {
+    : net_(), callbacks_(), async_test_done_(true), async_test_iter_(0),
+      root_solver_(root_solver), requested_early_exit_(false) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(param_file, &param);
   Init(param);
@@ -49,12 +63,47 @@ void Solver<Dtype>::Init(const SolverParameter& param) {
     << std::endl << param.DebugString();
   param_ = param;
   CHECK_GE(param_.average_loss(), 1) << "average_loss should be non-negative.";
+  snapshots_since_base_ = 0;
+  if (param_.metrics_log().size() && Caffe::root_solver()) {
+    metrics_sink_.reset(new MetricsSink(param_.metrics_log()));
+  }
   CheckSnapshotWritePermissions();
   if (Caffe::root_solver() && param_.random_seed() >= 0) {
     Caffe::set_random_seed(param_.random_seed());
   }
+  switch (param_.cudnn_backward_policy()) {
+  case SolverParameter_CuDNNBackwardPolicy_BACKWARD_FASTEST:
+    Caffe::set_cudnn_backward_policy(Caffe::CUDNN_BACKWARD_FASTEST);
+    break;
+  case SolverParameter_CuDNNBackwardPolicy_BACKWARD_DETERMINISTIC:
+    Caffe::set_cudnn_backward_policy(Caffe::CUDNN_BACKWARD_DETERMINISTIC);
+    break;
+  case SolverParameter_CuDNNBackwardPolicy_BACKWARD_MEMORY_LEAN:
+    Caffe::set_cudnn_backward_policy(Caffe::CUDNN_BACKWARD_MEMORY_LEAN);
+    break;
+  }
   // Scaffolding code
   InitTrainNet();
+  if (param_.async_loss_readback()) {
+    if (Caffe::mode() == Caffe::GPU) {
+      net_->set_async_loss(true);
+    } else {
+      LOG_IF(WARNING, Caffe::root_solver())
+          << "async_loss_readback requires GPU mode; ignored.";
+    }
+  }
+  if (param_.share_weights_shm().size() && Caffe::root_solver()) {
+    size_t count = 0;
+    const vector<Blob<Dtype>*>& params = net_->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      count += params[i]->count();
+    }
+    shared_weights_ =
+        SharedWeights<Dtype>::Create(param_.share_weights_shm(), count);
+    shared_weights_->Publish(params);
+    LOG(INFO) << "Publishing weights in shared segment "
+        << param_.share_weights_shm();
+  }
   if (Caffe::root_solver()) {
     InitTestNets();
     LOG(INFO) << "Solver scaffolding done.";
@@ -165,7 +214,9 @@ void Solver<Dtype>::InitTestNets() {
       ReadNetParamsFromTextFileOrDie(param_.net(), &net_params[test_net_id]);
     }
   }
-  test_nets_.resize(num_test_net_instances);
+  if (!param_.test_async()) {
+    test_nets_.resize(num_test_net_instances);
+  }
   for (int i = 0; i < num_test_net_instances; ++i) {
     // Set the correct NetState.  We start with the solver defaults (lowest
     // precedence); then, merge in any NetState specified by the net_param
@@ -178,10 +229,18 @@ void Solver<Dtype>::InitTestNets() {
       net_state.MergeFrom(param_.test_state(i));
     }
     net_params[i].mutable_state()->CopyFrom(net_state);
+    if (param_.test_async()) {
+      // The evaluation thread builds its own net from this definition,
+      // on its own device (see TestAllAsync).
+      async_test_net_params_.push_back(net_params[i]);
+      continue;
+    }
     LOG(INFO)
         << "Creating test net (#" << i << ") specified by " << sources[i];
     if (Caffe::root_solver()) {
-      test_nets_[i].reset(new Net<Dtype>(net_params[i]));
+      // Share the train net's param storage from the start so the test
+      // net never holds a second copy of the weights.
+      test_nets_[i].reset(new Net<Dtype>(net_params[i], NULL, net_.get()));
     } else {
       test_nets_[i].reset(new Net<Dtype>(net_params[i],
           root_solver_->test_nets_[i].get()));
@@ -190,6 +249,84 @@ void Solver<Dtype>::InitTestNets() {
   }
 }
 
+// Iteration latencies spread five orders of magnitude when something
+// stalls, so power-of-two buckets up to ~half an hour are plenty.
+static const int kIterationHistBuckets = 32;
+
+// Sums the consumer-side prefetch wait across the net's data layers,
+// i.e. the time Forward spent blocked popping prefetch_full_.
+template <typename Dtype>
+static double TotalConsumerWaitMs(const Net<Dtype>& net) {
+  const vector<PrefetchStats> stats = net.prefetch_stats();
+  double wait_us = 0;
+  for (int i = 0; i < stats.size(); ++i) {
+    wait_us += stats[i].consumer_wait_us;
+  }
+  return wait_us / 1000;
+}
+
+template <typename Dtype>
+void Solver<Dtype>::RecordIterationTime(const double total_ms,
+    const double data_wait_ms, const double update_ms,
+    const double snapshot_ms) {
+  if (iteration_hist_.empty()) {
+    iteration_hist_.resize(kIterationHistBuckets);
+  }
+  // Bucket 0 holds [0, 1) ms; bucket i holds [2^{i-1}, 2^i) ms.
+  int bucket = 0;
+  double upper = 1;
+  while (total_ms >= upper && bucket + 1 < iteration_hist_.size()) {
+    upper *= 2;
+    ++bucket;
+  }
+  IterationBucket& b = iteration_hist_[bucket];
+  ++b.count;
+  b.total_ms += total_ms;
+  b.data_wait_ms += data_wait_ms;
+  b.update_ms += update_ms;
+  b.snapshot_ms += snapshot_ms;
+}
+
+template <typename Dtype>
+void Solver<Dtype>::LogIterationHistogram() {
+  size_t total = 0;
+  for (int i = 0; i < iteration_hist_.size(); ++i) {
+    total += iteration_hist_[i].count;
+  }
+  if (total == 0) { return; }
+  LOG(INFO) << "Iteration latency histogram over " << total
+            << " iterations (avg ms in data-wait / ApplyUpdate / "
+            << "snapshot / other per bucket):";
+  double lower = 0, upper = 1;
+  size_t seen = 0;
+  double p50 = 0, p99 = 0, max_upper = 0;
+  for (int i = 0; i < iteration_hist_.size(); ++i) {
+    const IterationBucket& b = iteration_hist_[i];
+    if (b.count > 0) {
+      const double other = std::max(
+          b.total_ms - b.data_wait_ms - b.update_ms - b.snapshot_ms, 0.0);
+      LOG(INFO) << "    [" << lower << ", " << upper << ") ms: "
+                << b.count << " iters, "
+                << b.data_wait_ms / b.count << " / "
+                << b.update_ms / b.count << " / "
+                << b.snapshot_ms / b.count << " / "
+                << other / b.count;
+      if (seen < (total + 1) / 2 && seen + b.count >= (total + 1) / 2) {
+        p50 = upper;
+      }
+      if (seen * 100 < total * 99 && (seen + b.count) * 100 >= total * 99) {
+        p99 = upper;
+      }
+      max_upper = upper;
+      seen += b.count;
+    }
+    lower = upper;
+    upper *= 2;
+  }
+  LOG(INFO) << "    approx p50 < " << p50 << " ms, p99 < " << p99
+            << " ms, max < " << max_upper << " ms";
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Step(int iters) {
   const int start_iter = iter_;
@@ -199,6 +336,31 @@ void Solver<Dtype>::Step(int iters) {
   smoothed_loss_ = 0;
 
   while (iter_ < stop_iter) {
+    if (SignalHandler::GotTraceRequest()) {
+      if (ChromeTrace::enabled()) {
+        ChromeTrace::Stop();
+      } else {
+        ostringstream filename;
+        filename << "caffe_trace_iter_" << iter_ << ".json";
+        ChromeTrace::Start(filename.str());
+        ChromeTrace::SetThreadName("solver");
+      }
+    }
+    if (SignalHandler::GotProfileRequest()) {
+      if (net_->profiling()) {
+        // Dump what the window collected before switching off.
+        net_->LogLayerTimings();
+        net_->set_profiling(false);
+        LOG(INFO) << "Layer profiling disabled at iteration " << iter_;
+      } else {
+        net_->set_profiling(true);
+        LOG(INFO) << "Layer profiling enabled at iteration " << iter_;
+      }
+    }
+    TraceSpan iteration_span("solver", "iteration");
+    CPUTimer iteration_timer;
+    iteration_timer.Start();
+    const double data_wait_start_ms = TotalConsumerWaitMs(*net_);
     // zero-init the params
     net_->ClearParamDiffs();
     if (param_.test_interval() && iter_ % param_.test_interval() == 0
@@ -216,54 +378,94 @@ void Solver<Dtype>::Step(int iters) {
     }
     const bool display = param_.display() && iter_ % param_.display() == 0;
     net_->set_debug_info(display && param_.debug_info());
-    // accumulate the loss and gradient
+    // Accumulate the loss and gradient. The 1/iter_size normalization
+    // is applied at the loss seed, so the diffs accumulate already
+    // normalized (no rescaling sweep afterwards) and the scaled losses
+    // sum straight to the average.
+    net_->set_loss_scale(Dtype(1) / param_.iter_size());
     Dtype loss = 0;
-    for (int i = 0; i < param_.iter_size(); ++i) {
-      loss += net_->ForwardBackward();
+    {
+      TraceSpan span("solver", "forward_backward");
+      for (int i = 0; i < param_.iter_size(); ++i) {
+        loss += net_->ForwardBackward();
+      }
     }
-    loss /= param_.iter_size();
     // average the loss across iterations for smoothed reporting
     UpdateSmoothedLoss(loss, start_iter, average_loss);
     if (display) {
-      LOG_IF(INFO, Caffe::root_solver()) << "Iteration " << iter_
-          << ", loss = " << smoothed_loss_;
-      const vector<Blob<Dtype>*>& result = net_->output_blobs();
-      int score_index = 0;
-      for (int j = 0; j < result.size(); ++j) {
-        const Dtype* result_vec = result[j]->cpu_data();
-        const string& output_name =
-            net_->blob_names()[net_->output_blob_indices()[j]];
-        const Dtype loss_weight =
-            net_->blob_loss_weights()[net_->output_blob_indices()[j]];
-        for (int k = 0; k < result[j]->count(); ++k) {
-          ostringstream loss_msg_stream;
-          if (loss_weight) {
-            loss_msg_stream << " (* " << loss_weight
-                            << " = " << loss_weight * result_vec[k] << " loss)";
+      if (metrics_sink_) {
+        // Structured sink instead of glog: copy the values and move on,
+        // the flusher thread does the formatting and I/O.
+        RecordMetrics();
+      } else {
+        LOG_IF(INFO, Caffe::root_solver()) << "Iteration " << iter_
+            << ", loss = " << smoothed_loss_;
+        const vector<Blob<Dtype>*>& result = net_->output_blobs();
+        int score_index = 0;
+        for (int j = 0; j < result.size(); ++j) {
+          const Dtype* result_vec = result[j]->cpu_data();
+          const string& output_name =
+              net_->blob_names()[net_->output_blob_indices()[j]];
+          const Dtype loss_weight =
+              net_->blob_loss_weights()[net_->output_blob_indices()[j]];
+          for (int k = 0; k < result[j]->count(); ++k) {
+            ostringstream loss_msg_stream;
+            if (loss_weight) {
+              loss_msg_stream << " (* " << loss_weight << " = "
+                              << loss_weight * result_vec[k] << " loss)";
+            }
+            LOG_IF(INFO, Caffe::root_solver()) << "    Train net output #"
+                << score_index++ << ": " << output_name << " = "
+                << result_vec[k] << loss_msg_stream.str();
           }
-          LOG_IF(INFO, Caffe::root_solver()) << "    Train net output #"
-              << score_index++ << ": " << output_name << " = "
-              << result_vec[k] << loss_msg_stream.str();
         }
       }
     }
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
     }
-    ApplyUpdate();
+    double update_ms = 0;
+    {
+      TraceSpan span("solver", "ApplyUpdate");
+      CPUTimer update_timer;
+      update_timer.Start();
+      ApplyUpdate();
+      update_ms = update_timer.MilliSeconds();
+    }
 
     // Increment the internal iter_ counter -- its value should always indicate
     // the number of times the weights have been updated.
     ++iter_;
 
+    if (shared_weights_ && iter_ % param_.share_weights_interval() == 0) {
+      FinishUpdate();
+      shared_weights_->Publish(net_->learnable_params());
+    }
+
     SolverAction::Enum request = GetRequestedAction();
+    if (request != SolverAction::NONE && net_->profiling()) {
+      // A signal doubles as the profile dump trigger, so a SIGHUP
+      // reports where a live run spends its time.
+      net_->LogLayerTimings();
+    }
 
     // Save a snapshot if needed.
+    double snapshot_ms = 0;
     if ((param_.snapshot()
          && iter_ % param_.snapshot() == 0
          && Caffe::root_solver()) ||
          (request == SolverAction::SNAPSHOT)) {
+      CPUTimer snapshot_timer;
+      snapshot_timer.Start();
       Snapshot();
+      snapshot_ms = snapshot_timer.MilliSeconds();
+    }
+    RecordIterationTime(iteration_timer.MilliSeconds(),
+        TotalConsumerWaitMs(*net_) - data_wait_start_ms,
+        update_ms, snapshot_ms);
+    if (request != SolverAction::NONE && Caffe::root_solver()) {
+      // A signal also dumps the latency histogram of the live run.
+      LogIterationHistogram();
     }
     if (SolverAction::STOP == request) {
       requested_early_exit_ = true;
@@ -319,11 +521,19 @@ void Solver<Dtype>::Solve(const char* resume_file) {
   if (param_.test_interval() && iter_ % param_.test_interval() == 0) {
     TestAll();
   }
+  // Let a final asynchronous evaluation log its results before exit.
+  WaitForAsyncTest();
+  LogIterationHistogram();
   LOG(INFO) << "Optimization Done.";
 }
 
 template <typename Dtype>
 void Solver<Dtype>::TestAll() {
+  FinishUpdate();
+  if (param_.test_async()) {
+    TestAllAsync();
+    return;
+  }
   for (int test_net_id = 0;
        test_net_id < test_nets_.size() && !requested_early_exit_;
        ++test_net_id) {
@@ -331,6 +541,70 @@ void Solver<Dtype>::TestAll() {
   }
 }
 
+template <typename Dtype>
+void Solver<Dtype>::TestAllAsync() {
+  CHECK(Caffe::root_solver());
+  if (async_test_thread_ && !async_test_done_) {
+    LOG(INFO) << "Iteration " << iter_
+        << ", previous asynchronous test still running; skipping.";
+    return;
+  }
+  WaitForAsyncTest();
+  // Snapshot the weights; the background pass evaluates these while
+  // training keeps updating the live params.
+  async_test_weights_.reset(new NetParameter());
+  net_->ToProto(async_test_weights_.get(), false);
+  async_test_iter_ = iter_;
+  async_test_done_ = false;
+  int device = -1;
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    if (param_.test_async_device() >= 0) {
+      device = param_.test_async_device();
+    } else {
+      CUDA_CHECK(cudaGetDevice(&device));
+    }
+  }
+#endif
+  async_test_thread_.reset(new boost::thread(
+      &Solver<Dtype>::AsyncTestThread, this,
+      static_cast<int>(Caffe::mode()), device));
+}
+
+template <typename Dtype>
+void Solver<Dtype>::AsyncTestThread(const int mode, const int device) {
+  // Caffe state is thread local; mirror the solver thread's mode and
+  // pick the evaluation device before touching any blob.
+  Caffe::set_mode(static_cast<Caffe::Brew>(mode));
+#ifndef CPU_ONLY
+  if (device >= 0) {
+    Caffe::SetDevice(device);
+  }
+#endif
+  if (async_test_nets_.empty()) {
+    for (int i = 0; i < async_test_net_params_.size(); ++i) {
+      LOG(INFO) << "Creating asynchronous test net (#" << i << ")";
+      async_test_nets_.push_back(shared_ptr<Net<Dtype> >(
+          new Net<Dtype>(async_test_net_params_[i])));
+    }
+  }
+  for (int i = 0; i < async_test_nets_.size(); ++i) {
+    async_test_nets_[i]->CopyTrainedLayersFrom(*async_test_weights_);
+    LOG(INFO) << "Iteration " << async_test_iter_
+        << ", Testing net (#" << i << ") asynchronously";
+    TestOnNet(async_test_nets_[i].get(), i, async_test_iter_, false);
+  }
+  async_test_done_ = true;
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForAsyncTest() {
+  if (async_test_thread_) {
+    async_test_thread_->join();
+    async_test_thread_.reset();
+  }
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Test(const int test_net_id) {
   CHECK(Caffe::root_solver());
@@ -338,24 +612,34 @@ void Solver<Dtype>::Test(const int test_net_id) {
             << ", Testing net (#" << test_net_id << ")";
   CHECK_NOTNULL(test_nets_[test_net_id].get())->
       ShareTrainedLayersWith(net_.get());
+  TestOnNet(test_nets_[test_net_id].get(), test_net_id, iter_, true);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::TestOnNet(Net<Dtype>* test_net, const int test_net_id,
+    const int iteration, const bool handle_actions) {
   vector<Dtype> test_score;
   vector<int> test_score_output_id;
-  const shared_ptr<Net<Dtype> >& test_net = test_nets_[test_net_id];
+  // In GPU mode the per-iteration output blobs are summed on the device
+  // and read back once after the loop, instead of syncing every batch.
+  vector<shared_ptr<Blob<Dtype> > > test_score_accum;
   Dtype loss = 0;
   for (int i = 0; i < param_.test_iter(test_net_id); ++i) {
-    SolverAction::Enum request = GetRequestedAction();
-    // Check to see if stoppage of testing/training has been requested.
-    while (request != SolverAction::NONE) {
+    if (handle_actions) {
+      SolverAction::Enum request = GetRequestedAction();
+      // Check to see if stoppage of testing/training has been requested.
+      while (request != SolverAction::NONE) {
         if (SolverAction::SNAPSHOT == request) {
           Snapshot();
         } else if (SolverAction::STOP == request) {
           requested_early_exit_ = true;
         }
         request = GetRequestedAction();
-    }
-    if (requested_early_exit_) {
-      // break out of test loop.
-      break;
+      }
+      if (requested_early_exit_) {
+        // break out of test loop.
+        break;
+      }
     }
 
     Dtype iter_loss;
@@ -364,6 +648,23 @@ void Solver<Dtype>::Test(const int test_net_id) {
     if (param_.test_compute_loss()) {
       loss += iter_loss;
     }
+#ifndef CPU_ONLY
+    if (Caffe::mode() == Caffe::GPU) {
+      for (int j = 0; j < result.size(); ++j) {
+        if (i == 0) {
+          test_score_accum.push_back(shared_ptr<Blob<Dtype> >(
+              new Blob<Dtype>(result[j]->shape())));
+          caffe_copy(result[j]->count(), result[j]->gpu_data(),
+              test_score_accum[j]->mutable_gpu_data());
+        } else {
+          caffe_gpu_axpy(result[j]->count(), Dtype(1),
+              result[j]->gpu_data(),
+              test_score_accum[j]->mutable_gpu_data());
+        }
+      }
+      continue;
+    }
+#endif
     if (i == 0) {
       for (int j = 0; j < result.size(); ++j) {
         const Dtype* result_vec = result[j]->cpu_data();
@@ -382,6 +683,16 @@ void Solver<Dtype>::Test(const int test_net_id) {
       }
     }
   }
+#ifndef CPU_ONLY
+  // Single readback of the device-side sums.
+  for (int j = 0; j < test_score_accum.size(); ++j) {
+    const Dtype* result_vec = test_score_accum[j]->cpu_data();
+    for (int k = 0; k < test_score_accum[j]->count(); ++k) {
+      test_score.push_back(result_vec[k]);
+      test_score_output_id.push_back(j);
+    }
+  }
+#endif
   if (requested_early_exit_) {
     LOG(INFO)     << "Test interrupted.";
     return;
@@ -406,15 +717,49 @@ void Solver<Dtype>::Test(const int test_net_id) {
   }
 }
 
+template <typename Dtype>
+Solver<Dtype>::~Solver() {
+  WaitForSnapshot();
+  WaitForAsyncTest();
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForSnapshot() {
+  if (snapshot_thread_) {
+    snapshot_thread_->join();
+    snapshot_thread_.reset();
+  }
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Snapshot() {
   CHECK(Caffe::root_solver());
+  FinishUpdate();
+  // At most one writer in flight; a slow disk stalls here, not mid-step.
+  WaitForSnapshot();
   string model_filename;
   switch (param_.snapshot_format()) {
   case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
-    model_filename = SnapshotToBinaryProto();
+    if (param_.snapshot_delta() > 0 && !snapshot_base_.empty() &&
+        snapshots_since_base_ < param_.snapshot_delta()) {
+      model_filename = SnapshotToDelta();
+      ++snapshots_since_base_;
+      break;
+    }
+    if (param_.async_snapshot()) {
+      model_filename = SnapshotFilename(".caffemodel");
+      SnapshotToBinaryProtoAsync(model_filename);
+    } else {
+      model_filename = SnapshotToBinaryProto();
+    }
+    if (param_.snapshot_delta() > 0) {
+      CaptureSnapshotBase(model_filename);
+      snapshots_since_base_ = 0;
+    }
     break;
   case caffe::SolverParameter_SnapshotFormat_HDF5:
+    // HDF5 writes through the live blobs; async staging only supports
+    // the binary proto format.
     model_filename = SnapshotToHDF5();
     break;
   default:
@@ -424,6 +769,162 @@ void Solver<Dtype>::Snapshot() {
   SnapshotSolverState(model_filename);
 }
 
+template <typename Dtype>
+void Solver<Dtype>::SnapshotToBinaryProtoAsync(const string& model_filename) {
+  LOG(INFO) << "Snapshotting to binary proto file " << model_filename
+            << " in the background";
+  shared_ptr<SnapshotPayload> payload(new SnapshotPayload());
+  payload->model_filename = model_filename;
+  payload->write_diff = param_.snapshot_diff();
+  payload->net_param.reset(new NetParameter);
+  payload->net_param->set_name(net_->name());
+  // Stage the structure and deep host copies of the param blobs; the
+  // expensive proto fill and file write happen on the writer thread.
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    LayerParameter* layer_param = payload->net_param->add_layer();
+    layer_param->CopyFrom(layers[i]->layer_param());
+    layer_param->clear_blobs();
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layers[i]->blobs();
+    payload->layer_blob_counts.push_back(blobs.size());
+    for (int j = 0; j < blobs.size(); ++j) {
+      Blob<Dtype>* source = blobs[j].get();
+      shared_ptr<Blob<Dtype> > staged(new Blob<Dtype>(source->shape()));
+      if (Caffe::mode() == Caffe::GPU) {
+#ifndef CPU_ONLY
+        caffe_copy(source->count(), source->gpu_data(),
+                   staged->mutable_cpu_data());
+        if (payload->write_diff) {
+          caffe_copy(source->count(), source->gpu_diff(),
+                     staged->mutable_cpu_diff());
+        }
+#endif
+      } else {
+        caffe_copy(source->count(), source->cpu_data(),
+                   staged->mutable_cpu_data());
+        if (payload->write_diff) {
+          caffe_copy(source->count(), source->cpu_diff(),
+                     staged->mutable_cpu_diff());
+        }
+      }
+      payload->blobs.push_back(staged);
+    }
+  }
+  snapshot_thread_.reset(new boost::thread(
+      &Solver<Dtype>::SnapshotWriteThread, this, payload));
+}
+
+template <typename Dtype>
+void Solver<Dtype>::RecordMetrics() {
+  vector<float> values;
+  metrics_sink_->AddColumn("loss");
+  values.push_back(smoothed_loss_);
+  const vector<Blob<Dtype>*>& result = net_->output_blobs();
+  for (int j = 0; j < result.size(); ++j) {
+    const Dtype* result_vec = result[j]->cpu_data();
+    const string& output_name =
+        net_->blob_names()[net_->output_blob_indices()[j]];
+    for (int k = 0; k < result[j]->count(); ++k) {
+      if (result[j]->count() == 1) {
+        metrics_sink_->AddColumn(output_name);
+      } else {
+        ostringstream name;
+        name << output_name << "[" << k << "]";
+        metrics_sink_->AddColumn(name.str());
+      }
+      values.push_back(result_vec[k]);
+    }
+  }
+  metrics_sink_->Append(iter_, values);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::CaptureSnapshotBase(const string& model_filename) {
+  snapshot_base_filename_ = model_filename;
+  snapshot_base_.clear();
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layers[i]->blobs();
+    for (int j = 0; j < blobs.size(); ++j) {
+      Blob<Dtype>* source = blobs[j].get();
+      shared_ptr<Blob<Dtype> > copy(new Blob<Dtype>(source->shape()));
+      if (Caffe::mode() == Caffe::GPU) {
+#ifndef CPU_ONLY
+        caffe_copy(source->count(), source->gpu_data(),
+                   copy->mutable_cpu_data());
+#endif
+      } else {
+        caffe_copy(source->count(), source->cpu_data(),
+                   copy->mutable_cpu_data());
+      }
+      snapshot_base_.push_back(copy);
+    }
+  }
+}
+
+template <typename Dtype>
+string Solver<Dtype>::SnapshotToDelta() {
+  string model_filename = SnapshotFilename(".caffemodel.delta");
+  LOG(INFO) << "Snapshotting delta against " << snapshot_base_filename_
+            << " to " << model_filename;
+  NetParameterDelta delta;
+  delta.set_base(snapshot_base_filename_);
+  delta.set_iter(iter_);
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  int blob_id = 0;
+  for (int i = 0; i < layers.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layers[i]->blobs();
+    for (int j = 0; j < blobs.size(); ++j) {
+      Blob<Dtype>* source = blobs[j].get();
+      const Dtype* base = snapshot_base_[blob_id]->cpu_data();
+      const Dtype* data = source->cpu_data();
+      const int count = source->count();
+      // Per-blob max-abs scale, like the wire gradient quantization:
+      // one signed byte per element, a quarter of the full snapshot.
+      double max_abs = 0;
+      for (int k = 0; k < count; ++k) {
+        max_abs = std::max(max_abs,
+            std::abs(static_cast<double>(data[k] - base[k])));
+      }
+      const Dtype scale = static_cast<Dtype>(max_abs / 127);
+      BlobDelta* blob_delta = delta.add_blob();
+      blob_delta->set_scale(scale);
+      string* quantized = blob_delta->mutable_quantized();
+      quantized->resize(count);
+      char* q = &(*quantized)[0];
+      for (int k = 0; k < count; ++k) {
+        q[k] = scale > 0 ?
+            static_cast<char>(round((data[k] - base[k]) / scale)) : 0;
+      }
+      ++blob_id;
+    }
+  }
+  CHECK_EQ(blob_id, snapshot_base_.size())
+      << "Net changed shape since the base snapshot.";
+  WriteProtoToBinaryFile(delta, model_filename);
+  return model_filename;
+}
+
+template <typename Dtype>
+void Solver<Dtype>::SnapshotWriteThread(shared_ptr<SnapshotPayload> payload) {
+  int blob_id = 0;
+  for (int i = 0; i < payload->net_param->layer_size(); ++i) {
+    LayerParameter* layer_param = payload->net_param->mutable_layer(i);
+    for (int j = 0; j < payload->layer_blob_counts[i]; ++j) {
+      payload->blobs[blob_id++]->ToProto(layer_param->add_blobs(),
+                                         payload->write_diff);
+    }
+  }
+  // Write to a temp name and rename on completion, so a crash mid-write
+  // never leaves a truncated model under the snapshot name.
+  const string temp_filename = payload->model_filename + ".tmp";
+  WriteProtoToBinaryFile(*payload->net_param, temp_filename);
+  CHECK_EQ(0, std::rename(temp_filename.c_str(),
+                          payload->model_filename.c_str()))
+      << "Failed to rename " << temp_filename;
+  LOG(INFO) << "Snapshot written to " << payload->model_filename;
+}
+
 template <typename Dtype>
 void Solver<Dtype>::CheckSnapshotWritePermissions() {
   if (Caffe::root_solver() && param_.snapshot()) {
@@ -462,7 +963,8 @@ template <typename Dtype>
 string Solver<Dtype>::SnapshotToHDF5() {
   string model_filename = SnapshotFilename(".caffemodel.h5");
   LOG(INFO) << "Snapshotting to HDF5 file " << model_filename;
-  net_->ToHDF5(model_filename, param_.snapshot_diff());
+  net_->ToHDF5(model_filename, param_.snapshot_diff(),
+      param_.snapshot_hdf5_deflate());
   return model_filename;
 }
 
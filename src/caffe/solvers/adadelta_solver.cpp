@@ -6,14 +6,11 @@ namespace caffe {
 
 template <typename Dtype>
 void AdaDeltaSolver<Dtype>::AdaDeltaPreSolve() {
-  // Add the extra history entries for AdaDelta after those from
-  // SGDSolver::PreSolve
+  // Add slots for the extra history bank (the squared update running
+  // average) after those from SGDSolver::PreSolve; like them, the
+  // blobs themselves are allocated on first use.
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
-  for (int i = 0; i < net_params.size(); ++i) {
-        const vector<int>& shape = net_params[i]->shape();
-        this->history_.push_back(
-                shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
-  }
+  this->history_.resize(2 * net_params.size());
 }
 
 #ifndef CPU_ONLY
@@ -35,53 +32,54 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
     // compute square of gradient in update
     caffe_powx(net_params[param_id]->count(),
         net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // update history of gradients
     caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) - momentum,
-        this->update_[param_id]->cpu_data(), momentum,
-        this->history_[param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->cpu_data(), momentum,
+        this->history_blob(param_id)->mutable_cpu_data());
 
     // add delta to history to guard against dividing by zero later
     caffe_set(net_params[param_id]->count(), delta,
-        this->temp_[param_id]->mutable_cpu_data());
+        this->temp_blob(param_id)->mutable_cpu_data());
 
     caffe_add(net_params[param_id]->count(),
-        this->temp_[param_id]->cpu_data(),
-        this->history_[update_history_offset + param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
+        this->temp_blob(param_id)->cpu_data(),
+        this->history_blob(update_history_offset + param_id)->cpu_data(),
+        this->update_blob(param_id)->mutable_cpu_data());
 
     caffe_add(net_params[param_id]->count(),
-        this->temp_[param_id]->cpu_data(),
-        this->history_[param_id]->cpu_data(),
-        this->temp_[param_id]->mutable_cpu_data());
+        this->temp_blob(param_id)->cpu_data(),
+        this->history_blob(param_id)->cpu_data(),
+        this->temp_blob(param_id)->mutable_cpu_data());
 
     // divide history of updates by history of gradients
     caffe_div(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(),
-        this->temp_[param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->cpu_data(),
+        this->temp_blob(param_id)->cpu_data(),
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // jointly compute the RMS of both for update and gradient history
     caffe_powx(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(), Dtype(0.5),
-        this->update_[param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->cpu_data(), Dtype(0.5),
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // compute the update
     caffe_mul(net_params[param_id]->count(),
         net_params[param_id]->cpu_diff(),
-        this->update_[param_id]->cpu_data(),
+        this->update_blob(param_id)->cpu_data(),
         net_params[param_id]->mutable_cpu_diff());
 
     // compute square of update
     caffe_powx(net_params[param_id]->count(),
         net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // update history of updates
     caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) - momentum,
-        this->update_[param_id]->cpu_data(), momentum,
-        this->history_[update_history_offset + param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->cpu_data(), momentum,
+        this->history_blob(update_history_offset + param_id)
+            ->mutable_cpu_data());
 
     // apply learning rate
     caffe_cpu_scale(net_params[param_id]->count(), local_rate,
@@ -93,8 +91,9 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
 #ifndef CPU_ONLY
     adadelta_update_gpu(net_params[param_id]->count(),
         net_params[param_id]->mutable_gpu_diff(),
-        this->history_[param_id]->mutable_gpu_data(),
-        this->history_[update_history_offset + param_id]->mutable_gpu_data(),
+        this->history_blob(param_id)->mutable_gpu_data(),
+        this->history_blob(update_history_offset + param_id)
+            ->mutable_gpu_data(),
         momentum, delta, local_rate);
 #else
     NO_GPU;
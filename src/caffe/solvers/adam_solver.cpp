@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -6,14 +7,11 @@ namespace caffe {
 
 template <typename Dtype>
 void AdamSolver<Dtype>::AdamPreSolve() {
-  // Add the extra history entries for Adam after those from
-  // SGDSolver::PreSolve
+  // Add slots for the extra history bank (the second moment) after
+  // those from SGDSolver::PreSolve; like them, the blobs themselves
+  // are allocated on first use.
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
-  for (int i = 0; i < net_params.size(); ++i) {
-    const vector<int>& shape = net_params[i]->shape();
-    this->history_.push_back(
-            shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
-  }
+  this->history_.resize(2 * net_params.size());
 }
 
 #ifndef CPU_ONLY
@@ -32,9 +30,8 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
 
   // we create aliases for convenience
   size_t update_history_offset = net_params.size();
-  Blob<Dtype>* val_m = this->history_[param_id].get();
-  Blob<Dtype>* val_v = this->history_[param_id + update_history_offset].get();
-  Blob<Dtype>* val_t = this->temp_[param_id].get();
+  Blob<Dtype>* val_m = this->history_blob(param_id);
+  Blob<Dtype>* val_v = this->history_blob(param_id + update_history_offset);
 
   const int t = this->iter_ + 1;
   const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
@@ -44,33 +41,18 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
 
   switch (Caffe::mode()) {
     case Caffe::CPU: {
-    // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
-    caffe_cpu_axpby(N, Dtype(1)-beta1,
-        net_params[param_id]->cpu_diff(), beta1,
-        val_m->mutable_cpu_data());
-
-    // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
-    caffe_mul(N,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->cpu_diff(),
-    val_t->mutable_cpu_data());
-    caffe_cpu_axpby(N, Dtype(1)-beta2,
-        val_t->cpu_data(), beta2,
-        val_v->mutable_cpu_data());
-
-    // set update
-    caffe_powx(N,
-        val_v->cpu_data(), Dtype(0.5),
-        val_t->mutable_cpu_data());
-    caffe_add_scalar(N, eps_hat, val_t->mutable_cpu_data());
-    caffe_div(N,
-        val_m->cpu_data(),
-        val_t->cpu_data(),
-        val_t->mutable_cpu_data());
-
-    caffe_cpu_scale(N, local_rate*correction,
-        val_t->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    // One fused sweep: m and v advance and the bias-corrected update
+    // lands in the diff, with no mul/powx/div scratch passes and no
+    // temp blob alongside the m/v state.
+    Dtype* g = net_params[param_id]->mutable_cpu_diff();
+    Dtype* m = val_m->mutable_cpu_data();
+    Dtype* v = val_v->mutable_cpu_data();
+    for (int i = 0; i < N; ++i) {
+      const Dtype gi = g[i];
+      const Dtype mi = m[i] = beta1 * m[i] + (Dtype(1) - beta1) * gi;
+      const Dtype vi = v[i] = beta2 * v[i] + (Dtype(1) - beta2) * gi * gi;
+      g[i] = local_rate * correction * mi / (std::sqrt(vi) + eps_hat);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -21,22 +21,22 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   case Caffe::CPU: {
     // save history momentum for stepping back
     caffe_copy(net_params[param_id]->count(),
-        this->history_[param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
+        this->history_blob(param_id)->cpu_data(),
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // update history
     caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
               net_params[param_id]->cpu_diff(), momentum,
-              this->history_[param_id]->mutable_cpu_data());
+              this->history_blob(param_id)->mutable_cpu_data());
 
     // compute update: step back then over step
     caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) + momentum,
-        this->history_[param_id]->cpu_data(), -momentum,
-        this->update_[param_id]->mutable_cpu_data());
+        this->history_blob(param_id)->cpu_data(), -momentum,
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // copy
     caffe_copy(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(),
+        this->update_blob(param_id)->cpu_data(),
         net_params[param_id]->mutable_cpu_diff());
     break;
   }
@@ -44,7 +44,7 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
 #ifndef CPU_ONLY
     nesterov_update_gpu(net_params[param_id]->count(),
         net_params[param_id]->mutable_gpu_diff(),
-        this->history_[param_id]->mutable_gpu_data(),
+        this->history_blob(param_id)->mutable_gpu_data(),
         momentum, local_rate);
 #else
     NO_GPU;
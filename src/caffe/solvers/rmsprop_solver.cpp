@@ -25,35 +25,36 @@ void RMSPropSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
     // compute square of gradient in update
     caffe_powx(net_params[param_id]->count(),
         net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // update history
     caffe_cpu_axpby(net_params[param_id] -> count(),
-        Dtype(1-rms_decay), this->update_[param_id]->cpu_data(),
-        rms_decay, this->history_[param_id]-> mutable_cpu_data());
+        Dtype(1-rms_decay), this->update_blob(param_id)->cpu_data(),
+        rms_decay, this->history_blob(param_id)-> mutable_cpu_data());
 
     // prepare update
     caffe_powx(net_params[param_id]->count(),
-        this->history_[param_id]->cpu_data(), Dtype(0.5),
-        this->update_[param_id]->mutable_cpu_data());
+        this->history_blob(param_id)->cpu_data(), Dtype(0.5),
+        this->update_blob(param_id)->mutable_cpu_data());
 
     caffe_add_scalar(net_params[param_id]->count(),
-        delta, this->update_[param_id]->mutable_cpu_data());
+        delta, this->update_blob(param_id)->mutable_cpu_data());
 
     caffe_div(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(), this->update_[param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
+        net_params[param_id]->cpu_diff(),
+        this->update_blob(param_id)->cpu_data(),
+        this->update_blob(param_id)->mutable_cpu_data());
 
     // scale and copy
     caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-        this->update_[param_id]->cpu_data(), Dtype(0),
+        this->update_blob(param_id)->cpu_data(), Dtype(0),
         net_params[param_id]->mutable_cpu_diff());
     break;
   case Caffe::GPU:
 #ifndef CPU_ONLY
     rmsprop_update_gpu(net_params[param_id]->count(),
         net_params[param_id]->mutable_gpu_diff(),
-        this->history_[param_id]->mutable_gpu_data(),
+        this->history_blob(param_id)->mutable_gpu_data(),
         rms_decay, delta, local_rate);
 #else
     NO_GPU;
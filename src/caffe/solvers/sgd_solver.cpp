@@ -1,3 +1,9 @@
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include <climits>
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -8,38 +14,33 @@
 
 namespace caffe {
 
-// Return the current learning rate. The currently implemented learning rate
-// policies are as follows:
-//    - fixed: always return base_lr.
-//    - step: return base_lr * gamma ^ (floor(iter / step))
-//    - exp: return base_lr * gamma ^ iter
-//    - inv: return base_lr * (1 + gamma * iter) ^ (- power)
-//    - multistep: similar to step but it allows non uniform steps defined by
-//      stepvalue
-//    - poly: the effective learning rate follows a polynomial decay, to be
-//      zero by the max_iter. return base_lr (1 - iter/max_iter) ^ (power)
-//    - sigmoid: the effective learning rate follows a sigmod decay
-//      return base_lr ( 1/(1 + exp(-gamma * (iter - stepsize))))
-//
-// where base_lr, max_iter, gamma, step, stepvalue and power are defined
-// in the solver parameter protocol buffer, and iter is the current iteration.
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::FileInputStream;
+
+// Return the current learning rate according to the policy resolved in
+// PreSolve (see the lr_policy comment in caffe.proto for the formulas),
+// with the optional linear warmup applied first.
 template <typename Dtype>
 Dtype SGDSolver<Dtype>::GetLearningRate() {
   Dtype rate;
-  const string& lr_policy = this->param_.lr_policy();
-  if (lr_policy == "fixed") {
+  switch (lr_policy_) {
+  case LR_FIXED:
     rate = this->param_.base_lr();
-  } else if (lr_policy == "step") {
+    break;
+  case LR_STEP:
     this->current_step_ = this->iter_ / this->param_.stepsize();
     rate = this->param_.base_lr() *
         pow(this->param_.gamma(), this->current_step_);
-  } else if (lr_policy == "exp") {
+    break;
+  case LR_EXP:
     rate = this->param_.base_lr() * pow(this->param_.gamma(), this->iter_);
-  } else if (lr_policy == "inv") {
+    break;
+  case LR_INV:
     rate = this->param_.base_lr() *
         pow(Dtype(1) + this->param_.gamma() * this->iter_,
             - this->param_.power());
-  } else if (lr_policy == "multistep") {
+    break;
+  case LR_MULTISTEP:
     if (this->current_step_ < this->param_.stepvalue_size() &&
           this->iter_ >= this->param_.stepvalue(this->current_step_)) {
       this->current_step_++;
@@ -48,33 +49,151 @@ Dtype SGDSolver<Dtype>::GetLearningRate() {
     }
     rate = this->param_.base_lr() *
         pow(this->param_.gamma(), this->current_step_);
-  } else if (lr_policy == "poly") {
+    break;
+  case LR_POLY:
     rate = this->param_.base_lr() * pow(Dtype(1.) -
         (Dtype(this->iter_) / Dtype(this->param_.max_iter())),
         this->param_.power());
-  } else if (lr_policy == "sigmoid") {
+    break;
+  case LR_SIGMOID:
     rate = this->param_.base_lr() * (Dtype(1.) /
         (Dtype(1.) + exp(-this->param_.gamma() * (Dtype(this->iter_) -
           Dtype(this->param_.stepsize())))));
-  } else {
-    LOG(FATAL) << "Unknown learning rate policy: " << lr_policy;
+    break;
+  case LR_COSINE:
+    rate = this->param_.base_lr() * Dtype(0.5) *
+        (Dtype(1) + cos(M_PI * Dtype(this->iter_) /
+                        Dtype(this->param_.max_iter())));
+    break;
+  case LR_TRIANGULAR: {
+    // Period 2 * stepsize: zero at each cycle boundary, base_lr at the
+    // midpoint.
+    const int stepsize = this->param_.stepsize();
+    const int phase = this->iter_ % (2 * stepsize);
+    const int dist = phase < stepsize ? stepsize - phase : phase - stepsize;
+    rate = this->param_.base_lr() *
+        (Dtype(1) - Dtype(dist) / Dtype(stepsize));
+    break;
+  }
+  case LR_INTERP: {
+    // Linear interpolation through (stepvalue[i], stage_lr[i]),
+    // clamped at the endpoints.
+    const SolverParameter& p = this->param_;
+    const int n = p.stepvalue_size();
+    if (this->iter_ <= p.stepvalue(0)) {
+      rate = p.stage_lr(0);
+    } else if (this->iter_ >= p.stepvalue(n - 1)) {
+      rate = p.stage_lr(n - 1);
+    } else {
+      int i = 1;
+      while (this->iter_ > p.stepvalue(i)) { ++i; }
+      const Dtype alpha = Dtype(this->iter_ - p.stepvalue(i - 1)) /
+          Dtype(p.stepvalue(i) - p.stepvalue(i - 1));
+      rate = p.stage_lr(i - 1) + alpha * (p.stage_lr(i) - p.stage_lr(i - 1));
+    }
+    break;
+  }
+  default:
+    LOG(FATAL) << "Unknown learning rate policy: " << lr_policy_;
+    return 0;
+  }
+  if (this->iter_ < this->param_.warmup_iter()) {
+    // Linear ramp from warmup_start_lr to the policy rate.
+    const Dtype alpha = Dtype(this->iter_) /
+        Dtype(this->param_.warmup_iter());
+    rate = this->param_.warmup_start_lr() * (Dtype(1) - alpha) +
+        rate * alpha;
   }
   return rate;
 }
 
 template <typename Dtype>
 void SGDSolver<Dtype>::PreSolve() {
-  // Initialize the history
+#ifndef CPU_ONLY
+  update_stream_ = NULL;
+  grads_ready_event_ = NULL;
+  stats_gpu_ = NULL;
+  stats_pinned_ = NULL;
+  clip_gpu_ = NULL;
+#endif
+  // Resolve the learning rate policy string once; GetLearningRate then
+  // dispatches on the enum every iteration.
+  const string& lr_policy = this->param_.lr_policy();
+  if (lr_policy == "fixed") {
+    lr_policy_ = LR_FIXED;
+  } else if (lr_policy == "step") {
+    lr_policy_ = LR_STEP;
+  } else if (lr_policy == "exp") {
+    lr_policy_ = LR_EXP;
+  } else if (lr_policy == "inv") {
+    lr_policy_ = LR_INV;
+  } else if (lr_policy == "multistep") {
+    lr_policy_ = LR_MULTISTEP;
+  } else if (lr_policy == "poly") {
+    lr_policy_ = LR_POLY;
+  } else if (lr_policy == "sigmoid") {
+    lr_policy_ = LR_SIGMOID;
+  } else if (lr_policy == "cosine") {
+    lr_policy_ = LR_COSINE;
+  } else if (lr_policy == "triangular") {
+    CHECK_GT(this->param_.stepsize(), 0)
+        << "triangular lr policy needs a positive stepsize.";
+    lr_policy_ = LR_TRIANGULAR;
+  } else if (lr_policy == "interp") {
+    lr_policy_ = LR_INTERP;
+    CHECK_GT(this->param_.stepvalue_size(), 0)
+        << "interp lr policy needs stepvalue control points.";
+    CHECK_EQ(this->param_.stepvalue_size(), this->param_.stage_lr_size())
+        << "interp lr policy needs one stage_lr per stepvalue.";
+    for (int i = 1; i < this->param_.stepvalue_size(); ++i) {
+      CHECK_GT(this->param_.stepvalue(i), this->param_.stepvalue(i - 1))
+          << "interp lr policy stepvalues must increase.";
+    }
+  } else {
+    LOG(FATAL) << "Unknown learning rate policy: " << lr_policy;
+  }
+  // Size the state vectors but allocate nothing: the history_/update_/
+  // temp_ blobs are created on first use through the _blob() accessors,
+  // so each solver type only ever holds the slots its update path
+  // actually touches (momentum-0 SGD holds none of them).
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
   history_.clear();
   update_.clear();
   temp_.clear();
-  for (int i = 0; i < net_params.size(); ++i) {
-    const vector<int>& shape = net_params[i]->shape();
-    history_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
-    update_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
-    temp_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+  history_.resize(net_params.size());
+  update_.resize(net_params.size());
+  temp_.resize(net_params.size());
+}
+
+template <typename Dtype>
+Blob<Dtype>* SGDSolver<Dtype>::history_blob(int param_id) {
+  if (!history_[param_id]) {
+    // Fresh SyncedMemory reads back as zeros, the correct initial
+    // history. The modulus maps the second bank some solver types
+    // append (AdaDelta, Adam) back to its param's shape.
+    const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+    history_[param_id].reset(new Blob<Dtype>(
+        net_params[param_id % net_params.size()]->shape()));
   }
+  return history_[param_id].get();
+}
+
+template <typename Dtype>
+Blob<Dtype>* SGDSolver<Dtype>::update_blob(int param_id) {
+  if (!update_[param_id]) {
+    update_[param_id].reset(
+        new Blob<Dtype>(this->net_->learnable_params()[param_id]->shape()));
+  }
+  return update_[param_id].get();
+}
+
+template <typename Dtype>
+Blob<Dtype>* SGDSolver<Dtype>::temp_blob(int param_id) {
+  if (!temp_[param_id]) {
+    temp_[param_id].reset(
+        new Blob<Dtype>(this->net_->learnable_params()[param_id]->shape()));
+  }
+  return temp_[param_id].get();
 }
 
 template <typename Dtype>
@@ -82,9 +201,34 @@ void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const vector<bool>& need_backward =
+      this->net_->learnable_param_need_backward();
   Dtype sumsq_diff = 0;
-  for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+  if (Caffe::mode() == Caffe::GPU) {
+#ifndef CPU_ONLY
+    // Per-blob sumsq_diff() would block on a cublas result copy for
+    // every parameter blob; instead the warp-shuffle reduction kernels
+    // accumulate all blobs into one device scalar and the final
+    // readback below is the only sync.
+    if (clip_gpu_ == NULL) {
+      CUDA_CHECK(cudaMalloc(&clip_gpu_, sizeof(Dtype)));
+    }
+    caffe_gpu_memset(sizeof(Dtype), 0, clip_gpu_);
+    for (int i = 0; i < net_params.size(); ++i) {
+      if (!need_backward[i]) { continue; }
+      caffe_gpu_sumsq_acc(net_params[i]->count(),
+          net_params[i]->gpu_diff(), clip_gpu_);
+    }
+    CUDA_CHECK(cudaMemcpy(&sumsq_diff, clip_gpu_, sizeof(Dtype),
+        cudaMemcpyDeviceToHost));
+#else
+    NO_GPU;
+#endif
+  } else {
+    for (int i = 0; i < net_params.size(); ++i) {
+      if (!need_backward[i]) { continue; }
+      sumsq_diff += net_params[i]->sumsq_diff();
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -93,11 +237,39 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
+      if (!need_backward[i]) { continue; }
       net_params[i]->scale_diff(scale_factor);
     }
   }
 }
 
+template <typename Dtype>
+SGDSolver<Dtype>::~SGDSolver() {
+#ifndef CPU_ONLY
+  if (update_stream_) {
+    cudaStreamSynchronize(update_stream_);
+    cudaStreamDestroy(update_stream_);
+    cudaEventDestroy(grads_ready_event_);
+  }
+  if (stats_gpu_) {
+    cudaFree(stats_gpu_);
+    cudaFreeHost(stats_pinned_);
+  }
+  if (clip_gpu_) {
+    cudaFree(clip_gpu_);
+  }
+#endif
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::FinishUpdate() {
+#ifndef CPU_ONLY
+  if (update_stream_) {
+    CUDA_CHECK(cudaStreamSynchronize(update_stream_));
+  }
+#endif
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::ApplyUpdate() {
   CHECK(Caffe::root_solver());
@@ -106,31 +278,128 @@ void SGDSolver<Dtype>::ApplyUpdate() {
     LOG(INFO) << "Iteration " << this->iter_ << ", lr = " << rate;
   }
   ClipGradients();
+  // Only plain SGD knows how to apply sparse row annotations; other
+  // solver types compute dense update values everywhere, so fall back.
+  if (string(this->type()) != "SGD") {
+    const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+    for (int param_id = 0; param_id < net_params.size(); ++param_id) {
+      net_params[param_id]->clear_sparse_diff_rows();
+    }
+  }
+  // Plain SGD with L2 (or zero) decay takes the fused path: decay,
+  // momentum, normalization and the apply collapse into one sweep over
+  // each param instead of three or four. The other solver types
+  // override ComputeUpdateValue and L1 needs the sign scratch pass, so
+  // they keep the split pipeline.
+  const bool stats = this->param_.collect_update_stats();
+  const bool fused = string(this->type()) == "SGD" &&
+      (this->param_.regularization_type() == "L2" ||
+       this->param_.weight_decay() == 0);
+#ifndef CPU_ONLY
+  // Overlapped update: the fused kernels run on a side stream ordered
+  // after the backward kernels, recording a per-layer event as each
+  // param lands; the next Forward orders every layer after its event
+  // (Net::ForwardFromTo), so early layers start computing batch N+1
+  // while late params are still updating.
+  const bool overlap = this->param_.overlapped_update() &&
+      Caffe::mode() == Caffe::GPU && fused;
+  if (overlap && update_stream_ == NULL) {
+    CUDA_CHECK(cudaStreamCreateWithFlags(&update_stream_,
+        cudaStreamNonBlocking));
+    CUDA_CHECK(cudaEventCreateWithFlags(&grads_ready_event_,
+        cudaEventDisableTiming));
+    this->net_->EnableUpdateEvents();
+  }
+  if (overlap) {
+    CUDA_CHECK(cudaEventRecord(grads_ready_event_, cudaStreamDefault));
+    CUDA_CHECK(cudaStreamWaitEvent(update_stream_, grads_ready_event_, 0));
+  }
+#endif
+  const vector<bool>& param_need_backward =
+      this->net_->learnable_param_need_backward();
   for (int param_id = 0; param_id < this->net_->learnable_params().size();
        ++param_id) {
-    Normalize(param_id);
-    Regularize(param_id);
-    ComputeUpdateValue(param_id, rate);
+    // Frozen params have no gradient and a zero update; skipping them
+    // keeps their diff and history blobs unallocated.
+    if (!param_need_backward[param_id]) { continue; }
+    Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+    // The sparse-row path keeps its lazy per-row loops.
+    if (fused && !(Caffe::mode() == Caffe::CPU &&
+                   param->has_sparse_diff_rows())) {
+      FusedUpdate(param_id, rate);
+    } else {
+      Regularize(param_id);
+      ComputeUpdateValue(param_id, rate);
+      param->Update();
+    }
+    if (stats) { CollectUpdateStats(param_id); }
+#ifndef CPU_ONLY
+    if (overlap) {
+      CUDA_CHECK(cudaEventRecord(this->net_->update_event(
+          this->net_->learnable_param_layer_ids()[param_id]),
+          update_stream_));
+    }
+#endif
+  }
+#ifndef CPU_ONLY
+  if (stats && Caffe::mode() == Caffe::GPU && stats_gpu_ != NULL) {
+    // One small async readback per iteration; update_stats() reads the
+    // pinned copy, so the exposed values lag one iteration.
+    CUDA_CHECK(cudaMemcpyAsync(stats_pinned_, stats_gpu_,
+        update_stats_.size() * sizeof(Dtype), cudaMemcpyDeviceToHost,
+        update_stream_ ? update_stream_ : cudaStreamDefault));
+  }
+#endif
+  if (stats && this->param_.display() &&
+      this->iter_ % this->param_.display() == 0) {
+    const vector<Dtype> ratios = update_stats();
+    for (int i = 0; i < ratios.size(); ++i) {
+      LOG(INFO) << "    [UpdateStats] param " << i << " (layer "
+          << this->net_->layer_names()[
+              this->net_->learnable_param_layer_ids()[i]]
+          << "): update/weight ratio " << ratios[i];
+    }
   }
-  this->net_->Update();
 }
 
 template <typename Dtype>
-void SGDSolver<Dtype>::Normalize(int param_id) {
-  if (this->param_.iter_size() == 1) { return; }
-  // Scale gradient to counterbalance accumulation.
+void SGDSolver<Dtype>::CollectUpdateStats(int param_id) {
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
-  const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
+  Blob<Dtype>* param = net_params[param_id];
+  const int count = param->count();
+  if (update_stats_.empty()) {
+    update_stats_.resize(2 * net_params.size(), Dtype(0));
+  }
   switch (Caffe::mode()) {
-  case Caffe::CPU: {
-    caffe_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_cpu_diff());
+  case Caffe::CPU:
+    // The diff holds the applied update after ComputeUpdateValue or
+    // FusedUpdate, whichever path produced it.
+    update_stats_[2 * param_id] =
+        caffe_cpu_dot(count, param->cpu_diff(), param->cpu_diff());
+    update_stats_[2 * param_id + 1] =
+        caffe_cpu_dot(count, param->cpu_data(), param->cpu_data());
     break;
-  }
   case Caffe::GPU: {
 #ifndef CPU_ONLY
-    caffe_gpu_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_gpu_diff());
+    const size_t size = update_stats_.size() * sizeof(Dtype);
+    if (stats_gpu_ == NULL) {
+      CUDA_CHECK(cudaMalloc(&stats_gpu_, size));
+      caffe_gpu_memset(size, 0, stats_gpu_);
+      CUDA_CHECK(cudaMallocHost(&stats_pinned_, size));
+      caffe_memset(size, 0, stats_pinned_);
+    }
+    // Device-side results: no host sync here. In overlapped mode the
+    // dots follow the update on the side stream.
+    if (update_stream_) {
+      CUBLAS_CHECK(cublasSetStream(Caffe::cublas_handle(), update_stream_));
+    }
+    caffe_gpu_dot_device(count, param->gpu_diff(), param->gpu_diff(),
+        stats_gpu_ + 2 * param_id);
+    caffe_gpu_dot_device(count, param->gpu_data(), param->gpu_data(),
+        stats_gpu_ + 2 * param_id + 1);
+    if (update_stream_) {
+      CUBLAS_CHECK(cublasSetStream(Caffe::cublas_handle(), NULL));
+    }
 #else
     NO_GPU;
 #endif
@@ -141,6 +410,27 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   }
 }
 
+template <typename Dtype>
+vector<Dtype> SGDSolver<Dtype>::update_stats() {
+  vector<Dtype> ratios;
+  if (update_stats_.empty()) { return ratios; }
+  const Dtype* sums = &update_stats_[0];
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    if (stats_pinned_ == NULL) { return ratios; }
+    sums = stats_pinned_;
+  }
+#endif
+  const int n = update_stats_.size() / 2;
+  ratios.resize(n, Dtype(0));
+  for (int i = 0; i < n; ++i) {
+    if (sums[2 * i + 1] > 0) {
+      ratios[i] = std::sqrt(sums[2 * i] / sums[2 * i + 1]);
+    }
+  }
+  return ratios;
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::Regularize(int param_id) {
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -152,6 +442,28 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   switch (Caffe::mode()) {
   case Caffe::CPU: {
     if (local_decay) {
+      Blob<Dtype>* param = net_params[param_id];
+      if (param->has_sparse_diff_rows()) {
+        // Lazy regularization: only rows with gradient this step decay.
+        const vector<int>& rows = param->sparse_diff_rows();
+        const int row_dim = param->count() / param->shape(0);
+        const Dtype* data = param->cpu_data();
+        Dtype* diff = param->mutable_cpu_diff();
+        Dtype* temp = temp_blob(param_id)->mutable_cpu_data();
+        for (int r = 0; r < rows.size(); ++r) {
+          const int offset = rows[r] * row_dim;
+          if (regularization_type == "L2") {
+            caffe_axpy(row_dim, local_decay, data + offset, diff + offset);
+          } else if (regularization_type == "L1") {
+            caffe_cpu_sign(row_dim, data + offset, temp + offset);
+            caffe_axpy(row_dim, local_decay, temp + offset, diff + offset);
+          } else {
+            LOG(FATAL) << "Unknown regularization type: "
+                << regularization_type;
+          }
+        }
+        break;
+      }
       if (regularization_type == "L2") {
         // add weight decay
         caffe_axpy(net_params[param_id]->count(),
@@ -161,10 +473,10 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
       } else if (regularization_type == "L1") {
         caffe_cpu_sign(net_params[param_id]->count(),
             net_params[param_id]->cpu_data(),
-            temp_[param_id]->mutable_cpu_data());
+            temp_blob(param_id)->mutable_cpu_data());
         caffe_axpy(net_params[param_id]->count(),
             local_decay,
-            temp_[param_id]->cpu_data(),
+            temp_blob(param_id)->cpu_data(),
             net_params[param_id]->mutable_cpu_diff());
       } else {
         LOG(FATAL) << "Unknown regularization type: " << regularization_type;
@@ -184,10 +496,10 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
       } else if (regularization_type == "L1") {
         caffe_gpu_sign(net_params[param_id]->count(),
             net_params[param_id]->gpu_data(),
-            temp_[param_id]->mutable_gpu_data());
+            temp_blob(param_id)->mutable_gpu_data());
         caffe_gpu_axpy(net_params[param_id]->count(),
             local_decay,
-            temp_[param_id]->gpu_data(),
+            temp_blob(param_id)->gpu_data(),
             net_params[param_id]->mutable_gpu_diff());
       } else {
         LOG(FATAL) << "Unknown regularization type: " << regularization_type;
@@ -206,9 +518,55 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
 #ifndef CPU_ONLY
 template <typename Dtype>
 void sgd_update_gpu(int N, Dtype* g, Dtype* h, Dtype momentum,
-    Dtype local_rate);
+    Dtype local_rate, cudaStream_t stream);
+template <typename Dtype>
+void sgd_fused_update_gpu(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype momentum, Dtype local_rate, Dtype local_decay,
+    cudaStream_t stream);
 #endif
 
+template <typename Dtype>
+void SGDSolver<Dtype>::FusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  const Dtype local_decay = this->param_.weight_decay() *
+      this->net_->params_weight_decay()[param_id];
+  const int count = param->count();
+  switch (Caffe::mode()) {
+  case Caffe::CPU: {
+    Dtype* w = param->mutable_cpu_data();
+    Dtype* g = param->mutable_cpu_diff();
+    // With no momentum there is no history to read or keep.
+    Dtype* h = momentum != 0 ?
+        history_blob(param_id)->mutable_cpu_data() : NULL;
+    for (int i = 0; i < count; ++i) {
+      Dtype hi = local_rate * (g[i] + local_decay * w[i]);
+      if (h) {
+        hi += momentum * h[i];
+        h[i] = hi;
+      }
+      g[i] = hi;  // keep diff == applied update, as the split path does
+      w[i] -= hi;
+    }
+    break;
+  }
+  case Caffe::GPU:
+#ifndef CPU_ONLY
+    sgd_fused_update_gpu(count, param->mutable_gpu_data(),
+        param->mutable_gpu_diff(),
+        momentum != 0 ? history_blob(param_id)->mutable_gpu_data()
+                      : static_cast<Dtype*>(NULL),
+        momentum, local_rate, local_decay, update_stream_);
+#else
+    NO_GPU;
+#endif
+    break;
+  default:
+    LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
+  }
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -218,20 +576,52 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   // Compute the update to history, then copy it to the parameter diff.
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-              net_params[param_id]->cpu_diff(), momentum,
-              history_[param_id]->mutable_cpu_data());
-    caffe_copy(net_params[param_id]->count(),
-        history_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    Blob<Dtype>* param = net_params[param_id];
+    if (param->has_sparse_diff_rows()) {
+      // Lazy momentum: a row's history only advances on steps where the
+      // row has gradient, and applies in full when it is next touched.
+      const vector<int>& rows = param->sparse_diff_rows();
+      const int row_dim = param->count() / param->shape(0);
+      Dtype* diff = param->mutable_cpu_diff();
+      if (momentum == 0) {
+        for (int r = 0; r < rows.size(); ++r) {
+          caffe_scal(row_dim, local_rate, diff + rows[r] * row_dim);
+        }
+        break;
+      }
+      Dtype* history = history_blob(param_id)->mutable_cpu_data();
+      for (int r = 0; r < rows.size(); ++r) {
+        const int offset = rows[r] * row_dim;
+        caffe_cpu_axpby(row_dim, local_rate, diff + offset, momentum,
+            history + offset);
+        caffe_copy(row_dim, history + offset, diff + offset);
+      }
+      break;
+    }
+    if (momentum == 0) {
+      // No history to maintain: the update is the scaled gradient.
+      caffe_scal(param->count(), local_rate, param->mutable_cpu_diff());
+      break;
+    }
+    caffe_cpu_axpby(param->count(), local_rate,
+              param->cpu_diff(), momentum,
+              history_blob(param_id)->mutable_cpu_data());
+    caffe_copy(param->count(),
+        history_blob(param_id)->cpu_data(),
+        param->mutable_cpu_diff());
     break;
   }
   case Caffe::GPU: {
 #ifndef CPU_ONLY
+    if (momentum == 0) {
+      caffe_gpu_scal(net_params[param_id]->count(), local_rate,
+          net_params[param_id]->mutable_gpu_diff());
+      break;
+    }
     sgd_update_gpu(net_params[param_id]->count(),
         net_params[param_id]->mutable_gpu_diff(),
-        history_[param_id]->mutable_gpu_data(),
-        momentum, local_rate);
+        history_blob(param_id)->mutable_gpu_data(),
+        momentum, local_rate, update_stream_);
 #else
     NO_GPU;
 #endif
@@ -265,9 +655,10 @@ void SGDSolver<Dtype>::SnapshotSolverStateToBinaryProto(
   state.set_current_step(this->current_step_);
   state.clear_history();
   for (int i = 0; i < history_.size(); ++i) {
-    // Add history
-    BlobProto* history_blob = state.add_history();
-    history_[i]->ToProto(history_blob);
+    // Add history (materializing untouched slots as their implicit
+    // zeros, so the state format does not depend on what was lazily
+    // allocated)
+    history_blob(i)->ToProto(state.add_history());
   }
   string snapshot_filename = Solver<Dtype>::SnapshotFilename(".solverstate");
   LOG(INFO)
@@ -295,7 +686,8 @@ void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
   for (int i = 0; i < history_.size(); ++i) {
     ostringstream oss;
     oss << i;
-    hdf5_save_nd_dataset<Dtype>(history_hid, oss.str(), *history_[i]);
+    hdf5_save_nd_dataset<Dtype>(history_hid, oss.str(), *history_blob(i),
+        false, this->param_.snapshot_hdf5_deflate());
   }
   H5Gclose(history_hid);
   H5Fclose(file_hid);
@@ -304,21 +696,69 @@ void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
 template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
     const string& state_file) {
-  SolverState state;
-  ReadProtoFromBinaryFile(state_file, &state);
-  this->iter_ = state.iter();
-  if (state.has_learned_net()) {
-    NetParameter net_param;
-    ReadNetParamsFromBinaryFileOrDie(state.learned_net().c_str(), &net_param);
-    this->net_->CopyTrainedLayersFrom(net_param);
-  }
-  this->current_step_ = state.current_step();
-  CHECK_EQ(state.history_size(), history_.size())
-      << "Incorrect length of history blobs.";
-  LOG(INFO) << "SGDSolver: restoring history";
-  for (int i = 0; i < history_.size(); ++i) {
-    history_[i]->FromProto(state.history(i));
+  // Stream the state blob-by-blob with one reusable BlobProto instead of
+  // parsing the whole SolverState at once: the history is a full copy of
+  // the model, so the one-shot parse triples peak memory at restore.
+  int fd = open(state_file.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << state_file;
+  FileInputStream* raw_input = new FileInputStream(fd);
+  CodedInputStream* coded_input = new CodedInputStream(raw_input);
+  coded_input->SetTotalBytesLimit(INT_MAX, 536870912);
+  int num_history = 0;
+  BlobProto history_proto;
+  google::protobuf::uint32 tag;
+  while ((tag = coded_input->ReadTag()) != 0) {
+    switch (tag >> 3) {
+    case SolverState::kIterFieldNumber: {
+      google::protobuf::uint32 value;
+      CHECK(coded_input->ReadVarint32(&value))
+          << "Malformed solver state file " << state_file;
+      this->iter_ = static_cast<int>(value);
+      break;
+    }
+    case SolverState::kLearnedNetFieldNumber: {
+      google::protobuf::uint32 length;
+      string learned_net;
+      CHECK(coded_input->ReadVarint32(&length) &&
+          coded_input->ReadString(&learned_net, length))
+          << "Malformed solver state file " << state_file;
+      this->net_->CopyTrainedLayersFromBinaryProto(learned_net);
+      break;
+    }
+    case SolverState::kHistoryFieldNumber: {
+      google::protobuf::uint32 length;
+      CHECK(coded_input->ReadVarint32(&length))
+          << "Malformed solver state file " << state_file;
+      const CodedInputStream::Limit limit = coded_input->PushLimit(length);
+      history_proto.Clear();
+      CHECK(history_proto.MergeFromCodedStream(coded_input) &&
+          coded_input->ConsumedEntireMessage())
+          << "Malformed solver state file " << state_file;
+      coded_input->PopLimit(limit);
+      CHECK_LT(num_history, history_.size())
+          << "Incorrect length of history blobs.";
+      history_blob(num_history)->FromProto(history_proto);
+      ++num_history;
+      break;
+    }
+    case SolverState::kCurrentStepFieldNumber: {
+      google::protobuf::uint32 value;
+      CHECK(coded_input->ReadVarint32(&value))
+          << "Malformed solver state file " << state_file;
+      this->current_step_ = static_cast<int>(value);
+      break;
+    }
+    default:
+      CHECK(SkipBinaryProtoField(coded_input, tag))
+          << "Malformed solver state file " << state_file;
+    }
   }
+  delete coded_input;
+  delete raw_input;
+  close(fd);
+  CHECK_EQ(num_history, history_.size())
+      << "Incorrect length of history blobs.";
+  LOG(INFO) << "SGDSolver: restored history";
 }
 
 template <typename Dtype>
@@ -340,7 +780,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
     ostringstream oss;
     oss << i;
     hdf5_load_nd_dataset<Dtype>(history_hid, oss.str().c_str(), 0,
-                                kMaxBlobAxes, history_[i].get());
+                                kMaxBlobAxes, history_blob(i));
   }
   H5Gclose(history_hid);
   H5Fclose(file_hid);
@@ -12,13 +12,43 @@ __global__ void SGDUpdate(int N, Dtype* g, Dtype* h,
 }
 template <typename Dtype>
 void sgd_update_gpu(int N, Dtype* g, Dtype* h, Dtype momentum,
-    Dtype local_rate) {
+    Dtype local_rate, cudaStream_t stream) {
   SGDUpdate<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
-      <<<CAFFE_GET_BLOCKS(N), CAFFE_CUDA_NUM_THREADS>>>(
+      <<<CAFFE_GET_BLOCKS(N), CAFFE_CUDA_NUM_THREADS, 0, stream>>>(
       N, g, h, momentum, local_rate);
   CUDA_POST_KERNEL_CHECK;
 }
-template void sgd_update_gpu<float>(int, float*, float*, float, float);
-template void sgd_update_gpu<double>(int, double*, double*, double, double);
+template void sgd_update_gpu<float>(int, float*, float*, float, float,
+    cudaStream_t);
+template void sgd_update_gpu<double>(int, double*, double*, double, double,
+    cudaStream_t);
+
+template <typename Dtype>
+__global__ void SGDFusedUpdate(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype momentum, Dtype local_rate, Dtype local_decay) {
+  // h may be NULL for momentum 0, where no history is kept at all.
+  CUDA_KERNEL_LOOP(i, N) {
+    Dtype hi = local_rate*(g[i] + local_decay*w[i]);
+    if (h) {
+      hi += momentum*h[i];
+      h[i] = hi;
+    }
+    g[i] = hi;
+    w[i] -= hi;
+  }
+}
+template <typename Dtype>
+void sgd_fused_update_gpu(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype momentum, Dtype local_rate, Dtype local_decay,
+    cudaStream_t stream) {
+  SGDFusedUpdate<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
+      <<<CAFFE_GET_BLOCKS(N), CAFFE_CUDA_NUM_THREADS, 0, stream>>>(
+      N, w, g, h, momentum, local_rate, local_decay);
+  CUDA_POST_KERNEL_CHECK;
+}
+template void sgd_fused_update_gpu<float>(int, float*, float*, float*, float,
+    float, float, cudaStream_t);
+template void sgd_fused_update_gpu<double>(int, double*, double*, double*,
+    double, double, double, cudaStream_t);
 
 }  // namespace caffe
@@ -1,23 +1,162 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/gpu_allocator.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+namespace {
+
+struct TraceState {
+  explicit TraceState(int capacity)
+      : ring(), next(0), wrapped(false), capacity(capacity),
+        start(boost::posix_time::microsec_clock::local_time()) {}
+  vector<SyncedMemoryTrace::Record> ring;
+  int next;
+  bool wrapped;
+  int capacity;
+  boost::posix_time::ptime start;
+  string context;
+};
+
+boost::mutex trace_mutex;
+TraceState* trace_state = NULL;
+
+const char* head_name(SyncedMemory::SyncedHead head) {
+  switch (head) {
+  case SyncedMemory::UNINITIALIZED: return "UNINITIALIZED";
+  case SyncedMemory::HEAD_AT_CPU: return "HEAD_AT_CPU";
+  case SyncedMemory::HEAD_AT_GPU: return "HEAD_AT_GPU";
+  case SyncedMemory::SYNCED: return "SYNCED";
+  }
+  return "?";
+}
+
+}  // namespace
+
+volatile bool SyncedMemoryTrace::enabled_ = false;
+
+void SyncedMemoryTrace::Enable(int capacity) {
+  CHECK_GT(capacity, 0);
+  boost::mutex::scoped_lock lock(trace_mutex);
+  delete trace_state;
+  trace_state = new TraceState(capacity);
+  trace_state->ring.reserve(capacity);
+  enabled_ = true;
+}
+
+void SyncedMemoryTrace::Disable() {
+  boost::mutex::scoped_lock lock(trace_mutex);
+  enabled_ = false;
+  delete trace_state;
+  trace_state = NULL;
+}
+
+void SyncedMemoryTrace::set_context(const string& context) {
+  boost::mutex::scoped_lock lock(trace_mutex);
+  if (trace_state) { trace_state->context = context; }
+}
+
+void SyncedMemoryTrace::Push(const void* mem, SyncedMemory::SyncedHead from,
+    SyncedMemory::SyncedHead to, size_t size) {
+  boost::mutex::scoped_lock lock(trace_mutex);
+  if (trace_state == NULL) { return; }
+  Record record;
+  record.mem = mem;
+  record.context = trace_state->context;
+  record.from = from;
+  record.to = to;
+  record.size = size;
+  record.ms = (boost::posix_time::microsec_clock::local_time() -
+      trace_state->start).total_microseconds() / 1000.0;
+  if (trace_state->ring.size() < trace_state->capacity) {
+    trace_state->ring.push_back(record);
+  } else {
+    trace_state->ring[trace_state->next] = record;
+    trace_state->wrapped = true;
+  }
+  trace_state->next = (trace_state->next + 1) % trace_state->capacity;
+}
+
+vector<SyncedMemoryTrace::Record> SyncedMemoryTrace::records() {
+  boost::mutex::scoped_lock lock(trace_mutex);
+  vector<Record> snapshot;
+  if (trace_state == NULL) { return snapshot; }
+  if (trace_state->wrapped) {
+    // Oldest record first: the ring continues at next.
+    snapshot.insert(snapshot.end(),
+        trace_state->ring.begin() + trace_state->next,
+        trace_state->ring.end());
+    snapshot.insert(snapshot.end(), trace_state->ring.begin(),
+        trace_state->ring.begin() + trace_state->next);
+  } else {
+    snapshot = trace_state->ring;
+  }
+  return snapshot;
+}
+
+string SyncedMemoryTrace::Report() {
+  const vector<Record> snapshot = records();
+  // Per context: device-to-host and host-to-device copy bytes, and
+  // invalidations (a mutable access that will force a copy later).
+  map<string, vector<size_t> > traffic;
+  for (int i = 0; i < snapshot.size(); ++i) {
+    const Record& r = snapshot[i];
+    vector<size_t>& sums = traffic[r.context];
+    if (sums.empty()) { sums.resize(3, 0); }
+    if (r.from == SyncedMemory::HEAD_AT_GPU &&
+        r.to == SyncedMemory::SYNCED) {
+      sums[0] += r.size;
+    } else if (r.from == SyncedMemory::HEAD_AT_CPU &&
+               r.to == SyncedMemory::SYNCED) {
+      sums[1] += r.size;
+    } else if (r.from == SyncedMemory::SYNCED) {
+      sums[2] += r.size;
+    }
+  }
+  ostringstream report;
+  report << "SyncedMemory transitions (" << snapshot.size() << " records):"
+      << std::endl;
+  for (map<string, vector<size_t> >::const_iterator it = traffic.begin();
+       it != traffic.end(); ++it) {
+    report << "  [" << (it->first.empty() ? "<none>" : it->first) << "]"
+        << " D2H " << it->second[0] << " B,"
+        << " H2D " << it->second[1] << " B,"
+        << " invalidated " << it->second[2] << " B" << std::endl;
+  }
+  return report.str();
+}
+
+size_t SyncedMemory::device_bytes_ = 0;
+size_t SyncedMemory::peak_device_bytes_ = 0;
+
+void SyncedMemory::track_gpu_alloc() {
+  device_bytes_ += size_;
+  if (device_bytes_ > peak_device_bytes_) {
+    peak_device_bytes_ = device_bytes_;
+  }
+}
+
+void SyncedMemory::track_gpu_free() {
+  device_bytes_ -= size_;
+}
+
 SyncedMemory::~SyncedMemory() {
   if (cpu_ptr_ && own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, cpu_alloc_mode_);
   }
 
 #ifndef CPU_ONLY
   if (gpu_ptr_ && own_gpu_data_) {
-    int initial_device;
-    cudaGetDevice(&initial_device);
-    if (gpu_device_ != -1) {
-      CUDA_CHECK(cudaSetDevice(gpu_device_));
-    }
-    CUDA_CHECK(cudaFree(gpu_ptr_));
-    cudaSetDevice(initial_device);
+    GPUAllocator::Put(gpu_ptr_, size_, gpu_device_);
+    track_gpu_free();
   }
 #endif  // CPU_ONLY
 }
@@ -25,7 +164,7 @@ SyncedMemory::~SyncedMemory() {
 inline void SyncedMemory::to_cpu() {
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_alloc_mode_);
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -33,10 +172,13 @@ inline void SyncedMemory::to_cpu() {
   case HEAD_AT_GPU:
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_alloc_mode_);
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
+    if (SyncedMemoryTrace::enabled()) {
+      SyncedMemoryTrace::Push(this, HEAD_AT_GPU, SYNCED, size_);
+    }
     head_ = SYNCED;
 #else
     NO_GPU;
@@ -52,19 +194,24 @@ inline void SyncedMemory::to_gpu() {
 #ifndef CPU_ONLY
   switch (head_) {
   case UNINITIALIZED:
-    CUDA_CHECK(cudaGetDevice(&gpu_device_));
-    CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    CHECK(GPUAllocator::Get(&gpu_ptr_, size_, &gpu_device_))
+        << "device allocation of size " << size_ << " failed";
+    track_gpu_alloc();
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
     break;
   case HEAD_AT_CPU:
     if (gpu_ptr_ == NULL) {
-      CUDA_CHECK(cudaGetDevice(&gpu_device_));
-      CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+      CHECK(GPUAllocator::Get(&gpu_ptr_, size_, &gpu_device_))
+          << "device allocation of size " << size_ << " failed";
+      track_gpu_alloc();
       own_gpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
+    if (SyncedMemoryTrace::enabled()) {
+      SyncedMemoryTrace::Push(this, HEAD_AT_CPU, SYNCED, size_);
+    }
     head_ = SYNCED;
     break;
   case HEAD_AT_GPU:
@@ -77,14 +224,18 @@ inline void SyncedMemory::to_gpu() {
 }
 
 const void* SyncedMemory::cpu_data() {
+  if (view_parent_) {
+    return static_cast<const char*>(view_parent_->cpu_data()) + view_offset_;
+  }
   to_cpu();
   return (const void*)cpu_ptr_;
 }
 
 void SyncedMemory::set_cpu_data(void* data) {
+  CHECK(!view_parent_) << "cannot rebind a view SyncedMemory";
   CHECK(data);
   if (own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, cpu_alloc_mode_);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
@@ -93,6 +244,9 @@ void SyncedMemory::set_cpu_data(void* data) {
 
 const void* SyncedMemory::gpu_data() {
 #ifndef CPU_ONLY
+  if (view_parent_) {
+    return static_cast<const char*>(view_parent_->gpu_data()) + view_offset_;
+  }
   to_gpu();
   return (const void*)gpu_ptr_;
 #else
@@ -103,15 +257,11 @@ const void* SyncedMemory::gpu_data() {
 
 void SyncedMemory::set_gpu_data(void* data) {
 #ifndef CPU_ONLY
+  CHECK(!view_parent_) << "cannot rebind a view SyncedMemory";
   CHECK(data);
   if (own_gpu_data_) {
-    int initial_device;
-    cudaGetDevice(&initial_device);
-    if (gpu_device_ != -1) {
-      CUDA_CHECK(cudaSetDevice(gpu_device_));
-    }
-    CUDA_CHECK(cudaFree(gpu_ptr_));
-    cudaSetDevice(initial_device);
+    GPUAllocator::Put(gpu_ptr_, size_, gpu_device_);
+    track_gpu_free();
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
@@ -122,14 +272,28 @@ void SyncedMemory::set_gpu_data(void* data) {
 }
 
 void* SyncedMemory::mutable_cpu_data() {
+  if (view_parent_) {
+    return static_cast<char*>(view_parent_->mutable_cpu_data()) +
+        view_offset_;
+  }
   to_cpu();
+  if (SyncedMemoryTrace::enabled() && head_ != HEAD_AT_CPU) {
+    SyncedMemoryTrace::Push(this, head_, HEAD_AT_CPU, size_);
+  }
   head_ = HEAD_AT_CPU;
   return cpu_ptr_;
 }
 
 void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
+  if (view_parent_) {
+    return static_cast<char*>(view_parent_->mutable_gpu_data()) +
+        view_offset_;
+  }
   to_gpu();
+  if (SyncedMemoryTrace::enabled() && head_ != HEAD_AT_GPU) {
+    SyncedMemoryTrace::Push(this, head_, HEAD_AT_GPU, size_);
+  }
   head_ = HEAD_AT_GPU;
   return gpu_ptr_;
 #else
@@ -140,10 +304,12 @@ void* SyncedMemory::mutable_gpu_data() {
 
 #ifndef CPU_ONLY
 void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
+  CHECK(!view_parent_) << "async_gpu_push on a view SyncedMemory";
   CHECK(head_ == HEAD_AT_CPU);
   if (gpu_ptr_ == NULL) {
-    CUDA_CHECK(cudaGetDevice(&gpu_device_));
-    CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    CHECK(GPUAllocator::Get(&gpu_ptr_, size_, &gpu_device_))
+        << "device allocation of size " << size_ << " failed";
+    track_gpu_alloc();
     own_gpu_data_ = true;
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
@@ -151,6 +317,23 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   // Assume caller will synchronize on the stream before use
   head_ = SYNCED;
 }
+
+void SyncedMemory::async_cpu_pull(const cudaStream_t& stream) {
+  CHECK(!view_parent_) << "async_cpu_pull on a view SyncedMemory";
+  CHECK(head_ != UNINITIALIZED);
+  if (head_ != HEAD_AT_GPU) { return; }  // host copy already current
+  if (cpu_ptr_ == NULL) {
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_alloc_mode_);
+    own_cpu_data_ = true;
+  }
+  const cudaMemcpyKind get = cudaMemcpyDeviceToHost;
+  CUDA_CHECK(cudaMemcpyAsync(cpu_ptr_, gpu_ptr_, size_, get, stream));
+  if (SyncedMemoryTrace::enabled()) {
+    SyncedMemoryTrace::Push(this, HEAD_AT_GPU, SYNCED, size_);
+  }
+  // Assume caller will synchronize on the stream before reading
+  head_ = SYNCED;
+}
 #endif
 
 }  // namespace caffe
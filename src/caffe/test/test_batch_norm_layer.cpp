@@ -8,6 +8,9 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/batch_norm_layer.hpp"
+#ifdef USE_CUDNN
+#include "caffe/layers/cudnn_batch_norm_layer.hpp"
+#endif
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -130,4 +133,73 @@ namespace caffe {
         this->blob_top_vec_);
   }
 
+#ifdef USE_CUDNN
+  template <typename Dtype>
+  class CuDNNBatchNormLayerTest : public GPUDeviceTest<Dtype> {
+   protected:
+    CuDNNBatchNormLayerTest()
+        : blob_bottom_(new Blob<Dtype>(5, 2, 3, 4)),
+          blob_top_(new Blob<Dtype>()) {
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(this->blob_bottom_);
+      blob_bottom_vec_.push_back(blob_bottom_);
+      blob_top_vec_.push_back(blob_top_);
+    }
+    virtual ~CuDNNBatchNormLayerTest() {
+      delete blob_bottom_;
+      delete blob_top_;
+    }
+    Blob<Dtype>* const blob_bottom_;
+    Blob<Dtype>* const blob_top_;
+    vector<Blob<Dtype>*> blob_bottom_vec_;
+    vector<Blob<Dtype>*> blob_top_vec_;
+  };
+
+  TYPED_TEST_CASE(CuDNNBatchNormLayerTest, TestDtypes);
+
+  TYPED_TEST(CuDNNBatchNormLayerTest, TestForwardCuDNN) {
+    LayerParameter layer_param;
+
+    CuDNNBatchNormLayer<TypeParam> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+    // The scale and bias initialize to the identity, so the output should
+    // have zero mean and unit variance just like the CAFFE engine.
+    int num = this->blob_bottom_->num();
+    int channels = this->blob_bottom_->channels();
+    int height = this->blob_bottom_->height();
+    int width = this->blob_bottom_->width();
+
+    for (int j = 0; j < channels; ++j) {
+      TypeParam sum = 0, var = 0;
+      for (int i = 0; i < num; ++i) {
+        for ( int k = 0; k < height; ++k ) {
+          for ( int l = 0; l < width; ++l ) {
+            TypeParam data = this->blob_top_->data_at(i, j, k, l);
+            sum += data;
+            var += data * data;
+          }
+        }
+      }
+      sum /= height * width * num;
+      var /= height * width * num;
+
+      const TypeParam kErrorBound = 0.001;
+      EXPECT_NEAR(0, sum, kErrorBound);
+      EXPECT_NEAR(1, var, kErrorBound);
+    }
+  }
+
+  TYPED_TEST(CuDNNBatchNormLayerTest, TestGradientCuDNN) {
+    LayerParameter layer_param;
+
+    CuDNNBatchNormLayer<TypeParam> layer(layer_param);
+    GradientChecker<TypeParam> checker(1e-2, 1e-4);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+#endif
+
 }  // namespace caffe
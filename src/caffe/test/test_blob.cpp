@@ -51,6 +51,74 @@ TYPED_TEST(BlobSimpleTest, TestReshape) {
   EXPECT_EQ(this->blob_->count(), 120);
 }
 
+TYPED_TEST(BlobSimpleTest, TestReshapeCapacityGrowth) {
+  typedef TypeParam Dtype;
+  this->blob_->Reshape(1, 1, 1, 10);
+  EXPECT_EQ(this->blob_->data()->size(), 10 * sizeof(Dtype));
+  const SyncedMemory* data = this->blob_->data().get();
+  // Growth doubles the capacity, so nearby larger shapes reuse the
+  // doubled allocation instead of reallocating each time.
+  this->blob_->Reshape(1, 1, 1, 11);
+  EXPECT_EQ(this->blob_->data()->size(), 20 * sizeof(Dtype));
+  data = this->blob_->data().get();
+  this->blob_->Reshape(1, 1, 1, 16);
+  EXPECT_EQ(this->blob_->data().get(), data);
+  this->blob_->Reshape(1, 1, 1, 20);
+  EXPECT_EQ(this->blob_->data().get(), data);
+  // Shrinking the shape never releases memory...
+  this->blob_->Reshape(1, 1, 1, 5);
+  EXPECT_EQ(this->blob_->data().get(), data);
+  // ...until asked.
+  this->blob_->ShrinkToFit();
+  EXPECT_EQ(this->blob_->data()->size(), 5 * sizeof(Dtype));
+}
+
+TYPED_TEST(BlobSimpleTest, TestReserve) {
+  typedef TypeParam Dtype;
+  this->blob_->Reserve(1000);
+  EXPECT_EQ(this->blob_->data()->size(), 1000 * sizeof(Dtype));
+  const SyncedMemory* data = this->blob_->data().get();
+  const SyncedMemory* diff = this->blob_->diff().get();
+  // No reshape within the reserved capacity reallocates.
+  this->blob_->Reshape(2, 3, 4, 5);
+  this->blob_->Reshape(1, 1, 25, 40);
+  this->blob_->Reshape(1, 1, 1, 1000);
+  EXPECT_EQ(this->blob_->data().get(), data);
+  EXPECT_EQ(this->blob_->diff().get(), diff);
+  // A smaller reservation is a no-op.
+  this->blob_->Reserve(10);
+  EXPECT_EQ(this->blob_->data().get(), data);
+  this->blob_->Reshape(1, 1, 1, 1001);
+  EXPECT_NE(this->blob_->data().get(), data);
+}
+
+TYPED_TEST(BlobSimpleTest, TestReshapeSameShapeNoOp) {
+  typedef TypeParam Dtype;
+  const SyncedMemory* data = this->blob_preshaped_->data().get();
+  Dtype* cpu_data = this->blob_preshaped_->mutable_cpu_data();
+  cpu_data[0] = 17;
+  this->blob_preshaped_->Reshape(2, 3, 4, 5);
+  EXPECT_EQ(this->blob_preshaped_->data().get(), data);
+  EXPECT_EQ(this->blob_preshaped_->cpu_data()[0], 17);
+}
+
+TYPED_TEST(BlobSimpleTest, TestSwap) {
+  this->blob_->Reshape(1, 1, 1, 3);
+  this->blob_->mutable_cpu_data()[0] = 5;
+  this->blob_preshaped_->mutable_cpu_data()[0] = 9;
+  const SyncedMemory* small_data = this->blob_->data().get();
+  const SyncedMemory* big_data = this->blob_preshaped_->data().get();
+  this->blob_->Swap(this->blob_preshaped_);
+  // Storage changes hands without any copy or reallocation.
+  EXPECT_EQ(this->blob_->data().get(), big_data);
+  EXPECT_EQ(this->blob_preshaped_->data().get(), small_data);
+  EXPECT_EQ(this->blob_->count(), 120);
+  EXPECT_EQ(this->blob_->num(), 2);
+  EXPECT_EQ(this->blob_preshaped_->count(), 3);
+  EXPECT_EQ(this->blob_->cpu_data()[0], 9);
+  EXPECT_EQ(this->blob_preshaped_->cpu_data()[0], 5);
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
@@ -0,0 +1,74 @@
+#include <boost/thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+namespace {
+
+void ProducerLoop(BlockingQueue<Datum*>* free, BlockingQueue<Datum*>* full,
+    int rounds) {
+  for (int i = 0; i < rounds; ++i) {
+    full->push(free->pop());
+  }
+}
+
+}  // namespace
+
+TEST(BlockingQueueTest, TestPushPop) {
+  BlockingQueue<Datum*> queue;
+  Datum a, b;
+  queue.push(&a);
+  queue.push(&b);
+  EXPECT_EQ(2, queue.size());
+  EXPECT_EQ(&a, queue.peek());
+  EXPECT_EQ(&a, queue.pop());
+  EXPECT_EQ(&b, queue.pop());
+  Datum* out;
+  EXPECT_FALSE(queue.try_pop(&out));
+}
+
+TEST(BlockingQueueTest, TestBoundedPushPop) {
+  BlockingQueue<Datum*> queue(4);
+  Datum data[4];
+  for (int i = 0; i < 4; ++i) {
+    queue.push(&data[i]);
+  }
+  EXPECT_EQ(4, queue.size());
+  Datum* out;
+  EXPECT_TRUE(queue.try_peek(&out));
+  EXPECT_EQ(&data[0], out);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(&data[i], queue.pop());
+  }
+  EXPECT_FALSE(queue.try_pop(&out));
+  EXPECT_EQ(0, queue.size());
+}
+
+TEST(BlockingQueueTest, TestBoundedThreaded) {
+  // Recycle items between a free and a full bounded queue, as the reader
+  // and prefetch pipelines do, and check nothing is lost or duplicated.
+  const int kItems = 16;
+  const int kRounds = 1000;
+  BlockingQueue<Datum*> free(kItems);
+  BlockingQueue<Datum*> full(kItems);
+  Datum data[kItems];
+  for (int i = 0; i < kItems; ++i) {
+    free.push(&data[i]);
+  }
+  boost::thread producer(ProducerLoop, &free, &full, kRounds);
+  for (int i = 0; i < kRounds; ++i) {
+    Datum* item = full.pop();
+    ASSERT_TRUE(item >= data && item < data + kItems);
+    free.push(item);
+  }
+  producer.join();
+  EXPECT_EQ(kItems, free.size());
+}
+
+}  // namespace caffe
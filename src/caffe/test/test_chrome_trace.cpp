@@ -0,0 +1,49 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/chrome_trace.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ChromeTraceTest : public ::testing::Test {
+ protected:
+  string ReadFile(const string& filename) {
+    std::ifstream file(filename.c_str());
+    string content, line;
+    while (std::getline(file, line)) {
+      content += line + "\n";
+    }
+    return content;
+  }
+};
+
+TEST_F(ChromeTraceTest, TestCaptureWindow) {
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".json";
+  // Spans outside the capture window are dropped.
+  { TraceSpan dropped("test", "before_start"); }
+  ChromeTrace::Start(filename);
+  ASSERT_TRUE(ChromeTrace::enabled());
+  ChromeTrace::SetThreadName("test_thread");
+  { TraceSpan span("test", "captured"); }
+  ChromeTrace::AddSpan("test", "explicit", ChromeTrace::NowUs(), 1.0);
+  ChromeTrace::Stop();
+  ASSERT_FALSE(ChromeTrace::enabled());
+  { TraceSpan dropped("test", "after_stop"); }
+
+  const string content = ReadFile(filename);
+  EXPECT_NE(string::npos, content.find("\"traceEvents\""));
+  EXPECT_NE(string::npos, content.find("\"captured\""));
+  EXPECT_NE(string::npos, content.find("\"explicit\""));
+  EXPECT_NE(string::npos, content.find("\"test_thread\""));
+  EXPECT_EQ(string::npos, content.find("before_start"));
+  EXPECT_EQ(string::npos, content.find("after_stop"));
+}
+
+}  // namespace caffe
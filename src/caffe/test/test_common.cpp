@@ -18,6 +18,16 @@ TEST_F(CommonTest, TestCublasHandlerGPU) {
   EXPECT_TRUE(Caffe::cublas_handle());
 }
 
+TEST_F(CommonTest, TestStreamPool) {
+  // Pooled streams are created lazily, stable across calls, and
+  // distinct from one another and from the default stream.
+  EXPECT_TRUE(Caffe::stream(0));
+  EXPECT_EQ(Caffe::stream(0), Caffe::stream(0));
+  EXPECT_NE(Caffe::stream(0), Caffe::stream(1));
+  EXPECT_TRUE(Caffe::cublas_handle(1));
+  EXPECT_NE(Caffe::cublas_handle(0), Caffe::cublas_handle());
+}
+
 #endif
 
 TEST_F(CommonTest, TestBrewMode) {
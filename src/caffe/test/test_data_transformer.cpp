@@ -121,6 +121,43 @@ TYPED_TEST(DataTransformTest, TestEmptyTransformUniquePixels) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestIdentityBatch) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = true;
+  const int label = 0;
+  const int channels = 3;
+  const int height = 4;
+  const int width = 5;
+
+  // Crop equal to the datum's dimensions is still an identity.
+  transform_param.set_crop_size(0);
+  Datum datum;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  EXPECT_TRUE(transformer.IsIdentity(datum));
+
+  const int num = 3;
+  vector<Datum*> datum_vector(num, &datum);
+  Blob<TypeParam> blob(num, channels, height, width);
+  transformer.TransformBatch(datum_vector, &blob);
+  for (int item_id = 0; item_id < num; ++item_id) {
+    const TypeParam* item = blob.cpu_data() + blob.offset(item_id);
+    for (int j = 0; j < channels * height * width; ++j) {
+      EXPECT_EQ(item[j], j);
+    }
+  }
+
+  TransformationParameter scaled_param;
+  scaled_param.set_scale(0.5);
+  DataTransformer<TypeParam> scaled(scaled_param, TEST);
+  EXPECT_FALSE(scaled.IsIdentity(datum));
+  TransformationParameter mirror_param;
+  mirror_param.set_mirror(true);
+  DataTransformer<TypeParam> mirrored(mirror_param, TEST);
+  EXPECT_FALSE(mirrored.IsIdentity(datum));
+}
+
 TYPED_TEST(DataTransformTest, TestCropSize) {
   TransformationParameter transform_param;
   const bool unique_pixels = false;  // all pixels the same equal to label
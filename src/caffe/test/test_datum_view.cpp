@@ -0,0 +1,84 @@
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DatumViewTest : public ::testing::Test {
+ protected:
+  void FillDatum(Datum* datum) {
+    datum->set_channels(3);
+    datum->set_height(4);
+    datum->set_width(5);
+    datum->set_label(7);
+    string* data = datum->mutable_data();
+    for (int i = 0; i < 3 * 4 * 5; ++i) {
+      data->push_back(static_cast<char>(i));
+    }
+  }
+};
+
+TEST_F(DatumViewTest, TestParse) {
+  Datum datum;
+  FillDatum(&datum);
+  string serialized;
+  datum.SerializeToString(&serialized);
+
+  DatumView view;
+  ASSERT_TRUE(view.ParseFrom(serialized.data(), serialized.size()));
+  EXPECT_EQ(datum.channels(), view.channels());
+  EXPECT_EQ(datum.height(), view.height());
+  EXPECT_EQ(datum.width(), view.width());
+  EXPECT_EQ(datum.label(), view.label());
+  EXPECT_FALSE(view.encoded());
+  ASSERT_EQ(datum.data().size(), view.data_size());
+  // The view must point into the serialized buffer, not a copy.
+  EXPECT_GE(view.data(), serialized.data());
+  EXPECT_LE(view.data() + view.data_size(),
+      serialized.data() + serialized.size());
+  EXPECT_EQ(0, memcmp(datum.data().data(), view.data(), view.data_size()));
+}
+
+TEST_F(DatumViewTest, TestParseEncoded) {
+  Datum datum;
+  FillDatum(&datum);
+  datum.set_encoded(true);
+  string serialized;
+  datum.SerializeToString(&serialized);
+
+  DatumView view;
+  ASSERT_TRUE(view.ParseFrom(serialized.data(), serialized.size()));
+  EXPECT_TRUE(view.encoded());
+}
+
+TEST_F(DatumViewTest, TestFloatDataFallsBack) {
+  Datum datum;
+  datum.set_channels(1);
+  datum.set_height(1);
+  datum.set_width(2);
+  datum.add_float_data(0.5);
+  datum.add_float_data(1.5);
+  string serialized;
+  datum.SerializeToString(&serialized);
+
+  DatumView view;
+  EXPECT_FALSE(view.ParseFrom(serialized.data(), serialized.size()));
+}
+
+TEST_F(DatumViewTest, TestTruncatedBufferFails) {
+  Datum datum;
+  FillDatum(&datum);
+  string serialized;
+  datum.SerializeToString(&serialized);
+
+  DatumView view;
+  EXPECT_FALSE(view.ParseFrom(serialized.data(), serialized.size() - 1));
+}
+
+}  // namespace caffe
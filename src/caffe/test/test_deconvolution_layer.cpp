@@ -136,6 +136,40 @@ TYPED_TEST(DeconvolutionLayerTest, TestSimpleDeconvolution) {
   }
 }
 
+TYPED_TEST(DeconvolutionLayerTest, TestTiledAgainstFullColBuffer) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  // Reference forward with the full column buffer.
+  shared_ptr<Layer<Dtype> > layer(
+      new DeconvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> ref_top;
+  ref_top.CopyFrom(*this->blob_top_, false, true);
+  // A one-byte bound forces single-row strips, the worst case for the
+  // tiled path; the result must match the full buffer exactly up to
+  // accumulation order.
+  convolution_param->set_col_buffer_max_size(1);
+  shared_ptr<Layer<Dtype> > tiled_layer(
+      new DeconvolutionLayer<Dtype>(layer_param));
+  tiled_layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  tiled_layer->blobs()[0]->CopyFrom(*layer->blobs()[0]);
+  tiled_layer->blobs()[1]->CopyFrom(*layer->blobs()[1]);
+  tiled_layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_data = ref_top.cpu_data();
+  for (int i = 0; i < ref_top.count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_data[i], 1e-4);
+  }
+}
+
 TYPED_TEST(DeconvolutionLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -126,6 +126,71 @@ TYPED_TEST(EltwiseLayerTest, TestSumCoeff) {
   }
 }
 
+TYPED_TEST(EltwiseLayerTest, TestSumInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EltwiseParameter* eltwise_param = layer_param.mutable_eltwise_param();
+  eltwise_param->set_operation(EltwiseParameter_EltwiseOp_SUM);
+  shared_ptr<EltwiseLayer<Dtype> > layer(
+      new EltwiseLayer<Dtype>(layer_param));
+  // Save the reference result before bottom[0] is overwritten in place.
+  const int count = this->blob_bottom_a_->count();
+  vector<Dtype> expected(count);
+  for (int i = 0; i < count; ++i) {
+    expected[i] = this->blob_bottom_a_->cpu_data()[i] +
+        this->blob_bottom_b_->cpu_data()[i] +
+        this->blob_bottom_c_->cpu_data()[i];
+  }
+  this->blob_top_vec_[0] = this->blob_bottom_a_;
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* data = this->blob_bottom_a_->cpu_data();
+  for (int i = 0; i < count; ++i) {
+    EXPECT_NEAR(data[i], expected[i], 1e-4);
+  }
+}
+
+TYPED_TEST(EltwiseLayerTest, TestSumCoeffInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EltwiseParameter* eltwise_param = layer_param.mutable_eltwise_param();
+  eltwise_param->set_operation(EltwiseParameter_EltwiseOp_SUM);
+  eltwise_param->add_coeff(-0.5);
+  eltwise_param->add_coeff(1);
+  eltwise_param->add_coeff(2);
+  shared_ptr<EltwiseLayer<Dtype> > layer(
+      new EltwiseLayer<Dtype>(layer_param));
+  const int count = this->blob_bottom_a_->count();
+  vector<Dtype> expected(count);
+  for (int i = 0; i < count; ++i) {
+    expected[i] = -0.5*this->blob_bottom_a_->cpu_data()[i] +
+        this->blob_bottom_b_->cpu_data()[i] +
+        2*this->blob_bottom_c_->cpu_data()[i];
+  }
+  this->blob_top_vec_[0] = this->blob_bottom_a_;
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* data = this->blob_bottom_a_->cpu_data();
+  for (int i = 0; i < count; ++i) {
+    EXPECT_NEAR(data[i], expected[i], 1e-4);
+  }
+  // Backward: bottom[0]'s diff aliases the top diff, so its scaling must not
+  // corrupt the diffs propagated to the other bottoms.
+  vector<Dtype> top_diff(count);
+  for (int i = 0; i < count; ++i) {
+    top_diff[i] = Dtype(i % 7) - Dtype(3);
+    this->blob_bottom_a_->mutable_cpu_diff()[i] = top_diff[i];
+  }
+  vector<bool> propagate_down(3, true);
+  layer->Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  for (int i = 0; i < count; ++i) {
+    EXPECT_NEAR(this->blob_bottom_a_->cpu_diff()[i], -0.5*top_diff[i], 1e-4);
+    EXPECT_NEAR(this->blob_bottom_b_->cpu_diff()[i], top_diff[i], 1e-4);
+    EXPECT_NEAR(this->blob_bottom_c_->cpu_diff()[i], 2*top_diff[i], 1e-4);
+  }
+}
+
 TYPED_TEST(EltwiseLayerTest, TestStableProdGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
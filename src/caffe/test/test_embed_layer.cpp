@@ -134,6 +134,44 @@ TYPED_TEST(EmbedLayerTest, TestForwardWithBias) {
   }
 }
 
+TYPED_TEST(EmbedLayerTest, TestSparseDiffRows) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) { return; }
+  LayerParameter layer_param;
+  EmbedParameter* embed_param = layer_param.mutable_embed_param();
+  embed_param->set_num_output(3);
+  embed_param->set_input_dim(10);
+  embed_param->set_bias_term(false);
+  embed_param->mutable_weight_filler()->set_type("uniform");
+  embed_param->mutable_weight_filler()->set_min(-10);
+  embed_param->mutable_weight_filler()->set_max(10);
+  this->blob_bottom_->mutable_cpu_data()[0] = 2;
+  this->blob_bottom_->mutable_cpu_data()[1] = 7;
+  this->blob_bottom_->mutable_cpu_data()[2] = 2;
+  this->blob_bottom_->mutable_cpu_data()[3] = 0;
+  shared_ptr<EmbedLayer<Dtype> > layer(new EmbedLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  caffe_set(this->blob_top_->count(), Dtype(1),
+      this->blob_top_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, false);
+  layer->Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  Blob<Dtype>* weight = layer->blobs()[0].get();
+  ASSERT_TRUE(weight->has_sparse_diff_rows());
+  ASSERT_EQ(weight->sparse_diff_rows().size(), 3);
+  EXPECT_EQ(weight->sparse_diff_rows()[0], 0);
+  EXPECT_EQ(weight->sparse_diff_rows()[1], 2);
+  EXPECT_EQ(weight->sparse_diff_rows()[2], 7);
+  // Index 2 appears twice in the batch; untouched rows carry no gradient.
+  for (int k = 0; k < 10; ++k) {
+    const Dtype expected = k == 2 ? 2 : (k == 0 || k == 7 ? 1 : 0);
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(weight->cpu_diff()[k * 3 + j], expected);
+    }
+  }
+}
+
 TYPED_TEST(EmbedLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
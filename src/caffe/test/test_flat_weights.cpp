@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/flat_weights.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FlatWeightsTest : public ::testing::Test {
+ protected:
+  FlatWeightsTest()
+      : blob_a_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_b_(new Blob<Dtype>(7, 1, 1, 1)) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_a_);
+    filler.Fill(blob_b_);
+    LayerParameter* layer = param_.add_layer();
+    layer->set_name("conv1");
+    blob_a_->ToProto(layer->add_blobs());
+    blob_b_->ToProto(layer->add_blobs());
+  }
+  virtual ~FlatWeightsTest() {
+    delete blob_a_;
+    delete blob_b_;
+  }
+
+  Blob<Dtype>* const blob_a_;
+  Blob<Dtype>* const blob_b_;
+  NetParameter param_;
+};
+
+TYPED_TEST_CASE(FlatWeightsTest, TestDtypes);
+
+TYPED_TEST(FlatWeightsTest, TestWriteAndOpen) {
+  typedef TypeParam Dtype;
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".flat";
+  FlatWeights<Dtype>::Write(this->param_, filename);
+  shared_ptr<FlatWeights<Dtype> > flat = FlatWeights<Dtype>::Open(filename);
+  ASSERT_EQ(2, flat->blob_count());
+  ASSERT_EQ(1, flat->index().layer_size());
+  EXPECT_EQ("conv1", flat->index().layer(0).name());
+  EXPECT_EQ(0, flat->index().layer(0).blobs(0).data_size());
+  const Dtype* data_a = flat->blob_data(0);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data_a) % 64);
+  for (int i = 0; i < this->blob_a_->count(); ++i) {
+    EXPECT_EQ(this->blob_a_->cpu_data()[i], data_a[i]);
+  }
+  const Dtype* data_b = flat->blob_data(1);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data_b) % 64);
+  for (int i = 0; i < this->blob_b_->count(); ++i) {
+    EXPECT_EQ(this->blob_b_->cpu_data()[i], data_b[i]);
+  }
+}
+
+}  // namespace caffe
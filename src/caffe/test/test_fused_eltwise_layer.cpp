@@ -0,0 +1,148 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/eltwise_layer.hpp"
+#include "caffe/layers/fused_eltwise_layer.hpp"
+#include "caffe/layers/power_layer.hpp"
+#include "caffe/layers/relu_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class FusedEltwiseLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  FusedEltwiseLayerTest()
+      : blob_bottom_a_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_bottom_b_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_a_);
+    filler.Fill(this->blob_bottom_b_);
+    blob_bottom_vec_.push_back(blob_bottom_a_);
+    blob_bottom_vec_.push_back(blob_bottom_b_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~FusedEltwiseLayerTest() {
+    delete blob_bottom_a_;
+    delete blob_bottom_b_;
+    delete blob_top_;
+  }
+
+  Blob<Dtype>* const blob_bottom_a_;
+  Blob<Dtype>* const blob_bottom_b_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(FusedEltwiseLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(FusedEltwiseLayerTest, TestSumReLUPowerAgainstUnfused) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Reference: Eltwise(SUM, coeffs 1/-0.5) -> ReLU(slope 0.1) -> Power,
+  // run as three separate layers.
+  LayerParameter eltwise_param;
+  eltwise_param.set_type("Eltwise");
+  eltwise_param.mutable_eltwise_param()->set_operation(
+      EltwiseParameter_EltwiseOp_SUM);
+  eltwise_param.mutable_eltwise_param()->add_coeff(1.);
+  eltwise_param.mutable_eltwise_param()->add_coeff(-0.5);
+  LayerParameter relu_param;
+  relu_param.set_type("ReLU");
+  relu_param.mutable_relu_param()->set_negative_slope(0.1);
+  LayerParameter power_param;
+  power_param.set_type("Power");
+  power_param.mutable_power_param()->set_power(2.);
+  power_param.mutable_power_param()->set_scale(0.5);
+  power_param.mutable_power_param()->set_shift(1.);
+
+  Blob<Dtype> stage_blob;
+  vector<Blob<Dtype>*> stage_vec(1, &stage_blob);
+  Blob<Dtype> ref_top_blob;
+  vector<Blob<Dtype>*> ref_top_vec(1, &ref_top_blob);
+  EltwiseLayer<Dtype> eltwise_layer(eltwise_param);
+  eltwise_layer.SetUp(this->blob_bottom_vec_, stage_vec);
+  eltwise_layer.Forward(this->blob_bottom_vec_, stage_vec);
+  ReLULayer<Dtype> relu_layer(relu_param);
+  relu_layer.SetUp(stage_vec, stage_vec);
+  relu_layer.Forward(stage_vec, stage_vec);
+  PowerLayer<Dtype> power_layer(power_param);
+  power_layer.SetUp(stage_vec, ref_top_vec);
+  power_layer.Forward(stage_vec, ref_top_vec);
+
+  LayerParameter fused_param;
+  fused_param.set_type("FusedEltwise");
+  FusedEltwiseParameter* chain = fused_param.mutable_fused_eltwise_param();
+  chain->add_stage()->CopyFrom(eltwise_param);
+  chain->add_stage()->CopyFrom(relu_param);
+  chain->add_stage()->CopyFrom(power_param);
+  FusedEltwiseLayer<Dtype> fused_layer(fused_param);
+  fused_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  fused_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  ASSERT_EQ(ref_top_blob.count(), this->blob_top_->count());
+  const Dtype* ref_data = ref_top_blob.cpu_data();
+  const Dtype* fused_data = this->blob_top_->cpu_data();
+  for (int i = 0; i < ref_top_blob.count(); ++i) {
+    EXPECT_NEAR(ref_data[i], fused_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(FusedEltwiseLayerTest, TestUnaryChain) {
+  typedef typename TypeParam::Dtype Dtype;
+  // TanH -> AbsVal -> Sigmoid over a single bottom.
+  LayerParameter tanh_param;
+  tanh_param.set_type("TanH");
+  LayerParameter abs_param;
+  abs_param.set_type("AbsVal");
+  LayerParameter sigmoid_param;
+  sigmoid_param.set_type("Sigmoid");
+  LayerParameter fused_param;
+  fused_param.set_type("FusedEltwise");
+  FusedEltwiseParameter* chain = fused_param.mutable_fused_eltwise_param();
+  chain->add_stage()->CopyFrom(tanh_param);
+  chain->add_stage()->CopyFrom(abs_param);
+  chain->add_stage()->CopyFrom(sigmoid_param);
+  vector<Blob<Dtype>*> bottom_vec(1, this->blob_bottom_a_);
+  FusedEltwiseLayer<Dtype> fused_layer(fused_param);
+  fused_layer.SetUp(bottom_vec, this->blob_top_vec_);
+  fused_layer.Forward(bottom_vec, this->blob_top_vec_);
+  const Dtype* bottom_data = this->blob_bottom_a_->cpu_data();
+  const Dtype* fused_data = this->blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    const Dtype expected =
+        1. / (1. + exp(-fabs(tanh(bottom_data[i]))));
+    EXPECT_NEAR(expected, fused_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(FusedEltwiseLayerTest, TestIsFusableStage) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.set_type("Eltwise");
+  param.add_bottom("a");
+  param.add_bottom("b");
+  param.add_top("c");
+  EXPECT_TRUE(FusedEltwiseLayer<Dtype>::IsFusableStage(param, true));
+  // A multi-bottom Eltwise may only lead a chain.
+  EXPECT_FALSE(FusedEltwiseLayer<Dtype>::IsFusableStage(param, false));
+  param.set_type("ReLU");
+  param.clear_bottom();
+  param.add_bottom("c");
+  EXPECT_TRUE(FusedEltwiseLayer<Dtype>::IsFusableStage(param, false));
+  param.set_type("Convolution");
+  EXPECT_FALSE(FusedEltwiseLayer<Dtype>::IsFusableStage(param, false));
+}
+
+}  // namespace caffe
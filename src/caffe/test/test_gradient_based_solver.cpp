@@ -294,8 +294,13 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
         ASSERT_EQ(4, history.size());  // additional blobs for update history
       }
       Dtype update_value = learning_rate * grad;
-      const Dtype history_value = (i == D) ?
-            history[1]->cpu_data()[0] : history[0]->cpu_data()[i];
+      // Momentum-0 SGD keeps no history; an unallocated slot reads as
+      // its implicit zeros.
+      const shared_ptr<Blob<Dtype> >& history_blob =
+          (i == D) ? history[1] : history[0];
+      const Dtype history_value = !history_blob ? Dtype(0) :
+          ((i == D) ? history_blob->cpu_data()[0]
+                    : history_blob->cpu_data()[i]);
       const Dtype temp = momentum * history_value;
       if (solver_->type() == string("SGD")) {
         update_value += temp;
@@ -377,10 +382,12 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
           std::min(fabs(expected_updated_bias), fabs(solver_updated_bias)));
     EXPECT_NEAR(expected_updated_bias, solver_updated_bias, error_margin);
 
-    // Check the solver's history -- should contain the previous update value.
+    // Check the solver's history -- should contain the previous update
+    // value. With momentum 0 the solver keeps no history at all.
     if (solver_->type() == string("SGD")) {
       const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
       ASSERT_EQ(2, history.size());
+      if (!history[0]) { return; }
       for (int i = 0; i < D; ++i) {
         const Dtype expected_history = updated_weights.cpu_diff()[i];
         const Dtype solver_history = history[0]->cpu_data()[i];
@@ -516,6 +523,7 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     const vector<shared_ptr<Blob<Dtype> > >& orig_history = solver_->history();
     history_copies.resize(orig_history.size());
     for (int i = 0; i < orig_history.size(); ++i) {
+      if (!orig_history[i]) { continue; }  // never allocated (no momentum)
       history_copies[i].reset(new Blob<Dtype>());
       const bool kReshape = true;
       for (int copy_diff = false; copy_diff <= true; ++copy_diff) {
@@ -548,6 +556,7 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     // Check that history now matches.
     const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
     for (int i = 0; i < history.size(); ++i) {
+      if (!history_copies[i] || !history[i]) { continue; }
       for (int j = 0; j < history[i]->count(); ++j) {
         EXPECT_EQ(history_copies[i]->cpu_data()[j], history[i]->cpu_data()[j])
             << "history blob " << i << " data differed at dim " << j;
@@ -0,0 +1,70 @@
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/half.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfTest : public ::testing::Test {};
+
+TEST_F(HalfTest, TestExactRoundTrip) {
+  // Values exactly representable in binary16 must survive the round trip.
+  const float exact[] = { 0.f, -0.f, 1.f, -1.f, 0.5f, 2.f, 1024.f,
+      65504.f, -65504.f, 0.0009765625f /* 2^-10 */,
+      5.9604644775390625e-8f /* 2^-24, smallest subnormal */ };
+  for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i) {
+    EXPECT_EQ(exact[i], caffe_half2float(caffe_float2half(exact[i])))
+        << "value " << exact[i];
+  }
+}
+
+TEST_F(HalfTest, TestRoundToNearestEven) {
+  // 1 + 2^-11 is exactly halfway between 1 and 1 + 2^-10; ties go to
+  // the even mantissa, i.e. down to 1.
+  EXPECT_EQ(1.f, caffe_half2float(caffe_float2half(1.f + 4.8828125e-4f)));
+  // 1 + 3 * 2^-11 is halfway between 1 + 2^-10 and 1 + 2^-9; the even
+  // neighbour is 1 + 2^-9.
+  EXPECT_EQ(1.f + 0.001953125f,
+      caffe_half2float(caffe_float2half(1.f + 3 * 4.8828125e-4f)));
+  // Just above halfway rounds up.
+  EXPECT_EQ(1.f + 0.0009765625f,
+      caffe_half2float(caffe_float2half(1.f + 4.8828130e-4f)));
+}
+
+TEST_F(HalfTest, TestOverflowAndUnderflow) {
+  const float kInf = std::numeric_limits<float>::infinity();
+  EXPECT_EQ(kInf, caffe_half2float(caffe_float2half(1e6f)));
+  EXPECT_EQ(-kInf, caffe_half2float(caffe_float2half(-1e6f)));
+  // Below half the smallest subnormal flushes to signed zero.
+  EXPECT_EQ(0.f, caffe_half2float(caffe_float2half(1e-9f)));
+  EXPECT_EQ(uint16_t(0x8000), caffe_float2half(-1e-9f));
+}
+
+TEST_F(HalfTest, TestSpecials) {
+  const float nan = caffe_half2float(
+      caffe_float2half(std::numeric_limits<float>::quiet_NaN()));
+  EXPECT_TRUE(nan != nan);
+  const float kInf = std::numeric_limits<float>::infinity();
+  EXPECT_EQ(kInf, caffe_half2float(caffe_float2half(kInf)));
+  EXPECT_EQ(-kInf, caffe_half2float(caffe_float2half(-kInf)));
+}
+
+TEST_F(HalfTest, TestArrayConversion) {
+  const int n = 64;
+  std::vector<float> src(n), back(n);
+  std::vector<uint16_t> half(n);
+  for (int i = 0; i < n; ++i) {
+    src[i] = (i - n / 2) * 0.25f;
+  }
+  caffe_cpu_float2half(n, &src[0], &half[0]);
+  caffe_cpu_half2float(n, &half[0], &back[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(src[i], back[i]);
+  }
+}
+
+}  // namespace caffe
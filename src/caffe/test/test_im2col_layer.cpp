@@ -75,6 +75,38 @@ TYPED_TEST(Im2colLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(Im2colLayerTest, TestForwardFixedShape) {
+  typedef typename TypeParam::Dtype Dtype;
+  // 3x3 stride 1 pad 1 takes the shape-templated CPU path; check it
+  // against the generic answer, padding included.
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(1);
+  convolution_param->add_pad(1);
+  Im2colLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->height(), this->blob_bottom_->height());
+  EXPECT_EQ(this->blob_top_->width(), this->blob_bottom_->width());
+  for (int c = 0; c < 27; ++c) {
+    const int kh = (c / 3) % 3;
+    const int kw = c % 3;
+    for (int h = 0; h < this->blob_top_->height(); ++h) {
+      for (int w = 0; w < this->blob_top_->width(); ++w) {
+        const int ih = h + kh - 1;
+        const int iw = w + kw - 1;
+        const Dtype expected =
+            (ih >= 0 && ih < this->blob_bottom_->height() &&
+             iw >= 0 && iw < this->blob_bottom_->width()) ?
+            this->blob_bottom_->data_at(0, c / 9, ih, iw) : Dtype(0);
+        EXPECT_EQ(expected, this->blob_top_->data_at(0, c, h, w));
+      }
+    }
+  }
+}
+
 TYPED_TEST(Im2colLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -143,6 +175,62 @@ TYPED_TEST(Im2colLayerTest, TestDilatedGradientForceND) {
                                   this->blob_top_vec_);
 }
 
+TYPED_TEST(Im2colLayerTest, TestForward3D) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  vector<int> bottom_shape;
+  bottom_shape.push_back(1);
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(3);
+  bottom_shape.push_back(4);
+  bottom_shape.push_back(4);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(1);
+  Im2colLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->shape(1), 2 * 27);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // We are lazy and will only check the front top left block. The output
+  // spatial volume is 1 x 2 x 2.
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  for (int c = 0; c < 2 * 27; ++c) {
+    const int bottom_index = ((((c / 27) * 3 + (c / 9) % 3) * 4
+        + (c / 3) % 3) * 4) + c % 3;
+    EXPECT_EQ(top_data[c * 4], bottom_data[bottom_index]);
+  }
+}
+
+TYPED_TEST(Im2colLayerTest, TestGradient3D) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  vector<int> bottom_shape;
+  bottom_shape.push_back(1);
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(3);
+  bottom_shape.push_back(4);
+  bottom_shape.push_back(4);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  Im2colLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(Im2colLayerTest, TestRect) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
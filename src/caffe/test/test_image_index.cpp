@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/image_index.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ImageIndexTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempFilename(&filename_);
+  }
+  virtual void TearDown() {
+    remove(filename_.c_str());
+  }
+  string filename_;
+};
+
+TEST_F(ImageIndexTest, TestWriteLoadRoundTrip) {
+  vector<std::pair<string, int> > lines;
+  lines.push_back(std::make_pair(string("cat/image1.jpg"), 3));
+  lines.push_back(std::make_pair(string("dog/image2.jpg"), -1));
+  lines.push_back(std::make_pair(string("fish.png"), 42));
+  ImageIndex::Write(filename_, lines);
+
+  ImageIndex index;
+  ASSERT_TRUE(index.Load(filename_));
+  ASSERT_EQ(lines.size(), index.size());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    EXPECT_EQ(lines[i].first, index.path(i));
+    EXPECT_EQ(lines[i].second, index.label(i));
+  }
+}
+
+TEST_F(ImageIndexTest, TestLoadRejectsTextListing) {
+  std::ofstream file(filename_.c_str());
+  file << "cat/image1.jpg 3\n";
+  file.close();
+
+  ImageIndex index;
+  EXPECT_FALSE(index.Load(filename_));
+}
+
+TEST_F(ImageIndexTest, TestLoadMissingFile) {
+  ImageIndex index;
+  EXPECT_FALSE(index.Load(filename_ + ".does_not_exist"));
+}
+
+}  // namespace caffe
@@ -0,0 +1,132 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+static void SessionInferOne(InferenceSession<Dtype>* session,
+    const Dtype* input, Dtype* output) {
+  vector<Dtype*> outputs(1, output);
+  session->Infer(input, outputs);
+}
+
+template <typename TypeParam>
+class InferenceSessionTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InferenceSessionTest() : seed_(1701) {}
+
+  virtual void InitNet() {
+    const string proto =
+        "name: 'SessionTestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 } } "
+        "} "
+        "layer { "
+        "  name: 'innerproduct' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'innerproduct' "
+        "  inner_product_param { "
+        "    num_output: 4 "
+        "    weight_filler { type: 'uniform' min: -1 max: 1 } "
+        "    bias_filler { type: 'uniform' min: -1 max: 1 } "
+        "  } "
+        "} ";
+    Caffe::set_random_seed(seed_);
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  int seed_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(InferenceSessionTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceSessionTest, TestSizes) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitNet();
+  InferenceSession<Dtype> session(this->net_.get(), 4, 0);
+  EXPECT_EQ(3, session.input_size());
+  EXPECT_EQ(1, session.num_outputs());
+  EXPECT_EQ(4, session.output_size(0));
+}
+
+TYPED_TEST(InferenceSessionTest, TestSingleRequest) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitNet();
+  // Reference: run the two-image batch through the bare net.
+  Dtype inputs[6];
+  for (int i = 0; i < 6; ++i) { inputs[i] = i * Dtype(0.25) - 1; }
+  Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+  caffe_copy(6, inputs, input_blob->mutable_cpu_data());
+  this->net_->Forward();
+  vector<Dtype> expected(8);
+  caffe_copy(8, this->net_->output_blobs()[0]->cpu_data(), &expected[0]);
+  // Each image submitted alone must come back as its batch slice.
+  InferenceSession<Dtype> session(this->net_.get(), 4, 0);
+  for (int i = 0; i < 2; ++i) {
+    Dtype output[4];
+    SessionInferOne(&session, inputs + i * 3, output);
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_NEAR(expected[i * 4 + j], output[j], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(InferenceSessionTest, TestConcurrentRequests) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitNet();
+  const int kRequests = 16;
+  vector<Dtype> inputs(kRequests * 3);
+  for (int i = 0; i < inputs.size(); ++i) {
+    inputs[i] = (i % 7) * Dtype(0.5) - 1;
+  }
+  // Reference outputs, one bare-net forward per image.
+  vector<Dtype> expected(kRequests * 4);
+  Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+  vector<int> shape = input_blob->shape();
+  shape[0] = 1;
+  for (int i = 0; i < kRequests; ++i) {
+    input_blob->Reshape(shape);
+    caffe_copy(3, &inputs[i * 3], input_blob->mutable_cpu_data());
+    this->net_->Forward();
+    caffe_copy(4, this->net_->output_blobs()[0]->cpu_data(),
+        &expected[i * 4]);
+  }
+  // All requests in flight at once, coalesced into shared forwards.
+  InferenceSession<Dtype> session(this->net_.get(), 4, 2000);
+  vector<Dtype> outputs(kRequests * 4);
+  boost::thread_group threads;
+  for (int i = 0; i < kRequests; ++i) {
+    threads.create_thread(boost::bind(&SessionInferOne<Dtype>,
+        &session, &inputs[i * 3], &outputs[i * 4]));
+  }
+  threads.join_all();
+  for (int i = 0; i < kRequests * 4; ++i) {
+    EXPECT_NEAR(expected[i], outputs[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -135,6 +136,73 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  inner_product_param->mutable_weight_filler()->set_min(-1);
+  inner_product_param->mutable_weight_filler()->set_max(1);
+  inner_product_param->set_sparse_weight_threshold(0.5);
+  shared_ptr<InnerProductLayer<Dtype> > layer(
+      new InnerProductLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Prune the weights to 90% zeros, as magnitude pruning would.
+  Blob<Dtype>* weights = layer->blobs()[0].get();
+  Dtype* weight_data = weights->mutable_cpu_data();
+  for (int i = 0; i < weights->count(); ++i) {
+    if (i % 10 != 0) { weight_data[i] = 0; }
+  }
+  EXPECT_NEAR(0.9, weights->sparsity(), 1e-5);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The CSR product must match the dense GEMM on the same weights.
+  const int M = 2, N = 10, K = 60;
+  vector<Dtype> ref(M * N);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, N, K, (Dtype)1.,
+      this->blob_bottom_->cpu_data(), weights->cpu_data(), (Dtype)0.,
+      &ref[0]);
+  const Dtype* data = this->blob_top_->cpu_data();
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(ref[i], data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardQuantized) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  inner_product_param->mutable_weight_filler()->set_min(-1);
+  inner_product_param->mutable_weight_filler()->set_max(1);
+  inner_product_param->mutable_bias_filler()->set_type("uniform");
+  inner_product_param->mutable_bias_filler()->set_min(1);
+  inner_product_param->mutable_bias_filler()->set_max(2);
+  layer_param.mutable_quant_param()->set_enabled(true);
+  layer_param.mutable_quant_param()->set_calibration_iters(1);
+  shared_ptr<InnerProductLayer<Dtype> > layer(
+      new InnerProductLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The calibration pass still computes in float; keep its output as the
+  // reference.
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> ref;
+  ref.CopyFrom(*this->blob_top_, false, true);
+  // The second pass on the same input takes the int8 path and must agree
+  // with the reference to within the rounding granularity of the two
+  // symmetric scales, summed over K = 60 products.
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* data = this->blob_top_->cpu_data();
+  for (int i = 0; i < ref.count(); ++i) {
+    EXPECT_NEAR(ref.cpu_data()[i], data[i], 0.5);
+  }
+}
+
 /**
  * @brief Init. an IP layer without transpose + random weights,
  * run Forward, save the result.
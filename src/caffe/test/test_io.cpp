@@ -4,7 +4,9 @@
 #include <opencv2/highgui/highgui_c.h>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -229,6 +231,31 @@ TEST_F(IOTest, TestReadImageToCVMatResizedGray) {
   EXPECT_EQ(cv_img.cols, 256);
 }
 
+TEST_F(IOTest, TestReadImageToCVMatScratch) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  std::vector<char> file_buffer;
+  cv::Mat decode_buffer;
+  cv::Mat cv_img;
+  EXPECT_TRUE(ReadImageToCVMat(filename, 256, 256, true, &file_buffer,
+      &decode_buffer, &cv_img));
+  EXPECT_EQ(cv_img.channels(), 3);
+  EXPECT_EQ(cv_img.rows, 256);
+  EXPECT_EQ(cv_img.cols, 256);
+  // Matches the allocating overload pixel for pixel.
+  cv::Mat expected = ReadImageToCVMat(filename, 256, 256, true);
+  EXPECT_EQ(0, memcmp(cv_img.data, expected.data,
+      expected.total() * expected.elemSize()));
+  // The second read of the same file reuses every buffer.
+  const void* file_data = file_buffer.data();
+  const void* decode_data = decode_buffer.data;
+  EXPECT_TRUE(ReadImageToCVMat(filename, 256, 256, true, &file_buffer,
+      &decode_buffer, &cv_img));
+  EXPECT_EQ(file_data, file_buffer.data());
+  EXPECT_EQ(decode_data, decode_buffer.data);
+  EXPECT_FALSE(ReadImageToCVMat("no-such-file.jpg", 256, 256, true,
+      &file_buffer, &decode_buffer, &cv_img));
+}
+
 TEST_F(IOTest, TestCVMatToDatum) {
   string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
   cv::Mat cv_img = ReadImageToCVMat(filename);
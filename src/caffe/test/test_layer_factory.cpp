@@ -48,4 +48,16 @@ TYPED_TEST(LayerFactoryTest, TestCreateLayer) {
   }
 }
 
+TYPED_TEST(LayerFactoryTest, TestTypeId) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int type_id = LayerRegistry<Dtype>::TypeId("InnerProduct");
+  ASSERT_GE(type_id, 0);
+  LayerParameter layer_param;
+  layer_param.set_type("InnerProduct");
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param, type_id);
+  EXPECT_STREQ("InnerProduct", layer->type());
+  EXPECT_EQ(-1, LayerRegistry<Dtype>::TypeId("NoSuchLayer"));
+}
+
 }  // namespace caffe
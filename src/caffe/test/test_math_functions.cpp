@@ -1,12 +1,15 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <algorithm>  // for std::max
 #include <cmath>  // for std::fabs
+#include <string>
 
 #include "gtest/gtest.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/util/gemm_dispatch.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -55,6 +58,60 @@ TYPED_TEST(CPUMathFunctionsTest, TestNothing) {
   //   due to the set up overhead.
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestGemmBackendFallback) {
+  // A backend that fails to load must leave the built-in BLAS active.
+  std::string error;
+  EXPECT_FALSE(caffe_gemm_load_backend("/nonexistent/libblas.so", &error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_FALSE(caffe_gemm_backend_active());
+  caffe_gemm_unload_backend();  // harmless with nothing loaded
+  EXPECT_FALSE(caffe_gemm_backend_active());
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestElementwise) {
+  int n = this->blob_bottom_->count();
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  const TypeParam* b = this->blob_top_->cpu_data();
+  TypeParam* y = this->blob_bottom_->mutable_cpu_diff();
+  caffe_add<TypeParam>(n, a, b, y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_FLOAT_EQ(y[i], a[i] + b[i]);
+  }
+  caffe_mul<TypeParam>(n, a, b, y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_FLOAT_EQ(y[i], a[i] * b[i]);
+  }
+  caffe_sqr<TypeParam>(n, a, y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_FLOAT_EQ(y[i], a[i] * a[i]);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestExp) {
+  int n = this->blob_bottom_->count();
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  TypeParam* y = this->blob_bottom_->mutable_cpu_diff();
+  caffe_exp<TypeParam>(n, a, y);
+  for (int i = 0; i < n; ++i) {
+    // The vectorized float path uses a polynomial exp accurate to a few
+    // ulps, not bit-identical to libm.
+    EXPECT_NEAR(y[i], std::exp(a[i]), 1e-5 * std::exp(a[i]));
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestClippedLog) {
+  int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam* y = this->blob_bottom_->mutable_cpu_diff();
+  const TypeParam floor = 1e-20;
+  caffe_cpu_clipped_log<TypeParam>(n, x, floor, y);
+  for (int i = 0; i < n; ++i) {
+    const TypeParam ref = std::log(std::max(x[i], floor));
+    // The vectorized float path matches logf to a few ulps.
+    EXPECT_NEAR(y[i], ref, 1e-5 * std::fabs(ref) + 1e-6);
+  }
+}
+
 TYPED_TEST(CPUMathFunctionsTest, TestAsum) {
   int n = this->blob_bottom_->count();
   const TypeParam* x = this->blob_bottom_->cpu_data();
@@ -66,6 +123,63 @@ TYPED_TEST(CPUMathFunctionsTest, TestAsum) {
   EXPECT_LT((cpu_asum - std_asum) / std_asum, 1e-2);
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestSliceReductions) {
+  const int num = 11 * 17;
+  const int dim = 19 * 23;
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam* sum = this->blob_top_->mutable_cpu_data();
+  TypeParam* sumsq = this->blob_top_->mutable_cpu_diff();
+  caffe_cpu_slice_sum_sumsq<TypeParam>(num, dim, x, sum, sumsq);
+  for (int i = 0; i < num; i += 37) {
+    TypeParam std_sum = 0, std_asum = 0, std_sumsq = 0;
+    for (int j = 0; j < dim; ++j) {
+      const TypeParam v = x[i * dim + j];
+      std_sum += v;
+      std_asum += std::fabs(v);
+      std_sumsq += v * v;
+    }
+    EXPECT_NEAR(sum[i], std_sum, 1e-2 * std_asum);
+    EXPECT_NEAR(sumsq[i], std_sumsq, 1e-2 * std_sumsq);
+  }
+  caffe_cpu_slice_asum<TypeParam>(num, dim, x, sum);
+  caffe_cpu_slice_sum<TypeParam>(num, dim, x, sumsq);
+  for (int i = 0; i < num; i += 37) {
+    TypeParam std_sum = 0, std_asum = 0;
+    for (int j = 0; j < dim; ++j) {
+      std_sum += x[i * dim + j];
+      std_asum += std::fabs(x[i * dim + j]);
+    }
+    EXPECT_NEAR(sum[i], std_asum, 1e-2 * std_asum);
+    EXPECT_NEAR(sumsq[i], std_sum, 1e-2 * std_asum);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestSubSumsq) {
+  const int num = 11 * 17;
+  const int dim = 19 * 23;
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  const TypeParam* b = this->blob_top_->cpu_data();
+  TypeParam* diff = this->blob_bottom_->mutable_cpu_diff();
+  TypeParam* sumsq = this->blob_top_->mutable_cpu_diff();
+  caffe_cpu_slice_sub_sumsq<TypeParam>(num, dim, a, b, diff, sumsq);
+  TypeParam std_total = 0;
+  for (int i = 0; i < num; ++i) {
+    TypeParam std_sumsq = 0;
+    for (int j = 0; j < dim; ++j) {
+      const TypeParam d = a[i * dim + j] - b[i * dim + j];
+      EXPECT_FLOAT_EQ(diff[i * dim + j], d);
+      std_sumsq += d * d;
+    }
+    if (i % 37 == 0) {
+      EXPECT_NEAR(sumsq[i], std_sumsq, 1e-2 * std_sumsq);
+    }
+    std_total += std_sumsq;
+  }
+  const TypeParam total =
+      caffe_cpu_sub_sumsq<TypeParam>(num * dim, a, b, diff);
+  EXPECT_NEAR(total, std_total, 1e-2 * std_total);
+}
+
 TYPED_TEST(CPUMathFunctionsTest, TestSign) {
   int n = this->blob_bottom_->count();
   const TypeParam* x = this->blob_bottom_->cpu_data();
@@ -139,6 +253,84 @@ TYPED_TEST(GPUMathFunctionsTest, TestAsum) {
   EXPECT_LT((gpu_asum - std_asum) / std_asum, 1e-2);
 }
 
+TYPED_TEST(GPUMathFunctionsTest, TestSumsqAcc) {
+  int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam std_sumsq = 0;
+  for (int i = 0; i < n; ++i) {
+    std_sumsq += x[i] * x[i];
+  }
+  // Accumulate the blob in two chunks to cover the multi-blob use: the
+  // device scalar sums across calls and only the readback syncs.
+  SyncedMemory acc(sizeof(TypeParam));
+  caffe_gpu_memset(sizeof(TypeParam), 0,
+      acc.mutable_gpu_data());
+  const TypeParam* gpu_x = this->blob_bottom_->gpu_data();
+  const int half = n / 2;
+  caffe_gpu_sumsq_acc<TypeParam>(half, gpu_x,
+      static_cast<TypeParam*>(acc.mutable_gpu_data()));
+  caffe_gpu_sumsq_acc<TypeParam>(n - half, gpu_x + half,
+      static_cast<TypeParam*>(acc.mutable_gpu_data()));
+  const TypeParam gpu_sumsq =
+      *static_cast<const TypeParam*>(acc.cpu_data());
+  EXPECT_LT(std::fabs(gpu_sumsq - std_sumsq) / std_sumsq, 1e-2);
+}
+
+TYPED_TEST(GPUMathFunctionsTest, TestSliceReductions) {
+  const int num = 11 * 17;
+  const int dim = 19 * 23;
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  const TypeParam* gpu_x = this->blob_bottom_->gpu_data();
+  caffe_gpu_slice_sum_sumsq<TypeParam>(num, dim, gpu_x,
+      this->blob_top_->mutable_gpu_data(),
+      this->blob_top_->mutable_gpu_diff());
+  const TypeParam* sum = this->blob_top_->cpu_data();
+  const TypeParam* sumsq = this->blob_top_->cpu_diff();
+  for (int i = 0; i < num; i += 37) {
+    TypeParam std_sum = 0, std_asum = 0, std_sumsq = 0;
+    for (int j = 0; j < dim; ++j) {
+      const TypeParam v = x[i * dim + j];
+      std_sum += v;
+      std_asum += std::fabs(v);
+      std_sumsq += v * v;
+    }
+    EXPECT_NEAR(sum[i], std_sum, 1e-2 * std_asum);
+    EXPECT_NEAR(sumsq[i], std_sumsq, 1e-2 * std_sumsq);
+  }
+  caffe_gpu_slice_asum<TypeParam>(num, dim, gpu_x,
+      this->blob_top_->mutable_gpu_data());
+  const TypeParam* asum = this->blob_top_->cpu_data();
+  for (int i = 0; i < num; i += 37) {
+    TypeParam std_asum = 0;
+    for (int j = 0; j < dim; ++j) {
+      std_asum += std::fabs(x[i * dim + j]);
+    }
+    EXPECT_NEAR(asum[i], std_asum, 1e-2 * std_asum);
+  }
+}
+
+TYPED_TEST(GPUMathFunctionsTest, TestSubSumsq) {
+  const int num = 11 * 17;
+  const int dim = 19 * 23;
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  const TypeParam* b = this->blob_top_->cpu_data();
+  caffe_gpu_slice_sub_sumsq<TypeParam>(num, dim,
+      this->blob_bottom_->gpu_data(), this->blob_top_->gpu_data(),
+      this->blob_bottom_->mutable_gpu_diff(),
+      this->blob_top_->mutable_gpu_diff());
+  const TypeParam* diff = this->blob_bottom_->cpu_diff();
+  const TypeParam* sumsq = this->blob_top_->cpu_diff();
+  for (int i = 0; i < num; i += 37) {
+    TypeParam std_sumsq = 0;
+    for (int j = 0; j < dim; ++j) {
+      const TypeParam d = a[i * dim + j] - b[i * dim + j];
+      EXPECT_FLOAT_EQ(diff[i * dim + j], d);
+      std_sumsq += d * d;
+    }
+    EXPECT_NEAR(sumsq[i], std_sumsq, 1e-2 * std_sumsq);
+  }
+}
+
 TYPED_TEST(GPUMathFunctionsTest, TestSign) {
   int n = this->blob_bottom_->count();
   caffe_gpu_sign<TypeParam>(n, this->blob_bottom_->gpu_data(),
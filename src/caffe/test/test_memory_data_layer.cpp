@@ -2,6 +2,7 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -295,5 +296,70 @@ TYPED_TEST(MemoryDataLayerTest, TestSetBatchSize) {
     }
   }
 }
+
+TYPED_TEST(MemoryDataLayerTest, TestForwardPartialBatch) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  MemoryDataParameter* memory_data_param = param.mutable_memory_data_param();
+  memory_data_param->set_batch_size(this->batch_size_);
+  memory_data_param->set_channels(this->channels_);
+  memory_data_param->set_height(this->height_);
+  memory_data_param->set_width(this->width_);
+  MemoryDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Add one and a half batches; the second forward slices the remainder.
+  const int num = this->batch_size_ + this->batch_size_ / 2;
+  vector<cv::Mat> mat_vector(num);
+  vector<int> label_vector(num);
+  for (int i = 0; i < num; ++i) {
+    mat_vector[i] = cv::Mat(this->height_, this->width_, CV_8UC4);
+    label_vector[i] = i;
+    cv::randu(mat_vector[i], cv::Scalar::all(0), cv::Scalar::all(255));
+  }
+  layer.AddMatVector(mat_vector, label_vector);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->batch_size_, this->blob_top_vec_[0]->num());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->batch_size_ / 2, this->blob_top_vec_[0]->num());
+  EXPECT_EQ(this->batch_size_ / 2, this->blob_top_vec_[1]->num());
+  for (int i = 0; i < this->batch_size_ / 2; ++i) {
+    EXPECT_EQ(this->batch_size_ + i, this->label_blob_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestAddMatVectorAsync) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  MemoryDataParameter* memory_data_param = param.mutable_memory_data_param();
+  memory_data_param->set_batch_size(this->batch_size_);
+  memory_data_param->set_channels(this->channels_);
+  memory_data_param->set_height(this->height_);
+  memory_data_param->set_width(this->width_);
+  MemoryDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Queue several differently sized requests before consuming any;
+  // Forward must deliver them in order, slicing the odd-sized ones.
+  const int sizes[] = { this->batch_size_, 3, 1 };
+  int label = 0;
+  for (int r = 0; r < 3; ++r) {
+    vector<cv::Mat> mat_vector(sizes[r]);
+    vector<int> label_vector(sizes[r]);
+    for (int i = 0; i < sizes[r]; ++i) {
+      mat_vector[i] = cv::Mat(this->height_, this->width_, CV_8UC4);
+      label_vector[i] = label++;
+      cv::randu(mat_vector[i], cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+    layer.AddMatVectorAsync(mat_vector, label_vector);
+  }
+  label = 0;
+  for (int r = 0; r < 3; ++r) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(std::min(sizes[r], this->batch_size_),
+        this->blob_top_vec_[0]->num());
+    for (int i = 0; i < this->blob_top_vec_[1]->num(); ++i) {
+      EXPECT_EQ(label++, this->label_blob_->cpu_data()[i]);
+    }
+  }
+}
 #endif  // USE_OPENCV
 }  // namespace caffe
@@ -0,0 +1,65 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/io.hpp"
+#include "caffe/util/metrics_sink.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MetricsSinkTest : public ::testing::Test {
+ protected:
+  vector<string> ReadLines(const string& filename) {
+    std::ifstream file(filename.c_str());
+    vector<string> lines;
+    string line;
+    while (std::getline(file, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+};
+
+TEST_F(MetricsSinkTest, TestWriteCSV) {
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".csv";
+  {
+    MetricsSink sink(filename);
+    EXPECT_EQ(0, sink.AddColumn("loss"));
+    EXPECT_EQ(1, sink.AddColumn("accuracy"));
+    EXPECT_EQ(0, sink.AddColumn("loss"));  // idempotent
+    vector<float> values(2);
+    for (int iter = 0; iter < 3; ++iter) {
+      values[0] = 2.0f - iter;
+      values[1] = 0.25f * iter;
+      sink.Append(iter, values);
+    }
+  }  // destruction flushes
+  const vector<string> lines = ReadLines(filename);
+  ASSERT_EQ(4, lines.size());
+  EXPECT_EQ("iter,loss,accuracy", lines[0]);
+  EXPECT_EQ("0,2,0", lines[1]);
+  EXPECT_EQ("1,1,0.25", lines[2]);
+  EXPECT_EQ("2,0,0.5", lines[3]);
+}
+
+TEST_F(MetricsSinkTest, TestWriteJSON) {
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".json";
+  {
+    MetricsSink sink(filename);
+    sink.AddColumn("loss");
+    sink.Append(7, vector<float>(1, 1.5f));
+  }
+  const vector<string> lines = ReadLines(filename);
+  ASSERT_EQ(1, lines.size());
+  EXPECT_EQ("{\"iter\": 7, \"loss\": 1.5}", lines[0]);
+}
+
+}  // namespace caffe
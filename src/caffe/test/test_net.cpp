@@ -731,6 +731,485 @@ TYPED_TEST(NetTest, TestHasBlob) {
   EXPECT_TRUE(this->net_->has_blob("top_loss"));
 }
 
+TYPED_TEST(NetTest, TestCheckpointBackward) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Three checkpoint segments; the middle one (tanh1, ip2) is released
+  // after forward and must be regenerated for backward. Constant data
+  // and a shared seed make the checkpointed and plain nets comparable.
+  const string proto_head =
+      "name: 'CheckpointNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 5 dim: 3 } "
+      "    shape { dim: 5 dim: 2 } "
+      "    data_filler { type: 'constant' value: 0.4 } "
+      "    data_filler { type: 'constant' value: 0.7 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'uniform' min: -1 max: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'ip1' ";
+  const string proto_mid =
+      "} "
+      "layer { name: 'tanh1' type: 'TanH' bottom: 'ip1' top: 'tanh1' } "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'uniform' min: -1 max: 1 } "
+      "  } "
+      "  bottom: 'tanh1' "
+      "  top: 'ip2' ";
+  const string proto_tail =
+      "} "
+      "layer { "
+      "  name: 'ip3' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 2 "
+      "    weight_filler { type: 'uniform' min: -1 max: 1 } "
+      "  } "
+      "  bottom: 'ip2' "
+      "  top: 'ip3' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip3' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  const string checkpoint = "  checkpoint: true ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto_head + proto_mid + proto_tail);
+  this->net_->Forward();
+  this->net_->Backward();
+  vector<shared_ptr<Blob<Dtype> > > expected_params;
+  this->CopyNetParams(true, &expected_params);
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(
+      proto_head + checkpoint + proto_mid + checkpoint + proto_tail);
+  this->net_->Forward();
+  this->net_->Backward();
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  ASSERT_EQ(expected_params.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    ASSERT_EQ(expected_params[i]->count(), params[i]->count());
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_NEAR(expected_params[i]->cpu_diff()[j],
+          params[i]->cpu_diff()[j], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardInference) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Constant-filled data so repeated forwards see identical inputs
+  // (the gaussian dummy data of the tiny net refills every pass).
+  const string proto =
+      "name: 'ForwardInferenceNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+      "    data_filler { type: 'constant' value: 0.5 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'innerproduct' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 10 "
+      "    weight_filler { type: 'uniform' min: -1 max: 1 } "
+      "    bias_filler { type: 'uniform' min: -1 max: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'innerproduct' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  const vector<Blob<Dtype>*>& ref = this->net_->Forward();
+  vector<Dtype> expected(ref[0]->count());
+  caffe_copy(ref[0]->count(), ref[0]->cpu_data(), &expected[0]);
+  const vector<Blob<Dtype>*>& out = this->net_->ForwardInference();
+  ASSERT_EQ(ref.size(), out.size());
+  for (int i = 0; i < out[0]->count(); ++i) {
+    EXPECT_FLOAT_EQ(expected[i], out[0]->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestReplaceLayerParams) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet();
+  const shared_ptr<Layer<Dtype> > ip = this->net_->layer_by_name(
+      "innerproduct");
+  vector<shared_ptr<Blob<Dtype> > > new_blobs(ip->blobs().size());
+  for (int i = 0; i < new_blobs.size(); ++i) {
+    new_blobs[i].reset(new Blob<Dtype>(ip->blobs()[i]->shape()));
+    caffe_set(new_blobs[i]->count(), Dtype(0.5),
+        new_blobs[i]->mutable_cpu_data());
+  }
+  this->net_->ReplaceLayerParams("innerproduct", new_blobs);
+  // The layer's blobs and the net's params_ views see the new values.
+  for (int i = 0; i < new_blobs.size(); ++i) {
+    const Dtype* data = ip->blobs()[i]->cpu_data();
+    for (int j = 0; j < ip->blobs()[i]->count(); ++j) {
+      EXPECT_EQ(Dtype(0.5), data[j]);
+    }
+  }
+  const Dtype* param_data = this->net_->params()[0]->cpu_data();
+  EXPECT_EQ(Dtype(0.5), param_data[0]);
+}
+
+TYPED_TEST(NetTest, TestInsertRemoveLayer) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet();
+  const int num_layers = this->net_->layers().size();
+  LayerParameter relu_param;
+  relu_param.set_name("inserted_relu");
+  relu_param.set_type("ReLU");
+  relu_param.add_bottom("innerproduct");
+  relu_param.add_top("innerproduct");
+  this->net_->InsertLayer(relu_param);
+  EXPECT_TRUE(this->net_->has_layer("inserted_relu"));
+  EXPECT_EQ(num_layers + 1, this->net_->layers().size());
+  // Spliced right after the producing layer, wired in place.
+  EXPECT_EQ("inserted_relu", this->net_->layer_names()[2]);
+  EXPECT_EQ(this->net_->bottom_vecs()[2][0], this->net_->top_vecs()[2][0]);
+  this->net_->Forward();
+  this->net_->RemoveLayer("inserted_relu");
+  EXPECT_FALSE(this->net_->has_layer("inserted_relu"));
+  EXPECT_EQ(num_layers, this->net_->layers().size());
+  this->net_->Forward();
+}
+
+TYPED_TEST(NetTest, TestMemoryReport) {
+  this->InitTinyNet();
+  const string report = this->net_->memory_report();
+  // One line per layer, named and typed.
+  EXPECT_NE(report.find("data (DummyData)"), string::npos);
+  EXPECT_NE(report.find("innerproduct (InnerProduct)"), string::npos);
+  EXPECT_NE(report.find("loss (SoftmaxWithLoss)"), string::npos);
+  EXPECT_NE(report.find("totals:"), string::npos);
+  EXPECT_NE(report.find("resident:"), string::npos);
+  // The InnerProduct weights are 1000 x 24 plus 1000 biases.
+  typedef typename TypeParam::Dtype Dtype;
+  ostringstream params;
+  params << "params " << 1000 * (2 * 3 * 4 + 1) * sizeof(Dtype);
+  EXPECT_NE(report.find(params.str()), string::npos);
+}
+
+TYPED_TEST(NetTest, TestWarmup) {
+  this->InitTinyNet();
+  this->net_->Warmup();
+  // Every allocation was faulted in; nothing is left for the first
+  // real iteration to pay.
+  typedef typename TypeParam::Dtype Dtype;
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    EXPECT_NE(blobs[i]->data()->head(), SyncedMemory::UNINITIALIZED);
+    EXPECT_NE(blobs[i]->diff()->head(), SyncedMemory::UNINITIALIZED);
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_NE(params[i]->data()->head(), SyncedMemory::UNINITIALIZED);
+    EXPECT_NE(params[i]->diff()->head(), SyncedMemory::UNINITIALIZED);
+  }
+}
+
+TYPED_TEST(NetTest, TestLayerTimings) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet(true);
+  NetParameter param;
+  this->net_->ToProto(&param);
+  param.set_profile_layers(true);
+  param.set_force_backward(true);
+  this->net_.reset(new Net<Dtype>(param));
+  // On GPU a layer's event pair is harvested one iteration later, so
+  // run a few iterations to guarantee every layer has samples.
+  for (int i = 0; i < 4; ++i) {
+    this->net_->ForwardBackward();
+  }
+  const vector<typename Net<Dtype>::LayerTiming> timings =
+      this->net_->layer_timings();
+  ASSERT_EQ(this->net_->layers().size(), timings.size());
+  bool any_backward = false;
+  for (int i = 0; i < timings.size(); ++i) {
+    EXPECT_EQ(this->net_->layer_names()[i], timings[i].name);
+    EXPECT_GT(timings[i].forward_samples, 0);
+    EXPECT_GE(timings[i].forward_max, timings[i].forward_p50);
+    any_backward |= timings[i].backward_samples > 0;
+  }
+  EXPECT_TRUE(any_backward);
+  this->net_->LogLayerTimings();
+}
+
+TYPED_TEST(NetTest, TestAsyncLossReadback) {
+#ifndef CPU_ONLY
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::GPU) { return; }
+  // Constant inputs and fixed weights make the loss identical every
+  // iteration, so the one-iteration delay is observable exactly.
+  const string& proto =
+      "name: 'AsyncLossTestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 5 dim: 2 } "
+      "    data_filler { type: 'constant' value: 0.5 } "
+      "    shape { dim: 5 } "
+      "    data_filler { type: 'constant' } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerproduct' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'constant' } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'innerproduct' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'SoftmaxWithLoss' "
+      "  bottom: 'innerproduct' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Dtype sync_loss;
+  this->net_->Forward(&sync_loss);
+  EXPECT_GT(sync_loss, Dtype(0));
+  this->net_->set_async_loss(true);
+  // The first asynchronous forward has nothing to report yet; from the
+  // second on, the delayed value matches the synchronous one.
+  Dtype async_loss;
+  this->net_->Forward(&async_loss);
+  EXPECT_EQ(Dtype(0), async_loss);
+  this->net_->Forward(&async_loss);
+  EXPECT_NEAR(sync_loss, async_loss, 1e-5);
+  this->net_->set_async_loss(false);
+  this->net_->Forward(&async_loss);
+  EXPECT_NEAR(sync_loss, async_loss, 1e-5);
+#endif
+}
+
+TYPED_TEST(NetTest, TestBackwardPrunesFrozenPrefix) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A fine-tuning shape: the first InnerProduct is frozen with
+  // lr_mult 0, so no layer before the second one has backward work.
+  const string& proto =
+      "name: 'FrozenPrefixTestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 5 dim: 2 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "    shape { dim: 5 } "
+      "    data_filler { type: 'constant' } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'frozen_ip' "
+      "  type: 'InnerProduct' "
+      "  param { lr_mult: 0 } "
+      "  param { lr_mult: 0 } "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'constant' } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'frozen_ip' "
+      "} "
+      "layer { "
+      "  name: 'tuned_ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'constant' } "
+      "  } "
+      "  bottom: 'frozen_ip' "
+      "  top: 'tuned_ip' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'SoftmaxWithLoss' "
+      "  bottom: 'tuned_ip' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  const vector<bool>& need_backward =
+      this->net_->learnable_param_need_backward();
+  ASSERT_EQ(4, need_backward.size());
+  EXPECT_FALSE(need_backward[0]);
+  EXPECT_FALSE(need_backward[1]);
+  EXPECT_TRUE(need_backward[2]);
+  EXPECT_TRUE(need_backward[3]);
+  this->net_->ClearParamDiffs();
+  this->net_->Forward();
+  this->net_->Backward();
+  this->net_->Update();
+  // The tuned layer got its gradient; the frozen layer's diff blobs
+  // were never touched, hence never allocated.
+  const shared_ptr<Layer<Dtype> >& frozen =
+      this->net_->layer_by_name("frozen_ip");
+  const shared_ptr<Layer<Dtype> >& tuned =
+      this->net_->layer_by_name("tuned_ip");
+  EXPECT_NE(tuned->blobs()[0]->diff()->head(), SyncedMemory::UNINITIALIZED);
+  EXPECT_EQ(frozen->blobs()[0]->diff()->head(), SyncedMemory::UNINITIALIZED);
+  EXPECT_EQ(frozen->blobs()[1]->diff()->head(), SyncedMemory::UNINITIALIZED);
+}
+
+template <typename Dtype>
+class BackwardLayerRecorder : public Net<Dtype>::Callback {
+ public:
+  virtual void run(int layer) { layers_.push_back(layer); }
+  vector<int> layers_;
+};
+
+TYPED_TEST(NetTest, TestAfterBackwardCallback) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet();
+  this->net_->Forward();
+  BackwardLayerRecorder<Dtype> recorder;
+  this->net_->add_after_backward(&recorder);
+  this->net_->Backward();
+  // Fired once per layer the backward pass walked, from the top down;
+  // the data layer has no backward work, so the walk stops above it.
+  ASSERT_EQ(2, recorder.layers_.size());
+  EXPECT_EQ(2, recorder.layers_[0]);
+  EXPECT_EQ(1, recorder.layers_[1]);
+}
+
+TYPED_TEST(NetTest, TestCompileNetFusesEltwiseChain) {
+  typedef typename TypeParam::Dtype Dtype;
+  // At TEST time an Eltwise followed by its sole (in-place) consumer
+  // collapses into one FusedEltwise layer.
+  const string& proto =
+      "name: 'EltwiseFusionTestNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 } "
+      "    data_filler { type: 'constant' value: 2 } "
+      "    shape { dim: 2 dim: 3 } "
+      "    data_filler { type: 'constant' value: -3 } "
+      "  } "
+      "  top: 'a' "
+      "  top: 'b' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'a' "
+      "  bottom: 'b' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'sum' "
+      "  top: 'sum' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  EXPECT_FALSE(this->net_->has_layer("relu"));
+  ASSERT_TRUE(this->net_->has_layer("sum"));
+  EXPECT_STREQ("FusedEltwise", this->net_->layer_by_name("sum")->type());
+  this->net_->Forward();
+  // 2 + (-3) = -1, rectified to 0, in a single pass.
+  const shared_ptr<Blob<Dtype> >& sum = this->net_->blob_by_name("sum");
+  for (int i = 0; i < sum->count(); ++i) {
+    EXPECT_EQ(Dtype(0), sum->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestReshapeSkipStaticShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'ReshapeSkipTestNetwork' "
+      "layer { "
+      "  name: 'input' "
+      "  type: 'Input' "
+      "  input_param { shape { dim: 2 dim: 3 } } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'innerproduct' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'constant' } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'innerproduct' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype>* input = this->net_->input_blobs()[0];
+  caffe_set(input->count(), Dtype(1), input->mutable_cpu_data());
+  this->net_->Forward();
+  const shared_ptr<Blob<Dtype> >& top =
+      this->net_->blob_by_name("innerproduct");
+  const Dtype* top_storage = top->cpu_data();
+  const Dtype first_value = top_storage[0];
+  // Static-shape iteration: no reshape, storage stays put, values hold.
+  this->net_->Forward();
+  EXPECT_EQ(top_storage, top->cpu_data());
+  EXPECT_EQ(first_value, top->cpu_data()[0]);
+  // A changed input shape must still propagate through the net.
+  input->Reshape(5, 3, 1, 1);
+  caffe_set(input->count(), Dtype(1), input->mutable_cpu_data());
+  this->net_->Forward();
+  EXPECT_EQ(5, top->shape(0));
+  EXPECT_EQ(4, top->shape(1));
+  // Identical rows in, identical rows out -- the larger batch went
+  // through the same weights.
+  for (int i = 0; i < top->count(); ++i) {
+    EXPECT_EQ(top->cpu_data()[i % 4], top->cpu_data()[i]);
+  }
+  EXPECT_EQ(first_value, top->cpu_data()[0]);
+}
+
+TYPED_TEST(NetTest, TestForwardToBlobs) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet();
+  vector<string> wanted(1, "innerproduct");
+  this->net_->ForwardTo(wanted);
+  // The requested blob and its ancestors ran; the loss head did not.
+  EXPECT_NE(this->net_->blob_by_name("innerproduct")->data()->head(),
+      SyncedMemory::UNINITIALIZED);
+  EXPECT_NE(this->net_->blob_by_name("data")->data()->head(),
+      SyncedMemory::UNINITIALIZED);
+  EXPECT_EQ(this->net_->blob_by_name("top_loss")->data()->head(),
+      SyncedMemory::UNINITIALIZED);
+}
+
 TYPED_TEST(NetTest, TestGetBlob) {
   this->InitTinyNet();
   EXPECT_EQ(this->net_->blob_by_name("data"), this->net_->blobs()[0]);
@@ -2371,4 +2850,487 @@ TYPED_TEST(NetTest, TestSkipPropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestFusedConvReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto_head =
+      "name: 'FusedConvReLUNet' "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "    bias_filler { type: 'constant' value: 0.1 } "
+      "  } "
+      "} ";
+  // The in-place ReLU is the sole consumer of the convolution output, so
+  // Net::Init folds it into the convolution epilogue and drops it from
+  // the forward schedule.
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto_head +
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } ");
+  const Blob<Dtype>* fused_out = this->net_->Forward()[0];
+  // The reference net keeps the ReLU as a separate layer by giving it its
+  // own top blob; the same seed reproduces the weights.
+  Caffe::set_random_seed(this->seed_);
+  NetParameter ref_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto_head +
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'relu' } ",
+      &ref_param));
+  Net<Dtype> ref_net(ref_param);
+  const Blob<Dtype>* ref_out = ref_net.Forward()[0];
+  ASSERT_EQ(fused_out->count(), ref_out->count());
+  for (int i = 0; i < fused_out->count(); ++i) {
+    EXPECT_GE(fused_out->cpu_data()[i], 0);
+    EXPECT_NEAR(fused_out->cpu_data()[i], ref_out->cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestFoldBatchNorm) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'FoldBatchNormNet' "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    bias_term: false "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "} "
+      "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'conv' } "
+      "layer { name: 'sc' type: 'Scale' bottom: 'conv' top: 'conv' "
+      "  scale_param { bias_term: true } } ";
+  // Build the reference net, give its BatchNorm and Scale layers
+  // non-trivial parameters, and snapshot it as the trained model.
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype>* bn_mean = this->net_->layer_by_name("bn")->blobs()[0].get();
+  Blob<Dtype>* bn_var = this->net_->layer_by_name("bn")->blobs()[1].get();
+  this->net_->layer_by_name("bn")->blobs()[2]->mutable_cpu_data()[0] = 0.8;
+  Blob<Dtype>* sc_gamma = this->net_->layer_by_name("sc")->blobs()[0].get();
+  Blob<Dtype>* sc_beta = this->net_->layer_by_name("sc")->blobs()[1].get();
+  for (int o = 0; o < 4; ++o) {
+    bn_mean->mutable_cpu_data()[o] = 0.2 * o - 0.3;
+    bn_var->mutable_cpu_data()[o] = 0.5 + 0.25 * o;
+    sc_gamma->mutable_cpu_data()[o] = 1.5 - 0.4 * o;
+    sc_beta->mutable_cpu_data()[o] = 0.1 * o;
+  }
+  NetParameter trained;
+  this->net_->ToProto(&trained, false);
+  const Blob<Dtype>* ref_out = this->net_->Forward()[0];
+  Blob<Dtype> reference;
+  reference.CopyFrom(*ref_out, false, true);
+  // The folded net drops both layers and reproduces their arithmetic in
+  // the convolution weights and synthesized bias once weights load.
+  NetParameter fold_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "fold_batch_norm: true " + proto, &fold_param));
+  Net<Dtype> fold_net(fold_param);
+  EXPECT_EQ(fold_net.layers().size(), this->net_->layers().size() - 2);
+  fold_net.CopyTrainedLayersFrom(trained);
+  const Blob<Dtype>* fold_out = fold_net.Forward()[0];
+  ASSERT_EQ(fold_out->count(), reference.count());
+  for (int i = 0; i < fold_out->count(); ++i) {
+    EXPECT_NEAR(fold_out->cpu_data()[i], reference.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardOnly) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'ForwardOnlyNet' "
+      "state: { phase: TEST } "
+      "forward_only: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 1 dim: 2 dim: 4 dim: 4 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 3 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } ";
+  this->InitNetFromProtoString(proto);
+  this->net_->Forward();
+  // No diff was faulted in anywhere: not for activations, not for
+  // parameters.
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  for (int i = 0; i < blobs.size(); ++i) {
+    EXPECT_TRUE(blobs[i]->forward_only());
+    EXPECT_EQ(blobs[i]->diff()->head(), SyncedMemory::UNINITIALIZED);
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_TRUE(params[i]->forward_only());
+    EXPECT_EQ(params[i]->diff()->head(), SyncedMemory::UNINITIALIZED);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardParallelism) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Four independent branches off one data layer, merged by a sum --
+  // the inception-style shape the dataflow scheduler exists for.
+  string proto =
+      "name: 'BranchyNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 4 dim: 4 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} ";
+  for (int b = 0; b < 4; ++b) {
+    ostringstream branch;
+    branch <<
+        "layer { name: 'conv" << b << "' type: 'Convolution' "
+        "  bottom: 'data' top: 'conv" << b << "' "
+        "  convolution_param { num_output: 2 kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 1 } } } ";
+    proto += branch.str();
+  }
+  proto +=
+      "layer { name: 'sum' type: 'Eltwise' "
+      "  bottom: 'conv0' bottom: 'conv1' bottom: 'conv2' bottom: 'conv3' "
+      "  top: 'sum' } ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  NetParameter trained;
+  this->net_->ToProto(&trained, false);
+  const Blob<Dtype>* ref_out = this->net_->Forward()[0];
+  Blob<Dtype> reference;
+  reference.CopyFrom(*ref_out, false, true);
+  NetParameter parallel_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "forward_parallelism: 4 " + proto, &parallel_param));
+  Net<Dtype> parallel_net(parallel_param);
+  parallel_net.CopyTrainedLayersFrom(trained);
+  for (int pass = 0; pass < 2; ++pass) {
+    const Blob<Dtype>* out = parallel_net.Forward()[0];
+    ASSERT_EQ(out->count(), reference.count());
+    for (int i = 0; i < out->count(); ++i) {
+      EXPECT_EQ(out->cpu_data()[i], reference.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestCompileNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'CompileNet' "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 8 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' "
+      "  inner_product_param { num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'drop' type: 'Dropout' bottom: 'ip1' top: 'drop' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'drop' top: 'ip2' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'ip2' top: 'ip2' } "
+      "layer { name: 'ip3' type: 'InnerProduct' bottom: 'ip2' top: 'ip3' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ";
+  this->InitNetFromProtoString(proto);
+  // TEST-phase dropout is compiled out and ip2 reads ip1 directly.
+  EXPECT_FALSE(this->net_->has_layer("drop"));
+  EXPECT_FALSE(this->net_->has_blob("drop"));
+  EXPECT_TRUE(this->net_->has_layer("ip2"));
+  this->net_->Forward();
+  // A forward-only net additionally elides the split layers that a
+  // multiply-consumed blob would otherwise get.
+  const string branchy =
+      "forward_only: true "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 8 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { name: 'ipa' type: 'InnerProduct' bottom: 'data' top: 'ipa' "
+      "  inner_product_param { num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'ipb' type: 'InnerProduct' bottom: 'data' top: 'ipb' "
+      "  inner_product_param { num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ";
+  NetParameter branchy_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      branchy, &branchy_param));
+  Net<Dtype> branchy_net(branchy_param);
+  EXPECT_FALSE(branchy_net.has_layer("data_data_0_split"));
+  EXPECT_EQ(branchy_net.layers().size(), 3);
+  branchy_net.Forward();
+}
+
+TYPED_TEST(NetTest, TestCompileNetInPlaceRewriteAfterDropout) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A ReLU rewriting the elided dropout's top in place must continue in
+  // place on the dropout's bottom; compare against the net written that
+  // way by hand, with identical fillers via a shared seed.
+  const string head =
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 8 } "
+      "    data_filler { type: 'constant' value: 0.5 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' "
+      "  inner_product_param { num_output: 4 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ";
+  const string tail =
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'drop' top: 'ip2' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(head +
+      "layer { name: 'drop' type: 'Dropout' bottom: 'ip1' top: 'drop' } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'drop' top: 'drop' } " +
+      tail);
+  EXPECT_FALSE(this->net_->has_layer("drop"));
+  EXPECT_FALSE(this->net_->has_blob("drop"));
+  const Blob<Dtype>* out = this->net_->Forward()[0];
+  vector<Dtype> result(out->count());
+  caffe_copy(out->count(), out->cpu_data(), &result[0]);
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(head +
+      "layer { name: 'relu' type: 'ReLU' bottom: 'ip1' top: 'ip1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'ip1' top: 'ip2' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ");
+  const Blob<Dtype>* ref = this->net_->Forward()[0];
+  ASSERT_EQ(ref->count(), result.size());
+  for (int i = 0; i < ref->count(); ++i) {
+    EXPECT_FLOAT_EQ(ref->cpu_data()[i], result[i]);
+  }
+  // When the bottom has another reader, folding the in-place rewrite
+  // onto it would clobber that reader's input; the dropout must stay.
+  this->InitNetFromProtoString(head +
+      "layer { name: 'drop' type: 'Dropout' bottom: 'ip1' top: 'drop' } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'drop' top: 'drop' } " +
+      tail +
+      "layer { name: 'ip3' type: 'InnerProduct' bottom: 'ip1' top: 'ip3' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ");
+  EXPECT_TRUE(this->net_->has_layer("drop"));
+  this->net_->Forward();
+}
+
+TYPED_TEST(NetTest, TestShareActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'ShareActivationsNet' "
+      "state: { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 1 dim: 2 dim: 6 dim: 6 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "} "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 3 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'conv1' top: 'conv2' "
+      "  convolution_param { num_output: 5 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'conv3' type: 'Convolution' bottom: 'conv2' top: 'conv3' "
+      "  convolution_param { num_output: 2 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } "
+      "layer { name: 'conv4' type: 'Convolution' bottom: 'conv3' top: 'conv4' "
+      "  convolution_param { num_output: 4 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 1 } } } ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  NetParameter trained;
+  this->net_->ToProto(&trained, false);
+  const Blob<Dtype>* ref_out = this->net_->Forward()[0];
+  Blob<Dtype> reference;
+  reference.CopyFrom(*ref_out, false, true);
+  NetParameter share_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "share_activations: true " + proto, &share_param));
+  Net<Dtype> share_net(share_param);
+  share_net.CopyTrainedLayersFrom(trained);
+  // conv1 is dead once conv2 has run, so conv3's top reuses its buffer;
+  // conv2 overlaps conv1 and must live elsewhere. The data-layer top and
+  // the net output keep private storage.
+  EXPECT_EQ(share_net.blob_by_name("conv1")->data().get(),
+            share_net.blob_by_name("conv3")->data().get());
+  EXPECT_NE(share_net.blob_by_name("conv1")->data().get(),
+            share_net.blob_by_name("conv2")->data().get());
+  EXPECT_NE(share_net.blob_by_name("data")->data().get(),
+            share_net.blob_by_name("conv3")->data().get());
+  EXPECT_NE(share_net.blob_by_name("conv4")->data().get(),
+            share_net.blob_by_name("conv2")->data().get());
+  // Two forward passes, since reuse bugs only show once a buffer holds a
+  // previous tenant's values.
+  share_net.Forward();
+  const Blob<Dtype>* share_out = share_net.Forward()[0];
+  ASSERT_EQ(share_out->count(), reference.count());
+  for (int i = 0; i < share_out->count(); ++i) {
+    EXPECT_EQ(share_out->cpu_data()[i], reference.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestZeroCopyConcatSliceViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'ZeroCopyViewsNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 1 dim: 2 dim: 3 } "
+      "    shape { dim: 1 dim: 2 dim: 3 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "    data_filler { type: 'constant' value: 2 } "
+      "  } "
+      "  top: 'a' "
+      "  top: 'b' "
+      "} "
+      "layer { name: 'concat' type: 'Concat' concat_param { axis: 0 } "
+      "  bottom: 'a' bottom: 'b' top: 'c' } "
+      "layer { name: 'slice' type: 'Slice' slice_param { axis: 0 } "
+      "  bottom: 'c' top: 's1' top: 's2' } ";
+  this->InitNetFromProtoString(proto);
+  const shared_ptr<Blob<Dtype> > a = this->net_->blob_by_name("a");
+  const shared_ptr<Blob<Dtype> > b = this->net_->blob_by_name("b");
+  const shared_ptr<Blob<Dtype> > c = this->net_->blob_by_name("c");
+  const shared_ptr<Blob<Dtype> > s1 = this->net_->blob_by_name("s1");
+  const shared_ptr<Blob<Dtype> > s2 = this->net_->blob_by_name("s2");
+  this->net_->Forward();
+  // Axis-0 concat and slice are outermost-contiguous, so the bottoms
+  // and slices alias ranges of the shared storage instead of copying.
+  const Dtype* c_data = c->cpu_data();
+  EXPECT_EQ(c_data, a->cpu_data());
+  EXPECT_EQ(c_data + 6, b->cpu_data());
+  EXPECT_EQ(c_data, s1->cpu_data());
+  EXPECT_EQ(c_data + 6, s2->cpu_data());
+  // The constant DummyData fill from setup survives the rewiring.
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(c_data[i], 1);
+    EXPECT_EQ(c_data[6 + i], 2);
+    EXPECT_EQ(s1->cpu_data()[i], 1);
+    EXPECT_EQ(s2->cpu_data()[i], 2);
+  }
+}
+
+TYPED_TEST(NetTest, TestZeroCopyCropView) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A crop that only trims an outer axis (here axis 1 of a
+  // singleton-batch blob) selects one contiguous range of the bottom,
+  // so the top aliases it instead of copying.
+  const string proto =
+      "name: 'CropViewNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 1 dim: 4 dim: 2 dim: 3 } "
+      "    shape { dim: 1 dim: 2 dim: 2 dim: 3 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "    data_filler { type: 'constant' value: 2 } "
+      "  } "
+      "  top: 'a' "
+      "  top: 'ref' "
+      "} "
+      "layer { name: 'crop' type: 'Crop' "
+      "  crop_param { axis: 1 offset: 1 offset: 0 offset: 0 } "
+      "  bottom: 'a' bottom: 'ref' top: 'c' } ";
+  this->InitNetFromProtoString(proto);
+  const shared_ptr<Blob<Dtype> > a = this->net_->blob_by_name("a");
+  const shared_ptr<Blob<Dtype> > c = this->net_->blob_by_name("c");
+  EXPECT_TRUE(c->data()->is_view());
+  this->net_->Forward();
+  EXPECT_EQ(c->cpu_data(), a->cpu_data() + 6);
+  for (int i = 0; i < 12; ++i) {
+    EXPECT_EQ(c->cpu_data()[i], 1);
+  }
+}
+
+TYPED_TEST(NetTest, TestZeroCopyViewsSkipInnerAxis) {
+  typedef typename TypeParam::Dtype Dtype;
+  // With two outer rows, channel-axis concat interleaves the bottoms in
+  // the top, so no views can be wired and Forward copies as before.
+  const string proto =
+      "name: 'InnerAxisConcatNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 2 dim: 3 } "
+      "    shape { dim: 2 dim: 4 dim: 3 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "    data_filler { type: 'constant' value: 2 } "
+      "  } "
+      "  top: 'a' "
+      "  top: 'b' "
+      "} "
+      "layer { name: 'concat' type: 'Concat' concat_param { axis: 1 } "
+      "  bottom: 'a' bottom: 'b' top: 'c' } ";
+  this->InitNetFromProtoString(proto);
+  const shared_ptr<Blob<Dtype> > a = this->net_->blob_by_name("a");
+  const shared_ptr<Blob<Dtype> > c = this->net_->blob_by_name("c");
+  EXPECT_FALSE(a->data()->is_view());
+  this->net_->Forward();
+  EXPECT_NE(c->cpu_data(), a->cpu_data());
+  const Dtype* c_data = c->cpu_data();
+  for (int n = 0; n < 2; ++n) {
+    for (int i = 0; i < 18; ++i) {
+      EXPECT_EQ(c_data[n * 18 + i], i < 6 ? 1 : 2);
+    }
+  }
+}
+
 }  // namespace caffe
@@ -520,6 +520,34 @@ TYPED_TEST(PoolingLayerTest, TestForwardMaxPadded) {
   EXPECT_NEAR(this->blob_top_->cpu_data()[8], 1, epsilon);
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardMaxInference) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The TEST-phase forward takes the maskless vectorized planes; check it
+  // against the masked TRAIN-phase path, including the 2x2/s2 and 3x3/s2
+  // specializations and a multi-threaded run.
+  for (int kernel = 2; kernel <= 3; ++kernel) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(kernel);
+    pooling_param->set_stride(2);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+    pooling_param->set_forward_threads(2);
+    layer_param.set_phase(TRAIN);
+    PoolingLayer<Dtype> train_layer(layer_param);
+    train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> reference;
+    reference.CopyFrom(*this->blob_top_, false, true);
+    layer_param.set_phase(TEST);
+    PoolingLayer<Dtype> test_layer(layer_param);
+    test_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    test_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < reference.count(); ++i) {
+      EXPECT_EQ(this->blob_top_->cpu_data()[i], reference.cpu_data()[i]);
+    }
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestGradientMaxTopMask) {
   typedef typename TypeParam::Dtype Dtype;
   for (int kernel_h = 3; kernel_h <= 4; kernel_h++) {
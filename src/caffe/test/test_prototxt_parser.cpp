@@ -0,0 +1,89 @@
+#include <google/protobuf/text_format.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/prototxt_parser.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class PrototxtParserTest : public ::testing::Test {
+ protected:
+  // The fast parser must agree byte-for-byte with TextFormat on
+  // everything inside its subset.
+  void CheckMatchesTextFormat(const string& text) {
+    NetParameter fast_param;
+    ASSERT_TRUE(ParsePrototxtFast(text, &fast_param)) << text;
+    NetParameter reference_param;
+    ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(
+        text, &reference_param)) << text;
+    EXPECT_EQ(reference_param.SerializeAsString(),
+              fast_param.SerializeAsString());
+  }
+};
+
+TEST_F(PrototxtParserTest, TestParseNet) {
+  this->CheckMatchesTextFormat(
+      "name: \"test net\"\n"
+      "# a comment\n"
+      "layer {\n"
+      "  name: \"data\"\n"
+      "  type: \"DummyData\"\n"
+      "  top: \"data\"\n"
+      "  dummy_data_param {\n"
+      "    shape { dim: 2 dim: 3 dim: 4 dim: 5 }\n"
+      "    data_filler { type: \"uniform\" min: -1.5 max: 1e-2 }\n"
+      "  }\n"
+      "}\n"
+      "layer {\n"
+      "  name: \"conv\"\n"
+      "  type: \"Convolution\"\n"
+      "  bottom: \"data\"\n"
+      "  top: \"conv\"\n"
+      "  param { lr_mult: 1 decay_mult: 1 }\n"
+      "  convolution_param {\n"
+      "    num_output: 8\n"
+      "    kernel_size: 3\n"
+      "    pad: 1\n"
+      "    bias_term: false\n"
+      "    engine: CAFFE\n"
+      "  }\n"
+      "}\n");
+}
+
+TEST_F(PrototxtParserTest, TestParseEnumByNumberAndPhase) {
+  this->CheckMatchesTextFormat(
+      "state { phase: TEST level: -2 }\n"
+      "layer { name: \"p\" type: \"Pooling\"\n"
+      "  pooling_param { pool: 1 kernel_size: 2 stride: 2 } }\n");
+}
+
+TEST_F(PrototxtParserTest, TestParseStringEscapes) {
+  this->CheckMatchesTextFormat(
+      "name: \"tab\\there \\\"quoted\\\" and\\nnewline\"\n");
+}
+
+TEST_F(PrototxtParserTest, TestUnknownFieldRejected) {
+  NetParameter param;
+  EXPECT_FALSE(ParsePrototxtFast("no_such_field: 1\n", &param));
+}
+
+TEST_F(PrototxtParserTest, TestListSyntaxRejected) {
+  // Short-hand repeated syntax is outside the subset; TextFormat takes
+  // over for it.
+  NetParameter param;
+  EXPECT_FALSE(ParsePrototxtFast(
+      "input: \"data\" input_dim: [1, 3, 4, 4]\n", &param));
+}
+
+TEST_F(PrototxtParserTest, TestTruncatedInputRejected) {
+  NetParameter param;
+  EXPECT_FALSE(ParsePrototxtFast("layer { name: \"x\"\n", &param));
+  EXPECT_FALSE(ParsePrototxtFast("name: \"x\n", &param));
+}
+
+}  // namespace caffe
@@ -395,6 +395,27 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulliTimesBernoulli) {
   EXPECT_NEAR(true_mean, sample_p, bound);
 }
 
+TYPED_TEST(RandomNumberGeneratorTest, TestRngReproducibleFromSeed) {
+  // The same seed must reproduce the same fill exactly; a reseeded
+  // second fill must not repeat the first one's continuation.
+  TypeParam* gaussian_data =
+      static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  TypeParam* gaussian_data_2 =
+      static_cast<TypeParam*>(this->data_2_->mutable_cpu_data());
+  this->RngGaussianFill(0, 1, gaussian_data);
+  this->RngGaussianFill(0, 1, gaussian_data_2);
+  int num_equal = 0;
+  for (int i = 0; i < this->sample_size_; ++i) {
+    num_equal += gaussian_data[i] == gaussian_data_2[i];
+  }
+  EXPECT_LT(num_equal, this->sample_size_);
+  Caffe::set_random_seed(this->seed_);
+  this->RngGaussianFill(0, 1, gaussian_data_2);
+  for (int i = 0; i < this->sample_size_; ++i) {
+    EXPECT_EQ(gaussian_data[i], gaussian_data_2[i]);
+  }
+}
+
 #ifndef CPU_ONLY
 
 TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianGPU) {
@@ -0,0 +1,98 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/shared_weights.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SharedWeightsTest : public ::testing::Test {
+ protected:
+  SharedWeightsTest()
+      : name_("/caffe_test_shared_weights"),
+        blob_a_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_b_(new Blob<Dtype>(7, 1, 1, 1)) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_a_);
+    filler.Fill(blob_b_);
+    params_.push_back(blob_a_);
+    params_.push_back(blob_b_);
+  }
+  virtual ~SharedWeightsTest() {
+    delete blob_a_;
+    delete blob_b_;
+  }
+
+  string name_;
+  Blob<Dtype>* const blob_a_;
+  Blob<Dtype>* const blob_b_;
+  vector<Blob<Dtype>*> params_;
+};
+
+TYPED_TEST_CASE(SharedWeightsTest, TestDtypes);
+
+TYPED_TEST(SharedWeightsTest, TestPublishAndOpen) {
+  typedef TypeParam Dtype;
+  const size_t count = this->blob_a_->count() + this->blob_b_->count();
+  shared_ptr<SharedWeights<Dtype> > publisher =
+      SharedWeights<Dtype>::Create(this->name_, count);
+  publisher->Publish(this->params_);
+  shared_ptr<SharedWeights<Dtype> > reader =
+      SharedWeights<Dtype>::Open(this->name_);
+  ASSERT_EQ(count, reader->count());
+  const Dtype* data = reader->data();
+  for (int i = 0; i < this->blob_a_->count(); ++i) {
+    EXPECT_EQ(this->blob_a_->cpu_data()[i], data[i]);
+  }
+  data += this->blob_a_->count();
+  for (int i = 0; i < this->blob_b_->count(); ++i) {
+    EXPECT_EQ(this->blob_b_->cpu_data()[i], data[i]);
+  }
+}
+
+TYPED_TEST(SharedWeightsTest, TestGenerationAdvances) {
+  typedef TypeParam Dtype;
+  const size_t count = this->blob_a_->count() + this->blob_b_->count();
+  shared_ptr<SharedWeights<Dtype> > publisher =
+      SharedWeights<Dtype>::Create(this->name_, count);
+  shared_ptr<SharedWeights<Dtype> > reader =
+      SharedWeights<Dtype>::Open(this->name_);
+  EXPECT_EQ(0, reader->generation());
+  publisher->Publish(this->params_);
+  // Even again: the payload is stable, one publish behind us.
+  EXPECT_EQ(2, reader->generation());
+  this->blob_b_->mutable_cpu_data()[0] += Dtype(1);
+  publisher->Publish(this->params_);
+  EXPECT_EQ(4, reader->generation());
+  EXPECT_EQ(this->blob_b_->cpu_data()[0],
+            reader->data()[this->blob_a_->count()]);
+}
+
+TYPED_TEST(SharedWeightsTest, TestFileBackedExclusiveCreate) {
+  typedef TypeParam Dtype;
+  string path;
+  MakeTempFilename(&path);
+  const size_t count = this->blob_a_->count() + this->blob_b_->count();
+  shared_ptr<SharedWeights<Dtype> > first =
+      SharedWeights<Dtype>::CreateExclusive(path, count);
+  ASSERT_TRUE(first.get() != NULL);
+  // The loser of the creation race gets an empty pointer back.
+  EXPECT_TRUE(SharedWeights<Dtype>::CreateExclusive(path, count).get()
+      == NULL);
+  first->Publish(this->params_);
+  shared_ptr<SharedWeights<Dtype> > reader =
+      SharedWeights<Dtype>::OpenWhenReady(path);
+  ASSERT_EQ(count, reader->count());
+  EXPECT_EQ(this->blob_a_->cpu_data()[0], reader->data()[0]);
+}
+
+}  // namespace caffe
@@ -74,6 +74,42 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardBlocked) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A spatial extent large enough to select the blocked CPU engine,
+  // including a partial tail tile.
+  Blob<Dtype> bottom(2, 5, 12, 9);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+  for (int i = 0; i < bottom.num(); ++i) {
+    for (int k = 0; k < bottom.height(); ++k) {
+      for (int l = 0; l < bottom.width(); ++l) {
+        Dtype sum = 0;
+        for (int j = 0; j < this->blob_top_->channels(); ++j) {
+          sum += this->blob_top_->data_at(i, j, k, l);
+        }
+        EXPECT_GE(sum, 0.999);
+        EXPECT_LE(sum, 1.001);
+        Dtype scale = 0;
+        for (int j = 0; j < bottom.channels(); ++j) {
+          scale += exp(bottom.data_at(i, j, k, l));
+        }
+        for (int j = 0; j < bottom.channels(); ++j) {
+          EXPECT_NEAR(this->blob_top_->data_at(i, j, k, l),
+              exp(bottom.data_at(i, j, k, l)) / scale, 1e-4)
+              << "debug: " << i << " " << j;
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(SoftmaxLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -61,6 +61,27 @@ TYPED_TEST(SoftmaxWithLossLayerTest, TestGradient) {
       this->blob_top_vec_, 0);
 }
 
+TYPED_TEST(SoftmaxWithLossLayerTest, TestFusedMatchesReference) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A single top selects the fused log-sum-exp engine; a second top forces
+  // the reference path through the internal softmax. The losses must agree.
+  LayerParameter layer_param;
+  layer_param.mutable_loss_param()->set_normalize(false);
+  scoped_ptr<SoftmaxWithLossLayer<Dtype> > layer(
+      new SoftmaxWithLossLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype fused_loss = this->blob_top_loss_->cpu_data()[0];
+  Blob<Dtype> top_prob;
+  this->blob_top_vec_.push_back(&top_prob);
+  layer.reset(new SoftmaxWithLossLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->blob_top_vec_.pop_back();
+  EXPECT_NEAR(fused_loss, this->blob_top_loss_->cpu_data()[0],
+      1e-4 * fabs(fused_loss));
+}
+
 TYPED_TEST(SoftmaxWithLossLayerTest, TestForwardIgnoreLabel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -22,6 +22,25 @@ TEST_F(SyncedMemoryTest, TestInitialization) {
   delete p_mem;
 }
 
+TEST_F(SyncedMemoryTest, TestView) {
+  shared_ptr<SyncedMemory> parent(
+      new SyncedMemory(10 * sizeof(float)));
+  SyncedMemory view(parent, 4 * sizeof(float), 6 * sizeof(float));
+  EXPECT_TRUE(view.is_view());
+  EXPECT_TRUE(view.is_view_of(parent.get(), 4 * sizeof(float)));
+  EXPECT_FALSE(view.is_view_of(parent.get(), 0));
+  EXPECT_EQ(view.size(), 6 * sizeof(float));
+  // Accesses delegate to the parent at the byte offset, and the view
+  // shares the parent's head state both ways.
+  float* parent_data = static_cast<float*>(parent->mutable_cpu_data());
+  EXPECT_EQ(view.cpu_data(), parent_data + 4);
+  EXPECT_EQ(view.head(), SyncedMemory::HEAD_AT_CPU);
+  parent_data[5] = 17;
+  EXPECT_EQ(static_cast<const float*>(view.cpu_data())[1], 17);
+  static_cast<float*>(view.mutable_cpu_data())[0] = 3;
+  EXPECT_EQ(parent_data[4], 3);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestAllocationCPUGPU) {
@@ -32,8 +51,66 @@ TEST_F(SyncedMemoryTest, TestAllocationCPUGPU) {
   EXPECT_TRUE(mem.mutable_gpu_data());
 }
 
+TEST_F(SyncedMemoryTest, TestTraceTransitions) {
+  SyncedMemoryTrace::Enable(16);
+  SyncedMemoryTrace::set_context("test");
+  SyncedMemory mem(10);
+  mem.mutable_cpu_data();
+  mem.gpu_data();            // H2D copy
+  mem.mutable_cpu_data();    // invalidates the device copy
+  mem.gpu_data();            // H2D copy again
+  const vector<SyncedMemoryTrace::Record> records =
+      SyncedMemoryTrace::records();
+  SyncedMemoryTrace::Disable();
+  ASSERT_EQ(records.size(), 3);
+  EXPECT_EQ(records[0].from, SyncedMemory::HEAD_AT_CPU);
+  EXPECT_EQ(records[0].to, SyncedMemory::SYNCED);
+  EXPECT_EQ(records[1].from, SyncedMemory::SYNCED);
+  EXPECT_EQ(records[1].to, SyncedMemory::HEAD_AT_CPU);
+  EXPECT_EQ(records[2].from, SyncedMemory::HEAD_AT_CPU);
+  EXPECT_EQ(records[2].to, SyncedMemory::SYNCED);
+  for (int i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i].mem, &mem);
+    EXPECT_EQ(records[i].context, "test");
+    EXPECT_EQ(records[i].size, 10);
+    EXPECT_GE(records[i].ms, 0);
+  }
+}
+
+TEST_F(SyncedMemoryTest, TestGPUAllocationCached) {
+  const void* first_ptr;
+  {
+    SyncedMemory mem(4096);
+    first_ptr = mem.gpu_data();
+  }
+  // Destruction parks the block in the allocator cache rather than
+  // freeing it, so an equal-sized request gets the same block back.
+  EXPECT_GE(Caffe::gpu_allocator_bytes_cached(), 4096);
+  SyncedMemory mem(4096);
+  EXPECT_EQ(mem.gpu_data(), first_ptr);
+  EXPECT_GT(Caffe::gpu_allocator_hit_rate(), 0);
+  Caffe::ReleaseCachedGPUMemory();
+  EXPECT_EQ(Caffe::gpu_allocator_bytes_cached(), 0);
+}
+
 #endif
 
+TEST_F(SyncedMemoryTest, TestLargeAllocationCPU) {
+  // Large enough (and deliberately not a multiple of 2MB) to take the
+  // huge-page mmap path on Linux; semantics must match plain malloc.
+  const size_t size = 5 * kCaffeHugePageSize + 123;
+  SyncedMemory mem(size);
+  char* data = static_cast<char*>(mem.mutable_cpu_data());
+  ASSERT_TRUE(data);
+  for (size_t i = 0; i < size; i += kCaffeHugePageSize / 2) {
+    EXPECT_EQ(data[i], 0);
+    data[i] = i % 127;
+  }
+  EXPECT_EQ(data[size - 1], 0);
+  data[size - 1] = 42;
+  EXPECT_EQ(static_cast<const char*>(mem.cpu_data())[size - 1], 42);
+}
+
 TEST_F(SyncedMemoryTest, TestAllocationCPU) {
   SyncedMemory mem(10);
   EXPECT_TRUE(mem.cpu_data());
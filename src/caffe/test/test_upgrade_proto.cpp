@@ -2926,6 +2926,24 @@ TEST_F(NetUpgradeTest, TestUpgradeV1LayerType) {
   }
 }
 
+TEST_F(NetUpgradeTest, TestSchemaVersionStamp) {
+  NetParameter net_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "name: 'current' "
+      "layer { name: 'x' type: 'Input' top: 'x' "
+      "  input_param { shape { dim: 1 } } } ", &net_param));
+  EXPECT_FALSE(NetNeedsUpgrade(net_param));
+  EXPECT_TRUE(UpgradeNetAsNeeded("<test net>", &net_param));
+  EXPECT_EQ(kCurrentNetSchemaVersion, net_param.schema_version());
+  // A stamped net skips the deprecation scans entirely, even if it
+  // carries fields the scans would otherwise flag.
+  net_param.add_input("data");
+  net_param.add_input_dim(1);
+  EXPECT_FALSE(NetNeedsUpgrade(net_param));
+  EXPECT_TRUE(UpgradeNetAsNeeded("<test net>", &net_param));
+  EXPECT_EQ(1, net_param.input_size());  // untouched by the upgrade pass
+}
+
 class SolverTypeUpgradeTest : public ::testing::Test {
  protected:
   void RunSolverTypeUpgradeTest(
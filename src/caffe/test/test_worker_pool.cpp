@@ -0,0 +1,70 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "caffe/util/worker_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class WorkerPoolTest : public ::testing::Test {};
+
+namespace {
+
+void SetFlag(bool* flag) { *flag = true; }
+
+void LoopUntilInterrupted(bool* exited) {
+  while (!boost::this_thread::interruption_requested()) {
+    boost::this_thread::yield();
+  }
+  *exited = true;
+}
+
+}  // namespace
+
+TEST_F(WorkerPoolTest, TestSubmitAndJoin) {
+  const int kTasks = 8;
+  bool flags[kTasks];
+  std::vector<shared_ptr<WorkerHandle> > handles;
+  for (int i = 0; i < kTasks; ++i) {
+    flags[i] = false;
+    handles.push_back(WorkerPool::Submit(boost::bind(&SetFlag, &flags[i])));
+  }
+  for (int i = 0; i < kTasks; ++i) {
+    handles[i]->Join();
+    EXPECT_TRUE(handles[i]->done());
+    EXPECT_TRUE(flags[i]);
+  }
+}
+
+TEST_F(WorkerPoolTest, TestInterrupt) {
+  bool exited = false;
+  shared_ptr<WorkerHandle> handle =
+      WorkerPool::Submit(boost::bind(&LoopUntilInterrupted, &exited));
+  EXPECT_FALSE(handle->done());
+  handle->Interrupt();
+  handle->Join();
+  EXPECT_TRUE(exited);
+}
+
+TEST_F(WorkerPoolTest, TestWorkerReuse) {
+  // A task submitted after the previous one finished must not see its
+  // predecessor's late interruption.
+  bool exited = false;
+  shared_ptr<WorkerHandle> first =
+      WorkerPool::Submit(boost::bind(&LoopUntilInterrupted, &exited));
+  first->Interrupt();
+  first->Join();
+  bool flag = false;
+  shared_ptr<WorkerHandle> second =
+      WorkerPool::Submit(boost::bind(&SetFlag, &flag));
+  second->Join();
+  EXPECT_TRUE(flag);
+}
+
+}  // namespace caffe
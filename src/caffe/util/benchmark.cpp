@@ -1,5 +1,14 @@
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <cstring>
+
 #include "caffe/common.hpp"
 #include "caffe/util/benchmark.hpp"
 
@@ -165,4 +174,77 @@ float CPUTimer::MicroSeconds() {
   return this->elapsed_microseconds_;
 }
 
+#ifdef __linux__
+namespace {
+
+// Opens one perf_event counter on the calling thread; counters after
+// the first join the leader's group so they start and stop together.
+int open_perf_counter(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));  // NOLINT(caffe/alt_fn)
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group_fd < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+uint64_t read_perf_counter(int fd) {
+  uint64_t value = 0;
+  if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) {
+    value = 0;
+  }
+  return value;
+}
+
+}  // namespace
+#endif
+
+PerfCounters::PerfCounters()
+    : available_(false), running_(false),
+      cycles_(0), llc_misses_(0), stalled_backend_(0) {
+  for (int i = 0; i < 3; ++i) { fds_[i] = -1; }
+#ifdef __linux__
+  fds_[0] = open_perf_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (fds_[0] < 0) {
+    LOG(WARNING) << "perf_event counters unavailable "
+        << "(check kernel.perf_event_paranoid)";
+    return;
+  }
+  fds_[1] = open_perf_counter(PERF_COUNT_HW_CACHE_MISSES, fds_[0]);
+  fds_[2] = open_perf_counter(PERF_COUNT_HW_STALLED_CYCLES_BACKEND, fds_[0]);
+  available_ = true;
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int i = 0; i < 3; ++i) {
+    if (fds_[i] >= 0) { close(fds_[i]); }
+  }
+#endif
+}
+
+void PerfCounters::Start() {
+  if (!available_ || running_) { return; }
+#ifdef __linux__
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  running_ = true;
+}
+
+void PerfCounters::Stop() {
+  if (!available_ || !running_) { return; }
+#ifdef __linux__
+  ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  cycles_ = read_perf_counter(fds_[0]);
+  llc_misses_ = read_perf_counter(fds_[1]);
+  stalled_backend_ = read_perf_counter(fds_[2]);
+#endif
+  running_ = false;
+}
+
 }  // namespace caffe
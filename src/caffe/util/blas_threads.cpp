@@ -0,0 +1,61 @@
+#include "caffe/util/blas_threads.hpp"
+
+#ifdef USE_MKL
+#include <mkl.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace caffe {
+
+#ifndef USE_MKL
+namespace {
+
+typedef int (*GetThreadsFn)(void);
+typedef void (*SetThreadsFn)(int);
+
+// OpenBLAS's runtime thread controls, resolved once from whatever BLAS
+// the process ended up with (linked in, or dlopened with global scope
+// by set_blas_backend). ATLAS and the reference BLAS lack them, which
+// leaves the pointers NULL and every scope a no-op.
+GetThreadsFn openblas_get_threads() {
+  static GetThreadsFn fn = reinterpret_cast<GetThreadsFn>(
+      dlsym(RTLD_DEFAULT, "openblas_get_num_threads"));
+  return fn;
+}
+
+SetThreadsFn openblas_set_threads() {
+  static SetThreadsFn fn = reinterpret_cast<SetThreadsFn>(
+      dlsym(RTLD_DEFAULT, "openblas_set_num_threads"));
+  return fn;
+}
+
+}  // namespace
+#endif
+
+BlasThreadScope::BlasThreadScope(const int num_threads)
+    : previous_(0), active_(false) {
+  if (num_threads < 1) { return; }
+#ifdef USE_MKL
+  previous_ = mkl_set_num_threads_local(num_threads);
+  active_ = true;
+#else
+  if (openblas_get_threads() && openblas_set_threads()) {
+    previous_ = openblas_get_threads()();
+    if (previous_ == num_threads) { return; }
+    openblas_set_threads()(num_threads);
+    active_ = true;
+  }
+#endif
+}
+
+BlasThreadScope::~BlasThreadScope() {
+  if (!active_) { return; }
+#ifdef USE_MKL
+  mkl_set_num_threads_local(previous_);
+#else
+  openblas_set_threads()(previous_);
+#endif
+}
+
+}  // namespace caffe
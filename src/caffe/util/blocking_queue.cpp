@@ -1,3 +1,4 @@
+#include <boost/atomic.hpp>
 #include <boost/thread.hpp>
 #include <string>
 
@@ -15,13 +16,134 @@ class BlockingQueue<T>::sync {
   boost::condition_variable condition_;
 };
 
+// Bounded multi-producer/multi-consumer ring buffer (Vyukov-style): each
+// slot carries a sequence number that tells producers and consumers whether
+// the slot is theirs, so the hot path is a single compare-and-swap with no
+// mutex. Blocking semantics are layered on top by spinning, then yielding.
+template<typename T>
+class BlockingQueue<T>::Ring {
+ public:
+  explicit Ring(size_t capacity) {
+    size_ = 1;
+    while (size_ < capacity) {
+      size_ <<= 1;
+    }
+    mask_ = size_ - 1;
+    slots_ = new Slot[size_];
+    for (size_t i = 0; i < size_; ++i) {
+      slots_[i].sequence.store(i, boost::memory_order_relaxed);
+    }
+    head_.store(0, boost::memory_order_relaxed);
+    tail_.store(0, boost::memory_order_relaxed);
+  }
+
+  ~Ring() {
+    delete[] slots_;
+  }
+
+  bool try_push(const T& t) {
+    size_t pos = tail_.load(boost::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[pos & mask_];
+      const size_t seq = slot.sequence.load(boost::memory_order_acquire);
+      const ptrdiff_t diff = static_cast<ptrdiff_t>(seq)
+          - static_cast<ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                boost::memory_order_relaxed)) {
+          slot.value = t;
+          slot.sequence.store(pos + 1, boost::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = tail_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T* t) {
+    size_t pos = head_.load(boost::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[pos & mask_];
+      const size_t seq = slot.sequence.load(boost::memory_order_acquire);
+      const ptrdiff_t diff = static_cast<ptrdiff_t>(seq)
+          - static_cast<ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                boost::memory_order_relaxed)) {
+          *t = slot.value;
+          slot.sequence.store(pos + size_, boost::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = head_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Single-consumer only: another consumer may take the slot between the
+  // sequence check and the read.
+  bool try_peek(T* t) {
+    const size_t pos = head_.load(boost::memory_order_acquire);
+    Slot& slot = slots_[pos & mask_];
+    if (slot.sequence.load(boost::memory_order_acquire) != pos + 1) {
+      return false;
+    }
+    *t = slot.value;
+    return true;
+  }
+
+  size_t size() const {
+    const size_t tail = tail_.load(boost::memory_order_acquire);
+    const size_t head = head_.load(boost::memory_order_acquire);
+    return tail >= head ? tail - head : 0;
+  }
+
+ private:
+  struct Slot {
+    boost::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Spins a few rounds before sleeping; also an interruption point so
+  // blocked threads exit cleanly on shutdown.
+  friend class BlockingQueue<T>;
+  static void wait_round(int round) {
+    boost::this_thread::interruption_point();
+    if (round < 1024) {
+      boost::this_thread::yield();
+    } else {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+  }
+
+  size_t size_, mask_;
+  Slot* slots_;
+  boost::atomic<size_t> head_, tail_;
+};
+
 template<typename T>
 BlockingQueue<T>::BlockingQueue()
     : sync_(new sync()) {
 }
 
+template<typename T>
+BlockingQueue<T>::BlockingQueue(size_t capacity)
+    : ring_(new Ring(capacity)) {
+}
+
 template<typename T>
 void BlockingQueue<T>::push(const T& t) {
+  if (ring_) {
+    for (int round = 0; !ring_->try_push(t); ++round) {
+      Ring::wait_round(round);
+    }
+    return;
+  }
   boost::mutex::scoped_lock lock(sync_->mutex_);
   queue_.push(t);
   lock.unlock();
@@ -30,6 +152,9 @@ void BlockingQueue<T>::push(const T& t) {
 
 template<typename T>
 bool BlockingQueue<T>::try_pop(T* t) {
+  if (ring_) {
+    return ring_->try_pop(t);
+  }
   boost::mutex::scoped_lock lock(sync_->mutex_);
 
   if (queue_.empty()) {
@@ -43,6 +168,16 @@ bool BlockingQueue<T>::try_pop(T* t) {
 
 template<typename T>
 T BlockingQueue<T>::pop(const string& log_on_wait) {
+  if (ring_) {
+    T t;
+    for (int round = 0; !ring_->try_pop(&t); ++round) {
+      if (!log_on_wait.empty()) {
+        LOG_EVERY_N(INFO, 1000)<< log_on_wait;
+      }
+      Ring::wait_round(round);
+    }
+    return t;
+  }
   boost::mutex::scoped_lock lock(sync_->mutex_);
 
   while (queue_.empty()) {
@@ -59,6 +194,9 @@ T BlockingQueue<T>::pop(const string& log_on_wait) {
 
 template<typename T>
 bool BlockingQueue<T>::try_peek(T* t) {
+  if (ring_) {
+    return ring_->try_peek(t);
+  }
   boost::mutex::scoped_lock lock(sync_->mutex_);
 
   if (queue_.empty()) {
@@ -71,6 +209,13 @@ bool BlockingQueue<T>::try_peek(T* t) {
 
 template<typename T>
 T BlockingQueue<T>::peek() {
+  if (ring_) {
+    T t;
+    for (int round = 0; !ring_->try_peek(&t); ++round) {
+      Ring::wait_round(round);
+    }
+    return t;
+  }
   boost::mutex::scoped_lock lock(sync_->mutex_);
 
   while (queue_.empty()) {
@@ -82,6 +227,9 @@ T BlockingQueue<T>::peek() {
 
 template<typename T>
 size_t BlockingQueue<T>::size() const {
+  if (ring_) {
+    return ring_->size();
+  }
   boost::mutex::scoped_lock lock(sync_->mutex_);
   return queue_.size();
 }
@@ -0,0 +1,124 @@
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+
+#include "caffe/util/chrome_trace.hpp"
+
+namespace caffe {
+
+namespace {
+
+struct Span {
+  const char* category;
+  string name;
+  size_t tid;
+  double start_us;
+  double dur_us;
+};
+
+// All capture state behind one mutex; tracing sites only take it while
+// enabled, the steady-state cost is the enabled check.
+struct TraceState {
+  TraceState() : enabled(false) {}
+  volatile bool enabled;
+  boost::mutex mutex;
+  string filename;
+  vector<Span> spans;
+  map<size_t, string> thread_names;
+};
+
+TraceState& state() {
+  static TraceState instance;
+  return instance;
+}
+
+size_t current_tid() {
+  return reinterpret_cast<size_t>(pthread_self());
+}
+
+}  // namespace
+
+bool ChromeTrace::enabled() {
+  return state().enabled;
+}
+
+double ChromeTrace::NowUs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+void ChromeTrace::Start(const string& filename) {
+  TraceState& trace = state();
+  boost::mutex::scoped_lock lock(trace.mutex);
+  if (trace.enabled) { return; }
+  trace.filename = filename;
+  trace.spans.clear();
+  trace.enabled = true;
+  LOG(INFO) << "Trace capture started, writing to " << filename
+            << " on the next toggle";
+}
+
+void ChromeTrace::Stop() {
+  TraceState& trace = state();
+  boost::mutex::scoped_lock lock(trace.mutex);
+  if (!trace.enabled) { return; }
+  trace.enabled = false;
+  std::ofstream file(trace.filename.c_str());
+  if (!file.good()) {
+    LOG(ERROR) << "Failed to open trace file " << trace.filename;
+    return;
+  }
+  file << "{\"traceEvents\": [\n";
+  bool first = true;
+  for (map<size_t, string>::const_iterator it = trace.thread_names.begin();
+       it != trace.thread_names.end(); ++it) {
+    if (!first) { file << ",\n"; }
+    first = false;
+    file << "{\"ph\": \"M\", \"pid\": 0, \"tid\": " << it->first
+         << ", \"name\": \"thread_name\", \"args\": {\"name\": \""
+         << it->second << "\"}}";
+  }
+  for (int i = 0; i < trace.spans.size(); ++i) {
+    const Span& span = trace.spans[i];
+    if (!first) { file << ",\n"; }
+    first = false;
+    file << "{\"ph\": \"X\", \"pid\": 0, \"tid\": " << span.tid
+         << ", \"cat\": \"" << span.category
+         << "\", \"name\": \"" << span.name
+         << "\", \"ts\": " << std::fixed << span.start_us
+         << ", \"dur\": " << span.dur_us << "}";
+  }
+  file << "\n]}\n";
+  LOG(INFO) << "Wrote " << trace.spans.size() << " trace spans to "
+            << trace.filename;
+  trace.spans.clear();
+}
+
+void ChromeTrace::AddSpan(const char* category, const string& name,
+    double start_us, double dur_us) {
+  TraceState& trace = state();
+  boost::mutex::scoped_lock lock(trace.mutex);
+  if (!trace.enabled) { return; }
+  Span span;
+  span.category = category;
+  span.name = name;
+  span.tid = current_tid();
+  span.start_us = start_us;
+  span.dur_us = dur_us;
+  trace.spans.push_back(span);
+}
+
+void ChromeTrace::SetThreadName(const string& name) {
+  TraceState& trace = state();
+  boost::mutex::scoped_lock lock(trace.mutex);
+  trace.thread_names[current_tid()] = name;
+}
+
+}  // namespace caffe
@@ -0,0 +1,83 @@
+#include "caffe/util/datum_view.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Datum field numbers, see src/caffe/proto/caffe.proto.
+const int kDatumChannels = 1;
+const int kDatumHeight = 2;
+const int kDatumWidth = 3;
+const int kDatumData = 4;
+const int kDatumLabel = 5;
+const int kDatumFloatData = 6;
+const int kDatumEncoded = 7;
+
+bool ReadVarint(const uint8_t** p, const uint8_t* end, uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*p >= end) { return false; }
+    const uint8_t byte = *(*p)++;
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+bool DatumView::ParseFrom(const char* buffer, size_t size) {
+  channels_ = height_ = width_ = label_ = 0;
+  encoded_ = false;
+  data_ = NULL;
+  data_size_ = 0;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer);
+  const uint8_t* end = p + size;
+  while (p < end) {
+    uint64_t tag, value;
+    if (!ReadVarint(&p, end, &tag)) { return false; }
+    const int field = static_cast<int>(tag >> 3);
+    switch (tag & 7) {
+    case 0:  // varint
+      if (!ReadVarint(&p, end, &value)) { return false; }
+      switch (field) {
+      case kDatumChannels: channels_ = static_cast<int>(value); break;
+      case kDatumHeight: height_ = static_cast<int>(value); break;
+      case kDatumWidth: width_ = static_cast<int>(value); break;
+      case kDatumLabel: label_ = static_cast<int32_t>(value); break;
+      case kDatumEncoded: encoded_ = (value != 0); break;
+      default: break;  // unknown varint field, skipped
+      }
+      break;
+    case 2:  // length-delimited
+      if (!ReadVarint(&p, end, &value) || value > size_t(end - p)) {
+        return false;
+      }
+      if (field == kDatumData) {
+        data_ = reinterpret_cast<const char*>(p);
+        data_size_ = value;
+      } else if (field == kDatumFloatData) {
+        return false;  // packed float_data, caller must fully parse
+      }
+      p += value;
+      break;
+    case 5:  // 32-bit, only float_data in Datum
+      if (field == kDatumFloatData) { return false; }
+      if (end - p < 4) { return false; }
+      p += 4;
+      break;
+    case 1:  // 64-bit, no such Datum field but skip to stay future-proof
+      if (end - p < 8) { return false; }
+      p += 8;
+      break;
+    default:
+      return false;
+    }
+  }
+  return data_ != NULL;
+}
+
+}  // namespace caffe
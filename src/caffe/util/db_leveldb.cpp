@@ -8,7 +8,7 @@ namespace caffe { namespace db {
 void LevelDB::Open(const string& source, Mode mode) {
   leveldb::Options options;
   options.block_size = 65536;
-  options.write_buffer_size = 268435456;
+  options.write_buffer_size = write_buffer_size_;
   options.max_open_files = 100;
   options.error_if_exists = mode == NEW;
   options.create_if_missing = mode != READ;
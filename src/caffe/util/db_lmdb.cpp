@@ -1,10 +1,16 @@
 #ifdef USE_LMDB
 #include "caffe/util/db_lmdb.hpp"
 
+#include <stdint.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <string>
 
+#include "caffe/util/math_functions.hpp"
+
 namespace caffe { namespace db {
 
 const size_t LMDB_MAP_SIZE = 1099511627776;  // 1 TB
@@ -38,6 +44,76 @@ void LMDB::Open(const string& source, Mode mode) {
   LOG(INFO) << "Opened lmdb " << source;
 }
 
+bool LMDBCursor::SeekToKey(const string& key) {
+  mdb_key_.mv_data = const_cast<char*>(key.data());
+  mdb_key_.mv_size = key.size();
+  int mdb_status = mdb_cursor_get(mdb_cursor_, &mdb_key_, &mdb_value_,
+      MDB_SET_RANGE);
+  if (mdb_status == MDB_NOTFOUND) {
+    valid_ = false;
+    return false;
+  }
+  MDB_CHECK(mdb_status);
+  valid_ = true;
+  MaybeReadahead();
+  return true;
+}
+
+bool LMDBCursor::SeekToRandom() {
+  // Draw a key uniformly from the lexicographic range spanned by the
+  // database and seek to the first entry at or after it. This is uniform
+  // over the key space rather than over entries, which is adequate for
+  // the fixed-width zero-padded keys convert_imageset produces.
+  MDB_val first_key, last_key, value;
+  int mdb_status = mdb_cursor_get(mdb_cursor_, &first_key, &value, MDB_FIRST);
+  if (mdb_status == MDB_NOTFOUND) {
+    valid_ = false;
+    return false;
+  }
+  MDB_CHECK(mdb_status);
+  const string lo(static_cast<const char*>(first_key.mv_data),
+      first_key.mv_size);
+  MDB_CHECK(mdb_cursor_get(mdb_cursor_, &last_key, &value, MDB_LAST));
+  const string hi(static_cast<const char*>(last_key.mv_data),
+      last_key.mv_size);
+  string key;
+  bool at_lo = true, at_hi = true;
+  const size_t max_len = std::max(lo.size(), hi.size());
+  for (size_t i = 0; i < max_len && (at_lo || at_hi); ++i) {
+    const int low = at_lo && i < lo.size()
+        ? static_cast<unsigned char>(lo[i]) : 0;
+    const int high = at_hi && i < hi.size()
+        ? static_cast<unsigned char>(hi[i]) : 255;
+    const int byte = low + caffe_rng_rand() % (high - low + 1);
+    key.push_back(static_cast<char>(byte));
+    at_lo = at_lo && byte == low;
+    at_hi = at_hi && byte == high;
+  }
+  if (SeekToKey(key)) {
+    return true;
+  }
+  // Drawn past the last key (possible with variable-length keys); wrap.
+  SeekToFirst();
+  return valid_;
+}
+
+void LMDBCursor::MaybeReadahead() {
+  if (readahead_window_ == 0) {
+    return;
+  }
+  const char* ptr = static_cast<const char*>(mdb_value_.mv_data);
+  if (readahead_watermark_ != NULL
+      && ptr + mdb_value_.mv_size <= readahead_watermark_
+      && ptr + readahead_window_ >= readahead_watermark_) {
+    return;  // still inside the window advised last time
+  }
+  static const uintptr_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+  const uintptr_t start = reinterpret_cast<uintptr_t>(ptr) & ~page_mask;
+  madvise(reinterpret_cast<void*>(start), readahead_window_, MADV_WILLNEED);
+  readahead_watermark_ = reinterpret_cast<const char*>(start)
+      + readahead_window_;
+}
+
 LMDBCursor* LMDB::NewCursor() {
   MDB_txn* mdb_txn;
   MDB_cursor* mdb_cursor;
@@ -55,12 +131,18 @@ LMDBTransaction* LMDB::NewTransaction() {
 }
 
 void LMDBTransaction::Put(const string& key, const string& value) {
+  Put(key.data(), key.size(), value.data(), value.size());
+}
+
+void LMDBTransaction::Put(const char* key, size_t key_size,
+    const char* value, size_t value_size) {
   MDB_val mdb_key, mdb_value;
-  mdb_key.mv_data = const_cast<char*>(key.data());
-  mdb_key.mv_size = key.size();
-  mdb_value.mv_data = const_cast<char*>(value.data());
-  mdb_value.mv_size = value.size();
-  MDB_CHECK(mdb_put(mdb_txn_, *mdb_dbi_, &mdb_key, &mdb_value, 0));
+  mdb_key.mv_data = const_cast<char*>(key);
+  mdb_key.mv_size = key_size;
+  mdb_value.mv_data = const_cast<char*>(value);
+  mdb_value.mv_size = value_size;
+  MDB_CHECK(mdb_put(mdb_txn_, *mdb_dbi_, &mdb_key, &mdb_value,
+      append_ ? MDB_APPEND : 0));
 }
 
 }  // namespace db
@@ -0,0 +1,128 @@
+#include <boost/thread.hpp>
+
+#include "caffe/common.hpp"
+#include "caffe/util/dropout_mask_pool.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+
+namespace {
+
+// Double-buffered per-thread pool state; see the header for the
+// protocol. All methods run on the owning thread, so no locking.
+class PoolImpl {
+ public:
+  PoolImpl()
+      : capacity_(0), offset_(0), front_(0),
+        seed_generation_(Caffe::random_seed_generation()) {
+    CUDA_CHECK(cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking));
+    CUDA_CHECK(cudaEventCreateWithFlags(&consumed_, cudaEventDisableTiming));
+    for (int i = 0; i < 2; ++i) {
+      buf_[i] = NULL;
+      CUDA_CHECK(cudaEventCreateWithFlags(&ready_[i],
+          cudaEventDisableTiming));
+    }
+  }
+
+  ~PoolImpl() {
+    cudaDeviceSynchronize();
+    for (int i = 0; i < 2; ++i) {
+      if (buf_[i]) { cudaFree(buf_[i]); }
+      cudaEventDestroy(ready_[i]);
+    }
+    cudaEventDestroy(consumed_);
+    cudaStreamDestroy(stream_);
+  }
+
+  const unsigned int* Acquire(const int count) {
+    // A reseed (Caffe::set_random_seed) invalidates what was
+    // pipelined ahead; regenerate so reseeded runs reproduce exactly,
+    // which the gradient checker relies on for dropout.
+    if (seed_generation_ != Caffe::random_seed_generation()) {
+      seed_generation_ = Caffe::random_seed_generation();
+      if (capacity_ > 0) {
+        CUDA_CHECK(cudaDeviceSynchronize());
+        front_ = 0;
+        Generate(0);
+        Generate(1);
+        CUDA_CHECK(cudaStreamWaitEvent(cudaStreamDefault, ready_[0], 0));
+        offset_ = 0;
+      }
+    }
+    if (offset_ + count > capacity_) { NewCycle(count); }
+    const unsigned int* mask = buf_[front_] + offset_;
+    offset_ += count;
+    return mask;
+  }
+
+ private:
+  // One batched generation of a whole buffer on the side stream, using
+  // the thread's curand generator; the compute stream gates on the
+  // recorded event before reading the buffer.
+  void Generate(const int buf) {
+    curandGenerator_t gen = Caffe::curand_generator();
+    CURAND_CHECK(curandSetStream(gen, stream_));
+    CURAND_CHECK(curandGenerate(gen, buf_[buf], capacity_));
+    CUDA_CHECK(cudaEventRecord(ready_[buf], stream_));
+#ifdef USE_PER_THREAD_STREAMS
+    CURAND_CHECK(curandSetStream(gen, cudaStreamPerThread));
+#else
+    CURAND_CHECK(curandSetStream(gen, cudaStreamDefault));
+#endif
+  }
+
+  void NewCycle(const int count) {
+    const size_t needed = offset_ + count;
+    if (needed > capacity_) {
+      // Still learning the per-iteration total: regrow both buffers
+      // and refill them. Quiesce first -- the previous iteration may
+      // still be reading the old front buffer.
+      CUDA_CHECK(cudaDeviceSynchronize());
+      for (int i = 0; i < 2; ++i) {
+        if (buf_[i]) { CUDA_CHECK(cudaFree(buf_[i])); }
+      }
+      capacity_ = needed;
+      for (int i = 0; i < 2; ++i) {
+        CUDA_CHECK(cudaMalloc(&buf_[i],
+            capacity_ * sizeof(unsigned int)));
+      }
+      front_ = 0;
+      Generate(0);
+      Generate(1);
+    } else {
+      // Steady state: rotate, then regenerate the retired buffer once
+      // the compute stream has issued all of its reads of it (both
+      // this iteration's forwards and the previous backward precede
+      // this point in issue order).
+      front_ = 1 - front_;
+      CUDA_CHECK(cudaEventRecord(consumed_, cudaStreamDefault));
+      CUDA_CHECK(cudaStreamWaitEvent(stream_, consumed_, 0));
+      Generate(1 - front_);
+    }
+    CUDA_CHECK(cudaStreamWaitEvent(cudaStreamDefault, ready_[front_], 0));
+    offset_ = 0;
+  }
+
+  unsigned int* buf_[2];
+  size_t capacity_;
+  size_t offset_;
+  int front_;
+  cudaStream_t stream_;
+  cudaEvent_t ready_[2];
+  cudaEvent_t consumed_;
+  int seed_generation_;
+};
+
+boost::thread_specific_ptr<PoolImpl> thread_pool_;
+
+}  // namespace
+
+const unsigned int* DropoutMaskPool::Acquire(const int count) {
+  if (!thread_pool_.get()) { thread_pool_.reset(new PoolImpl()); }
+  return thread_pool_->Acquire(count);
+}
+
+#endif  // CPU_ONLY
+
+}  // namespace caffe
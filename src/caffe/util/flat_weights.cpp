@@ -0,0 +1,146 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/util/flat_weights.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+struct FlatWeights<Dtype>::Header {
+  uint64_t magic;
+  uint64_t element_size;
+  uint64_t index_size;
+};
+
+// "caffeflt" -- identifies the file format.
+static const uint64_t kFlatWeightsMagic = 0x6361666665666c74ULL;
+
+// The data region starts on a page boundary and every tensor on a cache
+// line, so mapped pointers satisfy any SIMD alignment the math kernels
+// assume. Writer and reader compute the same offsets from these rules.
+static const size_t kFlatPageAlign = 4096;
+static const size_t kFlatBlobAlign = 64;
+
+static size_t align_up(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename Dtype>
+FlatWeights<Dtype>::FlatWeights()
+    : mapped_(NULL),
+      mapped_size_(0) {
+}
+
+template <typename Dtype>
+FlatWeights<Dtype>::~FlatWeights() {
+  if (mapped_) {
+    munmap(mapped_, mapped_size_);
+  }
+}
+
+template <typename Dtype>
+void FlatWeights<Dtype>::Write(const NetParameter& param,
+    const string& filename) {
+  // The index is the structure with each blob reduced to its shape.
+  NetParameter index;
+  index.CopyFrom(param);
+  vector<shared_ptr<Blob<Dtype> > > blobs;
+  for (int i = 0; i < index.layer_size(); ++i) {
+    LayerParameter* layer = index.mutable_layer(i);
+    for (int j = 0; j < layer->blobs_size(); ++j) {
+      shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>());
+      blob->FromProto(param.layer(i).blobs(j));
+      blobs.push_back(blob);
+      BlobProto* proto = layer->mutable_blobs(j);
+      proto->Clear();
+      for (int k = 0; k < blob->num_axes(); ++k) {
+        proto->mutable_shape()->add_dim(blob->shape(k));
+      }
+    }
+  }
+  string index_bytes;
+  CHECK(index.SerializeToString(&index_bytes))
+      << "Failed to serialize the index for " << filename;
+
+  const int fd = open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  CHECK_GE(fd, 0) << "Failed to create flat weight file " << filename;
+  Header header;
+  header.magic = kFlatWeightsMagic;
+  header.element_size = sizeof(Dtype);
+  header.index_size = index_bytes.size();
+  CHECK_EQ(write(fd, &header, sizeof(header)), sizeof(header))
+      << "Failed to write flat weight file " << filename;
+  CHECK_EQ(write(fd, index_bytes.data(), index_bytes.size()),
+      index_bytes.size())
+      << "Failed to write flat weight file " << filename;
+  size_t offset = align_up(sizeof(header) + index_bytes.size(),
+      kFlatPageAlign);
+  for (int i = 0; i < blobs.size(); ++i) {
+    offset = align_up(offset, kFlatBlobAlign);
+    CHECK_EQ(lseek(fd, offset, SEEK_SET), offset);
+    const ssize_t bytes = blobs[i]->count() * sizeof(Dtype);
+    CHECK_EQ(write(fd, blobs[i]->cpu_data(), bytes), bytes)
+        << "Failed to write flat weight file " << filename;
+    offset += bytes;
+  }
+  CHECK_EQ(close(fd), 0) << "Failed to write flat weight file " << filename;
+}
+
+template <typename Dtype>
+shared_ptr<FlatWeights<Dtype> > FlatWeights<Dtype>::Open(
+    const string& filename) {
+  shared_ptr<FlatWeights> flat(new FlatWeights());
+  flat->filename_ = filename;
+  const int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Failed to open flat weight file " << filename;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat " << filename;
+  flat->mapped_size_ = st.st_size;
+  flat->mapped_ = mmap(NULL, flat->mapped_size_, PROT_READ, MAP_SHARED,
+      fd, 0);
+  close(fd);  // the mapping keeps the file referenced
+  CHECK_NE(flat->mapped_, MAP_FAILED)
+      << "Failed to map flat weight file " << filename;
+  const char* bytes = reinterpret_cast<const char*>(flat->mapped_);
+  CHECK_GE(flat->mapped_size_, sizeof(Header))
+      << filename << " is not a flat weight file";
+  const Header* header = reinterpret_cast<const Header*>(bytes);
+  CHECK_EQ(header->magic, kFlatWeightsMagic)
+      << filename << " is not a flat weight file";
+  CHECK_EQ(header->element_size, sizeof(Dtype))
+      << filename << " holds " << header->element_size
+      << "-byte elements; this net uses " << sizeof(Dtype) << "-byte ones";
+  CHECK_LE(sizeof(Header) + header->index_size, flat->mapped_size_)
+      << filename << " is truncated";
+  CHECK(flat->index_.ParseFromArray(bytes + sizeof(Header),
+      header->index_size))
+      << "Failed to parse the index of " << filename;
+  size_t offset = align_up(sizeof(Header) + header->index_size,
+      kFlatPageAlign);
+  for (int i = 0; i < flat->index_.layer_size(); ++i) {
+    const LayerParameter& layer = flat->index_.layer(i);
+    for (int j = 0; j < layer.blobs_size(); ++j) {
+      size_t count = 1;
+      for (int k = 0; k < layer.blobs(j).shape().dim_size(); ++k) {
+        count *= layer.blobs(j).shape().dim(k);
+      }
+      offset = align_up(offset, kFlatBlobAlign);
+      CHECK_LE(offset + count * sizeof(Dtype), flat->mapped_size_)
+          << filename << " is truncated";
+      flat->blob_data_.push_back(
+          reinterpret_cast<const Dtype*>(bytes + offset));
+      offset += count * sizeof(Dtype);
+    }
+  }
+  return flat;
+}
+
+INSTANTIATE_CLASS(FlatWeights);
+
+}  // namespace caffe
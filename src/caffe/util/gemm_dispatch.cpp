@@ -0,0 +1,199 @@
+#include <dlfcn.h>
+
+#include <boost/thread.hpp>
+
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/gemm_dispatch.hpp"
+
+namespace caffe {
+
+namespace {
+
+typedef void (*SgemmFn)(const CBLAS_ORDER Order, const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc);
+typedef void (*DgemmFn)(const CBLAS_ORDER Order, const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc);
+
+// Backend 0 is the BLAS linked at build time; backend 1 is the loaded one.
+const int kNumBackends = 2;
+// Each backend is timed this many times per shape before one is chosen;
+// the best observed time counts, so a cold first call does not decide.
+const int kProbesPerBackend = 2;
+
+// Thin adapters so the built-in BLAS matches the function pointer types
+// exactly, whatever integer widths its own prototypes use.
+void builtin_sgemm(const CBLAS_ORDER Order, const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc) {
+  cblas_sgemm(Order, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+      beta, C, ldc);
+}
+void builtin_dgemm(const CBLAS_ORDER Order, const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc) {
+  cblas_dgemm(Order, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+      beta, C, ldc);
+}
+
+void* backend_handle = NULL;
+SgemmFn backend_sgemm = NULL;
+DgemmFn backend_dgemm = NULL;
+// Read on every caffe_cpu_gemm call, so kept lock-free; backends load
+// before worker threads start.
+volatile bool backend_active = false;
+
+struct GemmTiming {
+  double best_ms[kNumBackends];
+  int probes[kNumBackends];
+  int chosen;
+  GemmTiming() : chosen(-1) {
+    for (int b = 0; b < kNumBackends; ++b) {
+      best_ms[b] = 0;
+      probes[b] = 0;
+    }
+  }
+};
+
+boost::mutex gemm_mutex;
+std::map<std::string, GemmTiming>* gemm_timings = NULL;
+
+std::string shape_key(const CBLAS_TRANSPOSE trans_a,
+    const CBLAS_TRANSPOSE trans_b, const int m, const int n, const int k,
+    const char type) {
+  std::ostringstream key;
+  key << type << "_" << (trans_a == CblasNoTrans ? "n" : "t")
+      << (trans_b == CblasNoTrans ? "n" : "t")
+      << "_" << m << "x" << n << "x" << k;
+  return key.str();
+}
+
+// Picks the backend for this call. While probing, *timing_entry is set so
+// the caller records the elapsed time; once a winner is chosen the entry
+// stays NULL and calls go straight through.
+int select_backend(const std::string& key, GemmTiming** timing_entry) {
+  boost::mutex::scoped_lock lock(gemm_mutex);
+  *timing_entry = NULL;
+  if (gemm_timings == NULL) {
+    gemm_timings = new std::map<std::string, GemmTiming>();
+  }
+  GemmTiming& entry = (*gemm_timings)[key];
+  if (entry.chosen >= 0) {
+    return entry.chosen;
+  }
+  for (int b = 0; b < kNumBackends; ++b) {
+    if (entry.probes[b] < kProbesPerBackend) {
+      *timing_entry = &entry;
+      return b;
+    }
+  }
+  entry.chosen = entry.best_ms[0] <= entry.best_ms[1] ? 0 : 1;
+  LOG(INFO) << "GEMM shape " << key << " dispatched to "
+      << (entry.chosen == 0 ? "built-in" : "loaded") << " BLAS ("
+      << entry.best_ms[0] << " ms vs " << entry.best_ms[1] << " ms)";
+  return entry.chosen;
+}
+
+void record_probe(GemmTiming* entry, const int backend, const double ms) {
+  boost::mutex::scoped_lock lock(gemm_mutex);
+  if (entry->probes[backend] == 0 || ms < entry->best_ms[backend]) {
+    entry->best_ms[backend] = ms;
+  }
+  ++entry->probes[backend];
+}
+
+}  // namespace
+
+bool caffe_gemm_load_backend(const std::string& path, std::string* error) {
+  caffe_gemm_unload_backend();
+  void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    if (error) { *error = dlerror(); }
+    return false;
+  }
+  SgemmFn sgemm = reinterpret_cast<SgemmFn>(dlsym(handle, "cblas_sgemm"));
+  DgemmFn dgemm = reinterpret_cast<DgemmFn>(dlsym(handle, "cblas_dgemm"));
+  if (sgemm == NULL || dgemm == NULL) {
+    if (error) { *error = path + " does not export cblas_sgemm/cblas_dgemm"; }
+    dlclose(handle);
+    return false;
+  }
+  boost::mutex::scoped_lock lock(gemm_mutex);
+  backend_handle = handle;
+  backend_sgemm = sgemm;
+  backend_dgemm = dgemm;
+  backend_active = true;
+  return true;
+}
+
+void caffe_gemm_unload_backend() {
+  boost::mutex::scoped_lock lock(gemm_mutex);
+  backend_active = false;
+  if (backend_handle != NULL) {
+    dlclose(backend_handle);
+    backend_handle = NULL;
+    backend_sgemm = NULL;
+    backend_dgemm = NULL;
+  }
+  // Timings against the unloaded backend are meaningless now.
+  delete gemm_timings;
+  gemm_timings = NULL;
+}
+
+bool caffe_gemm_backend_active() {
+  return backend_active;
+}
+
+void caffe_gemm_dispatch(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc) {
+  GemmTiming* entry = NULL;
+  const int backend =
+      select_backend(shape_key(TransA, TransB, M, N, K, 's'), &entry);
+  const SgemmFn fn = backend == 1 ? backend_sgemm : builtin_sgemm;
+  if (entry == NULL) {
+    fn(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+        beta, C, ldc);
+    return;
+  }
+  CPUTimer timer;
+  timer.Start();
+  fn(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+      beta, C, ldc);
+  timer.Stop();
+  record_probe(entry, backend, timer.MilliSeconds());
+}
+
+void caffe_gemm_dispatch(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc) {
+  GemmTiming* entry = NULL;
+  const int backend =
+      select_backend(shape_key(TransA, TransB, M, N, K, 'd'), &entry);
+  const DgemmFn fn = backend == 1 ? backend_dgemm : builtin_dgemm;
+  if (entry == NULL) {
+    fn(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+        beta, C, ldc);
+    return;
+  }
+  CPUTimer timer;
+  timer.Start();
+  fn(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+      beta, C, ldc);
+  timer.Stop();
+  record_probe(entry, backend, timer.MilliSeconds());
+}
+
+}  // namespace caffe
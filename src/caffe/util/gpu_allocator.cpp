@@ -0,0 +1,232 @@
+#include <boost/thread.hpp>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/gpu_allocator.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+
+namespace {
+
+// Blocks below the smallest bin still occupy one of these, which bounds
+// the number of distinct free lists without wasting much on tiny blobs.
+const size_t kMinBinBytes = 256;
+
+// Rounds up to the next power of two, so a blob that oscillates between
+// nearby sizes keeps hitting the same bin.
+size_t bin_size(size_t size) {
+  size_t bin = kMinBinBytes;
+  while (bin < size) { bin <<= 1; }
+  return bin;
+}
+
+// One idle block. Under USE_PER_THREAD_STREAMS, ready was recorded on
+// the freeing thread's stream after its last use of the block; the next
+// taker's stream waits on it before reuse, which is the cross-stream
+// fencing the single-default-stream build does not need.
+struct CachedBlock {
+  void* ptr;
+  cudaEvent_t ready;
+};
+
+// Free lists keyed by (device, bin); blocks in them are idle and may be
+// handed out again or freed wholesale by ReleaseCached.
+typedef std::map<std::pair<int, size_t>, std::vector<CachedBlock> > FreeLists;
+
+// Live (handed-out) blocks per bin plus how many requests the bin has
+// ever served, for the telemetry histogram.
+struct BinStats {
+  BinStats() : live(0), gets(0) {}
+  size_t live;
+  size_t gets;
+};
+
+boost::mutex allocator_mutex;
+FreeLists* free_lists = NULL;
+size_t cached_bytes = 0;
+size_t hit_count = 0;
+size_t miss_count = 0;
+std::map<size_t, BinStats>* bin_stats = NULL;
+// Bytes handed out right now, both as binned (what the device holds)
+// and as requested (what callers asked for); the gap is binning waste.
+size_t live_binned_bytes = 0;
+size_t live_requested_bytes = 0;
+size_t peak_live_binned_bytes = 0;
+
+// Frees all cached blocks; the caller holds allocator_mutex.
+void release_cached_locked() {
+  if (free_lists == NULL) { return; }
+  int initial_device;
+  cudaGetDevice(&initial_device);
+  for (FreeLists::iterator it = free_lists->begin();
+       it != free_lists->end(); ++it) {
+    CUDA_CHECK(cudaSetDevice(it->first.first));
+    for (int i = 0; i < it->second.size(); ++i) {
+      if (it->second[i].ready != NULL) {
+        CUDA_CHECK(cudaEventDestroy(it->second[i].ready));
+      }
+      CUDA_CHECK(cudaFree(it->second[i].ptr));
+    }
+  }
+  cudaSetDevice(initial_device);
+  free_lists->clear();
+  cached_bytes = 0;
+}
+
+// Accounts one block of the given bin entering service; the caller
+// holds allocator_mutex.
+void record_get_locked(size_t bin, size_t size) {
+  if (bin_stats == NULL) {
+    bin_stats = new std::map<size_t, BinStats>();
+  }
+  BinStats& stats = (*bin_stats)[bin];
+  ++stats.live;
+  ++stats.gets;
+  live_binned_bytes += bin;
+  live_requested_bytes += size;
+  if (live_binned_bytes > peak_live_binned_bytes) {
+    peak_live_binned_bytes = live_binned_bytes;
+  }
+}
+
+// Builds the telemetry report; the caller holds allocator_mutex.
+std::string report_locked() {
+  std::ostringstream report;
+  const double mb = 1024 * 1024;
+  const size_t lookups = hit_count + miss_count;
+  report << "GPU allocator telemetry:";
+  report << "\n  live " << live_binned_bytes / mb << " MB binned ("
+         << live_requested_bytes / mb << " MB requested), peak "
+         << peak_live_binned_bytes / mb << " MB, cached "
+         << cached_bytes / mb << " MB, hit rate "
+         << (lookups ? static_cast<double>(hit_count) / lookups : 0);
+  const size_t footprint = live_binned_bytes + cached_bytes;
+  if (footprint > 0) {
+    // Bytes the device holds that no caller is using: binning slack in
+    // live blocks plus everything idle in the cache.
+    report << "\n  fragmentation estimate "
+           << 100.0 * (footprint - live_requested_bytes) / footprint
+           << "% of " << footprint / mb << " MB footprint";
+  }
+  if (bin_stats != NULL && !bin_stats->empty()) {
+    report << "\n  bin histogram (bin KB: live blocks / cached blocks"
+           << " / total gets):";
+    for (std::map<size_t, BinStats>::const_iterator it = bin_stats->begin();
+         it != bin_stats->end(); ++it) {
+      size_t cached_blocks = 0;
+      if (free_lists != NULL) {
+        for (FreeLists::const_iterator fl = free_lists->begin();
+             fl != free_lists->end(); ++fl) {
+          if (fl->first.second == it->first) {
+            cached_blocks += fl->second.size();
+          }
+        }
+      }
+      report << "\n    " << it->first / 1024.0 << ": "
+             << it->second.live << " / " << cached_blocks << " / "
+             << it->second.gets;
+    }
+  }
+  return report.str();
+}
+
+}  // namespace
+
+bool GPUAllocator::Get(void** ptr, size_t size, int* device) {
+  const size_t bin = bin_size(size);
+  CUDA_CHECK(cudaGetDevice(device));
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  if (free_lists == NULL) {
+    free_lists = new FreeLists();
+  }
+  std::vector<CachedBlock>& blocks =
+      (*free_lists)[std::make_pair(*device, bin)];
+  if (!blocks.empty()) {
+    const CachedBlock block = blocks.back();
+    blocks.pop_back();
+    if (block.ready != NULL) {
+      // Order this thread's stream after the freeing thread's last use.
+      CUDA_CHECK(cudaStreamWaitEvent(cudaStreamDefault, block.ready, 0));
+      CUDA_CHECK(cudaEventDestroy(block.ready));
+    }
+    *ptr = block.ptr;
+    cached_bytes -= bin;
+    ++hit_count;
+    record_get_locked(bin, size);
+    return true;
+  }
+  ++miss_count;
+  if (cudaMalloc(ptr, bin) == cudaSuccess) {
+    record_get_locked(bin, size);
+    return true;
+  }
+  // Out of memory: the cache may be sitting on the headroom we need.
+  release_cached_locked();
+  if (cudaMalloc(ptr, bin) == cudaSuccess) {
+    record_get_locked(bin, size);
+    return true;
+  }
+  *ptr = NULL;
+  LOG(ERROR) << report_locked();
+  return false;
+}
+
+void GPUAllocator::Put(void* ptr, size_t size, int device) {
+  const size_t bin = bin_size(size);
+  CachedBlock block;
+  block.ptr = ptr;
+  block.ready = NULL;
+#ifdef USE_PER_THREAD_STREAMS
+  // cudaStreamDefault resolves to this thread's private stream here, so
+  // the event marks the end of the freeing net's work on the block.
+  CUDA_CHECK(cudaEventCreateWithFlags(&block.ready, cudaEventDisableTiming));
+  CUDA_CHECK(cudaEventRecord(block.ready, cudaStreamDefault));
+#endif
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  if (free_lists == NULL) {
+    free_lists = new FreeLists();
+  }
+  (*free_lists)[std::make_pair(device, bin)].push_back(block);
+  cached_bytes += bin;
+  if (bin_stats != NULL && (*bin_stats)[bin].live > 0) {
+    --(*bin_stats)[bin].live;
+  }
+  live_binned_bytes -= bin;
+  live_requested_bytes -= size;
+}
+
+void GPUAllocator::ReleaseCached() {
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  release_cached_locked();
+}
+
+size_t GPUAllocator::bytes_cached() {
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  return cached_bytes;
+}
+
+size_t GPUAllocator::hits() {
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  return hit_count;
+}
+
+size_t GPUAllocator::misses() {
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  return miss_count;
+}
+
+std::string GPUAllocator::report() {
+  boost::mutex::scoped_lock lock(allocator_mutex);
+  return report_locked();
+}
+
+#endif  // CPU_ONLY
+
+}  // namespace caffe
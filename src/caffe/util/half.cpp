@@ -0,0 +1,95 @@
+#include <cstring>
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+uint16_t caffe_float2half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));  // NOLINT(caffe/alt_fn)
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  const uint32_t exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+  if (exponent == 0xff) {
+    // Inf stays Inf; NaN keeps a non-zero payload.
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  // Re-bias the exponent from 127 to 15.
+  int half_exp = static_cast<int>(exponent) - 127 + 15;
+  if (half_exp >= 0x1f) {
+    return sign | 0x7c00;  // overflow to Inf
+  }
+  if (half_exp <= 0) {
+    if (half_exp < -10) {
+      return sign;  // underflows even the smallest subnormal
+    }
+    // Shift the full 24-bit significand into a half subnormal,
+    // rounding to nearest even on the bits shifted out.
+    mantissa |= 0x800000;
+    const int shift = 14 - half_exp;
+    uint32_t half_mantissa = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half_mantissa & 1))) {
+      // A subnormal rounding up into 0x400 is exactly the smallest
+      // normal encoding, so no further carry handling is needed.
+      ++half_mantissa;
+    }
+    return sign | half_mantissa;
+  }
+  uint32_t half_mantissa = mantissa >> 13;
+  const uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half_mantissa & 1))) {
+    ++half_mantissa;
+    if (half_mantissa == 0x400) {
+      half_mantissa = 0;
+      if (++half_exp >= 0x1f) {
+        return sign | 0x7c00;
+      }
+    }
+  }
+  return sign | (half_exp << 10) | half_mantissa;
+}
+
+float caffe_half2float(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // Normalize the subnormal; every half value is exact in fp32.
+      exponent = 127 - 15 + 1;
+      while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        --exponent;
+      }
+      mantissa &= 0x3ff;
+      bits = sign | (exponent << 23) | (mantissa << 13);
+    }
+  } else {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+  float out;
+  memcpy(&out, &bits, sizeof(out));  // NOLINT(caffe/alt_fn)
+  return out;
+}
+
+void caffe_cpu_float2half(const int n, const float* src, uint16_t* dst) {
+  for (int i = 0; i < n; ++i) {
+    dst[i] = caffe_float2half(src[i]);
+  }
+}
+
+void caffe_cpu_half2float(const int n, const uint16_t* src, float* dst) {
+  for (int i = 0; i < n; ++i) {
+    dst[i] = caffe_half2float(src[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,36 @@
+#include <cuda_fp16.h>
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+__global__ void float2half_kernel(const int n, const float* src,
+    uint16_t* dst) {
+  CUDA_KERNEL_LOOP(index, n) {
+    dst[index] = __half_as_ushort(__float2half_rn(src[index]));
+  }
+}
+
+__global__ void half2float_kernel(const int n, const uint16_t* src,
+    float* dst) {
+  CUDA_KERNEL_LOOP(index, n) {
+    dst[index] = __half2float(__ushort_as_half(src[index]));
+  }
+}
+
+void caffe_gpu_float2half(const int n, const float* src, uint16_t* dst) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  float2half_kernel<<<CAFFE_GET_BLOCKS(n), CAFFE_CUDA_NUM_THREADS>>>(
+      n, src, dst);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+void caffe_gpu_half2float(const int n, const uint16_t* src, float* dst) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  half2float_kernel<<<CAFFE_GET_BLOCKS(n), CAFFE_CUDA_NUM_THREADS>>>(
+      n, src, dst);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+}  // namespace caffe
@@ -1,5 +1,6 @@
 #include "caffe/util/hdf5.hpp"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -63,6 +64,86 @@ void hdf5_load_nd_dataset_helper(
   blob->Reshape(blob_dims);
 }
 
+hsize_t hdf5_get_dataset_rows(hid_t file_id, const char* dataset_name_) {
+  CHECK(H5LTfind_dataset(file_id, dataset_name_))
+      << "Failed to find HDF5 dataset " << dataset_name_;
+  int ndims;
+  herr_t status = H5LTget_dataset_ndims(file_id, dataset_name_, &ndims);
+  CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name_;
+  CHECK_GE(ndims, 1) << "Dataset must have at least 1 axis: " << dataset_name_;
+  std::vector<hsize_t> dims(ndims);
+  H5T_class_t class_;
+  status = H5LTget_dataset_info(
+      file_id, dataset_name_, dims.data(), &class_, NULL);
+  CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name_;
+  return dims[0];
+}
+
+// Reads rows [start, start + count) of a dataset through a hyperslab
+// selection on the first axis, into a buffer of the given memory type.
+static void hdf5_read_dataset_rows(hid_t file_id, const char* dataset_name_,
+    hid_t mem_type, hsize_t start, hsize_t count, void* buffer) {
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t filespace = H5Dget_space(dataset);
+  CHECK_GE(filespace, 0);
+  const int ndims = H5Sget_simple_extent_ndims(filespace);
+  CHECK_GE(ndims, 1);
+  std::vector<hsize_t> dims(ndims);
+  H5Sget_simple_extent_dims(filespace, dims.data(), NULL);
+  CHECK_LE(start + count, dims[0])
+      << "Row window past the end of dataset " << dataset_name_;
+  std::vector<hsize_t> offset(ndims, 0);
+  std::vector<hsize_t> counts(dims);
+  offset[0] = start;
+  counts[0] = count;
+  herr_t status = H5Sselect_hyperslab(filespace, H5S_SELECT_SET,
+      offset.data(), NULL, counts.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t memspace = H5Screate_simple(ndims, counts.data(), NULL);
+  CHECK_GE(memspace, 0);
+  status = H5Dread(dataset, mem_type, memspace, filespace, H5P_DEFAULT,
+      buffer);
+  CHECK_GE(status, 0) << "Failed to read rows of dataset " << dataset_name_;
+  H5Sclose(memspace);
+  H5Sclose(filespace);
+  H5Dclose(dataset);
+}
+
+// Validates the dataset like hdf5_load_nd_dataset_helper and reshapes
+// blob to the row window rather than the full extent.
+template <typename Dtype>
+static void hdf5_load_nd_dataset_rows_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob, hsize_t start, hsize_t count) {
+  hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
+  vector<int> blob_dims(blob->shape());
+  CHECK_LE(start + count, blob_dims[0])
+      << "Row window past the end of dataset " << dataset_name_;
+  blob_dims[0] = count;
+  blob->Reshape(blob_dims);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, Blob<float>* blob,
+    hsize_t start, hsize_t count) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim, max_dim,
+      blob, start, count);
+  hdf5_read_dataset_rows(file_id, dataset_name_, H5T_NATIVE_FLOAT,
+      start, count, blob->mutable_cpu_data());
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, Blob<double>* blob,
+    hsize_t start, hsize_t count) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim, max_dim,
+      blob, start, count);
+  hdf5_read_dataset_rows(file_id, dataset_name_, H5T_NATIVE_DOUBLE,
+      start, count, blob->mutable_cpu_data());
+}
+
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<float>* blob) {
@@ -81,10 +162,46 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Writes a chunked, byte-shuffled, deflate-compressed dataset. Chunks
+// are the blob shape with the leading axis split so a chunk stays near
+// one million elements; each chunk compresses independently.
+static void hdf5_save_nd_dataset_deflate(
+    const hid_t file_id, const string& dataset_name, const int num_axes,
+    const hsize_t* dims, const hid_t type, const void* data,
+    const int deflate) {
+  std::vector<hsize_t> chunk(dims, dims + num_axes);
+  hsize_t inner = 1;
+  for (int i = 1; i < num_axes; ++i) {
+    inner *= dims[i];
+  }
+  const hsize_t max_lead = std::max<hsize_t>((1 << 20) / inner, 1);
+  if (chunk[0] > max_lead) {
+    chunk[0] = max_lead;
+  }
+  hid_t space = H5Screate_simple(num_axes, dims, NULL);
+  CHECK_GE(space, 0) << "Failed to make dataspace " << dataset_name;
+  hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+  CHECK_GE(plist, 0) << "Failed to make property list " << dataset_name;
+  CHECK_GE(H5Pset_chunk(plist, num_axes, chunk.data()), 0)
+      << "Failed to set chunking for " << dataset_name;
+  CHECK_GE(H5Pset_shuffle(plist), 0)
+      << "Failed to set shuffle filter for " << dataset_name;
+  CHECK_GE(H5Pset_deflate(plist, deflate), 0)
+      << "Failed to set deflate filter for " << dataset_name;
+  hid_t dataset = H5Dcreate2(file_id, dataset_name.c_str(), type, space,
+      H5P_DEFAULT, plist, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to make dataset " << dataset_name;
+  CHECK_GE(H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data), 0)
+      << "Failed to write dataset " << dataset_name;
+  H5Dclose(dataset);
+  H5Pclose(plist);
+  H5Sclose(space);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
-    bool write_diff) {
+    bool write_diff, int deflate) {
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -96,16 +213,21 @@ void hdf5_save_nd_dataset<float>(
   } else {
     data = blob.cpu_data();
   }
-  herr_t status = H5LTmake_dataset_float(
-      file_id, dataset_name.c_str(), num_axes, dims, data);
-  CHECK_GE(status, 0) << "Failed to make float dataset " << dataset_name;
+  if (deflate > 0 && num_axes > 0) {  // chunking requires rank >= 1
+    hdf5_save_nd_dataset_deflate(file_id, dataset_name, num_axes, dims,
+        H5T_NATIVE_FLOAT, data, deflate);
+  } else {
+    herr_t status = H5LTmake_dataset_float(
+        file_id, dataset_name.c_str(), num_axes, dims, data);
+    CHECK_GE(status, 0) << "Failed to make float dataset " << dataset_name;
+  }
   delete[] dims;
 }
 
 template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
-    bool write_diff) {
+    bool write_diff, int deflate) {
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -117,9 +239,14 @@ void hdf5_save_nd_dataset<double>(
   } else {
     data = blob.cpu_data();
   }
-  herr_t status = H5LTmake_dataset_double(
-      file_id, dataset_name.c_str(), num_axes, dims, data);
-  CHECK_GE(status, 0) << "Failed to make double dataset " << dataset_name;
+  if (deflate > 0 && num_axes > 0) {  // chunking requires rank >= 1
+    hdf5_save_nd_dataset_deflate(file_id, dataset_name, num_axes, dims,
+        H5T_NATIVE_DOUBLE, data, deflate);
+  } else {
+    herr_t status = H5LTmake_dataset_double(
+        file_id, dataset_name.c_str(), num_axes, dims, data);
+    CHECK_GE(status, 0) << "Failed to make double dataset " << dataset_name;
+  }
   delete[] dims;
 }
 
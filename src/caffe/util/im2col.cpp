@@ -15,6 +15,44 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
+// Shape-templated copy of the generic loop below for square undilated
+// kernels: with kernel, stride and pad as compile-time constants the
+// compiler unrolls the tap loops and vectorizes the interior columns.
+// Instantiated for the handful of shapes our nets actually run;
+// im2col_cpu dispatches here when the arguments match one.
+template <typename Dtype, int kKernel, int kStride, int kPad>
+static void im2col_cpu_fixed(const Dtype* data_im, const int channels,
+    const int height, const int width, Dtype* data_col) {
+  const int output_h = (height + 2 * kPad - kKernel) / kStride + 1;
+  const int output_w = (width + 2 * kPad - kKernel) / kStride + 1;
+  const int channel_size = height * width;
+  for (int channel = channels; channel--; data_im += channel_size) {
+    for (int kernel_row = 0; kernel_row < kKernel; kernel_row++) {
+      for (int kernel_col = 0; kernel_col < kKernel; kernel_col++) {
+        int input_row = -kPad + kernel_row;
+        for (int output_rows = output_h; output_rows; output_rows--) {
+          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+            for (int output_cols = output_w; output_cols; output_cols--) {
+              *(data_col++) = 0;
+            }
+          } else {
+            int input_col = -kPad + kernel_col;
+            for (int output_col = output_w; output_col; output_col--) {
+              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                *(data_col++) = data_im[input_row * width + input_col];
+              } else {
+                *(data_col++) = 0;
+              }
+              input_col += kStride;
+            }
+          }
+          input_row += kStride;
+        }
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -22,6 +60,22 @@ void im2col_cpu(const Dtype* data_im, const int channels,
     const int stride_h, const int stride_w,
     const int dilation_h, const int dilation_w,
     Dtype* data_col) {
+  if (dilation_h == 1 && dilation_w == 1 && kernel_h == kernel_w &&
+      stride_h == stride_w && pad_h == pad_w) {
+#define IM2COL_FIXED_CASE(K, S, P) \
+    if (kernel_h == K && stride_h == S && pad_h == P) { \
+      im2col_cpu_fixed<Dtype, K, S, P>(data_im, channels, height, width, \
+          data_col); \
+      return; \
+    }
+    IM2COL_FIXED_CASE(1, 1, 0);
+    IM2COL_FIXED_CASE(3, 1, 1);
+    IM2COL_FIXED_CASE(3, 2, 1);
+    IM2COL_FIXED_CASE(5, 1, 2);
+    IM2COL_FIXED_CASE(7, 2, 3);
+    IM2COL_FIXED_CASE(11, 4, 0);
+#undef IM2COL_FIXED_CASE
+  }
   const int output_h = (height + 2 * pad_h -
     (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int output_w = (width + 2 * pad_w -
@@ -66,6 +120,112 @@ template void im2col_cpu<double>(const double* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_col);
 
+// 3-D specialization of the generic n-d routine below. Volumetric nets
+// hit this shape on every call, and the per-element index-vector
+// arithmetic of the generic path dominates their profile; here the
+// strides are linearized once per kernel tap and the innermost loop
+// walks the width contiguously, just like the 2-D path above.
+template <typename Dtype>
+void im2col_3d_cpu(const Dtype* data_im, const int* im_shape,
+    const int* col_shape, const int* kernel_shape, const int* pad,
+    const int* stride, const int* dilation, Dtype* data_col) {
+  const int depth = im_shape[1];
+  const int height = im_shape[2];
+  const int width = im_shape[3];
+  const int output_d = col_shape[1];
+  const int output_h = col_shape[2];
+  const int output_w = col_shape[3];
+  const int channel_size = depth * height * width;
+  for (int channel = im_shape[0]; channel--; data_im += channel_size) {
+    for (int kernel_d = 0; kernel_d < kernel_shape[0]; kernel_d++) {
+      for (int kernel_row = 0; kernel_row < kernel_shape[1]; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_shape[2]; kernel_col++) {
+          int input_d = -pad[0] + kernel_d * dilation[0];
+          for (int output_ds = output_d; output_ds; output_ds--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_d, depth)) {
+              caffe_set(output_h * output_w, Dtype(0), data_col);
+              data_col += output_h * output_w;
+            } else {
+              const Dtype* data_plane = data_im + input_d * height * width;
+              int input_row = -pad[1] + kernel_row * dilation[1];
+              for (int output_rows = output_h; output_rows; output_rows--) {
+                if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+                  for (int output_cols = output_w; output_cols;
+                       output_cols--) {
+                    *(data_col++) = 0;
+                  }
+                } else {
+                  int input_col = -pad[2] + kernel_col * dilation[2];
+                  for (int output_col = output_w; output_col; output_col--) {
+                    if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                      *(data_col++) =
+                          data_plane[input_row * width + input_col];
+                    } else {
+                      *(data_col++) = 0;
+                    }
+                    input_col += stride[2];
+                  }
+                }
+                input_row += stride[1];
+              }
+            }
+            input_d += stride[0];
+          }
+        }
+      }
+    }
+  }
+}
+
+// 3-D counterpart of col2im_cpu; same loop structure as im2col_3d_cpu
+// with the copy direction reversed.
+template <typename Dtype>
+void col2im_3d_cpu(const Dtype* data_col, const int* im_shape,
+    const int* col_shape, const int* kernel_shape, const int* pad,
+    const int* stride, const int* dilation, Dtype* data_im) {
+  const int depth = im_shape[1];
+  const int height = im_shape[2];
+  const int width = im_shape[3];
+  const int output_d = col_shape[1];
+  const int output_h = col_shape[2];
+  const int output_w = col_shape[3];
+  const int channel_size = depth * height * width;
+  caffe_set(im_shape[0] * channel_size, Dtype(0), data_im);
+  for (int channel = im_shape[0]; channel--; data_im += channel_size) {
+    for (int kernel_d = 0; kernel_d < kernel_shape[0]; kernel_d++) {
+      for (int kernel_row = 0; kernel_row < kernel_shape[1]; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_shape[2]; kernel_col++) {
+          int input_d = -pad[0] + kernel_d * dilation[0];
+          for (int output_ds = output_d; output_ds; output_ds--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_d, depth)) {
+              data_col += output_h * output_w;
+            } else {
+              Dtype* data_plane = data_im + input_d * height * width;
+              int input_row = -pad[1] + kernel_row * dilation[1];
+              for (int output_rows = output_h; output_rows; output_rows--) {
+                if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+                  data_col += output_w;
+                } else {
+                  int input_col = -pad[2] + kernel_col * dilation[2];
+                  for (int output_col = output_w; output_col; output_col--) {
+                    if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                      data_plane[input_row * width + input_col] += *data_col;
+                    }
+                    data_col++;
+                    input_col += stride[2];
+                  }
+                }
+                input_row += stride[1];
+              }
+            }
+            input_d += stride[0];
+          }
+        }
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int num_spatial_axes, const int* im_shape, const int* col_shape,
@@ -142,6 +302,11 @@ void im2col_nd_cpu(const Dtype* data_im, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_col) {
+  if (num_spatial_axes == 3) {
+    im2col_3d_cpu(data_im, im_shape, col_shape, kernel_shape, pad, stride,
+                  dilation, data_col);
+    return;
+  }
   const bool kIm2Col = true;
   im2col_nd_core_cpu(data_im, kIm2Col, num_spatial_axes, im_shape, col_shape,
                   kernel_shape, pad, stride, dilation, data_col);
@@ -208,11 +373,66 @@ template void col2im_cpu<double>(const double* data_col, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_im);
 
+template <typename Dtype>
+void col2im_strip_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int output_row_start, const int output_row_end, Dtype* data_im) {
+  const int output_w = (width + 2 * pad_w -
+    (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int channel_size = height * width;
+  for (int channel = channels; channel--; data_im += channel_size) {
+    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+        int input_row = -pad_h + kernel_row * dilation_h
+            + output_row_start * stride_h;
+        for (int output_rows = output_row_end - output_row_start;
+             output_rows; output_rows--) {
+          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+            data_col += output_w;
+          } else {
+            int input_col = -pad_w + kernel_col * dilation_w;
+            for (int output_col = output_w; output_col; output_col--) {
+              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                data_im[input_row * width + input_col] += *data_col;
+              }
+              data_col++;
+              input_col += stride_w;
+            }
+          }
+          input_row += stride_h;
+        }
+      }
+    }
+  }
+}
+
+// Explicit instantiation
+template void col2im_strip_cpu<float>(const float* data_col,
+    const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_row_start, const int output_row_end, float* data_im);
+template void col2im_strip_cpu<double>(const double* data_col,
+    const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_row_start, const int output_row_end, double* data_im);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_im) {
+  if (num_spatial_axes == 3) {
+    col2im_3d_cpu(data_col, im_shape, col_shape, kernel_shape, pad, stride,
+                  dilation, data_im);
+    return;
+  }
   const bool kIm2Col = false;
   im2col_nd_core_cpu(data_col, kIm2Col, num_spatial_axes, im_shape, col_shape,
                      kernel_shape, pad, stride, dilation, data_im);
@@ -0,0 +1,63 @@
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/image_index.hpp"
+
+namespace caffe {
+
+static const char kImageIndexMagic[8] =
+    { 'C', 'a', 'f', 'f', 'e', 'I', 'd', 'x' };
+
+bool ImageIndex::Load(const string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  char magic[8];
+  if (!file.read(magic, sizeof(magic))
+      || memcmp(magic, kImageIndexMagic, sizeof(magic)) != 0) {
+    return false;
+  }
+  uint32_t count;
+  CHECK(file.read(reinterpret_cast<char*>(&count), sizeof(count)))
+      << "Truncated image index " << filename;
+  labels_.resize(count);
+  offsets_.resize(count + 1);
+  CHECK(file.read(reinterpret_cast<char*>(&labels_[0]),
+      count * sizeof(int32_t))) << "Truncated image index " << filename;
+  CHECK(file.read(reinterpret_cast<char*>(&offsets_[0]),
+      (count + 1) * sizeof(uint32_t))) << "Truncated image index " << filename;
+  arena_.resize(offsets_[count]);
+  CHECK(file.read(&arena_[0], arena_.size()))
+      << "Truncated image index " << filename;
+  return true;
+}
+
+void ImageIndex::Write(const string& filename,
+    const vector<std::pair<string, int> >& lines) {
+  std::ofstream file(filename.c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  CHECK(file) << "Could not open " << filename << " for writing";
+  file.write(kImageIndexMagic, sizeof(kImageIndexMagic));
+  const uint32_t count = lines.size();
+  file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const int32_t label = lines[i].second;
+    file.write(reinterpret_cast<const char*>(&label), sizeof(label));
+  }
+  uint32_t offset = 0;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    offset += lines[i].first.size();
+  }
+  file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+  for (size_t i = 0; i < lines.size(); ++i) {
+    file.write(lines[i].first.data(), lines[i].first.size());
+  }
+  CHECK(file) << "Failed writing image index " << filename;
+}
+
+}  // namespace caffe
@@ -12,12 +12,17 @@
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
+#include <sstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/io.hpp"
+#include "caffe/util/prototxt_parser.hpp"
+#ifdef USE_OPENCV
+#include "caffe/util/jpeg_decoder.hpp"
+#endif  // USE_OPENCV
 
 const int kProtoReadBytesLimit = INT_MAX;  // Max size of 2 GB minus 1 byte.
 
@@ -32,13 +37,19 @@ using google::protobuf::io::CodedOutputStream;
 using google::protobuf::Message;
 
 bool ReadProtoFromTextFile(const char* filename, Message* proto) {
-  int fd = open(filename, O_RDONLY);
-  CHECK_NE(fd, -1) << "File not found: " << filename;
-  FileInputStream* input = new FileInputStream(fd);
-  bool success = google::protobuf::TextFormat::Parse(input, proto);
-  delete input;
-  close(fd);
-  return success;
+  std::ifstream file(filename, ios::in | ios::binary);
+  CHECK(file) << "File not found: " << filename;
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  const string text = buffer.str();
+  // Single-pass reflection parser first; TextFormat is a noticeable
+  // startup cost on large machine-generated prototxts. Anything outside
+  // the fast parser's subset falls back to the full parser.
+  if (ParsePrototxtFast(text, proto)) {
+    return true;
+  }
+  proto->Clear();
+  return google::protobuf::TextFormat::ParseFromString(text, proto);
 }
 
 void WriteProtoToTextFile(const Message& proto, const char* filename) {
@@ -49,6 +60,24 @@ void WriteProtoToTextFile(const Message& proto, const char* filename) {
   close(fd);
 }
 
+bool SkipBinaryProtoField(CodedInputStream* input,
+    const google::protobuf::uint32 tag) {
+  google::protobuf::uint64 varint;
+  google::protobuf::uint32 length;
+  switch (tag & 7) {  // wire type
+  case 0:  // varint
+    return input->ReadVarint64(&varint);
+  case 1:  // 64-bit
+    return input->Skip(8);
+  case 2:  // length-delimited
+    return input->ReadVarint32(&length) && input->Skip(length);
+  case 5:  // 32-bit
+    return input->Skip(4);
+  default:  // groups and reserved wire types: not used by our protos
+    return false;
+  }
+}
+
 bool ReadProtoFromBinaryFile(const char* filename, Message* proto) {
   int fd = open(filename, O_RDONLY);
   CHECK_NE(fd, -1) << "File not found: " << filename;
@@ -102,6 +131,43 @@ cv::Mat ReadImageToCVMat(const string& filename) {
   return ReadImageToCVMat(filename, 0, 0, true);
 }
 
+bool ReadImageToCVMat(const string& filename, const int height,
+    const int width, const bool is_color, std::vector<char>* file_buffer,
+    cv::Mat* decode_buffer, cv::Mat* cv_img) {
+  fstream file(filename.c_str(), ios::in|ios::binary|ios::ate);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open or find file " << filename;
+    return false;
+  }
+  const std::streampos size = file.tellg();
+  // resize keeps the old capacity, so a steady stream of similarly
+  // sized files stops allocating after the largest one.
+  file_buffer->resize(size);
+  file.seekg(0, ios::beg);
+  file.read(file_buffer->data(), size);
+  file.close();
+  const int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
+    CV_LOAD_IMAGE_GRAYSCALE);
+  const cv::Mat encoded(1, file_buffer->size(), CV_8UC1,
+      file_buffer->data());
+  // The dst overload reuses decode_buffer's storage whenever the
+  // decoded dimensions and type match the previous call's.
+  cv::imdecode(encoded, cv_read_flag, decode_buffer);
+  if (!decode_buffer->data) {
+    LOG(ERROR) << "Could not decode file " << filename;
+    *cv_img = cv::Mat();
+    return false;
+  }
+  if (height > 0 && width > 0 &&
+      (decode_buffer->rows != height || decode_buffer->cols != width)) {
+    cv::resize(*decode_buffer, *cv_img, cv::Size(width, height));
+  } else {
+    // Reference-counted share, not a copy.
+    *cv_img = *decode_buffer;
+  }
+  return true;
+}
+
 // Do the file extension and encoding match?
 static bool matchExt(const std::string & fn,
                      std::string en) {
@@ -167,6 +233,12 @@ cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
   cv::Mat cv_img;
   CHECK(datum.encoded()) << "Datum not encoded";
   const string& data = datum.data();
+#ifdef USE_TURBOJPEG
+  // JPEG datums take the libjpeg-turbo path, keeping the file's channels.
+  if (DecodeJpegToCVMat(data.data(), data.size(), 0, 0, -1, &cv_img)) {
+    return cv_img;
+  }
+#endif
   std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
   cv_img = cv::imdecode(vec_data, -1);
   if (!cv_img.data) {
@@ -178,6 +250,12 @@ cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color) {
   cv::Mat cv_img;
   CHECK(datum.encoded()) << "Datum not encoded";
   const string& data = datum.data();
+#ifdef USE_TURBOJPEG
+  if (DecodeJpegToCVMat(data.data(), data.size(), 0, 0, is_color ? 1 : 0,
+          &cv_img)) {
+    return cv_img;
+  }
+#endif
   std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
   int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
     CV_LOAD_IMAGE_GRAYSCALE);
@@ -0,0 +1,90 @@
+#ifdef USE_OPENCV
+#include "caffe/util/jpeg_decoder.hpp"
+
+#ifdef USE_TURBOJPEG
+#include <turbojpeg.h>
+
+#include <boost/thread/tss.hpp>
+#endif
+
+#include <stdint.h>
+
+namespace caffe {
+
+#ifdef USE_TURBOJPEG
+
+namespace {
+
+void DestroyTjHandle(void* handle) {
+  tjDestroy(handle);
+}
+
+// One decompressor per thread; handles are not thread-safe but are
+// expensive to create per image.
+boost::thread_specific_ptr<void> tj_handle(DestroyTjHandle);
+
+tjhandle GetTjHandle() {
+  if (tj_handle.get() == NULL) {
+    tj_handle.reset(tjInitDecompress());
+  }
+  return tj_handle.get();
+}
+
+}  // namespace
+
+bool DecodeJpegToCVMat(const char* data, size_t size,
+    int min_height, int min_width, int color_mode, cv::Mat* img) {
+  // JPEG streams start with the SOI marker.
+  if (size < 2 || static_cast<uint8_t>(data[0]) != 0xff
+      || static_cast<uint8_t>(data[1]) != 0xd8) {
+    return false;
+  }
+  tjhandle handle = GetTjHandle();
+  if (handle == NULL) {
+    return false;
+  }
+  const unsigned char* buf = reinterpret_cast<const unsigned char*>(data);
+  int width, height, subsamp, colorspace;
+  if (tjDecompressHeader3(handle, buf, size, &width, &height, &subsamp,
+          &colorspace) != 0) {
+    return false;
+  }
+  const bool is_color =
+      color_mode > 0 || (color_mode < 0 && colorspace != TJCS_GRAY);
+  // Pick the smallest DCT-domain scale that still covers the minimum size.
+  int scaled_width = width;
+  int scaled_height = height;
+  if (min_height > 0 && min_width > 0) {
+    int num_factors = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&num_factors);
+    for (int i = 0; i < num_factors; ++i) {
+      const int w = TJSCALED(width, factors[i]);
+      const int h = TJSCALED(height, factors[i]);
+      if (w >= min_width && h >= min_height
+          && w * h < scaled_width * scaled_height) {
+        scaled_width = w;
+        scaled_height = h;
+      }
+    }
+  }
+  img->create(scaled_height, scaled_width, is_color ? CV_8UC3 : CV_8UC1);
+  if (tjDecompress2(handle, buf, size, img->data, scaled_width,
+          static_cast<int>(img->step), scaled_height,
+          is_color ? TJPF_BGR : TJPF_GRAY, TJFLAG_FASTDCT) != 0) {
+    img->release();
+    return false;
+  }
+  return true;
+}
+
+#else
+
+bool DecodeJpegToCVMat(const char* data, size_t size,
+    int min_height, int min_width, int color_mode, cv::Mat* img) {
+  return false;
+}
+
+#endif  // USE_TURBOJPEG
+
+}  // namespace caffe
+#endif  // USE_OPENCV
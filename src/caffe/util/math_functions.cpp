@@ -1,11 +1,21 @@
+#include <boost/bind.hpp>
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
+#include <boost/thread.hpp>
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <vector>
 
 #include "caffe/common.hpp"
+#include "caffe/util/gemm_dispatch.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/simd_math.hpp"
+#include "caffe/util/worker_pool.hpp"
 
 namespace caffe {
 
@@ -16,6 +26,11 @@ void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     float* C) {
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
+  if (caffe_gemm_backend_active()) {
+    caffe_gemm_dispatch(TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+        beta, C, N);
+    return;
+  }
   cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
       ldb, beta, C, N);
 }
@@ -27,6 +42,11 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
     double* C) {
   int lda = (TransA == CblasNoTrans) ? K : M;
   int ldb = (TransB == CblasNoTrans) ? N : K;
+  if (caffe_gemm_backend_active()) {
+    caffe_gemm_dispatch(TransA, TransB, M, N, K, alpha, A, lda, B, ldb,
+        beta, C, N);
+    return;
+  }
   cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
       ldb, beta, C, N);
 }
@@ -45,13 +65,100 @@ void caffe_cpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
   cblas_dgemv(CblasRowMajor, TransA, M, N, alpha, A, N, x, 1, beta, y, 1);
 }
 
+namespace {
+
+// Level-1 BLAS updates over multi-million-element parameter blobs (the
+// solver's axpby over a 60M-element weight blob, gradient accumulation)
+// are memory bound on a single core. Above this element count they are
+// split into contiguous chunks across threads; below it the spawn cost
+// outweighs the win and the call stays on the calling thread.
+const int kLevel1ParallelThreshold = 1 << 20;
+
+int level1_threads(const int n) {
+  if (n < kLevel1ParallelThreshold) { return 1; }
+  int threads = boost::thread::hardware_concurrency();
+  if (threads < 1) { threads = 1; }
+  // Keep every chunk at least half the threshold so each thread has
+  // enough work to amortize its dispatch.
+  const int max_chunks = n / (kLevel1ParallelThreshold / 2);
+  return std::min(threads, max_chunks);
+}
+
+template <typename Op>
+void parallel_level1(const int n, const Op& op) {
+  const int threads = level1_threads(n);
+  if (threads <= 1) {
+    op(0, n);
+    return;
+  }
+  const int chunk = (n + threads - 1) / threads;
+  // Fan out over the shared WorkerPool instead of spawning a
+  // thread_group per call; the first chunk runs on the caller.
+  std::vector<shared_ptr<WorkerHandle> > handles;
+  for (int t = 1; t < threads; ++t) {
+    const int offset = t * chunk;
+    handles.push_back(WorkerPool::Submit(boost::bind<void>(op, offset,
+        std::min(chunk, n - offset))));
+  }
+  op(0, chunk);
+  for (size_t t = 0; t < handles.size(); ++t) {
+    handles[t]->Join();
+  }
+}
+
+inline void level1_axpy(const int n, const float alpha, const float* x,
+    float* y) { cblas_saxpy(n, alpha, x, 1, y, 1); }
+inline void level1_axpy(const int n, const double alpha, const double* x,
+    double* y) { cblas_daxpy(n, alpha, x, 1, y, 1); }
+inline void level1_scal(const int n, const float alpha, float* x) {
+  cblas_sscal(n, alpha, x, 1);
+}
+inline void level1_scal(const int n, const double alpha, double* x) {
+  cblas_dscal(n, alpha, x, 1);
+}
+inline void level1_axpby(const int n, const float alpha, const float* x,
+    const float beta, float* y) { cblas_saxpby(n, alpha, x, 1, beta, y, 1); }
+inline void level1_axpby(const int n, const double alpha, const double* x,
+    const double beta, double* y) { cblas_daxpby(n, alpha, x, 1, beta, y, 1); }
+
+template <typename Dtype>
+struct AxpyOp {
+  AxpyOp(const Dtype alpha, const Dtype* x, Dtype* y)
+      : alpha_(alpha), x_(x), y_(y) {}
+  void operator()(const int offset, const int n) const {
+    level1_axpy(n, alpha_, x_ + offset, y_ + offset);
+  }
+  Dtype alpha_; const Dtype* x_; Dtype* y_;
+};
+
+template <typename Dtype>
+struct ScalOp {
+  ScalOp(const Dtype alpha, Dtype* x) : alpha_(alpha), x_(x) {}
+  void operator()(const int offset, const int n) const {
+    level1_scal(n, alpha_, x_ + offset);
+  }
+  Dtype alpha_; Dtype* x_;
+};
+
+template <typename Dtype>
+struct AxpbyOp {
+  AxpbyOp(const Dtype alpha, const Dtype* x, const Dtype beta, Dtype* y)
+      : alpha_(alpha), x_(x), beta_(beta), y_(y) {}
+  void operator()(const int offset, const int n) const {
+    level1_axpby(n, alpha_, x_ + offset, beta_, y_ + offset);
+  }
+  Dtype alpha_; const Dtype* x_; Dtype beta_; Dtype* y_;
+};
+
+}  // namespace
+
 template <>
 void caffe_axpy<float>(const int N, const float alpha, const float* X,
-    float* Y) { cblas_saxpy(N, alpha, X, 1, Y, 1); }
+    float* Y) { parallel_level1(N, AxpyOp<float>(alpha, X, Y)); }
 
 template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
-    double* Y) { cblas_daxpy(N, alpha, X, 1, Y, 1); }
+    double* Y) { parallel_level1(N, AxpyOp<double>(alpha, X, Y)); }
 
 template <typename Dtype>
 void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
@@ -106,30 +213,34 @@ template void caffe_copy<double>(const int N, const double* X, double* Y);
 
 template <>
 void caffe_scal<float>(const int N, const float alpha, float *X) {
-  cblas_sscal(N, alpha, X, 1);
+  parallel_level1(N, ScalOp<float>(alpha, X));
 }
 
 template <>
 void caffe_scal<double>(const int N, const double alpha, double *X) {
-  cblas_dscal(N, alpha, X, 1);
+  parallel_level1(N, ScalOp<double>(alpha, X));
 }
 
 template <>
 void caffe_cpu_axpby<float>(const int N, const float alpha, const float* X,
                             const float beta, float* Y) {
-  cblas_saxpby(N, alpha, X, 1, beta, Y, 1);
+  parallel_level1(N, AxpbyOp<float>(alpha, X, beta, Y));
 }
 
 template <>
 void caffe_cpu_axpby<double>(const int N, const double alpha, const double* X,
                              const double beta, double* Y) {
-  cblas_daxpby(N, alpha, X, 1, beta, Y, 1);
+  parallel_level1(N, AxpbyOp<double>(alpha, X, beta, Y));
 }
 
 template <>
 void caffe_add<float>(const int n, const float* a, const float* b,
     float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_add(n, a, b, y);
+#else
   vsAdd(n, a, b, y);
+#endif
 }
 
 template <>
@@ -141,7 +252,11 @@ void caffe_add<double>(const int n, const double* a, const double* b,
 template <>
 void caffe_sub<float>(const int n, const float* a, const float* b,
     float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_sub(n, a, b, y);
+#else
   vsSub(n, a, b, y);
+#endif
 }
 
 template <>
@@ -153,7 +268,11 @@ void caffe_sub<double>(const int n, const double* a, const double* b,
 template <>
 void caffe_mul<float>(const int n, const float* a, const float* b,
     float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_mul(n, a, b, y);
+#else
   vsMul(n, a, b, y);
+#endif
 }
 
 template <>
@@ -165,7 +284,11 @@ void caffe_mul<double>(const int n, const double* a, const double* b,
 template <>
 void caffe_div<float>(const int n, const float* a, const float* b,
     float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_div(n, a, b, y);
+#else
   vsDiv(n, a, b, y);
+#endif
 }
 
 template <>
@@ -188,7 +311,11 @@ void caffe_powx<double>(const int n, const double* a, const double b,
 
 template <>
 void caffe_sqr<float>(const int n, const float* a, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_sqr(n, a, y);
+#else
   vsSqr(n, a, y);
+#endif
 }
 
 template <>
@@ -198,7 +325,11 @@ void caffe_sqr<double>(const int n, const double* a, double* y) {
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_exp(n, a, y);
+#else
   vsExp(n, a, y);
+#endif
 }
 
 template <>
@@ -226,6 +357,106 @@ void caffe_abs<double>(const int n, const double* a, double* y) {
     vdAbs(n, a, y);
 }
 
+template <>
+void caffe_cpu_relu<float>(const int n, const float* x,
+    const float negative_slope, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_relu(n, x, negative_slope, y);
+#else
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::max(x[i], 0.f) + negative_slope * std::min(x[i], 0.f);
+  }
+#endif
+}
+
+template <>
+void caffe_cpu_relu<double>(const int n, const double* x,
+    const double negative_slope, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::max(x[i], 0.) + negative_slope * std::min(x[i], 0.);
+  }
+}
+
+template <>
+void caffe_cpu_relu_backward<float>(const int n, const float* dy,
+    const float* x, const float negative_slope, float* dx) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_relu_backward(n, dy, x, negative_slope, dx);
+#else
+  for (int i = 0; i < n; ++i) {
+    dx[i] = dy[i] * ((x[i] > 0) + negative_slope * (x[i] <= 0));
+  }
+#endif
+}
+
+template <>
+void caffe_cpu_relu_backward<double>(const int n, const double* dy,
+    const double* x, const double negative_slope, double* dx) {
+  for (int i = 0; i < n; ++i) {
+    dx[i] = dy[i] * ((x[i] > 0) + negative_slope * (x[i] <= 0));
+  }
+}
+
+template <>
+void caffe_cpu_sigmoid<float>(const int n, const float* x, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_sigmoid(n, x, y);
+#else
+  for (int i = 0; i < n; ++i) { y[i] = 1.f / (1.f + exp(-x[i])); }
+#endif
+}
+
+template <>
+void caffe_cpu_sigmoid<double>(const int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) { y[i] = 1. / (1. + exp(-x[i])); }
+}
+
+template <>
+void caffe_cpu_sigmoid_backward<float>(const int n, const float* dy,
+    const float* y, float* dx) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_sigmoid_backward(n, dy, y, dx);
+#else
+  for (int i = 0; i < n; ++i) { dx[i] = dy[i] * y[i] * (1.f - y[i]); }
+#endif
+}
+
+template <>
+void caffe_cpu_sigmoid_backward<double>(const int n, const double* dy,
+    const double* y, double* dx) {
+  for (int i = 0; i < n; ++i) { dx[i] = dy[i] * y[i] * (1. - y[i]); }
+}
+
+template <>
+void caffe_cpu_tanh<float>(const int n, const float* x, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_tanh(n, x, y);
+#else
+  for (int i = 0; i < n; ++i) { y[i] = tanh(x[i]); }
+#endif
+}
+
+template <>
+void caffe_cpu_tanh<double>(const int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) { y[i] = tanh(x[i]); }
+}
+
+template <>
+void caffe_cpu_tanh_backward<float>(const int n, const float* dy,
+    const float* y, float* dx) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_tanh_backward(n, dy, y, dx);
+#else
+  for (int i = 0; i < n; ++i) { dx[i] = dy[i] * (1.f - y[i] * y[i]); }
+#endif
+}
+
+template <>
+void caffe_cpu_tanh_backward<double>(const int n, const double* dy,
+    const double* y, double* dx) {
+  for (int i = 0; i < n; ++i) { dx[i] = dy[i] * (1. - y[i] * y[i]); }
+}
+
 unsigned int caffe_rng_rand() {
   return (*caffe_rng())();
 }
@@ -242,17 +473,136 @@ float caffe_nextafter(const float b);
 template
 double caffe_nextafter(const double b);
 
+namespace {
+
+// Philox 4x32-10 counter-based generator (Salmon et al., SC'11). The
+// i-th block of four variates is a pure function of (key, i), so a fill
+// can be chunked across any number of threads -- via parallel_level1
+// above -- and still produce the identical sequence for a given key.
+// The key is drawn once per fill from the sequential caffe_rng(), which
+// keeps whole runs reproducible from Caffe::set_random_seed alone. The
+// boost variate path this replaces generated one value at a time from a
+// single stream; initializing nets with hundreds of millions of
+// parameters took more time in the filler than in the first iterations.
+inline void philox_block(const uint64_t key, const uint64_t counter,
+    uint32_t out[4]) {
+  uint32_t k0 = static_cast<uint32_t>(key);
+  uint32_t k1 = static_cast<uint32_t>(key >> 32);
+  out[0] = static_cast<uint32_t>(counter);
+  out[1] = static_cast<uint32_t>(counter >> 32);
+  out[2] = 0;
+  out[3] = 0;
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t p0 = UINT64_C(0xD2511F53) * out[0];
+    const uint64_t p1 = UINT64_C(0xCD9E8D57) * out[2];
+    const uint32_t x0 = static_cast<uint32_t>(p1 >> 32) ^ out[1] ^ k0;
+    const uint32_t x2 = static_cast<uint32_t>(p0 >> 32) ^ out[3] ^ k1;
+    out[1] = static_cast<uint32_t>(p1);
+    out[3] = static_cast<uint32_t>(p0);
+    out[0] = x0;
+    out[2] = x2;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+}
+
+uint64_t philox_key() {
+  caffe::rng_t* rng = caffe_rng();
+  const uint64_t lo = (*rng)();
+  const uint64_t hi = (*rng)();
+  return (hi << 32) | (lo & 0xFFFFFFFFu);
+}
+
+const double kInv32 = 2.3283064365386963e-10;  // 2^-32
+const double kTwoPi = 6.283185307179586;
+
+// Box-Muller on the block's two uniform pairs; the +1 keeps u1 in
+// (0, 1] so the log stays finite. Working in four-wide blocks keeps the
+// transcendentals in straight-line code the compiler can vectorize.
+template <typename Dtype>
+inline void philox_gaussian4(const uint32_t bits[4], Dtype vals[4]) {
+  for (int p = 0; p < 2; ++p) {
+    const double u1 = (static_cast<double>(bits[2 * p]) + 1.0) * kInv32;
+    const double u2 = static_cast<double>(bits[2 * p + 1]) * kInv32;
+    const double radius = std::sqrt(-2.0 * std::log(u1));
+    vals[2 * p] = radius * std::cos(kTwoPi * u2);
+    vals[2 * p + 1] = radius * std::sin(kTwoPi * u2);
+  }
+}
+
+// The ops below fill [offset, offset + n) by walking the blocks that
+// overlap the range, so chunk boundaries need not be block-aligned.
+template <typename Dtype>
+struct RngUniformOp {
+  RngUniformOp(const uint64_t key, const Dtype a, const Dtype b, Dtype* r)
+      : key_(key), a_(a), b_(b), r_(r) {}
+  void operator()(const int offset, const int n) const {
+    const int end = offset + n;
+    for (int base = offset & ~3; base < end; base += 4) {
+      uint32_t bits[4];
+      philox_block(key_, base >> 2, bits);
+      for (int j = 0; j < 4; ++j) {
+        const int idx = base + j;
+        if (idx >= offset && idx < end) {
+          r_[idx] = a_ + static_cast<Dtype>(bits[j] * kInv32) * (b_ - a_);
+        }
+      }
+    }
+  }
+  uint64_t key_; Dtype a_; Dtype b_; Dtype* r_;
+};
+
+template <typename Dtype>
+struct RngGaussianOp {
+  RngGaussianOp(const uint64_t key, const Dtype mu, const Dtype sigma,
+      Dtype* r) : key_(key), mu_(mu), sigma_(sigma), r_(r) {}
+  void operator()(const int offset, const int n) const {
+    const int end = offset + n;
+    for (int base = offset & ~3; base < end; base += 4) {
+      uint32_t bits[4];
+      philox_block(key_, base >> 2, bits);
+      Dtype vals[4];
+      philox_gaussian4(bits, vals);
+      for (int j = 0; j < 4; ++j) {
+        const int idx = base + j;
+        if (idx >= offset && idx < end) {
+          r_[idx] = mu_ + sigma_ * vals[j];
+        }
+      }
+    }
+  }
+  uint64_t key_; Dtype mu_; Dtype sigma_; Dtype* r_;
+};
+
+template <typename Dtype, typename Itype>
+struct RngBernoulliOp {
+  RngBernoulliOp(const uint64_t key, const Dtype p, Itype* r)
+      : key_(key), p_(p), r_(r) {}
+  void operator()(const int offset, const int n) const {
+    const int end = offset + n;
+    for (int base = offset & ~3; base < end; base += 4) {
+      uint32_t bits[4];
+      philox_block(key_, base >> 2, bits);
+      for (int j = 0; j < 4; ++j) {
+        const int idx = base + j;
+        if (idx >= offset && idx < end) {
+          r_[idx] = static_cast<Dtype>(bits[j] * kInv32) < p_ ? 1 : 0;
+        }
+      }
+    }
+  }
+  uint64_t key_; Dtype p_; Itype* r_;
+};
+
+}  // namespace
+
 template <typename Dtype>
 void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r) {
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_LE(a, b);
-  boost::uniform_real<Dtype> random_distribution(a, caffe_nextafter<Dtype>(b));
-  boost::variate_generator<caffe::rng_t*, boost::uniform_real<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
-  }
+  parallel_level1(n, RngUniformOp<Dtype>(philox_key(), a,
+      caffe_nextafter<Dtype>(b), r));
 }
 
 template
@@ -269,12 +619,7 @@ void caffe_rng_gaussian(const int n, const Dtype a,
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_GT(sigma, 0);
-  boost::normal_distribution<Dtype> random_distribution(a, sigma);
-  boost::variate_generator<caffe::rng_t*, boost::normal_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
-  }
+  parallel_level1(n, RngGaussianOp<Dtype>(philox_key(), a, sigma, r));
 }
 
 template
@@ -291,12 +636,7 @@ void caffe_rng_bernoulli(const int n, const Dtype p, int* r) {
   CHECK(r);
   CHECK_GE(p, 0);
   CHECK_LE(p, 1);
-  boost::bernoulli_distribution<Dtype> random_distribution(p);
-  boost::variate_generator<caffe::rng_t*, boost::bernoulli_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
-  }
+  parallel_level1(n, RngBernoulliOp<Dtype, int>(philox_key(), p, r));
 }
 
 template
@@ -311,12 +651,7 @@ void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r) {
   CHECK(r);
   CHECK_GE(p, 0);
   CHECK_LE(p, 1);
-  boost::bernoulli_distribution<Dtype> random_distribution(p);
-  boost::variate_generator<caffe::rng_t*, boost::bernoulli_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = static_cast<unsigned int>(variate_generator());
-  }
+  parallel_level1(n, RngBernoulliOp<Dtype, unsigned int>(philox_key(), p, r));
 }
 
 template
@@ -358,6 +693,170 @@ double caffe_cpu_asum<double>(const int n, const double* x) {
   return cblas_dasum(n, x, 1);
 }
 
+template <>
+void caffe_cpu_sum_sumsq<float>(const int n, const float* x, float* sum,
+    float* sumsq) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_sum_sumsq(n, x, sum, sumsq);
+#else
+  float s = 0, ss = 0;
+  for (int i = 0; i < n; ++i) {
+    s += x[i];
+    ss += x[i] * x[i];
+  }
+  *sum = s;
+  *sumsq = ss;
+#endif
+}
+
+template <>
+void caffe_cpu_sum_sumsq<double>(const int n, const double* x, double* sum,
+    double* sumsq) {
+  double s = 0, ss = 0;
+  for (int i = 0; i < n; ++i) {
+    s += x[i];
+    ss += x[i] * x[i];
+  }
+  *sum = s;
+  *sumsq = ss;
+}
+
+template <>
+void caffe_cpu_clipped_log<float>(const int n, const float* x,
+    const float floor, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_clipped_log(n, x, floor, y);
+#else
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::log(std::max(x[i], floor));
+  }
+#endif
+}
+
+template <>
+void caffe_cpu_clipped_log<double>(const int n, const double* x,
+    const double floor, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::log(std::max(x[i], floor));
+  }
+}
+
+template <>
+float caffe_cpu_sub_sumsq<float>(const int n, const float* a, const float* b,
+    float* diff) {
+#ifdef CAFFE_SIMD_MATH
+  float sumsq;
+  caffe_simd_sub_sumsq(n, a, b, diff, &sumsq);
+  return sumsq;
+#else
+  float ss = 0;
+  for (int i = 0; i < n; ++i) {
+    const float d = a[i] - b[i];
+    diff[i] = d;
+    ss += d * d;
+  }
+  return ss;
+#endif
+}
+
+template <>
+double caffe_cpu_sub_sumsq<double>(const int n, const double* a,
+    const double* b, double* diff) {
+  double ss = 0;
+  for (int i = 0; i < n; ++i) {
+    const double d = a[i] - b[i];
+    diff[i] = d;
+    ss += d * d;
+  }
+  return ss;
+}
+
+template <typename Dtype>
+void caffe_cpu_slice_sum(const int num, const int dim, const Dtype* x,
+    Dtype* y) {
+  // The fused kernel's extra squares are free next to the read of the
+  // data, and it is the vectorized single-pass sum we have.
+  Dtype sumsq;
+  for (int i = 0; i < num; ++i) {
+    caffe_cpu_sum_sumsq(dim, x + i * dim, y + i, &sumsq);
+  }
+}
+
+template void caffe_cpu_slice_sum<float>(const int num, const int dim,
+    const float* x, float* y);
+template void caffe_cpu_slice_sum<double>(const int num, const int dim,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_slice_asum(const int num, const int dim, const Dtype* x,
+    Dtype* y) {
+  for (int i = 0; i < num; ++i) {
+    y[i] = caffe_cpu_asum(dim, x + i * dim);
+  }
+}
+
+template void caffe_cpu_slice_asum<float>(const int num, const int dim,
+    const float* x, float* y);
+template void caffe_cpu_slice_asum<double>(const int num, const int dim,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_slice_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* y) {
+  Dtype sum;
+  for (int i = 0; i < num; ++i) {
+    caffe_cpu_sum_sumsq(dim, x + i * dim, &sum, y + i);
+  }
+}
+
+template void caffe_cpu_slice_sumsq<float>(const int num, const int dim,
+    const float* x, float* y);
+template void caffe_cpu_slice_sumsq<double>(const int num, const int dim,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_slice_sum_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* sum, Dtype* sumsq) {
+  for (int i = 0; i < num; ++i) {
+    caffe_cpu_sum_sumsq(dim, x + i * dim, sum + i, sumsq + i);
+  }
+}
+
+template void caffe_cpu_slice_sum_sumsq<float>(const int num, const int dim,
+    const float* x, float* sum, float* sumsq);
+template void caffe_cpu_slice_sum_sumsq<double>(const int num, const int dim,
+    const double* x, double* sum, double* sumsq);
+
+template <typename Dtype>
+void caffe_cpu_slice_sub_sumsq(const int num, const int dim, const Dtype* a,
+    const Dtype* b, Dtype* diff, Dtype* sumsq) {
+  for (int i = 0; i < num; ++i) {
+    sumsq[i] = caffe_cpu_sub_sumsq(dim, a + i * dim, b + i * dim,
+        diff + i * dim);
+  }
+}
+
+template void caffe_cpu_slice_sub_sumsq<float>(const int num, const int dim,
+    const float* a, const float* b, float* diff, float* sumsq);
+template void caffe_cpu_slice_sub_sumsq<double>(const int num, const int dim,
+    const double* a, const double* b, double* diff, double* sumsq);
+
+template <>
+void caffe_cpu_axpb<float>(const int n, const float alpha, const float* x,
+    const float beta, float* y) {
+#ifdef CAFFE_SIMD_MATH
+  caffe_simd_axpb(n, alpha, x, beta, y);
+#else
+  for (int i = 0; i < n; ++i) { y[i] = alpha * x[i] + beta; }
+#endif
+}
+
+template <>
+void caffe_cpu_axpb<double>(const int n, const double alpha, const double* x,
+    const double beta, double* y) {
+  for (int i = 0; i < n; ++i) { y[i] = alpha * x[i] + beta; }
+}
+
 template <>
 void caffe_cpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
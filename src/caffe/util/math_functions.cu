@@ -5,7 +5,10 @@
 
 #include <cmath>
 
+#include <algorithm>
+
 #include "caffe/common.hpp"
+#include "caffe/util/gpu_util.cuh"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -42,6 +45,58 @@ void caffe_gpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
       N, M, K, &alpha, B, ldb, A, lda, &beta, C, N));
 }
 
+template <>
+void caffe_gpu_gemm_batched<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int stride_A,
+    const float* B, const int stride_B, const float beta,
+    float* C, const int stride_C, const int batch) {
+  // Note that cublas follows fortran order.
+  int lda = (TransA == CblasNoTrans) ? K : M;
+  int ldb = (TransB == CblasNoTrans) ? N : K;
+  cublasOperation_t cuTransA =
+      (TransA == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  cublasOperation_t cuTransB =
+      (TransB == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+#if CUDA_VERSION >= 8000
+  CUBLAS_CHECK(cublasSgemmStridedBatched(Caffe::cublas_handle(), cuTransB,
+      cuTransA, N, M, K, &alpha, B, ldb, stride_B, A, lda, stride_A, &beta,
+      C, N, stride_C, batch));
+#else
+  for (int b = 0; b < batch; ++b) {
+    CUBLAS_CHECK(cublasSgemm(Caffe::cublas_handle(), cuTransB, cuTransA,
+        N, M, K, &alpha, B + b * stride_B, ldb, A + b * stride_A, lda,
+        &beta, C + b * stride_C, N));
+  }
+#endif
+}
+
+template <>
+void caffe_gpu_gemm_batched<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int stride_A,
+    const double* B, const int stride_B, const double beta,
+    double* C, const int stride_C, const int batch) {
+  // Note that cublas follows fortran order.
+  int lda = (TransA == CblasNoTrans) ? K : M;
+  int ldb = (TransB == CblasNoTrans) ? N : K;
+  cublasOperation_t cuTransA =
+      (TransA == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  cublasOperation_t cuTransB =
+      (TransB == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+#if CUDA_VERSION >= 8000
+  CUBLAS_CHECK(cublasDgemmStridedBatched(Caffe::cublas_handle(), cuTransB,
+      cuTransA, N, M, K, &alpha, B, ldb, stride_B, A, lda, stride_A, &beta,
+      C, N, stride_C, batch));
+#else
+  for (int b = 0; b < batch; ++b) {
+    CUBLAS_CHECK(cublasDgemm(Caffe::cublas_handle(), cuTransB, cuTransA,
+        N, M, K, &alpha, B + b * stride_B, ldb, A + b * stride_A, lda,
+        &beta, C + b * stride_C, N));
+  }
+#endif
+}
+
 template <>
 void caffe_gpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
@@ -116,6 +171,282 @@ void caffe_gpu_dot<double>(const int n, const double* x, const double* y,
   CUBLAS_CHECK(cublasDdot(Caffe::cublas_handle(), n, x, 1, y, 1, out));
 }
 
+template <>
+void caffe_gpu_dot_device<float>(const int n, const float* x, const float* y,
+    float* out) {
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_DEVICE));
+  CUBLAS_CHECK(cublasSdot(Caffe::cublas_handle(), n, x, 1, y, 1, out));
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_HOST));
+}
+
+template <>
+void caffe_gpu_dot_device<double>(const int n, const double* x,
+    const double* y, double* out) {
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_DEVICE));
+  CUBLAS_CHECK(cublasDdot(Caffe::cublas_handle(), n, x, 1, y, 1, out));
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_HOST));
+}
+
+template <typename Dtype>
+__global__ void scalar_mul_kernel(const Dtype* x, const Dtype* y, Dtype* out) {
+  out[0] = x[0] * y[0];
+}
+
+template <typename Dtype>
+void caffe_gpu_scalar_mul_device(const Dtype* x, const Dtype* y, Dtype* out) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  scalar_mul_kernel<Dtype><<<1, 1>>>(x, y, out);
+}
+
+template void caffe_gpu_scalar_mul_device<float>(const float* x,
+    const float* y, float* out);
+template void caffe_gpu_scalar_mul_device<double>(const double* x,
+    const double* y, double* out);
+
+// Lane-offset shuffle usable on every supported toolkit; doubles move
+// as two 32-bit halves where no native double shuffle exists.
+__device__ inline float caffe_shfl_down(float val, int offset) {
+#if CUDART_VERSION >= 9000
+  return __shfl_down_sync(0xffffffff, val, offset);
+#else
+  return __shfl_down(val, offset);
+#endif
+}
+
+__device__ inline double caffe_shfl_down(double val, int offset) {
+  int hi = __double2hiint(val);
+  int lo = __double2loint(val);
+#if CUDART_VERSION >= 9000
+  hi = __shfl_down_sync(0xffffffff, hi, offset);
+  lo = __shfl_down_sync(0xffffffff, lo, offset);
+#else
+  hi = __shfl_down(hi, offset);
+  lo = __shfl_down(lo, offset);
+#endif
+  return __hiloint2double(hi, lo);
+}
+
+// Single-pass sum-of-squares: a grid-stride pass over x, a warp tree
+// reduction with no shared-memory round trips, one shared slot per
+// warp, and a single atomic per block into the device accumulator.
+template <typename Dtype>
+__global__ void sumsq_acc_kernel(const int n, const Dtype* x, Dtype* acc) {
+  __shared__ Dtype warp_sums[CAFFE_CUDA_NUM_THREADS / 32];
+  Dtype sum = 0;
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n;
+       i += blockDim.x * gridDim.x) {
+    sum += x[i] * x[i];
+  }
+  for (int offset = 16; offset > 0; offset >>= 1) {
+    sum += caffe_shfl_down(sum, offset);
+  }
+  if ((threadIdx.x & 31) == 0) { warp_sums[threadIdx.x >> 5] = sum; }
+  __syncthreads();
+  if (threadIdx.x < 32) {
+    sum = threadIdx.x < (blockDim.x >> 5) ? warp_sums[threadIdx.x] : Dtype(0);
+    for (int offset = 16; offset > 0; offset >>= 1) {
+      sum += caffe_shfl_down(sum, offset);
+    }
+    if (threadIdx.x == 0) { caffe_gpu_atomic_add(sum, acc); }
+  }
+}
+
+template <typename Dtype>
+void caffe_gpu_sumsq_acc(const int n, const Dtype* x, Dtype* acc) {
+  // Cap the grid: the grid-stride loop covers the tail and fewer blocks
+  // mean fewer atomics on the accumulator.
+  const int blocks = std::min(CAFFE_GET_BLOCKS(n), 1024);
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  sumsq_acc_kernel<Dtype><<<blocks, CAFFE_CUDA_NUM_THREADS>>>(n, x, acc);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_sumsq_acc<float>(const int n, const float* x,
+    float* acc);
+template void caffe_gpu_sumsq_acc<double>(const int n, const double* x,
+    double* acc);
+
+// Like sumsq_acc_kernel, but reducing the difference of two inputs and
+// writing it out on the way: the Euclidean loss forward in one pass.
+template <typename Dtype>
+__global__ void sub_sumsq_acc_kernel(const int n, const Dtype* a,
+    const Dtype* b, Dtype* diff, Dtype* acc) {
+  __shared__ Dtype warp_sums[CAFFE_CUDA_NUM_THREADS / 32];
+  Dtype sum = 0;
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n;
+       i += blockDim.x * gridDim.x) {
+    const Dtype d = a[i] - b[i];
+    diff[i] = d;
+    sum += d * d;
+  }
+  for (int offset = 16; offset > 0; offset >>= 1) {
+    sum += caffe_shfl_down(sum, offset);
+  }
+  if ((threadIdx.x & 31) == 0) { warp_sums[threadIdx.x >> 5] = sum; }
+  __syncthreads();
+  if (threadIdx.x < 32) {
+    sum = threadIdx.x < (blockDim.x >> 5) ? warp_sums[threadIdx.x] : Dtype(0);
+    for (int offset = 16; offset > 0; offset >>= 1) {
+      sum += caffe_shfl_down(sum, offset);
+    }
+    if (threadIdx.x == 0) { caffe_gpu_atomic_add(sum, acc); }
+  }
+}
+
+template <typename Dtype>
+void caffe_gpu_sub_sumsq_acc(const int n, const Dtype* a, const Dtype* b,
+    Dtype* diff, Dtype* acc) {
+  const int blocks = std::min(CAFFE_GET_BLOCKS(n), 1024);
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  sub_sumsq_acc_kernel<Dtype><<<blocks, CAFFE_CUDA_NUM_THREADS>>>(
+      n, a, b, diff, acc);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_sub_sumsq_acc<float>(const int n, const float* a,
+    const float* b, float* diff, float* acc);
+template void caffe_gpu_sub_sumsq_acc<double>(const int n, const double* a,
+    const double* b, double* diff, double* acc);
+
+// Reduces one value per thread to a block total: warp shuffle tree, one
+// shared slot per warp, warp 0 folds the slots. The total is valid in
+// thread 0. Syncs on entry so back-to-back calls can reuse the slots.
+template <typename Dtype>
+__device__ Dtype caffe_block_reduce_sum(Dtype sum) {
+  __shared__ Dtype warp_sums[CAFFE_CUDA_NUM_THREADS / 32];
+  __syncthreads();
+  for (int offset = 16; offset > 0; offset >>= 1) {
+    sum += caffe_shfl_down(sum, offset);
+  }
+  if ((threadIdx.x & 31) == 0) { warp_sums[threadIdx.x >> 5] = sum; }
+  __syncthreads();
+  if (threadIdx.x < 32) {
+    sum = threadIdx.x < (blockDim.x >> 5) ? warp_sums[threadIdx.x] : Dtype(0);
+    for (int offset = 16; offset > 0; offset >>= 1) {
+      sum += caffe_shfl_down(sum, offset);
+    }
+  }
+  return sum;
+}
+
+// One block per slice; op selects the per-element term (0 = identity,
+// 1 = absolute value, 2 = square). The branch is uniform per launch.
+template <typename Dtype>
+__global__ void slice_reduce_kernel(const int dim, const Dtype* x,
+    const int op, Dtype* y) {
+  const Dtype* slice = x + static_cast<size_t>(blockIdx.x) * dim;
+  Dtype sum = 0;
+  for (int i = threadIdx.x; i < dim; i += blockDim.x) {
+    const Dtype v = slice[i];
+    sum += op == 0 ? v : (op == 1 ? fabs(v) : v * v);
+  }
+  sum = caffe_block_reduce_sum(sum);
+  if (threadIdx.x == 0) { y[blockIdx.x] = sum; }
+}
+
+template <typename Dtype>
+__global__ void slice_sum_sumsq_kernel(const int dim, const Dtype* x,
+    Dtype* sum_out, Dtype* sumsq_out) {
+  const Dtype* slice = x + static_cast<size_t>(blockIdx.x) * dim;
+  Dtype s = 0, ss = 0;
+  for (int i = threadIdx.x; i < dim; i += blockDim.x) {
+    const Dtype v = slice[i];
+    s += v;
+    ss += v * v;
+  }
+  s = caffe_block_reduce_sum(s);
+  ss = caffe_block_reduce_sum(ss);
+  if (threadIdx.x == 0) {
+    sum_out[blockIdx.x] = s;
+    sumsq_out[blockIdx.x] = ss;
+  }
+}
+
+template <typename Dtype>
+void caffe_gpu_slice_sum(const int num, const int dim, const Dtype* x,
+    Dtype* y) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  slice_reduce_kernel<Dtype><<<num, CAFFE_CUDA_NUM_THREADS>>>(dim, x, 0, y);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_slice_sum<float>(const int num, const int dim,
+    const float* x, float* y);
+template void caffe_gpu_slice_sum<double>(const int num, const int dim,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_gpu_slice_asum(const int num, const int dim, const Dtype* x,
+    Dtype* y) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  slice_reduce_kernel<Dtype><<<num, CAFFE_CUDA_NUM_THREADS>>>(dim, x, 1, y);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_slice_asum<float>(const int num, const int dim,
+    const float* x, float* y);
+template void caffe_gpu_slice_asum<double>(const int num, const int dim,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_gpu_slice_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* y) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  slice_reduce_kernel<Dtype><<<num, CAFFE_CUDA_NUM_THREADS>>>(dim, x, 2, y);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_slice_sumsq<float>(const int num, const int dim,
+    const float* x, float* y);
+template void caffe_gpu_slice_sumsq<double>(const int num, const int dim,
+    const double* x, double* y);
+
+template <typename Dtype>
+void caffe_gpu_slice_sum_sumsq(const int num, const int dim, const Dtype* x,
+    Dtype* sum, Dtype* sumsq) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  slice_sum_sumsq_kernel<Dtype><<<num, CAFFE_CUDA_NUM_THREADS>>>(
+      dim, x, sum, sumsq);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_slice_sum_sumsq<float>(const int num, const int dim,
+    const float* x, float* sum, float* sumsq);
+template void caffe_gpu_slice_sum_sumsq<double>(const int num, const int dim,
+    const double* x, double* sum, double* sumsq);
+
+template <typename Dtype>
+__global__ void slice_sub_sumsq_kernel(const int dim, const Dtype* a,
+    const Dtype* b, Dtype* diff, Dtype* sumsq) {
+  const size_t base = static_cast<size_t>(blockIdx.x) * dim;
+  Dtype ss = 0;
+  for (int i = threadIdx.x; i < dim; i += blockDim.x) {
+    const Dtype d = a[base + i] - b[base + i];
+    diff[base + i] = d;
+    ss += d * d;
+  }
+  ss = caffe_block_reduce_sum(ss);
+  if (threadIdx.x == 0) { sumsq[blockIdx.x] = ss; }
+}
+
+template <typename Dtype>
+void caffe_gpu_slice_sub_sumsq(const int num, const int dim, const Dtype* a,
+    const Dtype* b, Dtype* diff, Dtype* sumsq) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  slice_sub_sumsq_kernel<Dtype><<<num, CAFFE_CUDA_NUM_THREADS>>>(
+      dim, a, b, diff, sumsq);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template void caffe_gpu_slice_sub_sumsq<float>(const int num, const int dim,
+    const float* a, const float* b, float* diff, float* sumsq);
+template void caffe_gpu_slice_sub_sumsq<double>(const int num, const int dim,
+    const double* a, const double* b, double* diff, double* sumsq);
+
 template <>
 void caffe_gpu_asum<float>(const int n, const float* x, float* y) {
   CUBLAS_CHECK(cublasSasum(Caffe::cublas_handle(), n, x, 1, y));
@@ -126,6 +457,44 @@ void caffe_gpu_asum<double>(const int n, const double* x, double* y) {
   CUBLAS_CHECK(cublasDasum(Caffe::cublas_handle(), n, x, 1, y));
 }
 
+template <>
+void caffe_gpu_asum_device<float>(const int n, const float* x, float* y) {
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_DEVICE));
+  CUBLAS_CHECK(cublasSasum(Caffe::cublas_handle(), n, x, 1, y));
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_HOST));
+}
+
+template <>
+void caffe_gpu_asum_device<double>(const int n, const double* x, double* y) {
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_DEVICE));
+  CUBLAS_CHECK(cublasDasum(Caffe::cublas_handle(), n, x, 1, y));
+  CUBLAS_CHECK(cublasSetPointerMode(Caffe::cublas_handle(),
+      CUBLAS_POINTER_MODE_HOST));
+}
+
+template <typename Dtype>
+__global__ void nonfinite_check_kernel(const int n, const Dtype* x,
+    int* out) {
+  CUDA_KERNEL_LOOP(index, n) {
+    if (!isfinite(x[index])) { *out = 1; }
+  }
+}
+
+template <typename Dtype>
+void caffe_gpu_nonfinite_check(const int n, const Dtype* x, int* out) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  nonfinite_check_kernel<Dtype><<<CAFFE_GET_BLOCKS(n),
+      CAFFE_CUDA_NUM_THREADS>>>(n, x, out);
+}
+
+template void caffe_gpu_nonfinite_check<float>(const int n, const float* x,
+    int* out);
+template void caffe_gpu_nonfinite_check<double>(const int n, const double* x,
+    int* out);
+
 template <>
 void caffe_gpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
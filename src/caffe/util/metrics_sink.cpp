@@ -0,0 +1,138 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+
+#include "caffe/util/metrics_sink.hpp"
+
+namespace caffe {
+
+// Enough rows to ride out multi-second filesystem stalls at display: 1
+// before anything is dropped.
+static const size_t kMetricsRingCapacity = 4096;
+// How long the flusher sleeps between drains when nobody wakes it.
+static const int kMetricsFlushIntervalMs = 500;
+
+class MetricsSink::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  shared_ptr<boost::thread> thread_;
+};
+
+MetricsSink::MetricsSink(const string& filename)
+    : filename_(filename),
+      json_(filename.size() >= 5 &&
+          filename.compare(filename.size() - 5, 5, ".json") == 0),
+      columns_frozen_(false),
+      ring_(kMetricsRingCapacity),
+      ring_begin_(0),
+      ring_size_(0),
+      dropped_(0),
+      stop_(false),
+      sync_(new sync()) {
+  file_.open(filename.c_str());
+  CHECK(file_.good()) << "Failed to open metrics log " << filename;
+  sync_->thread_.reset(
+      new boost::thread(&MetricsSink::FlushThread, this));
+}
+
+MetricsSink::~MetricsSink() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stop_ = true;
+  }
+  sync_->condition_.notify_one();
+  sync_->thread_->join();
+  if (dropped_) {
+    LOG(WARNING) << "Metrics log " << filename_ << " dropped " << dropped_
+                 << " rows (flusher could not keep up)";
+  }
+}
+
+int MetricsSink::AddColumn(const string& name) {
+  map<string, int>::const_iterator it = column_indices_.find(name);
+  if (it != column_indices_.end()) {
+    return it->second;
+  }
+  CHECK(!columns_frozen_)
+      << "Metrics column '" << name << "' registered after the first row";
+  const int index = columns_.size();
+  columns_.push_back(name);
+  column_indices_[name] = index;
+  return index;
+}
+
+void MetricsSink::Append(int iter, const vector<float>& values) {
+  CHECK_EQ(values.size(), columns_.size())
+      << "Metrics row does not match the registered columns";
+  columns_frozen_ = true;
+  bool wake = false;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    if (ring_size_ == ring_.size()) {
+      ++dropped_;
+      return;
+    }
+    Row& row = ring_[(ring_begin_ + ring_size_) % ring_.size()];
+    row.iter = iter;
+    row.values = values;
+    ++ring_size_;
+    wake = ring_size_ >= ring_.size() / 2;
+  }
+  if (wake) {
+    sync_->condition_.notify_one();
+  }
+}
+
+void MetricsSink::FlushThread() {
+  vector<Row> rows;
+  bool stop = false;
+  while (!stop) {
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      if (!stop_ && ring_size_ < ring_.size() / 2) {
+        sync_->condition_.timed_wait(lock,
+            boost::posix_time::milliseconds(kMetricsFlushIntervalMs));
+      }
+      rows.clear();
+      for (; ring_size_ > 0; --ring_size_) {
+        rows.push_back(ring_[ring_begin_]);
+        ring_begin_ = (ring_begin_ + 1) % ring_.size();
+      }
+      stop = stop_;
+    }
+    WriteRows(rows);
+  }
+}
+
+void MetricsSink::WriteRows(const vector<Row>& rows) {
+  if (rows.empty()) { return; }
+  if (!json_ && file_.tellp() == std::streampos(0)) {
+    file_ << "iter";
+    for (int i = 0; i < columns_.size(); ++i) {
+      file_ << "," << columns_[i];
+    }
+    file_ << "\n";
+  }
+  for (int i = 0; i < rows.size(); ++i) {
+    const Row& row = rows[i];
+    if (json_) {
+      file_ << "{\"iter\": " << row.iter;
+      for (int j = 0; j < columns_.size(); ++j) {
+        file_ << ", \"" << columns_[j] << "\": " << row.values[j];
+      }
+      file_ << "}\n";
+    } else {
+      file_ << row.iter;
+      for (int j = 0; j < columns_.size(); ++j) {
+        file_ << "," << row.values[j];
+      }
+      file_ << "\n";
+    }
+  }
+  file_.flush();
+}
+
+}  // namespace caffe
@@ -0,0 +1,258 @@
+#include <google/protobuf/descriptor.h>
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <string>
+
+#include "caffe/util/prototxt_parser.hpp"
+
+namespace caffe {
+
+using google::protobuf::Descriptor;
+using google::protobuf::EnumValueDescriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+namespace {
+
+// Recursive-descent parser over the raw buffer. Every method returns false
+// on input outside the supported subset, leaving the message possibly
+// partially filled; the entry point reports the failure and TextFormat
+// takes over from scratch.
+class Parser {
+ public:
+  Parser(const char* p, const char* end) : p_(p), end_(end) {}
+
+  bool ParseMessage(Message* message, const char closing) {
+    const Descriptor* descriptor = message->GetDescriptor();
+    const Reflection* reflection = message->GetReflection();
+    while (true) {
+      SkipWhitespace();
+      if (p_ == end_) { return closing == '\0'; }
+      if (*p_ == closing) { ++p_; return true; }
+      std::string name;
+      if (!ReadIdentifier(&name)) { return false; }
+      const FieldDescriptor* field = descriptor->FindFieldByName(name);
+      if (field == NULL) { return false; }
+      SkipWhitespace();
+      bool has_colon = false;
+      if (p_ != end_ && *p_ == ':') {
+        ++p_;
+        has_colon = true;
+        SkipWhitespace();
+      }
+      if (p_ == end_) { return false; }
+      if (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+        if (*p_ != '{') { return false; }
+        ++p_;
+        Message* sub = field->is_repeated() ?
+            reflection->AddMessage(message, field) :
+            reflection->MutableMessage(message, field);
+        if (!ParseMessage(sub, '}')) { return false; }
+      } else {
+        if (!has_colon) { return false; }
+        if (!ParseScalar(message, reflection, field)) { return false; }
+      }
+    }
+  }
+
+ private:
+  void SkipWhitespace() {
+    while (p_ != end_) {
+      const char c = *p_;
+      if (c == '#') {
+        while (p_ != end_ && *p_ != '\n') { ++p_; }
+      } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        ++p_;
+      } else {
+        return;
+      }
+    }
+  }
+
+  static bool IsIdentChar(const char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
+  }
+
+  bool ReadIdentifier(std::string* out) {
+    const char* start = p_;
+    while (p_ != end_ && IsIdentChar(*p_)) { ++p_; }
+    if (p_ == start) { return false; }
+    out->assign(start, p_);
+    return true;
+  }
+
+  // A scalar value token: covers numbers (including signs and exponents),
+  // enum names, and booleans.
+  bool ReadToken(std::string* out) {
+    const char* start = p_;
+    while (p_ != end_ &&
+        (IsIdentChar(*p_) || *p_ == '+' || *p_ == '-' || *p_ == '.')) {
+      ++p_;
+    }
+    if (p_ == start) { return false; }
+    out->assign(start, p_);
+    return true;
+  }
+
+  bool ReadString(std::string* out) {
+    if (p_ == end_ || (*p_ != '"' && *p_ != '\'')) { return false; }
+    const char quote = *p_;
+    ++p_;
+    out->clear();
+    while (p_ != end_ && *p_ != quote) {
+      char c = *p_;
+      ++p_;
+      if (c == '\n') { return false; }
+      if (c == '\\') {
+        if (p_ == end_) { return false; }
+        const char escaped = *p_;
+        ++p_;
+        switch (escaped) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case '\\': case '"': case '\'': c = escaped; break;
+        default: return false;  // octal/hex escapes: let TextFormat handle
+        }
+      }
+      out->push_back(c);
+    }
+    if (p_ == end_) { return false; }
+    ++p_;  // closing quote
+    return true;
+  }
+
+  bool ParseScalar(Message* message, const Reflection* reflection,
+      const FieldDescriptor* field) {
+    if (field->cpp_type() == FieldDescriptor::CPPTYPE_STRING) {
+      std::string value;
+      if (!ReadString(&value)) { return false; }
+      if (field->is_repeated()) {
+        reflection->AddString(message, field, value);
+      } else {
+        reflection->SetString(message, field, value);
+      }
+      return true;
+    }
+    std::string token;
+    if (!ReadToken(&token)) { return false; }
+    const char* s = token.c_str();
+    char* parse_end = NULL;
+    errno = 0;
+    switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32: {
+      const long value = strtol(s, &parse_end, 10);  // NOLINT(runtime/int)
+      if (*parse_end || errno || value < INT_MIN || value > INT_MAX) {
+        return false;
+      }
+      if (field->is_repeated()) {
+        reflection->AddInt32(message, field, value);
+      } else {
+        reflection->SetInt32(message, field, value);
+      }
+      return true;
+    }
+    case FieldDescriptor::CPPTYPE_UINT32: {
+      if (*s == '-') { return false; }
+      const unsigned long value =  // NOLINT(runtime/int)
+          strtoul(s, &parse_end, 10);
+      if (*parse_end || errno || value > UINT_MAX) { return false; }
+      if (field->is_repeated()) {
+        reflection->AddUInt32(message, field, value);
+      } else {
+        reflection->SetUInt32(message, field, value);
+      }
+      return true;
+    }
+    case FieldDescriptor::CPPTYPE_INT64: {
+      const google::protobuf::int64 value = strtoll(s, &parse_end, 10);
+      if (*parse_end || errno) { return false; }
+      if (field->is_repeated()) {
+        reflection->AddInt64(message, field, value);
+      } else {
+        reflection->SetInt64(message, field, value);
+      }
+      return true;
+    }
+    case FieldDescriptor::CPPTYPE_UINT64: {
+      if (*s == '-') { return false; }
+      const google::protobuf::uint64 value = strtoull(s, &parse_end, 10);
+      if (*parse_end || errno) { return false; }
+      if (field->is_repeated()) {
+        reflection->AddUInt64(message, field, value);
+      } else {
+        reflection->SetUInt64(message, field, value);
+      }
+      return true;
+    }
+    case FieldDescriptor::CPPTYPE_FLOAT:
+    case FieldDescriptor::CPPTYPE_DOUBLE: {
+      const double value = strtod(s, &parse_end);
+      if (*parse_end || errno) { return false; }
+      if (field->cpp_type() == FieldDescriptor::CPPTYPE_FLOAT) {
+        if (field->is_repeated()) {
+          reflection->AddFloat(message, field, value);
+        } else {
+          reflection->SetFloat(message, field, value);
+        }
+      } else if (field->is_repeated()) {
+        reflection->AddDouble(message, field, value);
+      } else {
+        reflection->SetDouble(message, field, value);
+      }
+      return true;
+    }
+    case FieldDescriptor::CPPTYPE_BOOL: {
+      bool value;
+      if (token == "true" || token == "1") {
+        value = true;
+      } else if (token == "false" || token == "0") {
+        value = false;
+      } else {
+        return false;
+      }
+      if (field->is_repeated()) {
+        reflection->AddBool(message, field, value);
+      } else {
+        reflection->SetBool(message, field, value);
+      }
+      return true;
+    }
+    case FieldDescriptor::CPPTYPE_ENUM: {
+      const EnumValueDescriptor* value = NULL;
+      if (*s == '-' || isdigit(static_cast<unsigned char>(*s))) {
+        const long number = strtol(s, &parse_end, 10);  // NOLINT(runtime/int)
+        if (*parse_end || errno) { return false; }
+        value = field->enum_type()->FindValueByNumber(number);
+      } else {
+        value = field->enum_type()->FindValueByName(token);
+      }
+      if (value == NULL) { return false; }
+      if (field->is_repeated()) {
+        reflection->AddEnum(message, field, value);
+      } else {
+        reflection->SetEnum(message, field, value);
+      }
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+
+  const char* p_;
+  const char* end_;
+};
+
+}  // namespace
+
+bool ParsePrototxtFast(const std::string& text, Message* message) {
+  Parser parser(text.data(), text.data() + text.size());
+  return parser.ParseMessage(message, '\0');
+}
+
+}  // namespace caffe
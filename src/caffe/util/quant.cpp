@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/quant.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+Dtype caffe_cpu_max_abs(const int n, const Dtype* x) {
+  Dtype max_abs = 0;
+  for (int i = 0; i < n; ++i) {
+    const Dtype abs = x[i] < 0 ? -x[i] : x[i];
+    if (abs > max_abs) { max_abs = abs; }
+  }
+  return max_abs;
+}
+
+template float caffe_cpu_max_abs<float>(const int n, const float* x);
+template double caffe_cpu_max_abs<double>(const int n, const double* x);
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const Dtype scale,
+    int8_t* y) {
+  const Dtype inv_scale = scale > 0 ? Dtype(1) / scale : Dtype(0);
+  for (int i = 0; i < n; ++i) {
+    Dtype q = x[i] * inv_scale;
+    q = q < 0 ? q - Dtype(0.5) : q + Dtype(0.5);
+    int v = static_cast<int>(q);
+    v = std::min(127, std::max(-127, v));
+    y[i] = static_cast<int8_t>(v);
+  }
+}
+
+template void caffe_cpu_quantize<float>(const int n, const float* x,
+    const float scale, int8_t* y);
+template void caffe_cpu_quantize<double>(const int n, const double* x,
+    const double scale, int8_t* y);
+
+void caffe_cpu_igemm_nt(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int* C) {
+  for (int m = 0; m < M; ++m) {
+    const int8_t* a_row = A + m * K;
+    for (int n = 0; n < N; ++n) {
+      const int8_t* b_row = B + n * K;
+      int acc = 0;
+      for (int k = 0; k < K; ++k) {
+        acc += static_cast<int>(a_row[k]) * static_cast<int>(b_row[k]);
+      }
+      C[m * N + n] = acc;
+    }
+  }
+}
+
+void caffe_cpu_igemm_nn(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int* C) {
+  std::fill(C, C + M * N, 0);
+  for (int m = 0; m < M; ++m) {
+    int* c_row = C + m * N;
+    for (int k = 0; k < K; ++k) {
+      const int a = A[m * K + k];
+      if (a == 0) { continue; }
+      const int8_t* b_row = B + k * N;
+      for (int n = 0; n < N; ++n) {
+        c_row[n] += a * static_cast<int>(b_row[n]);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+bool QuantState<Dtype>::ObserveInput(const int n, const Dtype* x) {
+  if (!enabled_) { return false; }
+  if (ready_) { return true; }
+  input_max_ = std::max(input_max_, caffe_cpu_max_abs(n, x));
+  if (calibration_left_ > 0) { --calibration_left_; }
+  if (calibration_left_ > 0 || input_max_ == 0) {
+    // Keep calibrating until the range is fixed; an all-zero range would
+    // make the scale degenerate, so zero inputs extend calibration.
+    return false;
+  }
+  input_scale_ = input_max_ / 127;
+  ready_ = true;
+  return false;
+}
+
+template <typename Dtype>
+void QuantState<Dtype>::QuantizeWeights(const int rows, const int cols,
+    const Dtype* w) {
+  if (weights_ready_) { return; }
+  weights_q_.resize(rows * cols);
+  weight_scales_.resize(rows);
+  for (int r = 0; r < rows; ++r) {
+    const Dtype scale = caffe_cpu_max_abs(cols, w + r * cols) / 127;
+    weight_scales_[r] = scale;
+    caffe_cpu_quantize(cols, w + r * cols, scale, &weights_q_[r * cols]);
+  }
+  weights_ready_ = true;
+}
+
+INSTANTIATE_CLASS(QuantState);
+
+}  // namespace caffe
@@ -0,0 +1,197 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/shared_weights.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+struct SharedWeights<Dtype>::Header {
+  uint64_t magic;
+  uint64_t count;
+  uint64_t element_size;
+  volatile uint64_t generation;
+};
+
+// "caffeshw" -- identifies the segment format.
+static const uint64_t kSharedWeightsMagic = 0x6361666665736877ULL;
+
+// A name with a directory component is a filesystem path and backs the
+// segment with a regular file; a bare "/name" is a POSIX shm object.
+static bool is_file_backed(const string& name) {
+  return name.find('/', 1) != string::npos;
+}
+
+static int segment_open(const string& name, int oflag, mode_t mode) {
+  if (is_file_backed(name)) {
+    return open(name.c_str(), oflag, mode);
+  }
+  return shm_open(name.c_str(), oflag, mode);
+}
+
+static void segment_unlink(const string& name) {
+  if (is_file_backed(name)) {
+    unlink(name.c_str());
+  } else {
+    shm_unlink(name.c_str());
+  }
+}
+
+template <typename Dtype>
+SharedWeights<Dtype>::SharedWeights(const string& name, bool owner)
+    : name_(name),
+      owner_(owner),
+      fd_(-1),
+      mapped_(NULL),
+      mapped_size_(0),
+      count_(0),
+      data_(NULL),
+      header_(NULL) {
+}
+
+template <typename Dtype>
+SharedWeights<Dtype>::~SharedWeights() {
+  if (mapped_) {
+    munmap(mapped_, mapped_size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (owner_) {
+    segment_unlink(name_);
+  }
+}
+
+template <typename Dtype>
+void SharedWeights<Dtype>::MapCreated(size_t count) {
+  mapped_size_ = sizeof(Header) + count * sizeof(Dtype);
+  CHECK_EQ(ftruncate(fd_, mapped_size_), 0)
+      << "Failed to size shared segment " << name_;
+  mapped_ = mmap(NULL, mapped_size_,
+      PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  CHECK_NE(mapped_, MAP_FAILED)
+      << "Failed to map shared segment " << name_;
+  header_ = reinterpret_cast<Header*>(mapped_);
+  header_->count = count;
+  header_->element_size = sizeof(Dtype);
+  header_->generation = 0;
+  // The magic goes in last: a reader that finds it can trust the rest.
+  __sync_synchronize();
+  header_->magic = kSharedWeightsMagic;
+  count_ = count;
+  data_ = reinterpret_cast<Dtype*>(header_ + 1);
+}
+
+template <typename Dtype>
+shared_ptr<SharedWeights<Dtype> > SharedWeights<Dtype>::Create(
+    const string& name, size_t count) {
+  shared_ptr<SharedWeights> segment(new SharedWeights(name, true));
+  segment->fd_ = segment_open(name, O_CREAT | O_RDWR, 0644);
+  CHECK_GE(segment->fd_, 0) << "Failed to create shared segment " << name;
+  segment->MapCreated(count);
+  return segment;
+}
+
+template <typename Dtype>
+shared_ptr<SharedWeights<Dtype> > SharedWeights<Dtype>::CreateExclusive(
+    const string& name, size_t count) {
+  shared_ptr<SharedWeights> segment(new SharedWeights(name, true));
+  segment->fd_ = segment_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (segment->fd_ < 0 && errno == EEXIST) {
+    segment->owner_ = false;  // the segment belongs to whoever raced us
+    return shared_ptr<SharedWeights>();
+  }
+  CHECK_GE(segment->fd_, 0) << "Failed to create shared segment " << name;
+  segment->MapCreated(count);
+  return segment;
+}
+
+template <typename Dtype>
+shared_ptr<SharedWeights<Dtype> > SharedWeights<Dtype>::OpenWhenReady(
+    const string& name) {
+  // The creator writes the magic last and publishes under the seqlock,
+  // so a valid magic plus a nonzero even generation means a complete
+  // payload is in place. Until then the creator is still loading.
+  while (true) {
+    int fd = segment_open(name, O_RDONLY, 0);
+    if (fd >= 0) {
+      struct stat st;
+      Header header;
+      if (fstat(fd, &st) == 0 &&
+          st.st_size >= static_cast<off_t>(sizeof(Header)) &&
+          pread(fd, &header, sizeof(header), 0) ==
+              static_cast<ssize_t>(sizeof(header)) &&
+          header.magic == kSharedWeightsMagic &&
+          header.generation >= 2 && header.generation % 2 == 0) {
+        close(fd);
+        return Open(name);
+      }
+      close(fd);
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+}
+
+template <typename Dtype>
+shared_ptr<SharedWeights<Dtype> > SharedWeights<Dtype>::Open(
+    const string& name) {
+  shared_ptr<SharedWeights> segment(new SharedWeights(name, false));
+  segment->fd_ = segment_open(name, O_RDONLY, 0);
+  CHECK_GE(segment->fd_, 0) << "No shared weight segment " << name
+      << "; is the publisher running?";
+  struct stat st;
+  CHECK_EQ(fstat(segment->fd_, &st), 0);
+  segment->mapped_size_ = st.st_size;
+  CHECK_GE(segment->mapped_size_, sizeof(Header))
+      << "Shared segment " << name << " is truncated";
+  segment->mapped_ = mmap(NULL, segment->mapped_size_, PROT_READ,
+      MAP_SHARED, segment->fd_, 0);
+  CHECK_NE(segment->mapped_, MAP_FAILED)
+      << "Failed to map shared segment " << name;
+  segment->header_ = reinterpret_cast<Header*>(segment->mapped_);
+  CHECK_EQ(segment->header_->magic, kSharedWeightsMagic)
+      << "Shared segment " << name << " is not a weight segment";
+  CHECK_EQ(segment->header_->element_size, sizeof(Dtype))
+      << "Shared segment " << name << " holds a different element type";
+  segment->count_ = segment->header_->count;
+  CHECK_EQ(segment->mapped_size_,
+           sizeof(Header) + segment->count_ * sizeof(Dtype))
+      << "Shared segment " << name << " size does not match its header";
+  segment->data_ = reinterpret_cast<Dtype*>(segment->header_ + 1);
+  return segment;
+}
+
+template <typename Dtype>
+void SharedWeights<Dtype>::Publish(const vector<Blob<Dtype>*>& params) {
+  CHECK(owner_) << "Only the creating side may publish";
+  header_->generation++;  // odd: payload in flux
+  __sync_synchronize();
+  size_t offset = 0;
+  for (int i = 0; i < params.size(); ++i) {
+    CHECK_LE(offset + params[i]->count(), count_);
+    caffe_copy(params[i]->count(), params[i]->cpu_data(), data_ + offset);
+    offset += params[i]->count();
+  }
+  CHECK_EQ(offset, count_);
+  __sync_synchronize();
+  header_->generation++;  // even: stable again
+}
+
+template <typename Dtype>
+uint64_t SharedWeights<Dtype>::generation() const {
+  __sync_synchronize();
+  return header_->generation;
+}
+
+INSTANTIATE_CLASS(SharedWeights);
+
+}  // namespace caffe
@@ -9,6 +9,8 @@
 namespace {
   static volatile sig_atomic_t got_sigint = false;
   static volatile sig_atomic_t got_sighup = false;
+  static volatile sig_atomic_t got_sigusr1 = false;
+  static volatile sig_atomic_t got_sigusr2 = false;
   static bool already_hooked_up = false;
 
   void handle_signal(int signal) {
@@ -19,6 +21,12 @@ namespace {
     case SIGINT:
       got_sigint = true;
       break;
+    case SIGUSR1:
+      got_sigusr1 = true;
+      break;
+    case SIGUSR2:
+      got_sigusr2 = true;
+      break;
     }
   }
 
@@ -35,13 +43,19 @@ namespace {
     sa.sa_flags = SA_RESTART;
     // Block every signal during the handler
     sigfillset(&sa.sa_mask);
-    // Intercept SIGHUP and SIGINT
+    // Intercept SIGHUP, SIGINT and SIGUSR1
     if (sigaction(SIGHUP, &sa, NULL) == -1) {
       LOG(FATAL) << "Cannot install SIGHUP handler.";
     }
     if (sigaction(SIGINT, &sa, NULL) == -1) {
       LOG(FATAL) << "Cannot install SIGINT handler.";
     }
+    if (sigaction(SIGUSR1, &sa, NULL) == -1) {
+      LOG(FATAL) << "Cannot install SIGUSR1 handler.";
+    }
+    if (sigaction(SIGUSR2, &sa, NULL) == -1) {
+      LOG(FATAL) << "Cannot install SIGUSR2 handler.";
+    }
   }
 
   // Set the signal handlers to the default.
@@ -54,13 +68,19 @@ namespace {
       sa.sa_flags = SA_RESTART;
       // Block every signal during the handler
       sigfillset(&sa.sa_mask);
-      // Intercept SIGHUP and SIGINT
+      // Intercept SIGHUP, SIGINT and SIGUSR1
       if (sigaction(SIGHUP, &sa, NULL) == -1) {
         LOG(FATAL) << "Cannot uninstall SIGHUP handler.";
       }
       if (sigaction(SIGINT, &sa, NULL) == -1) {
         LOG(FATAL) << "Cannot uninstall SIGINT handler.";
       }
+      if (sigaction(SIGUSR1, &sa, NULL) == -1) {
+        LOG(FATAL) << "Cannot uninstall SIGUSR1 handler.";
+      }
+      if (sigaction(SIGUSR2, &sa, NULL) == -1) {
+        LOG(FATAL) << "Cannot uninstall SIGUSR2 handler.";
+      }
 
       already_hooked_up = false;
     }
@@ -81,6 +101,22 @@ namespace {
     got_sighup = false;
     return result;
   }
+
+  // Return true iff a SIGUSR1 has been received since the last time
+  // this function was called.
+  bool GotSIGUSR1() {
+    bool result = got_sigusr1;
+    got_sigusr1 = false;
+    return result;
+  }
+
+  // Return true iff a SIGUSR2 has been received since the last time
+  // this function was called.
+  bool GotSIGUSR2() {
+    bool result = got_sigusr2;
+    got_sigusr2 = false;
+    return result;
+  }
 }  // namespace
 
 namespace caffe {
@@ -112,4 +148,21 @@ ActionCallback SignalHandler::GetActionFunction() {
   return boost::bind(&SignalHandler::CheckForSignals, this);
 }
 
+bool SignalHandler::GotTraceRequest() {
+  return GotSIGUSR1();
+}
+
+bool SignalHandler::GotProfileRequest() {
+  return GotSIGUSR2();
+}
+
+bool SignalHandler::ActionPending() {
+  if (!already_hooked_up) {
+    // Nothing maintains the flags, so the caller has to fall back to
+    // polling its callback.
+    return true;
+  }
+  return got_sigint || got_sighup;
+}
+
 }  // namespace caffe
@@ -0,0 +1,779 @@
+#include "caffe/util/simd_math.hpp"
+
+#ifdef CAFFE_SIMD_MATH
+
+#include <immintrin.h>
+#include <math.h>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+namespace {
+
+enum SimdLevel { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+SimdLevel detect_simd_level() {
+  __builtin_cpu_init();
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+  if (__builtin_cpu_supports("avx512f")) { return SIMD_AVX512; }
+#endif
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SIMD_AVX2;
+  }
+  return SIMD_SCALAR;
+}
+
+SimdLevel simd_level() {
+  static SimdLevel level = detect_simd_level();
+  return level;
+}
+
+// Binary kernels: 8-wide AVX2 and 16-wide AVX-512 bodies with a scalar
+// tail. The loads and stores are unaligned; SyncedMemory allocations are
+// aligned anyway and the unaligned forms cost nothing on aligned data.
+#define DEFINE_SIMD_BINARY(name, scalar_op, mm_op) \
+  __attribute__((target("avx2,fma"))) \
+  void name##_avx2(const int n, const float* a, const float* b, float* y) { \
+    int i = 0; \
+    for (; i + 8 <= n; i += 8) { \
+      _mm256_storeu_ps(y + i, _mm256_##mm_op##_ps( \
+          _mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))); \
+    } \
+    for (; i < n; ++i) { y[i] = a[i] scalar_op b[i]; } \
+  } \
+  __attribute__((target("avx512f"))) \
+  void name##_avx512(const int n, const float* a, const float* b, \
+      float* y) { \
+    int i = 0; \
+    for (; i + 16 <= n; i += 16) { \
+      _mm512_storeu_ps(y + i, _mm512_##mm_op##_ps( \
+          _mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))); \
+    } \
+    if (i < n) { \
+      const __mmask16 tail = (1 << (n - i)) - 1; \
+      _mm512_mask_storeu_ps(y + i, tail, _mm512_##mm_op##_ps( \
+          _mm512_maskz_loadu_ps(tail, a + i), \
+          _mm512_maskz_loadu_ps(tail, b + i))); \
+    } \
+  }
+
+DEFINE_SIMD_BINARY(simd_add, +, add)
+DEFINE_SIMD_BINARY(simd_sub, -, sub)
+DEFINE_SIMD_BINARY(simd_mul, *, mul)
+DEFINE_SIMD_BINARY(simd_div, /, div)
+
+// exp via the Cephes polynomial: exp(x) = 2^k * exp(r) with
+// r = x - k * ln(2) reduced to [-ln(2)/2, ln(2)/2] and exp(r) a degree-5
+// polynomial. Matches expf to a couple of ulps over the clamped range.
+#define CAFFE_EXP_HI 88.3762626647949f
+#define CAFFE_EXP_LO -87.3365478515625f
+#define CAFFE_LOG2E 1.44269504088896341f
+#define CAFFE_EXP_C1 0.693359375f
+#define CAFFE_EXP_C2 -2.12194440e-4f
+#define CAFFE_EXP_P0 1.9875691500e-4f
+#define CAFFE_EXP_P1 1.3981999507e-3f
+#define CAFFE_EXP_P2 8.3334519073e-3f
+#define CAFFE_EXP_P3 4.1665795894e-2f
+#define CAFFE_EXP_P4 1.6666665459e-1f
+#define CAFFE_EXP_P5 5.0000001201e-1f
+
+__attribute__((target("avx2,fma")))
+__m256 exp_ps_avx2(__m256 x) {
+  x = _mm256_min_ps(x, _mm256_set1_ps(CAFFE_EXP_HI));
+  x = _mm256_max_ps(x, _mm256_set1_ps(CAFFE_EXP_LO));
+  __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x,
+      _mm256_set1_ps(CAFFE_LOG2E), _mm256_set1_ps(0.5f)));
+  x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(CAFFE_EXP_C1), x);
+  x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(CAFFE_EXP_C2), x);
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 y = _mm256_set1_ps(CAFFE_EXP_P0);
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_EXP_P1));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_EXP_P2));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_EXP_P3));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_EXP_P4));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_EXP_P5));
+  y = _mm256_add_ps(_mm256_fmadd_ps(y, z, x), _mm256_set1_ps(1.0f));
+  // 2^k through the float exponent field.
+  const __m256i k = _mm256_add_epi32(_mm256_cvtps_epi32(fx),
+      _mm256_set1_epi32(127));
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(k, 23)));
+}
+
+__attribute__((target("avx2,fma")))
+void simd_exp_avx2(const int n, const float* a, float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, exp_ps_avx2(_mm256_loadu_ps(a + i)));
+  }
+  if (i < n) {
+    float buf[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    for (int j = 0; i + j < n; ++j) { buf[j] = a[i + j]; }
+    _mm256_storeu_ps(buf, exp_ps_avx2(_mm256_loadu_ps(buf)));
+    for (int j = 0; i + j < n; ++j) { y[i + j] = buf[j]; }
+  }
+}
+
+__attribute__((target("avx512f")))
+__m512 exp_ps_avx512(__m512 x) {
+  x = _mm512_min_ps(x, _mm512_set1_ps(CAFFE_EXP_HI));
+  x = _mm512_max_ps(x, _mm512_set1_ps(CAFFE_EXP_LO));
+  __m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x,
+      _mm512_set1_ps(CAFFE_LOG2E), _mm512_set1_ps(0.5f)),
+      _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+  x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(CAFFE_EXP_C1), x);
+  x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(CAFFE_EXP_C2), x);
+  const __m512 z = _mm512_mul_ps(x, x);
+  __m512 y = _mm512_set1_ps(CAFFE_EXP_P0);
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_EXP_P1));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_EXP_P2));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_EXP_P3));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_EXP_P4));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_EXP_P5));
+  y = _mm512_add_ps(_mm512_fmadd_ps(y, z, x), _mm512_set1_ps(1.0f));
+  const __m512i k = _mm512_add_epi32(_mm512_cvtps_epi32(fx),
+      _mm512_set1_epi32(127));
+  return _mm512_mul_ps(y, _mm512_castsi512_ps(_mm512_slli_epi32(k, 23)));
+}
+
+__attribute__((target("avx512f")))
+void simd_exp_avx512(const int n, const float* a, float* y) {
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, exp_ps_avx512(_mm512_loadu_ps(a + i)));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    _mm512_mask_storeu_ps(y + i, tail,
+        exp_ps_avx512(_mm512_maskz_loadu_ps(tail, a + i)));
+  }
+}
+
+// log via the Cephes polynomial: x = m * 2^k with m reduced to
+// [sqrt(1/2), sqrt(2)), log(x) = k*ln(2) + log1p(m-1) with a degree-9
+// polynomial for log1p. Inputs are clamped to [floor, +inf) first (the
+// callers' log(max(p, threshold)) idiom), so the kernel never sees
+// zeros, negatives or denormals. Matches logf to a couple of ulps.
+#define CAFFE_SQRTHF 0.707106781186547524f
+#define CAFFE_LOG_P0 7.0376836292e-2f
+#define CAFFE_LOG_P1 -1.1514610310e-1f
+#define CAFFE_LOG_P2 1.1676998740e-1f
+#define CAFFE_LOG_P3 -1.2420140846e-1f
+#define CAFFE_LOG_P4 1.4249322787e-1f
+#define CAFFE_LOG_P5 -1.6668057665e-1f
+#define CAFFE_LOG_P6 2.0000714765e-1f
+#define CAFFE_LOG_P7 -2.4999993993e-1f
+#define CAFFE_LOG_P8 3.3333331174e-1f
+#define CAFFE_LOG_Q1 -2.12194440e-4f
+#define CAFFE_LOG_Q2 0.693359375f
+
+__attribute__((target("avx2,fma")))
+__m256 log_ps_avx2(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  // Exponent and mantissa renormalized into [0.5, 1).
+  __m256i emm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+  emm0 = _mm256_sub_epi32(emm0, _mm256_set1_epi32(127));
+  __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(emm0), one);
+  x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x007fffff)));
+  x = _mm256_or_ps(x, _mm256_set1_ps(0.5f));
+  // Mantissas below sqrt(1/2) double and drop one from the exponent,
+  // keeping the polynomial argument centered on zero.
+  const __m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(CAFFE_SQRTHF),
+      _CMP_LT_OQ);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_sub_ps(_mm256_add_ps(x, _mm256_and_ps(x, mask)), one);
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 y = _mm256_set1_ps(CAFFE_LOG_P0);
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P1));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P2));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P3));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P4));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P5));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P6));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P7));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(CAFFE_LOG_P8));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(CAFFE_LOG_Q1), y);
+  y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+  x = _mm256_add_ps(x, y);
+  return _mm256_fmadd_ps(e, _mm256_set1_ps(CAFFE_LOG_Q2), x);
+}
+
+__attribute__((target("avx2,fma")))
+void simd_clipped_log_avx2(const int n, const float* x, const float floor,
+    float* y) {
+  const __m256 vfloor = _mm256_set1_ps(floor);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i,
+        log_ps_avx2(_mm256_max_ps(_mm256_loadu_ps(x + i), vfloor)));
+  }
+  for (; i < n; ++i) { y[i] = logf(x[i] > floor ? x[i] : floor); }
+}
+
+__attribute__((target("avx512f")))
+__m512 log_ps_avx512(__m512 x) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  __m512i emm0 = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+  emm0 = _mm512_sub_epi32(emm0, _mm512_set1_epi32(127));
+  __m512 e = _mm512_add_ps(_mm512_cvtepi32_ps(emm0), one);
+  // AVX-512F lacks _mm512_and_ps; mask the mantissa in the integer
+  // domain (0x3f000000 is 0.5f).
+  x = _mm512_castsi512_ps(_mm512_or_si512(
+      _mm512_and_si512(_mm512_castps_si512(x),
+          _mm512_set1_epi32(0x007fffff)),
+      _mm512_set1_epi32(0x3f000000)));
+  const __mmask16 mask = _mm512_cmp_ps_mask(x,
+      _mm512_set1_ps(CAFFE_SQRTHF), _CMP_LT_OQ);
+  e = _mm512_mask_sub_ps(e, mask, e, one);
+  x = _mm512_mask_add_ps(x, mask, x, x);
+  x = _mm512_sub_ps(x, one);
+  const __m512 z = _mm512_mul_ps(x, x);
+  __m512 y = _mm512_set1_ps(CAFFE_LOG_P0);
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P1));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P2));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P3));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P4));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P5));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P6));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P7));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(CAFFE_LOG_P8));
+  y = _mm512_mul_ps(_mm512_mul_ps(y, x), z);
+  y = _mm512_fmadd_ps(e, _mm512_set1_ps(CAFFE_LOG_Q1), y);
+  y = _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), z, y);
+  x = _mm512_add_ps(x, y);
+  return _mm512_fmadd_ps(e, _mm512_set1_ps(CAFFE_LOG_Q2), x);
+}
+
+__attribute__((target("avx512f")))
+void simd_clipped_log_avx512(const int n, const float* x, const float floor,
+    float* y) {
+  const __m512 vfloor = _mm512_set1_ps(floor);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i,
+        log_ps_avx512(_mm512_max_ps(_mm512_loadu_ps(x + i), vfloor)));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    // Masked-off lanes load as zero; the floor clamp keeps them out of
+    // the polynomial's singularity.
+    _mm512_mask_storeu_ps(y + i, tail, log_ps_avx512(
+        _mm512_max_ps(_mm512_maskz_loadu_ps(tail, x + i), vfloor)));
+  }
+}
+
+// y = max(x, 0) + negative_slope * min(x, 0)
+__attribute__((target("avx2,fma")))
+void simd_relu_avx2(const int n, const float* x, const float negative_slope,
+    float* y) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 slope = _mm256_set1_ps(negative_slope);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_loadu_ps(x + i);
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(slope, _mm256_min_ps(v, zero),
+        _mm256_max_ps(v, zero)));
+  }
+  for (; i < n; ++i) {
+    y[i] = (x[i] > 0 ? x[i] : 0) + negative_slope * (x[i] < 0 ? x[i] : 0);
+  }
+}
+
+__attribute__((target("avx512f")))
+void simd_relu_avx512(const int n, const float* x,
+    const float negative_slope, float* y) {
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 slope = _mm512_set1_ps(negative_slope);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 v = _mm512_loadu_ps(x + i);
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(slope, _mm512_min_ps(v, zero),
+        _mm512_max_ps(v, zero)));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 v = _mm512_maskz_loadu_ps(tail, x + i);
+    _mm512_mask_storeu_ps(y + i, tail,
+        _mm512_fmadd_ps(slope, _mm512_min_ps(v, zero),
+            _mm512_max_ps(v, zero)));
+  }
+}
+
+// dx = dy where x > 0, negative_slope * dy elsewhere
+__attribute__((target("avx2,fma")))
+void simd_relu_backward_avx2(const int n, const float* dy, const float* x,
+    const float negative_slope, float* dx) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 slope = _mm256_set1_ps(negative_slope);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_loadu_ps(dy + i);
+    const __m256 pos = _mm256_cmp_ps(_mm256_loadu_ps(x + i), zero,
+        _CMP_GT_OQ);
+    _mm256_storeu_ps(dx + i,
+        _mm256_blendv_ps(_mm256_mul_ps(d, slope), d, pos));
+  }
+  for (; i < n; ++i) {
+    dx[i] = dy[i] * (x[i] > 0 ? 1.0f : negative_slope);
+  }
+}
+
+__attribute__((target("avx512f")))
+void simd_relu_backward_avx512(const int n, const float* dy, const float* x,
+    const float negative_slope, float* dx) {
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 slope = _mm512_set1_ps(negative_slope);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 d = _mm512_loadu_ps(dy + i);
+    const __mmask16 pos = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i), zero,
+        _CMP_GT_OQ);
+    _mm512_storeu_ps(dx + i,
+        _mm512_mask_blend_ps(pos, _mm512_mul_ps(d, slope), d));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 d = _mm512_maskz_loadu_ps(tail, dy + i);
+    const __mmask16 pos = _mm512_cmp_ps_mask(
+        _mm512_maskz_loadu_ps(tail, x + i), zero, _CMP_GT_OQ);
+    _mm512_mask_storeu_ps(dx + i, tail,
+        _mm512_mask_blend_ps(pos, _mm512_mul_ps(d, slope), d));
+  }
+}
+
+// y = 1 / (1 + exp(-x))
+__attribute__((target("avx2,fma")))
+void simd_sigmoid_avx2(const int n, const float* x, float* y) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 e = exp_ps_avx2(_mm256_sub_ps(_mm256_setzero_ps(),
+        _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(y + i, _mm256_div_ps(one, _mm256_add_ps(e, one)));
+  }
+  for (; i < n; ++i) { y[i] = 1.0f / (1.0f + expf(-x[i])); }
+}
+
+__attribute__((target("avx512f")))
+void simd_sigmoid_avx512(const int n, const float* x, float* y) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 e = exp_ps_avx512(_mm512_sub_ps(_mm512_setzero_ps(),
+        _mm512_loadu_ps(x + i)));
+    _mm512_storeu_ps(y + i, _mm512_div_ps(one, _mm512_add_ps(e, one)));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 e = exp_ps_avx512(_mm512_sub_ps(_mm512_setzero_ps(),
+        _mm512_maskz_loadu_ps(tail, x + i)));
+    _mm512_mask_storeu_ps(y + i, tail,
+        _mm512_div_ps(one, _mm512_add_ps(e, one)));
+  }
+}
+
+// dx = dy * y * (1 - y), with y the forward output
+__attribute__((target("avx2,fma")))
+void simd_sigmoid_backward_avx2(const int n, const float* dy,
+    const float* y, float* dx) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 s = _mm256_loadu_ps(y + i);
+    // y - y * y in one fnmadd
+    const __m256 g = _mm256_fnmadd_ps(s, s, s);
+    _mm256_storeu_ps(dx + i, _mm256_mul_ps(_mm256_loadu_ps(dy + i), g));
+  }
+  for (; i < n; ++i) { dx[i] = dy[i] * y[i] * (1.0f - y[i]); }
+}
+
+__attribute__((target("avx512f")))
+void simd_sigmoid_backward_avx512(const int n, const float* dy,
+    const float* y, float* dx) {
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 s = _mm512_loadu_ps(y + i);
+    const __m512 g = _mm512_fnmadd_ps(s, s, s);
+    _mm512_storeu_ps(dx + i, _mm512_mul_ps(_mm512_loadu_ps(dy + i), g));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 s = _mm512_maskz_loadu_ps(tail, y + i);
+    const __m512 g = _mm512_fnmadd_ps(s, s, s);
+    _mm512_mask_storeu_ps(dx + i, tail,
+        _mm512_mul_ps(_mm512_maskz_loadu_ps(tail, dy + i), g));
+  }
+}
+
+// y = (exp(2x) - 1) / (exp(2x) + 1); the clamp inside exp saturates the
+// ratio to +/-1 for large inputs.
+__attribute__((target("avx2,fma")))
+void simd_tanh_avx2(const int n, const float* x, float* y) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 e = exp_ps_avx2(_mm256_mul_ps(two, _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(y + i, _mm256_div_ps(_mm256_sub_ps(e, one),
+        _mm256_add_ps(e, one)));
+  }
+  for (; i < n; ++i) { y[i] = tanhf(x[i]); }
+}
+
+__attribute__((target("avx512f")))
+void simd_tanh_avx512(const int n, const float* x, float* y) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  const __m512 two = _mm512_set1_ps(2.0f);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 e = exp_ps_avx512(_mm512_mul_ps(two,
+        _mm512_loadu_ps(x + i)));
+    _mm512_storeu_ps(y + i, _mm512_div_ps(_mm512_sub_ps(e, one),
+        _mm512_add_ps(e, one)));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 e = exp_ps_avx512(_mm512_mul_ps(two,
+        _mm512_maskz_loadu_ps(tail, x + i)));
+    _mm512_mask_storeu_ps(y + i, tail,
+        _mm512_div_ps(_mm512_sub_ps(e, one), _mm512_add_ps(e, one)));
+  }
+}
+
+// dx = dy * (1 - y * y), with y the forward output
+__attribute__((target("avx2,fma")))
+void simd_tanh_backward_avx2(const int n, const float* dy, const float* y,
+    float* dx) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 t = _mm256_loadu_ps(y + i);
+    const __m256 d = _mm256_loadu_ps(dy + i);
+    _mm256_storeu_ps(dx + i, _mm256_fnmadd_ps(_mm256_mul_ps(t, t), d, d));
+  }
+  for (; i < n; ++i) { dx[i] = dy[i] * (1.0f - y[i] * y[i]); }
+}
+
+__attribute__((target("avx512f")))
+void simd_tanh_backward_avx512(const int n, const float* dy, const float* y,
+    float* dx) {
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 t = _mm512_loadu_ps(y + i);
+    const __m512 d = _mm512_loadu_ps(dy + i);
+    _mm512_storeu_ps(dx + i, _mm512_fnmadd_ps(_mm512_mul_ps(t, t), d, d));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 t = _mm512_maskz_loadu_ps(tail, y + i);
+    const __m512 d = _mm512_maskz_loadu_ps(tail, dy + i);
+    _mm512_mask_storeu_ps(dx + i, tail,
+        _mm512_fnmadd_ps(_mm512_mul_ps(t, t), d, d));
+  }
+}
+
+// Fused sum and sum-of-squares: two vector accumulators per pass, folded
+// horizontally at the end. The callers (BatchNorm statistics) merge the
+// per-slice partials themselves, which keeps the accumulation hierarchical.
+__attribute__((target("avx2,fma")))
+void simd_sum_sumsq_avx2(const int n, const float* x, float* sum,
+    float* sumsq) {
+  __m256 vsum = _mm256_setzero_ps();
+  __m256 vsumsq = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_loadu_ps(x + i);
+    vsum = _mm256_add_ps(vsum, v);
+    vsumsq = _mm256_fmadd_ps(v, v, vsumsq);
+  }
+  float buf[8];
+  float s = 0, ss = 0;
+  _mm256_storeu_ps(buf, vsum);
+  for (int j = 0; j < 8; ++j) { s += buf[j]; }
+  _mm256_storeu_ps(buf, vsumsq);
+  for (int j = 0; j < 8; ++j) { ss += buf[j]; }
+  for (; i < n; ++i) {
+    s += x[i];
+    ss += x[i] * x[i];
+  }
+  *sum = s;
+  *sumsq = ss;
+}
+
+__attribute__((target("avx512f")))
+void simd_sum_sumsq_avx512(const int n, const float* x, float* sum,
+    float* sumsq) {
+  __m512 vsum = _mm512_setzero_ps();
+  __m512 vsumsq = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 v = _mm512_loadu_ps(x + i);
+    vsum = _mm512_add_ps(vsum, v);
+    vsumsq = _mm512_fmadd_ps(v, v, vsumsq);
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 v = _mm512_maskz_loadu_ps(tail, x + i);
+    vsum = _mm512_add_ps(vsum, v);
+    vsumsq = _mm512_fmadd_ps(v, v, vsumsq);
+  }
+  *sum = _mm512_reduce_add_ps(vsum);
+  *sumsq = _mm512_reduce_add_ps(vsumsq);
+}
+
+// Fused difference and sum-of-squares: the difference is squared while
+// still in registers, so the loss reduction costs no extra pass over it.
+__attribute__((target("avx2,fma")))
+void simd_sub_sumsq_avx2(const int n, const float* a, const float* b,
+    float* diff, float* sumsq) {
+  __m256 vsumsq = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i),
+                                   _mm256_loadu_ps(b + i));
+    _mm256_storeu_ps(diff + i, d);
+    vsumsq = _mm256_fmadd_ps(d, d, vsumsq);
+  }
+  float buf[8];
+  float ss = 0;
+  _mm256_storeu_ps(buf, vsumsq);
+  for (int j = 0; j < 8; ++j) { ss += buf[j]; }
+  for (; i < n; ++i) {
+    const float d = a[i] - b[i];
+    diff[i] = d;
+    ss += d * d;
+  }
+  *sumsq = ss;
+}
+
+__attribute__((target("avx512f")))
+void simd_sub_sumsq_avx512(const int n, const float* a, const float* b,
+    float* diff, float* sumsq) {
+  __m512 vsumsq = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i),
+                                   _mm512_loadu_ps(b + i));
+    _mm512_storeu_ps(diff + i, d);
+    vsumsq = _mm512_fmadd_ps(d, d, vsumsq);
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    const __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(tail, a + i),
+                                   _mm512_maskz_loadu_ps(tail, b + i));
+    _mm512_mask_storeu_ps(diff + i, tail, d);
+    vsumsq = _mm512_fmadd_ps(d, d, vsumsq);
+  }
+  *sumsq = _mm512_reduce_add_ps(vsumsq);
+}
+
+// y = a * x + b with broadcast scalars: one fused pass over the tensor
+// slice where a scale followed by a bias add would take two.
+__attribute__((target("avx2,fma")))
+void simd_axpb_avx2(const int n, const float a, const float* x,
+    const float b, float* y) {
+  const __m256 va = _mm256_set1_ps(a);
+  const __m256 vb = _mm256_set1_ps(b);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), vb));
+  }
+  for (; i < n; ++i) { y[i] = a * x[i] + b; }
+}
+
+__attribute__((target("avx512f")))
+void simd_axpb_avx512(const int n, const float a, const float* x,
+    const float b, float* y) {
+  const __m512 va = _mm512_set1_ps(a);
+  const __m512 vb = _mm512_set1_ps(b);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i,
+        _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), vb));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    _mm512_mask_storeu_ps(y + i, tail,
+        _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(tail, x + i), vb));
+  }
+}
+
+__attribute__((target("avx2,fma")))
+void simd_sqr_avx2(const int n, const float* a, float* y) {
+  simd_mul_avx2(n, a, a, y);
+}
+
+__attribute__((target("avx512f")))
+void simd_sqr_avx512(const int n, const float* a, float* y) {
+  simd_mul_avx512(n, a, a, y);
+}
+
+}  // namespace
+
+#define DISPATCH_SIMD_BINARY(name, scalar_op) \
+  void caffe_simd_##name(const int n, const float* a, const float* b, \
+      float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(y); \
+    switch (simd_level()) { \
+    case SIMD_AVX512: simd_##name##_avx512(n, a, b, y); return; \
+    case SIMD_AVX2: simd_##name##_avx2(n, a, b, y); return; \
+    case SIMD_SCALAR: break; \
+    } \
+    for (int i = 0; i < n; ++i) { y[i] = a[i] scalar_op b[i]; } \
+  }
+
+DISPATCH_SIMD_BINARY(add, +)
+DISPATCH_SIMD_BINARY(sub, -)
+DISPATCH_SIMD_BINARY(mul, *)
+DISPATCH_SIMD_BINARY(div, /)
+
+void caffe_simd_axpb(const int n, const float a, const float* x,
+    const float b, float* y) {
+  CHECK_GT(n, 0); CHECK(x); CHECK(y);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_axpb_avx512(n, a, x, b, y); return;
+  case SIMD_AVX2: simd_axpb_avx2(n, a, x, b, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { y[i] = a * x[i] + b; }
+}
+
+void caffe_simd_sqr(const int n, const float* a, float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_sqr_avx512(n, a, y); return;
+  case SIMD_AVX2: simd_sqr_avx2(n, a, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { y[i] = a[i] * a[i]; }
+}
+
+void caffe_simd_sum_sumsq(const int n, const float* x, float* sum,
+    float* sumsq) {
+  CHECK_GT(n, 0); CHECK(x); CHECK(sum); CHECK(sumsq);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_sum_sumsq_avx512(n, x, sum, sumsq); return;
+  case SIMD_AVX2: simd_sum_sumsq_avx2(n, x, sum, sumsq); return;
+  case SIMD_SCALAR: break;
+  }
+  float s = 0, ss = 0;
+  for (int i = 0; i < n; ++i) {
+    s += x[i];
+    ss += x[i] * x[i];
+  }
+  *sum = s;
+  *sumsq = ss;
+}
+
+void caffe_simd_sub_sumsq(const int n, const float* a, const float* b,
+    float* diff, float* sumsq) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(diff); CHECK(sumsq);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_sub_sumsq_avx512(n, a, b, diff, sumsq); return;
+  case SIMD_AVX2: simd_sub_sumsq_avx2(n, a, b, diff, sumsq); return;
+  case SIMD_SCALAR: break;
+  }
+  float ss = 0;
+  for (int i = 0; i < n; ++i) {
+    const float d = a[i] - b[i];
+    diff[i] = d;
+    ss += d * d;
+  }
+  *sumsq = ss;
+}
+
+void caffe_simd_exp(const int n, const float* a, float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_exp_avx512(n, a, y); return;
+  case SIMD_AVX2: simd_exp_avx2(n, a, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { y[i] = expf(a[i]); }
+}
+
+void caffe_simd_clipped_log(const int n, const float* x, const float floor,
+    float* y) {
+  CHECK_GT(n, 0); CHECK(x); CHECK(y); CHECK_GT(floor, 0);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_clipped_log_avx512(n, x, floor, y); return;
+  case SIMD_AVX2: simd_clipped_log_avx2(n, x, floor, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { y[i] = logf(x[i] > floor ? x[i] : floor); }
+}
+
+void caffe_simd_relu(const int n, const float* x, const float negative_slope,
+    float* y) {
+  CHECK_GT(n, 0); CHECK(x); CHECK(y);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_relu_avx512(n, x, negative_slope, y); return;
+  case SIMD_AVX2: simd_relu_avx2(n, x, negative_slope, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) {
+    y[i] = (x[i] > 0 ? x[i] : 0) + negative_slope * (x[i] < 0 ? x[i] : 0);
+  }
+}
+
+void caffe_simd_relu_backward(const int n, const float* dy, const float* x,
+    const float negative_slope, float* dx) {
+  CHECK_GT(n, 0); CHECK(dy); CHECK(x); CHECK(dx);
+  switch (simd_level()) {
+  case SIMD_AVX512:
+    simd_relu_backward_avx512(n, dy, x, negative_slope, dx);
+    return;
+  case SIMD_AVX2:
+    simd_relu_backward_avx2(n, dy, x, negative_slope, dx);
+    return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) {
+    dx[i] = dy[i] * (x[i] > 0 ? 1.0f : negative_slope);
+  }
+}
+
+void caffe_simd_sigmoid(const int n, const float* x, float* y) {
+  CHECK_GT(n, 0); CHECK(x); CHECK(y);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_sigmoid_avx512(n, x, y); return;
+  case SIMD_AVX2: simd_sigmoid_avx2(n, x, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { y[i] = 1.0f / (1.0f + expf(-x[i])); }
+}
+
+void caffe_simd_sigmoid_backward(const int n, const float* dy,
+    const float* y, float* dx) {
+  CHECK_GT(n, 0); CHECK(dy); CHECK(y); CHECK(dx);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_sigmoid_backward_avx512(n, dy, y, dx); return;
+  case SIMD_AVX2: simd_sigmoid_backward_avx2(n, dy, y, dx); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { dx[i] = dy[i] * y[i] * (1.0f - y[i]); }
+}
+
+void caffe_simd_tanh(const int n, const float* x, float* y) {
+  CHECK_GT(n, 0); CHECK(x); CHECK(y);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_tanh_avx512(n, x, y); return;
+  case SIMD_AVX2: simd_tanh_avx2(n, x, y); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { y[i] = tanhf(x[i]); }
+}
+
+void caffe_simd_tanh_backward(const int n, const float* dy, const float* y,
+    float* dx) {
+  CHECK_GT(n, 0); CHECK(dy); CHECK(y); CHECK(dx);
+  switch (simd_level()) {
+  case SIMD_AVX512: simd_tanh_backward_avx512(n, dy, y, dx); return;
+  case SIMD_AVX2: simd_tanh_backward_avx2(n, dy, y, dx); return;
+  case SIMD_SCALAR: break;
+  }
+  for (int i = 0; i < n; ++i) { dx[i] = dy[i] * (1.0f - y[i] * y[i]); }
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_SIMD_MATH
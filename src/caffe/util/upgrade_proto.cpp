@@ -2,6 +2,10 @@
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
 
+#include <stdint.h>
+
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
 #include <map>
 #include <string>
 
@@ -13,11 +17,19 @@
 namespace caffe {
 
 bool NetNeedsUpgrade(const NetParameter& net_param) {
+  if (net_param.schema_version() >= kCurrentNetSchemaVersion) {
+    return false;
+  }
   return NetNeedsV0ToV1Upgrade(net_param) || NetNeedsV1ToV2Upgrade(net_param)
       || NetNeedsDataUpgrade(net_param) || NetNeedsInputUpgrade(net_param);
 }
 
 bool UpgradeNetAsNeeded(const string& param_file, NetParameter* param) {
+  // Current-format nets (upgraded outputs, snapshots, compiled nets) carry
+  // the schema stamp; skip the per-layer deprecation scans for them.
+  if (param->schema_version() >= kCurrentNetSchemaVersion) {
+    return true;
+  }
   bool success = true;
   if (NetNeedsV0ToV1Upgrade(*param)) {
     // NetParameter was specified using the old style (V0LayerParameter); try to
@@ -71,14 +83,109 @@ bool UpgradeNetAsNeeded(const string& param_file, NetParameter* param) {
     LOG(WARNING) << "Note that future Caffe releases will only support "
                  << "input layers and not input fields.";
   }
+  if (success) {
+    param->set_schema_version(kCurrentNetSchemaVersion);
+  }
   return success;
 }
 
+namespace {
+
+bool net_parameter_cache_enabled = false;
+
+// Bump to invalidate caches written before a format or upgrade change.
+const uint64_t kNetParameterCacheVersion = 1;
+
+string NetParameterCachePath(const string& param_file) {
+  return param_file + ".netcache";
+}
+
+// FNV-1a over the prototxt bytes, seeded with the cache version; any
+// edit to the file yields a different key.
+bool HashNetParamsFile(const string& param_file, uint64_t* hash) {
+  std::ifstream file(param_file.c_str(), std::ios::in | std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  uint64_t h = 14695981039346656037ULL ^ kNetParameterCacheVersion;
+  char buffer[4096];
+  while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+    const std::streamsize got = file.gcount();
+    for (std::streamsize i = 0; i < got; ++i) {
+      h ^= static_cast<unsigned char>(buffer[i]);
+      h *= 1099511628211ULL;
+    }
+  }
+  *hash = h;
+  return true;
+}
+
+bool ReadNetParamsFromCache(const string& param_file, uint64_t hash,
+                            NetParameter* param) {
+  NetParameterCache cache;
+  if (!ReadProtoFromBinaryFile(NetParameterCachePath(param_file), &cache)) {
+    return false;
+  }
+  if (cache.source_hash() != hash || !cache.has_net()) {
+    return false;
+  }
+  param->CopyFrom(cache.net());
+  LOG(INFO) << "Read upgraded NetParameter for " << param_file
+            << " from cache.";
+  return true;
+}
+
+// Best-effort: a read-only model directory just means no cache. The
+// write goes through a temporary so concurrent jobs never read a
+// half-written cache.
+void WriteNetParamsToCache(const string& param_file, uint64_t hash,
+                           const NetParameter& param) {
+  NetParameterCache cache;
+  cache.set_source_hash(hash);
+  *cache.mutable_net() = param;
+  string serialized;
+  if (!cache.SerializeToString(&serialized)) {
+    return;
+  }
+  const string cache_file = NetParameterCachePath(param_file);
+  const string tmp_file = cache_file + ".tmp";
+  std::ofstream out(tmp_file.c_str(),
+      std::ios::out | std::ios::trunc | std::ios::binary);
+  out.write(serialized.data(), serialized.size());
+  out.close();
+  if (!out || std::rename(tmp_file.c_str(), cache_file.c_str()) != 0) {
+    LOG(WARNING) << "Could not write NetParameter cache " << cache_file;
+    std::remove(tmp_file.c_str());
+    return;
+  }
+  LOG(INFO) << "Wrote upgraded NetParameter cache " << cache_file;
+}
+
+}  // namespace
+
+void EnableNetParameterCache(bool enable) {
+  net_parameter_cache_enabled = enable;
+}
+
 void ReadNetParamsFromTextFileOrDie(const string& param_file,
                                     NetParameter* param) {
-  CHECK(ReadProtoFromTextFile(param_file, param))
-      << "Failed to parse NetParameter file: " << param_file;
+  uint64_t hash = 0;
+  const bool hashed = net_parameter_cache_enabled &&
+      HashNetParamsFile(param_file, &hash);
+  if (hashed && ReadNetParamsFromCache(param_file, hash, param)) {
+    return;
+  }
+  if (!ReadProtoFromTextFile(param_file, param)) {
+    // A compiled binary NetParameter (`caffe compile`) is accepted
+    // anywhere a prototxt is.
+    param->Clear();
+    CHECK(ReadProtoFromBinaryFile(param_file, param))
+        << "Failed to parse NetParameter file: " << param_file;
+  }
   UpgradeNetAsNeeded(param_file, param);
+  if (hashed) {
+    WriteNetParamsToCache(param_file, hash, *param);
+  }
 }
 
 void ReadNetParamsFromBinaryFileOrDie(const string& param_file,
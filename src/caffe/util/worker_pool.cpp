@@ -0,0 +1,170 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <vector>
+
+#include "caffe/util/worker_pool.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace caffe {
+
+// Per-task state shared between the submitting thread's WorkerHandle
+// and the worker running the task. worker_ points at the running
+// worker's thread object only while the task is in flight, so
+// Interrupt() after completion cannot touch a worker that has moved on
+// to an unrelated task.
+class WorkerHandle::State {
+ public:
+  State() : worker_(NULL), interrupted_(false), done_(false) {}
+
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  boost::function<void()> task_;
+  boost::thread* worker_;
+  // Interrupt() may land before a worker has claimed the task; the
+  // flag makes it stick so the claiming worker self-interrupts.
+  bool interrupted_;
+  bool done_;
+};
+
+WorkerHandle::WorkerHandle() : state_(new State()) {}
+
+WorkerHandle::~WorkerHandle() {}
+
+void WorkerHandle::Interrupt() {
+  boost::mutex::scoped_lock lock(state_->mutex_);
+  state_->interrupted_ = true;
+  if (!state_->done_ && state_->worker_) {
+    state_->worker_->interrupt();
+  }
+}
+
+void WorkerHandle::Join() {
+  boost::mutex::scoped_lock lock(state_->mutex_);
+  while (!state_->done_) {
+    state_->cond_.wait(lock);
+  }
+}
+
+bool WorkerHandle::done() {
+  boost::mutex::scoped_lock lock(state_->mutex_);
+  return state_->done_;
+}
+
+// The process-wide pool behind WorkerPool's static interface. Workers
+// are never torn down: a worker that finishes its task parks on the
+// condition and waits for the next one, and a new thread is spawned
+// only when a task arrives while no worker is idle. Long-running tasks
+// therefore cost one spawn ever, and short tasks reuse warm threads.
+class WorkerPoolImpl {
+ public:
+  WorkerPoolImpl() : idle_(0), next_cpu_(0) {}
+
+  static WorkerPoolImpl& Get() {
+    static WorkerPoolImpl pool;
+    return pool;
+  }
+
+  shared_ptr<WorkerHandle> Submit(const boost::function<void()>& task) {
+    shared_ptr<WorkerHandle> handle(new WorkerHandle());
+    handle->state_->task_ = task;
+    boost::mutex::scoped_lock lock(mutex_);
+    pending_.push_back(handle->state_);
+    // Spawn only when every parked worker already has a task to claim;
+    // this keeps tasks that never return (prefetch loops) from
+    // starving the ones queued behind them.
+    if (idle_ < pending_.size()) {
+      const size_t index = threads_.size();
+      threads_.push_back(shared_ptr<boost::thread>(new boost::thread(
+          boost::bind(&WorkerPoolImpl::WorkerLoop, this, index))));
+      Pin(threads_.back().get());
+    }
+    cond_.notify_one();
+    return handle;
+  }
+
+  void SetAffinity(const std::vector<int>& cpus) {
+    boost::mutex::scoped_lock lock(mutex_);
+    cpus_ = cpus;
+    next_cpu_ = 0;
+  }
+
+ private:
+  // Called with mutex_ held, for a freshly spawned worker.
+  void Pin(boost::thread* thread) {
+#ifdef __linux__
+    if (cpus_.empty()) { return; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus_[next_cpu_ % cpus_.size()], &set);
+    ++next_cpu_;
+    pthread_setaffinity_np(thread->native_handle(), sizeof(set), &set);
+#endif
+  }
+
+  void WorkerLoop(const size_t index) {
+    boost::thread* self = NULL;
+    while (true) {
+      shared_ptr<WorkerHandle::State> state;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        // The spawning Submit holds mutex_ until our thread object is
+        // in threads_, so the entry is valid by our first acquisition.
+        if (!self) { self = threads_[index].get(); }
+        ++idle_;
+        while (pending_.empty()) {
+          cond_.wait(lock);
+        }
+        --idle_;
+        state = pending_.front();
+        pending_.pop_front();
+      }
+      {
+        boost::mutex::scoped_lock lock(state->mutex_);
+        state->worker_ = self;
+        if (state->interrupted_) { self->interrupt(); }
+      }
+      try {
+        state->task_();
+      } catch (boost::thread_interrupted&) {
+      } catch (std::exception& e) {
+        LOG(FATAL) << "Thread exception: " << e.what();
+      }
+      {
+        boost::mutex::scoped_lock lock(state->mutex_);
+        state->worker_ = NULL;
+        state->done_ = true;
+        state->cond_.notify_all();
+      }
+      // A late Interrupt() may have left a request pending after the
+      // task returned; clear it so it cannot fire in the next task.
+      try {
+        boost::this_thread::interruption_point();
+      } catch (boost::thread_interrupted&) {}
+    }
+  }
+
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  std::deque<shared_ptr<WorkerHandle::State> > pending_;
+  size_t idle_;
+  std::vector<shared_ptr<boost::thread> > threads_;
+  std::vector<int> cpus_;
+  size_t next_cpu_;
+};
+
+shared_ptr<WorkerHandle> WorkerPool::Submit(
+    const boost::function<void()>& task) {
+  return WorkerPoolImpl::Get().Submit(task);
+}
+
+void WorkerPool::SetAffinity(const std::vector<int>& cpus) {
+  WorkerPoolImpl::Get().SetAffinity(cpus);
+}
+
+}  // namespace caffe
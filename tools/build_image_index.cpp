@@ -0,0 +1,52 @@
+// This program converts a text image listing (as consumed by ImageDataLayer,
+// one "path label" pair per line) into the compact binary index format
+// loaded by the same layer, avoiding per-entry string parsing at startup.
+// Usage:
+//   build_image_index LISTFILE INDEXFILE
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/image_index.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Convert a text image listing into the binary\n"
+        "index format loaded by ImageDataLayer.\n"
+        "Usage:\n"
+        "    build_image_index LISTFILE INDEXFILE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/build_image_index");
+    return 1;
+  }
+
+  std::ifstream infile(argv[1]);
+  CHECK(infile) << "Could not open " << argv[1];
+  std::vector<std::pair<std::string, int> > lines;
+  std::string filename;
+  int label;
+  while (infile >> filename >> label) {
+    lines.push_back(std::make_pair(filename, label));
+  }
+  CHECK(lines.size()) << "No entries found in " << argv[1];
+
+  ImageIndex::Write(argv[2], lines);
+  LOG(INFO) << "Wrote " << lines.size() << " entries to " << argv[2];
+  return 0;
+}
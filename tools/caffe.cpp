@@ -13,7 +13,11 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/util/signal_handler.h"
+#ifdef USE_CUDNN
+#include "caffe/util/cudnn.hpp"
+#endif
 
 using caffe::Blob;
 using caffe::Caffe;
@@ -34,6 +38,9 @@ DEFINE_string(solver, "",
     "The solver definition protocol buffer text file.");
 DEFINE_string(model, "",
     "The model definition protocol buffer text file..");
+DEFINE_string(output, "",
+    "The output file for the compile command: the model definition "
+    "written as a binary NetParameter.");
 DEFINE_string(snapshot, "",
     "Optional; the snapshot solver state to resume training.");
 DEFINE_string(weights, "",
@@ -44,9 +51,56 @@ DEFINE_int32(iterations, 50,
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
+DEFINE_int32(prefetch_stats_interval, 0,
+    "Optional; if positive, log each data layer's prefetch pipeline "
+    "counters (queue depths, wait times, batches/sec) every that many "
+    "training iterations.");
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_string(capture_replay, "",
+    "Optional; file continuously rewritten each training iteration with "
+    "a ReplayInfo text proto (iteration, host RNG state, data cursor "
+    "positions), so a window of this run can be rerun with --replay.");
+DEFINE_string(replay, "",
+    "Optional; a ReplayInfo file written by --capture_replay. Restores "
+    "the recorded host RNG state and data order and runs --iterations "
+    "iterations instead of the full schedule. Single device only; "
+    "combine with --snapshot or --weights for the captured weights.");
+DEFINE_bool(net_cache, true,
+    "Cache the parsed and upgraded NetParameter beside each prototxt "
+    "(<file>.netcache), keyed by a hash of the text, so unchanged nets "
+    "skip the parse and upgrade passes on later runs.");
+DEFINE_int32(cpu_core_budget, 0,
+    "Optional; cap on the total CPU cores Caffe-managed parallelism may "
+    "use. Per-layer BLAS thread hints (blas_threads), convolution batch "
+    "workers (forward_threads) and the dataflow forward pool "
+    "(forward_parallelism) all clamp to it. 0 means no cap.");
+DEFINE_string(plan, "",
+    "Optional; cuDNN plan cache file. Benchmarked convolution algorithm "
+    "choices are loaded from it at startup (skipping the per-geometry "
+    "benchmarking that dominates job startup) and written back on exit. "
+    "Stamped with the cuDNN version and device name; a plan for a "
+    "different build or device is ignored.");
+
+// Loads the cuDNN plan named by --plan, if any; call once the device
+// has been selected.
+static void LoadPlanCache() {
+#ifdef USE_CUDNN
+  if (FLAGS_plan.size() && Caffe::mode() == Caffe::GPU) {
+    caffe::CuDNNAlgoCacheLoad(FLAGS_plan);
+  }
+#endif
+}
+
+// Writes the (possibly extended) cuDNN algorithm cache back to --plan.
+static void SavePlanCache() {
+#ifdef USE_CUDNN
+  if (FLAGS_plan.size() && Caffe::mode() == Caffe::GPU) {
+    caffe::CuDNNAlgoCacheSave(FLAGS_plan);
+  }
+#endif
+}
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -120,6 +174,20 @@ int device_query() {
 }
 RegisterBrewFunction(device_query);
 
+// Compile: parse (and upgrade) a model definition once and write it back
+// as a binary NetParameter, so production jobs never parse text. The
+// output is accepted anywhere a prototxt is.
+int compile() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to compile.";
+  CHECK_GT(FLAGS_output.size(), 0) << "Need an output file to write.";
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  caffe::WriteProtoToBinaryFile(net_param, FLAGS_output);
+  LOG(INFO) << "Wrote compiled NetParameter to " << FLAGS_output;
+  return 0;
+}
+RegisterBrewFunction(compile);
+
 // Load the weights from the specified caffemodel(s) into the train and
 // test nets.
 void CopyLayers(caffe::Solver<float>* solver, const std::string& model_list) {
@@ -150,6 +218,91 @@ caffe::SolverAction::Enum GetRequestedAction(
   LOG(FATAL) << "Invalid signal effect \""<< flag_value << "\" was specified";
 }
 
+// Logs Net::prefetch_stats() every FLAGS_prefetch_stats_interval training
+// iterations, with wait times and batches/sec computed over the interval.
+class PrefetchStatsDumper : public Solver<float>::Callback {
+ public:
+  explicit PrefetchStatsDumper(Solver<float>* solver)
+      : solver_(solver), iter_(0) {
+    timer_.Start();
+  }
+
+ protected:
+  virtual void on_start() {
+    if (++iter_ % FLAGS_prefetch_stats_interval != 0) {
+      return;
+    }
+    timer_.Stop();
+    const double seconds = timer_.MilliSeconds() / 1000;
+    const std::vector<caffe::PrefetchStats> stats =
+        solver_->net()->prefetch_stats();
+    for (int i = 0; i < stats.size(); ++i) {
+      const caffe::PrefetchStats& s = stats[i];
+      const caffe::PrefetchStats& prev = last_[s.layer_name];
+      ostringstream msg;
+      msg << "Prefetch [" << s.layer_name << "] "
+          << (s.batches_consumed - prev.batches_consumed) / seconds
+          << " batches/s, queue free/full " << s.free_queue_size << "/"
+          << s.full_queue_size;
+      if (s.reader_full_size >= 0) {
+        msg << ", reader free/full " << s.reader_free_size << "/"
+            << s.reader_full_size;
+      }
+      msg << ", producer wait "
+          << (s.producer_wait_us - prev.producer_wait_us) / 1000
+          << " ms, consumer wait "
+          << (s.consumer_wait_us - prev.consumer_wait_us) / 1000 << " ms";
+      LOG(INFO) << msg.str();
+      last_[s.layer_name] = s;
+    }
+    timer_.Start();
+  }
+  virtual void on_gradients_ready() {}
+
+ private:
+  Solver<float>* solver_;
+  int iter_;
+  caffe::CPUTimer timer_;
+  std::map<std::string, caffe::PrefetchStats> last_;
+};
+
+// Rewrites FLAGS_capture_replay before every iteration with the state a
+// replay of that iteration window needs; see ReplayInfo in caffe.proto.
+class ReplayCapture : public Solver<float>::Callback {
+ public:
+  explicit ReplayCapture(Solver<float>* solver) : solver_(solver) {}
+
+ protected:
+  virtual void on_start() {
+    caffe::ReplayInfo info;
+    info.set_iter(solver_->iter());
+    info.set_rng_state(Caffe::rng_state());
+    const std::vector<caffe::PrefetchStats> stats =
+        solver_->net()->prefetch_stats();
+    const std::vector<shared_ptr<Layer<float> > >& layers =
+        solver_->net()->layers();
+    for (int i = 0; i < stats.size(); ++i) {
+      caffe::ReplayInfo::DataCursor* cursor = info.add_cursor();
+      cursor->set_layer_name(stats[i].layer_name);
+      uint64_t batch_size = 0;
+      for (int l = 0; l < layers.size(); ++l) {
+        if (layers[l]->layer_param().name() == stats[i].layer_name) {
+          batch_size = layers[l]->layer_param().data_param().batch_size();
+        }
+      }
+      cursor->set_consumed(stats[i].batches_consumed * batch_size);
+    }
+    // Write-then-rename so a reader never sees a half-written file.
+    const string tmp = FLAGS_capture_replay + ".tmp";
+    caffe::WriteProtoToTextFile(info, tmp);
+    CHECK_EQ(0, rename(tmp.c_str(), FLAGS_capture_replay.c_str()));
+  }
+  virtual void on_gradients_ready() {}
+
+ private:
+  Solver<float>* solver_;
+};
+
 // Train / Finetune a model.
 int train() {
   CHECK_GT(FLAGS_solver.size(), 0) << "Need a solver definition to train.";
@@ -160,6 +313,46 @@ int train() {
   caffe::SolverParameter solver_param;
   caffe::ReadSolverParamsFromTextFileOrDie(FLAGS_solver, &solver_param);
 
+  if (FLAGS_capture_replay.size() && !solver_param.has_random_seed()) {
+    // A captured run must also be reseedable from iteration 0.
+    solver_param.set_random_seed(caffe::caffe_rng_rand());
+    LOG(INFO) << "Capture: fixing random_seed to "
+              << solver_param.random_seed();
+  }
+
+  caffe::ReplayInfo replay_info;
+  if (FLAGS_replay.size()) {
+    caffe::ReadProtoFromTextFileOrDie(FLAGS_replay, &replay_info);
+    // Inline the train net and advance its data layers to the captured
+    // cursor positions before the solver builds it.
+    caffe::NetParameter* net_param = NULL;
+    if (solver_param.has_net()) {
+      caffe::ReadNetParamsFromTextFileOrDie(solver_param.net(),
+          solver_param.mutable_net_param());
+      solver_param.clear_net();
+      net_param = solver_param.mutable_net_param();
+    } else if (solver_param.has_train_net()) {
+      caffe::ReadNetParamsFromTextFileOrDie(solver_param.train_net(),
+          solver_param.mutable_train_net_param());
+      solver_param.clear_train_net();
+      net_param = solver_param.mutable_train_net_param();
+    } else if (solver_param.has_net_param()) {
+      net_param = solver_param.mutable_net_param();
+    } else if (solver_param.has_train_net_param()) {
+      net_param = solver_param.mutable_train_net_param();
+    }
+    CHECK(net_param != NULL) << "--replay: no train net in the solver";
+    for (int i = 0; i < replay_info.cursor_size(); ++i) {
+      const caffe::ReplayInfo::DataCursor& cursor = replay_info.cursor(i);
+      for (int l = 0; l < net_param->layer_size(); ++l) {
+        if (net_param->layer(l).name() == cursor.layer_name()) {
+          net_param->mutable_layer(l)->mutable_data_param()->set_skip(
+              cursor.consumed());
+        }
+      }
+    }
+  }
+
   // If the gpus flag is not provided, allow the mode and device to be set
   // in the solver prototxt.
   if (FLAGS_gpu.size() == 0
@@ -174,6 +367,12 @@ int train() {
 
   vector<int> gpus;
   get_gpus(&gpus);
+#ifdef USE_MPI
+  // When launched under mpirun, every process is one rank of a
+  // multi-node job and takes its own GPU from the -gpu list.
+  shared_ptr<caffe::MPITransport<float> > mpi_transport(
+      new caffe::MPITransport<float>());
+#endif
   if (gpus.size() == 0) {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
@@ -190,12 +389,20 @@ int train() {
       LOG(INFO) << "GPU " << gpus[i] << ": " << device_prop.name;
     }
 #endif
-    solver_param.set_device_id(gpus[0]);
-    Caffe::SetDevice(gpus[0]);
+    int device_index = 0;
+#ifdef USE_MPI
+    if (mpi_transport->size() > 1) {
+      device_index = mpi_transport->rank() % gpus.size();
+    }
+#endif
+    solver_param.set_device_id(gpus[device_index]);
+    Caffe::SetDevice(gpus[device_index]);
     Caffe::set_mode(Caffe::GPU);
     Caffe::set_solver_count(gpus.size());
   }
 
+  LoadPlanCache();
+
   caffe::SignalHandler signal_handler(
         GetRequestedAction(FLAGS_sigint_effect),
         GetRequestedAction(FLAGS_sighup_effect));
@@ -205,6 +412,16 @@ int train() {
 
   solver->SetActionFunction(signal_handler.GetActionFunction());
 
+  PrefetchStatsDumper prefetch_stats(solver.get());
+  if (FLAGS_prefetch_stats_interval > 0) {
+    solver->add_callback(&prefetch_stats);
+  }
+
+  ReplayCapture replay_capture(solver.get());
+  if (FLAGS_capture_replay.size()) {
+    solver->add_callback(&replay_capture);
+  }
+
   if (FLAGS_snapshot.size()) {
     LOG(INFO) << "Resuming from " << FLAGS_snapshot;
     solver->Restore(FLAGS_snapshot.c_str());
@@ -212,14 +429,40 @@ int train() {
     CopyLayers(solver.get(), FLAGS_weights);
   }
 
+#ifdef USE_MPI
+  if (mpi_transport->size() > 1) {
+    caffe::DistributedSync<float> sync(solver, mpi_transport);
+    sync.Run();
+    LOG(INFO) << "Optimization Done.";
+    return 0;
+  }
+#endif
+  if (FLAGS_replay.size()) {
+    CHECK_LE(gpus.size(), 1) << "--replay runs on a single device";
+    // The net is built (its fillers consumed RNG), so the captured
+    // mid-run state can be restored now.
+    Caffe::set_rng_state(replay_info.rng_state());
+    LOG(INFO) << "Replaying " << FLAGS_iterations << " iterations from "
+              << FLAGS_replay << " (captured at iteration "
+              << replay_info.iter() << ")";
+    solver->Step(FLAGS_iterations);
+    LOG(INFO) << "Replay Done.";
+    return 0;
+  }
   if (gpus.size() > 1) {
+#ifdef USE_NCCL
+    caffe::NCCLSync<float> sync(solver, solver->param());
+    sync.Run(gpus);
+#else
     caffe::P2PSync<float> sync(solver, NULL, solver->param());
     sync.Run(gpus);
+#endif
   } else {
     LOG(INFO) << "Starting Optimization";
     solver->Solve();
   }
   LOG(INFO) << "Optimization Done.";
+  SavePlanCache();
   return 0;
 }
 RegisterBrewFunction(train);
@@ -246,9 +489,24 @@ int test() {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
   }
+  LoadPlanCache();
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, caffe::TEST);
-  caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  const std::string shm_prefix("shm://");
+  const std::string shared_prefix("shared://");
+  if (FLAGS_weights.compare(0, shm_prefix.size(), shm_prefix) == 0) {
+    // Map the live weights a training process publishes instead of
+    // reading a snapshot file; see SolverParameter.share_weights_shm.
+    caffe_net.MapSharedWeights(FLAGS_weights.substr(shm_prefix.size()));
+  } else if (FLAGS_weights.compare(0, shared_prefix.size(),
+                                   shared_prefix) == 0) {
+    // One process per box deserializes the model into a file-backed
+    // cache; the rest map it, sharing a single physical copy.
+    caffe_net.CopyTrainedLayersFromShared(
+        FLAGS_weights.substr(shared_prefix.size()));
+  } else {
+    caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
 
   vector<int> test_score_output_id;
@@ -292,6 +550,7 @@ int test() {
     LOG(INFO) << output_name << " = " << mean_score << loss_msg_stream.str();
   }
 
+  SavePlanCache();
   return 0;
 }
 RegisterBrewFunction(test);
@@ -401,6 +660,8 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  caffe::EnableNetParameterCache(FLAGS_net_cache);
+  Caffe::set_cpu_core_budget(FLAGS_cpu_core_budget);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
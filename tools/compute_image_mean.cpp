@@ -1,16 +1,32 @@
+// Computes the mean image of a leveldb/lmdb image database.
+// Usage:
+//   compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]
+//
+// The database is scanned by this thread while --threads workers decode
+// the datums and accumulate sharded partial sums with vectorized adds.
+// --sample_ratio estimates the mean from a random subset and reports
+// the resulting per-channel confidence interval; --channel_mean_only
+// skips the full-resolution accumulation and produces only the three
+// (or one) per-channel means most models actually subtract.
+
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
+#include <deque>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
@@ -20,6 +36,138 @@ using boost::scoped_ptr;
 
 DEFINE_string(backend, "lmdb",
         "The backend {leveldb, lmdb} containing the images");
+DEFINE_int32(threads, 0,
+    "Number of datum decode/accumulate worker threads; 0 means one per "
+    "hardware thread.");
+DEFINE_double(sample_ratio, 1.0,
+    "Fraction of the database to sample, in (0, 1]. Values below 1 "
+    "estimate the mean from a random subset and report the 95% "
+    "confidence interval of each channel mean.");
+DEFINE_bool(channel_mean_only, false,
+    "Compute only the per-channel means, skipping the full-resolution "
+    "mean image; OUTPUT_FILE then holds a 1 x channels x 1 x 1 blob.");
+
+#ifdef USE_OPENCV
+namespace {
+
+// Fixed-capacity handoff from the database scan to the workers, holding
+// serialized datums; the bound caps memory when decoding falls behind.
+class ValueQueue {
+ public:
+  explicit ValueQueue(size_t capacity) : capacity_(capacity) {}
+  void Push(std::string* value) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.size() >= capacity_) {
+      not_full_.wait(lock);
+    }
+    queue_.push_back(value);
+    not_empty_.notify_one();
+  }
+  std::string* Pop() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.empty()) {
+      not_empty_.wait(lock);
+    }
+    std::string* value = queue_.front();
+    queue_.pop_front();
+    not_full_.notify_one();
+    return value;
+  }
+
+ private:
+  const size_t capacity_;
+  boost::mutex mutex_;
+  boost::condition_variable not_empty_, not_full_;
+  std::deque<std::string*> queue_;
+};
+
+// One worker's shard of the accumulation, merged after the join.
+struct MeanShard {
+  MeanShard() : count(0) {}
+  std::vector<double> sum;  // full-resolution; empty in channel-only mode
+  // Per-channel totals, plus the sum and sum of squares of per-image
+  // channel means, from which sampling error is estimated.
+  std::vector<double> channel_sum;
+  std::vector<double> image_mean_sum, image_mean_sumsq;
+  size_t count;
+};
+
+struct MeanContext {
+  ValueQueue* queue;
+  int channels, dim, data_size;
+  bool channel_mean_only;
+  std::vector<MeanShard> shards;
+};
+
+// Pops serialized datums until the NULL sentinel, decoding and
+// accumulating into this worker's shard. Images are staged as float so
+// the full-resolution add is a single SIMD axpy; the float partial sum
+// is folded into doubles periodically to keep precision over large
+// databases.
+void AccumulateWorker(MeanContext* ctx, int worker) {
+  const int kFoldInterval = 1024;
+  MeanShard& shard = ctx->shards[worker];
+  shard.channel_sum.assign(ctx->channels, 0.);
+  shard.image_mean_sum.assign(ctx->channels, 0.);
+  shard.image_mean_sumsq.assign(ctx->channels, 0.);
+  std::vector<float> scratch(ctx->data_size);
+  std::vector<float> partial;
+  if (!ctx->channel_mean_only) {
+    shard.sum.assign(ctx->data_size, 0.);
+    partial.assign(ctx->data_size, 0.f);
+  }
+  int unfolded = 0;
+  while (true) {
+    std::string* value = ctx->queue->Pop();
+    if (value == NULL) { break; }
+    Datum datum;
+    CHECK(datum.ParseFromString(*value));
+    delete value;
+    DecodeDatumNative(&datum);
+    const std::string& data = datum.data();
+    const int size_in_datum = std::max<int>(datum.data().size(),
+        datum.float_data_size());
+    CHECK_EQ(size_in_datum, ctx->data_size) << "Incorrect data field size "
+        << size_in_datum;
+    if (data.size() != 0) {
+      for (int i = 0; i < size_in_datum; ++i) {
+        scratch[i] = static_cast<uint8_t>(data[i]);
+      }
+    } else {
+      CHECK_EQ(datum.float_data_size(), size_in_datum);
+      for (int i = 0; i < size_in_datum; ++i) {
+        scratch[i] = datum.float_data(i);
+      }
+    }
+    if (!ctx->channel_mean_only) {
+      caffe_axpy<float>(ctx->data_size, 1.f, &scratch[0], &partial[0]);
+      if (++unfolded == kFoldInterval) {
+        for (int i = 0; i < ctx->data_size; ++i) {
+          shard.sum[i] += partial[i];
+        }
+        caffe_set<float>(ctx->data_size, 0.f, &partial[0]);
+        unfolded = 0;
+      }
+    }
+    for (int c = 0; c < ctx->channels; ++c) {
+      double channel = 0;
+      for (int i = 0; i < ctx->dim; ++i) {
+        channel += scratch[c * ctx->dim + i];
+      }
+      shard.channel_sum[c] += channel;
+      const double image_mean = channel / ctx->dim;
+      shard.image_mean_sum[c] += image_mean;
+      shard.image_mean_sumsq[c] += image_mean * image_mean;
+    }
+    ++shard.count;
+  }
+  for (int i = 0; i < static_cast<int>(shard.sum.size()); ++i) {
+    shard.sum[i] += partial[i];
+  }
+}
+
+}  // namespace
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
   ::google::InitGoogleLogging(argv[0]);
@@ -40,14 +188,15 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_image_mean");
     return 1;
   }
+  CHECK(FLAGS_sample_ratio > 0 && FLAGS_sample_ratio <= 1)
+      << "--sample_ratio must be in (0, 1].";
+  const bool sampling = FLAGS_sample_ratio < 1;
 
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
   db->Open(argv[1], db::READ);
   scoped_ptr<db::Cursor> cursor(db->NewCursor());
 
-  BlobProto sum_blob;
-  int count = 0;
-  // load first datum
+  // load first datum, which fixes the shape for the whole database
   Datum datum;
   datum.ParseFromString(cursor->value());
 
@@ -55,66 +204,104 @@ int main(int argc, char** argv) {
     LOG(INFO) << "Decoding Datum";
   }
 
-  sum_blob.set_num(1);
-  sum_blob.set_channels(datum.channels());
-  sum_blob.set_height(datum.height());
-  sum_blob.set_width(datum.width());
-  const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  const int threads = FLAGS_threads > 0 ? FLAGS_threads
+      : std::max<int>(1, boost::thread::hardware_concurrency());
+  ValueQueue queue(threads * 8);
+  MeanContext ctx;
+  ctx.queue = &queue;
+  ctx.channels = datum.channels();
+  ctx.dim = datum.height() * datum.width();
+  ctx.data_size = datum.channels() * datum.height() * datum.width();
+  ctx.channel_mean_only = FLAGS_channel_mean_only;
+  ctx.shards.resize(threads);
+  boost::thread_group workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.create_thread(boost::bind(&AccumulateWorker, &ctx, i));
   }
+
   LOG(INFO) << "Starting Iteration";
+  size_t scanned = 0;
   while (cursor->valid()) {
-    Datum datum;
-    datum.ParseFromString(cursor->value());
-    DecodeDatumNative(&datum);
-
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
-      }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
-      }
+    bool keep = true;
+    if (sampling) {
+      int coin;
+      caffe_rng_bernoulli(1, FLAGS_sample_ratio, &coin);
+      keep = coin;
+    }
+    if (keep) {
+      queue.Push(new std::string(cursor->value()));
     }
-    ++count;
-    if (count % 10000 == 0) {
-      LOG(INFO) << "Processed " << count << " files.";
+    if (++scanned % 10000 == 0) {
+      LOG(INFO) << "Processed " << scanned << " files.";
     }
     cursor->Next();
   }
+  if (scanned % 10000 != 0) {
+    LOG(INFO) << "Processed " << scanned << " files.";
+  }
+  for (int i = 0; i < threads; ++i) {
+    queue.Push(NULL);
+  }
+  workers.join_all();
 
-  if (count % 10000 != 0) {
-    LOG(INFO) << "Processed " << count << " files.";
+  // Merge the shards.
+  size_t count = 0;
+  std::vector<double> sum(ctx.channel_mean_only ? 0 : ctx.data_size, 0.);
+  std::vector<double> channel_sum(ctx.channels, 0.);
+  std::vector<double> mean_sum(ctx.channels, 0.), mean_sumsq(ctx.channels, 0.);
+  for (int s = 0; s < threads; ++s) {
+    const MeanShard& shard = ctx.shards[s];
+    count += shard.count;
+    for (int i = 0; i < static_cast<int>(sum.size()); ++i) {
+      sum[i] += shard.sum[i];
+    }
+    for (int c = 0; c < ctx.channels; ++c) {
+      channel_sum[c] += shard.channel_sum[c];
+      mean_sum[c] += shard.image_mean_sum[c];
+      mean_sumsq[c] += shard.image_mean_sumsq[c];
+    }
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
+  CHECK_GT(count, 0) << "No images accumulated; is --sample_ratio too small?";
+  if (sampling) {
+    LOG(INFO) << "Sampled " << count << " of " << scanned << " images.";
+  }
+
+  BlobProto sum_blob;
+  sum_blob.set_num(1);
+  sum_blob.set_channels(ctx.channels);
+  if (ctx.channel_mean_only) {
+    sum_blob.set_height(1);
+    sum_blob.set_width(1);
+    for (int c = 0; c < ctx.channels; ++c) {
+      sum_blob.add_data(channel_sum[c] / count / ctx.dim);
+    }
+  } else {
+    sum_blob.set_height(datum.height());
+    sum_blob.set_width(datum.width());
+    for (int i = 0; i < ctx.data_size; ++i) {
+      sum_blob.add_data(sum[i] / count);
+    }
   }
   // Write to disk
   if (argc == 3) {
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
-  const int dim = sum_blob.height() * sum_blob.width();
-  std::vector<float> mean_values(channels, 0.0);
-  LOG(INFO) << "Number of channels: " << channels;
-  for (int c = 0; c < channels; ++c) {
-    for (int i = 0; i < dim; ++i) {
-      mean_values[c] += sum_blob.data(dim * c + i);
+  LOG(INFO) << "Number of channels: " << ctx.channels;
+  for (int c = 0; c < ctx.channels; ++c) {
+    const double mean = channel_sum[c] / count / ctx.dim;
+    if (sampling && count > 1) {
+      // Standard error of the sampled mean, over per-image channel means.
+      const double avg = mean_sum[c] / count;
+      const double var =
+          std::max(0., mean_sumsq[c] / count - avg * avg) * count
+          / (count - 1);
+      const double half_width = 1.96 * std::sqrt(var / count);
+      LOG(INFO) << "mean_value channel [" << c << "]:" << mean
+                << " +/- " << half_width << " (95% CI)";
+    } else {
+      LOG(INFO) << "mean_value channel [" << c << "]:" << mean;
     }
-    LOG(INFO) << "mean_value channel [" << c << "]:" << mean_values[c] / dim;
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
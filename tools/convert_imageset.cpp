@@ -7,17 +7,28 @@
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// Decoding and re-encoding run on --threads worker threads feeding a
+// single writer, which keeps the database keys in line order so LMDB
+// can use its append fast path. Transactions span --commit_interval
+// images, and a sidecar progress file makes interrupted conversions
+// resumable with --resume.
 
 #include <algorithm>
+#include <cstdio>
+#include <deque>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
+#include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
@@ -32,6 +43,9 @@ DEFINE_bool(gray, false,
     "When this option is on, treat images as grayscale ones");
 DEFINE_bool(shuffle, false,
     "Randomly shuffle the order of images and their labels");
+DEFINE_int32(shuffle_seed, -1,
+    "Optional: seed for --shuffle, making the order reproducible. "
+    "Required when combining --shuffle with --resume.");
 DEFINE_string(backend, "lmdb",
         "The backend {lmdb, leveldb} for storing the result");
 DEFINE_int32(resize_width, 0, "Width images are resized to");
@@ -42,6 +56,121 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "Number of image decode/encode worker threads; 0 means one per "
+    "hardware thread.");
+DEFINE_int32(commit_interval, 10000,
+    "Number of images written per database transaction.");
+DEFINE_bool(resume, false,
+    "Continue a previous run of this tool on the same LISTFILE and "
+    "DB_NAME, skipping the images it already committed.");
+
+#ifdef USE_OPENCV
+namespace {
+
+// One image, decoded and serialized by a worker, ready for the writer.
+struct PendingImage {
+  bool ok;
+  std::string key;
+  std::string value;
+  int data_size;
+};
+
+// Fixed-capacity handoff from one worker to the writer. The bound is
+// what caps the pipeline's memory when the writer falls behind.
+// (caffe::BlockingQueue is unbounded and only instantiated for the
+// framework's own element types, so the tool carries its own.)
+class ImageQueue {
+ public:
+  explicit ImageQueue(size_t capacity) : capacity_(capacity) {}
+  void Push(PendingImage* image) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.size() >= capacity_) {
+      not_full_.wait(lock);
+    }
+    queue_.push_back(image);
+    not_empty_.notify_one();
+  }
+  PendingImage* Pop() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.empty()) {
+      not_empty_.wait(lock);
+    }
+    PendingImage* image = queue_.front();
+    queue_.pop_front();
+    not_full_.notify_one();
+    return image;
+  }
+
+ private:
+  const size_t capacity_;
+  boost::mutex mutex_;
+  boost::condition_variable not_empty_, not_full_;
+  std::deque<PendingImage*> queue_;
+};
+
+// Everything the workers share, read-only once the threads start.
+struct ConvertContext {
+  const std::vector<std::pair<std::string, int> >* lines;
+  std::string root_folder;
+  bool is_color;
+  bool encoded;
+  std::string encode_type;
+  int resize_height, resize_width;
+  int start_line;
+  int threads;
+  std::vector<boost::shared_ptr<ImageQueue> > queues;
+};
+
+// Worker w handles the lines with line_id % threads == w, so the writer
+// can pop queues round-robin and reassemble line order without tickets.
+void EncodeWorker(ConvertContext* ctx, int worker) {
+  const std::vector<std::pair<std::string, int> >& lines = *ctx->lines;
+  int line_id = ctx->start_line +
+      (worker - ctx->start_line % ctx->threads + ctx->threads) % ctx->threads;
+  Datum datum;
+  for (; line_id < lines.size(); line_id += ctx->threads) {
+    PendingImage* image = new PendingImage();
+    std::string enc = ctx->encode_type;
+    if (ctx->encoded && !enc.size()) {
+      // Guess the encoding type from the file name
+      const string& fn = lines[line_id].first;
+      size_t p = fn.rfind('.');
+      if ( p == fn.npos )
+        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+      enc = fn.substr(p);
+      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+    }
+    image->ok = ReadImageToDatum(ctx->root_folder + lines[line_id].first,
+        lines[line_id].second, ctx->resize_height, ctx->resize_width,
+        ctx->is_color, enc, &datum);
+    if (image->ok) {
+      image->key =
+          caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
+      image->data_size = datum.channels() * datum.height() * datum.width();
+      CHECK(datum.SerializeToString(&image->value));
+    }
+    ctx->queues[worker]->Push(image);
+  }
+}
+
+// The progress file records how many input lines have been committed to
+// the database, updated atomically right after each commit.
+std::string progress_path(const char* db_path) {
+  return std::string(db_path) + ".progress";
+}
+
+void write_progress(const std::string& path, size_t lines_done) {
+  const std::string tmp = path + ".tmp";
+  std::ofstream out(tmp.c_str());
+  out << lines_done << std::endl;
+  out.close();
+  CHECK_EQ(0, std::rename(tmp.c_str(), path.c_str()))
+      << "Failed to update " << path;
+}
+
+}  // namespace
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -79,7 +208,14 @@ int main(int argc, char** argv) {
     lines.push_back(std::make_pair(filename, label));
   }
   if (FLAGS_shuffle) {
-    // randomly shuffle data
+    // randomly shuffle data; a fixed seed keeps the order reproducible,
+    // which --resume depends on to skip the right lines.
+    CHECK(!FLAGS_resume || FLAGS_shuffle_seed >= 0)
+        << "--resume with --shuffle requires --shuffle_seed so the "
+        << "shuffled order matches the interrupted run.";
+    if (FLAGS_shuffle_seed >= 0) {
+      Caffe::set_random_seed(FLAGS_shuffle_seed);
+    }
     LOG(INFO) << "Shuffling data";
     shuffle(lines.begin(), lines.end());
   }
@@ -91,64 +227,98 @@ int main(int argc, char** argv) {
   int resize_height = std::max<int>(0, FLAGS_resize_height);
   int resize_width = std::max<int>(0, FLAGS_resize_width);
 
+  // Resume from the progress file if asked to and one exists.
+  const std::string progress = progress_path(argv[3]);
+  int start_line = 0;
+  db::Mode mode = db::NEW;
+  if (FLAGS_resume) {
+    std::ifstream progress_file(progress.c_str());
+    if (progress_file >> start_line) {
+      CHECK_LE(start_line, lines.size())
+          << progress << " does not match " << argv[2];
+      LOG(INFO) << "Resuming at image " << start_line << " of "
+                << lines.size() << ".";
+      mode = db::WRITE;
+    } else {
+      LOG(INFO) << "No progress file at " << progress
+                << "; starting from scratch.";
+    }
+  }
+  if (start_line >= lines.size()) {
+    LOG(INFO) << "Nothing left to do.";
+    return 0;
+  }
+
   // Create new DB
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[3], db::NEW);
+  db->Open(argv[3], mode);
   scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  // The fixed-width line_id prefix makes the keys strictly increasing
+  // (until it would overflow eight digits), so the backend may append.
+  const bool sorted_keys = lines.size() <= 100000000;
+  txn->set_append(sorted_keys);
 
-  // Storing to db
-  std::string root_folder(argv[1]);
-  Datum datum;
+  // Start the decode/encode workers.
+  int threads = FLAGS_threads > 0 ? FLAGS_threads
+      : std::max<int>(1, boost::thread::hardware_concurrency());
+  threads = std::min<int>(threads, lines.size() - start_line);
+  ConvertContext ctx;
+  ctx.lines = &lines;
+  ctx.root_folder = argv[1];
+  ctx.is_color = is_color;
+  ctx.encoded = encoded;
+  ctx.encode_type = encode_type;
+  ctx.resize_height = resize_height;
+  ctx.resize_width = resize_width;
+  ctx.start_line = start_line;
+  ctx.threads = threads;
+  for (int i = 0; i < threads; ++i) {
+    ctx.queues.push_back(
+        boost::shared_ptr<ImageQueue>(new ImageQueue(16)));
+  }
+  boost::thread_group workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.create_thread(boost::bind(&EncodeWorker, &ctx, i));
+  }
+
+  // Storing to db, in line order, on this thread.
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
 
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if ( p == fn.npos )
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      enc = fn.substr(p);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-    }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
-        lines[line_id].second, resize_height, resize_width, is_color,
-        enc, &datum);
-    if (status == false) continue;
-    if (check_size) {
-      if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
-        data_size_initialized = true;
-      } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
+  for (int line_id = start_line; line_id < lines.size(); ++line_id) {
+    PendingImage* image = ctx.queues[line_id % threads]->Pop();
+    if (image->ok) {
+      if (check_size) {
+        if (!data_size_initialized) {
+          data_size = image->data_size;
+          data_size_initialized = true;
+        } else {
+          CHECK_EQ(image->data_size, data_size)
+              << "Incorrect data field size for " << image->key;
+        }
+      }
+      // Put in db
+      txn->Put(image->key.data(), image->key.size(),
+               image->value.data(), image->value.size());
+
+      if (++count % FLAGS_commit_interval == 0) {
+        // Commit db; the progress file must only ever name committed
+        // lines, or a resumed run would skip uncommitted images.
+        txn->Commit();
+        write_progress(progress, line_id + 1);
+        txn.reset(db->NewTransaction());
+        txn->set_append(sorted_keys);
+        LOG(INFO) << "Processed " << count << " files.";
       }
     }
-    // sequential
-    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
-
-    // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
-
-    if (++count % 1000 == 0) {
-      // Commit db
-      txn->Commit();
-      txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
-    }
+    delete image;
   }
   // write the last batch
-  if (count % 1000 != 0) {
-    txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
-  }
+  txn->Commit();
+  write_progress(progress, lines.size());
+  LOG(INFO) << "Processed " << count << " files.";
+  workers.join_all();
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
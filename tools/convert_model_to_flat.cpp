@@ -0,0 +1,30 @@
+// Converts a binary proto model to the memory-mappable flat weight
+// format (see caffe/util/flat_weights.hpp), which Net loads with one
+// mmap instead of parsing and copying every weight.
+// Usage:
+//    convert_model_to_flat net_proto_file_in flat_weight_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/flat_weights.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 3) {
+    LOG(ERROR) << "Usage: "
+        << "convert_model_to_flat net_proto_file_in flat_weight_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromBinaryFileOrDie(string(argv[1]), &net_param);
+  FlatWeights<float>::Write(net_param, string(argv[2]));
+
+  LOG(INFO) << "Wrote flat weight file to " << argv[2];
+  return 0;
+}
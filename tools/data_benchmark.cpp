@@ -0,0 +1,177 @@
+// Benchmarks the data ingest pipeline in isolation: the data layers of
+// a net prototxt are run without the rest of the model, with a consumer
+// popping batches as fast as the prefetch threads can fill them.
+//
+// For each configuration the tool reports images/sec and, per layer,
+// how the producer time splits between reading/decoding and
+// transforming, plus queue wait on both sides -- the numbers needed to
+// size DataParameter.prefetch_threads and TransformationParameter
+// .threads for a machine before launching a long job. Pass sweeps as
+// comma-separated lists to measure several settings in one run.
+// Usage:
+//    data_benchmark --model=train_val.prototxt \
+//        [--prefetch_threads=1,2,4] [--transform_threads=1,4] [--gpu=0]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Caffe;
+using caffe::Net;
+using caffe::NetParameter;
+using caffe::LayerParameter;
+using caffe::PrefetchStats;
+using caffe::Timer;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file. Only its data "
+    "layers (layers with no bottoms) are instantiated.");
+DEFINE_string(phase, "TRAIN",
+    "Network phase to benchmark (TRAIN or TEST).");
+DEFINE_int32(gpu, -1,
+    "Optional; run on the GPU with the given device ID (exercises the "
+    "device upload and any GPU transform engine).");
+DEFINE_int32(batches, 200,
+    "The number of batches to consume per configuration.");
+DEFINE_int32(warmup_batches, 20,
+    "Batches consumed before the timed window, so the queues reach "
+    "steady state first.");
+DEFINE_string(prefetch_threads, "",
+    "Optional sweep of DataParameter.prefetch_threads values, separated "
+    "by ','. Empty keeps the prototxt settings.");
+DEFINE_string(transform_threads, "",
+    "Optional sweep of TransformationParameter.threads values, separated "
+    "by ','. Empty keeps the prototxt settings.");
+
+namespace {
+
+void parse_sweep(const string& spec, vector<int>* values) {
+  if (spec.empty()) {
+    values->push_back(-1);  // keep the prototxt setting
+    return;
+  }
+  vector<string> strings;
+  boost::split(strings, spec, boost::is_any_of(","));
+  for (int i = 0; i < strings.size(); ++i) {
+    values->push_back(boost::lexical_cast<int>(strings[i]));
+  }
+}
+
+// Measures one configuration and prints a CSV row per data layer.
+void run_config(const NetParameter& param, caffe::Phase phase,
+    int prefetch_threads, int transform_threads) {
+  NetParameter config = param;
+  for (int i = 0; i < config.layer_size(); ++i) {
+    LayerParameter* layer = config.mutable_layer(i);
+    if (prefetch_threads > 0) {
+      layer->mutable_data_param()->set_prefetch_threads(prefetch_threads);
+    }
+    if (transform_threads > 0) {
+      layer->mutable_transform_param()->set_threads(transform_threads);
+    }
+  }
+  Net<float> net(config, phase);
+
+  for (int i = 0; i < FLAGS_warmup_batches; ++i) {
+    net.Forward();
+  }
+  const vector<PrefetchStats> before = net.prefetch_stats();
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_batches; ++i) {
+    net.Forward();
+  }
+  timer.Stop();
+  const double seconds = timer.MilliSeconds() / 1000;
+  const vector<PrefetchStats> after = net.prefetch_stats();
+
+  CHECK_EQ(before.size(), after.size());
+  for (int i = 0; i < after.size(); ++i) {
+    const PrefetchStats& b = before[i];
+    const PrefetchStats& a = after[i];
+    const size_t batches = a.batches_consumed - b.batches_consumed;
+    // Every data layer's first top carries one image per batch row.
+    int batch_size = 0;
+    for (int l = 0; l < net.layers().size(); ++l) {
+      if (net.layers()[l]->layer_param().name() == a.layer_name &&
+          !net.top_vecs()[l].empty()) {
+        batch_size = net.top_vecs()[l][0]->shape(0);
+      }
+    }
+    const double per_batch_ms = batches ? seconds * 1000 / batches : 0;
+    printf("%s,%d,%d,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu\n",
+        a.layer_name.c_str(),
+        prefetch_threads, transform_threads,
+        batches * batch_size / seconds,
+        per_batch_ms,
+        (a.read_us - b.read_us) / 1000 / std::max<size_t>(batches, 1),
+        (a.transform_us - b.transform_us) / 1000
+            / std::max<size_t>(batches, 1),
+        (a.producer_wait_us - b.producer_wait_us) / 1000
+            / std::max<size_t>(batches, 1),
+        (a.consumer_wait_us - b.consumer_wait_us) / 1000
+            / std::max<size_t>(batches, 1),
+        a.free_queue_size, a.full_queue_size);
+    fflush(stdout);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  ::gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to benchmark.";
+
+  if (FLAGS_gpu >= 0) {
+    LOG(INFO) << "Use GPU with device ID " << FLAGS_gpu;
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    LOG(INFO) << "Use CPU.";
+    Caffe::set_mode(Caffe::CPU);
+  }
+  const caffe::Phase phase =
+      FLAGS_phase == "TEST" ? caffe::TEST : caffe::TRAIN;
+
+  NetParameter full_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &full_param);
+  // Keep only the source layers: everything with a bottom is the model
+  // the request explicitly excludes.
+  NetParameter data_param;
+  data_param.set_name(full_param.name() + "_data_only");
+  for (int i = 0; i < full_param.layer_size(); ++i) {
+    if (full_param.layer(i).bottom_size() == 0) {
+      *data_param.add_layer() = full_param.layer(i);
+    }
+  }
+  CHECK_GT(data_param.layer_size(), 0)
+      << "No data layers (layers without bottoms) in " << FLAGS_model;
+
+  vector<int> prefetch_sweep, transform_sweep;
+  parse_sweep(FLAGS_prefetch_threads, &prefetch_sweep);
+  parse_sweep(FLAGS_transform_threads, &transform_sweep);
+
+  printf("layer,prefetch_threads,transform_threads,images_per_sec,"
+         "batch_ms,read_ms,transform_ms,producer_wait_ms,"
+         "consumer_wait_ms,free_queue,full_queue\n");
+  for (int p = 0; p < prefetch_sweep.size(); ++p) {
+    for (int t = 0; t < transform_sweep.size(); ++t) {
+      run_config(data_param, phase, prefetch_sweep[p], transform_sweep[t]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,224 @@
+// Microbenchmarks a single layer across a sweep of input shapes.
+//
+// The layer is given as a LayerParameter prototxt file and instantiated
+// through the layer registry, so every registered type (including
+// cuDNN engines) can be measured without building a net around it.
+// For each shape in the sweep the harness runs warmup then timed
+// Forward (and optionally Backward) passes and prints one CSV row with
+// average latency, GFLOP/s and achieved bandwidth, suitable for diffing
+// between kernel changes.
+// Usage:
+//    layer_benchmark --layer=conv.prototxt \
+//        --shapes="16,3,224,224;32,3,224,224" [--gpu=0] [--backward]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/benchmark.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::Layer;
+using caffe::LayerParameter;
+using caffe::LayerRegistry;
+using caffe::Timer;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(layer, "",
+    "The LayerParameter definition prototxt file for the layer to time.");
+DEFINE_string(shapes, "1,3,224,224",
+    "Bottom shape sweep: dims separated by ',', shapes separated by ';'. "
+    "Every bottom of the layer gets the same shape.");
+DEFINE_int32(gpu, -1,
+    "Optional; run on the GPU with the given device ID.");
+DEFINE_int32(iterations, 50,
+    "The number of timed iterations per shape.");
+DEFINE_int32(warmup, 10,
+    "The number of untimed warmup iterations per shape.");
+DEFINE_bool(backward, false,
+    "Also time the Backward pass (top diffs filled with gaussians).");
+
+namespace {
+
+// Parses "16,3,224,224;32,3,224,224" into one shape per entry.
+void parse_shapes(const string& spec, vector<vector<int> >* shapes) {
+  vector<string> shape_strings;
+  boost::split(shape_strings, spec, boost::is_any_of(";"));
+  for (int i = 0; i < shape_strings.size(); ++i) {
+    vector<string> dim_strings;
+    boost::split(dim_strings, shape_strings[i], boost::is_any_of(","));
+    vector<int> shape;
+    for (int j = 0; j < dim_strings.size(); ++j) {
+      shape.push_back(boost::lexical_cast<int>(
+          boost::trim_copy(dim_strings[j])));
+    }
+    CHECK(!shape.empty()) << "Empty shape in --shapes";
+    shapes->push_back(shape);
+  }
+  CHECK(!shapes->empty()) << "--shapes parsed to nothing";
+}
+
+// Rough FLOP estimate from the shapes alone. For layers whose work is a
+// matrix product against their first parameter blob (convolution, inner
+// product), every output element costs weight_count / weight_shape(0)
+// multiply-adds; for parameter-free layers we count one op per output
+// element, which makes the bandwidth column the meaningful one.
+double estimate_flops(const Layer<float>& layer,
+    const vector<Blob<float>*>& top) {
+  double top_count = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    top_count += top[i]->count();
+  }
+  if (layer.blobs().size() && layer.blobs()[0]->num_axes() >= 2) {
+    const Blob<float>& weight = *layer.blobs()[0];
+    return 2.0 * weight.count() * top_count / weight.shape(0);
+  }
+  return top_count;
+}
+
+// Bytes touched by one Forward pass: read every bottom and parameter,
+// write every top. Backward reads and writes roughly the same set plus
+// the parameter diffs; we reuse this figure for both directions.
+double estimate_bytes(const Layer<float>& layer,
+    const vector<Blob<float>*>& bottom, const vector<Blob<float>*>& top) {
+  double count = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    count += bottom[i]->count();
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    count += top[i]->count();
+  }
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    count += layer.blobs()[i]->count();
+  }
+  return count * sizeof(float);
+}
+
+string shape_to_string(const vector<int>& shape) {
+  std::ostringstream stream;
+  for (int i = 0; i < shape.size(); ++i) {
+    stream << (i ? "x" : "") << shape[i];
+  }
+  return stream.str();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  ::gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_layer.size(), 0) << "Need a layer definition to time.";
+
+  if (FLAGS_gpu >= 0) {
+    LOG(INFO) << "Use GPU with device ID " << FLAGS_gpu;
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    LOG(INFO) << "Use CPU.";
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  LayerParameter layer_param;
+  CHECK(caffe::ReadProtoFromTextFile(FLAGS_layer, &layer_param))
+      << "Failed to parse LayerParameter file " << FLAGS_layer;
+
+  vector<vector<int> > shapes;
+  parse_shapes(FLAGS_shapes, &shapes);
+
+  // Header first so the output is a valid CSV stream even if a shape
+  // aborts mid-sweep.
+  printf("shape,forward_ms,backward_ms,forward_gflops,backward_gflops,"
+         "forward_gb_s,backward_gb_s\n");
+
+  for (int s = 0; s < shapes.size(); ++s) {
+    // A fresh layer per shape: Reshape is exercised once during SetUp
+    // and the timed loop then measures steady-state kernels only.
+    shared_ptr<Layer<float> > layer =
+        LayerRegistry<float>::CreateLayer(layer_param);
+    const int num_bottoms = layer->ExactNumBottomBlobs() >= 0 ?
+        layer->ExactNumBottomBlobs() : std::max(layer->MinBottomBlobs(), 1);
+    const int num_tops = layer->ExactNumTopBlobs() >= 0 ?
+        layer->ExactNumTopBlobs() : std::max(layer->MinTopBlobs(), 1);
+
+    vector<shared_ptr<Blob<float> > > blob_storage;
+    vector<Blob<float>*> bottom, top;
+    caffe::FillerParameter filler_param;
+    caffe::GaussianFiller<float> filler(filler_param);
+    for (int i = 0; i < num_bottoms; ++i) {
+      shared_ptr<Blob<float> > blob(new Blob<float>(shapes[s]));
+      filler.Fill(blob.get());
+      blob_storage.push_back(blob);
+      bottom.push_back(blob.get());
+    }
+    for (int i = 0; i < num_tops; ++i) {
+      shared_ptr<Blob<float> > blob(new Blob<float>());
+      blob_storage.push_back(blob);
+      top.push_back(blob.get());
+    }
+    layer->SetUp(bottom, top);
+
+    const vector<bool> propagate_down(bottom.size(), true);
+    if (FLAGS_backward) {
+      for (int i = 0; i < top.size(); ++i) {
+        Blob<float> diff(top[i]->shape());
+        filler.Fill(&diff);
+        caffe::caffe_copy(diff.count(), diff.cpu_data(),
+            top[i]->mutable_cpu_diff());
+      }
+    }
+
+    for (int i = 0; i < FLAGS_warmup; ++i) {
+      layer->Forward(bottom, top);
+      if (FLAGS_backward) {
+        layer->Backward(top, propagate_down, bottom);
+      }
+    }
+
+    Timer forward_timer;
+    forward_timer.Start();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      layer->Forward(bottom, top);
+    }
+    forward_timer.Stop();
+    const double forward_ms =
+        forward_timer.MilliSeconds() / FLAGS_iterations;
+
+    double backward_ms = 0;
+    if (FLAGS_backward) {
+      Timer backward_timer;
+      backward_timer.Start();
+      for (int i = 0; i < FLAGS_iterations; ++i) {
+        layer->Backward(top, propagate_down, bottom);
+      }
+      backward_timer.Stop();
+      backward_ms = backward_timer.MilliSeconds() / FLAGS_iterations;
+    }
+
+    const double flops = estimate_flops(*layer, top);
+    const double bytes = estimate_bytes(*layer, bottom, top);
+    const double forward_gflops = flops / (forward_ms * 1e6);
+    const double backward_gflops =
+        backward_ms > 0 ? 2 * flops / (backward_ms * 1e6) : 0;
+    const double forward_gb_s = bytes / (forward_ms * 1e6);
+    const double backward_gb_s =
+        backward_ms > 0 ? 2 * bytes / (backward_ms * 1e6) : 0;
+    printf("%s,%.4f,%.4f,%.2f,%.2f,%.2f,%.2f\n",
+        shape_to_string(shapes[s]).c_str(), forward_ms, backward_ms,
+        forward_gflops, backward_gflops, forward_gb_s, backward_gb_s);
+    fflush(stdout);
+  }
+  return 0;
+}